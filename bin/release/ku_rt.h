@@ -0,0 +1,142 @@
+#ifndef KU_RT_H
+#define KU_RT_H
+
+// Single header runtime of C programs produced by cckuc emit-c command. It
+// depends only on standard C11 headers, generated code includes it and is
+// linked with native runtime library (see native_rt.h). Declarations below
+// mirror strings and values of bytecode runtime (see runtime.h), native
+// runtime checks that their layouts match
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct KuString KuString;
+typedef union KuValue KuValue;
+
+struct KuString {
+    const uint8_t *bytes;
+    uint64_t len;
+
+    // NULL for string literals
+    void *buffer;
+};
+
+// KuValue is argument of print builtins, floats of both sizes are passed as
+// double, bools as 0 or 1 in u field
+union KuValue {
+    uint64_t u;
+    int64_t i;
+    double f;
+    const KuString *s;
+};
+
+// kinds of print builtin arguments, as VmKind
+enum {
+    KU_KIND_SIGNED,
+    KU_KIND_UNSIGNED,
+    KU_KIND_F32,
+    KU_KIND_F64,
+    KU_KIND_BOOL,
+    KU_KIND_STR,
+};
+
+// runtime errors, as NativeError
+enum {
+    KU_DIVISION_BY_ZERO,
+    KU_STACK_OVERFLOW,
+};
+
+extern uint64_t ku_rt_stack_limit;
+
+const KuString *ku_rt_concat(const KuString *a, const KuString *b);
+int32_t ku_rt_compare(const KuString *a, const KuString *b);
+void ku_rt_print(uint32_t builtin, const KuValue *values, const uint32_t *kinds, uint32_t len);
+_Noreturn void ku_rt_fail(uint32_t error, const char *function);
+
+// value of uninitialized string variables and results
+static const KuString ku_empty_string = {(const uint8_t *)"", 0, NULL};
+
+// Integer operations are done on 64-bit values and converted back to type
+// of result, the same way as in bytecode. Signed overflow wraps around
+
+static inline int64_t ku_divs(int64_t a, int64_t b, const char *function) {
+    if (b == 0) {
+        ku_rt_fail(KU_DIVISION_BY_ZERO, function);
+    }
+    if (b == -1) {
+        return (int64_t)(0 - (uint64_t)a);
+    }
+    return a / b;
+}
+
+static inline int64_t ku_rems(int64_t a, int64_t b, const char *function) {
+    if (b == 0) {
+        ku_rt_fail(KU_DIVISION_BY_ZERO, function);
+    }
+    if (b == -1) {
+        return 0;
+    }
+    return a % b;
+}
+
+static inline uint64_t ku_divu(uint64_t a, uint64_t b, const char *function) {
+    if (b == 0) {
+        ku_rt_fail(KU_DIVISION_BY_ZERO, function);
+    }
+    return a / b;
+}
+
+static inline uint64_t ku_remu(uint64_t a, uint64_t b, const char *function) {
+    if (b == 0) {
+        ku_rt_fail(KU_DIVISION_BY_ZERO, function);
+    }
+    return a % b;
+}
+
+// shift count is taken as unsigned, shifting by 64 or more bits moves all
+// bits out
+static inline uint64_t ku_shl(uint64_t x, uint64_t k) {
+    return k < 64 ? x << k : 0;
+}
+
+static inline uint64_t ku_shru(uint64_t x, uint64_t k) {
+    return k < 64 ? x >> k : 0;
+}
+
+static inline int64_t ku_shrs(int64_t x, uint64_t k) {
+    if (k > 63) {
+        k = 63;
+    }
+    // right shift of negative numbers is implementation defined
+    return x < 0 ? ~(~x >> k) : x >> k;
+}
+
+static inline double ku_f64(uint64_t bits) {
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+static inline float ku_f32(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// KU_CHECK_STACK reports stack overflow when function frame is below the
+// limit set by runtime
+#if defined(__GNUC__)
+#define KU_CHECK_STACK(function)                                                                                       \
+    if ((uintptr_t)__builtin_frame_address(0) < ku_rt_stack_limit) {                                                   \
+        ku_rt_fail(KU_STACK_OVERFLOW, function);                                                                       \
+    }
+#else
+#define KU_CHECK_STACK(function)                                                                                       \
+    char ku_stack_marker;                                                                                              \
+    if ((uintptr_t)&ku_stack_marker < ku_rt_stack_limit) {                                                             \
+        ku_rt_fail(KU_STACK_OVERFLOW, function);                                                                       \
+    }
+#endif
+
+#endif // KU_RT_H
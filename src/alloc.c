@@ -0,0 +1,160 @@
+// getrusage is not part of C11
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "alloc.h"
+
+_Static_assert(sizeof(AllocHeader) % _Alignof(max_align_t) == 0, "allocation header breaks alignment");
+
+const char *alloc_tag_names[] = {
+    [at_Other]   = "other",
+    [at_Source]  = "source",
+    [at_Scanner] = "scanner",
+    [at_AST]     = "ast",
+    [at_Map]     = "map",
+    [at_String]  = "string",
+    [at_Slice]   = "slice",
+    [at_IR]      = "ir",
+    [at_Vm]      = "vm",
+};
+
+// counters are updated only when stats are enabled, so that regular runs do
+// not pay for shared atomic updates on every allocation
+bool mem_stats_enabled = false;
+
+AllocStats alloc_stats[at_end];
+
+// counters of all tags together, peak of total is not a sum of tag peaks
+AllocStats total_alloc_stats;
+
+// enable_mem_stats turns on accounting of allocations, it must be called
+// before any worker thread is started
+void enable_mem_stats() {
+    mem_stats_enabled = true;
+}
+
+void update_peak(atomic_uint_fast64_t *peak, u64 live) {
+    u64 p = atomic_load_explicit(peak, memory_order_relaxed);
+    while (live > p && !atomic_compare_exchange_weak_explicit(peak, &p, live, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void add_live_bytes(AllocStats *stats, u64 size) {
+    u64 live = atomic_fetch_add_explicit(&stats->live, size, memory_order_relaxed) + size;
+    update_peak(&stats->peak, live);
+}
+
+void record_growth(AllocTag tag, u64 size) {
+    atomic_fetch_add_explicit(&alloc_stats[tag].allocated, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total_alloc_stats.allocated, size, memory_order_relaxed);
+    add_live_bytes(&alloc_stats[tag], size);
+    add_live_bytes(&total_alloc_stats, size);
+}
+
+void record_shrink(AllocTag tag, u64 size) {
+    atomic_fetch_sub_explicit(&alloc_stats[tag].live, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&total_alloc_stats.live, size, memory_order_relaxed);
+}
+
+void *finish_alloc(AllocTag tag, AllocHeader *h, u64 size) {
+    h->size    = size;
+    h->tag     = tag;
+    h->counted = mem_stats_enabled;
+    if (!h->counted) {
+        return h + 1;
+    }
+
+    atomic_fetch_add_explicit(&alloc_stats[tag].allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total_alloc_stats.allocs, 1, memory_order_relaxed);
+    record_growth(tag, size);
+    return h + 1;
+}
+
+// alloc_mem allocates memory block and accounts it under given tag. Returns nil
+// if there is not enough memory, blocks must be freed only with free_mem
+void *alloc_mem(AllocTag tag, u64 size) {
+    AllocHeader *h = (AllocHeader *)malloc(sizeof(AllocHeader) + size);
+    if (h == nil) {
+        return nil;
+    }
+    return finish_alloc(tag, h, size);
+}
+
+void *alloc_zeroed_mem(AllocTag tag, u64 size) {
+    AllocHeader *h = (AllocHeader *)calloc(1, sizeof(AllocHeader) + size);
+    if (h == nil) {
+        return nil;
+    }
+    return finish_alloc(tag, h, size);
+}
+
+// realloc_mem changes size of memory block keeping its tag, given tag is
+// used only if ptr is nil
+void *realloc_mem(AllocTag tag, void *ptr, u64 size) {
+    if (ptr == nil) {
+        return alloc_mem(tag, size);
+    }
+
+    AllocHeader *h = (AllocHeader *)ptr - 1;
+    u64 old_size   = h->size;
+    tag            = (AllocTag)h->tag;
+
+    h = (AllocHeader *)realloc(h, sizeof(AllocHeader) + size);
+    if (h == nil) {
+        return nil;
+    }
+    h->size = size;
+    if (!h->counted) {
+        return h + 1;
+    }
+    if (size > old_size) {
+        record_growth(tag, size - old_size);
+    } else {
+        record_shrink(tag, old_size - size);
+    }
+    return h + 1;
+}
+
+void free_mem(void *ptr) {
+    if (ptr == nil) {
+        return;
+    }
+    AllocHeader *h = (AllocHeader *)ptr - 1;
+    if (h->counted) {
+        record_shrink((AllocTag)h->tag, h->size);
+    }
+    free(h);
+}
+
+void print_alloc_stats(const char *name, AllocStats *stats) {
+    fprintf(stderr,
+        "%-8s  %12llu  %16llu  %16llu  %16llu\n",
+        name,
+        (unsigned long long)atomic_load(&stats->allocs),
+        (unsigned long long)atomic_load(&stats->allocated),
+        (unsigned long long)atomic_load(&stats->live),
+        (unsigned long long)atomic_load(&stats->peak));
+}
+
+// print_mem_stats_report writes allocation counters of each tag and
+// maximum resident set size of the process to stderr
+void print_mem_stats_report() {
+    fprintf(stderr, "%-8s  %12s  %16s  %16s  %16s\n", "tag", "allocs", "allocated bytes", "live bytes", "peak bytes");
+    for (u32 i = 0; i < at_end; i++) {
+        if (atomic_load(&alloc_stats[i].allocs) == 0) {
+            continue;
+        }
+        print_alloc_stats(alloc_tag_names[i], &alloc_stats[i]);
+    }
+    print_alloc_stats("total", &total_alloc_stats);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Linux reports maximum resident set size in kilobytes
+        fprintf(stderr, "max RSS: %llu KiB\n", (unsigned long long)usage.ru_maxrss);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef KU_ALLOC_H
+#define KU_ALLOC_H
+
+#include <stdatomic.h>
+
+#include "types.h"
+
+typedef enum AllocTag AllocTag;
+typedef struct AllocHeader AllocHeader;
+typedef struct AllocStats AllocStats;
+
+// AllocTag names subsystem which owns allocated memory
+enum AllocTag {
+    at_Other,
+    at_Source,  // source texts
+    at_Scanner, // scanners and token literals
+    at_AST,     // syntax tree nodes
+    at_Map,     // map tables and buckets
+    at_String,  // strings created by str functions
+    at_Slice,   // slice element arrays
+    at_IR,      // arenas of intermediate representation
+    at_Vm,      // bytecode, interpreter stacks and strings of running program
+
+    at_end,
+};
+
+// AllocHeader is placed before each allocated block, its size keeps
+// block aligned the same way as memory returned by malloc
+struct AllocHeader {
+    u64 size;
+    u32 tag;
+
+    // true if block was allocated while stats were enabled, only such
+    // blocks are subtracted from live counters when freed
+    u32 counted;
+};
+
+// AllocStats holds counters of a single tag, updated concurrently by all threads
+struct AllocStats {
+    // number of allocations
+    _Alignas(64) atomic_uint_fast64_t allocs;
+
+    // sum of sizes of all allocations, growth of reallocated blocks included
+    atomic_uint_fast64_t allocated;
+
+    // size of currently allocated blocks
+    atomic_uint_fast64_t live;
+
+    // maximum value of live
+    atomic_uint_fast64_t peak;
+};
+
+void enable_mem_stats();
+void *alloc_mem(AllocTag tag, u64 size);
+void *alloc_zeroed_mem(AllocTag tag, u64 size);
+void *realloc_mem(AllocTag tag, void *ptr, u64 size);
+void free_mem(void *ptr);
+void print_mem_stats_report();
+
+#endif // KU_ALLOC_H
@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include "arena.h"
+#include "fatal.h"
+
+_Static_assert(sizeof(ArenaChunk) % _Alignof(max_align_t) == 0, "arena chunk header breaks alignment");
+
+// size of chunks allocated for small requests
+const u64 default_arena_chunk_cap = 1 << 16;
+
+u64 align_arena_size(u64 size) {
+    u64 mask = _Alignof(max_align_t) - 1;
+    return (size + mask) & ~mask;
+}
+
+Arena init_arena(AllocTag tag) {
+    Arena a = {
+        .chunk = nil,
+        .last  = nil,
+        .size  = 0,
+        .tag   = tag,
+    };
+    return a;
+}
+
+byte *get_chunk_bytes(ArenaChunk *chunk) {
+    return (byte *)(chunk + 1);
+}
+
+void add_arena_chunk(Arena *a, u64 size) {
+    u64 cap = default_arena_chunk_cap;
+    if (size > cap) {
+        cap = size;
+    }
+    ArenaChunk *chunk = (ArenaChunk *)alloc_mem(a->tag, sizeof(ArenaChunk) + cap);
+    if (chunk == nil) {
+        fatal(1, "not enough memory for arena chunk");
+    }
+    chunk->prev     = a->chunk;
+    chunk->cap      = cap;
+    chunk->len      = 0;
+    chunk->reserved = 0;
+    a->chunk        = chunk;
+    a->size += cap;
+}
+
+void *arena_alloc(Arena *a, u64 size) {
+    size = align_arena_size(size);
+    if (a->chunk == nil || a->chunk->cap - a->chunk->len < size) {
+        add_arena_chunk(a, size);
+    }
+    byte *p = get_chunk_bytes(a->chunk) + a->chunk->len;
+    a->chunk->len += size;
+    a->last = p;
+    return p;
+}
+
+void *arena_grow(Arena *a, void *ptr, u64 old_size, u64 new_size) {
+    if (ptr == nil) {
+        return arena_alloc(a, new_size);
+    }
+    if ((byte *)ptr == a->last) {
+        ArenaChunk *chunk = a->chunk;
+        u64 start         = (u64)(a->last - get_chunk_bytes(chunk));
+        u64 size          = align_arena_size(new_size);
+        if (chunk->cap - start >= size) {
+            chunk->len = start + size;
+            return ptr;
+        }
+    }
+    void *p = arena_alloc(a, new_size);
+    memcpy(p, ptr, old_size);
+    return p;
+}
+
+void free_arena(Arena *a) {
+    ArenaChunk *chunk = a->chunk;
+    while (chunk != nil) {
+        ArenaChunk *prev = chunk->prev;
+        free_mem(chunk);
+        chunk = prev;
+    }
+    a->chunk = nil;
+    a->last  = nil;
+    a->size  = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef KU_ARENA_H
+#define KU_ARENA_H
+
+#include "alloc.h"
+#include "types.h"
+
+typedef struct Arena Arena;
+typedef struct ArenaChunk ArenaChunk;
+
+// ArenaChunk is a block of memory which allocations of arena are cut from,
+// bytes of the block follow the header
+struct ArenaChunk {
+    // chunk which was current before this one, nil for the first chunk
+    ArenaChunk *prev;
+
+    // number of bytes available after the header
+    u64 cap;
+
+    // number of bytes already given out
+    u64 len;
+
+    // keeps bytes after the header aligned
+    u64 reserved;
+};
+
+// Arena is a bump allocator. Memory is released only all at once when arena
+// is freed, individual allocations are never freed
+struct Arena {
+    // chunk from which next allocation is cut, nil if arena is empty
+    ArenaChunk *chunk;
+
+    // latest allocation, it can grow without copying
+    byte *last;
+
+    // sum of sizes of all chunks
+    u64 size;
+
+    AllocTag tag;
+};
+
+Arena init_arena(AllocTag tag);
+
+// arena_alloc returns uninitialized memory aligned the same way as memory
+// returned by malloc
+void *arena_alloc(Arena *a, u64 size);
+
+// arena_grow returns memory of new_size bytes which starts with old_size bytes
+// of ptr. Latest allocation is extended in place when its chunk has enough
+// space, otherwise contents are copied and old memory stays unused
+void *arena_grow(Arena *a, void *ptr, u64 old_size, u64 new_size);
+
+void free_arena(Arena *a);
+
+#endif // KU_ARENA_H
@@ -53,7 +53,7 @@
 //
 // <SliceTypeLiteral> = "[" "]" <ElementTypeSpecifier>
 //
-// <MapTypeLiteral> = "[" <KeyTypeSpecifier> "]" "=>" <ValueTypeSpecifier>
+// <MapTypeLiteral> = "map" "[" <KeyTypeSpecifier> "=>" <ValueTypeSpecifier> "]"
 //
 // <KeyTypeSpecifier> = <TypeSpecifier>
 //
@@ -91,25 +91,53 @@
 //
 // <DefineStatement> = [ "imt" ], <Identifier>, { ",", <Identifier> }, ":=", <Expression>, { ",", <Expression> }, ";";
 //
+// <LoopStatement> = "loop", [ <Expression> ], <BlockStatement> | "while", <Expression>, <BlockStatement>;
+//
+// <Expression> = <UnaryExpression> | <Expression>, <BinaryOperator>, <Expression>;
+//
+// <UnaryExpression> = <PrimaryExpression> | <UnaryOperator>, <UnaryExpression>;
+//
+// <PrimaryExpression> = <Identifier> | <CallExpression> | <Literal> | "(", <Expression>, ")";
+//
+// <UnaryOperator> = "+" | "-" | "!" | "^";
+//
+// <BinaryOperator> = "||" | "&&" | <CompareOperator> | <AddOperator> | <MultiplyOperator>;
+//
+// Binary operators bind in the order of listing above from weakest to strongest,
+// operators of equal precedence are left associative
+//
+// <CompareOperator> = "==" | "!=" | "<" | "<=" | ">" | ">=";
+//
+// <AddOperator> = "+" | "-" | "|" | "^";
+//
+// <MultiplyOperator> = "*" | "/" | "%" | "<<" | ">>" | "&" | "&^";
+//
 // <SelectorExpression> = <Expression>, ".", <Identifier>
 //
 // <CallExpression> = <Expression>, "(", { <Expression>, "," }, ")";
 //
 // <DestinationExpression> = <IndexExpression> | <Identifier>
 //
-// <AssignStatement> = <DestinationExpression>, { ",", <DestinationExpression> }, "=", <Expression>, { ",",
-//                     <Expression> }, ";";
+// <AssignStatement> = <DestinationExpression>, { ",", <DestinationExpression> }, <AssignOperator>, <Expression>,
+//                     { ",", <Expression> }, ";";
 //
-// <ReturnStatement> = "return", [ <Expression> ], ";";
+// <AssignOperator> = "=" | "+=" | "-=" | "*=" | "/=" | "%=";
+//
+// <ReturnStatement> = "return", [ <Expression>, { ",", <Expression> } ], ";";
 
 const Identifier empty_identifier = {
-    .token = empty_token,
+    .token  = empty_token,
+    .symbol = nil,
 };
 
 const TypeSpecifier empty_type_specifier = {
     .ptr = nil,
 };
 
+const Expression empty_expression = {
+    .ptr = nil,
+};
+
 const FunctionResult void_result = {
     .type = frt_Void,
     .ptr  = nil,
@@ -133,7 +161,8 @@ const u8 display_indentation = 2;
 
 Identifier init_identifier(Token token) {
     Identifier identifier = {
-        .token = token,
+        .token  = token,
+        .symbol = nil,
     };
     return identifier;
 }
@@ -147,7 +176,7 @@ Statement init_empty_statement() {
 }
 
 Statement init_define_statement(slice_of_Expressions left, slice_of_Expressions right) {
-    DefineStatement *dstmt = (DefineStatement *)malloc(sizeof(DefineStatement));
+    DefineStatement *dstmt = (DefineStatement *)alloc_mem(at_AST, sizeof(DefineStatement));
     if (dstmt == nil) {
         fatal(1, "not enough memory for new define statement");
     }
@@ -162,7 +191,7 @@ Statement init_define_statement(slice_of_Expressions left, slice_of_Expressions
 }
 
 Statement init_expression_statement(Expression expr) {
-    Expression *new_expr = (Expression *)malloc(sizeof(Expression));
+    Expression *new_expr = (Expression *)alloc_mem(at_AST, sizeof(Expression));
     if (new_expr == nil) {
         fatal(1, "not enough memory for new define statement");
     }
@@ -175,12 +204,74 @@ Statement init_expression_statement(Expression expr) {
     return stmt;
 }
 
+Statement init_assign_statement(Token operator, slice_of_Expressions left, slice_of_Expressions right) {
+    AssignStatement *astmt = xnew(at_AST, AssignStatement);
+    astmt->operator        = operator;
+    astmt->left            = left;
+    astmt->right           = right;
+
+    Statement stmt = {
+        .type = st_Assign,
+        .ptr  = astmt,
+    };
+    return stmt;
+}
+
+Statement init_return_statement(Token token, slice_of_Expressions values) {
+    ReturnStatement *rstmt = xnew(at_AST, ReturnStatement);
+    rstmt->token           = token;
+    rstmt->values          = values;
+
+    Statement stmt = {
+        .type = st_Return,
+        .ptr  = rstmt,
+    };
+    return stmt;
+}
+
+Statement init_if_statement(slice_of_IfClauses clauses, BlockStatement *else_body) {
+    IfStatement *istmt = xnew(at_AST, IfStatement);
+    istmt->clauses     = clauses;
+    istmt->else_body   = else_body;
+
+    Statement stmt = {
+        .type = st_If,
+        .ptr  = istmt,
+    };
+    return stmt;
+}
+
+Statement init_loop_statement(Token token, Expression count, BlockStatement body) {
+    LoopStatement *lstmt = xnew(at_AST, LoopStatement);
+    lstmt->token         = token;
+    lstmt->count         = count;
+    lstmt->body          = body;
+
+    Statement stmt = {
+        .type = st_Loop,
+        .ptr  = lstmt,
+    };
+    return stmt;
+}
+
+Statement init_while_statement(Expression condition, BlockStatement body) {
+    WhileStatement *wstmt = xnew(at_AST, WhileStatement);
+    wstmt->condition      = condition;
+    wstmt->body           = body;
+
+    Statement stmt = {
+        .type = st_While,
+        .ptr  = wstmt,
+    };
+    return stmt;
+}
+
 Expression init_identifier_expression(Token token) {
-    Identifier *ident = (Identifier *)malloc(sizeof(Identifier));
+    Identifier *ident = (Identifier *)alloc_mem(at_AST, sizeof(Identifier));
     if (ident == nil) {
         fatal(1, "not enough memory for new identifier expression");
     }
-    ident->token = token;
+    *ident = init_identifier(token);
 
     Expression expr = {
         .type = et_Identifier,
@@ -190,7 +281,7 @@ Expression init_identifier_expression(Token token) {
 }
 
 Expression init_integer_expression(Token token) {
-    Integer *literal = (Integer *)malloc(sizeof(Integer));
+    Integer *literal = (Integer *)alloc_mem(at_AST, sizeof(Integer));
     if (literal == nil) {
         fatal(1, "not enough memory for new integer literal expression");
     }
@@ -204,7 +295,7 @@ Expression init_integer_expression(Token token) {
 }
 
 Expression init_string_expression(Token token) {
-    String *literal = (String *)malloc(sizeof(String));
+    String *literal = (String *)alloc_mem(at_AST, sizeof(String));
     if (literal == nil) {
         fatal(1, "not enough memory for new string literal expression");
     }
@@ -217,13 +308,49 @@ Expression init_string_expression(Token token) {
     return expr;
 }
 
+Expression init_float_expression(Token token) {
+    Float *literal = xnew(at_AST, Float);
+    literal->token = token;
+
+    Expression expr = {
+        .type = et_FloatLiteral,
+        .ptr  = literal,
+    };
+    return expr;
+}
+
+Expression init_unary_expression(Token operator, Expression operand) {
+    UnaryExpression *unary = xnew(at_AST, UnaryExpression);
+    unary->operator        = operator;
+    unary->operand         = operand;
+
+    Expression expr = {
+        .type = et_Unary,
+        .ptr  = unary,
+    };
+    return expr;
+}
+
+Expression init_binary_expression(Token operator, Expression left, Expression right) {
+    BinaryExpression *binary = xnew(at_AST, BinaryExpression);
+    binary->operator         = operator;
+    binary->left             = left;
+    binary->right            = right;
+
+    Expression expr = {
+        .type = et_Binary,
+        .ptr  = binary,
+    };
+    return expr;
+}
+
 Expression init_call_expression(Token name_token, slice_of_Expressions args) {
-    CallExpression *call_expression = (CallExpression *)malloc(sizeof(CallExpression));
+    CallExpression *call_expression = (CallExpression *)alloc_mem(at_AST, sizeof(CallExpression));
     if (call_expression == nil) {
         fatal(1, "not enough memory for new call expression");
     }
-    call_expression->function_name = take_str_from_str(&name_token.literal);
-    call_expression->args          = args;
+    call_expression->name = init_identifier(name_token);
+    call_expression->args = args;
 
     Expression expr = {
         .type = et_Call,
@@ -233,7 +360,7 @@ Expression init_call_expression(Token name_token, slice_of_Expressions args) {
 }
 
 TypeSpecifier new_name_type_specifier(Token token) {
-    TypeName *type_name = (TypeName *)malloc(sizeof(TypeName));
+    TypeName *type_name = (TypeName *)alloc_mem(at_AST, sizeof(TypeName));
     if (type_name == nil) {
         fatal(1, "not enough memory for new call expression");
     }
@@ -247,7 +374,7 @@ TypeSpecifier new_name_type_specifier(Token token) {
 }
 
 FunctionResult new_simple_result(TypeSpecifier type_specifier) {
-    SimpleResult *simple_result = (SimpleResult *)malloc(sizeof(SimpleResult));
+    SimpleResult *simple_result = (SimpleResult *)alloc_mem(at_AST, sizeof(SimpleResult));
     if (simple_result == nil) {
         fatal(1, "not enough memory for new simple result");
     }
@@ -260,7 +387,7 @@ FunctionResult new_simple_result(TypeSpecifier type_specifier) {
 }
 
 FunctionResult new_typed_tuple_result(slice_of_ParameterDeclarations params) {
-    TypedTupleResult *tuple_result       = xnew(TypedTupleResult);
+    TypedTupleResult *tuple_result       = xnew(at_AST, TypedTupleResult);
     tuple_result->parameter_declarations = params;
     FunctionResult function_result       = {
               .type = frt_TypedTuple,
@@ -270,7 +397,7 @@ FunctionResult new_typed_tuple_result(slice_of_ParameterDeclarations params) {
 }
 
 FunctionResult new_tuple_signature_result_from_identifiers(slice_of_Identifiers names) {
-    TupleSignatureResult *tuple_signature_result = xnew(TupleSignatureResult);
+    TupleSignatureResult *tuple_signature_result = xnew(at_AST, TupleSignatureResult);
     tuple_signature_result->type_specifiers      = empty_slice_of_TypeSpecifiers;
     for (u32 i = 0; i < names.len; i++) {
         append_TypeSpecifier_to_slice(
@@ -284,7 +411,7 @@ FunctionResult new_tuple_signature_result_from_identifiers(slice_of_Identifiers
 }
 
 FunctionResult new_tuple_signature_result(slice_of_TypeSpecifiers type_specifiers) {
-    TupleSignatureResult *tuple_signature_result = xnew(TupleSignatureResult);
+    TupleSignatureResult *tuple_signature_result = xnew(at_AST, TupleSignatureResult);
     tuple_signature_result->type_specifiers      = type_specifiers;
     FunctionResult function_result               = {
                       .type = frt_TupleSignature,
@@ -294,9 +421,9 @@ FunctionResult new_tuple_signature_result(slice_of_TypeSpecifiers type_specifier
 }
 
 TypeSpecifier new_slice_type_specifier(TypeSpecifier element_type_specifier) {
-    SliceTypeLiteral *slice_type_literal = xnew(SliceTypeLiteral);
+    SliceTypeLiteral *slice_type_literal = xnew(at_AST, SliceTypeLiteral);
     slice_type_literal->element_type     = element_type_specifier;
-    TypeLiteral *type_literal            = xnew(TypeLiteral);
+    TypeLiteral *type_literal            = xnew(at_AST, TypeLiteral);
     type_literal->type                   = tlt_Slice;
     type_literal->ptr                    = slice_type_literal;
     TypeSpecifier type_specifier         = {
@@ -306,6 +433,20 @@ TypeSpecifier new_slice_type_specifier(TypeSpecifier element_type_specifier) {
     return type_specifier;
 }
 
+TypeSpecifier new_map_type_specifier(TypeSpecifier key_type_specifier, TypeSpecifier value_type_specifier) {
+    MapTypeLiteral *map_type_literal = xnew(at_AST, MapTypeLiteral);
+    map_type_literal->key_type       = key_type_specifier;
+    map_type_literal->value_type     = value_type_specifier;
+    TypeLiteral *type_literal        = xnew(at_AST, TypeLiteral);
+    type_literal->type               = tlt_Map;
+    type_literal->ptr                = map_type_literal;
+    TypeSpecifier type_specifier     = {
+            .type = tst_Literal,
+            .ptr  = type_literal,
+    };
+    return type_specifier;
+}
+
 slice_of_TypeSpecifiers new_type_specifiers_from_identifiers(slice_of_Identifiers names) {
     slice_of_TypeSpecifiers type_specifiers = empty_slice_of_TypeSpecifiers;
     for (u32 i = 0; i < names.len; i++) {
@@ -314,16 +455,209 @@ slice_of_TypeSpecifiers new_type_specifiers_from_identifiers(slice_of_Identifier
     return type_specifiers;
 }
 
-void print_type_name(TypeName type_name) {
-    print_indent_str(1, type_name.name.token.literal);
+void shift_token_line(Token *token, i32 delta) {
+    token->pos.line = (u32)((i32)token->pos.line + delta);
+}
+
+void shift_type_specifier_lines(TypeSpecifier type_specifier, i32 delta);
+
+void shift_type_literal_lines(TypeLiteral *type_literal, i32 delta) {
+    switch (type_literal->type) {
+    case tlt_Slice:
+        shift_type_specifier_lines(((SliceTypeLiteral *)type_literal->ptr)->element_type, delta);
+        break;
+    case tlt_Map: {
+        MapTypeLiteral *map_type_literal = (MapTypeLiteral *)type_literal->ptr;
+        shift_type_specifier_lines(map_type_literal->key_type, delta);
+        shift_type_specifier_lines(map_type_literal->value_type, delta);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void shift_type_specifier_lines(TypeSpecifier type_specifier, i32 delta) {
+    switch (type_specifier.type) {
+    case tst_Name:
+        shift_token_line(&((TypeName *)type_specifier.ptr)->name.token, delta);
+        break;
+    case tst_QualifiedName: {
+        TypeName *type_name = (TypeName *)type_specifier.ptr;
+        shift_token_line(&type_name->name.token, delta);
+        shift_token_line(&type_name->module_name.token, delta);
+        break;
+    }
+    case tst_Literal:
+        shift_type_literal_lines((TypeLiteral *)type_specifier.ptr, delta);
+        break;
+    default:
+        break;
+    }
+}
+
+void shift_parameter_declarations_lines(slice_of_ParameterDeclarations decls, i32 delta) {
+    for (u32 i = 0; i < decls.len; i++) {
+        ParameterDeclaration *decl = &decls.elem[i];
+        for (u32 j = 0; j < decl->names.len; j++) {
+            shift_token_line(&decl->names.elem[j].token, delta);
+        }
+        shift_type_specifier_lines(decl->type_specifier, delta);
+    }
+}
+
+void shift_function_result_lines(FunctionResult result, i32 delta) {
+    switch (result.type) {
+    case frt_Simple:
+        shift_type_specifier_lines(((SimpleResult *)result.ptr)->type_specifier, delta);
+        break;
+    case frt_TupleSignature: {
+        slice_of_TypeSpecifiers type_specifiers = ((TupleSignatureResult *)result.ptr)->type_specifiers;
+        for (u32 i = 0; i < type_specifiers.len; i++) {
+            shift_type_specifier_lines(type_specifiers.elem[i], delta);
+        }
+        break;
+    }
+    case frt_TypedTuple:
+        shift_parameter_declarations_lines(((TypedTupleResult *)result.ptr)->parameter_declarations, delta);
+        break;
+    default:
+        break;
+    }
+}
+
+void shift_expression_lines(Expression expr, i32 delta);
+
+void shift_expressions_lines(slice_of_Expressions exprs, i32 delta) {
+    for (u32 i = 0; i < exprs.len; i++) {
+        shift_expression_lines(exprs.elem[i], delta);
+    }
+}
+
+void shift_expression_lines(Expression expr, i32 delta) {
+    switch (expr.type) {
+    case et_Identifier:
+        shift_token_line(&((Identifier *)expr.ptr)->token, delta);
+        break;
+    case et_IntegerLiteral:
+        shift_token_line(&((Integer *)expr.ptr)->token, delta);
+        break;
+    case et_FloatLiteral:
+        shift_token_line(&((Float *)expr.ptr)->token, delta);
+        break;
+    case et_StringLiteral:
+        shift_token_line(&((String *)expr.ptr)->token, delta);
+        break;
+    case et_Unary: {
+        UnaryExpression *unary = (UnaryExpression *)expr.ptr;
+        shift_token_line(&unary->operator, delta);
+        shift_expression_lines(unary->operand, delta);
+        break;
+    }
+    case et_Binary: {
+        BinaryExpression *binary = (BinaryExpression *)expr.ptr;
+        shift_token_line(&binary->operator, delta);
+        shift_expression_lines(binary->left, delta);
+        shift_expression_lines(binary->right, delta);
+        break;
+    }
+    case et_Call: {
+        CallExpression *call = (CallExpression *)expr.ptr;
+        shift_token_line(&call->name.token, delta);
+        shift_expressions_lines(call->args, delta);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void shift_statement_lines(Statement stmt, i32 delta);
+
+void shift_block_lines(BlockStatement block, i32 delta) {
+    for (u32 i = 0; i < block.statements.len; i++) {
+        shift_statement_lines(block.statements.elem[i], delta);
+    }
+}
+
+void shift_statement_lines(Statement stmt, i32 delta) {
+    switch (stmt.type) {
+    case st_Define: {
+        DefineStatement *dstmt = (DefineStatement *)stmt.ptr;
+        shift_expressions_lines(dstmt->left, delta);
+        shift_expressions_lines(dstmt->right, delta);
+        break;
+    }
+    case st_Assign: {
+        AssignStatement *astmt = (AssignStatement *)stmt.ptr;
+        shift_token_line(&astmt->operator, delta);
+        shift_expressions_lines(astmt->left, delta);
+        shift_expressions_lines(astmt->right, delta);
+        break;
+    }
+    case st_Expression:
+        shift_expression_lines(*(Expression *)stmt.ptr, delta);
+        break;
+    case st_Return: {
+        ReturnStatement *rstmt = (ReturnStatement *)stmt.ptr;
+        shift_token_line(&rstmt->token, delta);
+        shift_expressions_lines(rstmt->values, delta);
+        break;
+    }
+    case st_If: {
+        IfStatement *istmt = (IfStatement *)stmt.ptr;
+        for (u32 i = 0; i < istmt->clauses.len; i++) {
+            shift_expression_lines(istmt->clauses.elem[i].condition, delta);
+            shift_block_lines(istmt->clauses.elem[i].body, delta);
+        }
+        if (istmt->else_body != nil) {
+            shift_block_lines(*istmt->else_body, delta);
+        }
+        break;
+    }
+    case st_Loop: {
+        LoopStatement *lstmt = (LoopStatement *)stmt.ptr;
+        shift_token_line(&lstmt->token, delta);
+        if (lstmt->count.ptr != nil) {
+            shift_expression_lines(lstmt->count, delta);
+        }
+        shift_block_lines(lstmt->body, delta);
+        break;
+    }
+    case st_While: {
+        WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+        shift_expression_lines(wstmt->condition, delta);
+        shift_block_lines(wstmt->body, delta);
+        break;
+    }
+    case st_Block:
+        shift_block_lines(*(BlockStatement *)stmt.ptr, delta);
+        break;
+    default:
+        break;
+    }
+}
+
+// shift_function_definition_lines moves all token positions stored inside
+// function definition by delta lines
+void shift_function_definition_lines(FunctionDefinition *def, i32 delta) {
+    shift_token_line(&def->declaration.name.token, delta);
+    shift_parameter_declarations_lines(def->declaration.parameters.parameter_declarations, delta);
+    shift_function_result_lines(def->declaration.result, delta);
+    shift_block_lines(def->body, delta);
+}
+
+void print_type_name(OutputBuffer *out, TypeName type_name) {
+    write_indent_str_to_output(out, 1, type_name.name.token.literal);
 }
 
-void print_type_qualified_name(TypeName type_name) {
-    print_indent_str(1, type_name.name.token.literal);
-    print_str(type_name.module_name.token.literal);
+void print_type_qualified_name(OutputBuffer *out, TypeName type_name) {
+    write_indent_str_to_output(out, 1, type_name.name.token.literal);
+    write_str_to_output(out, type_name.module_name.token.literal);
 }
 
-void print_type_literal(TypeLiteral type_literal) {
+void print_type_literal(OutputBuffer *out, TypeLiteral type_literal) {
+    (void)out;
     switch (type_literal.type) {
     case tlt_Slice:
         break;
@@ -332,67 +666,67 @@ void print_type_literal(TypeLiteral type_literal) {
     }
 }
 
-void print_type_specifier(TypeSpecifier type_specifier) {
+void print_type_specifier(OutputBuffer *out, TypeSpecifier type_specifier) {
     switch (type_specifier.type) {
     case tst_Name:
-        print_type_name(*(TypeName *)type_specifier.ptr);
+        print_type_name(out, *(TypeName *)type_specifier.ptr);
         break;
     case tst_QualifiedName:
-        print_type_name(*(TypeName *)type_specifier.ptr);
+        print_type_name(out, *(TypeName *)type_specifier.ptr);
         break;
     case tst_Literal:
-        print_type_literal(*(TypeLiteral *)type_specifier.ptr);
+        print_type_literal(out, *(TypeLiteral *)type_specifier.ptr);
         break;
     default:
         break;
     }
 }
 
-void print_parameter_declaration(u8 spaces, ParameterDeclaration decl) {
+void print_parameter_declaration(OutputBuffer *out, u8 spaces, ParameterDeclaration decl) {
     u8 indent = (u8)(spaces + display_indentation);
     for (u32 i = 0; i < decl.names.len; i++) {
-        print_indent_str(indent, decl.names.elem[i].token.literal);
-        print_type_specifier(decl.type_specifier);
-        println();
+        write_indent_str_to_output(out, indent, decl.names.elem[i].token.literal);
+        print_type_specifier(out, decl.type_specifier);
+        write_byte_to_output(out, '\n');
     }
 }
 
-void print_function_parameters(FunctionParameters params) {
-    print_indent_str(display_indentation, params_display_title);
+void print_function_parameters(OutputBuffer *out, FunctionParameters params) {
+    write_indent_str_to_output(out, display_indentation, params_display_title);
     if (params.parameter_declarations.len == 0) {
-        print_str(void_display_title);
+        write_str_to_output(out, void_display_title);
     } else {
-        println();
+        write_byte_to_output(out, '\n');
         for (u32 i = 0; i < params.parameter_declarations.len; i++) {
-            print_parameter_declaration(display_indentation, params.parameter_declarations.elem[i]);
+            print_parameter_declaration(out, display_indentation, params.parameter_declarations.elem[i]);
         }
     }
-    println();
+    write_byte_to_output(out, '\n');
 }
 
-void print_function_result(FunctionResult result) {
-    print_indent_str(display_indentation, result_display_title);
+void print_function_result(OutputBuffer *out, FunctionResult result) {
+    write_indent_str_to_output(out, display_indentation, result_display_title);
     if (result.type == frt_Void) {
-        print_str(void_display_title);
+        write_str_to_output(out, void_display_title);
     }
-    println();
+    write_byte_to_output(out, '\n');
 }
 
-void print_function_name(Identifier name) {
-    print_str(function_display_title);
-    println_str(name.token.literal);
+void print_function_name(OutputBuffer *out, Identifier name) {
+    write_str_to_output(out, function_display_title);
+    write_line_str_to_output(out, name.token.literal);
 }
 
-void print_function_definition(FunctionDefinition def) {
-    print_function_name(def.declaration.name);
-    print_function_parameters(def.declaration.parameters);
-    print_function_result(def.declaration.result);
-    println();
+void print_function_definition(OutputBuffer *out, FunctionDefinition def) {
+    print_function_name(out, def.declaration.name);
+    print_function_parameters(out, def.declaration.parameters);
+    print_function_result(out, def.declaration.result);
+    write_byte_to_output(out, '\n');
 }
 
-void print_standalone_source_tree(StandaloneSourceTree tree) {
+void print_standalone_source_tree(OutputBuffer *out, StandaloneSourceTree tree) {
     for (u32 i = 0; i < tree.functions.len; i++) {
-        print_function_definition(tree.functions.elem[i]);
+        print_function_definition(out, tree.functions.elem[i]);
     }
 }
 
@@ -403,3 +737,4 @@ IMPLEMENT_SLICE(Identifier)
 IMPLEMENT_SLICE(TypeSpecifier)
 IMPLEMENT_SLICE(ParameterDeclaration)
 IMPLEMENT_SLICE(FunctionDefinition)
+IMPLEMENT_SLICE(IfClause)
@@ -4,6 +4,7 @@
 #include "slice.h"
 #include "str.h"
 #include "token.h"
+#include "type_table.h"
 #include "types.h"
 
 typedef enum FunctionResultType FunctionResultType;
@@ -11,18 +12,29 @@ typedef enum StatementType StatementType;
 typedef enum ExpressionType ExpressionType;
 typedef enum TypeSpecifierType TypeSpecifierType;
 typedef enum TypeLiteralType TypeLiteralType;
+typedef enum ConstantKind ConstantKind;
 
 typedef struct StandaloneSourceTree StandaloneSourceTree;
 typedef struct Statement Statement;
 typedef struct DefineStatement DefineStatement;
+typedef struct AssignStatement AssignStatement;
+typedef struct ReturnStatement ReturnStatement;
+typedef struct IfClause IfClause;
+typedef struct IfStatement IfStatement;
+typedef struct LoopStatement LoopStatement;
+typedef struct WhileStatement WhileStatement;
 typedef struct Expression Expression;
 typedef struct CallExpression CallExpression;
+typedef struct UnaryExpression UnaryExpression;
+typedef struct BinaryExpression BinaryExpression;
+typedef struct Constant Constant;
 typedef struct FunctionDeclaration FunctionDeclaration;
 typedef struct FunctionDefinition FunctionDefinition;
 typedef struct SimpleResult SimpleResult;
 typedef struct TupleSignatureResult TupleSignatureResult;
 typedef struct TypedTupleResult TypedTupleResult;
 typedef struct SliceTypeLiteral SliceTypeLiteral;
+typedef struct MapTypeLiteral MapTypeLiteral;
 typedef struct TypeLiteral TypeLiteral;
 typedef struct FunctionResult FunctionResult;
 typedef struct FunctionParameters FunctionParameters;
@@ -33,8 +45,12 @@ typedef struct BlockStatement BlockStatement;
 typedef struct CallArgument CallArgument;
 typedef struct Identifier Identifier;
 typedef struct Integer Integer;
+typedef struct Float Float;
 typedef struct String String;
 
+// defined by name resolution pass in resolve.h
+typedef struct Symbol Symbol;
+
 TYPEDEF_SLICE(Identifier)
 TYPEDEF_SLICE(ParameterDeclaration)
 TYPEDEF_SLICE(TypeSpecifier)
@@ -42,6 +58,7 @@ TYPEDEF_SLICE(Statement)
 TYPEDEF_SLICE(Expression)
 TYPEDEF_SLICE(CallArgument)
 TYPEDEF_SLICE(FunctionDefinition)
+TYPEDEF_SLICE(IfClause)
 
 // FunctionResultType determines type of struct behind pointer in FunctionResult struct
 enum FunctionResultType {
@@ -79,13 +96,28 @@ enum StatementType {
     st_Return,
     st_StructDeclaration,
     st_TypeDeclaration,
+    st_If,
+    st_Loop,
+    st_While,
 };
 
 enum ExpressionType {
     et_Identifier,
     et_Call,
     et_IntegerLiteral,
+    et_FloatLiteral,
     et_StringLiteral,
+    et_Unary,
+    et_Binary,
+};
+
+enum ConstantKind {
+    // expression value is not known at compile time or was not evaluated
+    ck_None,
+
+    ck_Integer,
+    ck_Float,
+    ck_Bool,
 };
 
 // TypeSpecifierType determines type of struct behind pointer in TypeSpecifier struct
@@ -113,11 +145,30 @@ enum TypeLiteralType {
 
 struct Identifier {
     Token token;
+
+    // declaration this identifier refers to or declares, nil until
+    // name resolution pass binds it
+    Symbol *symbol;
+};
+
+// Constant is value of expression evaluated at compile time. Integers are
+// stored as 64-bit patterns, values of signed types are sign-extended and
+// values of unsigned types are zero-extended from their width. Bool is
+// stored in integer as 0 or 1
+struct Constant {
+    ConstantKind kind;
+    TokenValue value;
 };
 
 struct Expression {
     ExpressionType type;
     void *ptr;
+
+    // ti_Invalid until type checker assigns type to expression
+    TypeId type_id;
+
+    // value cached by constant folding pass
+    Constant constant;
 };
 
 struct TypeSpecifier {
@@ -177,6 +228,10 @@ struct TypedTupleResult {
 struct FunctionResult {
     FunctionResultType type;
     void *ptr;
+
+    // ti_Invalid until type checker assigns type to result, tuple for
+    // several values
+    TypeId type_id;
 };
 
 struct FunctionDeclaration {
@@ -192,6 +247,9 @@ struct BlockStatement {
 struct FunctionDefinition {
     FunctionDeclaration declaration;
     BlockStatement body;
+
+    // number of local symbols declared in function, set by name resolution
+    u32 locals;
 };
 
 struct Statement {
@@ -203,19 +261,77 @@ struct DefineStatement {
     slice_of_Expressions left, right;
 };
 
+// AssignStatement stores values into existing variables, operator is "=" or
+// one of compound assignments, e.g. "+="
+struct AssignStatement {
+    Token operator;
+    slice_of_Expressions left, right;
+};
+
+struct ReturnStatement {
+    Token token;
+
+    // empty for bare return
+    slice_of_Expressions values;
+};
+
+struct IfClause {
+    Expression condition;
+    BlockStatement body;
+};
+
+struct IfStatement {
+    // "if" clause followed by "elif" clauses in order of appearance
+    slice_of_IfClauses clauses;
+
+    // nil if there is no "else" clause
+    BlockStatement *else_body;
+};
+
+// LoopStatement executes body count times, loop without count repeats
+// forever
+struct LoopStatement {
+    Token token;
+
+    // ptr is nil if loop has no count
+    Expression count;
+
+    BlockStatement body;
+};
+
+struct WhileStatement {
+    Expression condition;
+    BlockStatement body;
+};
+
 struct Integer {
     Token token;
 };
 
+struct Float {
+    Token token;
+};
+
 struct String {
     Token token;
 };
 
 struct CallExpression {
-    str function_name;
+    Identifier name;
     slice_of_Expressions args;
 };
 
+struct UnaryExpression {
+    Token operator;
+    Expression operand;
+};
+
+struct BinaryExpression {
+    Token operator;
+    Expression left;
+    Expression right;
+};
+
 struct CallArgument {
     Expression expression;
 };
@@ -227,6 +343,7 @@ struct StandaloneSourceTree {
 
 extern const Identifier empty_identifier;
 extern const TypeSpecifier empty_type_specifier;
+extern const Expression empty_expression;
 extern const FunctionResult void_result;
 extern const BlockStatement empty_block_statement;
 extern const StandaloneSourceTree empty_standalone_source_tree;
@@ -237,11 +354,19 @@ slice_of_TypeSpecifiers new_type_specifiers_from_identifiers(slice_of_Identifier
 Statement init_empty_statement();
 Statement init_define_statement(slice_of_Expressions left, slice_of_Expressions right);
 Statement init_expression_statement(Expression expr);
+Statement init_assign_statement(Token operator, slice_of_Expressions left, slice_of_Expressions right);
+Statement init_return_statement(Token token, slice_of_Expressions values);
+Statement init_if_statement(slice_of_IfClauses clauses, BlockStatement *else_body);
+Statement init_loop_statement(Token token, Expression count, BlockStatement body);
+Statement init_while_statement(Expression condition, BlockStatement body);
 
 Expression init_identifier_expression(Token token);
 Expression init_integer_expression(Token token);
 Expression init_call_expression(Token name_token, slice_of_Expressions args);
 Expression init_string_expression(Token token);
+Expression init_float_expression(Token token);
+Expression init_unary_expression(Token operator, Expression operand);
+Expression init_binary_expression(Token operator, Expression left, Expression right);
 
 TypeSpecifier new_name_type_specifier(Token token);
 FunctionResult new_simple_result(TypeSpecifier type_specifier);
@@ -249,7 +374,9 @@ FunctionResult new_typed_tuple_result(slice_of_ParameterDeclarations params);
 FunctionResult new_tuple_signature_result_from_identifiers(slice_of_Identifiers names);
 FunctionResult new_tuple_signature_result(slice_of_TypeSpecifiers type_specifiers);
 TypeSpecifier new_slice_type_specifier(TypeSpecifier element_type_specifier);
+TypeSpecifier new_map_type_specifier(TypeSpecifier key_type_specifier, TypeSpecifier value_type_specifier);
 
-void print_standalone_source_tree(StandaloneSourceTree tree);
+void shift_function_definition_lines(FunctionDefinition *def, i32 delta);
+void print_standalone_source_tree(OutputBuffer *out, StandaloneSourceTree tree);
 
 #endif // KU_AST_H
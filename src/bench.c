@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "corpus.h"
+#include "fatal.h"
+#include "parser.h"
+#include "source.h"
+#include "timer.h"
+
+typedef struct BenchOptions BenchOptions;
+typedef struct BenchInput BenchInput;
+typedef struct BenchResult BenchResult;
+
+typedef u64 (*BenchFunc)(BenchInput *input);
+
+struct BenchOptions {
+    // approximate size of generated program in bytes
+    u64 size;
+
+    u32 warmup;
+    u32 repetitions;
+
+    // run only one shape if true
+    bool single_shape;
+    CorpusShape shape;
+
+    // path of JSON results file, empty if results are not saved
+    str json_path;
+};
+
+struct BenchInput {
+    str text;
+
+    // generated program is also saved to this file to measure source loading
+    char *path;
+};
+
+struct BenchResult {
+    const char *shape;
+    const char *name;
+
+    u64 bytes;
+    u64 tokens;
+
+    u64 min_ns;
+    u64 median_ns;
+    u64 p99_ns;
+};
+
+const u64 default_bench_size        = 1 << 20;
+const u32 default_bench_warmup      = 3;
+const u32 default_bench_repetitions = 15;
+const u64 bench_corpus_seed         = 0x2545f4914f6cdd1dULL;
+
+const str size_flag_prefix   = STR("--size=");
+const str warmup_flag_prefix = STR("--warmup=");
+const str reps_flag_prefix   = STR("--reps=");
+const str shape_flag_prefix  = STR("--shape=");
+const str json_flag_prefix   = STR("--json=");
+
+// bench_load reads generated program from file
+u64 bench_load(BenchInput *input) {
+    SourceReadResult result = read_source_from_file(input->path);
+    if (result.erc != srec_NotAnError) {
+        fatal(1, "failed to read benchmark corpus file");
+    }
+    free_source(result.source);
+    return 0;
+}
+
+// bench_scan splits generated program into tokens
+u64 bench_scan(BenchInput *input) {
+    Scanner scanner = init_scanner_from_str(input->text);
+    u64 tokens      = 0;
+    Token token;
+    do {
+        token = scan_token(&scanner);
+        free_token(token);
+        tokens++;
+    } while (token.type != tt_EOF);
+    return tokens;
+}
+
+// bench_parse builds syntax tree of generated program. Tree nodes cannot be
+// freed yet, so memory usage grows with each repetition
+u64 bench_parse(BenchInput *input) {
+    StandaloneParseResult result = parse_standalone_source_from_str(input->text);
+    free_slice_of_FunctionDefinitions(result.tree.functions);
+    return result.tokens;
+}
+
+int compare_u64s(const void *a, const void *b) {
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+    if (x == y) {
+        return 0;
+    }
+    return x < y ? -1 : 1;
+}
+
+BenchResult run_bench(BenchOptions options, BenchInput *input, const char *shape, const char *name, BenchFunc func) {
+    u64 tokens = 0;
+    for (u32 i = 0; i < options.warmup; i++) {
+        tokens = func(input);
+    }
+
+    u64 *samples = (u64 *)alloc_mem(at_Other, options.repetitions * sizeof(u64));
+    if (samples == nil) {
+        fatal(1, "not enough memory for benchmark samples");
+    }
+    for (u32 i = 0; i < options.repetitions; i++) {
+        u64 start  = get_wall_time_ns();
+        tokens     = func(input);
+        samples[i] = get_wall_time_ns() - start;
+    }
+    qsort(samples, options.repetitions, sizeof(u64), compare_u64s);
+
+    // nearest rank percentile
+    u32 p99_rank = (options.repetitions * 99 + 99) / 100;
+
+    BenchResult result = {
+        .shape     = shape,
+        .name      = name,
+        .bytes     = input->text.len,
+        .tokens    = tokens,
+        .min_ns    = samples[0],
+        .median_ns = samples[options.repetitions / 2],
+        .p99_ns    = samples[p99_rank - 1],
+    };
+    free_mem(samples);
+    return result;
+}
+
+double get_rate(u64 amount, u64 ns) {
+    if (ns == 0) {
+        return 0;
+    }
+    return (double)amount / ((double)ns / 1e9) / 1e6;
+}
+
+void print_bench_result(BenchResult r) {
+    printf("%-16s  %-6s  %10.3f  %10.3f  %10.3f  %10.2f",
+        r.shape,
+        r.name,
+        (double)r.min_ns / 1e6,
+        (double)r.median_ns / 1e6,
+        (double)r.p99_ns / 1e6,
+        get_rate(r.bytes, r.median_ns));
+    if (r.tokens != 0) {
+        printf("  %10.2f\n", get_rate(r.tokens, r.median_ns));
+    } else {
+        printf("  %10s\n", "-");
+    }
+}
+
+void write_bench_json(BenchOptions options, BenchResult *results, u32 len) {
+    char *path = str_to_cstr(options.json_path);
+    FILE *file = fopen(path, "w");
+    if (file == nil) {
+        fprintf(stderr, "error writing results file: %s\n", path);
+        exit(1);
+    }
+
+    fprintf(file,
+        "{\n  \"size\": %llu,\n  \"warmup\": %u,\n  \"repetitions\": %u,\n  \"results\": [",
+        (unsigned long long)options.size,
+        options.warmup,
+        options.repetitions);
+    for (u32 i = 0; i < len; i++) {
+        BenchResult r = results[i];
+        fprintf(file,
+            "%s\n    {\"shape\": \"%s\", \"benchmark\": \"%s\", \"bytes\": %llu, \"tokens\": %llu, "
+            "\"min_ns\": %llu, \"median_ns\": %llu, \"p99_ns\": %llu, \"mb_per_s\": %.3f, \"mtokens_per_s\": %.3f}",
+            i == 0 ? "" : ",",
+            r.shape,
+            r.name,
+            (unsigned long long)r.bytes,
+            (unsigned long long)r.tokens,
+            (unsigned long long)r.min_ns,
+            (unsigned long long)r.median_ns,
+            (unsigned long long)r.p99_ns,
+            get_rate(r.bytes, r.median_ns),
+            get_rate(r.tokens, r.median_ns));
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    free_mem(path);
+}
+
+char *new_corpus_file_path(CorpusShape shape) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == nil || dir[0] == 0) {
+        dir = "/tmp";
+    }
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s/ccku_bench_%s.ku", dir, corpus_shape_names[shape]);
+    return str_to_cstr(take_str_from_cstr(buf));
+}
+
+void save_corpus(char *path, str text) {
+    FILE *file = fopen(path, "w");
+    if (file == nil || fwrite(text.bytes, 1, text.len, file) != text.len) {
+        fatal(1, "failed to write benchmark corpus file");
+    }
+    fclose(file);
+}
+
+u32 parse_bench_u32(str value) {
+    U32ParseResult res = parse_u32_from_decimal(value);
+    if (!res.ok) {
+        fatal(1, "invalid number in flag value");
+    }
+    return res.num;
+}
+
+BenchOptions parse_bench_options(int argc, char **argv) {
+    BenchOptions options = {
+        .size         = default_bench_size,
+        .warmup       = default_bench_warmup,
+        .repetitions  = default_bench_repetitions,
+        .single_shape = false,
+        .shape        = cs_Identifiers,
+        .json_path    = empty_str,
+    };
+    for (int i = 1; i < argc; i++) {
+        str arg = take_str_from_cstr(argv[i]);
+        if (has_prefix_str(arg, size_flag_prefix)) {
+            options.size = parse_bench_u32(borrow_str_slice_to_end(arg, size_flag_prefix.len));
+        } else if (has_prefix_str(arg, warmup_flag_prefix)) {
+            options.warmup = parse_bench_u32(borrow_str_slice_to_end(arg, warmup_flag_prefix.len));
+        } else if (has_prefix_str(arg, reps_flag_prefix)) {
+            options.repetitions = parse_bench_u32(borrow_str_slice_to_end(arg, reps_flag_prefix.len));
+        } else if (has_prefix_str(arg, shape_flag_prefix)) {
+            options.single_shape = true;
+            if (!parse_corpus_shape(borrow_str_slice_to_end(arg, shape_flag_prefix.len), &options.shape)) {
+                fatal(1, "unknown corpus shape");
+            }
+        } else if (has_prefix_str(arg, json_flag_prefix)) {
+            options.json_path = borrow_str_slice_to_end(arg, json_flag_prefix.len);
+        } else {
+            fatal(1, "unknown flag");
+        }
+    }
+    if (options.repetitions == 0) {
+        fatal(1, "number of repetitions must be positive");
+    }
+    return options;
+}
+
+// Usage: bench [--size=BYTES] [--warmup=N] [--reps=N] [--shape=NAME] [--json=PATH]
+//
+// Generates deterministic programs of each shape and measures loading them
+// from file, scanning and parsing. Times are reported in milliseconds
+int main(int argc, char **argv) {
+    BenchOptions options = parse_bench_options(argc, argv);
+
+    BenchResult results[cs_end * 3];
+    u32 len = 0;
+
+    printf("%-16s  %-6s  %10s  %10s  %10s  %10s  %10s\n", "shape", "bench", "min", "median", "p99", "MB/s",
+        "Mtokens/s");
+    for (u32 i = 0; i < cs_end; i++) {
+        CorpusShape shape = (CorpusShape)i;
+        if (options.single_shape && shape != options.shape) {
+            continue;
+        }
+
+        BenchInput input = {
+            .text = generate_corpus(shape, options.size, bench_corpus_seed),
+            .path = new_corpus_file_path(shape),
+        };
+        save_corpus(input.path, input.text);
+
+        const char *name = corpus_shape_names[shape];
+        results[len + 0] = run_bench(options, &input, name, "load", bench_load);
+        results[len + 1] = run_bench(options, &input, name, "scan", bench_scan);
+        results[len + 2] = run_bench(options, &input, name, "parse", bench_parse);
+        for (u32 j = 0; j < 3; j++) {
+            print_bench_result(results[len + j]);
+        }
+        len += 3;
+
+        remove(input.path);
+        free_mem(input.path);
+        free_str(input.text);
+    }
+
+    if (options.json_path.len != 0) {
+        write_bench_json(options, results, len);
+    }
+    return 0;
+}
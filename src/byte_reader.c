@@ -39,11 +39,14 @@ void mark_str_byte_reader_position(StrByteReader *r) {
     r->mark = r->pos - r->offset;
 }
 
+// slice_from_str_byte_reader_mark returns copy of bytes between mark and current
+// position, copies are token literals thus they are accounted as scanner memory
 str slice_from_str_byte_reader_mark(const StrByteReader *r) {
+    u64 end = r->pos - r->offset;
     if (r->pos > r->s.len + r->offset) {
-        return new_str_slice_to_end(r->s, r->mark);
+        end = r->s.len;
     }
-    return new_str_slice(r->s, r->mark, r->pos - r->offset);
+    return new_tagged_str_from_bytes(at_Scanner, r->s.bytes + r->mark, end - r->mark);
 }
 
 void free_str_byte_reader(StrByteReader r) {
@@ -0,0 +1,1004 @@
+#include <string.h>
+
+#include "bytecode.h"
+#include "fatal.h"
+
+typedef struct BcCompiler BcCompiler;
+typedef struct BcCondition BcCondition;
+
+struct BcCompiler {
+    const IrModule *m;
+    BcProgram *p;
+
+    // open addressing table of constant pool, slot holds index of constant
+    // plus one, zero marks free slot
+    u32 *const_slots;
+
+    // always a power of two
+    u32 const_cap;
+
+    // function being compiled and its output
+    const IrFunction *fn;
+    BcFunction *out;
+
+    // register of each value indexed by value id
+    u32 *regs;
+
+    // index of instruction which defines each value, IR_NONE for block
+    // parameters
+    u32 *defs;
+
+    // number of operands referring to each value
+    u32 *uses;
+
+    // constants whose every use takes them as immediate operand, they are
+    // not loaded into registers
+    bool *immediate_only;
+
+    // index of the first instruction of each block
+    u32 *block_pc;
+
+    // pairs of jump instruction index and its target block, targets are
+    // patched after all blocks are placed
+    slice_of_u32s fixups;
+
+    // register which breaks cycles of block argument moves, IR_NONE until
+    // it is needed
+    u32 scratch;
+};
+
+// BcCondition describes conditional jump: either jumpif or jumpifnot with bool
+// register in b or comparison of registers a and b fused into the jump
+struct BcCondition {
+    BcOpcode op;
+
+    u32 a;
+    u32 b;
+};
+
+#define BC_OPCODE_NAME(name, s) [bc_##name] = STR(s),
+
+const str bc_opcode_names[] = {BC_OPCODE_LIST(BC_OPCODE_NAME)};
+
+const str bc_comma_str      = STR(", ");
+const str bc_fn_str         = STR("fn ");
+const str bc_frame_str      = STR(" registers");
+const str bc_body_start_str = STR(" {\n");
+const str bc_body_end_str   = STR("}\n");
+const str bc_pc_end_str     = STR(": ");
+
+const str bc_kind_names[] = {
+    [vk_Signed]   = STR("signed"),
+    [vk_Unsigned] = STR("unsigned"),
+    [vk_F32]      = STR("f32"),
+    [vk_F64]      = STR("f64"),
+    [vk_Bool]     = STR("bool"),
+    [vk_Str]      = STR("str"),
+};
+
+// initial capacity of constant pool table
+const u32 min_bc_const_cap = 64;
+
+IMPLEMENT_SLICE(BcInstruction)
+IMPLEMENT_SLICE(VmValue)
+
+void *alloc_bc_temp(u64 size) {
+    void *p = alloc_mem(at_Vm, size + 1);
+    if (p == nil) {
+        fatal(1, "not enough memory for bytecode compilation");
+    }
+    return p;
+}
+
+u32 hash_bc_constant(u64 bits, u32 cap) {
+    return (u32)((bits * 0x9E3779B97F4A7C15) >> 32) & (cap - 1);
+}
+
+void grow_bc_const_slots(BcCompiler *bc) {
+    u32 cap    = bc->const_cap == 0 ? min_bc_const_cap : bc->const_cap * 2;
+    u32 *slots = (u32 *)alloc_bc_temp((u64)cap * sizeof(u32));
+    memset(slots, 0, (u64)cap * sizeof(u32));
+    for (u32 i = 0; i < bc->const_cap; i++) {
+        u32 k = bc->const_slots[i];
+        if (k == 0) {
+            continue;
+        }
+        u32 j = hash_bc_constant(bc->p->constants.elem[k - 1].u, cap);
+        while (slots[j] != 0) {
+            j = (j + 1) & (cap - 1);
+        }
+        slots[j] = k;
+    }
+    free_mem(bc->const_slots);
+    bc->const_slots = slots;
+    bc->const_cap   = cap;
+}
+
+// add_bc_constant returns index of number with given bits in constant pool,
+// equal numbers share the same entry
+u32 add_bc_constant(BcCompiler *bc, u64 bits) {
+    if ((bc->p->constants.len + 1) * 2 > bc->const_cap) {
+        grow_bc_const_slots(bc);
+    }
+    u32 i = hash_bc_constant(bits, bc->const_cap);
+    while (bc->const_slots[i] != 0) {
+        u32 k = bc->const_slots[i] - 1;
+        if (bc->p->constants.elem[k].u == bits) {
+            return k;
+        }
+        i = (i + 1) & (bc->const_cap - 1);
+    }
+    VmValue v = {.u = bits};
+    append_VmValue_to_slice(&bc->p->constants, v);
+    bc->const_slots[i] = bc->p->constants.len;
+    return bc->p->constants.len - 1;
+}
+
+// add_bc_string_constant copies string into program arena and adds it to the
+// pool, strings are not deduplicated
+u32 add_bc_string_constant(BcCompiler *bc, str s) {
+    VmValue v = {.s = new_vm_string(&bc->p->arena, s)};
+    append_VmValue_to_slice(&bc->p->constants, v);
+    return bc->p->constants.len - 1;
+}
+
+u32 emit_bc(BcCompiler *bc, BcOpcode op, u32 a, u32 b, u32 c) {
+    BcInstruction inst = {
+        .handler = nil,
+        .op      = op,
+        .a       = a,
+        .b       = b,
+        .c       = c,
+    };
+    append_BcInstruction_to_slice(&bc->out->code, inst);
+    return bc->out->code.len - 1;
+}
+
+// add_bc_fixup makes instruction jump to target block when block is placed
+void add_bc_fixup(BcCompiler *bc, u32 index, BlockId target) {
+    append_u32_to_slice(&bc->fixups, index);
+    append_u32_to_slice(&bc->fixups, target);
+}
+
+// emit_bc_jump_to_block emits jump instruction whose target is patched when
+// block is placed
+void emit_bc_jump_to_block(BcCompiler *bc, BcOpcode op, u32 condition, BlockId target) {
+    add_bc_fixup(bc, emit_bc(bc, op, 0, condition, 0), target);
+}
+
+// begin_bc_list appends length of new list and returns its offset, elements
+// are appended by caller
+u32 begin_bc_list(BcCompiler *bc, u32 len) {
+    append_u32_to_slice(&bc->out->lists, len);
+    return bc->out->lists.len - 1;
+}
+
+VmKind get_bc_value_kind(BcCompiler *bc, ValueId v) {
+    return get_vm_kind(bc->m->table, bc->fn->values[v]);
+}
+
+// emit_bc_wrap brings result of integer operation back to width of its type
+void emit_bc_wrap(BcCompiler *bc, TypeId type, u32 reg) {
+    Type t = get_type(bc->m->table, type);
+    if (t.size == 8) {
+        return;
+    }
+    bool is_signed = t.kind == tk_Signed;
+    switch (t.size) {
+    case 1:
+        emit_bc(bc, is_signed ? bc_Sext8 : bc_Zext8, reg, reg, 0);
+        break;
+    case 2:
+        emit_bc(bc, is_signed ? bc_Sext16 : bc_Zext16, reg, reg, 0);
+        break;
+    default:
+        emit_bc(bc, is_signed ? bc_Sext32 : bc_Zext32, reg, reg, 0);
+        break;
+    }
+}
+
+// get_bc_arithmetic_opcode selects bytecode opcode of arithmetic or bitwise
+// IR operation on values of given kind
+BcOpcode get_bc_arithmetic_opcode(IrOpcode op, VmKind kind) {
+    bool is_float  = kind == vk_F32 || kind == vk_F64;
+    bool is_signed = kind == vk_Signed;
+    switch (op) {
+    case op_Neg:
+        return is_float ? bc_FNeg : bc_Neg;
+    case op_Not:
+        return bc_Not;
+    case op_BitNot:
+        return bc_BitNot;
+    case op_Add:
+        if (kind == vk_Str) {
+            return bc_Concat;
+        }
+        return is_float ? bc_FAdd : bc_Add;
+    case op_Sub:
+        return is_float ? bc_FSub : bc_Sub;
+    case op_Mul:
+        return is_float ? bc_FMul : bc_Mul;
+    case op_Div:
+        if (is_float) {
+            return bc_FDiv;
+        }
+        return is_signed ? bc_DivS : bc_DivU;
+    case op_Rem:
+        return is_signed ? bc_RemS : bc_RemU;
+    case op_And:
+        return bc_And;
+    case op_Or:
+        return bc_Or;
+    case op_Xor:
+        return bc_Xor;
+    case op_AndNot:
+        return bc_AndNot;
+    case op_Shl:
+        return bc_Shl;
+    default:
+        return is_signed ? bc_ShrS : bc_ShrU;
+    }
+}
+
+// needs_bc_wrap tells whether result of operation may leave range of its
+// integer type
+bool needs_bc_wrap(BcOpcode op) {
+    switch (op) {
+    case bc_Add:
+    case bc_AddI:
+    case bc_Sub:
+    case bc_Mul:
+    case bc_DivS:
+    case bc_Shl:
+    case bc_Neg:
+    case bc_BitNot:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool needs_bc_rounding(BcOpcode op) {
+    switch (op) {
+    case bc_FAdd:
+    case bc_FSub:
+    case bc_FMul:
+    case bc_FDiv:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_bc_integer_kind(VmKind kind) {
+    return kind == vk_Signed || kind == vk_Unsigned;
+}
+
+// get_bc_immediate tells whether value is integer constant which fits into
+// immediate operand together with its negation
+bool get_bc_immediate(BcCompiler *bc, ValueId v, i64 *imm) {
+    u32 def = bc->defs[v];
+    if (def == IR_NONE) {
+        return false;
+    }
+    const IrInstruction *inst = &bc->fn->instructions[def];
+    if (inst->op != op_Const || !is_bc_integer_kind(get_vm_kind(bc->m->table, inst->type))) {
+        return false;
+    }
+    i64 x = (i64)inst->imm;
+    if (x < -INT32_MAX || x > INT32_MAX) {
+        return false;
+    }
+    *imm = x;
+    return true;
+}
+
+// get_bc_immediate_operand returns index of operand of integer add or sub
+// which becomes immediate of addi, IR_NONE if there is none. Subtracted
+// constant is negated, so only right operand of sub may be immediate
+u32 get_bc_immediate_operand(BcCompiler *bc, const IrInstruction *inst, const ValueId *ops) {
+    if (inst->op != op_Add && inst->op != op_Sub) {
+        return IR_NONE;
+    }
+    if (!is_bc_integer_kind(get_vm_kind(bc->m->table, inst->type))) {
+        return IR_NONE;
+    }
+    i64 imm;
+    if (get_bc_immediate(bc, ops[1], &imm)) {
+        return 1;
+    }
+    if (inst->op == op_Add && get_bc_immediate(bc, ops[0], &imm)) {
+        return 0;
+    }
+    return IR_NONE;
+}
+
+void compile_bc_arithmetic(BcCompiler *bc, const IrInstruction *inst, const ValueId *ops) {
+    u32 dst     = bc->regs[inst->result];
+    VmKind kind = get_vm_kind(bc->m->table, inst->type);
+    BcOpcode op = get_bc_arithmetic_opcode(inst->op, kind);
+    u32 index   = get_bc_immediate_operand(bc, inst, ops);
+    if (index != IR_NONE) {
+        i64 imm;
+        get_bc_immediate(bc, ops[index], &imm);
+        if (inst->op == op_Sub) {
+            imm = -imm;
+        }
+        op = bc_AddI;
+        emit_bc(bc, op, dst, bc->regs[ops[1 - index]], (u32)(i32)imm);
+    } else {
+        u32 right = inst->operands_len > 1 ? bc->regs[ops[1]] : 0;
+        emit_bc(bc, op, dst, bc->regs[ops[0]], right);
+    }
+    if ((kind == vk_Signed || kind == vk_Unsigned) && needs_bc_wrap(op)) {
+        emit_bc_wrap(bc, inst->type, dst);
+    } else if (kind == vk_F32 && needs_bc_rounding(op)) {
+        emit_bc(bc, bc_FRound32, dst, dst, 0);
+    }
+}
+
+// select_bc_comparison returns opcode of comparison and its operand
+// registers. Greater and greater or equal comparisons become less and less
+// or equal with swapped operands
+BcOpcode select_bc_comparison(BcCompiler *bc, const IrInstruction *inst, u32 *left, u32 *right) {
+    const ValueId *ops = bc->fn->operands + inst->operands;
+    VmKind kind        = get_bc_value_kind(bc, ops[0]);
+    *left              = bc->regs[ops[0]];
+    *right             = bc->regs[ops[1]];
+    if (inst->op == op_Gt || inst->op == op_Ge) {
+        u32 t  = *left;
+        *left  = *right;
+        *right = t;
+    }
+
+    bool is_less = inst->op == op_Lt || inst->op == op_Gt;
+    BcOpcode op;
+    switch (inst->op) {
+    case op_Eq:
+        op = kind == vk_Str ? bc_StrEq : bc_Eq;
+        if (kind == vk_F32 || kind == vk_F64) {
+            op = bc_FEq;
+        }
+        break;
+    case op_Ne:
+        op = kind == vk_Str ? bc_StrNe : bc_Ne;
+        if (kind == vk_F32 || kind == vk_F64) {
+            op = bc_FNe;
+        }
+        break;
+    default:
+        switch (kind) {
+        case vk_Signed:
+            op = is_less ? bc_LtS : bc_LeS;
+            break;
+        case vk_Unsigned:
+            op = is_less ? bc_LtU : bc_LeU;
+            break;
+        case vk_Str:
+            op = is_less ? bc_StrLt : bc_StrLe;
+            break;
+        default:
+            op = is_less ? bc_FLt : bc_FLe;
+            break;
+        }
+        break;
+    }
+    return op;
+}
+
+void compile_bc_comparison(BcCompiler *bc, const IrInstruction *inst) {
+    u32 left;
+    u32 right;
+    BcOpcode op = select_bc_comparison(bc, inst, &left, &right);
+    emit_bc(bc, op, bc->regs[inst->result], left, right);
+}
+
+// get_bc_fused_jump returns jump which replaces comparison followed by
+// conditional jump, bc_end if comparison of such kind is not fused
+BcOpcode get_bc_fused_jump(BcOpcode compare) {
+    switch (compare) {
+    case bc_Eq:
+        return bc_JumpEq;
+    case bc_Ne:
+        return bc_JumpNe;
+    case bc_LtS:
+        return bc_JumpLtS;
+    case bc_LeS:
+        return bc_JumpLeS;
+    case bc_LtU:
+        return bc_JumpLtU;
+    case bc_LeU:
+        return bc_JumpLeU;
+    default:
+        return bc_end;
+    }
+}
+
+// is_bc_fused_comparison tells whether comparison is used only as condition
+// of the following branch and may be fused into its jump
+bool is_bc_fused_comparison(BcCompiler *bc, const IrInstruction *inst, const IrInstruction *term) {
+    switch (inst->op) {
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        break;
+    default:
+        return false;
+    }
+    if (term->op != op_Branch || bc->fn->operands[term->operands] != inst->result || bc->uses[inst->result] != 1) {
+        return false;
+    }
+    u32 left;
+    u32 right;
+    return get_bc_fused_jump(select_bc_comparison(bc, inst, &left, &right)) != bc_end;
+}
+
+// Fused comparisons are negated by swapping operands, which is valid only
+// for integers: not (a < b) is b <= a
+BcCondition negate_bc_condition(BcCondition c) {
+    BcCondition n = c;
+    switch (c.op) {
+    case bc_JumpIf:
+        n.op = bc_JumpIfNot;
+        return n;
+    case bc_JumpIfNot:
+        n.op = bc_JumpIf;
+        return n;
+    case bc_JumpEq:
+        n.op = bc_JumpNe;
+        return n;
+    case bc_JumpNe:
+        n.op = bc_JumpEq;
+        return n;
+    case bc_JumpLtS:
+        n.op = bc_JumpLeS;
+        break;
+    case bc_JumpLeS:
+        n.op = bc_JumpLtS;
+        break;
+    case bc_JumpLtU:
+        n.op = bc_JumpLeU;
+        break;
+    default:
+        n.op = bc_JumpLtU;
+        break;
+    }
+    n.a = c.b;
+    n.b = c.a;
+    return n;
+}
+
+// emit_bc_conditional_jump emits jump to target block, target is left for
+// caller to patch if it is IR_NONE
+u32 emit_bc_conditional_jump(BcCompiler *bc, BcCondition c, BlockId target) {
+    u32 index = emit_bc(bc, c.op, c.a, c.b, 0);
+    if (target != IR_NONE) {
+        add_bc_fixup(bc, index, target);
+    }
+    return index;
+}
+
+// emit_bc_moves assigns arguments to parameters of target block as if all
+// of them were copied at once. Move is emitted only after no other pending
+// move reads its destination, cycles are broken with scratch register
+void emit_bc_moves(BcCompiler *bc, BlockId target, const ValueId *args, u32 len) {
+    if (len == 0) {
+        return;
+    }
+    u32 *dst       = (u32 *)alloc_bc_temp((u64)len * sizeof(u32));
+    u32 *src       = (u32 *)alloc_bc_temp((u64)len * sizeof(u32));
+    ValueId params = bc->fn->blocks[target].params;
+    u32 n          = 0;
+    for (u32 i = 0; i < len; i++) {
+        u32 d = bc->regs[params + i];
+        u32 s = bc->regs[args[i]];
+        if (d != s) {
+            dst[n] = d;
+            src[n] = s;
+            n++;
+        }
+    }
+
+    while (n != 0) {
+        u32 ready = IR_NONE;
+        for (u32 i = 0; i < n && ready == IR_NONE; i++) {
+            bool is_read = false;
+            for (u32 j = 0; j < n && !is_read; j++) {
+                is_read = src[j] == dst[i];
+            }
+            if (!is_read) {
+                ready = i;
+            }
+        }
+
+        if (ready == IR_NONE) {
+            // every destination is read by another move, save one of them
+            if (bc->scratch == IR_NONE) {
+                bc->scratch = bc->out->frame_size;
+                bc->out->frame_size++;
+            }
+            emit_bc(bc, bc_Move, bc->scratch, dst[0], 0);
+            for (u32 j = 0; j < n; j++) {
+                if (src[j] == dst[0]) {
+                    src[j] = bc->scratch;
+                }
+            }
+            continue;
+        }
+
+        emit_bc(bc, bc_Move, dst[ready], src[ready], 0);
+        n--;
+        dst[ready] = dst[n];
+        src[ready] = src[n];
+    }
+    free_mem(dst);
+    free_mem(src);
+}
+
+// emit_bc_edge passes arguments to target block and jumps there unless
+// target is placed right after current block. The last move and the jump
+// are fused into movejump
+void emit_bc_edge(BcCompiler *bc, const IrInstruction *inst, u32 index, BlockId next) {
+    u32 len;
+    const ValueId *args = get_ir_target_args(bc->fn, inst, index, &len);
+    BlockId target      = inst->targets[index];
+    u32 start           = bc->out->code.len;
+    emit_bc_moves(bc, target, args, len);
+    if (target == next) {
+        return;
+    }
+    u32 last = bc->out->code.len - 1;
+    if (bc->out->code.len != start && bc->out->code.elem[last].op == bc_Move) {
+        bc->out->code.elem[last].op = bc_MoveJump;
+        add_bc_fixup(bc, last, target);
+        return;
+    }
+    emit_bc_jump_to_block(bc, bc_Jump, 0, target);
+}
+
+// compile_bc_branch emits conditional jump on bool register or on
+// comparison fused into the jump if it is given
+void compile_bc_branch(BcCompiler *bc, const IrInstruction *inst, const IrInstruction *compare, BlockId next) {
+    u32 then_len;
+    u32 else_len;
+    get_ir_target_args(bc->fn, inst, 0, &then_len);
+    get_ir_target_args(bc->fn, inst, 1, &else_len);
+    BlockId then_block = inst->targets[0];
+    BlockId else_block = inst->targets[1];
+
+    BcCondition c = {
+        .op = bc_JumpIf,
+        .a  = 0,
+        .b  = bc->regs[bc->fn->operands[inst->operands]],
+    };
+    if (compare != nil) {
+        c.op = get_bc_fused_jump(select_bc_comparison(bc, compare, &c.a, &c.b));
+    }
+
+    if (then_len == 0 && else_len == 0) {
+        if (then_block == next) {
+            emit_bc_conditional_jump(bc, negate_bc_condition(c), else_block);
+        } else if (else_block == next) {
+            emit_bc_conditional_jump(bc, c, then_block);
+        } else {
+            emit_bc_conditional_jump(bc, c, then_block);
+            emit_bc_jump_to_block(bc, bc_Jump, 0, else_block);
+        }
+        return;
+    }
+
+    // arguments of each target are moved on its own path
+    u32 skip = emit_bc_conditional_jump(bc, negate_bc_condition(c), IR_NONE);
+    emit_bc_edge(bc, inst, 0, IR_NONE);
+    bc->out->code.elem[skip].c = bc->out->code.len;
+    emit_bc_edge(bc, inst, 1, next);
+}
+
+// add_bc_value_list appends list of registers of given values
+u32 add_bc_value_list(BcCompiler *bc, const ValueId *values, u32 len) {
+    u32 list = begin_bc_list(bc, len);
+    for (u32 i = 0; i < len; i++) {
+        append_u32_to_slice(&bc->out->lists, bc->regs[values[i]]);
+    }
+    return list;
+}
+
+// Tuple arguments of builtins are expanded into their members
+void compile_bc_builtin_call(BcCompiler *bc, const IrInstruction *inst, const ValueId *ops) {
+    const TypeTable *table = bc->m->table;
+
+    u32 len = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        len += get_tuple_members(table, &bc->fn->values[ops[i]]).len;
+    }
+    if (len > bc->p->max_builtin_args) {
+        bc->p->max_builtin_args = len;
+    }
+
+    u32 list = begin_bc_list(bc, len);
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        TypeList members = get_tuple_members(table, &bc->fn->values[ops[i]]);
+        for (u32 j = 0; j < members.len; j++) {
+            append_u32_to_slice(&bc->out->lists, bc->regs[ops[i]] + j);
+            append_u32_to_slice(&bc->out->lists, get_vm_kind(table, members.elem[j]));
+        }
+    }
+    emit_bc(bc, bc_CallBuiltin, 0, (u32)inst->imm, list);
+}
+
+void compile_bc_instruction(BcCompiler *bc, const IrInstruction *inst, BlockId next) {
+    const ValueId *ops = bc->fn->operands + inst->operands;
+    switch (inst->op) {
+    case op_Const: {
+        if (bc->immediate_only[inst->result]) {
+            break;
+        }
+        // zero value of string type is empty string
+        u32 k = inst->type == ti_Str ? add_bc_string_constant(bc, empty_str) : add_bc_constant(bc, inst->imm);
+        emit_bc(bc, bc_Const, bc->regs[inst->result], k, 0);
+        break;
+    }
+    case op_String: {
+        u32 k = add_bc_string_constant(bc, bc->fn->strings[inst->imm]);
+        emit_bc(bc, bc_Const, bc->regs[inst->result], k, 0);
+        break;
+    }
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        compile_bc_comparison(bc, inst);
+        break;
+    case op_Call: {
+        u32 dst  = inst->result == IR_NONE ? 0 : bc->regs[inst->result];
+        u32 list = add_bc_value_list(bc, ops, inst->operands_len);
+        emit_bc(bc, bc_Call, dst, (u32)inst->imm, list);
+        break;
+    }
+    case op_CallBuiltin:
+        compile_bc_builtin_call(bc, inst, ops);
+        break;
+    case op_Extract:
+        // member already has register inside of tuple
+        break;
+    case op_Jump:
+        emit_bc_edge(bc, inst, 0, next);
+        break;
+    case op_Branch:
+        compile_bc_branch(bc, inst, nil, next);
+        break;
+    case op_Return:
+        emit_bc(bc, bc_Return, 0, 0, add_bc_value_list(bc, ops, inst->operands_len));
+        break;
+    default:
+        compile_bc_arithmetic(bc, inst, ops);
+        break;
+    }
+}
+
+// assign_bc_registers gives parameters of entry block the first registers,
+// other values follow them in order of ids. Members of tuple extracted from
+// call result refer to registers of the tuple
+void assign_bc_registers(BcCompiler *bc) {
+    const IrFunction *fn = bc->fn;
+    bc->regs             = (u32 *)alloc_bc_temp((u64)fn->values_len * sizeof(u32));
+    for (u32 v = 0; v < fn->values_len; v++) {
+        bc->regs[v] = IR_NONE;
+    }
+    u32 next = 0;
+
+    IrBlock entry = fn->blocks[0];
+    for (u32 i = 0; i < entry.params_len; i++) {
+        bc->regs[entry.params + i] = next;
+        next++;
+    }
+    bool *extracted = (bool *)alloc_bc_temp(fn->values_len * sizeof(bool));
+    memset(extracted, 0, fn->values_len * sizeof(bool));
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        if (fn->instructions[i].op == op_Extract) {
+            extracted[fn->instructions[i].result] = true;
+        }
+    }
+
+    for (u32 v = 0; v < fn->values_len; v++) {
+        if (bc->regs[v] != IR_NONE || extracted[v]) {
+            continue;
+        }
+        bc->regs[v] = next;
+        next += get_tuple_members(bc->m->table, &fn->values[v]).len;
+    }
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        IrInstruction inst = fn->instructions[i];
+        if (inst.op == op_Extract) {
+            bc->regs[inst.result] = bc->regs[fn->operands[inst.operands]] + (u32)inst.imm;
+        }
+    }
+    free_mem(extracted);
+    bc->out->frame_size = next;
+}
+
+// analyze_bc_values finds definitions and counts uses of values, constants
+// which are used only as immediates of addi are not loaded
+void analyze_bc_values(BcCompiler *bc) {
+    const IrFunction *fn = bc->fn;
+    u64 size             = (u64)fn->values_len * sizeof(u32);
+    bc->defs             = (u32 *)alloc_bc_temp(size);
+    bc->uses             = (u32 *)alloc_bc_temp(size);
+    bc->immediate_only   = (bool *)alloc_bc_temp(fn->values_len * sizeof(bool));
+    u32 *immediate_uses  = (u32 *)alloc_bc_temp(size);
+    memset(bc->uses, 0, size);
+    memset(immediate_uses, 0, size);
+    for (u32 v = 0; v < fn->values_len; v++) {
+        bc->defs[v] = IR_NONE;
+    }
+
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        const IrInstruction *inst = &fn->instructions[i];
+        if (inst->result != IR_NONE) {
+            bc->defs[inst->result] = i;
+        }
+        for (u32 j = 0; j < inst->operands_len; j++) {
+            bc->uses[fn->operands[inst->operands + j]]++;
+        }
+    }
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        const IrInstruction *inst = &fn->instructions[i];
+        const ValueId *ops        = fn->operands + inst->operands;
+        u32 index                 = get_bc_immediate_operand(bc, inst, ops);
+        if (index != IR_NONE) {
+            immediate_uses[ops[index]]++;
+        }
+    }
+    for (u32 v = 0; v < fn->values_len; v++) {
+        bc->immediate_only[v] = immediate_uses[v] != 0 && immediate_uses[v] == bc->uses[v];
+    }
+    free_mem(immediate_uses);
+}
+
+str copy_bc_name(Arena *a, str name) {
+    byte *bytes = (byte *)arena_alloc(a, name.len + 1);
+    memcpy(bytes, name.bytes, name.len);
+    return borrow_str_from_bytes(bytes, name.len);
+}
+
+void compile_bc_function(BcCompiler *bc, const IrFunction *fn, BcFunction *out) {
+    out->name       = copy_bc_name(&bc->p->arena, fn->name);
+    out->params     = fn->blocks[0].params_len;
+    out->results    = get_tuple_members(bc->m->table, &fn->result).len;
+    out->frame_size = 0;
+    out->code       = empty_slice_of_BcInstructions;
+    out->lists      = empty_slice_of_u32s;
+
+    bc->fn       = fn;
+    bc->out      = out;
+    bc->scratch  = IR_NONE;
+    bc->fixups   = empty_slice_of_u32s;
+    bc->block_pc = (u32 *)alloc_bc_temp((u64)fn->blocks_len * sizeof(u32));
+    assign_bc_registers(bc);
+    analyze_bc_values(bc);
+
+    IrCfg cfg = compute_ir_cfg(fn);
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        BlockId next  = i + 1 < cfg.reachable ? cfg.order[i + 1] : IR_NONE;
+        IrBlock block = fn->blocks[b];
+        bc->block_pc[b] = out->code.len;
+        for (u32 j = 0; j < block.len; j++) {
+            const IrInstruction *inst = &fn->instructions[block.start + j];
+            if (j + 2 == block.len && is_bc_fused_comparison(bc, inst, inst + 1)) {
+                compile_bc_branch(bc, inst + 1, inst, next);
+                break;
+            }
+            compile_bc_instruction(bc, inst, next);
+        }
+    }
+    for (u32 i = 0; i + 1 < bc->fixups.len; i += 2) {
+        out->code.elem[bc->fixups.elem[i]].c = bc->block_pc[bc->fixups.elem[i + 1]];
+    }
+
+    free_ir_cfg(&cfg);
+    free_slice_of_u32s(bc->fixups);
+    free_mem(bc->block_pc);
+    free_mem(bc->regs);
+    free_mem(bc->defs);
+    free_mem(bc->uses);
+    free_mem(bc->immediate_only);
+}
+
+const BcProgram empty_bc_program = {
+    .arena            = {.chunk = nil, .last = nil, .size = 0, .tag = at_Vm},
+    .functions        = nil,
+    .functions_len    = 0,
+    .constants        = {.elem = nil, .len = 0, .cap = 0},
+    .max_builtin_args = 0,
+    .threaded         = false,
+    .profiled         = false,
+};
+
+BcProgram compile_ir_module(const IrModule *m) {
+    BcProgram p = {
+        .arena            = init_arena(at_Vm),
+        .functions        = nil,
+        .functions_len    = m->functions_len,
+        .constants        = empty_slice_of_VmValues,
+        .max_builtin_args = 0,
+        .threaded         = false,
+        .profiled         = false,
+    };
+    p.functions = (BcFunction *)arena_alloc(&p.arena, (u64)m->functions_len * sizeof(BcFunction) + 1);
+
+    BcCompiler bc = {
+        .m              = m,
+        .p              = &p,
+        .const_slots    = nil,
+        .const_cap      = 0,
+        .fn             = nil,
+        .out            = nil,
+        .regs           = nil,
+        .defs           = nil,
+        .uses           = nil,
+        .immediate_only = nil,
+        .block_pc       = nil,
+        .fixups         = empty_slice_of_u32s,
+        .scratch        = IR_NONE,
+    };
+    for (u32 i = 0; i < m->functions_len; i++) {
+        compile_bc_function(&bc, &m->functions[i], &p.functions[i]);
+    }
+    free_mem(bc.const_slots);
+    return p;
+}
+
+void free_bc_program(BcProgram *p) {
+    for (u32 i = 0; i < p->functions_len; i++) {
+        free_slice_of_BcInstructions(p->functions[i].code);
+        free_slice_of_u32s(p->functions[i].lists);
+    }
+    free_slice_of_VmValues(p->constants);
+    free_arena(&p->arena);
+    p->functions     = nil;
+    p->functions_len = 0;
+}
+
+u32 find_bc_function(const BcProgram *p, str name) {
+    for (u32 i = 0; i < p->functions_len; i++) {
+        if (are_strs_equal(p->functions[i].name, name)) {
+            return i;
+        }
+    }
+    return IR_NONE;
+}
+
+void write_bc_register(OutputBuffer *out, u32 reg) {
+    write_byte_to_output(out, 'r');
+    write_u64_to_output(out, reg);
+}
+
+// write_bc_list writes registers of list, kinds follow registers of builtin
+// arguments
+void write_bc_list(OutputBuffer *out, const BcFunction *fn, u32 list, bool kinds) {
+    u32 len  = fn->lists.elem[list];
+    u32 step = kinds ? 2 : 1;
+    write_byte_to_output(out, '(');
+    for (u32 i = 0; i < len; i++) {
+        if (i != 0) {
+            write_str_to_output(out, bc_comma_str);
+        }
+        u32 entry = list + 1 + i * step;
+        write_bc_register(out, fn->lists.elem[entry]);
+        if (kinds) {
+            write_byte_to_output(out, ' ');
+            write_str_to_output(out, bc_kind_names[fn->lists.elem[entry + 1]]);
+        }
+    }
+    write_byte_to_output(out, ')');
+}
+
+void write_bc_instruction(OutputBuffer *out, const BcProgram *p, const BcFunction *fn, BcInstruction inst) {
+    write_str_to_output(out, bc_opcode_names[inst.op]);
+    write_byte_to_output(out, ' ');
+    switch (inst.op) {
+    case bc_Const:
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_byte_to_output(out, 'k');
+        write_u64_to_output(out, inst.b);
+        break;
+    case bc_Jump:
+        write_u64_to_output(out, inst.c);
+        break;
+    case bc_JumpIf:
+    case bc_JumpIfNot:
+        write_bc_register(out, inst.b);
+        write_str_to_output(out, bc_comma_str);
+        write_u64_to_output(out, inst.c);
+        break;
+    case bc_JumpEq:
+    case bc_JumpNe:
+    case bc_JumpLtS:
+    case bc_JumpLeS:
+    case bc_JumpLtU:
+    case bc_JumpLeU:
+    case bc_MoveJump:
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_bc_register(out, inst.b);
+        write_str_to_output(out, bc_comma_str);
+        write_u64_to_output(out, inst.c);
+        break;
+    case bc_AddI: {
+        i32 imm = (i32)inst.c;
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_bc_register(out, inst.b);
+        write_str_to_output(out, bc_comma_str);
+        if (imm < 0) {
+            write_byte_to_output(out, '-');
+        }
+        write_u64_to_output(out, imm < 0 ? (u64)(-(i64)imm) : (u64)imm);
+        break;
+    }
+    case bc_Call:
+    case bc_CallJit:
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_str_to_output(out, p->functions[inst.b].name);
+        write_bc_list(out, fn, inst.c, false);
+        break;
+    case bc_CallBuiltin:
+        write_str_to_output(out, builtin_function_names[inst.b]);
+        write_bc_list(out, fn, inst.c, true);
+        break;
+    case bc_Return:
+        write_bc_list(out, fn, inst.c, false);
+        break;
+    case bc_Move:
+    case bc_Neg:
+    case bc_Not:
+    case bc_BitNot:
+    case bc_Sext8:
+    case bc_Sext16:
+    case bc_Sext32:
+    case bc_Zext8:
+    case bc_Zext16:
+    case bc_Zext32:
+    case bc_FNeg:
+    case bc_FRound32:
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_bc_register(out, inst.b);
+        break;
+    default:
+        write_bc_register(out, inst.a);
+        write_str_to_output(out, bc_comma_str);
+        write_bc_register(out, inst.b);
+        write_str_to_output(out, bc_comma_str);
+        write_bc_register(out, inst.c);
+        break;
+    }
+    write_byte_to_output(out, '\n');
+}
+
+// write_bc_function writes header with number of registers in frame followed
+// by numbered instructions
+void write_bc_function(OutputBuffer *out, const BcProgram *p, const BcFunction *fn) {
+    write_str_to_output(out, bc_fn_str);
+    write_str_to_output(out, fn->name);
+    write_byte_to_output(out, ' ');
+    write_u64_to_output(out, fn->frame_size);
+    write_str_to_output(out, bc_frame_str);
+    write_str_to_output(out, bc_body_start_str);
+    for (u32 i = 0; i < fn->code.len; i++) {
+        u64 digits = count_decimal_digits(i);
+        write_spaces_to_output(out, digits < 4 ? 8 - digits : 4);
+        write_u64_to_output(out, i);
+        write_str_to_output(out, bc_pc_end_str);
+        write_bc_instruction(out, p, fn, fn->code.elem[i]);
+    }
+    write_str_to_output(out, bc_body_end_str);
+}
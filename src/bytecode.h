@@ -0,0 +1,193 @@
+#ifndef KU_BYTECODE_H
+#define KU_BYTECODE_H
+
+#include "arena.h"
+#include "ir.h"
+#include "output.h"
+#include "resolve.h"
+#include "runtime.h"
+#include "slice.h"
+#include "str.h"
+#include "types.h"
+
+typedef enum BcOpcode BcOpcode;
+typedef struct BcInstruction BcInstruction;
+typedef struct BcFunction BcFunction;
+typedef struct BcProgram BcProgram;
+
+#define BC_OPCODE_LIST(X)                                                                                              \
+    X(Move, "move")                                                                                                    \
+    X(Const, "const")                                                                                                  \
+    X(Add, "add")                                                                                                      \
+    X(AddI, "addi")                                                                                                    \
+    X(Sub, "sub")                                                                                                      \
+    X(Mul, "mul")                                                                                                      \
+    X(DivS, "divs")                                                                                                    \
+    X(DivU, "divu")                                                                                                    \
+    X(RemS, "rems")                                                                                                    \
+    X(RemU, "remu")                                                                                                    \
+    X(And, "and")                                                                                                      \
+    X(Or, "or")                                                                                                        \
+    X(Xor, "xor")                                                                                                      \
+    X(AndNot, "andnot")                                                                                                \
+    X(Shl, "shl")                                                                                                      \
+    X(ShrS, "shrs")                                                                                                    \
+    X(ShrU, "shru")                                                                                                    \
+    X(Neg, "neg")                                                                                                      \
+    X(Not, "not")                                                                                                      \
+    X(BitNot, "bitnot")                                                                                                \
+    X(Sext8, "sext8")                                                                                                  \
+    X(Sext16, "sext16")                                                                                                \
+    X(Sext32, "sext32")                                                                                                \
+    X(Zext8, "zext8")                                                                                                  \
+    X(Zext16, "zext16")                                                                                                \
+    X(Zext32, "zext32")                                                                                                \
+    X(Eq, "eq")                                                                                                        \
+    X(Ne, "ne")                                                                                                        \
+    X(LtS, "lts")                                                                                                      \
+    X(LeS, "les")                                                                                                      \
+    X(LtU, "ltu")                                                                                                      \
+    X(LeU, "leu")                                                                                                      \
+    X(FAdd, "fadd")                                                                                                    \
+    X(FSub, "fsub")                                                                                                    \
+    X(FMul, "fmul")                                                                                                    \
+    X(FDiv, "fdiv")                                                                                                    \
+    X(FNeg, "fneg")                                                                                                    \
+    X(FRound32, "fround32")                                                                                            \
+    X(FEq, "feq")                                                                                                      \
+    X(FNe, "fne")                                                                                                      \
+    X(FLt, "flt")                                                                                                      \
+    X(FLe, "fle")                                                                                                      \
+    X(Concat, "concat")                                                                                                \
+    X(StrEq, "streq")                                                                                                  \
+    X(StrNe, "strne")                                                                                                  \
+    X(StrLt, "strlt")                                                                                                  \
+    X(StrLe, "strle")                                                                                                  \
+    X(Jump, "jump")                                                                                                    \
+    X(JumpIf, "jumpif")                                                                                                \
+    X(JumpIfNot, "jumpifnot")                                                                                          \
+    X(JumpEq, "jumpeq")                                                                                                \
+    X(JumpNe, "jumpne")                                                                                                \
+    X(JumpLtS, "jumplts")                                                                                              \
+    X(JumpLeS, "jumples")                                                                                              \
+    X(JumpLtU, "jumpltu")                                                                                              \
+    X(JumpLeU, "jumpleu")                                                                                              \
+    X(MoveJump, "movejump")                                                                                            \
+    X(Call, "call")                                                                                                    \
+    X(CallJit, "call_jit")                                                                                             \
+    X(CallBuiltin, "call_builtin")                                                                                     \
+    X(Return, "return")
+
+#define BC_OPCODE_ENUM_ENTRY(name, s) bc_##name,
+
+// Operands of instructions are registers of current frame unless noted
+// otherwise:
+//
+//   - move a, b: a = b
+//   - const a, b: a = constant with index b in program pool
+//   - binary operators a, b, c: a = b op c
+//   - unary operators and extensions a, b: a = op b
+//   - jump c: continue at instruction with index c
+//   - jumpif and jumpifnot b, c: jump to c if bool b is true or false
+//   - call a, b, c: call function with index b, arguments are listed at
+//     offset c of list array, results are written to a and following
+//     registers
+//   - call_builtin b, c: call builtin with index b, list at offset c holds
+//     pairs of register and VmKind
+//   - return c: return values listed at offset c
+//   - call_jit a, b, c: the same as call, callee runs as native code (see
+//     jit.h). Interpreter rewrites call into it when callee is compiled
+//
+// Superinstructions replace the most frequent pairs found by profiling
+// (see vm_bench --profile):
+//
+//   - addi a, b, c: a = b + c, c is a signed 32-bit immediate. Replaces
+//     constant load followed by add or sub
+//   - jumpeq, jumpne, jumplts, jumples, jumpltu, jumpleu a, b, c: jump to c
+//     if comparison of a and b holds. Replaces integer comparison followed
+//     by conditional jump when the comparison has no other uses
+//   - movejump a, b, c: a = b, then jump to c. Replaces the last move of
+//     block arguments followed by jump
+//
+// Integer operations work on 64-bit values, results of narrower types are
+// brought back to their width with sign or zero extension. Signed division
+// of minimal value by -1 gives the value itself
+enum BcOpcode {
+    BC_OPCODE_LIST(BC_OPCODE_ENUM_ENTRY)
+
+    bc_end,
+};
+
+struct BcInstruction {
+    // address of instruction handler in interpreter loop, it is set before
+    // the first run when interpreter uses direct threading
+    const void *handler;
+
+    BcOpcode op;
+
+    u32 a;
+    u32 b;
+    u32 c;
+};
+
+TYPEDEF_SLICE(BcInstruction)
+TYPEDEF_SLICE(VmValue)
+
+// BcFunction keeps each value in its own register. Parameters occupy the
+// first registers of frame, tuple results of calls occupy consecutive
+// registers
+struct BcFunction {
+    str name;
+
+    u32 params;
+    u32 results;
+
+    // number of registers in frame
+    u32 frame_size;
+
+    slice_of_BcInstructions code;
+
+    // lists of call arguments and returned values, each list is its length
+    // followed by elements
+    slice_of_u32s lists;
+};
+
+struct BcProgram {
+    // names of functions and string constants
+    Arena arena;
+
+    // functions are in the same order as in IR module
+    BcFunction *functions;
+    u32 functions_len;
+
+    // constant pool shared by all functions, bits of numbers or pointers to
+    // strings
+    slice_of_VmValues constants;
+
+    // maximal number of values passed to a builtin by a single call
+    u32 max_builtin_args;
+
+    // set by interpreter after handlers of instructions are filled in,
+    // profiling run fills in handlers which count instructions
+    bool threaded;
+    bool profiled;
+};
+
+extern const str bc_opcode_names[];
+
+extern const BcProgram empty_bc_program;
+
+// compile_ir_module translates each function of valid IR module into
+// register bytecode. Blocks are laid out in reverse postorder, so most
+// jumps fall through, and block arguments become moves into registers of
+// target parameters
+BcProgram compile_ir_module(const IrModule *m);
+
+void free_bc_program(BcProgram *p);
+
+// find_bc_function returns index of function with given name or IR_NONE
+u32 find_bc_function(const BcProgram *p, str name);
+
+void write_bc_function(OutputBuffer *out, const BcProgram *p, const BcFunction *fn);
+
+#endif // KU_BYTECODE_H
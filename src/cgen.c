@@ -0,0 +1,658 @@
+#include <string.h>
+
+#include "alloc.h"
+#include "cgen.h"
+#include "runtime.h"
+
+typedef struct CEmitter CEmitter;
+
+// CEmitter keeps state of write_c_module call
+struct CEmitter {
+    OutputBuffer *out;
+    const IrModule *m;
+
+    // tuple types which have structure declared, in order of declaration
+    TypeId *tuples;
+    u32 tuples_len;
+    u32 tuples_cap;
+
+    const IrFunction *fn;
+    u32 fn_index;
+};
+
+const char *const c_function_prefix = "ku_f_";
+
+const char *const c_signed_type_names[] = {
+    [1] = "int8_t",
+    [2] = "int16_t",
+    [4] = "int32_t",
+    [8] = "int64_t",
+};
+
+const char *const c_unsigned_type_names[] = {
+    [1] = "uint8_t",
+    [2] = "uint16_t",
+    [4] = "uint32_t",
+    [8] = "uint64_t",
+};
+
+const char *const c_kind_names[] = {
+    [vk_Signed]   = "KU_KIND_SIGNED",
+    [vk_Unsigned] = "KU_KIND_UNSIGNED",
+    [vk_F32]      = "KU_KIND_F32",
+    [vk_F64]      = "KU_KIND_F64",
+    [vk_Bool]     = "KU_KIND_BOOL",
+    [vk_Str]      = "KU_KIND_STR",
+};
+
+// operators of C used for IR operations whose semantics match
+const char *const c_operators[] = {
+    [op_Add]    = " + ",
+    [op_Sub]    = " - ",
+    [op_Mul]    = " * ",
+    [op_Div]    = " / ",
+    [op_And]    = " & ",
+    [op_Or]     = " | ",
+    [op_Xor]    = " ^ ",
+    [op_Eq]     = " == ",
+    [op_Ne]     = " != ",
+    [op_Lt]     = " < ",
+    [op_Le]     = " <= ",
+    [op_Gt]     = " > ",
+    [op_Ge]     = " >= ",
+};
+
+void write_c_cstr(CEmitter *e, const char *s) {
+    write_bytes_to_output(e->out, (const byte *)s, strlen(s));
+}
+
+void write_c_value(CEmitter *e, ValueId v) {
+    write_byte_to_output(e->out, 'v');
+    write_u64_to_output(e->out, v);
+}
+
+void write_c_function_name(CEmitter *e, u32 fn) {
+    write_c_cstr(e, c_function_prefix);
+    write_str_to_output(e->out, e->m->functions[fn].name);
+}
+
+// write_c_function_label writes name of static array with name of current
+// function, it is passed to runtime errors
+void write_c_function_label(CEmitter *e) {
+    write_c_cstr(e, "ku_name");
+    write_u64_to_output(e->out, e->fn_index);
+}
+
+void write_c_type(CEmitter *e, TypeId id) {
+    Type t = get_type(e->m->table, id);
+    switch (t.kind) {
+    case tk_Void:
+        write_c_cstr(e, "void");
+        break;
+    case tk_Bool:
+        write_c_cstr(e, "bool");
+        break;
+    case tk_Signed:
+        write_c_cstr(e, c_signed_type_names[t.size]);
+        break;
+    case tk_Unsigned:
+        write_c_cstr(e, c_unsigned_type_names[t.size]);
+        break;
+    case tk_Float:
+        write_c_cstr(e, t.size == 4 ? "float" : "double");
+        break;
+    case tk_Str:
+        write_c_cstr(e, "const KuString *");
+        break;
+    default:
+        write_c_cstr(e, "ku_tuple");
+        write_u64_to_output(e->out, id);
+        break;
+    }
+}
+
+bool is_c_tuple(const CEmitter *e, TypeId id) {
+    return get_type(e->m->table, id).kind == tk_Tuple;
+}
+
+// declare_c_tuple writes structure for tuple type unless it was already
+// declared, members are named m0, m1 and so on
+void declare_c_tuple(CEmitter *e, TypeId id) {
+    if (!is_c_tuple(e, id)) {
+        return;
+    }
+    for (u32 i = 0; i < e->tuples_len; i++) {
+        if (e->tuples[i] == id) {
+            return;
+        }
+    }
+    if (e->tuples_len == e->tuples_cap) {
+        e->tuples_cap = e->tuples_cap == 0 ? 16 : 2 * e->tuples_cap;
+        TypeId *tuples = (TypeId *)alloc_ir_temp((u64)e->tuples_cap * sizeof(TypeId));
+        if (e->tuples_len != 0) {
+            memcpy(tuples, e->tuples, e->tuples_len * sizeof(TypeId));
+        }
+        free_mem(e->tuples);
+        e->tuples = tuples;
+    }
+    e->tuples[e->tuples_len] = id;
+    e->tuples_len++;
+
+    TypeList members = get_tuple_members(e->m->table, &id);
+    write_c_cstr(e, "typedef struct {\n");
+    for (u32 i = 0; i < members.len; i++) {
+        write_c_cstr(e, "    ");
+        write_c_type(e, members.elem[i]);
+        write_c_cstr(e, " m");
+        write_u64_to_output(e->out, i);
+        write_c_cstr(e, ";\n");
+    }
+    write_c_cstr(e, "} ");
+    write_c_type(e, id);
+    write_c_cstr(e, ";\n\n");
+}
+
+void write_c_signature(CEmitter *e, u32 index) {
+    const IrFunction *fn = &e->m->functions[index];
+    IrBlock entry        = fn->blocks[0];
+    write_c_cstr(e, "static ");
+    write_c_type(e, fn->result);
+    write_byte_to_output(e->out, ' ');
+    write_c_function_name(e, index);
+    write_byte_to_output(e->out, '(');
+    if (entry.params_len == 0) {
+        write_c_cstr(e, "void");
+    }
+    for (u32 i = 0; i < entry.params_len; i++) {
+        if (i != 0) {
+            write_c_cstr(e, ", ");
+        }
+        write_c_type(e, fn->values[entry.params + i]);
+        write_byte_to_output(e->out, ' ');
+        write_c_value(e, entry.params + i);
+    }
+    write_byte_to_output(e->out, ')');
+}
+
+// write_c_string_literal writes bytes as C string literal, bytes which are
+// not printable are written as octal escapes of three digits, so that they
+// cannot merge with following characters
+void write_c_string_literal(CEmitter *e, str s) {
+    write_byte_to_output(e->out, '"');
+    for (u64 i = 0; i < s.len; i++) {
+        byte b = s.bytes[i];
+        if (b >= 0x20 && b < 0x7F && b != '"' && b != '\\' && b != '?') {
+            write_byte_to_output(e->out, b);
+            continue;
+        }
+        write_byte_to_output(e->out, '\\');
+        write_byte_to_output(e->out, (byte)('0' + (b >> 6)));
+        write_byte_to_output(e->out, (byte)('0' + ((b >> 3) & 7)));
+        write_byte_to_output(e->out, (byte)('0' + (b & 7)));
+    }
+    write_byte_to_output(e->out, '"');
+}
+
+void write_c_hex(CEmitter *e, u64 n) {
+    const char *digits = "0123456789ABCDEF";
+    write_c_cstr(e, "0x");
+    for (u32 shift = 64; shift > 0; shift -= 4) {
+        write_byte_to_output(e->out, (byte)digits[(n >> (shift - 4)) & 0xF]);
+    }
+}
+
+void write_c_const(CEmitter *e, const IrInstruction *inst) {
+    u64 bits = inst->imm;
+    switch (get_vm_kind(e->m->table, inst->type)) {
+    case vk_Signed:
+        if (bits == (u64)1 << 63) {
+            write_c_cstr(e, "INT64_MIN");
+            return;
+        }
+        write_c_cstr(e, "INT64_C(");
+        if ((i64)bits < 0) {
+            write_byte_to_output(e->out, '-');
+            bits = 0 - bits;
+        }
+        write_u64_to_output(e->out, bits);
+        write_byte_to_output(e->out, ')');
+        return;
+    case vk_Unsigned:
+        write_c_cstr(e, "UINT64_C(");
+        write_u64_to_output(e->out, bits);
+        write_byte_to_output(e->out, ')');
+        return;
+    case vk_Bool:
+        write_c_cstr(e, bits != 0 ? "true" : "false");
+        return;
+    case vk_F32: {
+        // constants of both float types hold bits of f64 value
+        f64 d;
+        memcpy(&d, &bits, sizeof(f64));
+        f32 f = (f32)d;
+        u32 b;
+        memcpy(&b, &f, sizeof(u32));
+        write_c_cstr(e, "ku_f32(");
+        write_c_hex(e, b);
+        write_c_cstr(e, "u)");
+        return;
+    }
+    case vk_F64:
+        write_c_cstr(e, "ku_f64(UINT64_C(");
+        write_c_hex(e, bits);
+        write_c_cstr(e, "))");
+        return;
+    default:
+        // zero value of string type is empty string
+        write_c_cstr(e, "&ku_empty_string");
+        return;
+    }
+}
+
+// write_c_integer_operand converts operand to 64-bit integer of given
+// signedness, operations are done on such values
+void write_c_integer_operand(CEmitter *e, ValueId v, bool is_signed) {
+    write_c_cstr(e, is_signed ? "(int64_t)" : "(uint64_t)");
+    write_c_value(e, v);
+}
+
+void write_c_call_args(CEmitter *e, const ValueId *ops, u32 len) {
+    write_byte_to_output(e->out, '(');
+    for (u32 i = 0; i < len; i++) {
+        if (i != 0) {
+            write_c_cstr(e, ", ");
+        }
+        write_c_value(e, ops[i]);
+    }
+    write_byte_to_output(e->out, ')');
+}
+
+// write_c_arithmetic writes expression of unary or binary operation
+void write_c_arithmetic(CEmitter *e, const IrInstruction *inst, const ValueId *ops) {
+    VmKind kind    = get_vm_kind(e->m->table, inst->type);
+    bool is_float  = kind == vk_F32 || kind == vk_F64;
+    bool is_signed = kind == vk_Signed;
+    if (inst->op == op_Not) {
+        write_byte_to_output(e->out, '!');
+        write_c_value(e, ops[0]);
+        return;
+    }
+    if (kind == vk_Str) {
+        write_c_cstr(e, "ku_rt_concat");
+        write_c_call_args(e, ops, 2);
+        return;
+    }
+    if (is_float) {
+        if (inst->op == op_Neg) {
+            write_byte_to_output(e->out, '-');
+            write_c_value(e, ops[0]);
+            return;
+        }
+        write_c_value(e, ops[0]);
+        write_c_cstr(e, c_operators[inst->op]);
+        write_c_value(e, ops[1]);
+        return;
+    }
+
+    write_byte_to_output(e->out, '(');
+    write_c_type(e, inst->type);
+    write_byte_to_output(e->out, ')');
+    switch (inst->op) {
+    case op_Neg:
+        write_c_cstr(e, "(0 - ");
+        write_c_integer_operand(e, ops[0], false);
+        write_byte_to_output(e->out, ')');
+        return;
+    case op_BitNot:
+        write_byte_to_output(e->out, '~');
+        write_c_integer_operand(e, ops[0], false);
+        return;
+    case op_Div:
+    case op_Rem:
+        if (inst->op == op_Div) {
+            write_c_cstr(e, is_signed ? "ku_divs(" : "ku_divu(");
+        } else {
+            write_c_cstr(e, is_signed ? "ku_rems(" : "ku_remu(");
+        }
+        write_c_integer_operand(e, ops[0], is_signed);
+        write_c_cstr(e, ", ");
+        write_c_integer_operand(e, ops[1], is_signed);
+        write_c_cstr(e, ", ");
+        write_c_function_label(e);
+        write_byte_to_output(e->out, ')');
+        return;
+    case op_Shl:
+    case op_Shr:
+        if (inst->op == op_Shl) {
+            write_c_cstr(e, "ku_shl(");
+        } else {
+            write_c_cstr(e, is_signed ? "ku_shrs(" : "ku_shru(");
+        }
+        write_c_integer_operand(e, ops[0], is_signed && inst->op == op_Shr);
+        write_c_cstr(e, ", ");
+        write_c_integer_operand(e, ops[1], false);
+        write_byte_to_output(e->out, ')');
+        return;
+    case op_AndNot:
+        write_byte_to_output(e->out, '(');
+        write_c_integer_operand(e, ops[0], false);
+        write_c_cstr(e, " & ~");
+        write_c_integer_operand(e, ops[1], false);
+        write_byte_to_output(e->out, ')');
+        return;
+    default:
+        // unsigned arithmetic wraps around without undefined behavior
+        write_byte_to_output(e->out, '(');
+        write_c_integer_operand(e, ops[0], false);
+        write_c_cstr(e, c_operators[inst->op]);
+        write_c_integer_operand(e, ops[1], false);
+        write_byte_to_output(e->out, ')');
+        return;
+    }
+}
+
+void write_c_comparison(CEmitter *e, const IrInstruction *inst, const ValueId *ops) {
+    if (get_vm_kind(e->m->table, e->fn->values[ops[0]]) == vk_Str) {
+        write_c_cstr(e, "ku_rt_compare");
+        write_c_call_args(e, ops, 2);
+        write_c_cstr(e, c_operators[inst->op]);
+        write_byte_to_output(e->out, '0');
+        return;
+    }
+    write_c_value(e, ops[0]);
+    write_c_cstr(e, c_operators[inst->op]);
+    write_c_value(e, ops[1]);
+}
+
+// write_c_builtin_call fills array of print arguments, members of tuples
+// are passed separately
+void write_c_builtin_call(CEmitter *e, const IrInstruction *inst, const ValueId *ops) {
+    const TypeTable *table = e->m->table;
+    u32 len                = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        len += get_tuple_members(table, &e->fn->values[ops[i]]).len;
+    }
+    if (len == 0) {
+        write_c_cstr(e, "    ku_rt_print(");
+        write_u64_to_output(e->out, inst->imm);
+        write_c_cstr(e, ", NULL, NULL, 0);\n");
+        return;
+    }
+
+    write_c_cstr(e, "    {\n        static const uint32_t kinds[] = {");
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        TypeList members = get_tuple_members(table, &e->fn->values[ops[i]]);
+        for (u32 j = 0; j < members.len; j++) {
+            if (i != 0 || j != 0) {
+                write_c_cstr(e, ", ");
+            }
+            write_c_cstr(e, c_kind_names[get_vm_kind(table, members.elem[j])]);
+        }
+    }
+    write_c_cstr(e, "};\n        KuValue args[");
+    write_u64_to_output(e->out, len);
+    write_c_cstr(e, "];\n");
+
+    u32 next = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        TypeList members = get_tuple_members(table, &e->fn->values[ops[i]]);
+        bool tuple       = is_c_tuple(e, e->fn->values[ops[i]]);
+        for (u32 j = 0; j < members.len; j++) {
+            write_c_cstr(e, "        args[");
+            write_u64_to_output(e->out, next);
+            switch (get_vm_kind(table, members.elem[j])) {
+            case vk_Signed:
+                write_c_cstr(e, "].i = ");
+                break;
+            case vk_F32:
+            case vk_F64:
+                write_c_cstr(e, "].f = ");
+                break;
+            case vk_Str:
+                write_c_cstr(e, "].s = ");
+                break;
+            default:
+                write_c_cstr(e, "].u = ");
+                break;
+            }
+            write_c_value(e, ops[i]);
+            if (tuple) {
+                write_c_cstr(e, ".m");
+                write_u64_to_output(e->out, j);
+            }
+            write_c_cstr(e, ";\n");
+            next++;
+        }
+    }
+    write_c_cstr(e, "        ku_rt_print(");
+    write_u64_to_output(e->out, inst->imm);
+    write_c_cstr(e, ", args, kinds, ");
+    write_u64_to_output(e->out, len);
+    write_c_cstr(e, ");\n    }\n");
+}
+
+// write_c_edge assigns arguments to parameters of target block and jumps
+// there, all arguments are read before parameters are assigned
+void write_c_edge(CEmitter *e, const IrInstruction *inst, u32 index, const char *indent) {
+    u32 len;
+    const ValueId *args = get_ir_target_args(e->fn, inst, index, &len);
+    BlockId target      = inst->targets[index];
+    ValueId params      = e->fn->blocks[target].params;
+    if (len == 1) {
+        write_c_cstr(e, indent);
+        write_c_value(e, params);
+        write_c_cstr(e, " = ");
+        write_c_value(e, args[0]);
+        write_c_cstr(e, ";\n");
+    } else if (len > 1) {
+        write_c_cstr(e, indent);
+        write_c_cstr(e, "{\n");
+        for (u32 i = 0; i < len; i++) {
+            write_c_cstr(e, indent);
+            write_c_cstr(e, "    ");
+            write_c_type(e, e->fn->values[params + i]);
+            write_c_cstr(e, " t");
+            write_u64_to_output(e->out, i);
+            write_c_cstr(e, " = ");
+            write_c_value(e, args[i]);
+            write_c_cstr(e, ";\n");
+        }
+        for (u32 i = 0; i < len; i++) {
+            write_c_cstr(e, indent);
+            write_c_cstr(e, "    ");
+            write_c_value(e, params + i);
+            write_c_cstr(e, " = t");
+            write_u64_to_output(e->out, i);
+            write_c_cstr(e, ";\n");
+        }
+        write_c_cstr(e, indent);
+        write_c_cstr(e, "}\n");
+    }
+    write_c_cstr(e, indent);
+    write_c_cstr(e, "goto b");
+    write_u64_to_output(e->out, target);
+    write_c_cstr(e, ";\n");
+}
+
+void write_c_return(CEmitter *e, const IrInstruction *inst, const ValueId *ops) {
+    write_c_cstr(e, "    return");
+    if (is_c_tuple(e, e->fn->result)) {
+        write_c_cstr(e, " (");
+        write_c_type(e, e->fn->result);
+        write_c_cstr(e, "){");
+        for (u32 i = 0; i < inst->operands_len; i++) {
+            if (i != 0) {
+                write_c_cstr(e, ", ");
+            }
+            write_c_value(e, ops[i]);
+        }
+        write_byte_to_output(e->out, '}');
+    } else if (inst->operands_len == 1) {
+        write_byte_to_output(e->out, ' ');
+        write_c_value(e, ops[0]);
+    }
+    write_c_cstr(e, ";\n");
+}
+
+void write_c_instruction(CEmitter *e, const IrInstruction *inst) {
+    const ValueId *ops = e->fn->operands + inst->operands;
+    switch (inst->op) {
+    case op_CallBuiltin:
+        write_c_builtin_call(e, inst, ops);
+        return;
+    case op_Jump:
+        write_c_edge(e, inst, 0, "    ");
+        return;
+    case op_Branch:
+        write_c_cstr(e, "    if (");
+        write_c_value(e, ops[0]);
+        write_c_cstr(e, ") {\n");
+        write_c_edge(e, inst, 0, "        ");
+        write_c_cstr(e, "    }\n");
+        write_c_edge(e, inst, 1, "    ");
+        return;
+    case op_Return:
+        write_c_return(e, inst, ops);
+        return;
+    default:
+        break;
+    }
+
+    write_c_cstr(e, "    ");
+    if (inst->result != IR_NONE) {
+        write_c_value(e, inst->result);
+        write_c_cstr(e, " = ");
+    }
+    switch (inst->op) {
+    case op_Const:
+        write_c_const(e, inst);
+        break;
+    case op_String:
+        write_c_cstr(e, "&ku_str");
+        write_u64_to_output(e->out, e->fn_index);
+        write_byte_to_output(e->out, '_');
+        write_u64_to_output(e->out, inst->imm);
+        break;
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        write_c_comparison(e, inst, ops);
+        break;
+    case op_Call:
+        write_c_function_name(e, (u32)inst->imm);
+        write_c_call_args(e, ops, inst->operands_len);
+        break;
+    case op_Extract:
+        write_c_value(e, ops[0]);
+        write_c_cstr(e, ".m");
+        write_u64_to_output(e->out, inst->imm);
+        break;
+    default:
+        write_c_arithmetic(e, inst, ops);
+        break;
+    }
+    write_c_cstr(e, ";\n");
+}
+
+// write_c_strings writes string literals and name of function, they are
+// placed before function which uses them
+void write_c_strings(CEmitter *e) {
+    write_c_cstr(e, "static const char ");
+    write_c_function_label(e);
+    write_c_cstr(e, "[] = ");
+    write_c_string_literal(e, e->fn->name);
+    write_c_cstr(e, ";\n");
+    for (u32 i = 0; i < e->fn->strings_len; i++) {
+        str s = e->fn->strings[i];
+        write_c_cstr(e, "static const KuString ku_str");
+        write_u64_to_output(e->out, e->fn_index);
+        write_byte_to_output(e->out, '_');
+        write_u64_to_output(e->out, i);
+        write_c_cstr(e, " = {(const uint8_t *)");
+        write_c_string_literal(e, s);
+        write_c_cstr(e, ", ");
+        write_u64_to_output(e->out, s.len);
+        write_c_cstr(e, ", NULL};\n");
+    }
+}
+
+// write_c_function declares all values except parameters at the top of
+// function, blocks are written in reverse postorder and only blocks with
+// predecessors get labels
+void write_c_function(CEmitter *e, u32 index) {
+    const IrFunction *fn = &e->m->functions[index];
+    e->fn                = fn;
+    e->fn_index          = index;
+    IrCfg cfg            = compute_ir_cfg(fn);
+    IrBlock entry        = fn->blocks[0];
+
+    write_byte_to_output(e->out, '\n');
+    write_c_strings(e);
+    write_byte_to_output(e->out, '\n');
+    write_c_signature(e, index);
+    write_c_cstr(e, " {\n");
+    for (u32 v = 0; v < fn->values_len; v++) {
+        bool is_param = v >= entry.params && v < entry.params + entry.params_len;
+        if (is_param || get_type(e->m->table, fn->values[v]).kind == tk_Void) {
+            continue;
+        }
+        write_c_cstr(e, "    ");
+        write_c_type(e, fn->values[v]);
+        write_byte_to_output(e->out, ' ');
+        write_c_value(e, v);
+        write_c_cstr(e, ";\n");
+    }
+    write_c_cstr(e, "    KU_CHECK_STACK(");
+    write_c_function_label(e);
+    write_c_cstr(e, ")\n");
+
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        IrBlock block = fn->blocks[b];
+        if (cfg.preds_start[b + 1] != cfg.preds_start[b]) {
+            write_byte_to_output(e->out, 'b');
+            write_u64_to_output(e->out, b);
+            write_c_cstr(e, ":;\n");
+        }
+        for (u32 j = 0; j < block.len; j++) {
+            write_c_instruction(e, &fn->instructions[block.start + j]);
+        }
+    }
+    write_c_cstr(e, "}\n");
+    free_ir_cfg(&cfg);
+}
+
+void write_c_module(OutputBuffer *out, const IrModule *m, u32 entry) {
+    CEmitter e = {
+        .out        = out,
+        .m          = m,
+        .tuples     = nil,
+        .tuples_len = 0,
+        .tuples_cap = 0,
+        .fn         = nil,
+        .fn_index   = 0,
+    };
+    write_c_cstr(&e, "#include \"ku_rt.h\"\n\n");
+    for (u32 i = 0; i < m->functions_len; i++) {
+        const IrFunction *fn = &m->functions[i];
+        declare_c_tuple(&e, fn->result);
+        for (u32 v = 0; v < fn->values_len; v++) {
+            declare_c_tuple(&e, fn->values[v]);
+        }
+    }
+    for (u32 i = 0; i < m->functions_len; i++) {
+        write_c_signature(&e, i);
+        write_c_cstr(&e, ";\n");
+    }
+    for (u32 i = 0; i < m->functions_len; i++) {
+        write_c_function(&e, i);
+    }
+
+    write_c_cstr(&e, "\nvoid ku_entry(void) {\n    ");
+    write_c_function_name(&e, entry);
+    write_c_cstr(&e, "();\n}\n");
+    free_mem(e.tuples);
+}
@@ -0,0 +1,19 @@
+#ifndef KU_CGEN_H
+#define KU_CGEN_H
+
+#include "ir.h"
+#include "output.h"
+#include "types.h"
+
+// Each function of module becomes static C function "ku_f_<name>" and each
+// value a local variable of C type matching its ku type, tuples become
+// structures returned by value. Blocks are labels, block parameters are
+// assigned before jumps. Generated source includes only ku_rt.h, which
+// implements operations whose semantics differ from C, and is linked with
+// native runtime the same way as assembly of x64 backend (see x64.h)
+
+// write_c_module writes C11 source for valid IR module, entry is index of
+// function without parameters which runs the program
+void write_c_module(OutputBuffer *out, const IrModule *m, u32 entry);
+
+#endif // KU_CGEN_H
@@ -1,51 +1,1005 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "alloc.h"
+#include "bytecode.h"
+#include "cgen.h"
+#include "const_eval.h"
 #include "fatal.h"
+#include "ir.h"
+#include "jit.h"
+#include "lower.h"
+#include "opt.h"
+#include "output.h"
 #include "parser.h"
+#include "path.h"
+#include "pool.h"
+#include "resolve.h"
 #include "source.h"
+#include "syntax_json.h"
+#include "timer.h"
+#include "token_stream.h"
+#include "toolchain.h"
+#include "trace.h"
+#include "type_check.h"
+#include "vm.h"
+#include "x64.h"
 
-const str scan_cmd_name  = STR("scan");
-const str parse_cmd_name = STR("parse");
+typedef enum Command Command;
+typedef enum OutputFormat OutputFormat;
+typedef struct FileJob FileJob;
+typedef struct CmdOptions CmdOptions;
 
-void execute_scan_cmd(char *path) {
-    SourceReadResult read_result = read_source_from_file(path);
-    if (read_result.erc != 0) {
-        fatal(read_result.erc, "error reading file");
-    }
+enum Command {
+    cmd_Scan,
+    cmd_Parse,
+    cmd_Check,
+    cmd_Ir,
+    cmd_Run,
+    cmd_Build,
+    cmd_EmitC,
+};
+
+enum OutputFormat {
+    of_Text,
+
+    // token stream described in token_stream.h
+    of_Binary,
+
+    // single JSON array with object for each file
+    of_Json,
+
+    // JSON object for each token or top level node on a separate line
+    of_Ndjson,
+};
+
+// FileJob holds input and results of processing a single file, results
+// are produced by pool workers and printed by main thread in input order
+struct FileJob {
+    Task task;
+    Command command;
+    OptLevel opt_level;
+    str path;
+
+    // pool which executes the job, passes work of later phases to other workers
+    WorkerPool *pool;
+
+    SourceReadErrCode erc;
+
+    // errno of failed read, reported by main thread in input order
+    int read_err;
+
+    slice_of_Tokens tokens;
+    StandaloneSourceTree tree;
+
+    // syntax error which stopped parsing, text is nil if there is none
+    ParseError parse_error;
+
+    slice_of_ResolveErrors errors;
+    TypeTable types;
+    slice_of_TypeErrors type_errors;
+    IrModule module;
+    slice_of_LowerErrors lower_errors;
+
+    // first problem found by IR verifier, empty if there is none
+    str ir_error;
+
+    // bytecode of optimized module, compiled only by run command
+    BcProgram program;
+};
+
+// CmdOptions holds values of flags given on command line
+struct CmdOptions {
+    // number of pool workers, 0 means default
+    u32 threads;
+
+    // print per-phase timing report to stderr
+    bool time;
+
+    // print per-phase hardware counters report to stderr
+    bool counters;
+
+    // print allocation counters and peak memory usage to stderr
+    bool mem_stats;
+
+    // print counts of executed bytecode instructions to stderr
+    bool profile;
+
+    // keep all functions in bytecode instead of compiling hot ones
+    bool no_jit;
+
+    // path of output file for trace events, empty if tracing is disabled
+    str trace_path;
+
+    OutputFormat format;
+
+    // include line table into binary token stream
+    bool line_table;
+
+    OptLevel opt_level;
 
-    Scanner *scanner = new_scanner_from_source(read_result.source);
+    // optimization level was given explicitly, otherwise commands which
+    // execute code use full optimization
+    bool opt_level_given;
+
+    // path of executable produced by build and emit-c commands
+    str output_path;
+};
+
+const str scan_cmd_name   = STR("scan");
+const str parse_cmd_name  = STR("parse");
+const str check_cmd_name  = STR("check");
+const str ir_cmd_name     = STR("ir");
+const str run_cmd_name    = STR("run");
+const str build_cmd_name  = STR("build");
+const str emit_c_cmd_name = STR("emit-c");
+
+const str source_file_ext    = STR(".ku");
+const str asm_file_ext       = STR(".s");
+const str c_file_ext         = STR(".c");
+const str main_function_name = STR("main");
+const str current_dir        = STR(".");
+const str file_title         = STR("file: ");
+
+const str flag_prefix         = STR("-");
+const str threads_flag_prefix = STR("--threads=");
+const str time_flag           = STR("--time");
+const str trace_flag_prefix   = STR("--trace=");
+const str counters_flag       = STR("--counters");
+const str mem_stats_flag      = STR("--mem-stats");
+const str profile_flag        = STR("--profile");
+const str no_jit_flag         = STR("--no-jit");
+const str format_flag_prefix  = STR("--format=");
+const str line_table_flag     = STR("--line-table");
+const str opt_flag_prefix     = STR("-O");
+const str output_flag         = STR("-o");
+
+const str text_format_name   = STR("text");
+const str binary_format_name = STR("bin");
+const str json_format_name   = STR("json");
+const str ndjson_format_name = STR("ndjson");
+
+const str file_json_key       = STR("file");
+const str token_json_key      = STR("token");
+const str tokens_json_key     = STR("tokens");
+const str function_json_key   = STR("function");
+const str functions_json_key  = STR("functions");
+const str statement_json_key  = STR("statement");
+const str statements_json_key = STR("statements");
+const str error_json_key      = STR("error");
+const str message_json_key    = STR("message");
+
+void scan_file_job(FileJob *job, SourceText source) {
+    PhaseScope scope = begin_phase(ph_Scan, job->path);
+    Scanner scanner  = init_scanner_from_source(source);
 
     Token token;
     do {
-        token = scan_token(scanner);
-        print_token(token);
+        token = scan_token(&scanner);
+        append_Token_to_slice(&job->tokens, token);
     } while (token.type != tt_EOF);
+    end_phase(scope, source.text.len, job->tokens.len);
 }
 
-void execute_parse_cmd(char *path) {
+void parse_file_job(FileJob *job, SourceText source) {
+    PhaseScope scope                   = begin_phase(ph_Parse, job->path);
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(source.text);
+    job->tree                          = parse_result.tree;
+    if (!parse_result.ok) {
+        job->parse_error = parse_result.error;
+    }
+    end_phase(scope, source.text.len, parse_result.tokens);
+}
+
+// check_file_job runs semantic phases only for files without syntax errors
+void check_file_job(FileJob *job, SourceText source) {
+    parse_file_job(job, source);
+    if (job->parse_error.text != nil) {
+        return;
+    }
+
+    PhaseScope scope     = begin_phase(ph_Resolve, job->path);
+    ResolveResult result = resolve_standalone_source_tree(job->pool, &job->tree);
+    job->errors          = result.errors;
+    end_phase(scope, source.text.len, 0);
+
+    scope                  = begin_phase(ph_Check, job->path);
+    job->types             = new_type_table();
+    TypeCheckResult checks = check_standalone_source_tree(&job->types, &job->tree);
+    job->type_errors       = checks.errors;
+    end_phase(scope, source.text.len, 0);
+
+    scope             = begin_phase(ph_Fold, job->path);
+    FoldResult folded = fold_standalone_source_tree(&job->types, &job->tree);
+    for (u32 i = 0; i < folded.errors.len; i++) {
+        append_TypeError_to_slice(&job->type_errors, folded.errors.elem[i]);
+    }
+    free_slice_of_TypeErrors(folded.errors);
+    end_phase(scope, source.text.len, 0);
+}
+
+void verify_file_job_module(FileJob *job) {
+    for (u32 i = 0; i < job->module.functions_len && job->ir_error.len == 0; i++) {
+        job->ir_error = verify_ir_function(&job->module, &job->module.functions[i]);
+    }
+}
+
+// lower_file_job produces intermediate representation only for files
+// without errors, each function is verified after lowering and again after
+// optimization
+void lower_file_job(FileJob *job, SourceText source) {
+    check_file_job(job, source);
+    if (job->parse_error.text != nil || job->errors.len != 0 || job->type_errors.len != 0) {
+        return;
+    }
+
+    PhaseScope scope   = begin_phase(ph_Lower, job->path);
+    LowerResult result = lower_standalone_source_tree(&job->types, &job->tree);
+    job->module        = result.module;
+    job->lower_errors  = result.errors;
+    verify_file_job_module(job);
+    end_phase(scope, source.text.len, 0);
+
+    if (job->lower_errors.len != 0 || job->ir_error.len != 0) {
+        return;
+    }
+    optimize_ir_module(&job->module, job->opt_level, job->path);
+    verify_file_job_module(job);
+}
+
+void compile_file_job(FileJob *job, SourceText source) {
+    lower_file_job(job, source);
+    if (job->module.functions_len == 0 || job->lower_errors.len != 0 || job->ir_error.len != 0) {
+        return;
+    }
+
+    PhaseScope scope = begin_phase(ph_Compile, job->path);
+    job->program     = compile_ir_module(&job->module);
+    end_phase(scope, source.text.len, 0);
+}
+
+void execute_file_job(void *arg) {
+    FileJob *job = (FileJob *)arg;
+
+    PhaseScope scope             = begin_phase(ph_Read, job->path);
+    char *path                   = str_to_cstr(job->path);
     SourceReadResult read_result = read_source_from_file(path);
-    if (read_result.erc != 0) {
-        fatal(read_result.erc, "error reading file");
+    free_mem(path);
+    job->erc      = read_result.erc;
+    job->read_err = read_result.err;
+    if (read_result.erc != srec_NotAnError) {
+        end_phase(scope, 0, 0);
+        return;
     }
-    parse_standalone_source_from_str(read_result.source.text);
+    end_phase(scope, read_result.source.text.len, 0);
+
+    switch (job->command) {
+    case cmd_Scan:
+        scan_file_job(job, read_result.source);
+        break;
+    case cmd_Parse:
+        parse_file_job(job, read_result.source);
+        break;
+    case cmd_Check:
+        check_file_job(job, read_result.source);
+        break;
+    case cmd_Ir:
+        lower_file_job(job, read_result.source);
+        break;
+    case cmd_Run:
+        compile_file_job(job, read_result.source);
+        break;
+    case cmd_Build:
+    case cmd_EmitC:
+        lower_file_job(job, read_result.source);
+        break;
+    }
+
+    // token literals are copied by scanner, so text is not needed anymore
+    free_source(read_result.source);
+}
+
+void begin_ndjson_line(JsonWriter *w, str path, str key) {
+    begin_json_object(w);
+    write_json_key(w, file_json_key);
+    write_json_str(w, path);
+    write_json_key(w, key);
+}
+
+void end_ndjson_line(JsonWriter *w) {
+    end_json_object(w);
+    write_byte_to_output(w->out, '\n');
+}
+
+// write_scan_json writes tokens of the file as one object in JSON format or
+// as separate line for each token in NDJSON format
+void write_scan_json(JsonWriter *w, FileJob *job, OutputFormat format) {
+    if (format == of_Ndjson) {
+        for (u32 i = 0; i < job->tokens.len; i++) {
+            begin_ndjson_line(w, job->path, token_json_key);
+            write_token_json(w, job->tokens.elem[i]);
+            end_ndjson_line(w);
+        }
+        return;
+    }
+
+    begin_json_object(w);
+    write_json_key(w, file_json_key);
+    write_json_str(w, job->path);
+    write_json_key(w, tokens_json_key);
+    begin_json_array(w);
+    for (u32 i = 0; i < job->tokens.len; i++) {
+        write_token_json(w, job->tokens.elem[i]);
+    }
+    end_json_array(w);
+    end_json_object(w);
+}
+
+// write_parse_json writes syntax tree of the file as one object in JSON format
+// or as separate line for each top level node in NDJSON format
+void write_parse_json(JsonWriter *w, FileJob *job, OutputFormat format) {
+    StandaloneSourceTree tree = job->tree;
+    if (format == of_Ndjson) {
+        for (u32 i = 0; i < tree.functions.len; i++) {
+            begin_ndjson_line(w, job->path, function_json_key);
+            write_function_definition_json(w, tree.functions.elem[i]);
+            end_ndjson_line(w);
+        }
+        for (u32 i = 0; i < tree.statements.len; i++) {
+            begin_ndjson_line(w, job->path, statement_json_key);
+            write_statement_json(w, tree.statements.elem[i]);
+            end_ndjson_line(w);
+        }
+        return;
+    }
+
+    begin_json_object(w);
+    write_json_key(w, file_json_key);
+    write_json_str(w, job->path);
+    write_json_key(w, functions_json_key);
+    begin_json_array(w);
+    for (u32 i = 0; i < tree.functions.len; i++) {
+        write_function_definition_json(w, tree.functions.elem[i]);
+    }
+    end_json_array(w);
+    write_json_key(w, statements_json_key);
+    begin_json_array(w);
+    for (u32 i = 0; i < tree.statements.len; i++) {
+        write_statement_json(w, tree.statements.elem[i]);
+    }
+    end_json_array(w);
+    end_json_object(w);
+}
+
+void write_parse_error_json_value(JsonWriter *w, ParseError err) {
+    begin_json_object(w);
+    write_json_key(w, message_json_key);
+    write_json_str(w, take_str_from_cstr((char *)err.text));
+    write_json_position(w, err.token.pos);
+    end_json_object(w);
+}
+
+// write_parse_error_json writes syntax error which stopped parsing of the file
+// in place of its tree, so that each file is represented in the output
+void write_parse_error_json(JsonWriter *w, FileJob *job, OutputFormat format) {
+    if (format == of_Ndjson) {
+        begin_ndjson_line(w, job->path, error_json_key);
+        write_parse_error_json_value(w, job->parse_error);
+        end_ndjson_line(w);
+        return;
+    }
+
+    begin_json_object(w);
+    write_json_key(w, file_json_key);
+    write_json_str(w, job->path);
+    write_json_key(w, error_json_key);
+    write_parse_error_json_value(w, job->parse_error);
+    end_json_object(w);
+}
+
+bool is_json_format(OutputFormat format) {
+    return format == of_Json || format == of_Ndjson;
+}
+
+void print_error_position(FileJob *job, Position pos) {
+    fprintf(stderr, "%.*s:%u:%u: ", (int)job->path.len, (char *)job->path.bytes, pos.line, pos.column);
+}
+
+// print_parse_error reports syntax error which stopped parsing of the file,
+// returns false if there was one
+bool print_parse_error(OutputBuffer *out, FileJob *job) {
+    if (job->parse_error.text == nil) {
+        return true;
+    }
+    // keep order of results and errors when both go to terminal
+    flush_output(out);
+    print_error_position(job, job->parse_error.token.pos);
+    fprintf(stderr, "%s\n", job->parse_error.text);
+    return false;
+}
+
+// print_check_errors reports errors found in the file in the form
+// "path:line:column: message", returns false if there were any
+bool print_check_errors(OutputBuffer *out, FileJob *job) {
+    if (!print_parse_error(out, job)) {
+        // semantic phases were skipped, so there is nothing else to report
+        return false;
+    }
+    bool ok = job->errors.len == 0 && job->type_errors.len == 0;
+    if (!ok) {
+        // keep order of results and errors when both go to terminal
+        flush_output(out);
+    }
+    for (u32 i = 0; i < job->errors.len; i++) {
+        ResolveError err = job->errors.elem[i];
+        str message      = resolve_error_messages[err.type];
+        print_error_position(job, err.pos);
+        fprintf(stderr, "%.*s: %.*s\n", (int)message.len, (char *)message.bytes, (int)err.name.len,
+            (char *)err.name.bytes);
+    }
+    for (u32 i = 0; i < job->type_errors.len; i++) {
+        TypeError err = job->type_errors.elem[i];
+        str message   = format_type_error(&job->types, err);
+        print_error_position(job, err.pos);
+        fprintf(stderr, "%.*s\n", (int)message.len, (char *)message.bytes);
+        free_str(message);
+    }
+    free_slice_of_ResolveErrors(job->errors);
+    free_slice_of_TypeErrors(job->type_errors);
+    free_type_table(&job->types);
+    return ok;
+}
+
+// print_lower_errors reports errors of all phases up to lowering and frees
+// their results, returns false if there were any
+bool print_lower_errors(OutputBuffer *out, FileJob *job) {
+    bool ok = job->lower_errors.len == 0 && job->ir_error.len == 0;
+    if (!ok) {
+        // keep order of results and errors when both go to terminal
+        flush_output(out);
+    }
+    for (u32 i = 0; i < job->lower_errors.len; i++) {
+        LowerError err = job->lower_errors.elem[i];
+        str message    = format_lower_error(err);
+        print_error_position(job, err.pos);
+        fprintf(stderr, "%.*s\n", (int)message.len, (char *)message.bytes);
+        free_str(message);
+    }
+    if (job->ir_error.len != 0) {
+        fprintf(stderr, "%.*s: invalid intermediate representation: %.*s\n", (int)job->path.len,
+            (char *)job->path.bytes, (int)job->ir_error.len, (char *)job->ir_error.bytes);
+    }
+    free_str(job->ir_error);
+    free_slice_of_LowerErrors(job->lower_errors);
+    free_ir_module(&job->module);
+    return print_check_errors(out, job) && ok;
+}
+
+// print_ir_file_job writes intermediate representation of file, errors of
+// all phases go to stderr
+bool print_ir_file_job(OutputBuffer *out, FileJob *job) {
+    if (job->lower_errors.len == 0 && job->ir_error.len == 0) {
+        write_ir_module(out, &job->module);
+    }
+    return print_lower_errors(out, job);
+}
+
+void print_run_error(FileJob *job, const char *format, str s) {
+    fprintf(stderr, "%.*s: ", (int)job->path.len, (char *)job->path.bytes);
+    fprintf(stderr, format, (int)s.len, (char *)s.bytes);
+    fprintf(stderr, "\n");
+}
+
+// run_file_job executes function main of the file, program prints directly
+// into command output. Profile report is printed after output of the program.
+// Zero jit_threshold disables native compilation of hot functions
+bool run_file_job(OutputBuffer *out, FileJob *job, bool profile, u32 jit_threshold) {
+    bool ok = print_lower_errors(out, job);
+    if (!ok) {
+        free_bc_program(&job->program);
+        return false;
+    }
+
+    u32 entry = find_bc_function(&job->program, main_function_name);
+    if (entry == IR_NONE) {
+        print_run_error(job, "function %.*s is not defined", main_function_name);
+        ok = false;
+    } else if (job->program.functions[entry].params != 0) {
+        print_run_error(job, "function %.*s must not have parameters", main_function_name);
+        ok = false;
+    } else {
+        VmProfile *counts = profile ? new_vm_profile() : nil;
+        PhaseScope scope  = begin_phase(ph_Run, job->path);
+        VmRuntime rt      = init_vm_runtime(out);
+        VmResult result   = run_bc_program(&job->program, entry, &rt, counts, jit_threshold);
+        free_vm_runtime(&rt);
+        end_phase(scope, 0, 0);
+        if (!result.ok || profile) {
+            // keep order of program output and reports when both go to terminal
+            flush_output(out);
+        }
+        if (!result.ok) {
+            print_run_error(job, "runtime error: %.*s", result.error);
+            free_str(result.error);
+            ok = false;
+        }
+        if (profile) {
+            print_vm_profile_report(counts);
+            free_vm_profile(counts);
+        }
+    }
+    free_bc_program(&job->program);
+    return ok;
+}
+
+// write_native_source writes assembly or C source of module into file at
+// given path, depending on command
+bool write_native_source(FileJob *job, u32 entry, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "error creating file %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    PhaseScope scope = begin_phase(ph_Codegen, job->path);
+    OutputBuffer out = new_output_buffer(fd, default_output_buffer_cap);
+    if (job->command == cmd_EmitC) {
+        write_c_module(&out, &job->module, entry);
+    } else {
+        write_x64_module(&out, &job->module, entry);
+    }
+    bool ok = flush_output(&out);
+    end_phase(scope, 0, 0);
+    if (!ok) {
+        fprintf(stderr, "error writing file %s: %s\n", path, strerror(errno));
+    }
+    free_output_buffer(&out);
+    close(fd);
+    return ok;
+}
+
+// compile_native_source runs C compiler on generated source, C source is
+// optimized by the compiler and includes runtime header from toolchain
+// directory
+bool compile_native_source(FileJob *job, const char *src_path, const char *out_path) {
+    str runtime   = get_native_runtime_path();
+    char *rt_path = str_to_cstr(runtime);
+    str dir       = get_toolchain_dir();
+    char *include = dir.len == 0 ? str_to_cstr(current_dir) : str_to_cstr(dir);
+
+    const char *const asm_args[] = {"-o", out_path, src_path, rt_path, nil};
+    const char *const c_args[]   = {"-O2", c_recursion_flag, "-I", include, "-o", out_path, src_path, rt_path, nil};
+    PhaseScope scope             = begin_phase(ph_Link, job->path);
+    bool ok                      = run_c_compiler(job->command == cmd_EmitC ? c_args : asm_args);
+    end_phase(scope, 0, 0);
+
+    free_mem(include);
+    free_str(dir);
+    free_mem(rt_path);
+    free_str(runtime);
+    return ok;
+}
+
+// build_native_program compiles function main of the file into executable,
+// generated source is kept only if output path itself ends with ".s" for
+// build command or ".c" for emit-c command
+bool build_native_program(FileJob *job, str output) {
+    u32 entry = find_ir_function(&job->module, main_function_name);
+    if (entry == IR_NONE) {
+        print_run_error(job, "function %.*s is not defined", main_function_name);
+        return false;
+    }
+    if (get_tuple_members(&job->types, &job->module.functions[entry].params).len != 0) {
+        print_run_error(job, "function %.*s must not have parameters", main_function_name);
+        return false;
+    }
+
+    str ext        = job->command == cmd_EmitC ? c_file_ext : asm_file_ext;
+    bool src_only  = output.len > ext.len && has_substr_at(output, ext, output.len - ext.len);
+    char *out_path = str_to_cstr(output);
+    if (src_only) {
+        bool ok = write_native_source(job, entry, out_path);
+        free_mem(out_path);
+        return ok;
+    }
+
+    char *src_path = (char *)alloc_mem(at_String, output.len + ext.len + 1);
+    if (src_path == nil) {
+        fatal(1, "not enough memory for source path");
+    }
+    memcpy(src_path, output.bytes, output.len);
+    memcpy(src_path + output.len, ext.bytes, ext.len);
+    src_path[output.len + ext.len] = 0;
+
+    bool ok = write_native_source(job, entry, src_path);
+    if (ok) {
+        ok = compile_native_source(job, src_path, out_path);
+        if (!ok) {
+            print_run_error(job, "error linking executable %.*s", output);
+        }
+    }
+    unlink(src_path);
+    free_mem(src_path);
+    free_mem(out_path);
+    return ok;
+}
+
+// build_file_job produces executable only for files without errors, errors
+// of all phases are reported as by ir command
+bool build_file_job(OutputBuffer *out, FileJob *job, str output) {
+    bool ok = true;
+    if (job->parse_error.text == nil && job->errors.len == 0 && job->type_errors.len == 0 &&
+        job->lower_errors.len == 0 && job->ir_error.len == 0) {
+        ok = build_native_program(job, output);
+    }
+    return print_lower_errors(out, job) && ok;
+}
+
+void print_read_error(OutputBuffer *out, FileJob *job) {
+    // keep order of results and errors when both go to terminal
+    flush_output(out);
+    fprintf(stderr,
+        "error reading file: %.*s: %s\n",
+        (int)job->path.len,
+        (char *)job->path.bytes,
+        describe_source_read_error(job->erc, job->read_err));
+}
+
+// print_file_job returns false if file has errors which must be reflected in
+// exit code
+bool print_file_job(JsonWriter *w, FileJob *job, CmdOptions options) {
+    if (job->erc != srec_NotAnError) {
+        print_read_error(w->out, job);
+        return false;
+    }
+
+    PhaseScope scope = begin_phase(ph_Print, job->path);
+    u64 tokens       = 0;
+    bool ok          = true;
+    switch (job->command) {
+    case cmd_Scan:
+        tokens = job->tokens.len;
+        if (options.format == of_Binary) {
+            write_token_stream(w->out, job->tokens, options.line_table);
+        } else if (is_json_format(options.format)) {
+            write_scan_json(w, job, options.format);
+        }
+        for (u32 i = 0; i < job->tokens.len; i++) {
+            if (options.format == of_Text) {
+                write_token(w->out, job->tokens.elem[i]);
+            }
+            free_token(job->tokens.elem[i]);
+        }
+        free_slice_of_Tokens(job->tokens);
+        break;
+    case cmd_Parse:
+        if (is_json_format(options.format)) {
+            ok = job->parse_error.text == nil;
+            if (ok) {
+                write_parse_json(w, job, options.format);
+            } else {
+                write_parse_error_json(w, job, options.format);
+            }
+            break;
+        }
+        ok = print_parse_error(w->out, job);
+        if (ok) {
+            print_standalone_source_tree(w->out, job->tree);
+        }
+        break;
+    case cmd_Check:
+        ok = print_check_errors(w->out, job);
+        break;
+    case cmd_Ir:
+        ok = print_ir_file_job(w->out, job);
+        break;
+    case cmd_Run:
+        ok = run_file_job(w->out, job, options.profile, options.no_jit ? 0 : jit_default_threshold);
+        break;
+    case cmd_Build:
+    case cmd_EmitC:
+        ok = build_file_job(w->out, job, options.output_path);
+        break;
+    }
+    end_phase(scope, 0, tokens);
+    return ok;
+}
+
+void parse_cmd_flag(CmdOptions *options, str flag) {
+    if (has_prefix_str(flag, threads_flag_prefix)) {
+        str value          = borrow_str_slice_to_end(flag, threads_flag_prefix.len);
+        U32ParseResult res = parse_u32_from_decimal(value);
+        if (!res.ok || res.num == 0) {
+            fatal(1, "invalid number of threads");
+        }
+        options->threads = res.num;
+        return;
+    }
+    if (are_strs_equal(flag, time_flag)) {
+        options->time = true;
+        return;
+    }
+    if (are_strs_equal(flag, counters_flag)) {
+        options->counters = true;
+        return;
+    }
+    if (are_strs_equal(flag, mem_stats_flag)) {
+        options->mem_stats = true;
+        return;
+    }
+    if (are_strs_equal(flag, profile_flag)) {
+        options->profile = true;
+        return;
+    }
+    if (are_strs_equal(flag, no_jit_flag)) {
+        options->no_jit = true;
+        return;
+    }
+    if (has_prefix_str(flag, format_flag_prefix)) {
+        str value = borrow_str_slice_to_end(flag, format_flag_prefix.len);
+        if (are_strs_equal(value, text_format_name)) {
+            options->format = of_Text;
+        } else if (are_strs_equal(value, binary_format_name)) {
+            options->format = of_Binary;
+        } else if (are_strs_equal(value, json_format_name)) {
+            options->format = of_Json;
+        } else if (are_strs_equal(value, ndjson_format_name)) {
+            options->format = of_Ndjson;
+        } else {
+            fatal(1, "unknown output format");
+        }
+        return;
+    }
+    if (are_strs_equal(flag, line_table_flag)) {
+        options->line_table = true;
+        return;
+    }
+    if (has_prefix_str(flag, opt_flag_prefix)) {
+        str value          = borrow_str_slice_to_end(flag, opt_flag_prefix.len);
+        U32ParseResult res = parse_u32_from_decimal(value);
+        if (!res.ok || res.num > ol_Full) {
+            fatal(1, "unknown optimization level");
+        }
+        options->opt_level       = (OptLevel)res.num;
+        options->opt_level_given = true;
+        return;
+    }
+    if (has_prefix_str(flag, trace_flag_prefix)) {
+        options->trace_path = borrow_str_slice_to_end(flag, trace_flag_prefix.len);
+        if (options->trace_path.len == 0) {
+            fatal(1, "empty trace file path");
+        }
+        return;
+    }
+    fatal(1, "unknown flag");
+}
+
+// collect_input_files expands directories from command line arguments into
+// lists of source files, other arguments are taken as is. Flags may be placed
+// anywhere among arguments
+slice_of_strs collect_input_files(int argc, char **argv, CmdOptions *options) {
+    slice_of_strs files = empty_slice_of_strs;
+    for (int i = 0; i < argc; i++) {
+        str arg = take_str_from_cstr(argv[i]);
+        if (are_strs_equal(arg, output_flag)) {
+            if (i + 1 == argc) {
+                fatal(1, "missing output path");
+            }
+            i++;
+            options->output_path = take_str_from_cstr(argv[i]);
+        } else if (has_prefix_str(arg, flag_prefix)) {
+            parse_cmd_flag(options, arg);
+        } else if (is_dir_path(arg)) {
+            append_dir_files_with_ext(arg, source_file_ext, &files);
+        } else {
+            append_str_to_slice(&files, new_str_from_str(arg));
+        }
+    }
+    return files;
+}
+
+// execute_files_cmd processes all files on worker pool and prints their
+// results in the same order files were given
+int execute_files_cmd(Command command, slice_of_strs files, CmdOptions options) {
+    FileJob *jobs = (FileJob *)alloc_mem(at_Other, files.len * sizeof(FileJob));
+    if (jobs == nil) {
+        fatal(1, "not enough memory for file jobs");
+    }
+
+    u32 threads = options.threads;
+    if (threads == 0) {
+        threads = get_default_worker_count();
+    }
+    WorkerPool *pool = new_worker_pool(threads);
+    OutputBuffer out = new_output_buffer(STDOUT_FILENO, default_output_buffer_cap);
+    JsonWriter json  = init_json_writer(&out);
+
+    // tasks are spawned in reverse order, because owner takes them from the
+    // bottom of its deque, this way main thread starts with the first file
+    // while other workers steal from the end of the list
+    for (u32 i = files.len; i > 0; i--) {
+        FileJob *job = &jobs[i - 1];
+        job->command      = command;
+        job->opt_level    = options.opt_level;
+        job->path         = files.elem[i - 1];
+        job->pool         = pool;
+        job->erc          = srec_NotAnError;
+        job->read_err     = 0;
+        job->tokens       = empty_slice_of_Tokens;
+        job->tree         = empty_standalone_source_tree;
+        job->parse_error  = (ParseError){.text = nil};
+        job->errors       = empty_slice_of_ResolveErrors;
+        job->type_errors  = empty_slice_of_TypeErrors;
+        job->module       = empty_ir_module;
+        job->lower_errors = empty_slice_of_LowerErrors;
+        job->ir_error     = empty_str;
+        job->program      = empty_bc_program;
+        spawn_task(pool, &job->task, execute_file_job, job);
+    }
+
+    if (options.format == of_Json) {
+        begin_json_array(&json);
+    }
+    int code = 0;
+    for (u32 i = 0; i < files.len; i++) {
+        FileJob *job = &jobs[i];
+        join_task(pool, &job->task);
+
+        // binary streams of several files are simply concatenated
+        if (files.len > 1 && options.format == of_Text) {
+            write_str_to_output(&out, file_title);
+            write_line_str_to_output(&out, job->path);
+        }
+        if (!print_file_job(&json, job, options)) {
+            code = 1;
+        }
+        free_str(job->path);
+    }
+    if (options.format == of_Json) {
+        end_json_array(&json);
+        write_byte_to_output(&out, '\n');
+    }
+
+    if (!flush_output(&out)) {
+        fprintf(stderr, "error writing output: %s\n", strerror(errno));
+        code = 1;
+    }
+    free_output_buffer(&out);
+    free_worker_pool(pool);
+    free_mem(jobs);
+    return code;
 }
 
 int main(int argc, char **argv) {
+    u64 wall_start = get_wall_time_ns();
     if (argc < 3) {
         fatal(1, "not enough arguments");
     }
 
-    init_token_module();
-
     str cmd_str = take_str_from_cstr(argv[1]);
-    char *path  = argv[2];
 
+    Command command;
     if (are_strs_equal(scan_cmd_name, cmd_str)) {
-        execute_scan_cmd(path);
+        command = cmd_Scan;
     } else if (are_strs_equal(parse_cmd_name, cmd_str)) {
-        execute_parse_cmd(path);
+        command = cmd_Parse;
+    } else if (are_strs_equal(check_cmd_name, cmd_str)) {
+        command = cmd_Check;
+    } else if (are_strs_equal(ir_cmd_name, cmd_str)) {
+        command = cmd_Ir;
+    } else if (are_strs_equal(run_cmd_name, cmd_str)) {
+        command = cmd_Run;
+    } else if (are_strs_equal(build_cmd_name, cmd_str)) {
+        command = cmd_Build;
+    } else if (are_strs_equal(emit_c_cmd_name, cmd_str)) {
+        command = cmd_EmitC;
     } else {
         fatal(1, "unknown command");
     }
-    return 0;
+
+    CmdOptions options = {
+        .threads         = 0,
+        .time            = false,
+        .counters        = false,
+        .mem_stats       = false,
+        .profile         = false,
+        .no_jit          = false,
+        .trace_path      = empty_str,
+        .format          = of_Text,
+        .line_table      = false,
+        .opt_level       = ol_None,
+        .opt_level_given = false,
+        .output_path     = empty_str,
+    };
+    slice_of_strs files = collect_input_files(argc - 2, argv + 2, &options);
+    if (files.len == 0) {
+        fatal(1, "no input files");
+    }
+    if (options.format == of_Binary && command != cmd_Scan) {
+        fatal(1, "binary output format is supported only by scan command");
+    }
+    if (options.format != of_Text && command == cmd_Check) {
+        fatal(1, "check command supports only text output format");
+    }
+    if (options.format != of_Text && command == cmd_Ir) {
+        fatal(1, "ir command supports only text output format");
+    }
+    if (options.format != of_Text && command == cmd_Run) {
+        fatal(1, "run command supports only text output format");
+    }
+    if (files.len != 1 && command == cmd_Run) {
+        fatal(1, "run command takes exactly one file");
+    }
+    if (options.format != of_Text && command == cmd_Build) {
+        fatal(1, "build command supports only text output format");
+    }
+    if (files.len != 1 && command == cmd_Build) {
+        fatal(1, "build command takes exactly one file");
+    }
+    if (options.output_path.len == 0 && command == cmd_Build) {
+        fatal(1, "build command requires output path given with -o flag");
+    }
+    if (options.format != of_Text && command == cmd_EmitC) {
+        fatal(1, "emit-c command supports only text output format");
+    }
+    if (files.len != 1 && command == cmd_EmitC) {
+        fatal(1, "emit-c command takes exactly one file");
+    }
+    if (options.output_path.len == 0 && command == cmd_EmitC) {
+        fatal(1, "emit-c command requires output path given with -o flag");
+    }
+    if (options.output_path.len != 0 && command != cmd_Build && command != cmd_EmitC) {
+        fatal(1, "output flag is supported only by build and emit-c commands");
+    }
+    if (options.profile && command != cmd_Run) {
+        fatal(1, "profile flag is supported only by run command");
+    }
+    if (options.no_jit && command != cmd_Run) {
+        fatal(1, "no-jit flag is supported only by run command");
+    }
+    if (!options.opt_level_given && (command == cmd_Run || command == cmd_Build || command == cmd_EmitC)) {
+        options.opt_level = ol_Full;
+    }
+    if (options.time) {
+        enable_phase_timing();
+    }
+    if (options.counters) {
+        enable_hardware_counters();
+    }
+    if (options.mem_stats) {
+        enable_mem_stats();
+    }
+    if (options.trace_path.len != 0) {
+        enable_tracing();
+    }
+
+    int code = execute_files_cmd(command, files, options);
+    free_slice_of_strs(files);
+
+    // worker threads are stopped at this point, so their trace buffers may be written
+    if (options.trace_path.len != 0) {
+        char *path = str_to_cstr(options.trace_path);
+        if (!write_trace_file(path)) {
+            fprintf(stderr, "error writing trace file: %s\n", path);
+            code = 1;
+        }
+        free_mem(path);
+    }
+    // flush results first, so that reports are not mixed with them
+    if (options.time || options.counters || options.mem_stats) {
+        fflush(stdout);
+    }
+    if (options.time) {
+        print_phase_timing_report(get_wall_time_ns() - wall_start, get_process_cpu_time_ns());
+    }
+    if (options.counters) {
+        print_phase_counters_report();
+    }
+    if (options.mem_stats) {
+        print_mem_stats_report();
+    }
+    return code;
 }
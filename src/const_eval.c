@@ -0,0 +1,625 @@
+#include <math.h>
+
+#include "const_eval.h"
+
+typedef struct ConstantFolder ConstantFolder;
+
+struct ConstantFolder {
+    const TypeTable *table;
+
+    slice_of_TypeErrors errors;
+};
+
+const Constant no_constant = {
+    .kind = ck_None,
+};
+
+void add_fold_error(ConstantFolder *f, TypeErrorType type, Position pos, TypeId want) {
+    TypeError err = {
+        .type = type,
+        .pos  = pos,
+        .name = empty_str,
+        .want = want,
+        .got  = 0,
+    };
+    append_TypeError_to_slice(&f->errors, err);
+}
+
+Constant new_integer_constant(u64 v) {
+    Constant c = {
+        .kind          = ck_Integer,
+        .value.integer = v,
+    };
+    return c;
+}
+
+Constant new_float_constant(f64 v) {
+    Constant c = {
+        .kind       = ck_Float,
+        .value.real = v,
+    };
+    return c;
+}
+
+Constant new_bool_constant(bool v) {
+    Constant c = {
+        .kind          = ck_Bool,
+        .value.integer = v ? 1 : 0,
+    };
+    return c;
+}
+
+bool is_untyped_type(TypeId id) {
+    return id == ti_UntypedInteger || id == ti_UntypedFloat;
+}
+
+bool is_zero_constant(Constant c) {
+    switch (c.kind) {
+    case ck_Integer:
+        return c.value.integer == 0;
+    case ck_Float:
+        return fpclassify(c.value.real) == FP_ZERO;
+    default:
+        return false;
+    }
+}
+
+// get_float_value gives value of untyped integer or float constant as float
+f64 get_float_value(Constant c) {
+    if (c.kind == ck_Integer) {
+        return (f64)(i64)c.value.integer;
+    }
+    return c.value.real;
+}
+
+u64 wrap_integer(Type type, u64 v) {
+    u32 bits = type.size * 8;
+    if (bits >= 64) {
+        return v;
+    }
+    if (type.kind == tk_Signed) {
+        u32 shift = 64 - bits;
+        return (u64)((i64)(v << shift) >> shift);
+    }
+    return v & ((1ULL << bits) - 1);
+}
+
+bool is_integer_in_range(Type type, i64 v) {
+    u32 bits = type.size * 8;
+    if (type.kind == tk_Signed) {
+        if (bits >= 64) {
+            return true;
+        }
+        i64 limit = (i64)1 << (bits - 1);
+        return v >= -limit && v < limit;
+    }
+    return v >= 0 && (bits >= 64 || (u64)v >> bits == 0);
+}
+
+// round_float gives value as it is stored in variable of float type
+f64 round_float(Type type, f64 v) {
+    if (type.size == 4) {
+        return (f64)(f32)v;
+    }
+    return v;
+}
+
+// convert_constant turns value of untyped expression into value of concrete
+// type, reports error if it does not fit
+Constant convert_constant(ConstantFolder *f, Constant c, TypeId from, TypeId to, Position pos) {
+    if (from == to || !is_untyped_type(from) || is_untyped_type(to)) {
+        return c;
+    }
+    Type type = get_type(f->table, to);
+    switch (type.kind) {
+    case tk_Signed:
+    case tk_Unsigned:
+        if (c.kind != ck_Integer) {
+            return no_constant;
+        }
+        if (!is_integer_in_range(type, (i64)c.value.integer)) {
+            add_fold_error(f, tet_Overflow, pos, to);
+            return no_constant;
+        }
+        return c;
+    case tk_Float: {
+        f64 v = get_float_value(c);
+        f64 r = round_float(type, v);
+        if (isinf(r) && !isinf(v)) {
+            add_fold_error(f, tet_Overflow, pos, to);
+            return no_constant;
+        }
+        return new_float_constant(r);
+    }
+    default:
+        return c;
+    }
+}
+
+Constant fold_expression(ConstantFolder *f, Expression *expr);
+
+Constant fold_integer_literal(ConstantFolder *f, Expression *expr) {
+    Token token = ((Integer *)expr->ptr)->token;
+    u64 v       = token.value.integer;
+    if (expr->type_id == ti_UntypedInteger) {
+        if ((i64)v < 0) {
+            TypeError err = {
+                .type = tet_Overflow,
+                .pos  = token.pos,
+                .name = token.literal,
+                .want = ti_UntypedInteger,
+                .got  = 0,
+            };
+            append_TypeError_to_slice(&f->errors, err);
+            return no_constant;
+        }
+        return new_integer_constant(v);
+    }
+
+    // literals which do not fit into their type are reported by type checker
+    Type type = get_type(f->table, expr->type_id);
+    switch (type.kind) {
+    case tk_Signed:
+    case tk_Unsigned:
+        return new_integer_constant(wrap_integer(type, v));
+    case tk_Float:
+        return new_float_constant(round_float(type, (f64)v));
+    default:
+        return no_constant;
+    }
+}
+
+Constant fold_float_literal(ConstantFolder *f, Expression *expr) {
+    f64 v = ((Float *)expr->ptr)->token.value.real;
+    if (expr->type_id == ti_UntypedFloat) {
+        return new_float_constant(v);
+    }
+    Type type = get_type(f->table, expr->type_id);
+    if (type.kind != tk_Float) {
+        return no_constant;
+    }
+    return convert_constant(f, new_float_constant(v), ti_UntypedFloat, expr->type_id, get_expression_position(*expr));
+}
+
+Constant fold_unary_value(ConstantFolder *f, TokenType operator, TypeId type_id, Constant x, Position pos) {
+    if (operator == tt_Not) {
+        return new_bool_constant(x.value.integer == 0);
+    }
+    if (operator == tt_Plus) {
+        return x;
+    }
+
+    Type type = get_type(f->table, type_id);
+    if (x.kind == ck_Float) {
+        // only "-" is defined on floats
+        return new_float_constant(-x.value.real);
+    }
+    if (type_id == ti_UntypedInteger) {
+        i64 v = (i64)x.value.integer;
+        if (operator == tt_Caret) {
+            return new_integer_constant((u64)~v);
+        }
+        if (v == INT64_MIN) {
+            add_fold_error(f, tet_Overflow, pos, ti_UntypedInteger);
+            return no_constant;
+        }
+        return new_integer_constant((u64)-v);
+    }
+    if (operator == tt_Caret) {
+        return new_integer_constant(wrap_integer(type, ~x.value.integer));
+    }
+    return new_integer_constant(wrap_integer(type, 0 - x.value.integer));
+}
+
+Constant fold_unary(ConstantFolder *f, Expression *expr) {
+    UnaryExpression *unary = (UnaryExpression *)expr->ptr;
+    Constant x             = fold_expression(f, &unary->operand);
+    if (x.kind == ck_None || expr->type_id == ti_Invalid) {
+        return no_constant;
+    }
+    TypeId from  = unary->operand.type_id;
+    Position pos = unary->operator.pos;
+    Constant c   = fold_unary_value(f, unary->operator.type, from, x, pos);
+    if (c.kind == ck_None) {
+        return c;
+    }
+    return convert_constant(f, c, from, expr->type_id, pos);
+}
+
+// get_operation_type gives type in which binary operation is performed, it
+// differs from operand types only when untyped integer meets untyped float
+TypeId get_operation_type(BinaryExpression *binary) {
+    TypeId left  = binary->left.type_id;
+    TypeId right = binary->right.type_id;
+    if (binary->operator.type == tt_LeftShift || binary->operator.type == tt_RightShift) {
+        return left;
+    }
+    if (left != right && (left == ti_UntypedFloat || right == ti_UntypedFloat)) {
+        return ti_UntypedFloat;
+    }
+    return left;
+}
+
+Constant compare_integers(TokenType operator, bool is_signed, u64 a, u64 b) {
+    bool less  = is_signed ? (i64)a < (i64)b : a < b;
+    bool equal = a == b;
+    switch (operator) {
+    case tt_Equal:
+        return new_bool_constant(equal);
+    case tt_NotEqual:
+        return new_bool_constant(!equal);
+    case tt_Less:
+        return new_bool_constant(less);
+    case tt_LessOrEqual:
+        return new_bool_constant(less || equal);
+    case tt_Greater:
+        return new_bool_constant(!less && !equal);
+    case tt_GreaterOrEqual:
+        return new_bool_constant(!less);
+    default:
+        return no_constant;
+    }
+}
+
+// compare_floats must give false for any comparison with NaN except "!="
+Constant compare_floats(TokenType operator, f64 a, f64 b) {
+    bool equal = a <= b && a >= b;
+    switch (operator) {
+    case tt_Equal:
+        return new_bool_constant(equal);
+    case tt_NotEqual:
+        return new_bool_constant(!equal);
+    case tt_Less:
+        return new_bool_constant(a < b);
+    case tt_LessOrEqual:
+        return new_bool_constant(a <= b);
+    case tt_Greater:
+        return new_bool_constant(a > b);
+    case tt_GreaterOrEqual:
+        return new_bool_constant(a >= b);
+    default:
+        return no_constant;
+    }
+}
+
+// fold_untyped_integer reports any result which does not fit into 64-bit
+// signed integer instead of wrapping it. Count of shift is never negative
+Constant fold_untyped_integer(ConstantFolder *f, TokenType operator, i64 a, i64 b, Position pos) {
+    i64 r         = 0;
+    bool overflow = false;
+    switch (operator) {
+    case tt_Plus:
+        overflow = __builtin_add_overflow(a, b, &r);
+        break;
+    case tt_Minus:
+        overflow = __builtin_sub_overflow(a, b, &r);
+        break;
+    case tt_Asterisk:
+        overflow = __builtin_mul_overflow(a, b, &r);
+        break;
+    case tt_Slash:
+        overflow = a == INT64_MIN && b == -1;
+        r        = overflow ? 0 : a / b;
+        break;
+    case tt_Percent:
+        r = b == -1 ? 0 : a % b;
+        break;
+    case tt_Ampersand:
+        r = a & b;
+        break;
+    case tt_Pipe:
+        r = a | b;
+        break;
+    case tt_Caret:
+        r = a ^ b;
+        break;
+    case tt_BitwiseAndNot:
+        r = a & ~b;
+        break;
+    case tt_LeftShift:
+        if (b >= 64) {
+            overflow = a != 0;
+        } else {
+            r        = (i64)((u64)a << b);
+            overflow = r >> b != a;
+        }
+        break;
+    case tt_RightShift:
+        if (b >= 64) {
+            r = a < 0 ? -1 : 0;
+        } else {
+            r = a >> b;
+        }
+        break;
+    default:
+        return compare_integers(operator, true, (u64)a, (u64)b);
+    }
+    if (overflow) {
+        add_fold_error(f, tet_Overflow, pos, ti_UntypedInteger);
+        return no_constant;
+    }
+    return new_integer_constant((u64)r);
+}
+
+Constant fold_typed_integer(Type type, TokenType operator, u64 a, u64 b) {
+    bool is_signed = type.kind == tk_Signed;
+    u32 bits       = type.size * 8;
+    u64 r          = 0;
+    switch (operator) {
+    case tt_Plus:
+        r = a + b;
+        break;
+    case tt_Minus:
+        r = a - b;
+        break;
+    case tt_Asterisk:
+        r = a * b;
+        break;
+    case tt_Slash:
+        if (!is_signed) {
+            r = a / b;
+        } else if ((i64)b == -1) {
+            // minimal value divided by -1 wraps to itself instead of trapping
+            r = 0 - a;
+        } else {
+            r = (u64)((i64)a / (i64)b);
+        }
+        break;
+    case tt_Percent:
+        if (!is_signed) {
+            r = a % b;
+        } else if ((i64)b != -1) {
+            r = (u64)((i64)a % (i64)b);
+        }
+        break;
+    case tt_Ampersand:
+        r = a & b;
+        break;
+    case tt_Pipe:
+        r = a | b;
+        break;
+    case tt_Caret:
+        r = a ^ b;
+        break;
+    case tt_BitwiseAndNot:
+        r = a & ~b;
+        break;
+    case tt_LeftShift:
+        if (b < bits) {
+            r = a << b;
+        }
+        break;
+    case tt_RightShift:
+        if (!is_signed) {
+            r = b < bits ? a >> b : 0;
+        } else {
+            // sign fills all bits when count exceeds width
+            r = (u64)((i64)a >> (b < bits ? b : 63));
+        }
+        break;
+    default:
+        return compare_integers(operator, is_signed, a, b);
+    }
+    return new_integer_constant(wrap_integer(type, r));
+}
+
+Constant fold_float(ConstantFolder *f, TypeId type_id, TokenType operator, f64 a, f64 b, Position pos) {
+    f64 r = 0;
+    switch (operator) {
+    case tt_Plus:
+        r = a + b;
+        break;
+    case tt_Minus:
+        r = a - b;
+        break;
+    case tt_Asterisk:
+        r = a * b;
+        break;
+    case tt_Slash:
+        r = a / b;
+        break;
+    default:
+        return compare_floats(operator, a, b);
+    }
+    if (type_id != ti_UntypedFloat) {
+        r = round_float(get_type(f->table, type_id), r);
+    }
+    if (isinf(r) && !isinf(a) && !isinf(b)) {
+        add_fold_error(f, tet_Overflow, pos, type_id);
+        return no_constant;
+    }
+    return new_float_constant(r);
+}
+
+Constant fold_bool(TokenType operator, bool a, bool b) {
+    switch (operator) {
+    case tt_Equal:
+        return new_bool_constant(a == b);
+    case tt_NotEqual:
+        return new_bool_constant(a != b);
+    case tt_LogicalAnd:
+        return new_bool_constant(a && b);
+    case tt_LogicalOr:
+        return new_bool_constant(a || b);
+    default:
+        return no_constant;
+    }
+}
+
+Constant fold_binary_value(ConstantFolder *f, BinaryExpression *binary, TypeId type_id, Constant x, Constant y) {
+    TokenType operator = binary->operator.type;
+    Position pos       = get_expression_position(binary->left);
+
+    if (operator == tt_LeftShift || operator == tt_RightShift) {
+        bool is_signed_count = binary->right.type_id == ti_UntypedInteger ||
+                               get_type(f->table, binary->right.type_id).kind == tk_Signed;
+        if (is_signed_count && (i64)y.value.integer < 0) {
+            add_fold_error(f, tet_InvalidShift, get_expression_position(binary->right), 0);
+            return no_constant;
+        }
+    }
+
+    Type type = get_type(f->table, type_id);
+    switch (type.kind) {
+    case tk_UntypedInteger: {
+        // shift count does not fit into i64 only if it is huge unsigned
+        i64 b = (i64)y.value.integer;
+        if ((operator == tt_LeftShift || operator == tt_RightShift) && b < 0) {
+            b = INT64_MAX;
+        }
+        return fold_untyped_integer(f, operator, (i64)x.value.integer, b, pos);
+    }
+    case tk_Signed:
+    case tk_Unsigned:
+        return fold_typed_integer(type, operator, x.value.integer, y.value.integer);
+    case tk_UntypedFloat:
+    case tk_Float:
+        return fold_float(f, type_id, operator, get_float_value(x), get_float_value(y), pos);
+    case tk_Bool:
+        return fold_bool(operator, x.value.integer != 0, y.value.integer != 0);
+    default:
+        return no_constant;
+    }
+}
+
+Constant fold_binary(ConstantFolder *f, Expression *expr) {
+    BinaryExpression *binary = (BinaryExpression *)expr->ptr;
+    TokenType operator       = binary->operator.type;
+    Constant x               = fold_expression(f, &binary->left);
+    Constant y               = fold_expression(f, &binary->right);
+    if (expr->type_id == ti_Invalid) {
+        return no_constant;
+    }
+
+    // divisor known at compile time must not be zero even if dividend is not
+    if ((operator == tt_Slash || operator == tt_Percent) && is_zero_constant(y)) {
+        add_fold_error(f, tet_DivisionByZero, get_expression_position(binary->right), 0);
+        return no_constant;
+    }
+
+    // logical operators do not need right operand if left one decides result
+    if (x.kind == ck_Bool && operator == tt_LogicalAnd && x.value.integer == 0) {
+        return new_bool_constant(false);
+    }
+    if (x.kind == ck_Bool && operator == tt_LogicalOr && x.value.integer != 0) {
+        return new_bool_constant(true);
+    }
+
+    if (x.kind == ck_None || y.kind == ck_None) {
+        return no_constant;
+    }
+    TypeId type_id = get_operation_type(binary);
+    Constant c     = fold_binary_value(f, binary, type_id, x, y);
+    if (c.kind == ck_None || c.kind == ck_Bool) {
+        return c;
+    }
+    return convert_constant(f, c, type_id, expr->type_id, get_expression_position(binary->left));
+}
+
+Constant fold_expression(ConstantFolder *f, Expression *expr) {
+    Constant c = no_constant;
+    switch (expr->type) {
+    case et_IntegerLiteral:
+        c = fold_integer_literal(f, expr);
+        break;
+    case et_FloatLiteral:
+        c = fold_float_literal(f, expr);
+        break;
+    case et_Call: {
+        slice_of_Expressions args = ((CallExpression *)expr->ptr)->args;
+        for (u32 i = 0; i < args.len; i++) {
+            fold_expression(f, &args.elem[i]);
+        }
+        break;
+    }
+    case et_Unary:
+        c = fold_unary(f, expr);
+        break;
+    case et_Binary:
+        c = fold_binary(f, expr);
+        break;
+    default:
+        break;
+    }
+    expr->constant = c;
+    return c;
+}
+
+void fold_expressions(ConstantFolder *f, slice_of_Expressions exprs) {
+    for (u32 i = 0; i < exprs.len; i++) {
+        fold_expression(f, &exprs.elem[i]);
+    }
+}
+
+void fold_statements(ConstantFolder *f, slice_of_Statements stmts);
+
+void fold_if_statement(ConstantFolder *f, IfStatement *istmt) {
+    for (u32 i = 0; i < istmt->clauses.len; i++) {
+        fold_expression(f, &istmt->clauses.elem[i].condition);
+        fold_statements(f, istmt->clauses.elem[i].body.statements);
+    }
+    if (istmt->else_body != nil) {
+        fold_statements(f, istmt->else_body->statements);
+    }
+}
+
+void fold_statement(ConstantFolder *f, Statement stmt) {
+    switch (stmt.type) {
+    case st_Define:
+        fold_expressions(f, ((DefineStatement *)stmt.ptr)->right);
+        break;
+    case st_Expression:
+        fold_expression(f, (Expression *)stmt.ptr);
+        break;
+    case st_Block:
+        fold_statements(f, ((BlockStatement *)stmt.ptr)->statements);
+        break;
+    case st_Assign:
+        fold_expressions(f, ((AssignStatement *)stmt.ptr)->right);
+        break;
+    case st_Return:
+        fold_expressions(f, ((ReturnStatement *)stmt.ptr)->values);
+        break;
+    case st_If:
+        fold_if_statement(f, (IfStatement *)stmt.ptr);
+        break;
+    case st_Loop: {
+        LoopStatement *lstmt = (LoopStatement *)stmt.ptr;
+        if (lstmt->count.ptr != nil) {
+            fold_expression(f, &lstmt->count);
+        }
+        fold_statements(f, lstmt->body.statements);
+        break;
+    }
+    case st_While: {
+        WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+        fold_expression(f, &wstmt->condition);
+        fold_statements(f, wstmt->body.statements);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void fold_statements(ConstantFolder *f, slice_of_Statements stmts) {
+    for (u32 i = 0; i < stmts.len; i++) {
+        fold_statement(f, stmts.elem[i]);
+    }
+}
+
+FoldResult fold_standalone_source_tree(const TypeTable *table, StandaloneSourceTree *tree) {
+    ConstantFolder f = {
+        .table  = table,
+        .errors = empty_slice_of_TypeErrors,
+    };
+    for (u32 i = 0; i < tree->functions.len; i++) {
+        fold_statements(&f, tree->functions.elem[i].body.statements);
+    }
+    fold_statements(&f, tree->statements);
+
+    FoldResult result = {
+        .errors = f.errors,
+    };
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef KU_CONST_EVAL_H
+#define KU_CONST_EVAL_H
+
+#include "ast.h"
+#include "slice.h"
+#include "type_check.h"
+#include "type_table.h"
+#include "types.h"
+
+typedef struct FoldResult FoldResult;
+
+struct FoldResult {
+    // overflows, divisions by zero and negative shifts found in constant
+    // expressions, in order of definition
+    slice_of_TypeErrors errors;
+};
+
+// fold_standalone_source_tree evaluates expressions whose operands are known
+// at compile time and caches their values in Expression.constant. Tree must
+// be already processed by type checker.
+//
+// Values of typed expressions wrap around to the width of their type, as they
+// would at runtime. Untyped integer expressions are evaluated exactly within
+// 64-bit signed range and any overflow is reported, so is a result which does
+// not fit into the type it is converted to
+FoldResult fold_standalone_source_tree(const TypeTable *table, StandaloneSourceTree *tree);
+
+// wrap_integer truncates 64-bit pattern to the width of integer type, value
+// of signed type is sign-extended back to 64 bits
+u64 wrap_integer(Type type, u64 v);
+
+// fold_typed_integer applies binary operator to integer operands of given type
+// with the same result as it would have at runtime: overflow wraps around,
+// minimal signed value divided by -1 gives itself and shift by count not less
+// than type width gives 0 or -1. Divisor must not be zero
+Constant fold_typed_integer(Type type, TokenType operator, u64 a, u64 b);
+
+#endif // KU_CONST_EVAL_H
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const_eval.h"
+#include "parser.h"
+#include "resolve.h"
+#include "type_check.h"
+
+typedef struct ConstEvalTestCase ConstEvalTestCase;
+typedef struct WrapTestCase WrapTestCase;
+
+struct ConstEvalTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    // first reported error in the form "line:column: message" or type and
+    // folded value of the last statement of the last function, it is value
+    // of the first right side expression for define statement and of the
+    // first argument for call statement
+    str want;
+};
+
+// WrapTestCase checks evaluation of typed operands, which have no constant
+// source in the language yet
+struct WrapTestCase {
+    u64 id;
+    TypeId type;
+    TokenType operator;
+    i64 a;
+    i64 b;
+    i64 want;
+};
+
+const u32 number_of_test_cases = 12;
+
+const ConstEvalTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("hexadecimal literal division"),
+        .input = STR("fn f() {\n    x := 0xff / 2\n}\n"),
+        .want  = STR("i64 127"),
+    },
+    {
+        .id    = 2,
+        .label = STR("shift and bit clear"),
+        .input = STR("fn f() {\n    x := (0xff << 4) &^ 0xf0\n}\n"),
+        .want  = STR("i64 3840"),
+    },
+    {
+        .id    = 3,
+        .label = STR("precedence of operators"),
+        .input = STR("fn f() {\n    x := 2 + 3 * 4 - 10 / 3\n}\n"),
+        .want  = STR("i64 11"),
+    },
+    {
+        .id    = 4,
+        .label = STR("comparison and logical operators"),
+        .input = STR("fn f() {\n    x := 0xff / 2 > 100 && 3 != 4\n}\n"),
+        .want  = STR("bool true"),
+    },
+    {
+        .id    = 5,
+        .label = STR("unary operators bind stronger"),
+        .input = STR("fn f() {\n    x := -0x80 ^ 3\n}\n"),
+        .want  = STR("i64 -125"),
+    },
+    {
+        .id    = 6,
+        .label = STR("untyped integer meets untyped float"),
+        .input = STR("fn f() {\n    x := 1 + 0.5\n}\n"),
+        .want  = STR("f64 1.5"),
+    },
+    {
+        .id    = 7,
+        .label = STR("rounding to f32"),
+        .input = STR("fn g(a: f32) {}\n\nfn f() {\n    g(0.1)\n}\n"),
+        .want  = STR("f32 0.10000000149011612"),
+    },
+    {
+        .id    = 8,
+        .label = STR("non-constant operand"),
+        .input = STR("fn f(a: u8) {\n    x := a + 1\n}\n"),
+        .want  = STR("u8 none"),
+    },
+    {
+        .id    = 9,
+        .label = STR("division by zero"),
+        .input = STR("fn f() {\n    x := 1 / (2 - 2)\n}\n"),
+        .want  = STR("2:15: division by zero"),
+    },
+    {
+        .id    = 10,
+        .label = STR("untyped overflow"),
+        .input = STR("fn f() {\n    x := (-0x7fff_ffff_ffff_ffff - 1) / -1\n}\n"),
+        .want  = STR("2:11: constant overflows untyped integer"),
+    },
+    {
+        .id    = 11,
+        .label = STR("result does not fit into parameter"),
+        .input = STR("fn g(a: u8) {}\n\nfn f() {\n    g(0xff + 1)\n}\n"),
+        .want  = STR("4:7: constant overflows u8"),
+    },
+    {
+        .id    = 12,
+        .label = STR("negative shift count"),
+        .input = STR("fn f() {\n    x := 1 << -1\n}\n"),
+        .want  = STR("2:15: negative shift count"),
+    },
+};
+
+const u32 number_of_wrap_test_cases = 8;
+
+const WrapTestCase wrap_test_cases[] = {
+    {.id = 1, .type = ti_U8, .operator = tt_Plus, .a = 200, .b = 100, .want = 44},
+    {.id = 2, .type = ti_I8, .operator = tt_Plus, .a = 127, .b = 1, .want = -128},
+    {.id = 3, .type = ti_I8, .operator = tt_Slash, .a = -128, .b = -1, .want = -128},
+    {.id = 4, .type = ti_I64, .operator = tt_Percent, .a = INT64_MIN, .b = -1, .want = 0},
+    {.id = 5, .type = ti_U16, .operator = tt_LeftShift, .a = 1, .b = 16, .want = 0},
+    {.id = 6, .type = ti_I16, .operator = tt_RightShift, .a = -5, .b = 40, .want = -1},
+    {.id = 7, .type = ti_U32, .operator = tt_Minus, .a = 0, .b = 1, .want = 0xffffffff},
+    {.id = 8, .type = ti_I32, .operator = tt_BitwiseAndNot, .a = -1, .b = 0xff, .want = -256},
+};
+
+const str pass_str = STR("    const_eval_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+const str wrap_label = STR("typed integer wrap");
+
+void print_failed_test_case(u64 id, str label, str want, str got) {
+    str id_str = format_u64_as_decimal(id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+str format_first_error(const TypeTable *table, slice_of_TypeErrors errors) {
+    TypeError err = errors.elem[0];
+    str message   = format_type_error(table, err);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%u:%u: %.*s", err.pos.line, err.pos.column, (int)message.len, (char *)message.bytes);
+    free_str(message);
+    return new_str_from_cstr(buf);
+}
+
+Expression get_checked_expression(const StandaloneSourceTree *tree) {
+    slice_of_Statements stmts = tree->functions.elem[tree->functions.len - 1].body.statements;
+    Statement stmt            = stmts.elem[stmts.len - 1];
+    if (stmt.type == st_Define) {
+        return ((DefineStatement *)stmt.ptr)->right.elem[0];
+    }
+    Expression call = *(Expression *)stmt.ptr;
+    return ((CallExpression *)call.ptr)->args.elem[0];
+}
+
+str format_constant(const TypeTable *table, Expression expr) {
+    char buf[64];
+    Constant c = expr.constant;
+    switch (c.kind) {
+    case ck_Integer:
+        if (get_type(table, expr.type_id).kind == tk_Unsigned) {
+            snprintf(buf, sizeof(buf), " %llu", (unsigned long long)c.value.integer);
+        } else {
+            snprintf(buf, sizeof(buf), " %lld", (long long)c.value.integer);
+        }
+        break;
+    case ck_Float:
+        snprintf(buf, sizeof(buf), " %.17g", c.value.real);
+        break;
+    case ck_Bool:
+        snprintf(buf, sizeof(buf), " %s", c.value.integer != 0 ? "true" : "false");
+        break;
+    default:
+        snprintf(buf, sizeof(buf), " none");
+        break;
+    }
+
+    slice_of_bytes b = empty_slice_of_bytes;
+    append_type_to_bytes(&b, table, expr.type_id);
+    append_cstr_to_bytes(&b, buf);
+    str s = new_str_from_bytes(b.elem, b.len);
+    free_slice_of_bytes(b);
+    return s;
+}
+
+bool run_test_case(ConstEvalTestCase test_case) {
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(test_case.input);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult check_result       = check_standalone_source_tree(&table, &parse_result.tree);
+    FoldResult result                  = fold_standalone_source_tree(&table, &parse_result.tree);
+
+    str got;
+    if (result.errors.len != 0) {
+        got = format_first_error(&table, result.errors);
+    } else {
+        got = format_constant(&table, get_checked_expression(&parse_result.tree));
+    }
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || check_result.errors.len != 0 ||
+                  !are_strs_equal(got, test_case.want);
+    if (failed) {
+        print_failed_test_case(test_case.id, test_case.label, test_case.want, got);
+    }
+
+    free_str(got);
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(check_result.errors);
+    free_slice_of_TypeErrors(result.errors);
+    free_type_table(&table);
+    return failed;
+}
+
+bool run_wrap_test_case(const TypeTable *table, WrapTestCase test_case) {
+    Type type  = get_type(table, test_case.type);
+    u64 a      = wrap_integer(type, (u64)test_case.a);
+    u64 b      = wrap_integer(type, (u64)test_case.b);
+    u64 want   = wrap_integer(type, (u64)test_case.want);
+    Constant c = fold_typed_integer(type, test_case.operator, a, b);
+    if (c.kind == ck_Integer && c.value.integer == want) {
+        return false;
+    }
+    str want_num = format_u64_as_decimal(want);
+    str got_num  = format_u64_as_decimal(c.value.integer);
+    print_failed_test_case(test_case.id, wrap_label, want_num, got_num);
+    free_str(want_num);
+    free_str(got_num);
+    return true;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    TypeTable table = new_type_table();
+    for (u32 i = 0; i < number_of_wrap_test_cases; i++) {
+        bool failed = run_wrap_test_case(&table, wrap_test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    free_type_table(&table);
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include <stdio.h>
+
+#include "corpus.h"
+
+// Generated programs contain only constructs which current parser is able
+// to consume: definitions and calls with a single operand, everything else
+// is placed into statements which parser skips token by token
+
+const char *corpus_shape_names[] = {
+    [cs_Identifiers]    = "identifiers",
+    [cs_Numbers]        = "numbers",
+    [cs_Comments]       = "comments",
+    [cs_Strings]        = "strings",
+    [cs_Nesting]        = "nesting",
+    [cs_SmallFunctions] = "small_functions",
+};
+
+const char *name_syllables[] = {
+    "alpha", "buf", "count", "data", "elem", "flag", "gen", "hash", "index", "join", "key", "len",
+    "map", "node", "offset", "pos", "queue", "read", "size", "tok", "unit", "val", "width", "next",
+};
+
+const char *type_names[] = {"i32", "u64", "str", "bool", "u8", "f64"};
+
+const char *comment_words[] = {
+    "scanner", "returns", "the", "next", "token", "from", "source", "text", "and", "advances",
+    "position", "of", "reader", "until", "first", "byte", "which", "does", "not", "belong",
+};
+
+const char *string_pieces[] = {
+    "hello", "world", "\\\"quoted\\\"", "\\t", "\\n", "path\\\\to\\\\file", "{}", "value: ", "   ", "ok",
+};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+bool parse_corpus_shape(str name, CorpusShape *shape) {
+    for (u32 i = 0; i < cs_end; i++) {
+        if (are_strs_equal(name, take_str_from_cstr((char *)corpus_shape_names[i]))) {
+            *shape = (CorpusShape)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+u64 next_corpus_random(CorpusGenerator *g) {
+    u64 x = g->seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    g->seed = x;
+    return x;
+}
+
+// random_below returns pseudo-random number in range [0, n)
+u32 random_below(CorpusGenerator *g, u32 n) {
+    return (u32)(next_corpus_random(g) % n);
+}
+
+void emit(CorpusGenerator *g, const char *s) {
+    append_cstr_to_bytes(&g->text, s);
+}
+
+void emit_u64(CorpusGenerator *g, u64 n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)n);
+    emit(g, buf);
+}
+
+void emit_indent(CorpusGenerator *g, u32 depth) {
+    for (u32 i = 0; i < depth; i++) {
+        emit(g, "    ");
+    }
+}
+
+void emit_name(CorpusGenerator *g, u32 syllables) {
+    for (u32 i = 0; i < syllables; i++) {
+        if (i != 0) {
+            emit(g, "_");
+        }
+        emit(g, name_syllables[random_below(g, ARRAY_LEN(name_syllables))]);
+    }
+}
+
+void emit_short_name(CorpusGenerator *g) {
+    emit_name(g, 1 + random_below(g, 2));
+}
+
+void emit_long_name(CorpusGenerator *g) {
+    emit_name(g, 2 + random_below(g, 3));
+    emit_u64(g, random_below(g, 1000));
+}
+
+void emit_type(CorpusGenerator *g) {
+    emit(g, type_names[random_below(g, ARRAY_LEN(type_names))]);
+}
+
+void emit_function_header(CorpusGenerator *g, u32 params) {
+    emit(g, "fn ");
+    emit_short_name(g);
+    emit(g, "_f");
+    emit_u64(g, g->functions);
+    g->functions++;
+    emit(g, "(");
+    for (u32 i = 0; i < params; i++) {
+        if (i != 0) {
+            emit(g, ", ");
+        }
+        emit_short_name(g);
+        emit_u64(g, i);
+    }
+    if (params != 0) {
+        emit(g, ": ");
+        emit_type(g);
+    }
+    emit(g, ")");
+    if (random_below(g, 2) == 0) {
+        emit(g, " => ");
+        emit_type(g);
+    }
+    emit(g, " {\n");
+}
+
+void emit_function_footer(CorpusGenerator *g) {
+    emit(g, "}\n\n");
+}
+
+void emit_number(CorpusGenerator *g) {
+    char buf[40];
+    u64 n = next_corpus_random(g) >> (random_below(g, 48) + 8);
+    switch (random_below(g, 5)) {
+    case 0:
+        snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)n);
+        break;
+    case 1:
+        snprintf(buf, sizeof(buf), "0o%llo", (unsigned long long)(n & 0xFFFFF));
+        break;
+    case 2:
+        snprintf(buf, sizeof(buf), "0b");
+        for (u32 i = 0; i < 12; i++) {
+            buf[2 + i] = (char)('0' + ((n >> i) & 1));
+        }
+        buf[14] = 0;
+        break;
+    case 3:
+        snprintf(buf, sizeof(buf), "%llu.%llu", (unsigned long long)(n % 100000), (unsigned long long)(n % 997));
+        break;
+    default:
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)n);
+    }
+    emit(g, buf);
+}
+
+void emit_string(CorpusGenerator *g) {
+    emit(g, "\"");
+    u32 pieces = 1 + random_below(g, 6);
+    for (u32 i = 0; i < pieces; i++) {
+        emit(g, string_pieces[random_below(g, ARRAY_LEN(string_pieces))]);
+    }
+    emit(g, "\"");
+}
+
+void emit_comment(CorpusGenerator *g, u32 depth) {
+    emit_indent(g, depth);
+    emit(g, "//");
+    u32 words = 3 + random_below(g, 12);
+    for (u32 i = 0; i < words; i++) {
+        emit(g, " ");
+        emit(g, comment_words[random_below(g, ARRAY_LEN(comment_words))]);
+    }
+    emit(g, "\n");
+}
+
+void generate_identifiers_unit(CorpusGenerator *g) {
+    emit_function_header(g, 1 + random_below(g, 4));
+    u32 lines = 8 + random_below(g, 9);
+    for (u32 i = 0; i < lines; i++) {
+        bool call = random_below(g, 2) == 0;
+        emit(g, "    ");
+        emit_long_name(g);
+        emit(g, call ? "(" : " := ");
+        emit_long_name(g);
+        emit(g, call ? ")\n" : "\n");
+    }
+    emit_function_footer(g);
+}
+
+void generate_numbers_unit(CorpusGenerator *g) {
+    emit_function_header(g, 0);
+    u32 lines = 4 + random_below(g, 5);
+    for (u32 i = 0; i < lines; i++) {
+        emit(g, "    total");
+        emit_u64(g, i);
+        emit(g, " := ");
+        emit_u64(g, next_corpus_random(g) >> 40);
+        emit(g, "\n    total");
+        emit_u64(g, i);
+        emit(g, " = ");
+        u32 terms = 4 + random_below(g, 6);
+        for (u32 j = 0; j < terms; j++) {
+            if (j != 0) {
+                emit(g, j % 2 == 0 ? " + " : " * ");
+            }
+            emit_number(g);
+        }
+        emit(g, "\n");
+    }
+    emit_function_footer(g);
+}
+
+void generate_comments_unit(CorpusGenerator *g) {
+    u32 lines = 3 + random_below(g, 6);
+    for (u32 i = 0; i < lines; i++) {
+        emit_comment(g, 0);
+    }
+    emit_function_header(g, 1);
+    lines = 2 + random_below(g, 4);
+    for (u32 i = 0; i < lines; i++) {
+        emit_comment(g, 1);
+        emit(g, "    ");
+        emit_short_name(g);
+        emit(g, " := ");
+        emit_u64(g, random_below(g, 100));
+        emit(g, "\n");
+    }
+    emit_function_footer(g);
+}
+
+void generate_strings_unit(CorpusGenerator *g) {
+    emit_function_header(g, 0);
+    u32 lines = 4 + random_below(g, 8);
+    for (u32 i = 0; i < lines; i++) {
+        emit(g, "    ");
+        if (random_below(g, 2) == 0) {
+            emit(g, "println(");
+            emit_string(g);
+            emit(g, ")\n");
+        } else {
+            emit_short_name(g);
+            emit(g, " := ");
+            emit_string(g);
+            emit(g, "\n");
+        }
+    }
+    emit_function_footer(g);
+}
+
+void generate_nesting_unit(CorpusGenerator *g) {
+    emit_function_header(g, 1);
+    u32 depth = 6 + random_below(g, 11);
+    for (u32 i = 1; i <= depth; i++) {
+        emit_indent(g, i);
+        emit(g, "level");
+        emit_u64(g, i);
+        emit(g, " := ");
+        emit_u64(g, i);
+        emit(g, "\n");
+        emit_indent(g, i);
+        if (random_below(g, 2) == 0) {
+            emit(g, "if level");
+            emit_u64(g, i);
+            emit(g, " == ");
+            emit_u64(g, random_below(g, 100));
+            emit(g, " {\n");
+        } else {
+            emit(g, "loop level");
+            emit_u64(g, i);
+            emit(g, " {\n");
+        }
+    }
+    emit_indent(g, depth + 1);
+    emit(g, "print(level");
+    emit_u64(g, depth);
+    emit(g, ")\n");
+    for (u32 i = depth; i >= 1; i--) {
+        emit_indent(g, i);
+        emit(g, "}\n");
+    }
+    emit_function_footer(g);
+}
+
+void generate_small_functions_unit(CorpusGenerator *g) {
+    emit_function_header(g, random_below(g, 3));
+    if (random_below(g, 3) != 0) {
+        emit(g, "    ");
+        emit_short_name(g);
+        emit(g, "(");
+        emit_u64(g, random_below(g, 10));
+        emit(g, ")\n");
+    }
+    emit_function_footer(g);
+}
+
+// generate_corpus returns deterministic program of given shape, generation stops at
+// the end of the first function which makes program at least size bytes long
+str generate_corpus(CorpusShape shape, u64 size, u64 seed) {
+    CorpusGenerator g = {
+        .text      = empty_slice_of_bytes,
+        .seed      = seed == 0 ? 1 : seed,
+        .functions = 0,
+    };
+
+    emit(&g, "// generated ");
+    emit(&g, corpus_shape_names[shape]);
+    emit(&g, " corpus\n\n");
+    while (g.text.len < size) {
+        switch (shape) {
+        case cs_Identifiers:
+            generate_identifiers_unit(&g);
+            break;
+        case cs_Numbers:
+            generate_numbers_unit(&g);
+            break;
+        case cs_Comments:
+            generate_comments_unit(&g);
+            break;
+        case cs_Strings:
+            generate_strings_unit(&g);
+            break;
+        case cs_Nesting:
+            generate_nesting_unit(&g);
+            break;
+        case cs_SmallFunctions:
+            generate_small_functions_unit(&g);
+            break;
+        case cs_end:
+            break;
+        }
+    }
+    return take_str_from_bytes(g.text.elem, g.text.len);
+}
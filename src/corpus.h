@@ -0,0 +1,38 @@
+#ifndef KU_CORPUS_H
+#define KU_CORPUS_H
+
+#include "str.h"
+#include "strop.h"
+#include "types.h"
+
+typedef enum CorpusShape CorpusShape;
+typedef struct CorpusGenerator CorpusGenerator;
+
+// CorpusShape selects which kind of tokens dominates generated program
+enum CorpusShape {
+    cs_Identifiers,    // long identifiers in definitions and calls
+    cs_Numbers,        // integer and float literals of all bases
+    cs_Comments,       // line comments between and inside functions
+    cs_Strings,        // string literals with escape sequences
+    cs_Nesting,        // deeply nested if and loop blocks
+    cs_SmallFunctions, // many short function definitions
+
+    cs_end,
+};
+
+struct CorpusGenerator {
+    slice_of_bytes text;
+
+    // state of pseudo-random generator, never zero
+    u64 seed;
+
+    // number of functions generated so far, used to make unique names
+    u32 functions;
+};
+
+extern const char *corpus_shape_names[];
+
+bool parse_corpus_shape(str name, CorpusShape *shape);
+str generate_corpus(CorpusShape shape, u64 size, u64 seed);
+
+#endif // KU_CORPUS_H
@@ -4,7 +4,7 @@
 
 #include "fatal.h"
 
-void fatal(int status, char *msg) {
+_Noreturn void fatal(int status, char *msg) {
     fwrite(msg, 1, strlen(msg), stderr);
     fwrite("\n", 1, 1, stderr);
     exit(status);
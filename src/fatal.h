@@ -1,6 +1,6 @@
 #ifndef KU_FATAL_H
 #define KU_FATAL_H
 
-void fatal(int status, char *msg);
+_Noreturn void fatal(int status, char *msg);
 
 #endif // KU_FATAL_H
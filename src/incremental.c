@@ -0,0 +1,583 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "fatal.h"
+#include "incremental.h"
+#include "parser.h"
+
+IMPLEMENT_SLICE(ScannerCheckpoint)
+IMPLEMENT_SLICE(TopLevelSpan)
+
+// Incremental update works in two stages:
+//
+// 1. Scanning restarts from checkpoint of the first token which looked at
+//    text at or after the edit offset and continues until scanner state after the edit
+//    matches state recorded for one of the old tokens. From that point
+//    the rest of old tokens are reused, shift of their offsets and lines
+//    is postponed until they are moved before the gap
+//
+// 2. Parsing restarts from the top level declaration which may have looked
+//    at changed tokens and continues until it reaches start of an old
+//    declaration located inside reused tokens. Syntax trees of all other
+//    declarations are reused. Declaration with syntax error extends up to
+//    the next function definition, parsing resumes from there
+
+const ScannerCheckpoint initial_scanner_checkpoint = {
+    .insert_terminator = false,
+    .insert_blocked    = false,
+    .offset            = 0,
+    .lookahead_end     = 0,
+    .pos               = {.line = 1, .column = 1},
+};
+
+const PendingShift no_pending_shift = {
+    .offset = 0,
+    .index  = 0,
+    .line   = 0,
+};
+
+// room added to text gap each time it is enlarged
+const u64 text_gap_reserve = 1 << 12;
+
+// reserve_text_gap enlarges text buffer if its gap has room for less than n bytes
+void reserve_text_gap(IncrementalSource *src, u64 n) {
+    u64 hole = src->text_cap - src->text_len;
+    if (hole >= n && src->text != nil) {
+        return;
+    }
+
+    u64 tail = src->text_len - src->text_gap;
+    u64 cap  = src->text_cap + n + text_gap_reserve;
+    byte *text;
+    if (src->text == nil) {
+        text = (byte *)alloc_mem(at_Source, cap);
+    } else {
+        text = (byte *)realloc_mem(at_Source, src->text, cap);
+    }
+    if (text == nil) {
+        fatal(1, "not enough memory for edited source text");
+    }
+    memmove(text + cap - tail, text + src->text_cap - tail, tail);
+    src->text     = text;
+    src->text_cap = cap;
+}
+
+void move_text_gap(IncrementalSource *src, u64 gap) {
+    u64 hole = src->text_cap - src->text_len;
+    if (gap < src->text_gap) {
+        memmove(src->text + gap + hole, src->text + gap, src->text_gap - gap);
+    } else if (gap > src->text_gap) {
+        memmove(src->text + src->text_gap, src->text + src->text_gap + hole, gap - src->text_gap);
+    }
+    src->text_gap = gap;
+}
+
+// get_text_after_gap returns text in which only bytes at or after the gap
+// are valid, indices of bytes are the same as in source text
+str get_text_after_gap(const IncrementalSource *src) {
+    return borrow_str_from_bytes(src->text + (src->text_cap - src->text_len), src->text_len);
+}
+
+void shift_checkpoint(ScannerCheckpoint *cp, i64 offset_delta, i32 line_delta) {
+    cp->offset += (u64)offset_delta;
+    cp->lookahead_end += (u64)offset_delta;
+    cp->pos.line += (u32)line_delta;
+}
+
+// reserve_tokens_gap enlarges token buffers if their gap has room for less than n tokens
+void reserve_tokens_gap(IncrementalSource *src, u32 n) {
+    u32 cap = src->tokens.cap;
+    if (cap - src->tokens.len >= n) {
+        return;
+    }
+    while (cap - src->tokens.len < n) {
+        cap = get_new_cap(cap);
+    }
+
+    u32 tail = src->tokens.len - src->tokens_gap;
+    u32 end  = src->tokens.cap;
+    recap_slice_of_Tokens(&src->tokens, cap);
+    recap_slice_of_ScannerCheckpoints(&src->checkpoints, cap);
+    memmove(src->tokens.elem + cap - tail, src->tokens.elem + end - tail, (u64)tail * sizeof(Token));
+    memmove(src->checkpoints.elem + cap - tail, src->checkpoints.elem + end - tail,
+        (u64)tail * sizeof(ScannerCheckpoint));
+}
+
+// move_tokens_gap applies pending shift to tokens which are moved before the gap
+// and removes it from tokens which are moved after the gap
+void move_tokens_gap(IncrementalSource *src, u32 gap) {
+    u32 hole           = src->tokens.cap - src->tokens.len;
+    PendingShift shift = src->tokens_shift;
+    while (src->tokens_gap < gap) {
+        u32 i                = src->tokens_gap;
+        Token token          = src->tokens.elem[i + hole];
+        ScannerCheckpoint cp = src->checkpoints.elem[i + hole];
+        token.pos.line += (u32)shift.line;
+        shift_checkpoint(&cp, shift.offset, shift.line);
+        src->tokens.elem[i]      = token;
+        src->checkpoints.elem[i] = cp;
+        src->tokens_gap++;
+    }
+    while (src->tokens_gap > gap) {
+        src->tokens_gap--;
+        u32 i                = src->tokens_gap;
+        Token token          = src->tokens.elem[i];
+        ScannerCheckpoint cp = src->checkpoints.elem[i];
+        token.pos.line -= (u32)shift.line;
+        shift_checkpoint(&cp, -shift.offset, -shift.line);
+        src->tokens.elem[i + hole]      = token;
+        src->checkpoints.elem[i + hole] = cp;
+    }
+    if (src->tokens_gap == src->tokens.len) {
+        src->tokens_shift = no_pending_shift;
+    }
+}
+
+// insert_tokens_into_gap places new tokens right before the gap
+void insert_tokens_into_gap(IncrementalSource *src, slice_of_Tokens tokens, slice_of_ScannerCheckpoints checkpoints) {
+    reserve_tokens_gap(src, tokens.len);
+    if (tokens.len != 0) {
+        memcpy(src->tokens.elem + src->tokens_gap, tokens.elem, (u64)tokens.len * sizeof(Token));
+        memcpy(src->checkpoints.elem + src->tokens_gap, checkpoints.elem,
+            (u64)checkpoints.len * sizeof(ScannerCheckpoint));
+    }
+    src->tokens_gap += tokens.len;
+    src->tokens.len += tokens.len;
+    src->checkpoints.len += tokens.len;
+}
+
+// get_checkpoint returns checkpoint with given index with pending shift applied
+ScannerCheckpoint get_checkpoint(const IncrementalSource *src, u32 i) {
+    if (i < src->tokens_gap) {
+        return src->checkpoints.elem[i];
+    }
+    ScannerCheckpoint cp = src->checkpoints.elem[i + src->checkpoints.cap - src->checkpoints.len];
+    shift_checkpoint(&cp, src->tokens_shift.offset, src->tokens_shift.line);
+    return cp;
+}
+
+void shift_span(TopLevelSpan *span, i64 index_delta, i32 line_delta) {
+    span->first = (u32)((i64)span->first + index_delta);
+    span->end   = (u32)((i64)span->end + index_delta);
+    span->error.token.pos.line += (u32)line_delta;
+}
+
+// reserve_spans_gap enlarges span and function buffers if their gaps have room
+// for less than given number of elements
+void reserve_spans_gap(IncrementalSource *src, u32 spans, u32 functions) {
+    slice_of_TopLevelSpans *s = &src->spans;
+    u32 cap                   = s->cap;
+    while (cap - s->len < spans) {
+        cap = get_new_cap(cap);
+    }
+    if (cap != s->cap) {
+        u32 tail = s->len - src->spans_gap;
+        u32 end  = s->cap;
+        recap_slice_of_TopLevelSpans(s, cap);
+        memmove(s->elem + cap - tail, s->elem + end - tail, (u64)tail * sizeof(TopLevelSpan));
+    }
+
+    slice_of_FunctionDefinitions *f = &src->tree.functions;
+    cap                             = f->cap;
+    while (cap - f->len < functions) {
+        cap = get_new_cap(cap);
+    }
+    if (cap != f->cap) {
+        u32 tail = f->len - src->functions_gap;
+        u32 end  = f->cap;
+        recap_slice_of_FunctionDefinitions(f, cap);
+        memmove(f->elem + cap - tail, f->elem + end - tail, (u64)tail * sizeof(FunctionDefinition));
+    }
+}
+
+// move_spans_gap applies pending shift to spans which are moved before the gap
+// and removes it from spans which are moved after the gap. Function definitions
+// move together with their spans
+void move_spans_gap(IncrementalSource *src, u32 gap) {
+    u32 hole                        = src->spans.cap - src->spans.len;
+    slice_of_FunctionDefinitions *f = &src->tree.functions;
+    u32 functions_hole              = f->cap - f->len;
+    PendingShift shift              = src->spans_shift;
+    while (src->spans_gap < gap) {
+        u32 i             = src->spans_gap;
+        TopLevelSpan span = src->spans.elem[i + hole];
+        shift_span(&span, shift.index, shift.line);
+        src->spans.elem[i] = span;
+        src->spans_gap++;
+        if (span.is_function) {
+            u32 k                 = src->functions_gap;
+            FunctionDefinition fn = f->elem[k + functions_hole];
+            if (shift.line != 0) {
+                shift_function_definition_lines(&fn, shift.line);
+            }
+            f->elem[k] = fn;
+            src->functions_gap++;
+        }
+    }
+    while (src->spans_gap > gap) {
+        src->spans_gap--;
+        u32 i             = src->spans_gap;
+        TopLevelSpan span = src->spans.elem[i];
+        shift_span(&span, -shift.index, -shift.line);
+        src->spans.elem[i + hole] = span;
+        if (span.is_function) {
+            src->functions_gap--;
+            u32 k                 = src->functions_gap;
+            FunctionDefinition fn = f->elem[k];
+            if (shift.line != 0) {
+                shift_function_definition_lines(&fn, -shift.line);
+            }
+            f->elem[k + functions_hole] = fn;
+        }
+    }
+    if (src->spans_gap == src->spans.len) {
+        src->spans_shift = no_pending_shift;
+    }
+}
+
+// get_span returns span with given index with pending shift applied
+TopLevelSpan get_span(const IncrementalSource *src, u32 i) {
+    if (i < src->spans_gap) {
+        return src->spans.elem[i];
+    }
+    TopLevelSpan span = src->spans.elem[i + src->spans.cap - src->spans.len];
+    shift_span(&span, src->spans_shift.index, src->spans_shift.line);
+    return span;
+}
+
+// scan_tokens_until_sync scans text starting from given checkpoint. Scanning stops at EOF or
+// when scanner reaches a state recorded in old checkpoints at or after sync_index. Index of
+// old token where scanning synchronized is returned, number of old tokens if it did not.
+// Scanner state at the moment of synchronization is stored in sync_checkpoint
+u32 scan_tokens_until_sync(const IncrementalSource *old, str text, ScannerCheckpoint start, u32 sync_index,
+    u64 sync_offset, i64 offset_delta, slice_of_Tokens *tokens, slice_of_ScannerCheckpoints *checkpoints,
+    ScannerCheckpoint *sync_checkpoint) {
+    u32 old_len     = old->checkpoints.len;
+    Scanner scanner = init_scanner_from_checkpoint(text, start);
+    while (true) {
+        ScannerCheckpoint cp = get_scanner_checkpoint(&scanner);
+        *sync_checkpoint     = cp;
+        if (cp.offset >= sync_offset) {
+            u64 old_offset = (u64)((i64)cp.offset - offset_delta);
+            while (sync_index < old_len && get_checkpoint(old, sync_index).offset < old_offset) {
+                sync_index++;
+            }
+            for (u32 i = sync_index; i < old_len; i++) {
+                ScannerCheckpoint old_cp = get_checkpoint(old, i);
+                if (old_cp.offset != old_offset) {
+                    break;
+                }
+                // equal columns guarantee that only lines of reused tokens change
+                if (old_cp.insert_terminator == cp.insert_terminator && old_cp.insert_blocked == cp.insert_blocked &&
+                    old_cp.pos.column == cp.pos.column) {
+                    return i;
+                }
+            }
+        }
+
+        Token token      = scan_token(&scanner);
+        cp.lookahead_end = scanner.reader.pos;
+        append_Token_to_slice(tokens, token);
+        append_ScannerCheckpoint_to_slice(checkpoints, cp);
+        if (token.type == tt_EOF) {
+            return old_len;
+        }
+    }
+}
+
+// find_function_token returns index of the first function keyword at or after given token, index of EOF if
+// there is none
+u32 find_function_token(const Token *tokens, u32 len, u32 index) {
+    u32 i = index;
+    while (i + 1 < len && tokens[i].type != tt_Function) {
+        i++;
+    }
+    return i;
+}
+
+// parse_top_level_until_sync parses declarations starting from token with given index. Parsing
+// stops at EOF or when parser reaches first token of one of old spans, which starts at or after
+// index sync_token. Index of old span where parsing synchronized is returned, number of
+// old spans if it did not
+u32 parse_top_level_until_sync(const IncrementalSource *old, const Token *tokens, u32 len, u32 start, u32 sync_span,
+    u32 sync_token, i64 index_delta, slice_of_TopLevelSpans *spans, slice_of_FunctionDefinitions *functions) {
+    u32 old_len   = old->spans.len;
+    Parser parser = init_parser_from_tokens(tokens, len, start);
+    while (parser.token.type != tt_EOF) {
+        u32 first = get_parser_token_index(&parser);
+        if (first >= sync_token) {
+            u32 old_first = (u32)((i64)first - index_delta);
+            while (sync_span < old_len && get_span(old, sync_span).first < old_first) {
+                sync_span++;
+            }
+            if (sync_span < old_len && get_span(old, sync_span).first == old_first) {
+                *functions = parser.source_tree.functions;
+                return sync_span;
+            }
+        }
+
+        u32 functions_before = parser.source_tree.functions.len;
+
+        TopLevelSpan span = {
+            .first = first,
+            .error = {.text = nil},
+        };
+        if (!try_parse_top_level(&parser)) {
+            // declaration depends on all tokens parser looked at before error
+            u32 resume = get_parser_token_index(&parser);
+            if (resume == first) {
+                resume++;
+            }
+            span.error = parser.error;
+            move_parser_to_token(&parser, find_function_token(tokens, len, resume));
+        }
+        span.end         = get_parser_token_index(&parser);
+        span.is_function = parser.source_tree.functions.len > functions_before;
+        append_TopLevelSpan_to_slice(spans, span);
+    }
+    *functions = parser.source_tree.functions;
+    return old_len;
+}
+
+IncrementalSource init_incremental_source(str text) {
+    IncrementalSource src = {
+        .text          = nil,
+        .text_len      = 0,
+        .text_cap      = 0,
+        .text_gap      = 0,
+        .tokens        = empty_slice_of_Tokens,
+        .checkpoints   = empty_slice_of_ScannerCheckpoints,
+        .tokens_gap    = 0,
+        .tokens_shift  = no_pending_shift,
+        .spans         = empty_slice_of_TopLevelSpans,
+        .spans_gap     = 0,
+        .spans_shift   = no_pending_shift,
+        .tree          = empty_standalone_source_tree,
+        .functions_gap = 0,
+    };
+    reserve_text_gap(&src, text.len);
+    if (text.len != 0) {
+        memcpy(src.text, text.bytes, text.len);
+    }
+    src.text_len = text.len;
+    src.text_gap = text.len;
+
+    slice_of_Tokens tokens                  = empty_slice_of_Tokens;
+    slice_of_ScannerCheckpoints checkpoints = empty_slice_of_ScannerCheckpoints;
+    ScannerCheckpoint sync_checkpoint;
+    scan_tokens_until_sync(
+        &src, text, initial_scanner_checkpoint, 0, UINT64_MAX, 0, &tokens, &checkpoints, &sync_checkpoint);
+    src.tokens      = tokens;
+    src.checkpoints = checkpoints;
+    src.tokens_gap  = tokens.len;
+
+    slice_of_TopLevelSpans spans           = empty_slice_of_TopLevelSpans;
+    slice_of_FunctionDefinitions functions = empty_slice_of_FunctionDefinitions;
+    parse_top_level_until_sync(&src, tokens.elem, tokens.len, 0, 0, UINT32_MAX, 0, &spans, &functions);
+    src.spans          = spans;
+    src.spans_gap      = spans.len;
+    src.tree.functions = functions;
+    src.functions_gap  = functions.len;
+    return src;
+}
+
+// find_restart_token returns index of the first token which scanner produced after looking at text at or
+// after given offset, lookahead ends do not decrease along tokens
+u32 find_restart_token(const IncrementalSource *src, u64 offset) {
+    u32 lo = 0;
+    u32 hi = src->checkpoints.len - 1;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (get_checkpoint(src, mid).lookahead_end <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// find_span_with_end_after returns index of the first span which ends after given token index
+u32 find_span_with_end_after(const IncrementalSource *src, u32 index) {
+    u32 lo = 0;
+    u32 hi = src->spans.len;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (get_span(src, mid).end <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// apply_edit_to_text replaces bytes inside text buffer, gap is left right after inserted bytes
+void apply_edit_to_text(IncrementalSource *src, TextEdit edit) {
+    move_text_gap(src, edit.offset);
+    // deleted bytes simply join the gap
+    src->text_len -= edit.deleted;
+    reserve_text_gap(src, edit.inserted.len);
+    if (edit.inserted.len != 0) {
+        memcpy(src->text + src->text_gap, edit.inserted.bytes, edit.inserted.len);
+    }
+    src->text_gap += edit.inserted.len;
+    src->text_len += edit.inserted.len;
+}
+
+// replace_tokens_after_gap drops old tokens in range [gap, end) and inserts new ones
+// in their place, tokens after the range keep their postponed shift
+void replace_tokens_after_gap(IncrementalSource *src, u32 end, slice_of_Tokens tokens,
+    slice_of_ScannerCheckpoints checkpoints) {
+    u32 hole = src->tokens.cap - src->tokens.len;
+    for (u32 i = src->tokens_gap; i < end; i++) {
+        free_token(src->tokens.elem[i + hole]);
+    }
+    src->tokens.len -= end - src->tokens_gap;
+    src->checkpoints.len -= end - src->tokens_gap;
+    insert_tokens_into_gap(src, tokens, checkpoints);
+}
+
+// replace_spans_after_gap drops old spans in range [gap, end) together with their
+// functions and inserts new ones in their place
+void replace_spans_after_gap(IncrementalSource *src, u32 end, slice_of_TopLevelSpans spans,
+    slice_of_FunctionDefinitions functions) {
+    u32 hole    = src->spans.cap - src->spans.len;
+    u32 dropped = 0;
+    for (u32 i = src->spans_gap; i < end; i++) {
+        if (src->spans.elem[i + hole].is_function) {
+            dropped++;
+        }
+    }
+    src->spans.len -= end - src->spans_gap;
+    src->tree.functions.len -= dropped;
+
+    reserve_spans_gap(src, spans.len, functions.len);
+    if (spans.len != 0) {
+        memcpy(src->spans.elem + src->spans_gap, spans.elem, (u64)spans.len * sizeof(TopLevelSpan));
+    }
+    if (functions.len != 0) {
+        memcpy(src->tree.functions.elem + src->functions_gap, functions.elem,
+            (u64)functions.len * sizeof(FunctionDefinition));
+    }
+    src->spans_gap += spans.len;
+    src->spans.len += spans.len;
+    src->functions_gap += functions.len;
+    src->tree.functions.len += functions.len;
+}
+
+IncrementalEditStats apply_incremental_edit(IncrementalSource *src, TextEdit edit) {
+    if (edit.offset > src->text_len || edit.deleted > src->text_len - edit.offset) {
+        fatal(1, "text edit is out of source bounds");
+    }
+
+    i64 offset_delta = (i64)edit.inserted.len - (i64)edit.deleted;
+    u32 restart      = find_restart_token(src, edit.offset);
+    u32 first_span   = 0;
+    if (restart > 0) {
+        first_span = find_span_with_end_after(src, restart - 1);
+    }
+    u32 start = restart;
+    if (first_span < src->spans.len) {
+        start = get_span(src, first_span).first;
+    }
+
+    // stage 1: scan tokens around the edit
+    ScannerCheckpoint restart_checkpoint = get_checkpoint(src, restart);
+    apply_edit_to_text(src, edit);
+    // scanner looks at one byte before its starting offset
+    u64 scan_start = restart_checkpoint.offset;
+    if (scan_start > 0) {
+        scan_start--;
+    }
+    move_text_gap(src, scan_start);
+
+    slice_of_Tokens relexed                 = empty_slice_of_Tokens;
+    slice_of_ScannerCheckpoints checkpoints = empty_slice_of_ScannerCheckpoints;
+    ScannerCheckpoint sync_checkpoint;
+    u32 sync = scan_tokens_until_sync(src,
+        get_text_after_gap(src),
+        restart_checkpoint,
+        restart,
+        edit.offset + edit.inserted.len,
+        offset_delta,
+        &relexed,
+        &checkpoints,
+        &sync_checkpoint);
+
+    i32 line_delta = 0;
+    if (sync < src->checkpoints.len) {
+        line_delta = (i32)sync_checkpoint.pos.line - (i32)get_checkpoint(src, sync).pos.line;
+    }
+
+    IncrementalEditStats stats = {
+        .relexed_tokens = relexed.len,
+        .dropped_tokens = sync - restart,
+    };
+
+    move_tokens_gap(src, restart);
+    src->tokens_shift.offset += offset_delta;
+    src->tokens_shift.line += line_delta;
+    replace_tokens_after_gap(src, sync, relexed, checkpoints);
+    free_slice_of_Tokens(relexed);
+    free_slice_of_ScannerCheckpoints(checkpoints);
+
+    // stage 2: parse declarations around changed tokens, parser reads tokens
+    // after the gap which lack pending line shift
+    u32 reused_start = restart + stats.relexed_tokens;
+    i64 index_delta  = (i64)stats.relexed_tokens - (i64)stats.dropped_tokens;
+    move_tokens_gap(src, start);
+    move_spans_gap(src, first_span);
+
+    slice_of_TopLevelSpans spans           = empty_slice_of_TopLevelSpans;
+    slice_of_FunctionDefinitions functions = empty_slice_of_FunctionDefinitions;
+    const Token *tokens                    = src->tokens.elem + (src->tokens.cap - src->tokens.len);
+    u32 sync_span                          = parse_top_level_until_sync(
+        src, tokens, src->tokens.len, start, first_span, reused_start, index_delta, &spans, &functions);
+    stats.reparsed_declarations = spans.len;
+
+    i32 parsed_line_delta = src->tokens_shift.line;
+    if (parsed_line_delta != 0) {
+        for (u32 i = 0; i < spans.len; i++) {
+            spans.elem[i].error.token.pos.line += (u32)parsed_line_delta;
+        }
+        for (u32 i = 0; i < functions.len; i++) {
+            shift_function_definition_lines(&functions.elem[i], parsed_line_delta);
+        }
+    }
+
+    src->spans_shift.index += index_delta;
+    src->spans_shift.line += line_delta;
+    replace_spans_after_gap(src, sync_span, spans, functions);
+    free_slice_of_TopLevelSpans(spans);
+    free_slice_of_FunctionDefinitions(functions);
+
+    return stats;
+}
+
+// settle_incremental_source applies all postponed shifts, after that text, tokens,
+// checkpoints, spans and functions of the source may be read as ordinary slices
+void settle_incremental_source(IncrementalSource *src) {
+    move_text_gap(src, src->text_len);
+    move_tokens_gap(src, src->tokens.len);
+    move_spans_gap(src, src->spans.len);
+}
+
+// get_incremental_text returns current source text, it stays valid until the next edit
+str get_incremental_text(IncrementalSource *src) {
+    move_text_gap(src, src->text_len);
+    return borrow_str_from_bytes(src->text, src->text_len);
+}
+
+void free_incremental_source(IncrementalSource src) {
+    settle_incremental_source(&src);
+    for (u32 i = 0; i < src.tokens.len; i++) {
+        free_token(src.tokens.elem[i]);
+    }
+    free_slice_of_Tokens(src.tokens);
+    free_slice_of_ScannerCheckpoints(src.checkpoints);
+    free_slice_of_TopLevelSpans(src.spans);
+    free_slice_of_FunctionDefinitions(src.tree.functions);
+    free_mem(src.text);
+}
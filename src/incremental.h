@@ -0,0 +1,107 @@
+#ifndef KU_INCREMENTAL_H
+#define KU_INCREMENTAL_H
+
+#include "ast.h"
+#include "parser.h"
+#include "scanner.h"
+#include "slice.h"
+#include "str.h"
+#include "token.h"
+#include "types.h"
+
+typedef struct TopLevelSpan TopLevelSpan;
+typedef struct TextEdit TextEdit;
+typedef struct PendingShift PendingShift;
+typedef struct IncrementalSource IncrementalSource;
+typedef struct IncrementalEditStats IncrementalEditStats;
+
+// TopLevelSpan describes range of tokens consumed by parser
+// for a single top level declaration
+struct TopLevelSpan {
+    // index of first token of declaration
+    u32 first;
+
+    // index of first token after declaration
+    u32 end;
+
+    // true if declaration produced a function definition
+    bool is_function;
+
+    // syntax error which stopped parsing of declaration, text is nil if
+    // there is none
+    ParseError error;
+};
+
+TYPEDEF_SLICE(ScannerCheckpoint)
+TYPEDEF_SLICE(TopLevelSpan)
+
+// TextEdit replaces deleted bytes starting at offset with inserted bytes
+struct TextEdit {
+    u64 offset;
+    u64 deleted;
+    str inserted;
+};
+
+// PendingShift accumulates changes of positions made by edits, which are
+// not yet applied to elements stored after a gap
+struct PendingShift {
+    // byte offset in source text
+    i64 offset;
+
+    // token index
+    i64 index;
+
+    i32 line;
+};
+
+// IncrementalSource keeps source text together with its tokens and syntax
+// tree, so that after a text edit only the region around the edit
+// needs to be scanned and parsed again.
+//
+// Text, tokens and spans are stored in gap buffers. Elements after the gap
+// are kept at the end of allocated memory and their positions do not include
+// shifts made by edits before them, those are accumulated in a pending shift
+// of the buffer. An edit moves gaps to its location, so its cost depends on
+// the size of the edit and distance from the previous one, but not on size
+// of the whole source. Source must be settled before its slices are read
+struct IncrementalSource {
+    byte *text;
+    u64 text_len;
+    u64 text_cap;
+    u64 text_gap;
+
+    // checkpoints.elem[i] is scanner state right before
+    // tokens.elem[i] was scanned, both slices share the gap
+    slice_of_Tokens tokens;
+    slice_of_ScannerCheckpoints checkpoints;
+    u32 tokens_gap;
+    PendingShift tokens_shift;
+
+    slice_of_TopLevelSpans spans;
+    u32 spans_gap;
+    PendingShift spans_shift;
+
+    // i-th function is definition produced by i-th function span,
+    // functions gap follows functions of spans before spans gap
+    StandaloneSourceTree tree;
+    u32 functions_gap;
+};
+
+struct IncrementalEditStats {
+    // number of tokens produced by scanner for the edit
+    u32 relexed_tokens;
+
+    // number of old tokens discarded by the edit
+    u32 dropped_tokens;
+
+    // number of top level declarations parsed again
+    u32 reparsed_declarations;
+};
+
+IncrementalSource init_incremental_source(str text);
+IncrementalEditStats apply_incremental_edit(IncrementalSource *src, TextEdit edit);
+void settle_incremental_source(IncrementalSource *src);
+str get_incremental_text(IncrementalSource *src);
+void free_incremental_source(IncrementalSource src);
+
+#endif // KU_INCREMENTAL_H
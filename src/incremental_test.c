@@ -0,0 +1,606 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "incremental.h"
+
+typedef struct IncrementalTestCase IncrementalTestCase;
+
+// Test cases are applied one after another to the same source,
+// offsets are given for text produced by previous edits
+struct IncrementalTestCase {
+    u64 id;
+    str label;
+    u64 offset;
+    u64 deleted;
+    str inserted;
+};
+
+const str initial_source_text = STR("// incremental parsing test program\n"
+                                    "\n"
+                                    "fn main() {\n"
+                                    "    x := 12\n"
+                                    "    print(x)\n"
+                                    "}\n"
+                                    "\n"
+                                    "fn add(a, b: i32) => i32 {\n"
+                                    "    s := a\n"
+                                    "    print(s)\n"
+                                    "}\n"
+                                    "\n"
+                                    "fn swap(a, b: i32) => (i32, i32) {\n"
+                                    "    print(\"swap\")\n"
+                                    "}\n");
+
+const u32 number_of_test_cases = 14;
+
+const IncrementalTestCase test_cases[] = {
+    {
+        .id       = 1,
+        .label    = STR("rename variable"),
+        .offset   = 53,
+        .deleted  = 1,
+        .inserted = STR("value"),
+    },
+    {
+        .id       = 2,
+        .label    = STR("extend identifier at its end"),
+        .offset   = 58,
+        .deleted  = 0,
+        .inserted = STR("s"),
+    },
+    {
+        .id       = 3,
+        .label    = STR("change integer literal"),
+        .offset   = 63,
+        .deleted  = 2,
+        .inserted = STR("1234"),
+    },
+    {
+        .id       = 4,
+        .label    = STR("insert statement on a new line"),
+        .offset   = 67,
+        .deleted  = 0,
+        .inserted = STR("\n    y := 7"),
+    },
+    {
+        .id       = 5,
+        .label    = STR("insert function before others"),
+        .offset   = 37,
+        .deleted  = 0,
+        .inserted = STR("fn first(a: str) {\n    print(a)\n}\n\n"),
+    },
+    {
+        .id       = 6,
+        .label    = STR("insert comment at start"),
+        .offset   = 0,
+        .deleted  = 0,
+        .inserted = STR("// header\n"),
+    },
+    {
+        .id       = 7,
+        .label    = STR("delete function"),
+        .offset   = 140,
+        .deleted  = 54,
+        .inserted = EMPTY_STR,
+    },
+    {
+        .id       = 8,
+        .label    = STR("turn comment into code"),
+        .offset   = 0,
+        .deleted  = 3,
+        .inserted = EMPTY_STR,
+    },
+    {
+        .id       = 9,
+        .label    = STR("append function at end"),
+        .offset   = 192,
+        .deleted  = 0,
+        .inserted = STR("\nfn last() {}\n"),
+    },
+    {
+        .id       = 10,
+        .label    = STR("join two lines"),
+        .offset   = 62,
+        .deleted  = 5,
+        .inserted = STR(" "),
+    },
+    {
+        .id       = 11,
+        .label    = STR("replace whole text"),
+        .offset   = 0,
+        .deleted  = 202,
+        .inserted = STR("fn only() {\n    z := 1\n}\n"),
+    },
+    {
+        .id       = 12,
+        .label    = STR("delete everything"),
+        .offset   = 0,
+        .deleted  = 25,
+        .inserted = EMPTY_STR,
+    },
+    {
+        .id       = 13,
+        .label    = STR("call followed by comment"),
+        .offset   = 0,
+        .deleted  = 0,
+        .inserted = STR("print(s) // x\n"),
+    },
+    {
+        .id       = 14,
+        .label    = STR("edit comment seen by terminator lookahead"),
+        .offset   = 10,
+        .deleted  = 1,
+        .inserted = STR("1"),
+    },
+};
+
+// Random edits are applied after the listed ones to the initial text, each
+// of them is checked against full scan. Inserted text is made of fragments
+// which change scanner state: comments, line breaks, literals and keywords
+const str random_edit_fragments[] = {
+    STR("//"),
+    STR("/"),
+    STR("\n"),
+    STR(" "),
+    STR("x"),
+    STR("1"),
+    STR("0x"),
+    STR("\""),
+    STR("'"),
+    STR("{"),
+    STR("}"),
+    STR("("),
+    STR(")"),
+    STR(":="),
+    STR("return"),
+    STR("if "),
+    STR("// c\n"),
+    STR("fn g() {\n"),
+};
+
+const u32 number_of_random_edit_fragments = 18;
+const u32 number_of_random_edits          = 3000;
+const u64 random_edit_seed                = 0x9E3779B97F4A7C15;
+
+// edits delete more than they insert while text is longer than this
+const u64 random_text_soft_limit = 1024;
+
+// on average source is compared after this number of random edits, so that
+// shifts postponed by several edits are checked too
+const u64 random_check_period = 4;
+
+const str random_label = STR("random edit");
+
+const str pass_str    = STR("    incremental_test [ OK ]");
+const str fail_str    = STR("[ FAILED ]");
+const str case_str    = STR("Test case: ");
+const str reason_str  = STR("Reason: ");
+const str stats_str   = STR("Relexed tokens: ");
+const str reparse_str = STR("Reparsed declarations: ");
+
+bool are_checkpoints_equal(ScannerCheckpoint cp1, ScannerCheckpoint cp2) {
+    return cp1.insert_terminator == cp2.insert_terminator && cp1.insert_blocked == cp2.insert_blocked &&
+           cp1.offset == cp2.offset && cp1.lookahead_end == cp2.lookahead_end && are_positions_equal(cp1.pos, cp2.pos);
+}
+
+bool are_type_specifiers_equal(TypeSpecifier t1, TypeSpecifier t2);
+
+bool are_type_literals_equal(TypeLiteral *l1, TypeLiteral *l2) {
+    if (l1->type != l2->type) {
+        return false;
+    }
+    switch (l1->type) {
+    case tlt_Slice:
+        return are_type_specifiers_equal(((SliceTypeLiteral *)l1->ptr)->element_type,
+                                         ((SliceTypeLiteral *)l2->ptr)->element_type);
+    case tlt_Map: {
+        MapTypeLiteral *m1 = (MapTypeLiteral *)l1->ptr;
+        MapTypeLiteral *m2 = (MapTypeLiteral *)l2->ptr;
+        return are_type_specifiers_equal(m1->key_type, m2->key_type) &&
+               are_type_specifiers_equal(m1->value_type, m2->value_type);
+    }
+    default:
+        return true;
+    }
+}
+
+bool are_type_specifiers_equal(TypeSpecifier t1, TypeSpecifier t2) {
+    if (t1.type != t2.type) {
+        return false;
+    }
+    switch (t1.type) {
+    case tst_Name:
+    case tst_QualifiedName: {
+        TypeName *n1 = (TypeName *)t1.ptr;
+        TypeName *n2 = (TypeName *)t2.ptr;
+        return are_tokens_equal(n1->name.token, n2->name.token) &&
+               are_tokens_equal(n1->module_name.token, n2->module_name.token);
+    }
+    case tst_Literal:
+        return are_type_literals_equal((TypeLiteral *)t1.ptr, (TypeLiteral *)t2.ptr);
+    default:
+        return true;
+    }
+}
+
+bool are_parameter_declarations_equal(slice_of_ParameterDeclarations p1, slice_of_ParameterDeclarations p2) {
+    if (p1.len != p2.len) {
+        return false;
+    }
+    for (u32 i = 0; i < p1.len; i++) {
+        if (p1.elem[i].names.len != p2.elem[i].names.len) {
+            return false;
+        }
+        for (u32 j = 0; j < p1.elem[i].names.len; j++) {
+            if (!are_tokens_equal(p1.elem[i].names.elem[j].token, p2.elem[i].names.elem[j].token)) {
+                return false;
+            }
+        }
+        if (!are_type_specifiers_equal(p1.elem[i].type_specifier, p2.elem[i].type_specifier)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool are_function_results_equal(FunctionResult r1, FunctionResult r2) {
+    if (r1.type != r2.type) {
+        return false;
+    }
+    switch (r1.type) {
+    case frt_Simple:
+        return are_type_specifiers_equal(((SimpleResult *)r1.ptr)->type_specifier,
+                                         ((SimpleResult *)r2.ptr)->type_specifier);
+    case frt_TupleSignature: {
+        slice_of_TypeSpecifiers s1 = ((TupleSignatureResult *)r1.ptr)->type_specifiers;
+        slice_of_TypeSpecifiers s2 = ((TupleSignatureResult *)r2.ptr)->type_specifiers;
+        if (s1.len != s2.len) {
+            return false;
+        }
+        for (u32 i = 0; i < s1.len; i++) {
+            if (!are_type_specifiers_equal(s1.elem[i], s2.elem[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case frt_TypedTuple:
+        return are_parameter_declarations_equal(((TypedTupleResult *)r1.ptr)->parameter_declarations,
+                                                ((TypedTupleResult *)r2.ptr)->parameter_declarations);
+    default:
+        return true;
+    }
+}
+
+bool are_expressions_equal(Expression e1, Expression e2);
+
+bool are_expression_lists_equal(slice_of_Expressions l1, slice_of_Expressions l2) {
+    if (l1.len != l2.len) {
+        return false;
+    }
+    for (u32 i = 0; i < l1.len; i++) {
+        if (!are_expressions_equal(l1.elem[i], l2.elem[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool are_expressions_equal(Expression e1, Expression e2) {
+    if (e1.type != e2.type) {
+        return false;
+    }
+    switch (e1.type) {
+    case et_Identifier:
+        return are_tokens_equal(((Identifier *)e1.ptr)->token, ((Identifier *)e2.ptr)->token);
+    case et_IntegerLiteral:
+        return are_tokens_equal(((Integer *)e1.ptr)->token, ((Integer *)e2.ptr)->token);
+    case et_FloatLiteral:
+        return are_tokens_equal(((Float *)e1.ptr)->token, ((Float *)e2.ptr)->token);
+    case et_StringLiteral:
+        return are_tokens_equal(((String *)e1.ptr)->token, ((String *)e2.ptr)->token);
+    case et_Unary: {
+        UnaryExpression *u1 = (UnaryExpression *)e1.ptr;
+        UnaryExpression *u2 = (UnaryExpression *)e2.ptr;
+        return are_tokens_equal(u1->operator, u2->operator) && are_expressions_equal(u1->operand, u2->operand);
+    }
+    case et_Binary: {
+        BinaryExpression *b1 = (BinaryExpression *)e1.ptr;
+        BinaryExpression *b2 = (BinaryExpression *)e2.ptr;
+        return are_tokens_equal(b1->operator, b2->operator) && are_expressions_equal(b1->left, b2->left) &&
+               are_expressions_equal(b1->right, b2->right);
+    }
+    case et_Call: {
+        CallExpression *c1 = (CallExpression *)e1.ptr;
+        CallExpression *c2 = (CallExpression *)e2.ptr;
+        return are_tokens_equal(c1->name.token, c2->name.token) && are_expression_lists_equal(c1->args, c2->args);
+    }
+    default:
+        return false;
+    }
+}
+
+bool are_statements_equal(Statement s1, Statement s2);
+
+bool are_blocks_equal(BlockStatement b1, BlockStatement b2) {
+    if (b1.statements.len != b2.statements.len) {
+        return false;
+    }
+    for (u32 i = 0; i < b1.statements.len; i++) {
+        if (!are_statements_equal(b1.statements.elem[i], b2.statements.elem[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool are_if_statements_equal(IfStatement *i1, IfStatement *i2) {
+    if (i1->clauses.len != i2->clauses.len) {
+        return false;
+    }
+    for (u32 i = 0; i < i1->clauses.len; i++) {
+        IfClause c1 = i1->clauses.elem[i];
+        IfClause c2 = i2->clauses.elem[i];
+        if (!are_expressions_equal(c1.condition, c2.condition) || !are_blocks_equal(c1.body, c2.body)) {
+            return false;
+        }
+    }
+    if (i1->else_body == nil || i2->else_body == nil) {
+        return i1->else_body == i2->else_body;
+    }
+    return are_blocks_equal(*i1->else_body, *i2->else_body);
+}
+
+bool are_statements_equal(Statement s1, Statement s2) {
+    if (s1.type != s2.type) {
+        return false;
+    }
+    switch (s1.type) {
+    case st_Empty:
+        return true;
+    case st_Define: {
+        DefineStatement *d1 = (DefineStatement *)s1.ptr;
+        DefineStatement *d2 = (DefineStatement *)s2.ptr;
+        return are_expression_lists_equal(d1->left, d2->left) && are_expression_lists_equal(d1->right, d2->right);
+    }
+    case st_Assign: {
+        AssignStatement *a1 = (AssignStatement *)s1.ptr;
+        AssignStatement *a2 = (AssignStatement *)s2.ptr;
+        return are_tokens_equal(a1->operator, a2->operator) && are_expression_lists_equal(a1->left, a2->left) &&
+               are_expression_lists_equal(a1->right, a2->right);
+    }
+    case st_Expression:
+        return are_expressions_equal(*(Expression *)s1.ptr, *(Expression *)s2.ptr);
+    case st_Return: {
+        ReturnStatement *r1 = (ReturnStatement *)s1.ptr;
+        ReturnStatement *r2 = (ReturnStatement *)s2.ptr;
+        return are_tokens_equal(r1->token, r2->token) && are_expression_lists_equal(r1->values, r2->values);
+    }
+    case st_If:
+        return are_if_statements_equal((IfStatement *)s1.ptr, (IfStatement *)s2.ptr);
+    case st_Loop: {
+        LoopStatement *l1 = (LoopStatement *)s1.ptr;
+        LoopStatement *l2 = (LoopStatement *)s2.ptr;
+        if (!are_tokens_equal(l1->token, l2->token) || !are_blocks_equal(l1->body, l2->body)) {
+            return false;
+        }
+        if (l1->count.ptr == nil || l2->count.ptr == nil) {
+            return l1->count.ptr == l2->count.ptr;
+        }
+        return are_expressions_equal(l1->count, l2->count);
+    }
+    case st_While: {
+        WhileStatement *w1 = (WhileStatement *)s1.ptr;
+        WhileStatement *w2 = (WhileStatement *)s2.ptr;
+        return are_expressions_equal(w1->condition, w2->condition) && are_blocks_equal(w1->body, w2->body);
+    }
+    case st_Block:
+        return are_blocks_equal(*(BlockStatement *)s1.ptr, *(BlockStatement *)s2.ptr);
+    default:
+        return false;
+    }
+}
+
+// are_function_definitions_equal compares whole syntax trees of functions
+// including positions of all tokens
+bool are_function_definitions_equal(FunctionDefinition f1, FunctionDefinition f2) {
+    return are_tokens_equal(f1.declaration.name.token, f2.declaration.name.token) &&
+           are_parameter_declarations_equal(f1.declaration.parameters.parameter_declarations,
+                                            f2.declaration.parameters.parameter_declarations) &&
+           are_function_results_equal(f1.declaration.result, f2.declaration.result) &&
+           are_blocks_equal(f1.body, f2.body);
+}
+
+// compare_sources returns nil if incrementally updated source is identical
+// to the one built from scratch, otherwise description of the difference.
+// Both sources must be settled
+char *compare_sources(IncrementalSource got, IncrementalSource want) {
+    if (!are_strs_equal(get_incremental_text(&got), get_incremental_text(&want))) {
+        return "source texts differ";
+    }
+    if (got.tokens.len != want.tokens.len) {
+        return "number of tokens differ";
+    }
+    for (u32 i = 0; i < got.tokens.len; i++) {
+        if (!are_tokens_equal(got.tokens.elem[i], want.tokens.elem[i])) {
+            return "tokens differ";
+        }
+        if (!are_checkpoints_equal(got.checkpoints.elem[i], want.checkpoints.elem[i])) {
+            return "scanner checkpoints differ";
+        }
+    }
+    if (got.spans.len != want.spans.len) {
+        return "number of top level spans differ";
+    }
+    for (u32 i = 0; i < got.spans.len; i++) {
+        TopLevelSpan s1 = got.spans.elem[i];
+        TopLevelSpan s2 = want.spans.elem[i];
+        if (s1.first != s2.first || s1.end != s2.end || s1.is_function != s2.is_function) {
+            return "top level spans differ";
+        }
+        if (s1.error.text != s2.error.text ||
+            (s1.error.text != nil && !are_tokens_equal(s1.error.token, s2.error.token))) {
+            return "syntax errors differ";
+        }
+    }
+    if (got.tree.functions.len != want.tree.functions.len) {
+        return "number of functions differ";
+    }
+    for (u32 i = 0; i < got.tree.functions.len; i++) {
+        if (!are_function_definitions_equal(got.tree.functions.elem[i], want.tree.functions.elem[i])) {
+            return "function definitions differ";
+        }
+    }
+    return nil;
+}
+
+// compare_with_fresh_parse returns nil if functions of settled incremental
+// source match the ones produced by parsing its text from scratch. Texts
+// with syntax errors are covered by compare_sources only
+char *compare_with_fresh_parse(IncrementalSource got) {
+    StandaloneParseResult result = parse_standalone_source_from_str(get_incremental_text(&got));
+    if (!result.ok) {
+        return nil;
+    }
+    slice_of_FunctionDefinitions functions = result.tree.functions;
+    if (got.tree.functions.len != functions.len) {
+        return "number of functions differ from fresh parse";
+    }
+    for (u32 i = 0; i < functions.len; i++) {
+        if (!are_function_definitions_equal(got.tree.functions.elem[i], functions.elem[i])) {
+            return "function definitions differ from fresh parse";
+        }
+    }
+    return nil;
+}
+
+void print_failed_test_case(IncrementalTestCase test_case, char *reason, IncrementalEditStats stats) {
+    str id_str      = format_u64_as_decimal(test_case.id);
+    str relexed_str = format_u32_as_decimal(stats.relexed_tokens);
+    str reparse_num = format_u32_as_decimal(stats.reparsed_declarations);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(reason_str);
+    println_str(take_str_from_cstr(reason));
+    print_str(stats_str);
+    println_str(relexed_str);
+    print_str(reparse_str);
+    println_str(reparse_num);
+
+    free_str(id_str);
+    free_str(relexed_str);
+    free_str(reparse_num);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+// run_test_case compares source against the one built from scratch
+// only if check is true
+bool run_test_case(IncrementalSource *src, IncrementalTestCase test_case, bool check) {
+    TextEdit edit = {
+        .offset   = test_case.offset,
+        .deleted  = test_case.deleted,
+        .inserted = test_case.inserted,
+    };
+    IncrementalEditStats stats = apply_incremental_edit(src, edit);
+    if (!check) {
+        return false;
+    }
+
+    settle_incremental_source(src);
+    IncrementalSource want = init_incremental_source(get_incremental_text(src));
+
+    char *reason = compare_sources(*src, want);
+    free_incremental_source(want);
+    if (reason == nil) {
+        reason = compare_with_fresh_parse(*src);
+    }
+    if (reason == nil) {
+        return false;
+    }
+    print_failed_test_case(test_case, reason, stats);
+    return true;
+}
+
+// next_random_number implements xorshift generator, so that sequence of
+// random edits is the same on each run
+u64 next_random_number(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// run_random_test_cases stops at the first failed edit, since later edits
+// depend on it
+bool run_random_test_cases() {
+    IncrementalSource src = init_incremental_source(initial_source_text);
+    u64 state             = random_edit_seed;
+    bool failed           = false;
+    for (u32 i = 0; i < number_of_random_edits && !failed; i++) {
+        u64 len    = src.text_len;
+        u64 offset = next_random_number(&state) % (len + 1);
+        u64 limit  = len > random_text_soft_limit ? 64 : 4;
+        if (limit > len - offset) {
+            limit = len - offset;
+        }
+
+        byte inserted[64];
+        u64 inserted_len = 0;
+        u64 fragments    = next_random_number(&state) % 4;
+        for (u64 j = 0; j < fragments; j++) {
+            str fragment = random_edit_fragments[next_random_number(&state) % number_of_random_edit_fragments];
+            memcpy(inserted + inserted_len, fragment.bytes, fragment.len);
+            inserted_len += fragment.len;
+        }
+
+        IncrementalTestCase test_case = {
+            .id       = number_of_test_cases + i + 1,
+            .label    = random_label,
+            .offset   = offset,
+            .deleted  = next_random_number(&state) % (limit + 1),
+            .inserted = borrow_str_from_bytes(inserted, inserted_len),
+        };
+        bool check = next_random_number(&state) % random_check_period == 0 || i + 1 == number_of_random_edits;
+        failed     = run_test_case(&src, test_case, check);
+    }
+    free_incremental_source(src);
+    return failed;
+}
+
+int main() {
+    IncrementalSource src = init_incremental_source(initial_source_text);
+
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(&src, test_cases[i], true);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    free_incremental_source(src);
+
+    if (run_random_test_cases()) {
+        failed_test_cases++;
+    }
+
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,911 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "fatal.h"
+#include "ir.h"
+#include "resolve.h"
+#include "slice.h"
+
+#define IR_OPCODE_NAME(name, s) [op_##name] = STR(s),
+
+const str ir_opcode_names[] = {IR_OPCODE_LIST(IR_OPCODE_NAME)};
+
+const str ir_comma_str          = STR(", ");
+const str ir_assign_str         = STR(" = ");
+const str ir_newline_escape_str = STR("\\n");
+const str ir_tab_escape_str     = STR("\\t");
+const str ir_fn_str             = STR("fn ");
+const str ir_result_arrow_str   = STR(" => ");
+const str ir_body_start_str     = STR(" {\n");
+const str ir_label_end_str      = STR(":\n");
+const str ir_body_end_str       = STR("}\n");
+
+const IrModule empty_ir_module = {
+    .table         = nil,
+    .functions     = nil,
+    .functions_len = 0,
+};
+
+// initial capacity of function arrays
+const u32 min_ir_array_cap = 16;
+
+IrFunction init_ir_function(str name, TypeId params, TypeId result) {
+    IrFunction fn = {
+        .name             = name,
+        .params           = params,
+        .result           = result,
+        .arena            = init_arena(at_IR),
+        .blocks           = nil,
+        .blocks_len       = 0,
+        .blocks_cap       = 0,
+        .instructions     = nil,
+        .instructions_len = 0,
+        .instructions_cap = 0,
+        .operands         = nil,
+        .operands_len     = 0,
+        .operands_cap     = 0,
+        .values           = nil,
+        .values_len       = 0,
+        .values_cap       = 0,
+        .strings          = nil,
+        .strings_len      = 0,
+        .strings_cap      = 0,
+        .current          = IR_NONE,
+    };
+    return fn;
+}
+
+void free_ir_function(IrFunction *fn) {
+    free_arena(&fn->arena);
+    fn->blocks       = nil;
+    fn->instructions = nil;
+    fn->operands     = nil;
+    fn->values       = nil;
+    fn->strings      = nil;
+}
+
+void free_ir_module(IrModule *m) {
+    for (u32 i = 0; i < m->functions_len; i++) {
+        free_ir_function(&m->functions[i]);
+    }
+    free_mem(m->functions);
+    m->functions     = nil;
+    m->functions_len = 0;
+}
+
+u32 find_ir_function(const IrModule *m, str name) {
+    for (u32 i = 0; i < m->functions_len; i++) {
+        if (are_strs_equal(m->functions[i].name, name)) {
+            return i;
+        }
+    }
+    return IR_NONE;
+}
+
+// grow_ir_array makes room for at least one more element of array with len
+// elements and returns its possibly moved memory
+void *grow_ir_array(IrFunction *fn, void *elem, u32 len, u32 *cap, u64 size) {
+    if (len < *cap) {
+        return elem;
+    }
+    u32 new_cap = *cap < min_ir_array_cap ? min_ir_array_cap : get_new_cap(*cap);
+    void *p     = arena_grow(&fn->arena, elem, (u64)*cap * size, (u64)new_cap * size);
+    *cap        = new_cap;
+    return p;
+}
+
+ValueId new_ir_value(IrFunction *fn, TypeId type) {
+    fn->values = (TypeId *)grow_ir_array(fn, fn->values, fn->values_len, &fn->values_cap, sizeof(TypeId));
+    fn->values[fn->values_len] = type;
+    fn->values_len++;
+    return fn->values_len - 1;
+}
+
+BlockId new_ir_block(IrFunction *fn, u32 params_len, const TypeId *types) {
+    fn->blocks = (IrBlock *)grow_ir_array(fn, fn->blocks, fn->blocks_len, &fn->blocks_cap, sizeof(IrBlock));
+
+    IrBlock block = {
+        .params     = fn->values_len,
+        .params_len = params_len,
+        .start      = fn->instructions_len,
+        .len        = 0,
+    };
+    for (u32 i = 0; i < params_len; i++) {
+        new_ir_value(fn, types[i]);
+    }
+    fn->blocks[fn->blocks_len] = block;
+    fn->blocks_len++;
+    return fn->blocks_len - 1;
+}
+
+void open_ir_block(IrFunction *fn, BlockId block) {
+    fn->blocks[block].start = fn->instructions_len;
+    fn->blocks[block].len   = 0;
+    fn->current             = block;
+}
+
+IrInstruction *add_ir_instruction(IrFunction *fn, IrOpcode op, TypeId type, const ValueId *operands, u32 len) {
+    if (fn->current == IR_NONE) {
+        fatal(1, "no open block for instruction");
+    }
+    fn->instructions = (IrInstruction *)grow_ir_array(fn, fn->instructions, fn->instructions_len,
+        &fn->instructions_cap, sizeof(IrInstruction));
+
+    IrInstruction inst = {
+        .op           = op,
+        .type         = type,
+        .result       = type == ti_Void ? IR_NONE : new_ir_value(fn, type),
+        .operands     = fn->operands_len,
+        .operands_len = len,
+        .targets      = {IR_NONE, IR_NONE},
+        .then_args    = 0,
+        .imm          = 0,
+    };
+    for (u32 i = 0; i < len; i++) {
+        fn->operands = (ValueId *)grow_ir_array(fn, fn->operands, fn->operands_len, &fn->operands_cap,
+            sizeof(ValueId));
+        fn->operands[fn->operands_len] = operands[i];
+        fn->operands_len++;
+    }
+
+    fn->instructions[fn->instructions_len] = inst;
+    fn->instructions_len++;
+    fn->blocks[fn->current].len++;
+    if (is_ir_terminator(op)) {
+        fn->current = IR_NONE;
+    }
+    return &fn->instructions[fn->instructions_len - 1];
+}
+
+u32 add_ir_string(IrFunction *fn, str s) {
+    fn->strings = (str *)grow_ir_array(fn, fn->strings, fn->strings_len, &fn->strings_cap, sizeof(str));
+
+    byte *bytes = (byte *)arena_alloc(&fn->arena, s.len);
+    if (s.len != 0) {
+        memcpy(bytes, s.bytes, s.len);
+    }
+    fn->strings[fn->strings_len] = borrow_str_from_bytes(bytes, s.len);
+    fn->strings_len++;
+    return fn->strings_len - 1;
+}
+
+bool is_ir_call(IrOpcode op) {
+    return op == op_Call || op == op_CallBuiltin;
+}
+
+bool is_ir_terminator(IrOpcode op) {
+    return op == op_Jump || op == op_Branch || op == op_Return;
+}
+
+bool is_ir_pure(IrOpcode op) {
+    return !is_ir_call(op) && !is_ir_terminator(op);
+}
+
+IrInstruction *get_ir_terminator(const IrFunction *fn, BlockId block) {
+    IrBlock b = fn->blocks[block];
+    return &fn->instructions[b.start + b.len - 1];
+}
+
+const ValueId *get_ir_target_args(const IrFunction *fn, const IrInstruction *inst, u32 target, u32 *len) {
+    const ValueId *ops = fn->operands + inst->operands;
+    if (inst->op == op_Jump) {
+        *len = inst->operands_len;
+        return ops;
+    }
+    if (target == 0) {
+        *len = inst->then_args;
+        return ops + 1;
+    }
+    *len = inst->operands_len - 1 - inst->then_args;
+    return ops + 1 + inst->then_args;
+}
+
+u32 get_ir_successors(const IrFunction *fn, BlockId block, BlockId succ[2]) {
+    IrBlock b = fn->blocks[block];
+    if (b.len == 0) {
+        return 0;
+    }
+    IrInstruction inst = fn->instructions[b.start + b.len - 1];
+    switch (inst.op) {
+    case op_Jump:
+        succ[0] = inst.targets[0];
+        return 1;
+    case op_Branch:
+        succ[0] = inst.targets[0];
+        succ[1] = inst.targets[1];
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+void *alloc_ir_temp(u64 size) {
+    void *p = alloc_mem(at_IR, size);
+    if (p == nil) {
+        fatal(1, "not enough memory for intermediate representation");
+    }
+    return p;
+}
+
+// number_ir_blocks writes blocks reachable from entry in reverse postorder
+// and sets their position in that order, unreachable blocks get IR_NONE.
+// Successors are visited from the last one, so that the first target of
+// branch precedes the second in the order. Returns number of reachable blocks
+u32 number_ir_blocks(const IrFunction *fn, BlockId *order, u32 *rpo) {
+    u32 n          = fn->blocks_len;
+    BlockId *stack = (BlockId *)alloc_ir_temp((u64)n * sizeof(BlockId) + 1);
+    u32 *next      = (u32 *)alloc_ir_temp((u64)n * sizeof(u32) + 1);
+    for (u32 i = 0; i < n; i++) {
+        rpo[i]  = IR_NONE;
+        next[i] = 0;
+    }
+
+    // postorder is written from the end of order array
+    u32 visited = 0;
+    u32 post    = n;
+    u32 top     = 0;
+    stack[top]  = 0;
+    top++;
+    rpo[0] = 0;
+    visited++;
+    while (top != 0) {
+        BlockId b = stack[top - 1];
+        BlockId succ[2];
+        u32 len = get_ir_successors(fn, b, succ);
+        if (next[b] < len) {
+            BlockId s = succ[len - 1 - next[b]];
+            next[b]++;
+            if (rpo[s] == IR_NONE) {
+                rpo[s] = 0;
+                visited++;
+                stack[top] = s;
+                top++;
+            }
+            continue;
+        }
+        top--;
+        post--;
+        order[post] = b;
+    }
+
+    // reachable blocks occupy the tail of order array, move them to the front
+    memmove(order, order + post, (u64)visited * sizeof(BlockId));
+    for (u32 i = 0; i < visited; i++) {
+        rpo[order[i]] = i;
+    }
+    free_mem(stack);
+    free_mem(next);
+    return visited;
+}
+
+BlockId intersect_ir_dominators(const BlockId *idom, const u32 *rpo, BlockId a, BlockId b) {
+    while (a != b) {
+        while (rpo[a] > rpo[b]) {
+            a = idom[a];
+        }
+        while (rpo[b] > rpo[a]) {
+            b = idom[b];
+        }
+    }
+    return a;
+}
+
+// find_ir_predecessors lists predecessors of each block, only edges which
+// leave reachable blocks are taken into account
+void find_ir_predecessors(const IrFunction *fn, IrCfg *cfg) {
+    u32 n            = fn->blocks_len;
+    cfg->preds_start = (u32 *)alloc_ir_temp((u64)(n + 1) * sizeof(u32));
+    memset(cfg->preds_start, 0, (u64)(n + 1) * sizeof(u32));
+    for (u32 i = 0; i < cfg->reachable; i++) {
+        BlockId succ[2];
+        u32 len = get_ir_successors(fn, cfg->order[i], succ);
+        for (u32 j = 0; j < len; j++) {
+            cfg->preds_start[succ[j] + 1]++;
+        }
+    }
+    for (u32 i = 0; i < n; i++) {
+        cfg->preds_start[i + 1] += cfg->preds_start[i];
+    }
+    cfg->preds = (BlockId *)alloc_ir_temp((u64)cfg->preds_start[n] * sizeof(BlockId) + 1);
+    u32 *fill  = (u32 *)alloc_ir_temp((u64)n * sizeof(u32) + 1);
+    memcpy(fill, cfg->preds_start, (u64)n * sizeof(u32));
+    for (u32 i = 0; i < cfg->reachable; i++) {
+        BlockId succ[2];
+        u32 len = get_ir_successors(fn, cfg->order[i], succ);
+        for (u32 j = 0; j < len; j++) {
+            cfg->preds[fill[succ[j]]] = cfg->order[i];
+            fill[succ[j]]++;
+        }
+    }
+    free_mem(fill);
+}
+
+// Dominators are found by iterating over blocks in reverse postorder until
+// nothing changes, as described in "A Simple, Fast Dominance Algorithm" by
+// Cooper, Harvey and Kennedy
+void find_ir_dominators(const IrFunction *fn, IrCfg *cfg) {
+    u32 n         = fn->blocks_len;
+    BlockId *idom = (BlockId *)alloc_ir_temp((u64)n * sizeof(BlockId) + 1);
+    for (u32 i = 0; i < n; i++) {
+        idom[i] = IR_NONE;
+    }
+    cfg->idom = idom;
+    if (n == 0) {
+        return;
+    }
+
+    idom[0]      = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = 1; i < cfg->reachable; i++) {
+            BlockId b       = cfg->order[i];
+            BlockId new_dom = IR_NONE;
+            for (u32 j = cfg->preds_start[b]; j < cfg->preds_start[b + 1]; j++) {
+                BlockId p = cfg->preds[j];
+                if (idom[p] == IR_NONE) {
+                    continue;
+                }
+                new_dom = new_dom == IR_NONE ? p : intersect_ir_dominators(idom, cfg->rpo, p, new_dom);
+            }
+            if (idom[b] != new_dom) {
+                idom[b] = new_dom;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = IR_NONE;
+}
+
+IrCfg compute_ir_cfg(const IrFunction *fn) {
+    u32 n     = fn->blocks_len;
+    IrCfg cfg = {
+        .order       = (BlockId *)alloc_ir_temp((u64)n * sizeof(BlockId) + 1),
+        .reachable   = 0,
+        .rpo         = (u32 *)alloc_ir_temp((u64)n * sizeof(u32) + 1),
+        .preds_start = nil,
+        .preds       = nil,
+        .idom        = nil,
+    };
+    if (n != 0) {
+        cfg.reachable = number_ir_blocks(fn, cfg.order, cfg.rpo);
+    }
+    find_ir_predecessors(fn, &cfg);
+    find_ir_dominators(fn, &cfg);
+    return cfg;
+}
+
+void free_ir_cfg(IrCfg *cfg) {
+    free_mem(cfg->order);
+    free_mem(cfg->rpo);
+    free_mem(cfg->preds_start);
+    free_mem(cfg->preds);
+    free_mem(cfg->idom);
+    cfg->order       = nil;
+    cfg->rpo         = nil;
+    cfg->preds_start = nil;
+    cfg->preds       = nil;
+    cfg->idom        = nil;
+}
+
+BlockId *compute_ir_dominators(const IrFunction *fn) {
+    IrCfg cfg     = compute_ir_cfg(fn);
+    BlockId *idom = cfg.idom;
+    cfg.idom      = nil;
+    free_ir_cfg(&cfg);
+    return idom;
+}
+
+bool ir_block_dominates(const BlockId *idom, BlockId a, BlockId b) {
+    while (b != IR_NONE) {
+        if (b == a) {
+            return true;
+        }
+        b = idom[b];
+    }
+    return false;
+}
+
+// IrVerifier keeps state of a single verify_ir_function call
+typedef struct IrVerifier IrVerifier;
+
+struct IrVerifier {
+    const IrModule *m;
+    const IrFunction *fn;
+    BlockId *idom;
+
+    // block which defines each value, IR_NONE if value is not defined
+    BlockId *def_block;
+
+    // 0 for block parameters, index of instruction inside block plus one
+    // for instruction results
+    u32 *def_pos;
+
+    // first problem found
+    char message[256];
+    bool failed;
+};
+
+void fail_ir_verification(IrVerifier *v, BlockId b, u32 pos, const char *what) {
+    if (v->failed) {
+        return;
+    }
+    v->failed = true;
+    snprintf(v->message, sizeof(v->message), "%.*s: b%u: instruction %u: %s", (int)v->fn->name.len,
+        (char *)v->fn->name.bytes, b, pos, what);
+}
+
+// define_ir_value records definition of value, each value must be defined
+// exactly once and have type of its definition
+void define_ir_value(IrVerifier *v, BlockId b, u32 pos, ValueId id, TypeId type) {
+    if (id >= v->fn->values_len) {
+        fail_ir_verification(v, b, pos, "value id out of range");
+        return;
+    }
+    if (v->def_block[id] != IR_NONE) {
+        fail_ir_verification(v, b, pos, "value defined twice");
+        return;
+    }
+    if (v->fn->values[id] != type) {
+        fail_ir_verification(v, b, pos, "value type differs from its definition");
+        return;
+    }
+    v->def_block[id] = b;
+    v->def_pos[id]   = pos;
+}
+
+// use_ir_value checks that definition of value dominates its use at position
+// pos of block b, uses in unreachable blocks are checked only inside block
+TypeId use_ir_value(IrVerifier *v, BlockId b, u32 pos, ValueId id) {
+    if (id >= v->fn->values_len || v->def_block[id] == IR_NONE) {
+        fail_ir_verification(v, b, pos, "use of undefined value");
+        return ti_Invalid;
+    }
+    BlockId d = v->def_block[id];
+    if (d == b) {
+        if (v->def_pos[id] > pos) {
+            fail_ir_verification(v, b, pos, "value used before definition");
+        }
+    } else if ((b == 0 || v->idom[b] != IR_NONE) && !ir_block_dominates(v->idom, d, b)) {
+        fail_ir_verification(v, b, pos, "definition does not dominate use");
+    }
+    return v->fn->values[id];
+}
+
+void verify_ir_types(IrVerifier *v, BlockId b, u32 pos, TypeList want, const ValueId *args, u32 len) {
+    if (want.len != len) {
+        fail_ir_verification(v, b, pos, "wrong number of values");
+        return;
+    }
+    for (u32 i = 0; i < len; i++) {
+        if (use_ir_value(v, b, pos, args[i]) != want.elem[i]) {
+            fail_ir_verification(v, b, pos, "value type mismatch");
+        }
+    }
+}
+
+void verify_ir_target(IrVerifier *v, BlockId b, u32 pos, BlockId target, const ValueId *args, u32 len) {
+    if (target >= v->fn->blocks_len) {
+        fail_ir_verification(v, b, pos, "target block out of range");
+        return;
+    }
+    if (target == 0) {
+        fail_ir_verification(v, b, pos, "jump to entry block");
+        return;
+    }
+    IrBlock t = v->fn->blocks[target];
+    if (t.params_len != len) {
+        fail_ir_verification(v, b, pos, "wrong number of block arguments");
+        return;
+    }
+    for (u32 i = 0; i < len; i++) {
+        if (use_ir_value(v, b, pos, args[i]) != v->fn->values[t.params + i]) {
+            fail_ir_verification(v, b, pos, "block argument type mismatch");
+        }
+    }
+}
+
+void verify_ir_instruction(IrVerifier *v, BlockId b, u32 pos, IrInstruction inst) {
+    const TypeTable *table = v->m->table;
+    const ValueId *ops     = v->fn->operands + inst.operands;
+    u32 len                = inst.operands_len;
+
+    switch (inst.op) {
+    case op_Const:
+    case op_String:
+        if (len != 0 || inst.type == ti_Void) {
+            fail_ir_verification(v, b, pos, "malformed constant");
+        } else if (inst.op == op_String && (inst.type != ti_Str || inst.imm >= v->fn->strings_len)) {
+            fail_ir_verification(v, b, pos, "malformed string constant");
+        }
+        break;
+    case op_Neg:
+    case op_Not:
+    case op_BitNot:
+        if (len != 1) {
+            fail_ir_verification(v, b, pos, "unary operation takes one operand");
+        } else if (use_ir_value(v, b, pos, ops[0]) != inst.type) {
+            fail_ir_verification(v, b, pos, "operand type differs from result");
+        } else if (inst.op == op_Not && inst.type != ti_Bool) {
+            fail_ir_verification(v, b, pos, "not operand must be bool");
+        }
+        break;
+    case op_Add:
+    case op_Sub:
+    case op_Mul:
+    case op_Div:
+    case op_Rem:
+    case op_And:
+    case op_Or:
+    case op_Xor:
+    case op_AndNot:
+    case op_Shl:
+    case op_Shr: {
+        if (len != 2) {
+            fail_ir_verification(v, b, pos, "binary operation takes two operands");
+            break;
+        }
+        TypeId left  = use_ir_value(v, b, pos, ops[0]);
+        TypeId right = use_ir_value(v, b, pos, ops[1]);
+        if (left != inst.type) {
+            fail_ir_verification(v, b, pos, "operand type differs from result");
+        } else if (inst.op == op_Shl || inst.op == op_Shr) {
+            if (!is_integer_type(table, left) || !is_integer_type(table, right)) {
+                fail_ir_verification(v, b, pos, "shift operands must be integers");
+            }
+        } else if (right != left) {
+            fail_ir_verification(v, b, pos, "operands have different types");
+        }
+        break;
+    }
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        if (len != 2) {
+            fail_ir_verification(v, b, pos, "comparison takes two operands");
+        } else if (use_ir_value(v, b, pos, ops[0]) != use_ir_value(v, b, pos, ops[1])) {
+            fail_ir_verification(v, b, pos, "operands have different types");
+        } else if (inst.type != ti_Bool) {
+            fail_ir_verification(v, b, pos, "comparison result must be bool");
+        }
+        break;
+    case op_Call: {
+        if (inst.imm >= v->m->functions_len) {
+            fail_ir_verification(v, b, pos, "called function out of range");
+            break;
+        }
+        const IrFunction *callee = &v->m->functions[inst.imm];
+        verify_ir_types(v, b, pos, get_tuple_members(table, &callee->params), ops, len);
+        if (inst.type != callee->result) {
+            fail_ir_verification(v, b, pos, "call type differs from callee result");
+        }
+        break;
+    }
+    case op_CallBuiltin:
+        if (inst.imm >= builtin_functions_len || inst.type != ti_Void) {
+            fail_ir_verification(v, b, pos, "malformed builtin call");
+        }
+        for (u32 i = 0; i < len; i++) {
+            use_ir_value(v, b, pos, ops[i]);
+        }
+        break;
+    case op_Extract: {
+        if (len != 1) {
+            fail_ir_verification(v, b, pos, "extract takes one operand");
+            break;
+        }
+        TypeId tuple = use_ir_value(v, b, pos, ops[0]);
+        if (get_type(table, tuple).kind != tk_Tuple) {
+            fail_ir_verification(v, b, pos, "extract operand must be tuple");
+            break;
+        }
+        TypeList members = get_tuple_members(table, &tuple);
+        if (inst.imm >= members.len || members.elem[inst.imm] != inst.type) {
+            fail_ir_verification(v, b, pos, "extract member mismatch");
+        }
+        break;
+    }
+    case op_Jump:
+        verify_ir_target(v, b, pos, inst.targets[0], ops, len);
+        break;
+    case op_Branch:
+        if (len == 0 || inst.then_args > len - 1) {
+            fail_ir_verification(v, b, pos, "malformed branch operands");
+            break;
+        }
+        if (use_ir_value(v, b, pos, ops[0]) != ti_Bool) {
+            fail_ir_verification(v, b, pos, "branch condition must be bool");
+        }
+        verify_ir_target(v, b, pos, inst.targets[0], ops + 1, inst.then_args);
+        verify_ir_target(v, b, pos, inst.targets[1], ops + 1 + inst.then_args, len - 1 - inst.then_args);
+        break;
+    case op_Return:
+        verify_ir_types(v, b, pos, get_tuple_members(table, &v->fn->result), ops, len);
+        break;
+    }
+}
+
+// verify_ir_definitions checks shape of blocks and records definition of
+// each value, must precede checks of uses
+void verify_ir_definitions(IrVerifier *v) {
+    const IrFunction *fn = v->fn;
+    for (BlockId b = 0; b < fn->blocks_len; b++) {
+        IrBlock block = fn->blocks[b];
+        if (block.len == 0) {
+            fail_ir_verification(v, b, 0, "block has no terminator");
+            return;
+        }
+        if (block.start + block.len > fn->instructions_len) {
+            fail_ir_verification(v, b, 0, "instructions out of range");
+            return;
+        }
+        for (u32 i = 0; i < block.params_len; i++) {
+            define_ir_value(v, b, 0, block.params + i, fn->values[block.params + i]);
+        }
+        for (u32 i = 0; i < block.len; i++) {
+            IrInstruction inst = fn->instructions[block.start + i];
+            if (is_ir_terminator(inst.op) != (i == block.len - 1)) {
+                fail_ir_verification(v, b, i, "terminator must be the last instruction of block");
+                return;
+            }
+            if ((inst.result == IR_NONE) != (inst.type == ti_Void)) {
+                fail_ir_verification(v, b, i, "result does not match its type");
+                return;
+            }
+            if (inst.operands + inst.operands_len > fn->operands_len) {
+                fail_ir_verification(v, b, i, "operands out of range");
+                return;
+            }
+            u32 targets = inst.op == op_Branch ? 2 : inst.op == op_Jump ? 1 : 0;
+            for (u32 j = 0; j < targets; j++) {
+                if (inst.targets[j] >= fn->blocks_len) {
+                    fail_ir_verification(v, b, i, "target block out of range");
+                    return;
+                }
+            }
+            if (inst.result != IR_NONE) {
+                define_ir_value(v, b, i + 1, inst.result, inst.type);
+            }
+        }
+    }
+}
+
+str verify_ir_function(const IrModule *m, const IrFunction *fn) {
+    IrVerifier v = {
+        .m         = m,
+        .fn        = fn,
+        .idom      = nil,
+        .def_block = (BlockId *)alloc_ir_temp((u64)fn->values_len * sizeof(BlockId) + 1),
+        .def_pos   = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1),
+        .failed    = false,
+    };
+    for (u32 i = 0; i < fn->values_len; i++) {
+        v.def_block[i] = IR_NONE;
+    }
+
+    if (fn->blocks_len == 0) {
+        fail_ir_verification(&v, 0, 0, "function has no blocks");
+    } else {
+        IrBlock entry = fn->blocks[0];
+        verify_ir_definitions(&v);
+        TypeList params = get_tuple_members(m->table, &fn->params);
+        if (!v.failed && entry.params_len != params.len) {
+            fail_ir_verification(&v, 0, 0, "entry block parameters differ from function parameters");
+        }
+        for (u32 i = 0; !v.failed && i < params.len; i++) {
+            if (fn->values[entry.params + i] != params.elem[i]) {
+                fail_ir_verification(&v, 0, 0, "entry block parameters differ from function parameters");
+            }
+        }
+    }
+    if (!v.failed) {
+        v.idom = compute_ir_dominators(fn);
+        for (BlockId b = 0; b < fn->blocks_len && !v.failed; b++) {
+            IrBlock block = fn->blocks[b];
+            for (u32 i = 0; i < block.len && !v.failed; i++) {
+                verify_ir_instruction(&v, b, i, fn->instructions[block.start + i]);
+            }
+        }
+        free_mem(v.idom);
+    }
+
+    free_mem(v.def_block);
+    free_mem(v.def_pos);
+    if (!v.failed) {
+        return empty_str;
+    }
+    return new_str_from_cstr(v.message);
+}
+
+void write_ir_type(OutputBuffer *out, const TypeTable *table, TypeId id) {
+    slice_of_bytes b = empty_slice_of_bytes;
+    append_type_to_bytes(&b, table, id);
+    write_bytes_to_output(out, b.elem, b.len);
+    free_slice_of_bytes(b);
+}
+
+void write_ir_value(OutputBuffer *out, ValueId id) {
+    write_byte_to_output(out, 'v');
+    write_u64_to_output(out, id);
+}
+
+void write_ir_values(OutputBuffer *out, const ValueId *values, u32 len) {
+    for (u32 i = 0; i < len; i++) {
+        if (i != 0) {
+            write_str_to_output(out, ir_comma_str);
+        }
+        write_ir_value(out, values[i]);
+    }
+}
+
+// write_ir_target writes block with its arguments, e.g. "b2(v1, v5)"
+void write_ir_target(OutputBuffer *out, BlockId block, const ValueId *args, u32 len) {
+    write_byte_to_output(out, 'b');
+    write_u64_to_output(out, block);
+    if (len == 0) {
+        return;
+    }
+    write_byte_to_output(out, '(');
+    write_ir_values(out, args, len);
+    write_byte_to_output(out, ')');
+}
+
+// write_ir_quoted writes string constant in double quotes, quotes, backslashes
+// and control bytes are escaped
+void write_ir_quoted(OutputBuffer *out, str s) {
+    write_byte_to_output(out, '"');
+    for (u64 i = 0; i < s.len; i++) {
+        byte c = s.bytes[i];
+        if (c == '"' || c == '\\') {
+            write_byte_to_output(out, '\\');
+            write_byte_to_output(out, c);
+        } else if (c == '\n') {
+            write_str_to_output(out, ir_newline_escape_str);
+        } else if (c == '\t') {
+            write_str_to_output(out, ir_tab_escape_str);
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\x%02x", c);
+            write_bytes_to_output(out, (byte *)buf, 4);
+        } else {
+            write_byte_to_output(out, c);
+        }
+    }
+    write_byte_to_output(out, '"');
+}
+
+void write_ir_constant(OutputBuffer *out, const TypeTable *table, TypeId type, u64 bits) {
+    char buf[32];
+    Type t = get_type(table, type);
+    switch (t.kind) {
+    case tk_Signed:
+        snprintf(buf, sizeof(buf), "%lld", (long long)bits);
+        break;
+    case tk_Float: {
+        f64 real;
+        memcpy(&real, &bits, sizeof(real));
+        snprintf(buf, sizeof(buf), "%.17g", real);
+        break;
+    }
+    default:
+        if (type == ti_Bool) {
+            snprintf(buf, sizeof(buf), "%s", bits != 0 ? "true" : "false");
+        } else {
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)bits);
+        }
+        break;
+    }
+    write_bytes_to_output(out, (byte *)buf, strlen(buf));
+}
+
+// Instructions are written as "v3 i64 = add v1, v2", instructions without
+// result omit the left part
+void write_ir_instruction(OutputBuffer *out, const IrModule *m, const IrFunction *fn, IrInstruction inst) {
+    const ValueId *ops = fn->operands + inst.operands;
+    write_spaces_to_output(out, 4);
+    if (inst.result != IR_NONE) {
+        write_ir_value(out, inst.result);
+        write_byte_to_output(out, ' ');
+        write_ir_type(out, m->table, inst.type);
+        write_str_to_output(out, ir_assign_str);
+    }
+    write_str_to_output(out, ir_opcode_names[inst.op]);
+    if (inst.operands_len != 0 || inst.op == op_Const || inst.op == op_String || inst.op == op_Jump ||
+        is_ir_call(inst.op)) {
+        write_byte_to_output(out, ' ');
+    }
+
+    switch (inst.op) {
+    case op_Const:
+        write_ir_constant(out, m->table, inst.type, inst.imm);
+        break;
+    case op_String:
+        write_ir_quoted(out, fn->strings[inst.imm]);
+        break;
+    case op_Call:
+        write_str_to_output(out, m->functions[inst.imm].name);
+        write_byte_to_output(out, '(');
+        write_ir_values(out, ops, inst.operands_len);
+        write_byte_to_output(out, ')');
+        break;
+    case op_CallBuiltin:
+        write_str_to_output(out, builtin_function_names[inst.imm]);
+        write_byte_to_output(out, '(');
+        write_ir_values(out, ops, inst.operands_len);
+        write_byte_to_output(out, ')');
+        break;
+    case op_Extract:
+        write_ir_value(out, ops[0]);
+        write_str_to_output(out, ir_comma_str);
+        write_u64_to_output(out, inst.imm);
+        break;
+    case op_Jump:
+        write_ir_target(out, inst.targets[0], ops, inst.operands_len);
+        break;
+    case op_Branch:
+        write_ir_value(out, ops[0]);
+        write_str_to_output(out, ir_comma_str);
+        write_ir_target(out, inst.targets[0], ops + 1, inst.then_args);
+        write_str_to_output(out, ir_comma_str);
+        write_ir_target(out, inst.targets[1], ops + 1 + inst.then_args, inst.operands_len - 1 - inst.then_args);
+        break;
+    default:
+        write_ir_values(out, ops, inst.operands_len);
+        break;
+    }
+    write_byte_to_output(out, '\n');
+}
+
+void write_ir_function(OutputBuffer *out, const IrModule *m, const IrFunction *fn) {
+    write_str_to_output(out, ir_fn_str);
+    write_str_to_output(out, fn->name);
+    write_byte_to_output(out, '(');
+    TypeList params = get_tuple_members(m->table, &fn->params);
+    for (u32 i = 0; i < params.len; i++) {
+        if (i != 0) {
+            write_str_to_output(out, ir_comma_str);
+        }
+        write_ir_type(out, m->table, params.elem[i]);
+    }
+    write_byte_to_output(out, ')');
+    if (fn->result != ti_Void) {
+        write_str_to_output(out, ir_result_arrow_str);
+        write_ir_type(out, m->table, fn->result);
+    }
+    write_str_to_output(out, ir_body_start_str);
+
+    for (BlockId b = 0; b < fn->blocks_len; b++) {
+        IrBlock block = fn->blocks[b];
+        write_byte_to_output(out, 'b');
+        write_u64_to_output(out, b);
+        if (block.params_len != 0) {
+            write_byte_to_output(out, '(');
+            for (u32 i = 0; i < block.params_len; i++) {
+                if (i != 0) {
+                    write_str_to_output(out, ir_comma_str);
+                }
+                write_ir_value(out, block.params + i);
+                write_byte_to_output(out, ' ');
+                write_ir_type(out, m->table, fn->values[block.params + i]);
+            }
+            write_byte_to_output(out, ')');
+        }
+        write_str_to_output(out, ir_label_end_str);
+        for (u32 i = 0; i < block.len; i++) {
+            write_ir_instruction(out, m, fn, fn->instructions[block.start + i]);
+        }
+    }
+    write_str_to_output(out, ir_body_end_str);
+}
+
+void write_ir_module(OutputBuffer *out, const IrModule *m) {
+    for (u32 i = 0; i < m->functions_len; i++) {
+        if (i != 0) {
+            write_byte_to_output(out, '\n');
+        }
+        write_ir_function(out, m, &m->functions[i]);
+    }
+}
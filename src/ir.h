@@ -0,0 +1,251 @@
+#ifndef KU_IR_H
+#define KU_IR_H
+
+#include "arena.h"
+#include "output.h"
+#include "str.h"
+#include "type_table.h"
+#include "types.h"
+
+typedef u32 ValueId;
+typedef u32 BlockId;
+
+typedef enum IrOpcode IrOpcode;
+typedef struct IrInstruction IrInstruction;
+typedef struct IrBlock IrBlock;
+typedef struct IrFunction IrFunction;
+typedef struct IrModule IrModule;
+typedef struct IrCfg IrCfg;
+
+// marks absent value, block or instruction
+#define IR_NONE ((u32)0xFFFFFFFF)
+
+#define IR_OPCODE_LIST(X)                                                                                              \
+    X(Const, "const")                                                                                                  \
+    X(String, "string")                                                                                                \
+    X(Neg, "neg")                                                                                                      \
+    X(Not, "not")                                                                                                      \
+    X(BitNot, "bitnot")                                                                                                \
+    X(Add, "add")                                                                                                      \
+    X(Sub, "sub")                                                                                                      \
+    X(Mul, "mul")                                                                                                      \
+    X(Div, "div")                                                                                                      \
+    X(Rem, "rem")                                                                                                      \
+    X(And, "and")                                                                                                      \
+    X(Or, "or")                                                                                                        \
+    X(Xor, "xor")                                                                                                      \
+    X(AndNot, "andnot")                                                                                                \
+    X(Shl, "shl")                                                                                                      \
+    X(Shr, "shr")                                                                                                      \
+    X(Eq, "eq")                                                                                                        \
+    X(Ne, "ne")                                                                                                        \
+    X(Lt, "lt")                                                                                                        \
+    X(Le, "le")                                                                                                        \
+    X(Gt, "gt")                                                                                                        \
+    X(Ge, "ge")                                                                                                        \
+    X(Call, "call")                                                                                                    \
+    X(CallBuiltin, "call_builtin")                                                                                     \
+    X(Extract, "extract")                                                                                              \
+    X(Jump, "jump")                                                                                                    \
+    X(Branch, "branch")                                                                                                \
+    X(Return, "return")
+
+#define IR_OPCODE_ENUM_ENTRY(name, s) op_##name,
+
+// Signedness of division, remainder, right shift and comparisons is taken
+// from type of operands. Shift count may have any integer type, other binary
+// operators take operands of the same type
+enum IrOpcode { IR_OPCODE_LIST(IR_OPCODE_ENUM_ENTRY) };
+
+// IrInstruction is a single operation. Operands are stored in operand array
+// of function, so that instructions have fixed size
+struct IrInstruction {
+    IrOpcode op;
+
+    // type of result, ti_Void for instructions without result
+    TypeId type;
+
+    // IR_NONE for instructions without result
+    ValueId result;
+
+    // index of the first operand in operand array of function
+    u32 operands;
+
+    u32 operands_len;
+
+    // destinations of jump and branch, for branch first target is taken if
+    // condition is true
+    BlockId targets[2];
+
+    // number of arguments passed to the first target of branch, they follow
+    // condition operand and arguments of the second target follow them
+    u32 then_args;
+
+    // Meaning depends on opcode:
+    //
+    //   - const: bits of integer value, 0 or 1 for bool, bits of f64 value
+    //     for both float types, zero value of any other type is 0
+    //   - string: index in string array of function
+    //   - call: index of function in module
+    //   - call_builtin: index in builtin_function_names
+    //   - extract: index of tuple member
+    u64 imm;
+};
+
+// IrBlock is a basic block. Values flowing in from predecessors are passed
+// as block parameters instead of phi nodes, terminator of each predecessor
+// provides arguments for them. Instructions of a block occupy contiguous
+// range of function instruction array and the last of them is a terminator
+struct IrBlock {
+    // id of the first parameter, parameters have consecutive ids
+    ValueId params;
+
+    u32 params_len;
+
+    // index of the first instruction
+    u32 start;
+
+    u32 len;
+};
+
+// IrFunction owns all its arrays, they are allocated in function arena.
+// Values are numbered from zero, each value is either a block parameter or
+// result of a single instruction
+struct IrFunction {
+    str name;
+
+    // tuple of parameter types, parameters of the entry block have them
+    TypeId params;
+
+    // result type as in function type, void, single type or tuple
+    TypeId result;
+
+    Arena arena;
+
+    // block with id 0 is the entry block
+    IrBlock *blocks;
+    u32 blocks_len;
+    u32 blocks_cap;
+
+    IrInstruction *instructions;
+    u32 instructions_len;
+    u32 instructions_cap;
+
+    ValueId *operands;
+    u32 operands_len;
+    u32 operands_cap;
+
+    // type of each value indexed by its id
+    TypeId *values;
+    u32 values_len;
+    u32 values_cap;
+
+    // string constants, bytes are copied into function arena
+    str *strings;
+    u32 strings_len;
+    u32 strings_cap;
+
+    // block which receives new instructions, IR_NONE if no block is open
+    BlockId current;
+};
+
+struct IrModule {
+    // types used by functions
+    const TypeTable *table;
+
+    IrFunction *functions;
+    u32 functions_len;
+};
+
+// IrCfg describes control flow between blocks of a function, all arrays are
+// indexed by block id unless noted otherwise
+struct IrCfg {
+    // blocks reachable from entry in reverse postorder, entry block is the
+    // first of them, first target of branch precedes the second
+    BlockId *order;
+    u32 reachable;
+
+    // position of block in order, IR_NONE for unreachable blocks
+    u32 *rpo;
+
+    // predecessors of block b are preds[preds_start[b]] up to
+    // preds[preds_start[b + 1]], block is listed once for each edge and only
+    // reachable predecessors are listed
+    u32 *preds_start;
+    BlockId *preds;
+
+    // immediate dominator, IR_NONE for the entry block and unreachable blocks
+    BlockId *idom;
+};
+
+extern const str ir_opcode_names[];
+extern const IrModule empty_ir_module;
+
+IrFunction init_ir_function(str name, TypeId params, TypeId result);
+void free_ir_function(IrFunction *fn);
+void free_ir_module(IrModule *m);
+
+// find_ir_function returns index of function with given name or IR_NONE
+u32 find_ir_function(const IrModule *m, str name);
+
+// new_ir_block creates block with given number of parameters, their values
+// are allocated immediately
+BlockId new_ir_block(IrFunction *fn, u32 params_len, const TypeId *types);
+
+// open_ir_block makes block current, instructions can be added only to the
+// latest opened block until it gets a terminator
+void open_ir_block(IrFunction *fn, BlockId block);
+
+ValueId new_ir_value(IrFunction *fn, TypeId type);
+
+// add_ir_instruction appends instruction to the latest opened block with
+// copy of given operands, result value is allocated if type is not void
+IrInstruction *add_ir_instruction(IrFunction *fn, IrOpcode op, TypeId type, const ValueId *operands, u32 len);
+
+u32 add_ir_string(IrFunction *fn, str s);
+
+bool is_ir_call(IrOpcode op);
+bool is_ir_terminator(IrOpcode op);
+
+// is_ir_pure tells whether result of operation depends only on its operands
+// and operation has no other effects, such instructions may be removed or
+// moved freely. Division by zero is the only exception, it traps at runtime
+bool is_ir_pure(IrOpcode op);
+
+// get_ir_terminator returns the last instruction of block, block must not
+// be empty
+IrInstruction *get_ir_terminator(const IrFunction *fn, BlockId block);
+
+// get_ir_target_args returns arguments which jump or branch passes to its
+// target with given index and writes their number to len
+const ValueId *get_ir_target_args(const IrFunction *fn, const IrInstruction *inst, u32 target, u32 *len);
+
+// get_ir_successors writes targets of block terminator to succ and returns
+// their number
+u32 get_ir_successors(const IrFunction *fn, BlockId block, BlockId succ[2]);
+
+// alloc_ir_temp allocates memory for temporary arrays of IR algorithms, it
+// is freed with free_mem
+void *alloc_ir_temp(u64 size);
+
+IrCfg compute_ir_cfg(const IrFunction *fn);
+void free_ir_cfg(IrCfg *cfg);
+
+// compute_ir_dominators returns new array with immediate dominator of each
+// block, IR_NONE for the entry block and blocks unreachable from it
+BlockId *compute_ir_dominators(const IrFunction *fn);
+
+// ir_block_dominates tells whether every path from entry block to block b
+// passes through block a, each block dominates itself
+bool ir_block_dominates(const BlockId *idom, BlockId a, BlockId b);
+
+// verify_ir_function checks structure of blocks, operand counts and types,
+// targets and block arguments and that each use of a value is dominated by
+// its definition. Returns empty string if function is valid or new string
+// with description of the first problem found
+str verify_ir_function(const IrModule *m, const IrFunction *fn);
+
+void write_ir_function(OutputBuffer *out, const IrModule *m, const IrFunction *fn);
+void write_ir_module(OutputBuffer *out, const IrModule *m);
+
+#endif // KU_IR_H
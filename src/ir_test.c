@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const_eval.h"
+#include "ir.h"
+#include "lower.h"
+#include "parser.h"
+#include "resolve.h"
+#include "type_check.h"
+
+typedef struct IrTestCase IrTestCase;
+
+struct IrTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    // dump of the last function or first reported error in the form
+    // "line:column: message"
+    str want;
+};
+
+const u32 number_of_test_cases = 7;
+
+const IrTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("straight line code"),
+        .input = STR("fn f(a: i32, b: i32) => i32 {\n    return a * b + 1\n}\n"),
+        .want  = STR("fn f(i32, i32) => i32 {\n"
+                     "b0(v0 i32, v1 i32):\n"
+                     "    v2 i32 = mul v0, v1\n"
+                     "    v3 i32 = const 1\n"
+                     "    v4 i32 = add v2, v3\n"
+                     "    return v4\n"
+                     "b1:\n"
+                     "    v5 i32 = const 0\n"
+                     "    return v5\n"
+                     "}\n"),
+    },
+    {
+        .id    = 2,
+        .label = STR("if statement merges assigned variable"),
+        .input = STR("fn f(a: i32) => i32 {\n    x := a\n    if a > 0 {\n        x = a * 2\n    } else {\n"
+                     "        x = -a\n    }\n    return x\n}\n"),
+        .want  = STR("fn f(i32) => i32 {\n"
+                     "b0(v0 i32):\n"
+                     "    v2 i32 = const 0\n"
+                     "    v3 bool = gt v0, v2\n"
+                     "    branch v3, b2, b3\n"
+                     "b1(v1 i32):\n"
+                     "    return v1\n"
+                     "b2:\n"
+                     "    v4 i32 = const 2\n"
+                     "    v5 i32 = mul v0, v4\n"
+                     "    jump b1(v5)\n"
+                     "b3:\n"
+                     "    v6 i32 = neg v0\n"
+                     "    jump b1(v6)\n"
+                     "b4:\n"
+                     "    v7 i32 = const 0\n"
+                     "    return v7\n"
+                     "}\n"),
+    },
+    {
+        .id    = 3,
+        .label = STR("loop with count"),
+        .input = STR("fn f(n: u8, step: u32) => u32 {\n    s := step\n    loop n {\n        s += step\n    }\n"
+                     "    return s\n}\n"),
+        .want  = STR("fn f(u8, u32) => u32 {\n"
+                     "b0(v0 u8, v1 u32):\n"
+                     "    jump b1(v0, v1)\n"
+                     "b1(v2 u8, v3 u32):\n"
+                     "    v4 u8 = const 0\n"
+                     "    v5 bool = gt v2, v4\n"
+                     "    branch v5, b2, b3\n"
+                     "b2:\n"
+                     "    v6 u8 = const 1\n"
+                     "    v7 u8 = sub v2, v6\n"
+                     "    v8 u32 = add v3, v1\n"
+                     "    jump b1(v7, v8)\n"
+                     "b3:\n"
+                     "    return v3\n"
+                     "b4:\n"
+                     "    v9 u32 = const 0\n"
+                     "    return v9\n"
+                     "}\n"),
+    },
+    {
+        .id    = 4,
+        .label = STR("while with short circuit condition"),
+        .input = STR("fn f(a: i64) => i64 {\n    while a < 0 || a > 100 {\n        a = a / 2\n    }\n"
+                     "    return a\n}\n"),
+        .want  = STR("fn f(i64) => i64 {\n"
+                     "b0(v0 i64):\n"
+                     "    jump b1(v0)\n"
+                     "b1(v1 i64):\n"
+                     "    v2 i64 = const 0\n"
+                     "    v3 bool = lt v1, v2\n"
+                     "    branch v3, b3(v3), b2\n"
+                     "b2:\n"
+                     "    v5 i64 = const 100\n"
+                     "    v6 bool = gt v1, v5\n"
+                     "    jump b3(v6)\n"
+                     "b3(v4 bool):\n"
+                     "    branch v4, b4, b5\n"
+                     "b4:\n"
+                     "    v7 i64 = const 2\n"
+                     "    v8 i64 = div v1, v7\n"
+                     "    jump b1(v8)\n"
+                     "b5:\n"
+                     "    return v1\n"
+                     "b6:\n"
+                     "    v9 i64 = const 0\n"
+                     "    return v9\n"
+                     "}\n"),
+    },
+    {
+        .id    = 5,
+        .label = STR("bare return of named results"),
+        .input = STR("fn f(a: i32) => (q: i32, r: i32) {\n    q = a / 10\n    return\n}\n"),
+        .want  = STR("fn f(i32) => (i32, i32) {\n"
+                     "b0(v0 i32):\n"
+                     "    v1 i32 = const 0\n"
+                     "    v2 i32 = const 0\n"
+                     "    v3 i32 = const 10\n"
+                     "    v4 i32 = div v0, v3\n"
+                     "    return v4, v2\n"
+                     "b1:\n"
+                     "    return v4, v2\n"
+                     "}\n"),
+    },
+    {
+        .id    = 6,
+        .label = STR("tuple result and builtin call"),
+        .input = STR("fn g() => (i32, str) {\n    return 1, \"a\\n\"\n}\n\nfn f() {\n    n, s := g()\n"
+                     "    print(s, n)\n}\n"),
+        .want  = STR("fn f() {\n"
+                     "b0:\n"
+                     "    v0 (i32, str) = call g()\n"
+                     "    v1 i32 = extract v0, 0\n"
+                     "    v2 str = extract v0, 1\n"
+                     "    call_builtin print(v2, v1)\n"
+                     "    return\n"
+                     "}\n"),
+    },
+    {
+        .id    = 7,
+        .label = STR("function used as value"),
+        .input = STR("fn g() {}\n\nfn f() {\n    x := g\n}\n"),
+        .want  = STR("4:10: function used as value: g"),
+    },
+};
+
+const u64 test_ir_buffer_cap = 1 << 16;
+
+const str pass_str = STR("    ir_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+const str verifier_label  = STR("verifier rejects use not dominated by definition");
+const str verifier_want   = STR("t: b3: instruction 0: definition does not dominate use");
+const str dominator_label = STR("immediate dominators");
+const str dominator_want  = STR("none 0 0 0");
+
+const str test_function_name = STR("t");
+
+void print_failed_test_case(u64 id, str label, str want, str got) {
+    str id_str = format_u64_as_decimal(id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+str format_first_lower_error(slice_of_LowerErrors errors) {
+    LowerError err = errors.elem[0];
+    str message    = format_lower_error(err);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%u:%u: %.*s", err.pos.line, err.pos.column, (int)message.len, (char *)message.bytes);
+    free_str(message);
+    return new_str_from_cstr(buf);
+}
+
+// lower_test_input returns dump of the last function, first lowering error
+// or first problem found by verifier
+str lower_test_input(const TypeTable *table, const StandaloneSourceTree *tree) {
+    LowerResult result = lower_standalone_source_tree(table, tree);
+    str got            = empty_str;
+    if (result.errors.len != 0) {
+        got = format_first_lower_error(result.errors);
+    }
+    for (u32 i = 0; i < result.module.functions_len && got.len == 0; i++) {
+        got = verify_ir_function(&result.module, &result.module.functions[i]);
+    }
+    if (got.len == 0) {
+        OutputBuffer out = new_output_buffer(-1, test_ir_buffer_cap);
+        write_ir_function(&out, &result.module, &result.module.functions[result.module.functions_len - 1]);
+        got = new_str_from_bytes(out.bytes, out.len);
+        free_output_buffer(&out);
+    }
+    free_slice_of_LowerErrors(result.errors);
+    free_ir_module(&result.module);
+    return got;
+}
+
+bool run_test_case(IrTestCase test_case) {
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(test_case.input);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult check_result       = check_standalone_source_tree(&table, &parse_result.tree);
+    FoldResult fold_result             = fold_standalone_source_tree(&table, &parse_result.tree);
+
+    str got     = lower_test_input(&table, &parse_result.tree);
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || check_result.errors.len != 0 ||
+                  fold_result.errors.len != 0 || !are_strs_equal(got, test_case.want);
+    if (failed) {
+        print_failed_test_case(test_case.id, test_case.label, test_case.want, got);
+    }
+
+    free_str(got);
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(check_result.errors);
+    free_slice_of_TypeErrors(fold_result.errors);
+    free_type_table(&table);
+    return failed;
+}
+
+// build_diamond_function creates function with blocks b1 and b2 between
+// b0 and b3, value defined in b1 is used in b3
+IrFunction build_diamond_function(TypeTable *table) {
+    TypeList none = {
+        .elem = nil,
+        .len  = 0,
+    };
+    IrFunction fn = init_ir_function(test_function_name, intern_tuple_type(table, none), ti_Void);
+
+    BlockId b0 = new_ir_block(&fn, 0, nil);
+    BlockId b1 = new_ir_block(&fn, 0, nil);
+    BlockId b2 = new_ir_block(&fn, 0, nil);
+    BlockId b3 = new_ir_block(&fn, 0, nil);
+
+    open_ir_block(&fn, b0);
+    ValueId condition   = add_ir_instruction(&fn, op_Const, ti_Bool, nil, 0)->result;
+    IrInstruction *inst = add_ir_instruction(&fn, op_Branch, ti_Void, &condition, 1);
+    inst->targets[0]    = b1;
+    inst->targets[1]    = b2;
+
+    open_ir_block(&fn, b1);
+    ValueId value = add_ir_instruction(&fn, op_Const, ti_I64, nil, 0)->result;
+    add_ir_instruction(&fn, op_Jump, ti_Void, nil, 0)->targets[0] = b3;
+
+    open_ir_block(&fn, b2);
+    add_ir_instruction(&fn, op_Jump, ti_Void, nil, 0)->targets[0] = b3;
+
+    open_ir_block(&fn, b3);
+    ValueId operands[2] = {value, value};
+    add_ir_instruction(&fn, op_Add, ti_I64, operands, 2);
+    add_ir_instruction(&fn, op_Return, ti_Void, nil, 0);
+    return fn;
+}
+
+bool run_verifier_checks() {
+    TypeTable table = new_type_table();
+    IrFunction fn   = build_diamond_function(&table);
+    IrModule m      = {
+             .table         = &table,
+             .functions     = &fn,
+             .functions_len = 1,
+    };
+
+    bool failed = false;
+    str got     = verify_ir_function(&m, &fn);
+    if (!are_strs_equal(got, verifier_want)) {
+        print_failed_test_case(1, verifier_label, verifier_want, got);
+        failed = true;
+    }
+    free_str(got);
+
+    BlockId *idom = compute_ir_dominators(&fn);
+    if (idom[0] != IR_NONE || idom[1] != 0 || idom[2] != 0 || idom[3] != 0) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%d %u %u %u", idom[0] == IR_NONE ? -1 : (int)idom[0], idom[1], idom[2], idom[3]);
+        str got_idom = new_str_from_cstr(buf);
+        print_failed_test_case(2, dominator_label, dominator_want, got_idom);
+        free_str(got_idom);
+        failed = true;
+    }
+    free_mem(idom);
+
+    free_ir_function(&fn);
+    free_type_table(&table);
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (run_verifier_checks()) {
+        failed_test_cases++;
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
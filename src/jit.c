@@ -0,0 +1,898 @@
+// mmap, mprotect and sysconf are not part of C11
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fatal.h"
+#include "jit.h"
+#include "strop.h"
+#include "vm.h"
+
+typedef enum JitReg JitReg;
+typedef enum JitCond JitCond;
+typedef struct JitFixup JitFixup;
+typedef struct JitStub JitStub;
+typedef struct JitAssembler JitAssembler;
+typedef u32 (*JitTrampoline)(VmValue *base, JitContext *ctx, VmValue *results, const void *start);
+
+// JitReg is number of general purpose register in instruction encoding,
+// numbers of xmm registers are the same
+enum JitReg {
+    jr_Rax,
+    jr_Rcx,
+    jr_Rdx,
+    jr_Rbx,
+    jr_Rsp,
+    jr_Rbp,
+    jr_Rsi,
+    jr_Rdi,
+    jr_R8,
+    jr_R9,
+    jr_R10,
+    jr_R11,
+    jr_R12,
+    jr_R13,
+    jr_R14,
+    jr_R15,
+};
+
+// JitCond is condition code of conditional jumps and setcc
+enum JitCond {
+    jc_B  = 0x2,
+    jc_AE = 0x3,
+    jc_E  = 0x4,
+    jc_NE = 0x5,
+    jc_BE = 0x6,
+    jc_A  = 0x7,
+    jc_P  = 0xA,
+    jc_NP = 0xB,
+    jc_L  = 0xC,
+    jc_LE = 0xE,
+};
+
+// JitFixup is 32-bit displacement of jump which is filled in when position
+// of its target is known
+struct JitFixup {
+    u32 pos;
+
+    // index of bytecode instruction or of stub
+    u32 target;
+};
+
+// JitStub records frame of function and leaves native code, it is reached
+// when guard fails or when callee returned after its guard failed
+struct JitStub {
+    u32 ip;
+    u32 dst;
+};
+
+struct JitAssembler {
+    slice_of_bytes code;
+
+    JitFixup *jumps;
+    u32 jumps_len;
+
+    JitFixup *guards;
+    u32 guards_len;
+
+    JitStub *stubs;
+    u32 stubs_len;
+};
+
+// Native code keeps frame base, context and destination of results in
+// callee-saved registers, so that they survive calls of runtime functions.
+// Machine stack is aligned to 16 bytes at each call as required by ABI
+const JitReg jit_base_reg    = jr_Rbx;
+const JitReg jit_ctx_reg     = jr_R12;
+const JitReg jit_results_reg = jr_R14;
+
+const u32 jit_default_threshold = 1000;
+
+// machine stack available to native calls, deeper calls continue in
+// interpreter
+const u64 jit_stack_size = 1 << 20;
+
+// number of guards and stubs which a single instruction may need
+const u32 jit_max_guards = 4;
+const u32 jit_max_stubs  = 2;
+
+void *alloc_jit_mem(u64 size) {
+    void *p = alloc_mem(at_Vm, size);
+    if (p == nil) {
+        fatal(1, "not enough memory for native code");
+    }
+    return p;
+}
+
+void emit_jit_byte(JitAssembler *a, u32 b) {
+    append_byte_to_slice(&a->code, (byte)b);
+}
+
+void emit_jit_u32(JitAssembler *a, u32 x) {
+    for (u32 i = 0; i < 4; i++) {
+        emit_jit_byte(a, (x >> (8 * i)) & 0xFF);
+    }
+}
+
+void emit_jit_u64(JitAssembler *a, u64 x) {
+    emit_jit_u32(a, (u32)x);
+    emit_jit_u32(a, (u32)(x >> 32));
+}
+
+void patch_jit_u32(JitAssembler *a, u32 pos, u32 x) {
+    for (u32 i = 0; i < 4; i++) {
+        a->code.elem[pos + i] = (byte)((x >> (8 * i)) & 0xFF);
+    }
+}
+
+// emit_jit_opcode writes mandatory prefix if there is one, REX prefix if it
+// is needed and opcode of one to three bytes
+void emit_jit_opcode(JitAssembler *a, u32 prefix, bool wide, u32 opcode, u32 reg, u32 rm) {
+    if (prefix != 0) {
+        emit_jit_byte(a, prefix);
+    }
+    u32 rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40) {
+        emit_jit_byte(a, rex);
+    }
+    if (opcode > 0xFFFF) {
+        emit_jit_byte(a, opcode >> 16);
+    }
+    if (opcode > 0xFF) {
+        emit_jit_byte(a, (opcode >> 8) & 0xFF);
+    }
+    emit_jit_byte(a, opcode & 0xFF);
+}
+
+// emit_jit_mem writes instruction with register operand, or opcode
+// extension in place of it, and memory operand [base + disp]
+void emit_jit_mem(JitAssembler *a, u32 prefix, bool wide, u32 opcode, u32 reg, JitReg base, i32 disp) {
+    emit_jit_opcode(a, prefix, wide, opcode, reg, base);
+    emit_jit_byte(a, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == jr_Rsp) {
+        emit_jit_byte(a, 0x24);
+    }
+    emit_jit_u32(a, (u32)disp);
+}
+
+// emit_jit_reg writes instruction with two register operands
+void emit_jit_reg(JitAssembler *a, u32 prefix, bool wide, u32 opcode, u32 reg, u32 rm) {
+    emit_jit_opcode(a, prefix, wide, opcode, reg, rm);
+    emit_jit_byte(a, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+i32 get_jit_disp(u32 r) {
+    return (i32)(r * sizeof(VmValue));
+}
+
+// emit_jit_load loads bytecode register into machine register
+void emit_jit_load(JitAssembler *a, JitReg reg, u32 r) {
+    emit_jit_mem(a, 0, true, 0x8B, reg, jit_base_reg, get_jit_disp(r));
+}
+
+// emit_jit_store stores machine register into bytecode register
+void emit_jit_store(JitAssembler *a, u32 r, JitReg reg) {
+    emit_jit_mem(a, 0, true, 0x89, reg, jit_base_reg, get_jit_disp(r));
+}
+
+void emit_jit_move(JitAssembler *a, JitReg dst, JitReg src) {
+    emit_jit_reg(a, 0, true, 0x8B, dst, src);
+}
+
+// emit_jit_move_imm uses the shortest of zero-extended, sign-extended and
+// full 64-bit immediate
+void emit_jit_move_imm(JitAssembler *a, JitReg reg, u64 x) {
+    if (x <= 0xFFFFFFFF) {
+        emit_jit_opcode(a, 0, false, 0xB8 + (reg & 7), 0, reg);
+        emit_jit_u32(a, (u32)x);
+    } else if ((i64)x == (i64)(i32)(u32)x) {
+        emit_jit_reg(a, 0, true, 0xC7, 0, reg);
+        emit_jit_u32(a, (u32)x);
+    } else {
+        emit_jit_opcode(a, 0, true, 0xB8 + (reg & 7), 0, reg);
+        emit_jit_u64(a, x);
+    }
+}
+
+// emit_jit_alu_imm writes instruction of group 1 with immediate operand,
+// ext selects operation: 0 add, 4 and, 5 sub, 6 xor, 7 cmp
+void emit_jit_alu_imm(JitAssembler *a, u32 ext, JitReg reg, i32 x) {
+    if (x >= -128 && x <= 127) {
+        emit_jit_reg(a, 0, true, 0x83, ext, reg);
+        emit_jit_byte(a, (u32)x & 0xFF);
+        return;
+    }
+    emit_jit_reg(a, 0, true, 0x81, ext, reg);
+    emit_jit_u32(a, (u32)x);
+}
+
+void emit_jit_setcc(JitAssembler *a, JitCond cond, JitReg reg) {
+    emit_jit_reg(a, 0, false, 0x0F90 | cond, 0, reg);
+}
+
+// emit_jit_store_flag stores bool from al
+void emit_jit_store_flag(JitAssembler *a, u32 r) {
+    emit_jit_reg(a, 0, false, 0x0FB6, jr_Rax, jr_Rax);
+    emit_jit_store(a, r, jr_Rax);
+}
+
+void emit_jit_push(JitAssembler *a, JitReg reg) {
+    emit_jit_opcode(a, 0, false, 0x50 + (reg & 7), 0, reg);
+}
+
+void emit_jit_pop(JitAssembler *a, JitReg reg) {
+    emit_jit_opcode(a, 0, false, 0x58 + (reg & 7), 0, reg);
+}
+
+// emit_jit_call_helper calls C function, native code is entered with
+// machine stack misaligned by return address
+void emit_jit_call_helper(JitAssembler *a, u64 helper) {
+    emit_jit_move_imm(a, jr_Rax, helper);
+    emit_jit_alu_imm(a, 5, jr_Rsp, 8);
+    emit_jit_reg(a, 0, false, 0xFF, 2, jr_Rax);
+    emit_jit_alu_imm(a, 0, jr_Rsp, 8);
+}
+
+// emit_jit_jump_rel writes jump with 32-bit displacement and returns
+// position of the displacement, condition is ignored for unconditional jump
+u32 emit_jit_jump_rel(JitAssembler *a, bool conditional, JitCond cond) {
+    if (conditional) {
+        emit_jit_byte(a, 0x0F);
+        emit_jit_byte(a, 0x80 | cond);
+    } else {
+        emit_jit_byte(a, 0xE9);
+    }
+    u32 pos = a->code.len;
+    emit_jit_u32(a, 0);
+    return pos;
+}
+
+// emit_jit_short_jump writes jump with 8-bit displacement which is set by
+// bind_jit_short_jump, condition is ignored for unconditional jump
+u32 emit_jit_short_jump(JitAssembler *a, bool conditional, JitCond cond) {
+    emit_jit_byte(a, conditional ? 0x70 | cond : 0xEB);
+    emit_jit_byte(a, 0);
+    return a->code.len - 1;
+}
+
+void bind_jit_short_jump(JitAssembler *a, u32 pos) {
+    a->code.elem[pos] = (byte)(a->code.len - pos - 1);
+}
+
+void emit_jit_jump(JitAssembler *a, bool conditional, JitCond cond, u32 target) {
+    u32 pos                = emit_jit_jump_rel(a, conditional, cond);
+    a->jumps[a->jumps_len] = (JitFixup){.pos = pos, .target = target};
+    a->jumps_len++;
+}
+
+u32 add_jit_stub(JitAssembler *a, u32 ip, u32 dst) {
+    a->stubs[a->stubs_len] = (JitStub){.ip = ip, .dst = dst};
+    a->stubs_len++;
+    return a->stubs_len - 1;
+}
+
+// emit_jit_guard leaves native code through stub when condition holds
+void emit_jit_guard(JitAssembler *a, JitCond cond, u32 stub) {
+    u32 pos                  = emit_jit_jump_rel(a, true, cond);
+    a->guards[a->guards_len] = (JitFixup){.pos = pos, .target = stub};
+    a->guards_len++;
+}
+
+i32 get_jit_ctx_disp(u64 offset) {
+    return (i32)offset;
+}
+
+// Runtime functions called by native code
+
+const VmString *concat_jit_strings(JitContext *ctx, const VmString *a, const VmString *b) {
+    return concat_vm_strings(ctx->rt, a, b);
+}
+
+void print_jit_values(JitContext *ctx, const VmValue *base, u32 builtin, const u32 *list) {
+    for (u32 i = 0; i < list[0]; i++) {
+        ctx->scratch[i] = base[list[2 * i + 1]];
+        ctx->kinds[i]   = (VmKind)list[2 * i + 2];
+    }
+    print_vm_values(ctx->rt, builtin, ctx->scratch, ctx->kinds, list[0]);
+}
+
+void save_jit_frame(JitContext *ctx, VmValue *base, u32 fn, u32 ip, u32 dst) {
+    ctx->frames[ctx->frames_len] = (JitFrame){
+        .fn   = fn,
+        .ip   = ip,
+        .base = base,
+        .dst  = dst,
+    };
+    ctx->frames_len++;
+}
+
+u64 get_jit_helper(const void *helper) {
+    return (u64)(uintptr_t)helper;
+}
+
+void emit_jit_divide(JitAssembler *a, const BcInstruction *inst, u32 retry) {
+    bool is_signed = inst->op == bc_DivS || inst->op == bc_RemS;
+    bool is_rem    = inst->op == bc_RemS || inst->op == bc_RemU;
+    emit_jit_load(a, jr_Rcx, inst->c);
+    emit_jit_reg(a, 0, true, 0x85, jr_Rcx, jr_Rcx);
+    emit_jit_guard(a, jc_E, retry);
+    u32 done = 0;
+    if (is_signed) {
+        // idiv faults on minimal value divided by -1
+        emit_jit_alu_imm(a, 7, jr_Rcx, -1);
+        u32 regular = emit_jit_short_jump(a, true, jc_NE);
+        if (is_rem) {
+            emit_jit_reg(a, 0, false, 0x31, jr_Rax, jr_Rax);
+        } else {
+            emit_jit_load(a, jr_Rax, inst->b);
+            emit_jit_reg(a, 0, true, 0xF7, 3, jr_Rax);
+        }
+        emit_jit_store(a, inst->a, jr_Rax);
+        done = emit_jit_short_jump(a, false, jc_E);
+        bind_jit_short_jump(a, regular);
+    }
+    emit_jit_load(a, jr_Rax, inst->b);
+    if (is_signed) {
+        emit_jit_byte(a, 0x48);
+        emit_jit_byte(a, 0x99);
+        emit_jit_reg(a, 0, true, 0xF7, 7, jr_Rcx);
+    } else {
+        emit_jit_reg(a, 0, false, 0x31, jr_Rdx, jr_Rdx);
+        emit_jit_reg(a, 0, true, 0xF7, 6, jr_Rcx);
+    }
+    emit_jit_store(a, inst->a, is_rem ? jr_Rdx : jr_Rax);
+    if (is_signed) {
+        bind_jit_short_jump(a, done);
+    }
+}
+
+// emit_jit_shift clamps count the same way as interpreter: shifting left
+// or logically right by 64 or more gives zero, arithmetic shift by 63
+void emit_jit_shift(JitAssembler *a, const BcInstruction *inst) {
+    emit_jit_load(a, jr_Rcx, inst->c);
+    emit_jit_load(a, jr_Rax, inst->b);
+    if (inst->op == bc_ShrS) {
+        emit_jit_move_imm(a, jr_Rdx, 63);
+        emit_jit_alu_imm(a, 7, jr_Rcx, 63);
+        emit_jit_reg(a, 0, true, 0x0F47, jr_Rcx, jr_Rdx);
+        emit_jit_reg(a, 0, true, 0xD3, 7, jr_Rax);
+    } else {
+        emit_jit_reg(a, 0, true, 0xD3, inst->op == bc_Shl ? 4 : 5, jr_Rax);
+        emit_jit_reg(a, 0, false, 0x31, jr_Rdx, jr_Rdx);
+        emit_jit_alu_imm(a, 7, jr_Rcx, 63);
+        emit_jit_reg(a, 0, true, 0x0F47, jr_Rax, jr_Rdx);
+    }
+    emit_jit_store(a, inst->a, jr_Rax);
+}
+
+// emit_jit_float_compare writes ordered comparison, unordered operands
+// compare as not equal and neither less nor greater
+void emit_jit_float_compare(JitAssembler *a, const BcInstruction *inst) {
+    bool swap = inst->op == bc_FLt || inst->op == bc_FLe;
+    emit_jit_mem(a, 0xF2, false, 0x0F10, 0, jit_base_reg, get_jit_disp(swap ? inst->c : inst->b));
+    emit_jit_mem(a, 0x66, false, 0x0F2E, 0, jit_base_reg, get_jit_disp(swap ? inst->b : inst->c));
+    switch (inst->op) {
+    case bc_FEq:
+        emit_jit_setcc(a, jc_E, jr_Rax);
+        emit_jit_setcc(a, jc_NP, jr_Rcx);
+        emit_jit_reg(a, 0, false, 0x20, jr_Rcx, jr_Rax);
+        break;
+    case bc_FNe:
+        emit_jit_setcc(a, jc_NE, jr_Rax);
+        emit_jit_setcc(a, jc_P, jr_Rcx);
+        emit_jit_reg(a, 0, false, 0x08, jr_Rcx, jr_Rax);
+        break;
+    case bc_FLt:
+        emit_jit_setcc(a, jc_A, jr_Rax);
+        break;
+    default:
+        emit_jit_setcc(a, jc_AE, jr_Rax);
+        break;
+    }
+    emit_jit_store_flag(a, inst->a);
+}
+
+void emit_jit_string_compare(JitAssembler *a, const BcInstruction *inst) {
+    const JitCond conds[] = {
+        [bc_StrEq] = jc_E,
+        [bc_StrNe] = jc_NE,
+        [bc_StrLt] = jc_L,
+        [bc_StrLe] = jc_LE,
+    };
+    emit_jit_load(a, jr_Rdi, inst->b);
+    emit_jit_load(a, jr_Rsi, inst->c);
+    emit_jit_call_helper(a, get_jit_helper((const void *)compare_vm_strings));
+    emit_jit_reg(a, 0, false, 0x85, jr_Rax, jr_Rax);
+    emit_jit_setcc(a, conds[inst->op], jr_Rax);
+    emit_jit_store_flag(a, inst->a);
+}
+
+// emit_jit_call checks the same limits as interpreter before the call and
+// calls callee through table of entries, so that it may be compiled later
+// than caller. Callee frame follows frame of caller as in interpreter
+void emit_jit_call(JitAssembler *a, const Jit *jit, const BcFunction *fn, u32 k) {
+    const BcInstruction *inst = &fn->code.elem[k];
+    const BcFunction *callee  = &jit->program->functions[inst->b];
+    const u32 *list           = fn->lists.elem + inst->c;
+    u32 retry                 = add_jit_stub(a, k, 0);
+
+    emit_jit_mem(a, 0, false, 0x81, 7, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, depth)));
+    emit_jit_u32(a, vm_max_frames);
+    emit_jit_guard(a, jc_AE, retry);
+    emit_jit_mem(a, 0, true, 0x3B, jr_Rsp, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, stack_limit)));
+    emit_jit_guard(a, jc_B, retry);
+    emit_jit_mem(a, 0, true, 0x8D, jr_Rax, jit_base_reg, get_jit_disp(fn->frame_size + callee->frame_size));
+    emit_jit_mem(a, 0, true, 0x3B, jr_Rax, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, end)));
+    emit_jit_guard(a, jc_A, retry);
+    emit_jit_mem(a, 0, true, 0x8B, jr_Rax, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, entries)));
+    emit_jit_mem(a, 0, true, 0x8B, jr_Rax, jr_Rax, get_jit_disp(inst->b));
+    emit_jit_reg(a, 0, true, 0x85, jr_Rax, jr_Rax);
+    emit_jit_guard(a, jc_E, retry);
+
+    for (u32 i = 0; i < list[0]; i++) {
+        emit_jit_load(a, jr_Rcx, list[i + 1]);
+        emit_jit_store(a, fn->frame_size + i, jr_Rcx);
+    }
+    emit_jit_mem(a, 0, false, 0xFF, 0, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, depth)));
+    emit_jit_push(a, jit_base_reg);
+    emit_jit_push(a, jit_results_reg);
+    emit_jit_alu_imm(a, 5, jr_Rsp, 8);
+    emit_jit_mem(a, 0, true, 0x8D, jit_results_reg, jit_base_reg, get_jit_disp(inst->a));
+    emit_jit_mem(a, 0, true, 0x8D, jit_base_reg, jit_base_reg, get_jit_disp(fn->frame_size));
+    emit_jit_reg(a, 0, false, 0xFF, 2, jr_Rax);
+    emit_jit_alu_imm(a, 0, jr_Rsp, 8);
+    emit_jit_pop(a, jit_results_reg);
+    emit_jit_pop(a, jit_base_reg);
+    emit_jit_mem(a, 0, false, 0xFF, 1, jit_ctx_reg, get_jit_ctx_disp(offsetof(JitContext, depth)));
+
+    // callee left native code, so does the caller
+    emit_jit_reg(a, 0, false, 0x85, jr_Rax, jr_Rax);
+    emit_jit_guard(a, jc_NE, add_jit_stub(a, k + 1, inst->a));
+}
+
+void emit_jit_return(JitAssembler *a, const BcFunction *fn, const BcInstruction *inst) {
+    const u32 *list = fn->lists.elem + inst->c;
+    for (u32 i = 0; i < list[0]; i++) {
+        emit_jit_load(a, jr_Rax, list[i + 1]);
+        emit_jit_mem(a, 0, true, 0x89, jr_Rax, jit_results_reg, get_jit_disp(i));
+    }
+    emit_jit_reg(a, 0, false, 0x31, jr_Rax, jr_Rax);
+    emit_jit_byte(a, 0xC3);
+}
+
+void emit_jit_instruction(JitAssembler *a, const Jit *jit, const BcFunction *fn, u32 k) {
+    const BcInstruction *inst = &fn->code.elem[k];
+    const u32 alu_opcodes[] = {
+        [bc_Add] = 0x03,
+        [bc_Sub] = 0x2B,
+        [bc_Mul] = 0x0FAF,
+        [bc_And] = 0x23,
+        [bc_Or]  = 0x0B,
+        [bc_Xor] = 0x33,
+    };
+    const u32 extend_opcodes[] = {
+        [bc_Sext8]  = 0x0FBE,
+        [bc_Sext16] = 0x0FBF,
+        [bc_Sext32] = 0x63,
+        [bc_Zext8]  = 0x0FB6,
+        [bc_Zext16] = 0x0FB7,
+        [bc_Zext32] = 0x8B,
+    };
+    const u32 float_opcodes[] = {
+        [bc_FAdd] = 0x0F58,
+        [bc_FSub] = 0x0F5C,
+        [bc_FMul] = 0x0F59,
+        [bc_FDiv] = 0x0F5E,
+    };
+    const JitCond conds[] = {
+        [bc_Eq]      = jc_E,
+        [bc_Ne]      = jc_NE,
+        [bc_LtS]     = jc_L,
+        [bc_LeS]     = jc_LE,
+        [bc_LtU]     = jc_B,
+        [bc_LeU]     = jc_BE,
+        [bc_JumpEq]  = jc_E,
+        [bc_JumpNe]  = jc_NE,
+        [bc_JumpLtS] = jc_L,
+        [bc_JumpLeS] = jc_LE,
+        [bc_JumpLtU] = jc_B,
+        [bc_JumpLeU] = jc_BE,
+    };
+
+    switch (inst->op) {
+    case bc_Move:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_Const:
+        emit_jit_move_imm(a, jr_Rax, jit->program->constants.elem[inst->b].u);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_Add:
+    case bc_Sub:
+    case bc_Mul:
+    case bc_And:
+    case bc_Or:
+    case bc_Xor:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_mem(a, 0, true, alu_opcodes[inst->op], jr_Rax, jit_base_reg, get_jit_disp(inst->c));
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_AddI:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_alu_imm(a, 0, jr_Rax, (i32)inst->c);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_DivS:
+    case bc_DivU:
+    case bc_RemS:
+    case bc_RemU:
+        emit_jit_divide(a, inst, add_jit_stub(a, k, 0));
+        break;
+    case bc_AndNot:
+        emit_jit_load(a, jr_Rax, inst->c);
+        emit_jit_reg(a, 0, true, 0xF7, 2, jr_Rax);
+        emit_jit_mem(a, 0, true, 0x23, jr_Rax, jit_base_reg, get_jit_disp(inst->b));
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_Shl:
+    case bc_ShrS:
+    case bc_ShrU:
+        emit_jit_shift(a, inst);
+        break;
+    case bc_Neg:
+    case bc_BitNot:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_reg(a, 0, true, 0xF7, inst->op == bc_Neg ? 3 : 2, jr_Rax);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_Not:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_alu_imm(a, 6, jr_Rax, 1);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_Sext8:
+    case bc_Sext16:
+    case bc_Sext32:
+    case bc_Zext8:
+    case bc_Zext16:
+    case bc_Zext32: {
+        // zero extension to 32 bits clears upper half of register as well
+        bool wide = inst->op == bc_Sext8 || inst->op == bc_Sext16 || inst->op == bc_Sext32;
+        emit_jit_mem(a, 0, wide, extend_opcodes[inst->op], jr_Rax, jit_base_reg, get_jit_disp(inst->b));
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    }
+    case bc_Eq:
+    case bc_Ne:
+    case bc_LtS:
+    case bc_LeS:
+    case bc_LtU:
+    case bc_LeU:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_mem(a, 0, true, 0x3B, jr_Rax, jit_base_reg, get_jit_disp(inst->c));
+        emit_jit_setcc(a, conds[inst->op], jr_Rax);
+        emit_jit_store_flag(a, inst->a);
+        break;
+    case bc_FAdd:
+    case bc_FSub:
+    case bc_FMul:
+    case bc_FDiv:
+        emit_jit_mem(a, 0xF2, false, 0x0F10, 0, jit_base_reg, get_jit_disp(inst->b));
+        emit_jit_mem(a, 0xF2, false, float_opcodes[inst->op], 0, jit_base_reg, get_jit_disp(inst->c));
+        emit_jit_mem(a, 0xF2, false, 0x0F11, 0, jit_base_reg, get_jit_disp(inst->a));
+        break;
+    case bc_FNeg:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_reg(a, 0, true, 0x0FBA, 7, jr_Rax);
+        emit_jit_byte(a, 63);
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_FRound32:
+        emit_jit_mem(a, 0xF2, false, 0x0F5A, 0, jit_base_reg, get_jit_disp(inst->b));
+        emit_jit_reg(a, 0xF3, false, 0x0F5A, 0, 0);
+        emit_jit_mem(a, 0xF2, false, 0x0F11, 0, jit_base_reg, get_jit_disp(inst->a));
+        break;
+    case bc_FEq:
+    case bc_FNe:
+    case bc_FLt:
+    case bc_FLe:
+        emit_jit_float_compare(a, inst);
+        break;
+    case bc_Concat:
+        emit_jit_move(a, jr_Rdi, jit_ctx_reg);
+        emit_jit_load(a, jr_Rsi, inst->b);
+        emit_jit_load(a, jr_Rdx, inst->c);
+        emit_jit_call_helper(a, get_jit_helper((const void *)concat_jit_strings));
+        emit_jit_store(a, inst->a, jr_Rax);
+        break;
+    case bc_StrEq:
+    case bc_StrNe:
+    case bc_StrLt:
+    case bc_StrLe:
+        emit_jit_string_compare(a, inst);
+        break;
+    case bc_Jump:
+        if (inst->c != k + 1) {
+            emit_jit_jump(a, false, jc_E, inst->c);
+        }
+        break;
+    case bc_JumpIf:
+    case bc_JumpIfNot:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_reg(a, 0, true, 0x85, jr_Rax, jr_Rax);
+        emit_jit_jump(a, true, inst->op == bc_JumpIf ? jc_NE : jc_E, inst->c);
+        break;
+    case bc_JumpEq:
+    case bc_JumpNe:
+    case bc_JumpLtS:
+    case bc_JumpLeS:
+    case bc_JumpLtU:
+    case bc_JumpLeU:
+        emit_jit_load(a, jr_Rax, inst->a);
+        emit_jit_mem(a, 0, true, 0x3B, jr_Rax, jit_base_reg, get_jit_disp(inst->b));
+        emit_jit_jump(a, true, conds[inst->op], inst->c);
+        break;
+    case bc_MoveJump:
+        emit_jit_load(a, jr_Rax, inst->b);
+        emit_jit_store(a, inst->a, jr_Rax);
+        emit_jit_jump(a, false, jc_E, inst->c);
+        break;
+    case bc_Call:
+    case bc_CallJit:
+        emit_jit_call(a, jit, fn, k);
+        break;
+    case bc_CallBuiltin:
+        emit_jit_move(a, jr_Rdi, jit_ctx_reg);
+        emit_jit_move(a, jr_Rsi, jit_base_reg);
+        emit_jit_move_imm(a, jr_Rdx, inst->b);
+        emit_jit_move_imm(a, jr_Rcx, get_jit_helper(fn->lists.elem + inst->c));
+        emit_jit_call_helper(a, get_jit_helper((const void *)print_jit_values));
+        break;
+    case bc_Return:
+        emit_jit_return(a, fn, inst);
+        break;
+    case bc_end:
+        break;
+    }
+}
+
+// emit_jit_stub records frame and returns to caller with nonzero status
+void emit_jit_stub(JitAssembler *a, u32 fn, JitStub stub) {
+    emit_jit_move(a, jr_Rdi, jit_ctx_reg);
+    emit_jit_move(a, jr_Rsi, jit_base_reg);
+    emit_jit_move_imm(a, jr_Rdx, fn);
+    emit_jit_move_imm(a, jr_Rcx, stub.ip);
+    emit_jit_move_imm(a, jr_R8, stub.dst);
+    emit_jit_call_helper(a, get_jit_helper((const void *)save_jit_frame));
+    emit_jit_move_imm(a, jr_Rax, 1);
+    emit_jit_byte(a, 0xC3);
+}
+
+// map_jit_code copies code into new pages which are made executable and
+// read-only afterwards, returns nil on failure
+void *map_jit_code(Jit *jit, const byte *code, u32 len) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) {
+        return nil;
+    }
+    u64 size   = ((u64)len + (u64)page - 1) / (u64)page * (u64)page;
+    void *addr = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return nil;
+    }
+    memcpy(addr, code, len);
+    if (mprotect(addr, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(addr, size);
+        return nil;
+    }
+
+    if (jit->regions_len == jit->regions_cap) {
+        jit->regions_cap = jit->regions_cap == 0 ? 16 : 2 * jit->regions_cap;
+        jit->regions     = (JitRegion *)realloc_mem(at_Vm, jit->regions, jit->regions_cap * sizeof(JitRegion));
+        if (jit->regions == nil) {
+            fatal(1, "not enough memory for native code");
+        }
+    }
+    jit->regions[jit->regions_len] = (JitRegion){.addr = addr, .size = size};
+    jit->regions_len++;
+    return addr;
+}
+
+// compile_jit_function generates code of a single function, function is
+// entered at any instruction with frame base in rbx
+void compile_jit_function(Jit *jit, u32 index) {
+    const BcFunction *fn = &jit->program->functions[index];
+    u32 len              = fn->code.len;
+    JitAssembler a       = {
+        .code       = empty_slice_of_bytes,
+        .jumps      = (JitFixup *)alloc_jit_mem((u64)len * sizeof(JitFixup) + 1),
+        .jumps_len  = 0,
+        .guards     = (JitFixup *)alloc_jit_mem((u64)len * jit_max_guards * sizeof(JitFixup) + 1),
+        .guards_len = 0,
+        .stubs      = (JitStub *)alloc_jit_mem((u64)len * jit_max_stubs * sizeof(JitStub) + 1),
+        .stubs_len  = 0,
+    };
+    u32 *offsets = (u32 *)alloc_jit_mem((u64)len * sizeof(u32) + 1);
+    for (u32 k = 0; k < len; k++) {
+        offsets[k] = a.code.len;
+        emit_jit_instruction(&a, jit, fn, k);
+    }
+    u32 *stub_offsets = (u32 *)alloc_jit_mem((u64)a.stubs_len * sizeof(u32) + 1);
+    for (u32 i = 0; i < a.stubs_len; i++) {
+        stub_offsets[i] = a.code.len;
+        emit_jit_stub(&a, index, a.stubs[i]);
+    }
+    for (u32 i = 0; i < a.jumps_len; i++) {
+        patch_jit_u32(&a, a.jumps[i].pos, offsets[a.jumps[i].target] - (a.jumps[i].pos + 4));
+    }
+    for (u32 i = 0; i < a.guards_len; i++) {
+        patch_jit_u32(&a, a.guards[i].pos, stub_offsets[a.guards[i].target] - (a.guards[i].pos + 4));
+    }
+
+    void *addr = map_jit_code(jit, a.code.elem, a.code.len);
+    if (addr == nil) {
+        jit->states[index] = js_Failed;
+        free_mem(offsets);
+    } else {
+        jit->states[index]      = js_Native;
+        jit->offsets[index]     = offsets;
+        jit->ctx.entries[index] = addr;
+    }
+    free_mem(stub_offsets);
+    free_mem(a.jumps);
+    free_mem(a.guards);
+    free_mem(a.stubs);
+    free_slice_of_bytes(a.code);
+}
+
+// compile_jit_functions compiles function and all functions reachable from
+// it through calls, so that hot code rarely leaves to interpreter
+void compile_jit_functions(Jit *jit, u32 root) {
+    const BcProgram *p = jit->program;
+    u32 *stack         = (u32 *)alloc_jit_mem((u64)p->functions_len * sizeof(u32) + 1);
+    bool *queued       = (bool *)alloc_zeroed_mem(at_Vm, (u64)p->functions_len * sizeof(bool) + 1);
+    if (queued == nil) {
+        fatal(1, "not enough memory for native code");
+    }
+    u32 len      = 1;
+    stack[0]     = root;
+    queued[root] = true;
+    while (len != 0) {
+        len--;
+        u32 index = stack[len];
+        compile_jit_function(jit, index);
+        slice_of_BcInstructions code = p->functions[index].code;
+        for (u32 k = 0; k < code.len; k++) {
+            u32 callee = code.elem[k].b;
+            bool call  = code.elem[k].op == bc_Call || code.elem[k].op == bc_CallJit;
+            if (call && !queued[callee] && jit->states[callee] == js_Bytecode) {
+                queued[callee] = true;
+                stack[len]     = callee;
+                len++;
+            }
+        }
+    }
+    free_mem(stack);
+    free_mem(queued);
+}
+
+// create_jit_trampoline generates entry from C: it saves callee-saved
+// registers used by native code, sets them from arguments and calls code
+// at given address
+void create_jit_trampoline(Jit *jit) {
+    JitAssembler a = {
+        .code       = empty_slice_of_bytes,
+        .jumps      = nil,
+        .jumps_len  = 0,
+        .guards     = nil,
+        .guards_len = 0,
+        .stubs      = nil,
+        .stubs_len  = 0,
+    };
+    emit_jit_push(&a, jr_Rbp);
+    emit_jit_push(&a, jit_base_reg);
+    emit_jit_push(&a, jit_ctx_reg);
+    emit_jit_push(&a, jit_results_reg);
+    emit_jit_alu_imm(&a, 5, jr_Rsp, 8);
+    emit_jit_move(&a, jit_base_reg, jr_Rdi);
+    emit_jit_move(&a, jit_ctx_reg, jr_Rsi);
+    emit_jit_move(&a, jit_results_reg, jr_Rdx);
+    emit_jit_reg(&a, 0, false, 0xFF, 2, jr_Rcx);
+    emit_jit_alu_imm(&a, 0, jr_Rsp, 8);
+    emit_jit_pop(&a, jit_results_reg);
+    emit_jit_pop(&a, jit_ctx_reg);
+    emit_jit_pop(&a, jit_base_reg);
+    emit_jit_pop(&a, jr_Rbp);
+    emit_jit_byte(&a, 0xC3);
+    jit->trampoline = map_jit_code(jit, a.code.elem, a.code.len);
+    free_slice_of_bytes(a.code);
+}
+
+Jit *new_jit(const BcProgram *p, VmRuntime *rt, const VmValue *end, u32 threshold) {
+    Jit *jit = (Jit *)alloc_jit_mem(sizeof(Jit));
+
+    // machine stack of native calls ends below stack of the caller
+    byte marker   = 0;
+    u32 results   = 1;
+    u64 functions = (u64)p->functions_len + 1;
+    for (u32 i = 0; i < p->functions_len; i++) {
+        if (p->functions[i].results > results) {
+            results = p->functions[i].results;
+        }
+    }
+    *jit = (Jit){
+        .program = p,
+        .ctx =
+            {
+                .entries     = (const void **)alloc_zeroed_mem(at_Vm, functions * sizeof(void *)),
+                .end         = end,
+                .stack_limit = (const void *)((uintptr_t)&marker - jit_stack_size),
+                .rt          = rt,
+                .depth       = 0,
+                .frames      = (JitFrame *)alloc_jit_mem(((u64)vm_max_frames + 1) * sizeof(JitFrame)),
+                .frames_len  = 0,
+                .scratch     = (VmValue *)alloc_jit_mem((u64)p->max_builtin_args * sizeof(VmValue) + 1),
+                .kinds       = (VmKind *)alloc_jit_mem((u64)p->max_builtin_args * sizeof(VmKind) + 1),
+            },
+        .heat        = (u32 *)alloc_zeroed_mem(at_Vm, functions * sizeof(u32)),
+        .threshold   = threshold,
+        .states      = (JitState *)alloc_zeroed_mem(at_Vm, functions * sizeof(JitState)),
+        .offsets     = (u32 **)alloc_zeroed_mem(at_Vm, functions * sizeof(u32 *)),
+        .regions     = nil,
+        .regions_len = 0,
+        .regions_cap = 0,
+        .trampoline  = nil,
+        .results     = (VmValue *)alloc_jit_mem((u64)results * sizeof(VmValue)),
+    };
+    if (jit->ctx.entries == nil || jit->heat == nil || jit->states == nil || jit->offsets == nil) {
+        fatal(1, "not enough memory for native code");
+    }
+    if (KU_JIT) {
+        create_jit_trampoline(jit);
+    }
+    return jit;
+}
+
+void free_jit(Jit *jit) {
+    for (u32 i = 0; i < jit->regions_len; i++) {
+        munmap(jit->regions[i].addr, jit->regions[i].size);
+    }
+    for (u32 i = 0; i < jit->program->functions_len; i++) {
+        free_mem(jit->offsets[i]);
+    }
+    free_mem(jit->regions);
+    free_mem(jit->offsets);
+    free_mem(jit->states);
+    free_mem(jit->heat);
+    free_mem(jit->results);
+    free_mem(jit->ctx.entries);
+    free_mem(jit->ctx.frames);
+    free_mem(jit->ctx.scratch);
+    free_mem(jit->ctx.kinds);
+    free_mem(jit);
+}
+
+bool heat_jit_function(Jit *jit, u32 fn) {
+    if (jit->states[fn] != js_Bytecode) {
+        return jit->states[fn] == js_Native;
+    }
+    jit->heat[fn]++;
+    if (jit->heat[fn] < jit->threshold || jit->trampoline == nil) {
+        return false;
+    }
+    compile_jit_functions(jit, fn);
+    return jit->states[fn] == js_Native;
+}
+
+bool run_jit_function(Jit *jit, u32 fn, u32 ip, VmValue *base, VmValue *results, u32 depth) {
+    JitTrampoline enter = (JitTrampoline)jit->trampoline;
+    const byte *start   = (const byte *)jit->ctx.entries[fn] + jit->offsets[fn][ip];
+    jit->ctx.depth      = depth;
+    jit->ctx.frames_len = 0;
+    return enter(base, &jit->ctx, results, start) == 0;
+}
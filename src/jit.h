@@ -0,0 +1,127 @@
+#ifndef KU_JIT_H
+#define KU_JIT_H
+
+#include "bytecode.h"
+#include "runtime.h"
+#include "types.h"
+
+// Native code is generated only for x86-64 System V targets, elsewhere all
+// functions stay in bytecode. Define KU_NO_JIT to disable code generation
+#if defined(__x86_64__) && !defined(KU_NO_JIT)
+#define KU_JIT 1
+#else
+#define KU_JIT 0
+#endif
+
+typedef enum JitState JitState;
+typedef struct JitFrame JitFrame;
+typedef struct JitContext JitContext;
+typedef struct JitRegion JitRegion;
+typedef struct Jit Jit;
+
+enum JitState {
+    js_Bytecode,
+    js_Native,
+
+    // compilation failed, function is never compiled again
+    js_Failed,
+};
+
+// JitFrame describes bytecode frame of function which ran natively when a
+// guard failed, interpreter continues the function from instruction ip
+struct JitFrame {
+    u32 fn;
+    u32 ip;
+    VmValue *base;
+
+    // first register of the frame which receives results of call, frame of
+    // the function whose guard failed does not have it
+    u32 dst;
+};
+
+// JitContext is shared by native code and interpreter, native code reaches
+// it through a register and accesses fields at fixed offsets
+struct JitContext {
+    // native entry of each function, nil while it runs in bytecode
+    const void **entries;
+
+    // end of interpreter stack, native calls check that callee frame fits
+    const VmValue *end;
+
+    // lowest address of machine stack available to native calls
+    const void *stack_limit;
+
+    VmRuntime *rt;
+
+    // number of interpreter frames as if native calls were interpreted
+    u32 depth;
+
+    // frames recorded after a guard failed, the innermost frame is the first
+    JitFrame *frames;
+    u32 frames_len;
+
+    // arguments of builtin calls
+    VmValue *scratch;
+    VmKind *kinds;
+};
+
+// JitRegion is memory mapped for code of a single function
+struct JitRegion {
+    void *addr;
+    u64 size;
+};
+
+// Jit compiles bytecode functions into machine code which keeps registers
+// of bytecode frame in memory, so that a failed guard can hand the frame
+// over to interpreter at any instruction. Guards check division by zero,
+// call depth and stack space; instead of raising the error natively, the
+// instruction is executed again by interpreter. Code pages are writable
+// only until code is copied into them, then they are only executable
+struct Jit {
+    const BcProgram *program;
+    JitContext ctx;
+
+    // number of calls and loop iterations of each function
+    u32 *heat;
+    u32 threshold;
+
+    JitState *states;
+
+    // native offset of each bytecode instruction by function, entry at any
+    // instruction is possible
+    u32 **offsets;
+
+    JitRegion *regions;
+    u32 regions_len;
+    u32 regions_cap;
+
+    // code which saves registers and enters native function
+    void *trampoline;
+
+    // results of entry function, they are discarded
+    VmValue *results;
+};
+
+// default number of calls or loop iterations after which function is
+// compiled
+extern const u32 jit_default_threshold;
+
+// new_jit prepares compilation of program functions which reach given
+// number of calls and loop iterations. Interpreter stack ends at end
+Jit *new_jit(const BcProgram *p, VmRuntime *rt, const VmValue *end, u32 threshold);
+
+// free_jit unmaps all generated code
+void free_jit(Jit *jit);
+
+// heat_jit_function counts call or loop iteration of function, it is
+// compiled when the count reaches threshold together with functions it
+// calls. Returns true if function has native code
+bool heat_jit_function(Jit *jit, u32 fn);
+
+// run_jit_function runs function natively from instruction ip with frame at
+// base, results are written from given register. Depth is number of
+// interpreter frames saved by callers. Returns false if a guard failed,
+// recorded frames are then in jit->ctx.frames
+bool run_jit_function(Jit *jit, u32 fn, u32 ip, VmValue *base, VmValue *results, u32 depth);
+
+#endif // KU_JIT_H
@@ -0,0 +1,189 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "fatal.h"
+#include "json.h"
+
+const byte json_hex_digits[] = "0123456789abcdef";
+
+JsonWriter init_json_writer(OutputBuffer *out) {
+    JsonWriter w = {
+        .out       = out,
+        .depth     = 0,
+        .after_key = false,
+    };
+    return w;
+}
+
+// begin_json_value places separator before next value in current container
+void begin_json_value(JsonWriter *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth == 0) {
+        return;
+    }
+    if (w->has_value[w->depth]) {
+        write_byte_to_output(w->out, ',');
+    }
+    w->has_value[w->depth] = true;
+}
+
+void open_json_container(JsonWriter *w, byte b) {
+    begin_json_value(w);
+    if (w->depth + 1 >= JSON_MAX_DEPTH) {
+        fatal(1, "JSON nesting is too deep");
+    }
+    write_byte_to_output(w->out, b);
+    w->depth++;
+    w->has_value[w->depth] = false;
+}
+
+void close_json_container(JsonWriter *w, byte b) {
+    if (w->depth == 0) {
+        fatal(1, "no open JSON container");
+    }
+    write_byte_to_output(w->out, b);
+    w->depth--;
+}
+
+void begin_json_object(JsonWriter *w) {
+    open_json_container(w, '{');
+}
+
+void end_json_object(JsonWriter *w) {
+    close_json_container(w, '}');
+}
+
+void begin_json_array(JsonWriter *w) {
+    open_json_container(w, '[');
+}
+
+void end_json_array(JsonWriter *w) {
+    close_json_container(w, ']');
+}
+
+void write_json_key(JsonWriter *w, str key) {
+    begin_json_value(w);
+    write_byte_to_output(w->out, '"');
+    write_json_escaped_str(w->out, key);
+    write_bytes_to_output(w->out, (const byte *)"\":", 2);
+    w->after_key = true;
+}
+
+void write_json_str(JsonWriter *w, str s) {
+    begin_json_value(w);
+    write_byte_to_output(w->out, '"');
+    write_json_escaped_str(w->out, s);
+    write_byte_to_output(w->out, '"');
+}
+
+void write_json_u64(JsonWriter *w, u64 n) {
+    begin_json_value(w);
+    write_u64_to_output(w->out, n);
+}
+
+void write_json_bool(JsonWriter *w, bool b) {
+    begin_json_value(w);
+    if (b) {
+        write_bytes_to_output(w->out, (const byte *)"true", 4);
+    } else {
+        write_bytes_to_output(w->out, (const byte *)"false", 5);
+    }
+}
+
+void write_json_null(JsonWriter *w) {
+    begin_json_value(w);
+    write_bytes_to_output(w->out, (const byte *)"null", 4);
+}
+
+bool needs_json_escape(byte b) {
+    return b < 0x20 || b == '"' || b == '\\';
+}
+
+// find_json_escape returns index of the first byte starting from given index
+// which cannot be placed into JSON string as is, len is returned if there is
+// no such byte. Bytes above ASCII range are passed through, text is expected
+// to be valid UTF-8
+u64 find_json_escape(const byte *bytes, u64 start, u64 len) {
+    u64 i = start;
+
+#if defined(__SSE2__)
+    // check 16 bytes at once, most literals and identifiers contain
+    // nothing to escape
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control   = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+
+        // unsigned v <= 0x1F if min(v, 0x1F) == v
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, control), v);
+        m         = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+        m         = _mm_or_si128(m, _mm_cmpeq_epi8(v, backslash));
+
+        u32 mask = (u32)_mm_movemask_epi8(m);
+        if (mask != 0) {
+            return i + (u64)__builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (needs_json_escape(bytes[i])) {
+            return i;
+        }
+    }
+    return len;
+}
+
+void write_json_escape(OutputBuffer *out, byte b) {
+    byte esc[6] = {'\\', 0, 0, 0, 0, 0};
+    switch (b) {
+    case '"':
+    case '\\':
+        esc[1] = b;
+        break;
+    case '\n':
+        esc[1] = 'n';
+        break;
+    case '\r':
+        esc[1] = 'r';
+        break;
+    case '\t':
+        esc[1] = 't';
+        break;
+    case '\b':
+        esc[1] = 'b';
+        break;
+    case '\f':
+        esc[1] = 'f';
+        break;
+    default:
+        esc[1] = 'u';
+        esc[2] = '0';
+        esc[3] = '0';
+        esc[4] = json_hex_digits[b >> 4];
+        esc[5] = json_hex_digits[b & 0xF];
+        write_bytes_to_output(out, esc, 6);
+        return;
+    }
+    write_bytes_to_output(out, esc, 2);
+}
+
+// write_json_escaped_str writes contents of JSON string without quotes,
+// runs of bytes which need no escaping are copied as a whole
+void write_json_escaped_str(OutputBuffer *out, str s) {
+    u64 start = 0;
+    while (start < s.len) {
+        u64 i = find_json_escape(s.bytes, start, s.len);
+        write_bytes_to_output(out, s.bytes + start, i - start);
+        if (i == s.len) {
+            return;
+        }
+        write_json_escape(out, s.bytes[i]);
+        start = i + 1;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef KU_JSON_H
+#define KU_JSON_H
+
+#include "output.h"
+#include "str.h"
+#include "types.h"
+
+#define JSON_MAX_DEPTH 64
+
+typedef struct JsonWriter JsonWriter;
+
+// JsonWriter emits JSON text directly into output buffer while values are
+// produced, without building document in memory. Commas and colons are
+// placed by writer, caller only opens and closes containers in proper order.
+//
+// Values written at the top level are not separated, so that caller may
+// put them on separate lines as in NDJSON
+struct JsonWriter {
+    OutputBuffer *out;
+
+    // number of currently open objects and arrays
+    u32 depth;
+
+    // has_value[d] is true if container at depth d already has a value,
+    // next value in it must be preceded by comma
+    bool has_value[JSON_MAX_DEPTH];
+
+    // key was just written, value follows without comma
+    bool after_key;
+};
+
+JsonWriter init_json_writer(OutputBuffer *out);
+void begin_json_object(JsonWriter *w);
+void end_json_object(JsonWriter *w);
+void begin_json_array(JsonWriter *w);
+void end_json_array(JsonWriter *w);
+void write_json_key(JsonWriter *w, str key);
+void write_json_str(JsonWriter *w, str s);
+void write_json_u64(JsonWriter *w, u64 n);
+void write_json_bool(JsonWriter *w, bool b);
+void write_json_null(JsonWriter *w);
+void write_json_escaped_str(OutputBuffer *out, str s);
+u64 find_json_escape(const byte *bytes, u64 start, u64 len);
+
+#endif // KU_JSON_H
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "json.h"
+
+typedef struct JsonEscapeTestCase JsonEscapeTestCase;
+
+struct JsonEscapeTestCase {
+    u64 id;
+    str label;
+    str input;
+    str want;
+};
+
+// inputs longer than 16 bytes place escaped bytes at different positions
+// of vector blocks and in scalar tail
+const u32 number_of_test_cases = 10;
+
+const JsonEscapeTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("empty string"),
+        .input = EMPTY_STR,
+        .want  = EMPTY_STR,
+    },
+    {
+        .id    = 2,
+        .label = STR("nothing to escape"),
+        .input = STR("identifier_with_more_than_thirty_two_bytes_in_it"),
+        .want  = STR("identifier_with_more_than_thirty_two_bytes_in_it"),
+    },
+    {
+        .id    = 3,
+        .label = STR("quote and backslash"),
+        .input = STR("\"a\\b\""),
+        .want  = STR("\\\"a\\\\b\\\""),
+    },
+    {
+        .id    = 4,
+        .label = STR("short escapes"),
+        .input = STR("\n\r\t\b\f"),
+        .want  = STR("\\n\\r\\t\\b\\f"),
+    },
+    {
+        .id    = 5,
+        .label = STR("other control bytes"),
+        .input = STR("\x01\x1f"),
+        .want  = STR("\\u0001\\u001f"),
+    },
+    {
+        .id    = 6,
+        .label = STR("escape at the end of first block"),
+        .input = STR("0123456789abcde\"0123456789"),
+        .want  = STR("0123456789abcde\\\"0123456789"),
+    },
+    {
+        .id    = 7,
+        .label = STR("escape at the start of second block"),
+        .input = STR("0123456789abcdef\n0123456789abcdef"),
+        .want  = STR("0123456789abcdef\\n0123456789abcdef"),
+    },
+    {
+        .id    = 8,
+        .label = STR("escape in scalar tail"),
+        .input = STR("0123456789abcdef01\\"),
+        .want  = STR("0123456789abcdef01\\\\"),
+    },
+    {
+        .id    = 9,
+        .label = STR("bytes above ASCII range"),
+        .input = STR("\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \x7f \xff"),
+        .want  = STR("\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \x7f \xff"),
+    },
+    {
+        .id    = 10,
+        .label = STR("space and byte below it"),
+        .input = STR(" \x1f \x20"),
+        .want  = STR(" \\u001f  "),
+    },
+};
+
+const str writer_test_label = STR("nested containers");
+const str writer_test_want  = STR("{\"a\":[1,{},[null,false],\"x\\ty\"],\"b\":true}");
+const str key_a             = STR("a");
+const str key_b             = STR("b");
+const str value_x           = STR("x\ty");
+
+const str pass_str = STR("    json_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+// large enough to keep output of any test case in memory
+const u64 test_json_buffer_cap = 1 << 12;
+
+void print_failed_test_case(u64 id, str label, str want, str got) {
+    str id_str = format_u64_as_decimal(id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+bool run_test_case(JsonEscapeTestCase test_case) {
+    OutputBuffer out = new_output_buffer(-1, test_json_buffer_cap);
+    write_json_escaped_str(&out, test_case.input);
+
+    str got     = borrow_str_from_bytes(out.bytes, out.len);
+    bool failed = !are_strs_equal(got, test_case.want);
+    if (failed) {
+        print_failed_test_case(test_case.id, test_case.label, test_case.want, got);
+    }
+    free_output_buffer(&out);
+    return failed;
+}
+
+// run_writer_test checks placement of separators in nested containers
+bool run_writer_test() {
+    OutputBuffer out = new_output_buffer(-1, test_json_buffer_cap);
+    JsonWriter w     = init_json_writer(&out);
+
+    begin_json_object(&w);
+    write_json_key(&w, key_a);
+    begin_json_array(&w);
+    write_json_u64(&w, 1);
+    begin_json_object(&w);
+    end_json_object(&w);
+    begin_json_array(&w);
+    write_json_null(&w);
+    write_json_bool(&w, false);
+    end_json_array(&w);
+    write_json_str(&w, value_x);
+    end_json_array(&w);
+    write_json_key(&w, key_b);
+    write_json_bool(&w, true);
+    end_json_object(&w);
+
+    str got     = borrow_str_from_bytes(out.bytes, out.len);
+    bool failed = !are_strs_equal(got, writer_test_want);
+    if (failed) {
+        print_failed_test_case(number_of_test_cases + 1, writer_test_label, writer_test_want, got);
+    }
+    free_output_buffer(&out);
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (run_writer_test()) {
+        failed_test_cases++;
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
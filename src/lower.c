@@ -0,0 +1,757 @@
+#include <string.h>
+
+#include "fatal.h"
+#include "lower.h"
+#include "resolve.h"
+#include "strop.h"
+#include "type_check.h"
+
+typedef struct Lowerer Lowerer;
+typedef struct MergeSet MergeSet;
+
+struct Lowerer {
+    const TypeTable *table;
+    const StandaloneSourceTree *tree;
+
+    // function being built
+    IrFunction *fn;
+
+    // current value of each local symbol indexed by Symbol.index, IR_NONE if
+    // symbol is not defined yet
+    ValueId *env;
+
+    // number of local symbols of current function
+    u32 locals;
+
+    // number of parameters of current function, named results follow them
+    // in local symbol numbering
+    u32 params;
+
+    bool named_results;
+
+    // name of current function, errors of nodes without position refer to it
+    Token function_name;
+
+    slice_of_LowerErrors errors;
+};
+
+// MergeSet lists variables which are assigned inside if statement or loop
+// and were defined before it. Their values are merged by block parameters
+// at the end of if statement and at loop header
+struct MergeSet {
+    // symbol indices in ascending order
+    u32 *locals;
+
+    // types of merged values
+    TypeId *types;
+
+    u32 len;
+};
+
+IMPLEMENT_SLICE(LowerError)
+
+void *alloc_lower_temp(u64 size) {
+    void *p = alloc_mem(at_IR, size + 1);
+    if (p == nil) {
+        fatal(1, "not enough memory for lowering");
+    }
+    return p;
+}
+
+void add_lower_error(Lowerer *l, LowerErrorType type, Position pos, str name) {
+    LowerError err = {
+        .type = type,
+        .pos  = pos,
+        .name = name,
+    };
+    append_LowerError_to_slice(&l->errors, err);
+}
+
+ValueId add_constant(Lowerer *l, TypeId type, u64 bits) {
+    IrInstruction *inst = add_ir_instruction(l->fn, op_Const, type, nil, 0);
+    inst->imm           = bits;
+    return inst->result;
+}
+
+ValueId add_value_instruction(Lowerer *l, IrOpcode op, TypeId type, const ValueId *operands, u32 len) {
+    return add_ir_instruction(l->fn, op, type, operands, len)->result;
+}
+
+void add_jump(Lowerer *l, BlockId target, const ValueId *args, u32 len) {
+    IrInstruction *inst = add_ir_instruction(l->fn, op_Jump, ti_Void, args, len);
+    inst->targets[0]    = target;
+}
+
+// add_branch emits conditional jump without block arguments
+void add_branch(Lowerer *l, ValueId condition, BlockId then_block, BlockId else_block) {
+    IrInstruction *inst = add_ir_instruction(l->fn, op_Branch, ti_Void, &condition, 1);
+    inst->targets[0]    = then_block;
+    inst->targets[1]    = else_block;
+}
+
+// open_new_block starts fresh block without parameters, it is also used to
+// hold unreachable code following return statement
+BlockId open_new_block(Lowerer *l) {
+    BlockId block = new_ir_block(l->fn, 0, nil);
+    open_ir_block(l->fn, block);
+    return block;
+}
+
+// get_value_type returns type of value produced by expression, untyped
+// expressions get default type
+TypeId get_value_type(Expression expr) {
+    return get_default_type(expr.type_id);
+}
+
+ValueId lower_expression(Lowerer *l, Expression expr);
+
+// lower_constant emits value of folded expression, floats of both sizes are
+// stored as f64 bits
+ValueId lower_constant(Lowerer *l, Expression expr) {
+    Constant c  = expr.constant;
+    TypeId type = get_value_type(expr);
+    if (c.kind == ck_Float) {
+        u64 bits;
+        memcpy(&bits, &c.value.real, sizeof(bits));
+        return add_constant(l, type, bits);
+    }
+    return add_constant(l, type, c.value.integer);
+}
+
+slice_of_bytes decode_string_literal(str literal) {
+    slice_of_bytes b = empty_slice_of_bytes;
+    for (u64 i = 1; i + 1 < literal.len; i++) {
+        byte c = literal.bytes[i];
+        if (c != '\\' || i + 2 >= literal.len) {
+            append_byte_to_slice(&b, c);
+            continue;
+        }
+        i++;
+        switch (literal.bytes[i]) {
+        case 'n':
+            append_byte_to_slice(&b, '\n');
+            break;
+        case 't':
+            append_byte_to_slice(&b, '\t');
+            break;
+        case 'r':
+            append_byte_to_slice(&b, '\r');
+            break;
+        case '0':
+            append_byte_to_slice(&b, 0);
+            break;
+        default:
+            append_byte_to_slice(&b, literal.bytes[i]);
+            break;
+        }
+    }
+    return b;
+}
+
+ValueId lower_string(Lowerer *l, String *s) {
+    slice_of_bytes b    = decode_string_literal(s->token.literal);
+    u32 index           = add_ir_string(l->fn, borrow_str_from_bytes(b.elem, b.len));
+    IrInstruction *inst = add_ir_instruction(l->fn, op_String, ti_Str, nil, 0);
+    inst->imm           = index;
+    free_slice_of_bytes(b);
+    return inst->result;
+}
+
+ValueId lower_identifier(Lowerer *l, Expression expr) {
+    Identifier *ident = (Identifier *)expr.ptr;
+    Symbol *symbol    = ident->symbol;
+    if (symbol->kind == sk_Function || symbol->kind == sk_Builtin) {
+        add_lower_error(l, let_FunctionValue, ident->token.pos, ident->token.literal);
+        return add_constant(l, expr.type_id, 0);
+    }
+    return l->env[symbol->index];
+}
+
+IrOpcode get_unary_opcode(TokenType operator) {
+    switch (operator) {
+    case tt_Minus:
+        return op_Neg;
+    case tt_Not:
+        return op_Not;
+    default:
+        return op_BitNot;
+    }
+}
+
+ValueId lower_unary(Lowerer *l, Expression expr) {
+    UnaryExpression *unary = (UnaryExpression *)expr.ptr;
+    ValueId operand        = lower_expression(l, unary->operand);
+    if (unary->operator.type == tt_Plus) {
+        return operand;
+    }
+    return add_value_instruction(l, get_unary_opcode(unary->operator.type), get_value_type(expr), &operand, 1);
+}
+
+IrOpcode get_binary_opcode(TokenType operator) {
+    switch (operator) {
+    case tt_Plus:
+        return op_Add;
+    case tt_Minus:
+        return op_Sub;
+    case tt_Asterisk:
+        return op_Mul;
+    case tt_Slash:
+        return op_Div;
+    case tt_Percent:
+        return op_Rem;
+    case tt_Ampersand:
+        return op_And;
+    case tt_Pipe:
+        return op_Or;
+    case tt_Caret:
+        return op_Xor;
+    case tt_BitwiseAndNot:
+        return op_AndNot;
+    case tt_LeftShift:
+        return op_Shl;
+    case tt_RightShift:
+        return op_Shr;
+    case tt_Equal:
+        return op_Eq;
+    case tt_NotEqual:
+        return op_Ne;
+    case tt_Less:
+        return op_Lt;
+    case tt_LessOrEqual:
+        return op_Le;
+    case tt_Greater:
+        return op_Gt;
+    default:
+        return op_Ge;
+    }
+}
+
+ValueId add_binary(Lowerer *l, TokenType operator, TypeId type, ValueId left, ValueId right) {
+    ValueId operands[2] = {left, right};
+    return add_value_instruction(l, get_binary_opcode(operator), type, operands, 2);
+}
+
+// Logical operators evaluate right operand only if left one does not decide
+// result, both paths meet in a block with single bool parameter
+ValueId lower_logical(Lowerer *l, BinaryExpression *binary) {
+    ValueId left        = lower_expression(l, binary->left);
+    BlockId right_block = new_ir_block(l->fn, 0, nil);
+    BlockId merge       = new_ir_block(l->fn, 1, &(TypeId){ti_Bool});
+
+    ValueId operands[2] = {left, left};
+    IrInstruction *inst = add_ir_instruction(l->fn, op_Branch, ti_Void, operands, 2);
+    if (binary->operator.type == tt_LogicalAnd) {
+        inst->targets[0] = right_block;
+        inst->targets[1] = merge;
+        inst->then_args  = 0;
+    } else {
+        inst->targets[0] = merge;
+        inst->targets[1] = right_block;
+        inst->then_args  = 1;
+    }
+
+    open_ir_block(l->fn, right_block);
+    ValueId right = lower_expression(l, binary->right);
+    add_jump(l, merge, &right, 1);
+
+    open_ir_block(l->fn, merge);
+    return l->fn->blocks[merge].params;
+}
+
+ValueId lower_binary(Lowerer *l, Expression expr) {
+    BinaryExpression *binary = (BinaryExpression *)expr.ptr;
+    TokenType operator       = binary->operator.type;
+    if (operator == tt_LogicalAnd || operator == tt_LogicalOr) {
+        return lower_logical(l, binary);
+    }
+    ValueId left  = lower_expression(l, binary->left);
+    ValueId right = lower_expression(l, binary->right);
+    return add_binary(l, operator, get_value_type(expr), left, right);
+}
+
+// lower_call emits call of function or builtin, result is IR_NONE for calls
+// without value
+ValueId lower_call(Lowerer *l, CallExpression *call) {
+    slice_of_u32s args = empty_slice_of_u32s;
+    for (u32 i = 0; i < call->args.len; i++) {
+        append_u32_to_slice(&args, lower_expression(l, call->args.elem[i]));
+    }
+
+    Symbol *symbol = call->name.symbol;
+    IrInstruction *inst;
+    if (symbol->kind == sk_Builtin) {
+        inst      = add_ir_instruction(l->fn, op_CallBuiltin, ti_Void, args.elem, args.len);
+        inst->imm = symbol->index;
+    } else {
+        Type type = get_type(l->table, symbol->type);
+        inst      = add_ir_instruction(l->fn, op_Call, type.elem, args.elem, args.len);
+        inst->imm = (u64)(symbol->function - l->tree->functions.elem);
+    }
+    free_slice_of_u32s(args);
+    return inst->result;
+}
+
+ValueId lower_expression(Lowerer *l, Expression expr) {
+    if (expr.constant.kind != ck_None) {
+        return lower_constant(l, expr);
+    }
+    switch (expr.type) {
+    case et_Identifier:
+        return lower_identifier(l, expr);
+    case et_Call:
+        return lower_call(l, (CallExpression *)expr.ptr);
+    case et_StringLiteral:
+        return lower_string(l, (String *)expr.ptr);
+    case et_Unary:
+        return lower_unary(l, expr);
+    case et_Binary:
+        return lower_binary(l, expr);
+    default:
+        // literals reach this point only if folding missed them, value is
+        // produced to keep IR well formed, but module is not used
+        add_lower_error(l, let_UnsupportedExpression, get_expression_position(expr), l->function_name.literal);
+        return add_constant(l, get_value_type(expr), 0);
+    }
+}
+
+// lower_values evaluates expressions from left to right and appends their
+// values to list. Single call with several results gives each member as
+// a separate value
+void lower_values(Lowerer *l, slice_of_Expressions exprs, u32 want, slice_of_u32s *values) {
+    if (exprs.len == 1 && want > 1) {
+        ValueId tuple    = lower_expression(l, exprs.elem[0]);
+        TypeId type      = exprs.elem[0].type_id;
+        TypeList members = get_tuple_members(l->table, &type);
+        for (u32 i = 0; i < members.len; i++) {
+            IrInstruction *inst = add_ir_instruction(l->fn, op_Extract, members.elem[i], &tuple, 1);
+            inst->imm           = i;
+            append_u32_to_slice(values, inst->result);
+        }
+        return;
+    }
+    for (u32 i = 0; i < exprs.len; i++) {
+        append_u32_to_slice(values, lower_expression(l, exprs.elem[i]));
+    }
+}
+
+// set_local binds new value to variable named by identifier expression
+void set_local(Lowerer *l, Expression expr, ValueId value) {
+    Symbol *symbol = ((Identifier *)expr.ptr)->symbol;
+    if (symbol != nil) {
+        l->env[symbol->index] = value;
+    }
+}
+
+void lower_define_statement(Lowerer *l, DefineStatement *dstmt) {
+    slice_of_u32s values = empty_slice_of_u32s;
+    lower_values(l, dstmt->right, dstmt->left.len, &values);
+    for (u32 i = 0; i < dstmt->left.len && i < values.len; i++) {
+        set_local(l, dstmt->left.elem[i], values.elem[i]);
+    }
+    free_slice_of_u32s(values);
+}
+
+// All values are evaluated before any variable changes, so that "a, b = b, a"
+// swaps values
+void lower_assign_statement(Lowerer *l, AssignStatement *astmt) {
+    TokenType operation = get_assign_operation(astmt->operator.type);
+    if (operation != tt_Empty) {
+        Expression left = astmt->left.elem[0];
+        ValueId current = lower_expression(l, left);
+        ValueId right   = lower_expression(l, astmt->right.elem[0]);
+        set_local(l, left, add_binary(l, operation, left.type_id, current, right));
+        return;
+    }
+
+    slice_of_u32s values = empty_slice_of_u32s;
+    lower_values(l, astmt->right, astmt->left.len, &values);
+    for (u32 i = 0; i < astmt->left.len && i < values.len; i++) {
+        set_local(l, astmt->left.elem[i], values.elem[i]);
+    }
+    free_slice_of_u32s(values);
+}
+
+// add_return emits return of given values, bare return gives current values
+// of named results or zero values of unnamed ones
+void add_return(Lowerer *l, slice_of_u32s values, bool bare) {
+    if (bare) {
+        TypeList members = get_tuple_members(l->table, &l->fn->result);
+        for (u32 i = 0; i < members.len; i++) {
+            ValueId value = IR_NONE;
+            if (l->named_results) {
+                value = l->env[l->params + i];
+            }
+            if (value == IR_NONE) {
+                value = add_constant(l, members.elem[i], 0);
+            }
+            append_u32_to_slice(&values, value);
+        }
+    }
+    add_ir_instruction(l->fn, op_Return, ti_Void, values.elem, values.len);
+    free_slice_of_u32s(values);
+}
+
+void lower_return_statement(Lowerer *l, ReturnStatement *rstmt) {
+    slice_of_u32s values = empty_slice_of_u32s;
+    u32 want             = get_tuple_members(l->table, &l->fn->result).len;
+    lower_values(l, rstmt->values, want, &values);
+    add_return(l, values, rstmt->values.len == 0);
+    open_new_block(l);
+}
+
+void mark_assigned_statements(slice_of_Statements stmts, bool *assigned);
+
+// mark_assigned_statement sets flags of variables which statement assigns
+// to, nested statements included
+void mark_assigned_statement(Statement stmt, bool *assigned) {
+    switch (stmt.type) {
+    case st_Assign: {
+        slice_of_Expressions left = ((AssignStatement *)stmt.ptr)->left;
+        for (u32 i = 0; i < left.len; i++) {
+            if (left.elem[i].type != et_Identifier) {
+                continue;
+            }
+            Symbol *symbol = ((Identifier *)left.elem[i].ptr)->symbol;
+            if (symbol != nil && symbol->kind != sk_Function && symbol->kind != sk_Builtin) {
+                assigned[symbol->index] = true;
+            }
+        }
+        break;
+    }
+    case st_If: {
+        IfStatement *istmt = (IfStatement *)stmt.ptr;
+        for (u32 i = 0; i < istmt->clauses.len; i++) {
+            mark_assigned_statements(istmt->clauses.elem[i].body.statements, assigned);
+        }
+        if (istmt->else_body != nil) {
+            mark_assigned_statements(istmt->else_body->statements, assigned);
+        }
+        break;
+    }
+    case st_Loop:
+        mark_assigned_statements(((LoopStatement *)stmt.ptr)->body.statements, assigned);
+        break;
+    case st_While:
+        mark_assigned_statements(((WhileStatement *)stmt.ptr)->body.statements, assigned);
+        break;
+    case st_Block:
+        mark_assigned_statements(((BlockStatement *)stmt.ptr)->statements, assigned);
+        break;
+    default:
+        break;
+    }
+}
+
+void mark_assigned_statements(slice_of_Statements stmts, bool *assigned) {
+    for (u32 i = 0; i < stmts.len; i++) {
+        mark_assigned_statement(stmts.elem[i], assigned);
+    }
+}
+
+MergeSet collect_merge_set(Lowerer *l, Statement stmt) {
+    bool *assigned = (bool *)alloc_lower_temp(l->locals * sizeof(bool));
+    memset(assigned, 0, l->locals * sizeof(bool));
+    mark_assigned_statement(stmt, assigned);
+
+    MergeSet set = {
+        .locals = (u32 *)alloc_lower_temp(l->locals * sizeof(u32)),
+        .types  = (TypeId *)alloc_lower_temp(l->locals * sizeof(TypeId)),
+        .len    = 0,
+    };
+    for (u32 i = 0; i < l->locals; i++) {
+        if (assigned[i] && l->env[i] != IR_NONE) {
+            set.locals[set.len] = i;
+            set.types[set.len]  = l->fn->values[l->env[i]];
+            set.len++;
+        }
+    }
+    free_mem(assigned);
+    return set;
+}
+
+void free_merge_set(MergeSet set) {
+    free_mem(set.locals);
+    free_mem(set.types);
+}
+
+// jump_with_merge_set jumps to target passing current values of variables
+// from the set, extra value is passed first if it is not IR_NONE
+void jump_with_merge_set(Lowerer *l, BlockId target, ValueId extra, MergeSet set) {
+    ValueId *args = (ValueId *)alloc_lower_temp((set.len + 1) * sizeof(ValueId));
+    u32 len       = 0;
+    if (extra != IR_NONE) {
+        args[len] = extra;
+        len++;
+    }
+    for (u32 i = 0; i < set.len; i++) {
+        args[len] = l->env[set.locals[i]];
+        len++;
+    }
+    add_jump(l, target, args, len);
+    free_mem(args);
+}
+
+// bind_merge_set makes variables from the set refer to parameters of block
+// starting from given one
+void bind_merge_set(Lowerer *l, BlockId block, u32 first, MergeSet set) {
+    ValueId params = l->fn->blocks[block].params + first;
+    for (u32 i = 0; i < set.len; i++) {
+        l->env[set.locals[i]] = params + i;
+    }
+}
+
+ValueId *save_env(Lowerer *l) {
+    ValueId *saved = (ValueId *)alloc_lower_temp(l->locals * sizeof(ValueId));
+    memcpy(saved, l->env, l->locals * sizeof(ValueId));
+    return saved;
+}
+
+void restore_env(Lowerer *l, const ValueId *saved) {
+    memcpy(l->env, saved, l->locals * sizeof(ValueId));
+}
+
+void lower_statements(Lowerer *l, slice_of_Statements stmts);
+
+// Each clause body starts with values variables had before if statement and
+// passes its final values to the merge block
+void lower_if_statement(Lowerer *l, Statement stmt) {
+    IfStatement *istmt = (IfStatement *)stmt.ptr;
+    MergeSet set       = collect_merge_set(l, stmt);
+    ValueId *saved     = save_env(l);
+    BlockId merge      = new_ir_block(l->fn, set.len, set.types);
+
+    for (u32 i = 0; i < istmt->clauses.len; i++) {
+        IfClause clause    = istmt->clauses.elem[i];
+        ValueId condition  = lower_expression(l, clause.condition);
+        BlockId then_block = new_ir_block(l->fn, 0, nil);
+        BlockId next_block = new_ir_block(l->fn, 0, nil);
+        add_branch(l, condition, then_block, next_block);
+
+        open_ir_block(l->fn, then_block);
+        lower_statements(l, clause.body.statements);
+        jump_with_merge_set(l, merge, IR_NONE, set);
+        restore_env(l, saved);
+
+        open_ir_block(l->fn, next_block);
+    }
+    if (istmt->else_body != nil) {
+        lower_statements(l, istmt->else_body->statements);
+    }
+    jump_with_merge_set(l, merge, IR_NONE, set);
+    restore_env(l, saved);
+
+    open_ir_block(l->fn, merge);
+    bind_merge_set(l, merge, 0, set);
+    free_mem(saved);
+    free_merge_set(set);
+}
+
+// Loop with count keeps number of remaining iterations as the first parameter
+// of loop header and exits when it is not positive
+void lower_loop_statement(Lowerer *l, Statement stmt) {
+    LoopStatement *lstmt = (LoopStatement *)stmt.ptr;
+    MergeSet set         = collect_merge_set(l, stmt);
+    ValueId *saved       = save_env(l);
+
+    if (lstmt->count.ptr == nil) {
+        BlockId header = new_ir_block(l->fn, set.len, set.types);
+        jump_with_merge_set(l, header, IR_NONE, set);
+        open_ir_block(l->fn, header);
+        bind_merge_set(l, header, 0, set);
+        lower_statements(l, lstmt->body.statements);
+        jump_with_merge_set(l, header, IR_NONE, set);
+
+        // there is no way out of the loop
+        restore_env(l, saved);
+        open_new_block(l);
+        free_mem(saved);
+        free_merge_set(set);
+        return;
+    }
+
+    ValueId count = lower_expression(l, lstmt->count);
+    TypeId type   = get_value_type(lstmt->count);
+
+    TypeId *types = (TypeId *)alloc_lower_temp((set.len + 1) * sizeof(TypeId));
+    types[0]      = type;
+    memcpy(types + 1, set.types, set.len * sizeof(TypeId));
+    BlockId header = new_ir_block(l->fn, set.len + 1, types);
+    free_mem(types);
+
+    jump_with_merge_set(l, header, count, set);
+    open_ir_block(l->fn, header);
+    bind_merge_set(l, header, 1, set);
+    ValueId remaining = l->fn->blocks[header].params;
+    ValueId condition = add_binary(l, tt_Greater, ti_Bool, remaining, add_constant(l, type, 0));
+    BlockId body      = new_ir_block(l->fn, 0, nil);
+    BlockId exit      = new_ir_block(l->fn, 0, nil);
+    add_branch(l, condition, body, exit);
+
+    open_ir_block(l->fn, body);
+    ValueId next = add_binary(l, tt_Minus, type, remaining, add_constant(l, type, 1));
+    lower_statements(l, lstmt->body.statements);
+    jump_with_merge_set(l, header, next, set);
+
+    restore_env(l, saved);
+    open_ir_block(l->fn, exit);
+    bind_merge_set(l, header, 1, set);
+    free_mem(saved);
+    free_merge_set(set);
+}
+
+void lower_while_statement(Lowerer *l, Statement stmt) {
+    WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+    MergeSet set          = collect_merge_set(l, stmt);
+    ValueId *saved        = save_env(l);
+
+    BlockId header = new_ir_block(l->fn, set.len, set.types);
+    jump_with_merge_set(l, header, IR_NONE, set);
+    open_ir_block(l->fn, header);
+    bind_merge_set(l, header, 0, set);
+    ValueId condition = lower_expression(l, wstmt->condition);
+    BlockId body      = new_ir_block(l->fn, 0, nil);
+    BlockId exit      = new_ir_block(l->fn, 0, nil);
+    add_branch(l, condition, body, exit);
+
+    open_ir_block(l->fn, body);
+    lower_statements(l, wstmt->body.statements);
+    jump_with_merge_set(l, header, IR_NONE, set);
+
+    restore_env(l, saved);
+    open_ir_block(l->fn, exit);
+    bind_merge_set(l, header, 0, set);
+    free_mem(saved);
+    free_merge_set(set);
+}
+
+void lower_statement(Lowerer *l, Statement stmt) {
+    switch (stmt.type) {
+    case st_Define:
+        lower_define_statement(l, (DefineStatement *)stmt.ptr);
+        break;
+    case st_Assign:
+        lower_assign_statement(l, (AssignStatement *)stmt.ptr);
+        break;
+    case st_Expression:
+        lower_expression(l, *(Expression *)stmt.ptr);
+        break;
+    case st_Return:
+        lower_return_statement(l, (ReturnStatement *)stmt.ptr);
+        break;
+    case st_If:
+        lower_if_statement(l, stmt);
+        break;
+    case st_Loop:
+        lower_loop_statement(l, stmt);
+        break;
+    case st_While:
+        lower_while_statement(l, stmt);
+        break;
+    case st_Block:
+        lower_statements(l, ((BlockStatement *)stmt.ptr)->statements);
+        break;
+    case st_Empty:
+        break;
+    default:
+        add_lower_error(l, let_UnsupportedStatement, l->function_name.pos, l->function_name.literal);
+        break;
+    }
+}
+
+void lower_statements(Lowerer *l, slice_of_Statements stmts) {
+    for (u32 i = 0; i < stmts.len; i++) {
+        lower_statement(l, stmts.elem[i]);
+    }
+}
+
+// Parameters become parameters of the entry block and named results start
+// with zero values. Function which reaches end of its body returns values of
+// named results or zero values
+IrFunction lower_function(Lowerer *l, const FunctionDefinition *def) {
+    Type type      = get_type(l->table, def->declaration.name.symbol->type);
+    IrFunction fn  = init_ir_function(def->declaration.name.token.literal, type.key, type.elem);
+    TypeList param = get_tuple_members(l->table, &type.key);
+
+    l->fn            = &fn;
+    l->locals        = def->locals;
+    l->params        = param.len;
+    l->named_results = def->declaration.result.type == frt_TypedTuple;
+    l->function_name = def->declaration.name.token;
+    l->env           = (ValueId *)alloc_lower_temp(def->locals * sizeof(ValueId));
+    for (u32 i = 0; i < def->locals; i++) {
+        l->env[i] = IR_NONE;
+    }
+
+    BlockId entry = new_ir_block(&fn, param.len, param.elem);
+    open_ir_block(&fn, entry);
+    for (u32 i = 0; i < param.len && i < def->locals; i++) {
+        l->env[i] = fn.blocks[entry].params + i;
+    }
+    if (l->named_results) {
+        TypeList results = get_tuple_members(l->table, &type.elem);
+        for (u32 i = 0; i < results.len && param.len + i < def->locals; i++) {
+            l->env[param.len + i] = add_constant(l, results.elem[i], 0);
+        }
+    }
+
+    lower_statements(l, def->body.statements);
+    add_return(l, empty_slice_of_u32s, true);
+
+    free_mem(l->env);
+    l->env = nil;
+    l->fn  = nil;
+    return fn;
+}
+
+LowerResult lower_standalone_source_tree(const TypeTable *table, const StandaloneSourceTree *tree) {
+    Lowerer l = {
+        .table         = table,
+        .tree          = tree,
+        .fn            = nil,
+        .env           = nil,
+        .locals        = 0,
+        .params        = 0,
+        .named_results = false,
+        .function_name = empty_token,
+        .errors        = empty_slice_of_LowerErrors,
+    };
+
+    u32 n            = tree->functions.len;
+    IrFunction *list = (IrFunction *)alloc_lower_temp(n * sizeof(IrFunction));
+    for (u32 i = 0; i < n; i++) {
+        list[i] = lower_function(&l, &tree->functions.elem[i]);
+    }
+
+    LowerResult result = {
+        .module =
+            {
+                .table         = table,
+                .functions     = list,
+                .functions_len = n,
+            },
+        .errors = l.errors,
+    };
+    return result;
+}
+
+str format_lower_error(LowerError err) {
+    slice_of_bytes b = empty_slice_of_bytes;
+    switch (err.type) {
+    case let_FunctionValue:
+        append_cstr_to_bytes(&b, "function used as value: ");
+        append_str_to_bytes(&b, err.name);
+        break;
+    case let_UnsupportedStatement:
+        append_cstr_to_bytes(&b, "statement is not supported by code generation in function ");
+        append_str_to_bytes(&b, err.name);
+        break;
+    case let_UnsupportedExpression:
+        append_cstr_to_bytes(&b, "expression is not supported by code generation in function ");
+        append_str_to_bytes(&b, err.name);
+        break;
+    }
+
+    str s = new_str_from_bytes(b.elem, b.len);
+    free_slice_of_bytes(b);
+    return s;
+}
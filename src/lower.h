@@ -0,0 +1,57 @@
+#ifndef KU_LOWER_H
+#define KU_LOWER_H
+
+#include "ast.h"
+#include "ir.h"
+#include "position.h"
+#include "slice.h"
+#include "str.h"
+#include "strop.h"
+#include "type_table.h"
+#include "types.h"
+
+typedef enum LowerErrorType LowerErrorType;
+typedef struct LowerError LowerError;
+typedef struct LowerResult LowerResult;
+
+enum LowerErrorType {
+    // function or builtin name is used as a value, name holds it
+    let_FunctionValue,
+
+    // statement kind has no lowering, reported at the name of enclosing
+    // function, name holds it
+    let_UnsupportedStatement,
+
+    // expression kind has no lowering, name holds enclosing function
+    let_UnsupportedExpression,
+};
+
+struct LowerError {
+    LowerErrorType type;
+    Position pos;
+    str name;
+};
+
+TYPEDEF_SLICE(LowerError)
+
+struct LowerResult {
+    // functions are in the same order as in source tree
+    IrModule module;
+
+    slice_of_LowerErrors errors;
+};
+
+// lower_standalone_source_tree translates functions of the tree into SSA
+// form. Tree must pass type checking and constant folding without errors.
+// Variables become values, their merges at if statements and loops become
+// block parameters. Top level statements are not lowered
+LowerResult lower_standalone_source_tree(const TypeTable *table, const StandaloneSourceTree *tree);
+
+// decode_string_literal strips quotes of string literal and replaces escape
+// sequences with bytes they denote
+slice_of_bytes decode_string_literal(str literal);
+
+// format_lower_error returns new string with error message, without position
+str format_lower_error(LowerError err);
+
+#endif // KU_LOWER_H
@@ -1,10 +1,11 @@
 #include <stdlib.h>
 
+#include "alloc.h"
 #include "fatal.h"
 #include "map.h"
 
 map_str_u64 new_map_str_u64(u32 cap) {
-    bucket_u64 **buck = (bucket_u64 **)calloc(cap, sizeof(bucket_u64 *));
+    bucket_u64 **buck = (bucket_u64 **)alloc_zeroed_mem(at_Map, (u64)cap * sizeof(bucket_u64 *));
     if (buck == nil) {
         fatal(1, "not enough memory for new map");
     }
@@ -18,7 +19,7 @@ map_str_u64 new_map_str_u64(u32 cap) {
 }
 
 bucket_u64 *new_bucket_u64(str key, u64 val) {
-    bucket_u64 *buck = (bucket_u64 *)malloc(sizeof(bucket_u64));
+    bucket_u64 *buck = (bucket_u64 *)alloc_mem(at_Map, sizeof(bucket_u64));
     if (buck == nil) {
         fatal(1, "not enough memory for new bucket");
     }
@@ -93,4 +94,17 @@ void put_map_str_u64(map_str_u64 *m, str key, u64 val) {
         return;
     }
     m->buck[h] = new_buck;
-}
\ No newline at end of file
+}
+// free_map_str_u64 frees buckets and underlying array of the map, keys are
+// not owned by the map and are not freed
+void free_map_str_u64(map_str_u64 m) {
+    for (u32 i = 0; i < m.cap; i++) {
+        bucket_u64 *buck = m.buck[i];
+        while (buck != nil) {
+            bucket_u64 *next = buck->next;
+            free_mem(buck);
+            buck = next;
+        }
+    }
+    free_mem(m.buck);
+}
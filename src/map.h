@@ -40,5 +40,6 @@ map_str_u64 new_map_str_u64(u32 cap);
 u32 hash_str(str s, u32 cap);
 result_u64 get_map_str_u64(map_str_u64 m, str key);
 void put_map_str_u64(map_str_u64 *m, str key, u64 val);
+void free_map_str_u64(map_str_u64 m);
 
 #endif // KU_MAP_H
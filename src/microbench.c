@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "fatal.h"
+#include "microbench.h"
+#include "str.h"
+#include "timer.h"
+
+typedef struct MicrobenchOptions MicrobenchOptions;
+typedef struct MicrobenchBaseline MicrobenchBaseline;
+
+struct MicrobenchOptions {
+    // minimal duration of a single measured run
+    u64 min_run_ns;
+
+    u32 runs;
+
+    // run only benchmarks which names contain this string
+    str filter;
+
+    str baseline_path;
+    str save_path;
+};
+
+struct MicrobenchBaseline {
+    char name[128];
+    double ns_per_op;
+};
+
+#define MAX_MICROBENCHES 256
+
+Microbench microbenches[MAX_MICROBENCHES];
+u32 number_of_microbenches = 0;
+
+const u64 default_min_run_ns = 20 * 1000 * 1000;
+const u32 default_runs       = 5;
+
+const str min_time_flag_prefix = STR("--min-time-ms=");
+const str runs_flag_prefix     = STR("--runs=");
+const str filter_flag_prefix   = STR("--filter=");
+const str baseline_flag_prefix = STR("--baseline=");
+const str save_flag_prefix     = STR("--save=");
+
+void register_microbench(const char *name, MicrobenchFunc func) {
+    if (number_of_microbenches >= MAX_MICROBENCHES) {
+        fatal(1, "too many microbenchmarks");
+    }
+    microbenches[number_of_microbenches].name = name;
+    microbenches[number_of_microbenches].func = func;
+    number_of_microbenches++;
+}
+
+// read_cycle_counter returns value of CPU time stamp counter, it ticks with
+// constant reference frequency which may differ from actual core frequency
+u64 read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    if (x < y) {
+        return -1;
+    }
+    return x > y ? 1 : 0;
+}
+
+// calibrate_microbench returns number of iterations which takes at least min_run_ns,
+// number of iterations is doubled until run is long enough
+u64 calibrate_microbench(Microbench bench, u64 min_run_ns) {
+    u64 iterations = 1;
+    while (true) {
+        u64 start = get_wall_time_ns();
+        bench.func(iterations);
+        u64 elapsed = get_wall_time_ns() - start;
+        if (elapsed >= min_run_ns || iterations >= (1ULL << 40)) {
+            return iterations;
+        }
+
+        // jump close to target when there is enough precision
+        if (elapsed > min_run_ns / 100) {
+            u64 estimate = (u64)((double)iterations * (double)min_run_ns / (double)elapsed * 1.1);
+            if (estimate > iterations * 2) {
+                iterations = estimate;
+                continue;
+            }
+        }
+        iterations *= 2;
+    }
+}
+
+MicrobenchResult run_microbench(Microbench bench, MicrobenchOptions options) {
+    u64 iterations = calibrate_microbench(bench, options.min_run_ns);
+
+    double ns[options.runs];
+    double cycles[options.runs];
+    for (u32 i = 0; i < options.runs; i++) {
+        u64 start_cycles = read_cycle_counter();
+        u64 start        = get_wall_time_ns();
+        bench.func(iterations);
+        u64 elapsed        = get_wall_time_ns() - start;
+        u64 elapsed_cycles = read_cycle_counter() - start_cycles;
+
+        ns[i]     = (double)elapsed / (double)iterations;
+        cycles[i] = (double)elapsed_cycles / (double)iterations;
+    }
+    qsort(ns, options.runs, sizeof(double), compare_doubles);
+    qsort(cycles, options.runs, sizeof(double), compare_doubles);
+
+    MicrobenchResult result = {
+        .name          = bench.name,
+        .iterations    = iterations,
+        .ns_per_op     = ns[options.runs / 2],
+        .cycles_per_op = cycles[options.runs / 2],
+    };
+    return result;
+}
+
+// load_microbench_baseline reads results saved by save_microbench_results,
+// each result is stored on a separate line
+u32 load_microbench_baseline(str path, MicrobenchBaseline *baseline, u32 cap) {
+    char *cpath = str_to_cstr(path);
+    FILE *file  = fopen(cpath, "r");
+    if (file == nil) {
+        fprintf(stderr, "error reading baseline file: %s\n", cpath);
+        exit(1);
+    }
+    free_mem(cpath);
+
+    u32 len = 0;
+    char line[512];
+    while (len < cap && fgets(line, sizeof(line), file) != nil) {
+        MicrobenchBaseline *b = &baseline[len];
+        if (sscanf(line, " {\"name\": \"%127[^\"]\", \"ns_per_op\": %lf", b->name, &b->ns_per_op) == 2) {
+            len++;
+        }
+    }
+    fclose(file);
+    return len;
+}
+
+void save_microbench_results(str path, MicrobenchResult *results, u32 len) {
+    char *cpath = str_to_cstr(path);
+    FILE *file  = fopen(cpath, "w");
+    if (file == nil) {
+        fprintf(stderr, "error writing results file: %s\n", cpath);
+        exit(1);
+    }
+    free_mem(cpath);
+
+    fprintf(file, "[");
+    for (u32 i = 0; i < len; i++) {
+        fprintf(file,
+            "%s\n  {\"name\": \"%s\", \"ns_per_op\": %.4f, \"cycles_per_op\": %.4f, \"iterations\": %llu}",
+            i == 0 ? "" : ",",
+            results[i].name,
+            results[i].ns_per_op,
+            results[i].cycles_per_op,
+            (unsigned long long)results[i].iterations);
+    }
+    fprintf(file, "\n]\n");
+    fclose(file);
+}
+
+MicrobenchBaseline *find_microbench_baseline(MicrobenchBaseline *baseline, u32 len, const char *name) {
+    for (u32 i = 0; i < len; i++) {
+        if (strcmp(baseline[i].name, name) == 0) {
+            return &baseline[i];
+        }
+    }
+    return nil;
+}
+
+bool has_substr(str s, str substr) {
+    if (substr.len > s.len) {
+        return false;
+    }
+    for (u64 i = 0; i <= s.len - substr.len; i++) {
+        if (has_substr_at(s, substr, i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MicrobenchOptions parse_microbench_options(int argc, char **argv) {
+    MicrobenchOptions options = {
+        .min_run_ns    = default_min_run_ns,
+        .runs          = default_runs,
+        .filter        = empty_str,
+        .baseline_path = empty_str,
+        .save_path     = empty_str,
+    };
+    for (int i = 1; i < argc; i++) {
+        str arg = take_str_from_cstr(argv[i]);
+        if (has_prefix_str(arg, min_time_flag_prefix)) {
+            U32ParseResult res = parse_u32_from_decimal(borrow_str_slice_to_end(arg, min_time_flag_prefix.len));
+            if (!res.ok || res.num == 0) {
+                fatal(1, "invalid minimal run time");
+            }
+            options.min_run_ns = (u64)res.num * 1000 * 1000;
+        } else if (has_prefix_str(arg, runs_flag_prefix)) {
+            U32ParseResult res = parse_u32_from_decimal(borrow_str_slice_to_end(arg, runs_flag_prefix.len));
+            if (!res.ok || res.num == 0) {
+                fatal(1, "invalid number of runs");
+            }
+            options.runs = res.num;
+        } else if (has_prefix_str(arg, filter_flag_prefix)) {
+            options.filter = borrow_str_slice_to_end(arg, filter_flag_prefix.len);
+        } else if (has_prefix_str(arg, baseline_flag_prefix)) {
+            options.baseline_path = borrow_str_slice_to_end(arg, baseline_flag_prefix.len);
+        } else if (has_prefix_str(arg, save_flag_prefix)) {
+            options.save_path = borrow_str_slice_to_end(arg, save_flag_prefix.len);
+        } else {
+            fatal(1, "unknown flag");
+        }
+    }
+    return options;
+}
+
+// Usage: microbench [--filter=SUBSTR] [--runs=N] [--min-time-ms=N] [--baseline=PATH] [--save=PATH]
+//
+// Runs all registered microbenchmarks. Number of iterations is calibrated so
+// that each run lasts at least given time, median of runs is reported. With
+// baseline results of a previous saved run, relative change is printed
+int main(int argc, char **argv) {
+    MicrobenchOptions options = parse_microbench_options(argc, argv);
+
+    MicrobenchBaseline baseline[MAX_MICROBENCHES];
+    u32 baseline_len = 0;
+    if (options.baseline_path.len != 0) {
+        baseline_len = load_microbench_baseline(options.baseline_path, baseline, MAX_MICROBENCHES);
+    }
+
+    MicrobenchResult results[MAX_MICROBENCHES];
+    u32 len = 0;
+
+    printf("%-38s  %14s  %12s  %12s  %10s\n", "benchmark", "iterations", "ns/op", "cycles/op", "change");
+    for (u32 i = 0; i < number_of_microbenches; i++) {
+        Microbench bench = microbenches[i];
+        if (!has_substr(take_str_from_cstr((char *)bench.name), options.filter)) {
+            continue;
+        }
+
+        MicrobenchResult r = run_microbench(bench, options);
+        results[len]       = r;
+        len++;
+
+        printf("%-38s  %14llu  %12.3f", r.name, (unsigned long long)r.iterations, r.ns_per_op);
+        if (r.cycles_per_op > 0) {
+            printf("  %12.2f", r.cycles_per_op);
+        } else {
+            printf("  %12s", "-");
+        }
+        MicrobenchBaseline *b = find_microbench_baseline(baseline, baseline_len, r.name);
+        if (b != nil && b->ns_per_op > 0) {
+            printf("  %+9.1f%%\n", (r.ns_per_op / b->ns_per_op - 1) * 100);
+        } else {
+            printf("  %10s\n", "-");
+        }
+        fflush(stdout);
+    }
+
+    if (options.save_path.len != 0) {
+        save_microbench_results(options.save_path, results, len);
+    }
+    return 0;
+}
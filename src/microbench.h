@@ -0,0 +1,54 @@
+#ifndef KU_MICROBENCH_H
+#define KU_MICROBENCH_H
+
+#include "types.h"
+
+typedef struct Microbench Microbench;
+typedef struct MicrobenchResult MicrobenchResult;
+
+// MicrobenchFunc runs measured operation given number of times
+typedef void (*MicrobenchFunc)(u64 iterations);
+
+struct Microbench {
+    const char *name;
+    MicrobenchFunc func;
+};
+
+struct MicrobenchResult {
+    const char *name;
+
+    // number of iterations selected by calibration
+    u64 iterations;
+
+    double ns_per_op;
+
+    // time stamp counter ticks per operation, zero if counter is not available
+    double cycles_per_op;
+};
+
+// MICROBENCH defines benchmark function and registers it before main is
+// called. Function body receives number of iterations in variable iterations:
+//
+//     MICROBENCH(are_strs_equal_short) {
+//         for (u64 i = 0; i < iterations; i++) {
+//             keep_microbench_value(are_strs_equal(a, b));
+//         }
+//     }
+#define MICROBENCH(name)                                                                                               \
+    void microbench_##name(u64 iterations);                                                                            \
+    __attribute__((constructor)) void register_microbench_##name() {                                                   \
+        register_microbench(#name, microbench_##name);                                                                 \
+    }                                                                                                                  \
+    void microbench_##name(u64 iterations)
+
+// keep_microbench_value prevents compiler from removing computation of
+// the value as unused
+#define keep_microbench_value(x) __asm__ volatile("" : : "r"((u64)(x)) : "memory")
+
+// keep_microbench_memory forces compiler to assume memory behind pointer
+// was read and changed, so loads and stores are not hoisted out of loops
+#define keep_microbench_memory(p) __asm__ volatile("" : : "r"(p) : "memory")
+
+void register_microbench(const char *name, MicrobenchFunc func);
+
+#endif // KU_MICROBENCH_H
@@ -0,0 +1,278 @@
+#include "map.h"
+#include "microbench.h"
+#include "number.h"
+#include "slice.h"
+#include "str.h"
+#include "strop.h"
+#include "token.h"
+
+// Microbenchmarks of str, slice and map primitives which are used on every
+// hot path of scanner and parser. Inputs are passed through
+// keep_microbench_memory so that compiler cannot fold calls with constant
+// arguments or hoist them out of loops
+
+str short_ident       = STR("counter");
+str short_ident_copy  = STR("counter");
+str long_literal      = STR("a fairly long string literal which is larger than a couple of cache words...");
+str long_literal_copy = STR("a fairly long string literal which is larger than a couple of cache words...");
+str long_literal_diff = STR("a fairly long string literal which is larger than a couple of cache words..!");
+str source_line       = STR("    total := add(total, next_value(counter)) // accumulate values of counter\n");
+
+const char *map_keys_text[] = {
+    "fn", "return", "if", "else", "for", "loop", "while", "var", "const", "type", "struct", "import",
+    "counter", "total", "value", "next", "result", "index", "length", "buffer", "reader", "writer",
+};
+
+#define MAP_KEYS_LEN (sizeof(map_keys_text) / sizeof(map_keys_text[0]))
+
+#define LONG_TEXT_LEN 4096
+
+// long_text is LONG_TEXT_LEN bytes of spaces with "needle\n" placed at the
+// end, searches scan over the whole text before finding a match
+byte long_text_bytes[LONG_TEXT_LEN];
+
+str needle = STR("needle");
+
+str init_long_text() {
+    str s = borrow_str_from_bytes(long_text_bytes, LONG_TEXT_LEN);
+    for (u64 i = 0; i < LONG_TEXT_LEN; i++) {
+        long_text_bytes[i] = ' ';
+    }
+    for (u64 i = 0; i < needle.len; i++) {
+        long_text_bytes[LONG_TEXT_LEN - 1 - needle.len + i] = needle.bytes[i];
+    }
+    long_text_bytes[LONG_TEXT_LEN - 1] = '\n';
+    return s;
+}
+
+MICROBENCH(are_strs_equal_short) {
+    for (u64 i = 0; i < iterations; i++) {
+        str a = short_ident;
+        keep_microbench_memory(&a);
+        keep_microbench_value(are_strs_equal(a, short_ident_copy));
+    }
+}
+
+MICROBENCH(are_strs_equal_long) {
+    for (u64 i = 0; i < iterations; i++) {
+        str a = long_literal;
+        keep_microbench_memory(&a);
+        keep_microbench_value(are_strs_equal(a, long_literal_copy));
+    }
+}
+
+MICROBENCH(are_strs_equal_long_last_byte_differs) {
+    for (u64 i = 0; i < iterations; i++) {
+        str a = long_literal;
+        keep_microbench_memory(&a);
+        keep_microbench_value(are_strs_equal(a, long_literal_diff));
+    }
+}
+
+MICROBENCH(index_byte_in_str_from_newline) {
+    for (u64 i = 0; i < iterations; i++) {
+        str s = source_line;
+        keep_microbench_memory(&s);
+        keep_microbench_value(index_byte_in_str_from(s, '\n', 4));
+    }
+}
+
+MICROBENCH(index_byte_in_str_from_long) {
+    str text = init_long_text();
+    for (u64 i = 0; i < iterations; i++) {
+        str s = text;
+        keep_microbench_memory(&s);
+        keep_microbench_value(index_byte_in_str_from(s, '\n', 0));
+    }
+}
+
+MICROBENCH(index_other_byte_in_str_from_long) {
+    str text = init_long_text();
+    for (u64 i = 0; i < iterations; i++) {
+        str s = text;
+        keep_microbench_memory(&s);
+        keep_microbench_value(index_other_byte_in_str_from(s, ' ', 0));
+    }
+}
+
+MICROBENCH(index_last_byte_in_str_long) {
+    str text = init_long_text();
+    for (u64 i = 0; i < iterations; i++) {
+        str s = text;
+        keep_microbench_memory(&s);
+        keep_microbench_value(index_last_byte_in_str(s, 'x'));
+    }
+}
+
+MICROBENCH(index_str_in_str_long) {
+    str text = init_long_text();
+    for (u64 i = 0; i < iterations; i++) {
+        str s = text;
+        keep_microbench_memory(&s);
+        keep_microbench_value(index_str_in_str(s, needle));
+    }
+}
+
+MICROBENCH(borrow_split_str_by_byte_line) {
+    for (u64 i = 0; i < iterations; i++) {
+        str s = source_line;
+        keep_microbench_memory(&s);
+        slice_of_strs words = borrow_split_str_by_byte(s, ' ');
+        keep_microbench_value(words.len);
+        free_slice_of_strs(words);
+    }
+}
+
+MICROBENCH(format_u64_as_decimal_small) {
+    for (u64 i = 0; i < iterations; i++) {
+        str s = format_u64_as_decimal(i & 0xFF);
+        keep_microbench_value(s.len);
+        free_str(s);
+    }
+}
+
+MICROBENCH(format_u64_as_decimal_large) {
+    for (u64 i = 0; i < iterations; i++) {
+        str s = format_u64_as_decimal(0xFFFFFFFFFFFF0000ULL + (i & 0xFFFF));
+        keep_microbench_value(s.len);
+        free_str(s);
+    }
+}
+
+MICROBENCH(parse_u64_from_decimal_small) {
+    str s = STR("42");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&s);
+        keep_microbench_value(parse_u64_from_decimal(s).num);
+    }
+}
+
+MICROBENCH(parse_u64_from_decimal_large) {
+    str s = STR("18446744073709551615");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&s);
+        keep_microbench_value(parse_u64_from_decimal(s).num);
+    }
+}
+
+MICROBENCH(decode_decimal_integer_large) {
+    str s = STR("18446744073709551615");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&s);
+        keep_microbench_value(decode_decimal_integer(s).num);
+    }
+}
+
+MICROBENCH(decode_hexadecimal_integer_large) {
+    str s = STR("0xdead_beef_0123_abcd");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&s);
+        keep_microbench_value(decode_hexadecimal_integer(s).num);
+    }
+}
+
+MICROBENCH(decode_decimal_float) {
+    str s = STR("3.141592653589");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&s);
+        f64 num = decode_decimal_float(s).num;
+        keep_microbench_memory(&num);
+    }
+}
+
+MICROBENCH(get_new_cap) {
+    u32 cap = 0;
+    for (u64 i = 0; i < iterations; i++) {
+        cap = get_new_cap(cap);
+        if (cap > (1 << 20)) {
+            cap = 0;
+        }
+        keep_microbench_value(cap);
+    }
+}
+
+// append_byte_to_slice_growing measures appending including all reallocations,
+// slice is released after each 4096 bytes
+MICROBENCH(append_byte_to_slice_growing) {
+    slice_of_bytes b = init_empty_slice_of_bytes();
+    for (u64 i = 0; i < iterations; i++) {
+        append_byte_to_slice(&b, (byte)i);
+        if (b.len == 4096) {
+            keep_microbench_memory(b.elem);
+            free_slice_of_bytes(b);
+            b = init_empty_slice_of_bytes();
+        }
+    }
+    free_slice_of_bytes(b);
+}
+
+// append_byte_to_slice_preallocated measures appending without reallocations
+MICROBENCH(append_byte_to_slice_preallocated) {
+    slice_of_bytes b = init_empty_slice_of_bytes();
+    recap_slice_of_bytes(&b, 4096);
+    for (u64 i = 0; i < iterations; i++) {
+        append_byte_to_slice(&b, (byte)i);
+        if (b.len == 4096) {
+            keep_microbench_memory(b.elem);
+            b.len = 0;
+        }
+    }
+    free_slice_of_bytes(b);
+}
+
+map_str_u64 new_microbench_map() {
+    map_str_u64 m = new_map_str_u64(64);
+    for (u64 i = 0; i < MAP_KEYS_LEN; i++) {
+        put_map_str_u64(&m, take_str_from_cstr((char *)map_keys_text[i]), i);
+    }
+    return m;
+}
+
+MICROBENCH(get_map_str_u64_hit) {
+    map_str_u64 m = new_microbench_map();
+    str keys[MAP_KEYS_LEN];
+    for (u64 i = 0; i < MAP_KEYS_LEN; i++) {
+        keys[i] = take_str_from_cstr((char *)map_keys_text[i]);
+    }
+    for (u64 i = 0; i < iterations; i++) {
+        str key = keys[i % MAP_KEYS_LEN];
+        keep_microbench_memory(&key);
+        keep_microbench_value(get_map_str_u64(m, key).val);
+    }
+    free_map_str_u64(m);
+}
+
+MICROBENCH(get_map_str_u64_miss) {
+    map_str_u64 m = new_microbench_map();
+    str key       = STR("missing_key");
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&key);
+        keep_microbench_value(get_map_str_u64(m, key).ok);
+    }
+    free_map_str_u64(m);
+}
+
+MICROBENCH(put_map_str_u64_existing) {
+    map_str_u64 m = new_microbench_map();
+    str key       = take_str_from_cstr((char *)map_keys_text[12]);
+    for (u64 i = 0; i < iterations; i++) {
+        keep_microbench_memory(&key);
+        put_map_str_u64(&m, key, i);
+    }
+    keep_microbench_value(get_map_str_u64(m, key).val);
+    free_map_str_u64(m);
+}
+
+// keys of the map are half keywords and half identifiers, which is close to
+// what scanner passes to lookup
+MICROBENCH(lookup_keyword_mixed) {
+    str keys[MAP_KEYS_LEN];
+    for (u64 i = 0; i < MAP_KEYS_LEN; i++) {
+        keys[i] = take_str_from_cstr((char *)map_keys_text[i]);
+    }
+    for (u64 i = 0; i < iterations; i++) {
+        str key = keys[i % MAP_KEYS_LEN];
+        keep_microbench_memory(&key);
+        keep_microbench_value(lookup_keyword(key).ok);
+    }
+}
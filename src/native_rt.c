@@ -0,0 +1,88 @@
+// getrlimit is not part of C11
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "native_rt.h"
+
+// generated code reads strings and fills arrays of print arguments directly
+_Static_assert(offsetof(VmString, bytes) == 0, "generated code relies on layout of strings");
+_Static_assert(offsetof(VmString, len) == 8, "generated code relies on layout of strings");
+_Static_assert(offsetof(VmString, buffer) == 16, "generated code relies on layout of strings");
+_Static_assert(sizeof(VmValue) == 8, "generated code relies on size of values");
+_Static_assert(sizeof(VmKind) == 4, "generated code relies on size of value kinds");
+
+// stack left for runtime functions called by generated code near the limit
+// and for environment placed above main function
+const u64 native_stack_reserve = 1 << 18;
+
+// stack size assumed when it is not limited
+const u64 native_default_stack_size = 8 << 20;
+
+const char *native_error_messages[] = {
+    [ne_DivisionByZero] = "division by zero",
+    [ne_StackOverflow]  = "stack overflow",
+};
+
+u64 ku_rt_stack_limit;
+
+OutputBuffer native_out;
+VmRuntime native_rt;
+
+// init_native_stack_limit places limit below current stack pointer at
+// distance allowed by resource limit of the process
+void init_native_stack_limit() {
+    u64 size = native_default_stack_size;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        size = (u64)limit.rlim_cur;
+    }
+    if (size < 2 * native_stack_reserve) {
+        size = 2 * native_stack_reserve;
+    }
+    byte marker       = 0;
+    ku_rt_stack_limit = (u64)&marker - size + native_stack_reserve;
+}
+
+const VmString *ku_rt_concat(const VmString *a, const VmString *b) {
+    return concat_vm_strings(&native_rt, a, b);
+}
+
+i32 ku_rt_compare(const VmString *a, const VmString *b) {
+    return compare_vm_strings(a, b);
+}
+
+void ku_rt_print(u32 builtin, const VmValue *values, const VmKind *kinds, u32 len) {
+    print_vm_values(&native_rt, builtin, values, kinds, len);
+}
+
+void ku_rt_fail(NativeError error, const char *function) {
+    VmResult result = new_vm_error(native_error_messages[error], take_str_from_cstr((char *)function));
+    flush_output(&native_out);
+    fprintf(stderr, "runtime error: %.*s\n", (int)result.error.len, (char *)result.error.bytes);
+    free_str(result.error);
+    exit(1);
+}
+
+int main() {
+    native_out = new_output_buffer(STDOUT_FILENO, default_output_buffer_cap);
+    native_rt  = init_vm_runtime(&native_out);
+    init_native_stack_limit();
+
+    ku_entry();
+
+    int code = 0;
+    if (!flush_output(&native_out)) {
+        fprintf(stderr, "error writing output: %s\n", strerror(errno));
+        code = 1;
+    }
+    free_vm_runtime(&native_rt);
+    free_output_buffer(&native_out);
+    return code;
+}
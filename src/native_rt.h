@@ -0,0 +1,39 @@
+#ifndef KU_NATIVE_RT_H
+#define KU_NATIVE_RT_H
+
+#include "runtime.h"
+#include "types.h"
+
+typedef enum NativeError NativeError;
+
+// NativeError is code of runtime error which generated code reports with
+// ku_rt_fail
+enum NativeError {
+    ne_DivisionByZero,
+    ne_StackOverflow,
+};
+
+// Native runtime is linked into each program built by cckuc build command.
+// It provides main function and operations which generated code does not
+// implement inline. Strings, printing and error messages are the same as in
+// bytecode interpreter
+
+// lowest stack address which generated code may use, each function compares
+// stack pointer with it after allocating its frame
+extern u64 ku_rt_stack_limit;
+
+// ku_entry is emitted by code generator, it calls entry function of program
+void ku_entry();
+
+const VmString *ku_rt_concat(const VmString *a, const VmString *b);
+i32 ku_rt_compare(const VmString *a, const VmString *b);
+
+// ku_rt_print implements print builtins, floats of both sizes are passed
+// as f64 values
+void ku_rt_print(u32 builtin, const VmValue *values, const VmKind *kinds, u32 len);
+
+// ku_rt_fail flushes output of the program, reports error in given function
+// and exits with status 1
+_Noreturn void ku_rt_fail(NativeError error, const char *function);
+
+#endif // KU_NATIVE_RT_H
@@ -0,0 +1,351 @@
+// mkdtemp is not part of C11
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cgen.h"
+#include "const_eval.h"
+#include "lower.h"
+#include "opt.h"
+#include "parser.h"
+#include "resolve.h"
+#include "source.h"
+#include "toolchain.h"
+#include "type_check.h"
+#include "x64.h"
+
+typedef struct NativeTestCase NativeTestCase;
+
+struct NativeTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    // when set program is read from the file instead of input, path is
+    // relative to repository root from which tests are run
+    char *path;
+
+    // standard output and error stream of the program
+    str want;
+};
+
+const u32 number_of_test_cases = 14;
+
+const NativeTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("hello"),
+        .input = STR("fn main() {\n    println(\"hello\")\n    print(\"a\\tb\\n\")\n}\n"),
+        .want  = STR("hello\na\tb\n"),
+    },
+    {
+        .id    = 2,
+        .label = STR("recursion"),
+        .input = STR("fn fact(n: i64) => i64 {\n    if n <= 1 {\n        return 1\n    }\n    return n * fact(n - 1)\n}\n\n"
+                     "fn main() {\n    println(fact(20), fact(21))\n}\n"),
+        .want  = STR("2432902008176640000 -4249290049419214848\n"),
+    },
+    {
+        .id    = 3,
+        .label = STR("named results"),
+        .input = STR("fn divmod(a: i64, b: i64) => (q: i64, r: i64) {\n    q = a / b\n    r = a % b\n    return\n}\n\n"
+                     "fn main() {\n    q, r := divmod(-17, 5)\n    println(q, r)\n    println(divmod(17, 5))\n}\n"),
+        .want  = STR("-3 -2\n3 2\n"),
+    },
+    {
+        .id    = 4,
+        .label = STR("strings"),
+        .input = STR("fn greet(name: str) => str {\n    return \"hi \\\"\" + name + \"\\\"\\t!\"\n}\n\n"
+                     "fn main() {\n    s := \"\"\n    loop 3 {\n        s = s + \"ab\"\n    }\n    a := greet(\"ku\")\n"
+                     "    println(s, a < \"hj\", a >= \"hi\", a != greet(\"ku\"), s == \"ababab\")\n}\n"),
+        .want  = STR("ababab true true false true\n"),
+    },
+    {
+        .id    = 5,
+        .label = STR("narrow integers"),
+        .input = STR("fn add(x: u8, y: u8) => u8 {\n    return x + y\n}\n\n"
+                     "fn narrow(a: i8, b: i8) => (q: i8, p: i8) {\n    q = a / b\n    p = a * b\n    return\n}\n\n"
+                     "fn main() {\n    println(add(100, 200), add(255, 1) < 1)\n    println(narrow(-128, -1))\n}\n"),
+        .want  = STR("44 true\n-128 -128\n"),
+    },
+    {
+        .id    = 6,
+        .label = STR("shifts and division"),
+        .input = STR("fn shl(x: i64, k: u8) => i64 {\n    return x << k\n}\n\n"
+                     "fn shr(x: i64, k: u8) => i64 {\n    return x >> k\n}\n\n"
+                     "fn ushr(x: u32, k: u8) => u32 {\n    return x >> k\n}\n\n"
+                     "fn divmod(a: i64, b: i64) => (q: i64, r: i64) {\n    q = a / b\n    r = a % b\n    return\n}\n\n"
+                     "fn main() {\n    println(shl(1, 3), shl(1, 70), shr(-16, 2), shr(-16, 200))\n"
+                     "    println(ushr(4000000000, 31))\n    m := -9223372036854775807 - 1\n"
+                     "    println(divmod(m, -1))\n    println(123456789012 * 3, m)\n}\n"),
+        .want  = STR("8 0 -4 -1\n1\n-9223372036854775808 0\n370370367036 -9223372036854775808\n"),
+    },
+    {
+        .id    = 7,
+        .label = STR("floats"),
+        .input = STR("fn div(a: f64, b: f64) => f64 {\n    return a / b\n}\n\n"
+                     "fn third(x: f32) => f32 {\n    return -x / 3.0\n}\n\n"
+                     "fn main() {\n    n := div(0.0, 0.0)\n    println(n == n, n != n, n < 1.0, n >= 1.0)\n"
+                     "    println(third(1.0), -div(1.0, 4.0), div(1.0, 0.0), div(0.2, 2.0) == 0.1)\n}\n"),
+        .want  = STR("false true false false\n-0.33333334 -0.25 inf true\n"),
+    },
+    {
+        .id    = 8,
+        .label = STR("arguments on stack"),
+        .input = STR("fn mix(a: i64, b: i64, c: i64, d: i64, e: i64, f: i64, g: i64, h: u8) => i64 {\n"
+                     "    if h == 0 {\n        return a - b + c - d + e - f + g\n    }\n"
+                     "    return a - b + c - d + e - f + g * mix(b, g, f, e, d, c, b, 0)\n}\n\n"
+                     "fn pick(a: f32, b: f32, c: f32, d: f32, e: f32, f: f32, g: f32, h: f32, i: f32, j: f32)"
+                     " => f32 {\n    return j - i + a\n}\n\n"
+                     "fn main() {\n    println(mix(1, 2, 3, 4, 5, 6, 7, 8))\n"
+                     "    println(pick(1.5, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.25, 0.125))\n}\n"),
+        .want  = STR("-10\n1.375\n"),
+    },
+    {
+        .id    = 9,
+        .label = STR("division by zero"),
+        .input = STR("fn div(a: i64, b: i64) => i64 {\n    return a / b\n}\n\n"
+                     "fn main() {\n    println(\"before\")\n    println(div(1, 0))\n    println(\"after\")\n}\n"),
+        .want  = STR("before\nruntime error: division by zero in function div\n"),
+    },
+    {
+        .id    = 10,
+        .label = STR("unbounded recursion"),
+        .input = STR("fn f(n: i64) => i64 {\n    return f(n + 1) + 1\n}\n\nfn main() {\n    println(f(0))\n}\n"),
+        .want  = STR("runtime error: stack overflow in function f\n"),
+    },
+    {
+        .id    = 11,
+        .label = STR("string bytes"),
+        .input = STR("fn main() {\n    s := \"?\?=\\\\é\"\n    println(s, s + \"?\" == \"?\?=\\\\é?\")\n}\n"),
+        .want  = STR("?\?=\\é true\n"),
+    },
+    {
+        .id    = 12,
+        .label = STR("float notation"),
+        .input = STR("fn scale(x: f64, k: f64) => f64 {\n    return x * k\n}\n\n"
+                     "fn main() {\n    println(scale(1.0, 10.0), scale(1000.0, 1000.0), scale(0.5, 0.001))\n"
+                     "    println(scale(1.0, 100000000000000000000.0), scale(10.0, 100000000000000000000.0))\n"
+                     "    println(scale(-1.0, 0.000001), scale(2.0, 61.625))\n}\n"),
+        .want  = STR("10 1000000 0.0005\n100000000000000000000 1e+21\n-1e-06 123.25\n"),
+    },
+    {
+        .id    = 13,
+        .label = STR("fibonacci pairs program"),
+        .path  = "tests/fibonacci_pairs.ku",
+        .want  = STR("12 fibonacci number is 144\n90 fibonacci number is 2880067194370816120\n"),
+    },
+    {
+        .id    = 14,
+        .label = STR("increment statements"),
+        .input = STR("fn main() {\n    x := 1\n    x++\n    x--\n    x++\n    println(\"{}\", x)\n"
+                     "    i := 0\n    s := 0\n    while i < 10 { s += 1; i++ }\n    s--\n    println(i, s)\n}\n"),
+        .want  = STR("2\n10 9\n"),
+    },
+};
+
+const u32 number_of_test_levels = 2;
+
+const OptLevel test_levels[] = {ol_None, ol_Full};
+
+// programs are built by both code generators, C source is compiled with
+// runtime header from binary directory
+const u32 number_of_test_backends = 2;
+
+const str test_backend_names[] = {STR("x64"), STR("c")};
+
+const str pass_str    = STR("    native_test [ OK ]");
+const str fail_str    = STR("[ FAILED ]");
+const str case_str    = STR("Test case: ");
+const str level_str   = STR("Optimization level: ");
+const str backend_str = STR("Backend: ");
+const str want_str    = STR("Want: ");
+const str got_str     = STR("Got:  ");
+
+const str test_entry_name  = STR("main");
+const str front_errors_str = STR("errors before code generation");
+const str read_error_str   = STR("error reading program file");
+const str build_error_str  = STR("error building program");
+
+const u64 test_output_cap = 1 << 16;
+
+void print_failed_test_case(NativeTestCase test_case, OptLevel level, u32 backend, str got) {
+    str id_str    = format_u64_as_decimal(test_case.id);
+    str level_num = format_u32_as_decimal(level);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(level_str);
+    println_str(level_num);
+    print_str(backend_str);
+    println_str(test_backend_names[backend]);
+    print_str(want_str);
+    println_str(test_case.want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+    free_str(level_num);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+// build_test_program writes assembly or C source of the module into dir and
+// compiles it into executable dir/prog
+bool build_test_program(const IrModule *m, u32 backend, const char *dir) {
+    char src_path[512];
+    char prog_path[512];
+    snprintf(src_path, sizeof(src_path), backend == 0 ? "%s/prog.s" : "%s/prog.c", dir);
+    snprintf(prog_path, sizeof(prog_path), "%s/prog", dir);
+
+    FILE *file = fopen(src_path, "w");
+    if (file == nil) {
+        return false;
+    }
+    OutputBuffer out = new_output_buffer(fileno(file), test_output_cap);
+    if (backend == 0) {
+        write_x64_module(&out, m, find_ir_function(m, test_entry_name));
+    } else {
+        write_c_module(&out, m, find_ir_function(m, test_entry_name));
+    }
+    bool ok = flush_output(&out);
+    free_output_buffer(&out);
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    str runtime                  = get_native_runtime_path();
+    char *rt_path                = str_to_cstr(runtime);
+    str bin_dir                  = get_toolchain_dir();
+    char *include                = str_to_cstr(bin_dir);
+    const char *const asm_args[] = {"-o", prog_path, src_path, rt_path, nil};
+    const char *const c_args[]   = {"-O2", c_recursion_flag, "-I", include, "-o", prog_path, src_path, rt_path, nil};
+    ok                           = run_c_compiler(backend == 0 ? asm_args : c_args);
+    free_mem(include);
+    free_str(bin_dir);
+    free_mem(rt_path);
+    free_str(runtime);
+    unlink(src_path);
+    return ok;
+}
+
+// run_test_program returns output of the program built in dir, both of its
+// streams are written into the same file
+str run_test_program(const char *dir) {
+    char command[1024];
+    char out_path[512];
+    snprintf(out_path, sizeof(out_path), "%s/out", dir);
+    snprintf(command, sizeof(command), "%s/prog > %s 2>&1", dir, out_path);
+    if (system(command) == -1) {
+        return new_str_from_str(build_error_str);
+    }
+
+    byte *bytes = (byte *)alloc_mem(at_String, test_output_cap);
+    FILE *file  = fopen(out_path, "r");
+    u64 len     = 0;
+    if (file != nil) {
+        len = fread(bytes, 1, test_output_cap, file);
+        fclose(file);
+    }
+    str got = new_str_from_bytes(bytes, len);
+    free_mem(bytes);
+    unlink(out_path);
+    return got;
+}
+
+str compile_and_run_test(const TypeTable *table, const StandaloneSourceTree *tree, OptLevel level, u32 backend,
+                        const char *dir) {
+    LowerResult lowered = lower_standalone_source_tree(table, tree);
+    optimize_ir_module(&lowered.module, level, empty_str);
+    bool built = build_test_program(&lowered.module, backend, dir);
+    free_slice_of_LowerErrors(lowered.errors);
+    free_ir_module(&lowered.module);
+    if (!built) {
+        return new_str_from_str(build_error_str);
+    }
+
+    str got = run_test_program(dir);
+    char prog_path[512];
+    snprintf(prog_path, sizeof(prog_path), "%s/prog", dir);
+    unlink(prog_path);
+    return got;
+}
+
+bool run_test_case(NativeTestCase test_case, const char *dir) {
+    SourceText source = new_source_from_str(test_case.input);
+    if (test_case.path != nil) {
+        SourceReadResult read_result = read_source_from_file(test_case.path);
+        if (read_result.erc != srec_NotAnError) {
+            print_failed_test_case(test_case, ol_None, 0, read_error_str);
+            return true;
+        }
+        source = read_result.source;
+    }
+
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(source.text);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult check_result       = check_standalone_source_tree(&table, &parse_result.tree);
+    FoldResult fold_result             = fold_standalone_source_tree(&table, &parse_result.tree);
+
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || check_result.errors.len != 0 ||
+                  fold_result.errors.len != 0;
+    if (failed) {
+        print_failed_test_case(test_case, ol_None, 0, front_errors_str);
+    }
+    for (u32 k = 0; k < number_of_test_backends && !failed; k++) {
+        for (u32 i = 0; i < number_of_test_levels && !failed; i++) {
+            str got = compile_and_run_test(&table, &parse_result.tree, test_levels[i], k, dir);
+            if (!are_strs_equal(got, test_case.want)) {
+                print_failed_test_case(test_case, test_levels[i], k, got);
+                failed = true;
+            }
+            free_str(got);
+        }
+    }
+
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(check_result.errors);
+    free_slice_of_TypeErrors(fold_result.errors);
+    free_type_table(&table);
+    if (test_case.path != nil) {
+        free_source(source);
+    }
+    return failed;
+}
+
+int main() {
+    char dir[] = "/tmp/native_test.XXXXXX";
+    if (mkdtemp(dir) == nil) {
+        fprintf(stderr, "error creating temporary directory\n");
+        return 1;
+    }
+
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i], dir);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    rmdir(dir);
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fatal.h"
+#include "number.h"
+
+// longest u64 value representation without leading zeros, reached in binary
+#define MAX_INTEGER_DIGITS 64
+
+typedef struct DigitBuffer DigitBuffer;
+
+// DigitBuffer holds significant digits of literal with leading zeros removed.
+// Digits are taken directly from literal unless it contains separators, in
+// that case they are copied to storage without them
+struct DigitBuffer {
+    byte storage[MAX_INTEGER_DIGITS];
+
+    const byte *digits;
+    u64 len;
+};
+
+// ASCII '0' in each byte of u64
+const u64 decimal_digit_offsets = 0x3030303030303030ULL;
+
+const byte max_u64_decimal_digits[] = "18446744073709551615";
+
+const u8 max_u64_decimal_digits_length = 20;
+
+// number of significant decimal digits which always fit into u64
+const u8 safe_u64_decimal_digits_length = 19;
+
+// floats with integer mantissa not greater than this are converted exactly
+const u64 max_exact_f64_mantissa = 1ULL << 53;
+
+// powers of ten which are represented by f64 exactly
+const f64 exact_f64_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+const u64 max_exact_f64_power_of_ten = 22;
+
+// load_digit_chunk reads 8 digits from memory, first digit ends up in the
+// lowest byte regardless of host byte order
+u64 load_digit_chunk(const byte *p) {
+    u64 chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+    return chunk;
+}
+
+// First step merges adjacent bytes into 2-digit numbers, then two
+// multiplications scale those by their powers of ten and gather them in upper
+// half of the product
+u64 parse_8_decimal_digits(u64 chunk) {
+    chunk -= decimal_digit_offsets;
+    chunk = chunk * 10 + (chunk >> 8);
+
+    u64 high = (chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32));
+    u64 low  = ((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32));
+    return (high + low) >> 32;
+}
+
+// digit_value works for all digits up to base 16, letters of both cases
+// have 0x40 bit set and their low nibble is 1 for 'a' and 'A'
+u8 digit_value(byte b) {
+    return (u8)((b & 0xF) + 9 * (b >> 6));
+}
+
+// parse_8_power_of_two_digits converts 8 digits of base 2^bits in the same
+// way as digit_value does, but for all bytes at once. Lanes are then merged
+// pairwise, first digit being the most significant
+u64 parse_8_power_of_two_digits(u64 chunk, u8 bits) {
+    chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) + 9 * ((chunk >> 6) & 0x0101010101010101ULL);
+    chunk = ((chunk & 0x00FF00FF00FF00FFULL) << bits) | ((chunk >> 8) & 0x00FF00FF00FF00FFULL);
+    chunk = ((chunk & 0x0000FFFF0000FFFFULL) << (2 * bits)) | ((chunk >> 16) & 0x0000FFFF0000FFFFULL);
+    chunk = ((chunk & 0x00000000FFFFFFFFULL) << (4 * bits)) | (chunk >> 32);
+    return chunk;
+}
+
+void collect_significant_digits(DigitBuffer *buf, str literal, u64 start) {
+    u64 i = start;
+    while (i < literal.len && (literal.bytes[i] == '0' || literal.bytes[i] == '_')) {
+        i++;
+    }
+
+    buf->digits = literal.bytes + i;
+    buf->len    = literal.len - i;
+    if (memchr(buf->digits, '_', buf->len) == nil) {
+        return;
+    }
+
+    u64 len = 0;
+    for (; i < literal.len; i++) {
+        byte b = literal.bytes[i];
+        if (b == '_') {
+            continue;
+        }
+        if (len == MAX_INTEGER_DIGITS) {
+            // any value of that length overflows, keep the length for checks
+            len++;
+            break;
+        }
+        buf->storage[len] = b;
+        len++;
+    }
+    buf->digits = buf->storage;
+    buf->len    = len;
+}
+
+// decode_decimal_digits does not check for overflow, caller must ensure that
+// value fits into u64
+u64 decode_decimal_digits(const byte *digits, u8 len) {
+    u64 num = 0;
+    u8 head = len % 8;
+    for (u8 i = 0; i < head; i++) {
+        num = num * 10 + (u64)(digits[i] - '0');
+    }
+    for (u8 i = head; i < len; i += 8) {
+        num = num * 100000000 + parse_8_decimal_digits(load_digit_chunk(digits + i));
+    }
+    return num;
+}
+
+U64ParseResult decode_power_of_two_integer(str literal, u8 bits) {
+    U64ParseResult res = {
+        .ok  = false,
+        .num = 0,
+    };
+
+    DigitBuffer buf;
+    collect_significant_digits(&buf, literal, 2); // skip "0b", "0o" or "0x" prefix
+    if (buf.len > MAX_INTEGER_DIGITS) {
+        return res;
+    }
+    if (buf.len == 0) {
+        res.ok = true;
+        return res;
+    }
+
+    // number of bits in value is determined by the first digit
+    u8 first  = digit_value(buf.digits[0]);
+    u32 width = (u32)(buf.len - 1) * bits;
+    for (; first != 0; first >>= 1) {
+        width++;
+    }
+    if (width > 64) {
+        return res;
+    }
+
+    u64 num  = 0;
+    u64 head = buf.len % 8;
+    for (u64 i = 0; i < head; i++) {
+        num = (num << bits) | digit_value(buf.digits[i]);
+    }
+    for (u64 i = head; i < buf.len; i += 8) {
+        num = (num << (8 * bits)) | parse_8_power_of_two_digits(load_digit_chunk(buf.digits + i), bits);
+    }
+
+    res.ok  = true;
+    res.num = num;
+    return res;
+}
+
+U64ParseResult decode_binary_integer(str literal) {
+    return decode_power_of_two_integer(literal, 1);
+}
+
+U64ParseResult decode_octal_integer(str literal) {
+    return decode_power_of_two_integer(literal, 3);
+}
+
+U64ParseResult decode_hexadecimal_integer(str literal) {
+    return decode_power_of_two_integer(literal, 4);
+}
+
+U64ParseResult decode_decimal_integer(str literal) {
+    U64ParseResult res = {
+        .ok  = false,
+        .num = 0,
+    };
+
+    DigitBuffer buf;
+    collect_significant_digits(&buf, literal, 0);
+    if (buf.len > max_u64_decimal_digits_length) {
+        return res;
+    }
+
+    // digit strings of equal length compare in the same way as their values
+    if (buf.len == max_u64_decimal_digits_length &&
+        memcmp(buf.digits, max_u64_decimal_digits, max_u64_decimal_digits_length) > 0) {
+        return res;
+    }
+
+    res.ok  = true;
+    res.num = decode_decimal_digits(buf.digits, (u8)buf.len);
+    return res;
+}
+
+// decode_decimal_float_slow handles literals outside of fast path, strtod
+// rounds correctly but needs null-terminated copy without separators
+F64ParseResult decode_decimal_float_slow(str literal) {
+    char local[64];
+    char *s = local;
+    if (literal.len >= sizeof(local)) {
+        s = (char *)alloc_mem(at_Other, literal.len + 1);
+        if (s == nil) {
+            fatal(1, "not enough memory to decode float literal");
+        }
+    }
+
+    u64 len = 0;
+    for (u64 i = 0; i < literal.len; i++) {
+        if (literal.bytes[i] != '_') {
+            s[len] = (char)literal.bytes[i];
+            len++;
+        }
+    }
+    s[len] = 0;
+
+    F64ParseResult res;
+    res.num = strtod(s, nil);
+    res.ok  = !isinf(res.num);
+    if (s != local) {
+        free_mem(s);
+    }
+    return res;
+}
+
+// Literal is viewed as integer mantissa m with d digits after period, its
+// value is m / 10^d. When both m and 10^d are exact in f64 a single division
+// gives correctly rounded result (Clinger's fast path). This covers almost all
+// literals found in practice, others fall back to strtod
+F64ParseResult decode_decimal_float(str literal) {
+    byte digits[MAX_INTEGER_DIGITS];
+    u8 len              = 0;
+    u64 fraction_digits = 0;
+    bool in_fraction    = false;
+    bool exact          = true;
+    for (u64 i = 0; i < literal.len; i++) {
+        byte b = literal.bytes[i];
+        if (b == '_') {
+            continue;
+        }
+        if (b == '.') {
+            in_fraction = true;
+            continue;
+        }
+        if (in_fraction) {
+            fraction_digits++;
+        }
+        if (b == '0' && len == 0) {
+            continue;
+        }
+        if (len == safe_u64_decimal_digits_length) {
+            exact = false;
+            break;
+        }
+        digits[len] = b;
+        len++;
+    }
+
+    if (exact && fraction_digits <= max_exact_f64_power_of_ten) {
+        u64 mantissa = decode_decimal_digits(digits, len);
+        if (mantissa <= max_exact_f64_mantissa) {
+            F64ParseResult res = {
+                .ok  = true,
+                .num = (f64)mantissa / exact_f64_powers_of_ten[fraction_digits],
+            };
+            return res;
+        }
+    }
+    return decode_decimal_float_slow(literal);
+}
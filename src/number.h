@@ -0,0 +1,29 @@
+#ifndef KU_NUMBER_H
+#define KU_NUMBER_H
+
+#include "str.h"
+#include "types.h"
+
+typedef struct F64ParseResult F64ParseResult;
+
+struct F64ParseResult {
+    bool ok;
+    f64 num;
+};
+
+// Functions below decode numeric literals exactly as they are produced by
+// scanner, prefix (if any) included and digits possibly separated by '_'.
+// Literal syntax is not checked, result is not ok only if value does not fit
+// into u64 (or f64 for floats)
+
+U64ParseResult decode_binary_integer(str literal);
+U64ParseResult decode_octal_integer(str literal);
+U64ParseResult decode_decimal_integer(str literal);
+U64ParseResult decode_hexadecimal_integer(str literal);
+F64ParseResult decode_decimal_float(str literal);
+
+// parse_8_decimal_digits converts 8 ASCII decimal digits packed into u64 in
+// little endian order (first digit in lowest byte) into their value
+u64 parse_8_decimal_digits(u64 chunk);
+
+#endif // KU_NUMBER_H
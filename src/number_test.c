@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+typedef struct IntegerTestCase IntegerTestCase;
+typedef struct FloatTestCase FloatTestCase;
+
+struct IntegerTestCase {
+    u64 id;
+    str label;
+    str input;
+    U64ParseResult (*decode)(str literal);
+
+    bool ok;
+    u64 want;
+};
+
+struct FloatTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    bool ok;
+    f64 want;
+};
+
+// inputs with more than 8 significant digits are decoded by whole chunks
+// and remaining head digits
+const u32 number_of_integer_test_cases = 16;
+
+const IntegerTestCase integer_test_cases[] = {
+    {
+        .id     = 1,
+        .label  = STR("single decimal digit"),
+        .input  = STR("7"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 7,
+    },
+    {
+        .id     = 2,
+        .label  = STR("exactly one decimal chunk"),
+        .input  = STR("12345678"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 12345678,
+    },
+    {
+        .id     = 3,
+        .label  = STR("decimal head and chunks"),
+        .input  = STR("98765432109876543"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 98765432109876543ULL,
+    },
+    {
+        .id     = 4,
+        .label  = STR("decimal separators"),
+        .input  = STR("1_000_097"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 1000097,
+    },
+    {
+        .id     = 5,
+        .label  = STR("max u64 in decimal"),
+        .input  = STR("18446744073709551615"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 0xFFFFFFFFFFFFFFFFULL,
+    },
+    {
+        .id     = 6,
+        .label  = STR("decimal overflow by one"),
+        .input  = STR("18446744073709551616"),
+        .decode = decode_decimal_integer,
+        .ok     = false,
+        .want   = 0,
+    },
+    {
+        .id     = 7,
+        .label  = STR("decimal overflow by length"),
+        .input  = STR("100000000000000000000"),
+        .decode = decode_decimal_integer,
+        .ok     = false,
+        .want   = 0,
+    },
+    {
+        .id     = 8,
+        .label  = STR("leading zeros do not overflow"),
+        .input  = STR("0000000000000000000000042"),
+        .decode = decode_decimal_integer,
+        .ok     = true,
+        .want   = 42,
+    },
+    {
+        .id     = 9,
+        .label  = STR("hexadecimal digits of both cases"),
+        .input  = STR("0xDeadBeef_0123abcd"),
+        .decode = decode_hexadecimal_integer,
+        .ok     = true,
+        .want   = 0xDEADBEEF0123ABCDULL,
+    },
+    {
+        .id     = 10,
+        .label  = STR("hexadecimal head"),
+        .input  = STR("0x43da1"),
+        .decode = decode_hexadecimal_integer,
+        .ok     = true,
+        .want   = 0x43DA1,
+    },
+    {
+        .id     = 11,
+        .label  = STR("hexadecimal overflow"),
+        .input  = STR("0x1_0000_0000_0000_0000"),
+        .decode = decode_hexadecimal_integer,
+        .ok     = false,
+        .want   = 0,
+    },
+    {
+        .id     = 12,
+        .label  = STR("max u64 in octal"),
+        .input  = STR("0o1777777777777777777777"),
+        .decode = decode_octal_integer,
+        .ok     = true,
+        .want   = 0xFFFFFFFFFFFFFFFFULL,
+    },
+    {
+        .id     = 13,
+        .label  = STR("octal overflow in first digit"),
+        .input  = STR("0o2000000000000000000000"),
+        .decode = decode_octal_integer,
+        .ok     = false,
+        .want   = 0,
+    },
+    {
+        .id     = 14,
+        .label  = STR("octal chunk"),
+        .input  = STR("0o43671_012"),
+        .decode = decode_octal_integer,
+        .ok     = true,
+        .want   = 043671012,
+    },
+    {
+        .id     = 15,
+        .label  = STR("binary chunk and head"),
+        .input  = STR("0b1101100001"),
+        .decode = decode_binary_integer,
+        .ok     = true,
+        .want   = 0x361,
+    },
+    {
+        .id     = 16,
+        .label  = STR("binary overflow"),
+        .input  = STR("0b1_00000000_00000000_00000000_00000000_00000000_00000000_00000000_00000000"),
+        .decode = decode_binary_integer,
+        .ok     = false,
+        .want   = 0,
+    },
+};
+
+const u32 number_of_float_test_cases = 6;
+
+const FloatTestCase float_test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("simple fraction"),
+        .input = STR("123.45"),
+        .ok    = true,
+        .want  = 123.45,
+    },
+    {
+        .id    = 2,
+        .label = STR("zero"),
+        .input = STR("0.0"),
+        .ok    = true,
+        .want  = 0.0,
+    },
+    {
+        .id    = 3,
+        .label = STR("separators in both parts"),
+        .input = STR("1_000.000_5"),
+        .ok    = true,
+        .want  = 1000.0005,
+    },
+    {
+        .id    = 4,
+        .label = STR("mantissa too long for fast path"),
+        .input = STR("3.14159265358979323846264338327950288"),
+        .ok    = true,
+        .want  = 3.14159265358979323846264338327950288,
+    },
+    {
+        .id    = 5,
+        .label = STR("fraction too long for fast path"),
+        .input = STR("0.000000000000000000000000012"),
+        .ok    = true,
+        .want  = 0.000000000000000000000000012,
+    },
+    {
+        .id    = 6,
+        .label = STR("mantissa above 2^53"),
+        .input = STR("9007199254740993.0"),
+        .ok    = true,
+        .want  = 9007199254740993.0,
+    },
+};
+
+// number of random literals checked against strtod and formatted values
+const u32 number_of_random_checks = 100000;
+
+const str pass_str = STR("    number_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+const str float_case_str  = STR("Float test case: ");
+const str random_case_str = STR("Random literal: ");
+
+void print_failed_test_case(str title, u64 id, str label, str want, str got) {
+    str id_str = format_u64_as_decimal(id);
+
+    println();
+    println_str(fail_str);
+    print_str(title);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+// format_result describes decoded value or its absence in test failure
+// messages
+str format_result(bool ok, u64 num) {
+    if (!ok) {
+        return new_str_from_cstr("overflow");
+    }
+    return format_u64_as_decimal(num);
+}
+
+str format_f64(bool ok, f64 num) {
+    if (!ok) {
+        return new_str_from_cstr("overflow");
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.17g", num);
+    return new_str_from_cstr(buf);
+}
+
+// are_f64_equal compares bit representations, so that result must be
+// rounded exactly as expected
+bool are_f64_equal(f64 a, f64 b) {
+    return memcmp(&a, &b, sizeof(f64)) == 0;
+}
+
+bool run_integer_test_case(IntegerTestCase test_case) {
+    U64ParseResult res = test_case.decode(test_case.input);
+    bool failed        = res.ok != test_case.ok || (res.ok && res.num != test_case.want);
+    if (failed) {
+        str want = format_result(test_case.ok, test_case.want);
+        str got  = format_result(res.ok, res.num);
+        print_failed_test_case(case_str, test_case.id, test_case.label, want, got);
+        free_str(want);
+        free_str(got);
+    }
+    return failed;
+}
+
+bool run_float_test_case(FloatTestCase test_case) {
+    F64ParseResult res = decode_decimal_float(test_case.input);
+    bool failed        = res.ok != test_case.ok || (res.ok && !are_f64_equal(res.num, test_case.want));
+    if (failed) {
+        str want = format_f64(test_case.ok, test_case.want);
+        str got  = format_f64(res.ok, res.num);
+        print_failed_test_case(float_case_str, test_case.id, test_case.label, want, got);
+        free_str(want);
+        free_str(got);
+    }
+    return failed;
+}
+
+u64 next_random(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// run_random_checks decodes literals of random values with various number of
+// digits and compares results with values they were formatted from
+bool run_random_checks() {
+    u64 state = 0x9E3779B97F4A7C15ULL;
+    char buf[64];
+    for (u32 i = 0; i < number_of_random_checks; i++) {
+        u64 num = next_random(&state) >> (next_random(&state) % 64);
+
+        int len            = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)num);
+        str literal        = borrow_str_from_bytes((byte *)buf, (u64)len);
+        U64ParseResult res = decode_decimal_integer(literal);
+        if (!res.ok || res.num != num) {
+            str got = format_result(res.ok, res.num);
+            print_failed_test_case(random_case_str, i, literal, literal, got);
+            free_str(got);
+            return true;
+        }
+
+        len     = snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)num);
+        literal = borrow_str_from_bytes((byte *)buf, (u64)len);
+        res     = decode_hexadecimal_integer(literal);
+        if (!res.ok || res.num != num) {
+            str want = format_u64_as_decimal(num);
+            str got  = format_result(res.ok, res.num);
+            print_failed_test_case(random_case_str, i, literal, want, got);
+            free_str(want);
+            free_str(got);
+            return true;
+        }
+
+        // random mantissa with period inserted after random number of digits
+        char digits[32];
+        u64 mantissa = next_random(&state) >> (next_random(&state) % 64);
+        int n        = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)mantissa);
+        int period   = (int)(next_random(&state) % (u64)n) + 1;
+        len          = snprintf(buf, sizeof(buf), "%.*s.%s", period, digits, period == n ? "0" : digits + period);
+
+        literal             = borrow_str_from_bytes((byte *)buf, (u64)len);
+        F64ParseResult fres = decode_decimal_float(literal);
+        f64 want            = strtod(buf, nil);
+        if (!fres.ok || !are_f64_equal(fres.num, want)) {
+            str want_str_value = format_f64(true, want);
+            str got            = format_f64(fres.ok, fres.num);
+            print_failed_test_case(random_case_str, i, literal, want_str_value, got);
+            free_str(want_str_value);
+            free_str(got);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_integer_test_cases; i++) {
+        bool failed = run_integer_test_case(integer_test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    for (u32 i = 0; i < number_of_float_test_cases; i++) {
+        bool failed = run_float_test_case(float_test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (run_random_checks()) {
+        failed_test_cases++;
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
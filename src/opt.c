@@ -0,0 +1,1199 @@
+#include <string.h>
+
+#include "const_eval.h"
+#include "fatal.h"
+#include "opt.h"
+
+typedef struct IrEdit IrEdit;
+typedef struct IrRebuilder IrRebuilder;
+typedef enum IrLattice IrLattice;
+typedef struct ConstantPropagator ConstantPropagator;
+
+// IrEdit lists changes which rebuild_ir_function applies to a function.
+// Arrays are indexed by value id, except drop and move_to, which are indexed
+// by instruction
+struct IrEdit {
+    // value which replaces all uses of a value, replacements may form chains
+    ValueId *replace;
+
+    // instructions which are left out, their results must be either unused
+    // or replaced
+    bool *drop;
+
+    // block parameters which are removed together with their arguments, uses
+    // of removed parameter must be replaced unless it becomes constant
+    bool *drop_param;
+
+    // values which become constants with given bits, instruction is replaced
+    // by constant and parameter is removed with constant placed at the start
+    // of its block
+    bool *is_const;
+    u64 *bits;
+
+    // block which instruction is moved to, IR_NONE keeps instruction in place.
+    // Moved instructions are placed before terminator of their new block in
+    // order of moves array
+    BlockId *move_to;
+    u32 *moves;
+    u32 moves_len;
+
+    // merge block into its only predecessor if predecessor ends with jump
+    bool merge_blocks;
+};
+
+// IrRebuilder keeps state of a single rebuild_ir_function call
+struct IrRebuilder {
+    const IrFunction *fn;
+    const IrEdit *edit;
+    IrCfg cfg;
+
+    // function being built
+    IrFunction out;
+
+    // new id of each value, IR_NONE until value is emitted
+    ValueId *values;
+
+    // new id of each block, IR_NONE for blocks which are not emitted on their own
+    BlockId *blocks;
+
+    // blocks which are emitted as continuation of their only predecessor
+    bool *merged;
+
+    // operands of instruction being emitted
+    ValueId *operands;
+
+    // types of parameters of block being emitted
+    TypeId *types;
+};
+
+IrEdit init_ir_edit(const IrFunction *fn) {
+    u64 values       = (u64)fn->values_len + 1;
+    u64 instructions = (u64)fn->instructions_len + 1;
+
+    IrEdit e = {
+        .replace      = (ValueId *)alloc_ir_temp(values * sizeof(ValueId)),
+        .drop         = (bool *)alloc_ir_temp(instructions * sizeof(bool)),
+        .drop_param   = (bool *)alloc_ir_temp(values * sizeof(bool)),
+        .is_const     = (bool *)alloc_ir_temp(values * sizeof(bool)),
+        .bits         = (u64 *)alloc_ir_temp(values * sizeof(u64)),
+        .move_to      = (BlockId *)alloc_ir_temp(instructions * sizeof(BlockId)),
+        .moves        = (u32 *)alloc_ir_temp(instructions * sizeof(u32)),
+        .moves_len    = 0,
+        .merge_blocks = false,
+    };
+    for (u32 i = 0; i < fn->values_len; i++) {
+        e.replace[i] = i;
+    }
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        e.move_to[i] = IR_NONE;
+    }
+    memset(e.drop, 0, instructions * sizeof(bool));
+    memset(e.drop_param, 0, values * sizeof(bool));
+    memset(e.is_const, 0, values * sizeof(bool));
+    memset(e.bits, 0, values * sizeof(u64));
+    return e;
+}
+
+void free_ir_edit(IrEdit *e) {
+    free_mem(e->replace);
+    free_mem(e->drop);
+    free_mem(e->drop_param);
+    free_mem(e->is_const);
+    free_mem(e->bits);
+    free_mem(e->move_to);
+    free_mem(e->moves);
+}
+
+ValueId resolve_ir_value(const IrEdit *e, ValueId v) {
+    while (e->replace[v] != v) {
+        v = e->replace[v];
+    }
+    return v;
+}
+
+bool is_ir_param_kept(const IrEdit *e, ValueId param) {
+    return !e->drop_param[param] && !e->is_const[param];
+}
+
+ValueId map_ir_value(IrRebuilder *r, ValueId v) {
+    ValueId id = r->values[resolve_ir_value(r->edit, v)];
+    if (id == IR_NONE) {
+        fatal(1, "value is used before its definition in rebuilt function");
+    }
+    return id;
+}
+
+// map_ir_block_args writes new ids of arguments for parameters of target
+// which are kept and returns their number
+u32 map_ir_block_args(IrRebuilder *r, BlockId target, const ValueId *args, u32 len, ValueId *out) {
+    ValueId params = r->fn->blocks[target].params;
+    u32 n          = 0;
+    for (u32 i = 0; i < len; i++) {
+        if (is_ir_param_kept(r->edit, params + i)) {
+            out[n] = map_ir_value(r, args[i]);
+            n++;
+        }
+    }
+    return n;
+}
+
+void emit_ir_constant(IrRebuilder *r, ValueId v) {
+    IrInstruction *inst = add_ir_instruction(&r->out, op_Const, r->fn->values[v], nil, 0);
+    inst->imm           = r->edit->bits[v];
+    r->values[v]        = inst->result;
+}
+
+void emit_ir_instruction(IrRebuilder *r, IrInstruction inst) {
+    if (inst.result != IR_NONE && r->edit->is_const[inst.result]) {
+        emit_ir_constant(r, inst.result);
+        return;
+    }
+    const ValueId *ops = r->fn->operands + inst.operands;
+    for (u32 i = 0; i < inst.operands_len; i++) {
+        r->operands[i] = map_ir_value(r, ops[i]);
+    }
+    IrInstruction *out = add_ir_instruction(&r->out, inst.op, inst.type, r->operands, inst.operands_len);
+    out->imm           = inst.imm;
+    if (inst.op == op_String) {
+        out->imm = add_ir_string(&r->out, r->fn->strings[inst.imm]);
+    }
+    if (inst.result != IR_NONE) {
+        r->values[inst.result] = out->result;
+    }
+}
+
+void emit_ir_terminator(IrRebuilder *r, const IrInstruction *inst) {
+    if (inst->op == op_Return) {
+        emit_ir_instruction(r, *inst);
+        return;
+    }
+
+    u32 len;
+    const ValueId *args = get_ir_target_args(r->fn, inst, 0, &len);
+    if (inst->op == op_Jump) {
+        u32 n            = map_ir_block_args(r, inst->targets[0], args, len, r->operands);
+        IrInstruction *j = add_ir_instruction(&r->out, op_Jump, ti_Void, r->operands, n);
+        j->targets[0]    = r->blocks[inst->targets[0]];
+        return;
+    }
+
+    r->operands[0]   = map_ir_value(r, r->fn->operands[inst->operands]);
+    u32 then_args    = map_ir_block_args(r, inst->targets[0], args, len, r->operands + 1);
+    args             = get_ir_target_args(r->fn, inst, 1, &len);
+    u32 else_args    = map_ir_block_args(r, inst->targets[1], args, len, r->operands + 1 + then_args);
+    IrInstruction *b = add_ir_instruction(&r->out, op_Branch, ti_Void, r->operands, 1 + then_args + else_args);
+    b->targets[0]    = r->blocks[inst->targets[0]];
+    b->targets[1]    = r->blocks[inst->targets[1]];
+    b->then_args     = then_args;
+}
+
+// emit_ir_block_body emits all instructions of block except terminator,
+// including constants which replace its parameters and instructions moved
+// into it
+void emit_ir_block_body(IrRebuilder *r, BlockId b) {
+    const IrEdit *e = r->edit;
+    IrBlock block   = r->fn->blocks[b];
+    for (u32 i = 0; i < block.params_len; i++) {
+        if (e->is_const[block.params + i]) {
+            emit_ir_constant(r, block.params + i);
+        }
+    }
+    for (u32 i = block.start; i < block.start + block.len - 1; i++) {
+        if (!e->drop[i] && e->move_to[i] == IR_NONE) {
+            emit_ir_instruction(r, r->fn->instructions[i]);
+        }
+    }
+    for (u32 i = 0; i < e->moves_len; i++) {
+        if (e->move_to[e->moves[i]] == b) {
+            emit_ir_instruction(r, r->fn->instructions[e->moves[i]]);
+        }
+    }
+}
+
+// mark_ir_merged_blocks finds blocks which are entered only by jump from
+// a single predecessor and numbers the remaining blocks in reverse postorder
+void mark_ir_merged_blocks(IrRebuilder *r) {
+    const IrCfg *cfg = &r->cfg;
+    for (u32 i = 0; i < r->fn->blocks_len; i++) {
+        r->merged[i] = false;
+        r->blocks[i] = IR_NONE;
+    }
+    if (r->edit->merge_blocks) {
+        for (u32 i = 1; i < cfg->reachable; i++) {
+            BlockId b = cfg->order[i];
+            if (cfg->preds_start[b + 1] - cfg->preds_start[b] != 1) {
+                continue;
+            }
+            BlockId pred = cfg->preds[cfg->preds_start[b]];
+            r->merged[b] = get_ir_terminator(r->fn, pred)->op == op_Jump;
+        }
+    }
+
+    BlockId next = 0;
+    for (u32 i = 0; i < cfg->reachable; i++) {
+        BlockId b = cfg->order[i];
+        if (!r->merged[b]) {
+            r->blocks[b] = next;
+            next++;
+        }
+    }
+}
+
+// rebuild_ir_function returns new function with changes of edit applied.
+// Blocks unreachable from entry are left out and the rest are placed in
+// reverse postorder, so that each definition precedes its uses
+IrFunction rebuild_ir_function(const IrFunction *fn, const IrEdit *edit) {
+    IrRebuilder r = {
+        .fn       = fn,
+        .edit     = edit,
+        .cfg      = compute_ir_cfg(fn),
+        .out      = init_ir_function(fn->name, fn->params, fn->result),
+        .values   = (ValueId *)alloc_ir_temp((u64)fn->values_len * sizeof(ValueId) + 1),
+        .blocks   = (BlockId *)alloc_ir_temp((u64)fn->blocks_len * sizeof(BlockId) + 1),
+        .merged   = (bool *)alloc_ir_temp((u64)fn->blocks_len * sizeof(bool) + 1),
+        .operands = (ValueId *)alloc_ir_temp((u64)fn->operands_len * sizeof(ValueId) + 1),
+        .types    = (TypeId *)alloc_ir_temp((u64)fn->values_len * sizeof(TypeId) + 1),
+    };
+    for (u32 i = 0; i < fn->values_len; i++) {
+        r.values[i] = IR_NONE;
+    }
+    mark_ir_merged_blocks(&r);
+
+    for (u32 i = 0; i < r.cfg.reachable; i++) {
+        BlockId b = r.cfg.order[i];
+        if (r.merged[b]) {
+            continue;
+        }
+        IrBlock block = fn->blocks[b];
+        u32 params    = 0;
+        for (u32 j = 0; j < block.params_len; j++) {
+            if (is_ir_param_kept(edit, block.params + j)) {
+                r.types[params] = fn->values[block.params + j];
+                params++;
+            }
+        }
+        BlockId nb = new_ir_block(&r.out, params, r.types);
+        ValueId id = r.out.blocks[nb].params;
+        for (u32 j = 0; j < block.params_len; j++) {
+            if (is_ir_param_kept(edit, block.params + j)) {
+                r.values[block.params + j] = id;
+                id++;
+            }
+        }
+        open_ir_block(&r.out, nb);
+
+        // merged blocks continue their predecessor, their parameters take
+        // values of jump arguments directly
+        BlockId cur = b;
+        for (;;) {
+            emit_ir_block_body(&r, cur);
+            const IrInstruction *term = get_ir_terminator(fn, cur);
+            if (term->op != op_Jump || !r.merged[term->targets[0]]) {
+                emit_ir_terminator(&r, term);
+                break;
+            }
+            BlockId next        = term->targets[0];
+            IrBlock next_block  = fn->blocks[next];
+            const ValueId *args = fn->operands + term->operands;
+            for (u32 j = 0; j < next_block.params_len; j++) {
+                if (is_ir_param_kept(edit, next_block.params + j)) {
+                    r.values[next_block.params + j] = map_ir_value(&r, args[j]);
+                }
+            }
+            cur = next;
+        }
+    }
+
+    free_ir_cfg(&r.cfg);
+    free_mem(r.values);
+    free_mem(r.blocks);
+    free_mem(r.merged);
+    free_mem(r.operands);
+    free_mem(r.types);
+    return r.out;
+}
+
+void apply_ir_edit(IrFunction *fn, const IrEdit *edit) {
+    IrFunction out = rebuild_ir_function(fn, edit);
+    free_ir_function(fn);
+    *fn = out;
+}
+
+// IrLattice is a state of value during constant propagation, state of value
+// only moves down the list
+enum IrLattice {
+    // no executable definition reached the value yet
+    il_Undefined,
+
+    il_Constant,
+
+    // value is not known at compile time
+    il_Varying,
+};
+
+// ConstantPropagator keeps state of propagate_ir_constants call
+struct ConstantPropagator {
+    const TypeTable *table;
+    IrFunction *fn;
+
+    IrLattice *state;
+    u64 *bits;
+
+    // blocks which may be executed
+    bool *executable;
+
+    // set when any state changes during iteration
+    bool changed;
+};
+
+void lower_ir_lattice(ConstantPropagator *p, ValueId v, IrLattice state, u64 bits) {
+    IrLattice cur = p->state[v];
+    if (cur == il_Varying || state == il_Undefined) {
+        return;
+    }
+    if (cur == il_Undefined) {
+        p->state[v] = state;
+        p->bits[v]  = bits;
+        p->changed  = true;
+        return;
+    }
+    if (state == il_Constant && bits == p->bits[v]) {
+        return;
+    }
+    p->state[v] = il_Varying;
+    p->changed  = true;
+}
+
+TokenType get_ir_binary_operator(IrOpcode op) {
+    switch (op) {
+    case op_Add:
+        return tt_Plus;
+    case op_Sub:
+        return tt_Minus;
+    case op_Mul:
+        return tt_Asterisk;
+    case op_Div:
+        return tt_Slash;
+    case op_Rem:
+        return tt_Percent;
+    case op_And:
+        return tt_Ampersand;
+    case op_Or:
+        return tt_Pipe;
+    case op_Xor:
+        return tt_Caret;
+    case op_AndNot:
+        return tt_BitwiseAndNot;
+    case op_Shl:
+        return tt_LeftShift;
+    case op_Shr:
+        return tt_RightShift;
+    case op_Eq:
+        return tt_Equal;
+    case op_Ne:
+        return tt_NotEqual;
+    case op_Lt:
+        return tt_Less;
+    case op_Le:
+        return tt_LessOrEqual;
+    case op_Gt:
+        return tt_Greater;
+    default:
+        return tt_GreaterOrEqual;
+    }
+}
+
+// fold_ir_binary evaluates binary operation or comparison with constant
+// operands in the same way as at runtime, returns false if result is not
+// known: operands are floats, divisor is zero or shift count is negative
+bool fold_ir_binary(ConstantPropagator *p, IrInstruction inst, u64 a, u64 b, u64 *result) {
+    const ValueId *ops = p->fn->operands + inst.operands;
+    TypeId type_id     = p->fn->values[ops[0]];
+    Type type          = get_type(p->table, type_id);
+    if (type_id == ti_Bool) {
+        if (inst.op != op_Eq && inst.op != op_Ne) {
+            return false;
+        }
+        *result = (a == b) == (inst.op == op_Eq) ? 1 : 0;
+        return true;
+    }
+    if (type.kind != tk_Signed && type.kind != tk_Unsigned) {
+        return false;
+    }
+    if ((inst.op == op_Div || inst.op == op_Rem) && b == 0) {
+        return false;
+    }
+    if ((inst.op == op_Shl || inst.op == op_Shr) && get_type(p->table, p->fn->values[ops[1]]).kind == tk_Signed &&
+        (i64)b < 0) {
+        return false;
+    }
+    *result = fold_typed_integer(type, get_ir_binary_operator(inst.op), a, b).value.integer;
+    return true;
+}
+
+bool fold_ir_unary(ConstantPropagator *p, IrInstruction inst, u64 a, u64 *result) {
+    Type type = get_type(p->table, inst.type);
+    if (inst.op == op_Not) {
+        *result = a ^ 1;
+        return true;
+    }
+    if (type.kind != tk_Signed && type.kind != tk_Unsigned) {
+        return false;
+    }
+    *result = wrap_integer(type, inst.op == op_Neg ? 0 - a : ~a);
+    return true;
+}
+
+// evaluate_ir_instruction computes lattice state of instruction result from
+// states of its operands
+void evaluate_ir_instruction(ConstantPropagator *p, IrInstruction inst) {
+    const ValueId *ops = p->fn->operands + inst.operands;
+    if (inst.op == op_Const) {
+        lower_ir_lattice(p, inst.result, il_Constant, inst.imm);
+        return;
+    }
+    if (inst.result == IR_NONE) {
+        return;
+    }
+    bool is_unary = inst.op == op_Neg || inst.op == op_Not || inst.op == op_BitNot;
+    if (!is_ir_pure(inst.op) || inst.op == op_String || inst.op == op_Extract) {
+        lower_ir_lattice(p, inst.result, il_Varying, 0);
+        return;
+    }
+
+    IrLattice state = il_Constant;
+    for (u32 i = 0; i < inst.operands_len; i++) {
+        if (p->state[ops[i]] == il_Varying) {
+            state = il_Varying;
+        } else if (p->state[ops[i]] == il_Undefined && state == il_Constant) {
+            state = il_Undefined;
+        }
+    }
+    if (state != il_Constant) {
+        lower_ir_lattice(p, inst.result, state, 0);
+        return;
+    }
+
+    u64 result = 0;
+    bool ok    = is_unary ? fold_ir_unary(p, inst, p->bits[ops[0]], &result)
+                          : fold_ir_binary(p, inst, p->bits[ops[0]], p->bits[ops[1]], &result);
+    lower_ir_lattice(p, inst.result, ok ? il_Constant : il_Varying, result);
+}
+
+// follow_ir_edge marks target as executable and merges states of arguments
+// into its parameters
+void follow_ir_edge(ConstantPropagator *p, const IrInstruction *term, u32 target) {
+    BlockId b = term->targets[target];
+    if (!p->executable[b]) {
+        p->executable[b] = true;
+        p->changed       = true;
+    }
+    u32 len;
+    const ValueId *args = get_ir_target_args(p->fn, term, target, &len);
+    ValueId params      = p->fn->blocks[b].params;
+    for (u32 i = 0; i < len; i++) {
+        lower_ir_lattice(p, params + i, p->state[args[i]], p->bits[args[i]]);
+    }
+}
+
+void evaluate_ir_terminator(ConstantPropagator *p, const IrInstruction *term) {
+    if (term->op == op_Jump) {
+        follow_ir_edge(p, term, 0);
+        return;
+    }
+    if (term->op != op_Branch) {
+        return;
+    }
+    ValueId condition = p->fn->operands[term->operands];
+    switch (p->state[condition]) {
+    case il_Undefined:
+        break;
+    case il_Constant:
+        follow_ir_edge(p, term, p->bits[condition] != 0 ? 0 : 1);
+        break;
+    case il_Varying:
+        follow_ir_edge(p, term, 0);
+        follow_ir_edge(p, term, 1);
+        break;
+    }
+}
+
+// fold_ir_branch turns branch with constant condition into jump to the
+// target which is taken
+void fold_ir_branch(IrFunction *fn, IrInstruction *term, u64 condition) {
+    u32 target = condition != 0 ? 0 : 1;
+    u32 len;
+    const ValueId *args = get_ir_target_args(fn, term, target, &len);
+
+    term->op           = op_Jump;
+    term->operands     = (u32)(args - fn->operands);
+    term->operands_len = len;
+    term->targets[0]   = term->targets[target];
+    term->targets[1]   = IR_NONE;
+    term->then_args    = 0;
+}
+
+// Lattice states are computed by iterating over executable blocks in reverse
+// postorder until nothing changes. States only go down and each pass which
+// changes nothing ends iteration, thus it reaches the same fixed point as
+// worklist formulation of the algorithm
+void propagate_ir_constants(const IrModule *m, IrFunction *fn) {
+    IrCfg cfg            = compute_ir_cfg(fn);
+    ConstantPropagator p = {
+        .table      = m->table,
+        .fn         = fn,
+        .state      = (IrLattice *)alloc_ir_temp((u64)fn->values_len * sizeof(IrLattice) + 1),
+        .bits       = (u64 *)alloc_ir_temp((u64)fn->values_len * sizeof(u64) + 1),
+        .executable = (bool *)alloc_ir_temp((u64)fn->blocks_len * sizeof(bool) + 1),
+        .changed    = true,
+    };
+    for (u32 i = 0; i < fn->values_len; i++) {
+        p.state[i] = il_Undefined;
+        p.bits[i]  = 0;
+    }
+    for (u32 i = 0; i < fn->blocks_len; i++) {
+        p.executable[i] = false;
+    }
+    p.executable[0] = true;
+    for (u32 i = 0; i < fn->blocks[0].params_len; i++) {
+        p.state[fn->blocks[0].params + i] = il_Varying;
+    }
+
+    while (p.changed) {
+        p.changed = false;
+        for (u32 i = 0; i < cfg.reachable; i++) {
+            BlockId b = cfg.order[i];
+            if (!p.executable[b]) {
+                continue;
+            }
+            IrBlock block = fn->blocks[b];
+            for (u32 j = block.start; j < block.start + block.len - 1; j++) {
+                evaluate_ir_instruction(&p, fn->instructions[j]);
+            }
+            evaluate_ir_terminator(&p, get_ir_terminator(fn, b));
+        }
+    }
+
+    IrEdit e = init_ir_edit(fn);
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b = cfg.order[i];
+        if (!p.executable[b]) {
+            continue;
+        }
+        IrInstruction *term = get_ir_terminator(fn, b);
+        if (term->op == op_Branch) {
+            ValueId condition = fn->operands[term->operands];
+            if (p.state[condition] == il_Constant) {
+                fold_ir_branch(fn, term, p.bits[condition]);
+            }
+        }
+    }
+    for (u32 i = 0; i < fn->values_len; i++) {
+        if (p.state[i] == il_Constant) {
+            e.is_const[i] = true;
+            e.bits[i]     = p.bits[i];
+        }
+    }
+    apply_ir_edit(fn, &e);
+
+    free_ir_edit(&e);
+    free_ir_cfg(&cfg);
+    free_mem(p.state);
+    free_mem(p.bits);
+    free_mem(p.executable);
+}
+
+// find_single_ir_argument returns value passed to parameter with index k of
+// block b by all predecessors, passing parameter to itself is ignored.
+// Returns IR_NONE if predecessors pass different values
+ValueId find_single_ir_argument(const IrFunction *fn, const IrCfg *cfg, const IrEdit *e, BlockId b, u32 k) {
+    ValueId param = fn->blocks[b].params + k;
+    ValueId value = IR_NONE;
+    for (u32 i = cfg->preds_start[b]; i < cfg->preds_start[b + 1]; i++) {
+        const IrInstruction *term = get_ir_terminator(fn, cfg->preds[i]);
+        u32 targets               = term->op == op_Branch ? 2 : 1;
+        for (u32 t = 0; t < targets; t++) {
+            if (term->targets[t] != b) {
+                continue;
+            }
+            u32 len;
+            ValueId arg = resolve_ir_value(e, get_ir_target_args(fn, term, t, &len)[k]);
+            if (arg == param) {
+                continue;
+            }
+            if (value != IR_NONE && value != arg) {
+                return IR_NONE;
+            }
+            value = arg;
+        }
+    }
+    return value;
+}
+
+// Parameter which receives a single value is replaced by that value, as
+// described in "Simple and Efficient Construction of Static Single Assignment
+// Form" by Braun et al. Replacement may reveal more such parameters, thus
+// blocks are scanned until nothing changes
+void propagate_ir_copies(const IrModule *m, IrFunction *fn) {
+    (void)m;
+    IrCfg cfg    = compute_ir_cfg(fn);
+    IrEdit e     = init_ir_edit(fn);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = 1; i < cfg.reachable; i++) {
+            BlockId b     = cfg.order[i];
+            IrBlock block = fn->blocks[b];
+            for (u32 k = 0; k < block.params_len; k++) {
+                ValueId param = block.params + k;
+                if (e.drop_param[param]) {
+                    continue;
+                }
+                ValueId value = find_single_ir_argument(fn, &cfg, &e, b, k);
+                if (value != IR_NONE) {
+                    e.replace[param]    = value;
+                    e.drop_param[param] = true;
+                    changed             = true;
+                }
+            }
+        }
+    }
+    apply_ir_edit(fn, &e);
+
+    free_ir_edit(&e);
+    free_ir_cfg(&cfg);
+}
+
+u64 mix_ir_hash(u64 h, u64 x) {
+    h ^= x;
+    h *= 0x100000001B3ULL;
+    return h;
+}
+
+bool is_ir_commutative(IrOpcode op) {
+    return op == op_Add || op == op_Mul || op == op_And || op == op_Or || op == op_Xor || op == op_Eq || op == op_Ne;
+}
+
+// hash_ir_instruction gives the same hash to instructions which compute the
+// same value, operands of commutative operations are taken in sorted order
+u64 hash_ir_instruction(const IrFunction *fn, const IrEdit *e, IrInstruction inst) {
+    u64 h = 0xCBF29CE484222325ULL;
+    h     = mix_ir_hash(h, inst.op);
+    h     = mix_ir_hash(h, inst.type);
+    if (inst.op == op_String) {
+        str s = fn->strings[inst.imm];
+        for (u64 i = 0; i < s.len; i++) {
+            h = mix_ir_hash(h, s.bytes[i]);
+        }
+        return h;
+    }
+    h                  = mix_ir_hash(h, inst.imm);
+    const ValueId *ops = fn->operands + inst.operands;
+    if (inst.operands_len == 2 && is_ir_commutative(inst.op)) {
+        ValueId a = resolve_ir_value(e, ops[0]);
+        ValueId b = resolve_ir_value(e, ops[1]);
+        h         = mix_ir_hash(h, a < b ? a : b);
+        return mix_ir_hash(h, a < b ? b : a);
+    }
+    for (u32 i = 0; i < inst.operands_len; i++) {
+        h = mix_ir_hash(h, resolve_ir_value(e, ops[i]));
+    }
+    return h;
+}
+
+bool are_ir_instructions_equal(const IrFunction *fn, const IrEdit *e, IrInstruction a, IrInstruction b) {
+    if (a.op != b.op || a.type != b.type || a.operands_len != b.operands_len) {
+        return false;
+    }
+    if (a.op == op_String) {
+        return are_strs_equal(fn->strings[a.imm], fn->strings[b.imm]);
+    }
+    if (a.imm != b.imm) {
+        return false;
+    }
+    const ValueId *x = fn->operands + a.operands;
+    const ValueId *y = fn->operands + b.operands;
+    if (a.operands_len == 2 && is_ir_commutative(a.op)) {
+        ValueId x0 = resolve_ir_value(e, x[0]);
+        ValueId x1 = resolve_ir_value(e, x[1]);
+        ValueId y0 = resolve_ir_value(e, y[0]);
+        ValueId y1 = resolve_ir_value(e, y[1]);
+        return (x0 == y0 && x1 == y1) || (x0 == y1 && x1 == y0);
+    }
+    for (u32 i = 0; i < a.operands_len; i++) {
+        if (resolve_ir_value(e, x[i]) != resolve_ir_value(e, y[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Blocks are visited in reverse postorder, so operands of each instruction
+// are already numbered when it is looked up. Table of instructions is keyed
+// by operation and numbered operands, instruction found in the table is
+// reused only if its block dominates current one, otherwise both stay in
+// the table
+void merge_ir_redundant_values(const IrModule *m, IrFunction *fn) {
+    (void)m;
+    IrCfg cfg = compute_ir_cfg(fn);
+    IrEdit e  = init_ir_edit(fn);
+
+    u32 cap = 16;
+    while (cap < 2 * fn->instructions_len) {
+        cap *= 2;
+    }
+    u32 mask       = cap - 1;
+    u32 *slots     = (u32 *)alloc_ir_temp((u64)cap * sizeof(u32));
+    BlockId *owner = (BlockId *)alloc_ir_temp((u64)fn->instructions_len * sizeof(BlockId) + 1);
+    for (u32 i = 0; i < cap; i++) {
+        slots[i] = IR_NONE;
+    }
+
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        IrBlock block = fn->blocks[b];
+        for (u32 j = block.start; j < block.start + block.len - 1; j++) {
+            IrInstruction inst = fn->instructions[j];
+            owner[j]           = b;
+            if (!is_ir_pure(inst.op)) {
+                continue;
+            }
+            u32 slot = (u32)hash_ir_instruction(fn, &e, inst) & mask;
+            for (;;) {
+                u32 other = slots[slot];
+                if (other == IR_NONE) {
+                    slots[slot] = j;
+                    break;
+                }
+                if (are_ir_instructions_equal(fn, &e, fn->instructions[other], inst) &&
+                    ir_block_dominates(cfg.idom, owner[other], b)) {
+                    e.replace[inst.result] = fn->instructions[other].result;
+                    e.drop[j]              = true;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    }
+    apply_ir_edit(fn, &e);
+
+    free_ir_edit(&e);
+    free_ir_cfg(&cfg);
+    free_mem(slots);
+    free_mem(owner);
+}
+
+// IrLoop is a natural loop found by its back edges
+typedef struct IrLoop IrLoop;
+
+struct IrLoop {
+    BlockId header;
+
+    // blocks of loop body indexed by block id, header included
+    bool *body;
+    u32 size;
+};
+
+// find_ir_loop_body collects blocks from which back edges into header can
+// be reached without passing through header
+IrLoop find_ir_loop_body(const IrFunction *fn, const IrCfg *cfg, BlockId header) {
+    IrLoop loop = {
+        .header = header,
+        .body   = (bool *)alloc_ir_temp((u64)fn->blocks_len * sizeof(bool)),
+        .size   = 1,
+    };
+    memset(loop.body, 0, (u64)fn->blocks_len * sizeof(bool));
+    loop.body[header] = true;
+
+    BlockId *stack = (BlockId *)alloc_ir_temp((u64)fn->blocks_len * sizeof(BlockId));
+    u32 top        = 0;
+    for (u32 i = cfg->preds_start[header]; i < cfg->preds_start[header + 1]; i++) {
+        BlockId latch = cfg->preds[i];
+        if (!loop.body[latch] && ir_block_dominates(cfg->idom, header, latch)) {
+            loop.body[latch] = true;
+            loop.size++;
+            stack[top] = latch;
+            top++;
+        }
+    }
+    while (top != 0) {
+        top--;
+        BlockId b = stack[top];
+        for (u32 i = cfg->preds_start[b]; i < cfg->preds_start[b + 1]; i++) {
+            BlockId p = cfg->preds[i];
+            if (!loop.body[p]) {
+                loop.body[p] = true;
+                loop.size++;
+                stack[top] = p;
+                top++;
+            }
+        }
+    }
+    free_mem(stack);
+    return loop;
+}
+
+// find_ir_preheader returns the only block outside of loop which jumps to
+// its header, IR_NONE if there is no such block
+BlockId find_ir_preheader(const IrFunction *fn, const IrCfg *cfg, IrLoop loop) {
+    BlockId preheader = IR_NONE;
+    for (u32 i = cfg->preds_start[loop.header]; i < cfg->preds_start[loop.header + 1]; i++) {
+        BlockId p = cfg->preds[i];
+        if (loop.body[p]) {
+            continue;
+        }
+        if (preheader != IR_NONE || get_ir_terminator(fn, p)->op != op_Jump) {
+            return IR_NONE;
+        }
+        preheader = p;
+    }
+    return preheader;
+}
+
+// IrHoister keeps state of hoist_ir_loop_invariants call
+typedef struct IrHoister IrHoister;
+
+struct IrHoister {
+    IrFunction *fn;
+    const TypeTable *table;
+
+    // current block of each instruction, IR_NONE for unreachable ones
+    BlockId *place;
+
+    // current block of value definition
+    BlockId *def_block;
+
+    // instruction which defines value, IR_NONE for block parameters
+    u32 *def_inst;
+
+    // position of instruction in order of moves, the latest move counts
+    u32 *seq;
+    u32 moves;
+};
+
+// is_ir_division_safe tells whether division can be executed speculatively,
+// it never traps only if divisor is a constant other than zero and -1
+bool is_ir_division_safe(IrHoister *h, IrInstruction inst) {
+    ValueId divisor = h->fn->operands[inst.operands + 1];
+    u32 def         = h->def_inst[divisor];
+    if (def == IR_NONE || h->fn->instructions[def].op != op_Const) {
+        return false;
+    }
+    u64 bits = h->fn->instructions[def].imm;
+    return bits != 0 && (get_type(h->table, inst.type).kind != tk_Signed || (i64)bits != -1);
+}
+
+bool is_ir_loop_invariant(IrHoister *h, IrLoop loop, u32 index) {
+    IrInstruction inst = h->fn->instructions[index];
+    if (!is_ir_pure(inst.op)) {
+        return false;
+    }
+    if ((inst.op == op_Div || inst.op == op_Rem) && !is_ir_division_safe(h, inst)) {
+        return false;
+    }
+    const ValueId *ops = h->fn->operands + inst.operands;
+    for (u32 i = 0; i < inst.operands_len; i++) {
+        if (loop.body[h->def_block[ops[i]]]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// hoist_ir_loop moves invariant instructions of loop into its preheader
+// until no more instructions become invariant
+void hoist_ir_loop(IrHoister *h, IrEdit *e, IrLoop loop, BlockId preheader) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = 0; i < h->fn->instructions_len; i++) {
+            if (h->place[i] == IR_NONE || !loop.body[h->place[i]] || !is_ir_loop_invariant(h, loop, i)) {
+                continue;
+            }
+            ValueId result       = h->fn->instructions[i].result;
+            h->place[i]          = preheader;
+            h->def_block[result] = preheader;
+            h->seq[i]            = h->moves;
+            e->move_to[i]        = preheader;
+            h->moves++;
+            changed = true;
+        }
+    }
+}
+
+// Loops are processed from the smallest one, so that instruction hoisted
+// into preheader of inner loop may then leave the outer loop too. Loops
+// without a single predecessor block which ends with jump are skipped
+void hoist_ir_loop_invariants(const IrModule *m, IrFunction *fn) {
+    IrCfg cfg   = compute_ir_cfg(fn);
+    IrEdit e    = init_ir_edit(fn);
+    IrHoister h = {
+        .fn        = fn,
+        .table     = m->table,
+        .place     = (BlockId *)alloc_ir_temp((u64)fn->instructions_len * sizeof(BlockId) + 1),
+        .def_block = (BlockId *)alloc_ir_temp((u64)fn->values_len * sizeof(BlockId) + 1),
+        .def_inst  = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1),
+        .seq       = (u32 *)alloc_ir_temp((u64)fn->instructions_len * sizeof(u32) + 1),
+        .moves     = 0,
+    };
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        h.place[i] = IR_NONE;
+        h.seq[i]   = IR_NONE;
+    }
+    for (u32 i = 0; i < fn->values_len; i++) {
+        h.def_block[i] = IR_NONE;
+        h.def_inst[i]  = IR_NONE;
+    }
+
+    IrLoop *loops = (IrLoop *)alloc_ir_temp((u64)fn->blocks_len * sizeof(IrLoop) + 1);
+    u32 loops_len = 0;
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        IrBlock block = fn->blocks[b];
+        for (u32 j = 0; j < block.params_len; j++) {
+            h.def_block[block.params + j] = b;
+        }
+        for (u32 j = block.start; j < block.start + block.len; j++) {
+            h.place[j] = b;
+            if (fn->instructions[j].result != IR_NONE) {
+                h.def_block[fn->instructions[j].result] = b;
+                h.def_inst[fn->instructions[j].result]  = j;
+            }
+        }
+        for (u32 j = cfg.preds_start[b]; j < cfg.preds_start[b + 1]; j++) {
+            if (ir_block_dominates(cfg.idom, b, cfg.preds[j])) {
+                loops[loops_len] = find_ir_loop_body(fn, &cfg, b);
+                loops_len++;
+                break;
+            }
+        }
+    }
+
+    // insertion sort by size, there are few loops in a function
+    for (u32 i = 1; i < loops_len; i++) {
+        IrLoop loop = loops[i];
+        u32 j       = i;
+        while (j > 0 && loops[j - 1].size > loop.size) {
+            loops[j] = loops[j - 1];
+            j--;
+        }
+        loops[j] = loop;
+    }
+    for (u32 i = 0; i < loops_len; i++) {
+        BlockId preheader = find_ir_preheader(fn, &cfg, loops[i]);
+        if (preheader != IR_NONE) {
+            hoist_ir_loop(&h, &e, loops[i], preheader);
+        }
+    }
+
+    // moved instructions are emitted in order of their latest move, which
+    // keeps definitions before uses
+    u32 *order = (u32 *)alloc_ir_temp((u64)h.moves * sizeof(u32) + 1);
+    for (u32 i = 0; i < h.moves; i++) {
+        order[i] = IR_NONE;
+    }
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        if (h.seq[i] != IR_NONE) {
+            order[h.seq[i]] = i;
+        }
+    }
+    for (u32 i = 0; i < h.moves; i++) {
+        if (order[i] != IR_NONE) {
+            e.moves[e.moves_len] = order[i];
+            e.moves_len++;
+        }
+    }
+    apply_ir_edit(fn, &e);
+
+    for (u32 i = 0; i < loops_len; i++) {
+        free_mem(loops[i].body);
+    }
+    free_mem(loops);
+    free_mem(order);
+    free_ir_edit(&e);
+    free_ir_cfg(&cfg);
+    free_mem(h.place);
+    free_mem(h.def_block);
+    free_mem(h.def_inst);
+    free_mem(h.seq);
+}
+
+// DeadCodeEliminator keeps state of remove_ir_dead_code call
+typedef struct DeadCodeEliminator DeadCodeEliminator;
+
+struct DeadCodeEliminator {
+    const IrFunction *fn;
+    const IrCfg *cfg;
+
+    bool *live;
+
+    // instruction which defines value, IR_NONE for block parameters
+    u32 *def_inst;
+
+    // block of parameter, IR_NONE for instruction results
+    BlockId *param_block;
+
+    // live values whose operands or arguments are not marked yet
+    ValueId *stack;
+    u32 top;
+};
+
+void mark_ir_live(DeadCodeEliminator *d, ValueId v) {
+    if (d->live[v]) {
+        return;
+    }
+    d->live[v]       = true;
+    d->stack[d->top] = v;
+    d->top++;
+}
+
+void mark_ir_operands_live(DeadCodeEliminator *d, IrInstruction inst) {
+    const ValueId *ops = d->fn->operands + inst.operands;
+    for (u32 i = 0; i < inst.operands_len; i++) {
+        mark_ir_live(d, ops[i]);
+    }
+}
+
+// mark_ir_param_args marks arguments which predecessors pass to live
+// parameter of block
+void mark_ir_param_args(DeadCodeEliminator *d, BlockId b, u32 k) {
+    const IrCfg *cfg = d->cfg;
+    for (u32 i = cfg->preds_start[b]; i < cfg->preds_start[b + 1]; i++) {
+        const IrInstruction *term = get_ir_terminator(d->fn, cfg->preds[i]);
+        u32 targets               = term->op == op_Branch ? 2 : 1;
+        for (u32 t = 0; t < targets; t++) {
+            if (term->targets[t] == b) {
+                u32 len;
+                mark_ir_live(d, get_ir_target_args(d->fn, term, t, &len)[k]);
+            }
+        }
+    }
+}
+
+// Values are live if they are used by calls, returns, branch conditions or
+// other live values. Argument of jump is live only if parameter which
+// receives it is live, so that values carried around loop without any
+// other use are removed with their parameters
+void remove_ir_dead_code(const IrModule *m, IrFunction *fn) {
+    (void)m;
+    IrCfg cfg            = compute_ir_cfg(fn);
+    DeadCodeEliminator d = {
+        .fn          = fn,
+        .cfg         = &cfg,
+        .live        = (bool *)alloc_ir_temp((u64)fn->values_len * sizeof(bool) + 1),
+        .def_inst    = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1),
+        .param_block = (BlockId *)alloc_ir_temp((u64)fn->values_len * sizeof(BlockId) + 1),
+        .stack       = (ValueId *)alloc_ir_temp((u64)fn->values_len * sizeof(ValueId) + 1),
+        .top         = 0,
+    };
+    for (u32 i = 0; i < fn->values_len; i++) {
+        d.live[i]        = false;
+        d.def_inst[i]    = IR_NONE;
+        d.param_block[i] = IR_NONE;
+    }
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        IrBlock block = fn->blocks[b];
+        for (u32 j = 0; j < block.params_len; j++) {
+            d.param_block[block.params + j] = b;
+        }
+        for (u32 j = block.start; j < block.start + block.len; j++) {
+            IrInstruction inst = fn->instructions[j];
+            if (inst.result != IR_NONE) {
+                d.def_inst[inst.result] = j;
+            }
+        }
+    }
+
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        IrBlock block = fn->blocks[cfg.order[i]];
+        for (u32 j = block.start; j < block.start + block.len; j++) {
+            IrInstruction inst = fn->instructions[j];
+            if (is_ir_call(inst.op) || inst.op == op_Return) {
+                mark_ir_operands_live(&d, inst);
+            } else if (inst.op == op_Branch) {
+                mark_ir_live(&d, fn->operands[inst.operands]);
+            }
+        }
+    }
+    while (d.top != 0) {
+        d.top--;
+        ValueId v = d.stack[d.top];
+        if (d.def_inst[v] != IR_NONE) {
+            mark_ir_operands_live(&d, fn->instructions[d.def_inst[v]]);
+        } else if (d.param_block[v] != 0 && d.param_block[v] != IR_NONE) {
+            BlockId b = d.param_block[v];
+            mark_ir_param_args(&d, b, v - fn->blocks[b].params);
+        }
+    }
+
+    IrEdit e       = init_ir_edit(fn);
+    e.merge_blocks = true;
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        IrBlock block = fn->blocks[b];
+        for (u32 j = 0; j < block.params_len && b != 0; j++) {
+            e.drop_param[block.params + j] = !d.live[block.params + j];
+        }
+        for (u32 j = block.start; j < block.start + block.len - 1; j++) {
+            IrInstruction inst = fn->instructions[j];
+            e.drop[j]          = is_ir_pure(inst.op) && !d.live[inst.result];
+        }
+    }
+    apply_ir_edit(fn, &e);
+
+    free_ir_edit(&e);
+    free_ir_cfg(&cfg);
+    free_mem(d.live);
+    free_mem(d.def_inst);
+    free_mem(d.param_block);
+    free_mem(d.stack);
+}
+
+const IrPass ir_pipeline[] = {
+    {.phase = ph_Sccp, .level = ol_Basic, .run = propagate_ir_constants},
+    {.phase = ph_Copy, .level = ol_Basic, .run = propagate_ir_copies},
+    {.phase = ph_Gvn, .level = ol_Full, .run = merge_ir_redundant_values},
+    {.phase = ph_Licm, .level = ol_Full, .run = hoist_ir_loop_invariants},
+    {.phase = ph_Dce, .level = ol_Basic, .run = remove_ir_dead_code},
+};
+
+const u32 ir_pipeline_len = sizeof(ir_pipeline) / sizeof(ir_pipeline[0]);
+
+// limit of pipeline repetitions at ol_Full level
+const u32 max_ir_pipeline_rounds = 4;
+
+u64 count_ir_instructions(const IrModule *m) {
+    u64 n = 0;
+    for (u32 i = 0; i < m->functions_len; i++) {
+        n += m->functions[i].instructions_len;
+    }
+    return n;
+}
+
+void optimize_ir_module(IrModule *m, OptLevel level, str arg) {
+    if (level == ol_None) {
+        return;
+    }
+    u32 rounds = level == ol_Full ? max_ir_pipeline_rounds : 1;
+    u64 count  = count_ir_instructions(m);
+    for (u32 round = 0; round < rounds; round++) {
+        u64 round_start = count;
+        for (u32 i = 0; i < ir_pipeline_len; i++) {
+            IrPass pass = ir_pipeline[i];
+            if (pass.level > level) {
+                continue;
+            }
+            PhaseScope scope = begin_phase(pass.phase, arg);
+            for (u32 j = 0; j < m->functions_len; j++) {
+                pass.run(m, &m->functions[j]);
+            }
+            u64 after = count_ir_instructions(m);
+            end_pass_phase(scope, count, after);
+            count = after;
+        }
+        if (count == round_start) {
+            break;
+        }
+    }
+}
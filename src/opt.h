@@ -0,0 +1,70 @@
+#ifndef KU_OPT_H
+#define KU_OPT_H
+
+#include "ir.h"
+#include "str.h"
+#include "timer.h"
+#include "types.h"
+
+typedef enum OptLevel OptLevel;
+typedef struct IrPass IrPass;
+
+// OptLevel selects passes of optimization pipeline, it is set by -O0, -O1
+// and -O2 command line flags
+enum OptLevel {
+    // IR is left as produced by lowering
+    ol_None,
+
+    // constant propagation, block parameter simplification and dead code
+    // elimination
+    ol_Basic,
+
+    // adds value numbering and loop invariant code motion, pipeline is
+    // repeated while it keeps removing instructions
+    ol_Full,
+};
+
+// IrPass transforms a single function of module, other functions are not
+// changed. Each pass leaves function valid
+struct IrPass {
+    // phase which measures the pass
+    Phase phase;
+
+    // minimal level which enables the pass
+    OptLevel level;
+
+    void (*run)(const IrModule *m, IrFunction *fn);
+};
+
+// passes in order of execution
+extern const IrPass ir_pipeline[];
+extern const u32 ir_pipeline_len;
+
+// propagate_ir_constants finds values which are constant along executable
+// paths, replaces them with constants and turns branches with constant
+// condition into jumps (sparse conditional constant propagation)
+void propagate_ir_constants(const IrModule *m, IrFunction *fn);
+
+// propagate_ir_copies removes block parameters which receive the same value
+// from all predecessors, apart from the parameter itself passed along a loop
+void propagate_ir_copies(const IrModule *m, IrFunction *fn);
+
+// merge_ir_redundant_values replaces pure instruction with an equal one from
+// dominating block (global value numbering)
+void merge_ir_redundant_values(const IrModule *m, IrFunction *fn);
+
+// hoist_ir_loop_invariants moves pure instructions whose operands are defined
+// outside of loop into the block which precedes loop header
+void hoist_ir_loop_invariants(const IrModule *m, IrFunction *fn);
+
+// remove_ir_dead_code removes unreachable blocks, unused pure instructions
+// and block parameters, then merges blocks into their single predecessor
+void remove_ir_dead_code(const IrModule *m, IrFunction *fn);
+
+u64 count_ir_instructions(const IrModule *m);
+
+// optimize_ir_module runs passes enabled by level over all functions of
+// module, each pass is measured as its own phase with given argument
+void optimize_ir_module(IrModule *m, OptLevel level, str arg);
+
+#endif // KU_OPT_H
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const_eval.h"
+#include "ir.h"
+#include "lower.h"
+#include "opt.h"
+#include "parser.h"
+#include "resolve.h"
+#include "type_check.h"
+
+typedef struct OptTestCase OptTestCase;
+
+struct OptTestCase {
+    u64 id;
+    str label;
+    OptLevel level;
+    str input;
+
+    // dump of the last function after optimization or first problem found
+    // by verifier
+    str want;
+};
+
+const u32 number_of_test_cases = 6;
+
+const OptTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("fibonacci loop"),
+        .level = ol_Full,
+        .input = STR("fn fib(n: i64) => i64 {\n    if n == 0 {\n        return 0\n    }\n    a := 0\n    b := 1\n"
+                     "    loop n - 1 {\n        a, b = b, a + b\n    }\n    return b\n}\n"),
+        .want  = STR("fn fib(i64) => i64 {\n"
+                     "b0(v0 i64):\n"
+                     "    v1 i64 = const 0\n"
+                     "    v2 bool = eq v0, v1\n"
+                     "    branch v2, b1, b2\n"
+                     "b1:\n"
+                     "    return v1\n"
+                     "b2:\n"
+                     "    v3 i64 = const 1\n"
+                     "    v4 i64 = sub v0, v3\n"
+                     "    jump b3(v4, v1, v3)\n"
+                     "b3(v5 i64, v6 i64, v7 i64):\n"
+                     "    v8 bool = gt v5, v1\n"
+                     "    branch v8, b4, b5\n"
+                     "b4:\n"
+                     "    v9 i64 = sub v5, v3\n"
+                     "    v10 i64 = add v6, v7\n"
+                     "    jump b3(v9, v7, v10)\n"
+                     "b5:\n"
+                     "    return v7\n"
+                     "}\n"),
+    },
+    {
+        .id    = 2,
+        .label = STR("constant condition removes branch"),
+        .level = ol_Basic,
+        .input = STR("fn f() => i64 {\n    x := 4\n    if x > 3 {\n        x = x * 2\n    } else {\n        x = 0\n"
+                     "    }\n    return x + 1\n}\n"),
+        .want  = STR("fn f() => i64 {\n"
+                     "b0:\n"
+                     "    v0 i64 = const 9\n"
+                     "    return v0\n"
+                     "}\n"),
+    },
+    {
+        .id    = 3,
+        .label = STR("loop invariant is hoisted"),
+        .level = ol_Full,
+        .input = STR("fn f(n: i64, k: i64) => i64 {\n    s := 0\n    i := 0\n    while i < n {\n        s += k * 3 + i\n"
+                     "        i += 1\n    }\n    return s\n}\n"),
+        .want  = STR("fn f(i64, i64) => i64 {\n"
+                     "b0(v0 i64, v1 i64):\n"
+                     "    v2 i64 = const 0\n"
+                     "    v3 i64 = const 3\n"
+                     "    v4 i64 = mul v1, v3\n"
+                     "    v5 i64 = const 1\n"
+                     "    jump b1(v2, v2)\n"
+                     "b1(v6 i64, v7 i64):\n"
+                     "    v8 bool = lt v7, v0\n"
+                     "    branch v8, b2, b3\n"
+                     "b2:\n"
+                     "    v9 i64 = add v4, v7\n"
+                     "    v10 i64 = add v6, v9\n"
+                     "    v11 i64 = add v7, v5\n"
+                     "    jump b1(v10, v11)\n"
+                     "b3:\n"
+                     "    return v6\n"
+                     "}\n"),
+    },
+    {
+        .id    = 4,
+        .label = STR("unused loop variable"),
+        .level = ol_Basic,
+        .input = STR("fn f(n: i64) => i64 {\n    t := 0\n    loop n {\n        t += 1\n    }\n    return n\n}\n"),
+        .want  = STR("fn f(i64) => i64 {\n"
+                     "b0(v0 i64):\n"
+                     "    jump b1(v0)\n"
+                     "b1(v1 i64):\n"
+                     "    v2 i64 = const 0\n"
+                     "    v3 bool = gt v1, v2\n"
+                     "    branch v3, b2, b3\n"
+                     "b2:\n"
+                     "    v4 i64 = const 1\n"
+                     "    v5 i64 = sub v1, v4\n"
+                     "    jump b1(v5)\n"
+                     "b3:\n"
+                     "    return v0\n"
+                     "}\n"),
+    },
+    {
+        .id    = 5,
+        .label = STR("commutative operands"),
+        .level = ol_Full,
+        .input = STR("fn f(a: i64, b: i64) => i64 {\n    return a * b + b * a\n}\n"),
+        .want  = STR("fn f(i64, i64) => i64 {\n"
+                     "b0(v0 i64, v1 i64):\n"
+                     "    v2 i64 = mul v0, v1\n"
+                     "    v3 i64 = add v2, v2\n"
+                     "    return v3\n"
+                     "}\n"),
+    },
+    {
+        .id    = 6,
+        .label = STR("division by variable stays in loop"),
+        .level = ol_Full,
+        .input = STR("fn f(a: i64, b: i64) => (q: i64, r: i64) {\n    loop 10 {\n        q = a / b\n        r = a % 3\n"
+                     "    }\n    return\n}\n"),
+        .want  = STR("fn f(i64, i64) => (i64, i64) {\n"
+                     "b0(v0 i64, v1 i64):\n"
+                     "    v2 i64 = const 0\n"
+                     "    v3 i64 = const 10\n"
+                     "    v4 i64 = const 1\n"
+                     "    v5 i64 = const 3\n"
+                     "    v6 i64 = rem v0, v5\n"
+                     "    jump b1(v3, v2, v2)\n"
+                     "b1(v7 i64, v8 i64, v9 i64):\n"
+                     "    v10 bool = gt v7, v2\n"
+                     "    branch v10, b2, b3\n"
+                     "b2:\n"
+                     "    v11 i64 = sub v7, v4\n"
+                     "    v12 i64 = div v0, v1\n"
+                     "    jump b1(v11, v12, v6)\n"
+                     "b3:\n"
+                     "    return v8, v9\n"
+                     "}\n"),
+    },
+};
+
+const u64 test_ir_buffer_cap = 1 << 16;
+
+const str pass_str = STR("    opt_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+void print_failed_test_case(OptTestCase test_case, str got) {
+    str id_str = format_u64_as_decimal(test_case.id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(test_case.want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+// optimize_test_input returns dump of the last function or first problem
+// found by verifier
+str optimize_test_input(const TypeTable *table, const StandaloneSourceTree *tree, OptLevel level) {
+    LowerResult result = lower_standalone_source_tree(table, tree);
+    optimize_ir_module(&result.module, level, empty_str);
+
+    str got = empty_str;
+    for (u32 i = 0; i < result.module.functions_len && got.len == 0; i++) {
+        got = verify_ir_function(&result.module, &result.module.functions[i]);
+    }
+    if (got.len == 0) {
+        OutputBuffer out = new_output_buffer(-1, test_ir_buffer_cap);
+        write_ir_function(&out, &result.module, &result.module.functions[result.module.functions_len - 1]);
+        got = new_str_from_bytes(out.bytes, out.len);
+        free_output_buffer(&out);
+    }
+    free_slice_of_LowerErrors(result.errors);
+    free_ir_module(&result.module);
+    return got;
+}
+
+bool run_test_case(OptTestCase test_case) {
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(test_case.input);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult check_result       = check_standalone_source_tree(&table, &parse_result.tree);
+    FoldResult fold_result             = fold_standalone_source_tree(&table, &parse_result.tree);
+
+    str got     = optimize_test_input(&table, &parse_result.tree, test_case.level);
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || check_result.errors.len != 0 ||
+                  fold_result.errors.len != 0 || !are_strs_equal(got, test_case.want);
+    if (failed) {
+        print_failed_test_case(test_case, got);
+    }
+
+    free_str(got);
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(check_result.errors);
+    free_slice_of_TypeErrors(fold_result.errors);
+    free_type_table(&table);
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
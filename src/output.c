@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "fatal.h"
+#include "output.h"
+
+const u64 default_output_buffer_cap = 1 << 18;
+
+// max length of u64 in decimal notation
+const u64 max_output_decimal_length = 20;
+
+// init_output_buffer creates buffer which uses given memory, it must
+// be valid until buffer is not used anymore
+OutputBuffer init_output_buffer(int fd, byte *bytes, u64 cap) {
+    OutputBuffer out = {
+        .bytes    = bytes,
+        .len      = 0,
+        .cap      = cap,
+        .fd       = fd,
+        .is_owner = false,
+        .failed   = false,
+    };
+    return out;
+}
+
+OutputBuffer new_output_buffer(int fd, u64 cap) {
+    byte *bytes = (byte *)alloc_mem(at_Other, cap);
+    if (bytes == nil) {
+        fatal(1, "not enough memory for output buffer");
+    }
+    OutputBuffer out = init_output_buffer(fd, bytes, cap);
+    out.is_owner     = true;
+    return out;
+}
+
+// write_all_bytes writes bytes to file descriptor retrying partial and
+// interrupted writes
+bool write_all_bytes(int fd, const byte *bytes, u64 len) {
+    while (len > 0) {
+        ssize_t n = write(fd, bytes, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += n;
+        len -= (u64)n;
+    }
+    return true;
+}
+
+// flush_output writes all buffered bytes, returns false if any write
+// to this buffer has failed
+bool flush_output(OutputBuffer *out) {
+    if (out->len != 0 && !out->failed) {
+        out->failed = !write_all_bytes(out->fd, out->bytes, out->len);
+    }
+    out->len = 0;
+    return !out->failed;
+}
+
+void free_output_buffer(OutputBuffer *out) {
+    if (out->is_owner) {
+        free_mem(out->bytes);
+    }
+    out->bytes = nil;
+    out->len   = 0;
+    out->cap   = 0;
+}
+
+void write_bytes_to_output(OutputBuffer *out, const byte *bytes, u64 len) {
+    if (out->len + len <= out->cap) {
+        memcpy(out->bytes + out->len, bytes, len);
+        out->len += len;
+        return;
+    }
+
+    flush_output(out);
+    if (len >= out->cap) {
+        // copying large chunks through buffer gives no benefit
+        if (!out->failed) {
+            out->failed = !write_all_bytes(out->fd, bytes, len);
+        }
+        return;
+    }
+    memcpy(out->bytes, bytes, len);
+    out->len = len;
+}
+
+void write_str_to_output(OutputBuffer *out, str s) {
+    write_bytes_to_output(out, s.bytes, s.len);
+}
+
+void write_byte_to_output(OutputBuffer *out, byte b) {
+    if (out->len == out->cap) {
+        flush_output(out);
+    }
+    out->bytes[out->len] = b;
+    out->len++;
+}
+
+void write_spaces_to_output(OutputBuffer *out, u64 n) {
+    while (n > 0) {
+        if (out->len == out->cap) {
+            flush_output(out);
+        }
+        u64 chunk = out->cap - out->len;
+        if (chunk > n) {
+            chunk = n;
+        }
+        memset(out->bytes + out->len, ' ', chunk);
+        out->len += chunk;
+        n -= chunk;
+    }
+}
+
+void write_indent_str_to_output(OutputBuffer *out, u64 spaces, str s) {
+    write_spaces_to_output(out, spaces);
+    write_str_to_output(out, s);
+}
+
+void write_line_str_to_output(OutputBuffer *out, str s) {
+    write_str_to_output(out, s);
+    write_byte_to_output(out, '\n');
+}
+
+u64 count_decimal_digits(u64 n) {
+    u64 len = 1;
+    for (; n >= 10; n /= 10) {
+        len++;
+    }
+    return len;
+}
+
+// write_u64_to_output writes number in decimal notation, digits are
+// generated in place from the end without intermediate strings
+void write_u64_to_output(OutputBuffer *out, u64 n) {
+    u64 len = count_decimal_digits(n);
+    if (out->cap - out->len < max_output_decimal_length) {
+        flush_output(out);
+    }
+
+    byte *digits = out->bytes + out->len;
+    for (u64 i = len; i > 0; i--) {
+        digits[i - 1] = (byte)('0' + n % 10);
+        n /= 10;
+    }
+    out->len += len;
+}
@@ -0,0 +1,44 @@
+#ifndef KU_OUTPUT_H
+#define KU_OUTPUT_H
+
+#include "str.h"
+#include "types.h"
+
+typedef struct OutputBuffer OutputBuffer;
+
+// OutputBuffer accumulates bytes in user space memory and writes them to file
+// descriptor with write(2) only when buffer is full or flushed explicitly
+struct OutputBuffer {
+    byte *bytes;
+
+    // number of bytes waiting to be written
+    u64 len;
+
+    u64 cap;
+
+    int fd;
+
+    // true if buffer memory is allocated by new_output_buffer
+    bool is_owner;
+
+    // set after first failed write, further output is discarded
+    bool failed;
+};
+
+// default capacity for buffers which dump large amounts of text
+extern const u64 default_output_buffer_cap;
+
+OutputBuffer init_output_buffer(int fd, byte *bytes, u64 cap);
+OutputBuffer new_output_buffer(int fd, u64 cap);
+bool flush_output(OutputBuffer *out);
+void free_output_buffer(OutputBuffer *out);
+void write_bytes_to_output(OutputBuffer *out, const byte *bytes, u64 len);
+void write_str_to_output(OutputBuffer *out, str s);
+void write_byte_to_output(OutputBuffer *out, byte b);
+void write_spaces_to_output(OutputBuffer *out, u64 n);
+void write_indent_str_to_output(OutputBuffer *out, u64 spaces, str s);
+void write_line_str_to_output(OutputBuffer *out, str s);
+void write_u64_to_output(OutputBuffer *out, u64 n);
+u64 count_decimal_digits(u64 n);
+
+#endif // KU_OUTPUT_H
@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "parser.h"
+#include "xnew.h"
 
 #define ENABLE_DEBUG 0
 #include "debug.h"
@@ -8,14 +9,22 @@
 const u8 parser_buffer_size = 2;
 
 TypeSpecifier parse_type_specifier(Parser *p);
+void terminate_parser(Parser *p, char *error_text);
 
 Token get_next_token(Parser *p) {
     Token token;
     if (p->prefetched) {
         p->prefetched = false;
         token         = p->prefetched_token;
+    } else if (p->scanner == nil) {
+        // array always ends with EOF token which is repeated past the end
+        token = p->tokens[p->tokens_pos];
+        if (p->tokens_pos + 1 < p->tokens_len) {
+            p->tokens_pos++;
+        }
     } else {
         token = scan_token(p->scanner);
+        p->scanned_tokens++;
         DEBUG(print_token(token);)
     }
     return token;
@@ -46,78 +55,334 @@ void parse_comments(Parser *p) {
     } while (p->token.type == tt_Comment);
 }
 
-Expression parse_expression(Parser *p) {
+Expression parse_expression(Parser *p);
+
+Expression parse_call_expression(Parser *p) {
+    Token name_token = p->token;
+
+    advance_parser(p); // consume identifier token
+    advance_parser(p); // consume "(" token
+
+    slice_of_Expressions args = init_empty_slice_of_Expressions();
+    while (p->token.type != tt_RightRoundBracket) {
+        append_Expression_to_slice(&args, parse_expression(p));
+        if (p->token.type == tt_Comma) {
+            advance_parser(p);
+        } else if (p->token.type != tt_RightRoundBracket) {
+            terminate_parser(p, "\")\" expected");
+        }
+    }
+
+    advance_parser(p); // consume ")" token
+
+    DEBUG(printf("call expression\n");)
+    return init_call_expression(name_token, args);
+}
+
+Expression parse_primary_expression(Parser *p) {
     Expression expr;
-    if (p->token.type == tt_Identifier) {
+    switch (p->token.type) {
+    case tt_Identifier:
+        if (p->next_token.type == tt_LeftRoundBracket) {
+            return parse_call_expression(p);
+        }
         expr = init_identifier_expression(p->token);
         advance_parser(p);
         DEBUG(printf("identifier expression\n");)
         return expr;
-    }
-    if (p->token.type == tt_DecimalInteger) {
+    case tt_BinaryInteger:
+    case tt_OctalInteger:
+    case tt_DecimalInteger:
+    case tt_HexadecimalInteger:
         expr = init_integer_expression(p->token);
         advance_parser(p);
         DEBUG(printf("integer expression\n");)
         return expr;
-    }
-    if (p->token.type == tt_String) {
+    case tt_DecimalFloat:
+        expr = init_float_expression(p->token);
+        advance_parser(p);
+        DEBUG(printf("float expression\n");)
+        return expr;
+    case tt_String:
         expr = init_string_expression(p->token);
         advance_parser(p);
         DEBUG(printf("string expression\n");)
         return expr;
+    case tt_LeftRoundBracket:
+        advance_parser(p); // consume "(" token
+        expr = parse_expression(p);
+        if (p->token.type != tt_RightRoundBracket) {
+            terminate_parser(p, "\")\" expected");
+        }
+        advance_parser(p); // consume ")" token
+        return expr;
+    case tt_Plus:
+    case tt_Minus:
+    case tt_Not:
+    case tt_Caret: {
+        Token operator = p->token;
+        advance_parser(p);
+        DEBUG(printf("unary expression\n");)
+        return init_unary_expression(operator, parse_primary_expression(p));
+    }
+    default:
+        terminate_parser(p, "unexpected token inside expression");
     }
-    return parse_expression(p);
+    return empty_expression; // non-reachable statement, avoids compiler warning
 }
 
-Statement parse_define_statement(Parser *p) {
-    slice_of_Expressions left = init_empty_slice_of_Expressions();
-    append_Expression_to_slice(&left, parse_expression(p));
+// get_binary_precedence returns 0 for tokens which are not binary operators,
+// bigger number means that operator binds stronger
+u8 get_binary_precedence(TokenType type) {
+    switch (type) {
+    case tt_Asterisk:
+    case tt_Slash:
+    case tt_Percent:
+    case tt_LeftShift:
+    case tt_RightShift:
+    case tt_Ampersand:
+    case tt_BitwiseAndNot:
+        return 5;
+    case tt_Plus:
+    case tt_Minus:
+    case tt_Pipe:
+    case tt_Caret:
+        return 4;
+    case tt_Equal:
+    case tt_NotEqual:
+    case tt_Less:
+    case tt_LessOrEqual:
+    case tt_Greater:
+    case tt_GreaterOrEqual:
+        return 3;
+    case tt_LogicalAnd:
+        return 2;
+    case tt_LogicalOr:
+        return 1;
+    default:
+        return 0;
+    }
+}
 
-    advance_parser(p); // consume ":=" token
+// parse_binary_expression uses precedence climbing, only operators which
+// bind stronger than min_precedence are consumed
+Expression parse_binary_expression(Parser *p, u8 min_precedence) {
+    Expression left = parse_primary_expression(p);
+    u8 precedence   = get_binary_precedence(p->token.type);
+    while (precedence > min_precedence) {
+        Token operator = p->token;
+        advance_parser(p);
+        Expression right = parse_binary_expression(p, precedence);
+        left             = init_binary_expression(operator, left, right);
+        precedence       = get_binary_precedence(p->token.type);
+    }
+    return left;
+}
 
-    slice_of_Expressions right = init_empty_slice_of_Expressions();
-    append_Expression_to_slice(&right, parse_expression(p));
+Expression parse_expression(Parser *p) {
+    return parse_binary_expression(p, 0);
+}
 
-    advance_parser(p); // consume ";" token
+slice_of_Expressions parse_expression_list(Parser *p) {
+    slice_of_Expressions exprs = init_empty_slice_of_Expressions();
+    append_Expression_to_slice(&exprs, parse_expression(p));
+    while (p->token.type == tt_Comma) {
+        advance_parser(p); // consume "," token
+        append_Expression_to_slice(&exprs, parse_expression(p));
+    }
+    return exprs;
+}
 
-    DEBUG(printf("define statement\n");)
-    return init_define_statement(left, right);
+bool is_assign_operator(TokenType type) {
+    switch (type) {
+    case tt_Assign:
+    case tt_AddAssign:
+    case tt_SubtractAssign:
+    case tt_MultiplyAssign:
+    case tt_QuotientAssign:
+    case tt_RemainderAssign:
+        return true;
+    default:
+        return false;
+    }
 }
 
-Statement parse_call_statement(Parser *p) {
-    Token name_token = p->token;
+// parse_statement_end consumes terminator of simple statement, statement
+// may also be ended by closing bracket of enclosing block
+void parse_statement_end(Parser *p) {
+    switch (p->token.type) {
+    case tt_Terminator:
+    case tt_Semicolon:
+        advance_parser(p);
+        return;
+    case tt_RightCurlyBracket:
+    case tt_EOF:
+        return;
+    default:
+        terminate_parser(p, "unexpected token at the end of statement");
+    }
+}
 
-    advance_parser(p); // consume identifier token
-    advance_parser(p); // consume "(" token
+// parse_define_or_assign_statement parses statements which start with list
+// of names, e.g. "a, b := 1, 2" or "a, b = b, a"
+Statement parse_define_or_assign_statement(Parser *p) {
+    slice_of_Expressions left = parse_expression_list(p);
 
-    slice_of_Expressions args = init_empty_slice_of_Expressions();
+    Token operator = p->token;
+    if (operator.type != tt_Define && !is_assign_operator(operator.type)) {
+        terminate_parser(p, "\":=\" or assignment operator expected");
+    }
+    advance_parser(p); // consume ":=" or assignment operator token
 
-    append_Expression_to_slice(&args, parse_expression(p));
+    slice_of_Expressions right = parse_expression_list(p);
+    parse_statement_end(p);
 
-    advance_parser(p); // consume ")" token
-    advance_parser(p); // consume ";" token
+    if (operator.type == tt_Define) {
+        DEBUG(printf("define statement\n");)
+        return init_define_statement(left, right);
+    }
+    DEBUG(printf("assign statement\n");)
+    return init_assign_statement(operator, left, right);
+}
+
+Statement parse_call_statement(Parser *p) {
+    Expression call = parse_call_expression(p);
+    parse_statement_end(p);
 
     DEBUG(printf("call statement\n");)
-    return init_expression_statement(init_call_expression(name_token, args));
+    return init_expression_statement(call);
+}
+
+BlockStatement parse_block_statement(Parser *p);
+
+Statement parse_return_statement(Parser *p) {
+    Token token = p->token;
+    advance_parser(p); // consume "return" token
+
+    slice_of_Expressions values = empty_slice_of_Expressions;
+    if (p->token.type != tt_Terminator && p->token.type != tt_Semicolon && p->token.type != tt_RightCurlyBracket) {
+        values = parse_expression_list(p);
+    }
+    parse_statement_end(p);
+
+    DEBUG(printf("return statement\n");)
+    return init_return_statement(token, values);
+}
+
+BlockStatement parse_body_block(Parser *p) {
+    if (p->token.type != tt_LeftCurlyBracket) {
+        terminate_parser(p, "\"{\" expected");
+    }
+    return parse_block_statement(p);
+}
+
+Statement parse_if_statement(Parser *p) {
+    slice_of_IfClauses clauses = empty_slice_of_IfClauses;
+    BlockStatement *else_body  = nil;
+    do {
+        advance_parser(p); // consume "if" or "elif" token
+        IfClause clause = {
+            .condition = parse_expression(p),
+        };
+        clause.body = parse_body_block(p);
+        append_IfClause_to_slice(&clauses, clause);
+    } while (p->token.type == tt_ElseIf);
+
+    if (p->token.type == tt_Else) {
+        advance_parser(p); // consume "else" token
+        else_body  = xnew(at_AST, BlockStatement);
+        *else_body = parse_body_block(p);
+    }
+
+    DEBUG(printf("if statement\n");)
+    return init_if_statement(clauses, else_body);
+}
+
+Statement parse_loop_statement(Parser *p) {
+    Token token = p->token;
+    advance_parser(p); // consume "loop" token
+
+    Expression count = empty_expression;
+    if (p->token.type != tt_LeftCurlyBracket) {
+        count = parse_expression(p);
+    }
+    BlockStatement body = parse_body_block(p);
+
+    DEBUG(printf("loop statement\n");)
+    return init_loop_statement(token, count, body);
+}
+
+Statement parse_while_statement(Parser *p) {
+    advance_parser(p); // consume "while" token
+
+    Expression condition = parse_expression(p);
+    BlockStatement body  = parse_body_block(p);
+
+    DEBUG(printf("while statement\n");)
+    return init_while_statement(condition, body);
+}
+
+// parse_increment_statement parses "x++" and "x--" as compound assignment
+// of constant 1, so that later phases do not need a separate statement
+Statement parse_increment_statement(Parser *p) {
+    slice_of_Expressions left = init_empty_slice_of_Expressions();
+    append_Expression_to_slice(&left, init_identifier_expression(p->token));
+    advance_parser(p); // consume identifier token
+
+    Token operator = {
+        .type = p->token.type == tt_Increment ? tt_AddAssign : tt_SubtractAssign,
+        .pos  = p->token.pos,
+    };
+    Token one = {
+        .type          = tt_DecimalInteger,
+        .pos           = p->token.pos,
+        .literal       = STR("1"),
+        .value.integer = 1,
+    };
+    advance_parser(p); // consume "++" or "--" token
+    parse_statement_end(p);
+
+    slice_of_Expressions right = init_empty_slice_of_Expressions();
+    append_Expression_to_slice(&right, init_integer_expression(one));
+
+    DEBUG(printf("increment statement\n");)
+    return init_assign_statement(operator, left, right);
 }
 
 Statement parse_statement(Parser *p) {
     switch (p->token.type) {
     case tt_Identifier:
-        if (p->next_token.type == tt_Define) {
-            return parse_define_statement(p);
+        if (p->next_token.type == tt_Define || p->next_token.type == tt_Comma ||
+            is_assign_operator(p->next_token.type)) {
+            return parse_define_or_assign_statement(p);
         }
         if (p->next_token.type == tt_LeftRoundBracket) {
             return parse_call_statement(p);
         }
+        if (p->next_token.type == tt_Increment || p->next_token.type == tt_Decrement) {
+            return parse_increment_statement(p);
+        }
+        advance_parser(p); // report token which follows identifier
+        terminate_parser(p, "unexpected token after identifier in statement");
         break;
+    case tt_Return:
+        return parse_return_statement(p);
+    case tt_If:
+        return parse_if_statement(p);
+    case tt_Loop:
+        return parse_loop_statement(p);
+    case tt_While:
+        return parse_while_statement(p);
+    case tt_Terminator:
+    case tt_Semicolon:
+    case tt_Comment:
+        advance_parser(p);
+        DEBUG(printf("empty statement\n");)
+        return init_empty_statement();
     default:
-        break;
+        terminate_parser(p, "unexpected token at the start of statement");
     }
-    advance_parser(p);
-
-    DEBUG(printf("empty statement\n");)
-    return init_empty_statement();
+    return init_empty_statement(); // non-reachable statement, avoids compiler warning
 }
 
 slice_of_Statements parse_source(SourceText source) {
@@ -143,6 +408,14 @@ slice_of_Statements parse(Parser *p) {
 }
 
 void terminate_parser(Parser *p, char *error_text) {
+    p->error = (ParseError){
+        .text  = error_text,
+        .token = p->token,
+    };
+    if (p->recover != nil) {
+        longjmp(*p->recover, 1);
+    }
+
     fwrite(error_text, 1, strlen(error_text), stdout);
     println();
     print_token(p->token);
@@ -158,6 +431,25 @@ TypeSpecifier parse_indexed_type_specifier(Parser *p) {
     return new_slice_type_specifier(parse_type_specifier(p));
 }
 
+TypeSpecifier parse_map_type_specifier(Parser *p) {
+    advance_parser(p); // skip "map"
+    if (p->token.type != tt_LeftSquareBracket) {
+        terminate_parser(p, "\"[\" expected");
+    }
+    advance_parser(p); // skip "["
+    TypeSpecifier key_type_specifier = parse_type_specifier(p);
+    if (p->token.type != tt_RightArrow) {
+        terminate_parser(p, "\"=>\" expected");
+    }
+    advance_parser(p); // skip "=>"
+    TypeSpecifier value_type_specifier = parse_type_specifier(p);
+    if (p->token.type != tt_RightSquareBracket) {
+        terminate_parser(p, "\"]\" expected");
+    }
+    advance_parser(p); // skip "]"
+    return new_map_type_specifier(key_type_specifier, value_type_specifier);
+}
+
 TypeSpecifier parse_name_type_specifier(Parser *p) {
     TypeSpecifier type_specifier = new_name_type_specifier(p->token);
     advance_parser(p); // consume type name
@@ -173,6 +465,8 @@ TypeSpecifier parse_type_specifier(Parser *p) {
         break;
     case tt_LeftSquareBracket:
         return parse_indexed_type_specifier(p);
+    case tt_Map:
+        return parse_map_type_specifier(p);
     case tt_Struct:
         terminate_parser(p, "struct type specifiers are not implemented");
         break;
@@ -361,6 +655,7 @@ void parse_function_definition(Parser *p) {
     FunctionDefinition definition = {
         .declaration = declaration,
         .body        = body,
+        .locals      = 0,
     };
     append_FunctionDefinition_to_slice(&p->source_tree.functions, definition);
 }
@@ -384,26 +679,85 @@ void init_parser_buffer(Parser *p) {
     }
 }
 
+// try_parse_top_level parses one top level declaration, returns false if
+// parsing was stopped by syntax error which is stored in parser
+bool try_parse_top_level(Parser *p) {
+    jmp_buf recover;
+    p->recover = &recover;
+    if (setjmp(recover) != 0) {
+        p->recover = nil;
+        return false;
+    }
+    parse_top_level(p);
+    p->recover = nil;
+    return true;
+}
+
+// parse_standalone stops at first syntax error, in that case result holds
+// the error and declarations parsed before it
 StandaloneParseResult parse_standalone(Parser *p) {
     StandaloneParseResult result = {
-        .ok = false,
+        .ok = true,
     };
-    result.tree = empty_standalone_source_tree;
-
-    while (p->token.type != tt_EOF) {
-        parse_top_level(p);
+    while (p->token.type != tt_EOF && result.ok) {
+        result.ok = try_parse_top_level(p);
+    }
+    if (!result.ok) {
+        result.error = p->error;
     }
-    print_standalone_source_tree(p->source_tree);
+    result.tree   = p->source_tree;
+    result.tokens = p->scanned_tokens;
     return result;
 }
 
 StandaloneParseResult parse_standalone_source_from_str(str s) {
     Scanner scanner = init_scanner_from_str(s);
     Parser parser   = {
+        .prefetched     = false,
+        .source_tree    = empty_standalone_source_tree,
+        .scanner        = &scanner,
+        .scanned_tokens = 0,
+    };
+    init_parser_buffer(&parser);
+    return parse_standalone(&parser);
+}
+
+Parser init_parser_from_tokens(const Token *tokens, u32 len, u32 start) {
+    Parser parser = {
         .prefetched  = false,
         .source_tree = empty_standalone_source_tree,
-        .scanner     = &scanner,
+        .scanner     = nil,
+        .tokens      = tokens,
+        .tokens_len  = len,
+        .tokens_pos  = start,
     };
     init_parser_buffer(&parser);
-    return parse_standalone(&parser);
+    return parser;
+}
+
+// move_parser_to_token continues parsing from token with given index, valid
+// only for parsers created from tokens
+void move_parser_to_token(Parser *p, u32 index) {
+    p->prefetched = false;
+    p->tokens_pos = index;
+    init_parser_buffer(p);
+}
+
+// get_parser_token_index returns index of current parser token inside
+// token array, valid only for parsers created from tokens
+u32 get_parser_token_index(const Parser *p) {
+    if (p->token.type == tt_EOF) {
+        return p->tokens_len - 1;
+    }
+    if (p->next_token.type == tt_EOF) {
+        return p->tokens_len - 2;
+    }
+    if (!p->prefetched) {
+        return p->tokens_pos - parser_buffer_size;
+    }
+    // token after the next one was already taken from array
+    if (p->prefetched_token.type == tt_EOF) {
+        return p->tokens_len - 3;
+    }
+    return p->tokens_pos - parser_buffer_size - 1;
 }
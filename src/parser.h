@@ -1,16 +1,34 @@
 #ifndef KU_PARSER_H
 #define KU_PARSER_H
 
+#include <setjmp.h>
+
 #include "ast.h"
 #include "scanner.h"
 #include "source.h"
 
 typedef struct Parser Parser;
+typedef struct ParseError ParseError;
 typedef struct StandaloneParseResult StandaloneParseResult;
 
+// ParseError describes syntax error which stopped parsing
+struct ParseError {
+    const char *text;
+
+    // token at which error was detected
+    Token token;
+};
+
 struct StandaloneParseResult {
+    // false when parsing was stopped by syntax error
     bool ok;
     StandaloneSourceTree tree;
+
+    // valid only if ok is false
+    ParseError error;
+
+    // number of tokens obtained from scanner during parsing
+    u64 tokens;
 };
 
 struct Parser {
@@ -27,7 +45,22 @@ struct Parser {
 
     StandaloneSourceTree source_tree;
 
+    // Parser reads tokens from scanner if it is not nil,
+    // otherwise tokens are taken from pre-scanned array
     Scanner *scanner;
+
+    // number of tokens obtained from scanner
+    u64 scanned_tokens;
+
+    const Token *tokens;
+    u32 tokens_len;
+    u32 tokens_pos;
+
+    // Parser jumps here on syntax error after recording it in error field,
+    // when nil error is printed and process exits
+    jmp_buf *recover;
+
+    ParseError error;
 };
 
 slice_of_Statements parse_str(str s);
@@ -37,4 +70,10 @@ slice_of_Statements parse_file(char *path);
 StandaloneParseResult parse_standalone_source_from_str(str s);
 slice_of_Statements parse(Parser *p);
 
+Parser init_parser_from_tokens(const Token *tokens, u32 len, u32 start);
+void move_parser_to_token(Parser *p, u32 index);
+u32 get_parser_token_index(const Parser *p);
+void parse_top_level(Parser *p);
+bool try_parse_top_level(Parser *p);
+
 #endif // KU_PARSER_H
@@ -1,30 +1,67 @@
+#include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "alloc.h"
 #include "fatal.h"
 #include "path.h"
 
-u64 clean_path_bytes_in_place(byte *bytes, u64 size) {
-    u64 pos       = 0;
-    int prev_code = -1;
-    for (u64 i = 0; i < size; i++) {
-        byte b = bytes[i];
-        if (prev_code == b) {
-        } else {
-            pos++; // test
-        }
-        prev_code = b;
+// clean_path_bytes_to_dest writes shortest path equivalent to given one by purely lexical processing:
+//
+//  1. Replace multiple slashes with a single slash
+//  2. Eliminate each "." path name element
+//  3. Eliminate each inner ".." path name element along with the non-".." element that precedes it
+//  4. Eliminate ".." elements that begin a rooted path
+//
+// Returns length of written path, which is never greater than size. Empty result means "."
+u64 clean_path_bytes_to_dest(const byte *bytes, byte *dest, u64 size) {
+    bool rooted = size > 0 && bytes[0] == '/';
+    u64 r       = 0; // next byte to process
+    u64 w       = 0; // next byte to write
+    u64 dotdot  = 0; // position where ".." elements can no longer be eliminated
+    if (rooted) {
+        dest[w] = '/';
+        w++;
+        r      = 1;
+        dotdot = 1;
     }
-    return pos;
-}
 
-u64 clean_path_bytes_to_dest(const byte *bytes, byte *dest, u64 size) {
-    u64 pos = 0;
-    for (u64 i = 0; i < size; i++) {
-        dest[i] = bytes[i];
-        pos++;
+    while (r < size) {
+        if (bytes[r] == '/') {
+            r++;
+        } else if (bytes[r] == '.' && (r + 1 == size || bytes[r + 1] == '/')) {
+            r++;
+        } else if (bytes[r] == '.' && bytes[r + 1] == '.' && (r + 2 == size || bytes[r + 2] == '/')) {
+            r += 2;
+            if (w > dotdot) {
+                // backtrack to previous slash
+                w--;
+                while (w > dotdot && dest[w] != '/') {
+                    w--;
+                }
+            } else if (!rooted) {
+                if (w > 0) {
+                    dest[w] = '/';
+                    w++;
+                }
+                dest[w]     = '.';
+                dest[w + 1] = '.';
+                w += 2;
+                dotdot = w;
+            }
+        } else {
+            if ((rooted && w != 1) || (!rooted && w != 0)) {
+                dest[w] = '/';
+                w++;
+            }
+            for (; r < size && bytes[r] != '/'; r++) {
+                dest[w] = bytes[r];
+                w++;
+            }
+        }
     }
-    return pos;
+    return w;
 }
 
 str new_clean_path_from_bytes(const byte *bytes, u64 size) {
@@ -34,13 +71,17 @@ str new_clean_path_from_bytes(const byte *bytes, u64 size) {
         return new_str_from_byte(bytes[0]);
     }
 
-    byte *new_bytes = (byte *)malloc(size);
+    byte *new_bytes = (byte *)alloc_mem(at_String, size);
     if (new_bytes == nil) {
         fatal(1, "not enough memory for new path");
     }
 
     u64 len = clean_path_bytes_to_dest(bytes, new_bytes, size);
-    str s   = {
+    if (len == 0) {
+        free_mem(new_bytes);
+        return new_str_from_byte('.');
+    }
+    str s = {
         .origin = new_bytes,
         .bytes  = new_bytes,
         .len    = len,
@@ -59,3 +100,82 @@ str new_clean_path_from_str(str s) {
 void free_path(Path path) {
     free_str(path.path);
 }
+
+str new_joined_path(str dir, str name) {
+    u64 size    = dir.len + 1 + name.len;
+    byte *bytes = (byte *)alloc_mem(at_String, size);
+    if (bytes == nil) {
+        fatal(1, "not enough memory for new path");
+    }
+    memcpy(bytes, dir.bytes, dir.len);
+    bytes[dir.len] = '/';
+    memcpy(bytes + dir.len + 1, name.bytes, name.len);
+
+    str path = new_clean_path_from_bytes(bytes, size);
+    free_mem(bytes);
+    return path;
+}
+
+bool is_dir_path(str path) {
+    char *cstr = str_to_cstr(path);
+    struct stat path_stat;
+    int code = stat(cstr, &path_stat);
+    free_mem(cstr);
+    return code == 0 && S_ISDIR(path_stat.st_mode);
+}
+
+int compare_strs(const void *a, const void *b) {
+    str s1  = *(const str *)a;
+    str s2  = *(const str *)b;
+    u64 len = s1.len < s2.len ? s1.len : s2.len;
+    int c   = memcmp(s1.bytes, s2.bytes, len);
+    if (c != 0) {
+        return c;
+    }
+    if (s1.len == s2.len) {
+        return 0;
+    }
+    return s1.len < s2.len ? -1 : 1;
+}
+
+// append_dir_files_with_ext recursively walks directory and appends paths of all regular
+// files with given extension to the list. Entries of each directory are visited in
+// lexicographic order, so resulting list does not depend on file system. Returns
+// false if directory cannot be opened
+bool append_dir_files_with_ext(str dir, str ext, slice_of_strs *files) {
+    char *cstr = str_to_cstr(dir);
+    DIR *d     = opendir(cstr);
+    free_mem(cstr);
+    if (d == nil) {
+        return false;
+    }
+
+    slice_of_strs names  = empty_slice_of_strs;
+    struct dirent *entry = readdir(d);
+    while (entry != nil) {
+        str name = borrow_str_from_bytes((byte *)entry->d_name, strlen(entry->d_name));
+        if (name.len != 0 && name.bytes[0] != '.') {
+            append_str_to_slice(&names, new_str_from_str(name));
+        }
+        entry = readdir(d);
+    }
+    closedir(d);
+
+    if (names.len != 0) {
+        qsort(names.elem, names.len, sizeof(str), compare_strs);
+    }
+    for (u32 i = 0; i < names.len; i++) {
+        str path = new_joined_path(dir, names.elem[i]);
+        if (is_dir_path(path)) {
+            append_dir_files_with_ext(path, ext, files);
+            free_str(path);
+        } else if (path.len > ext.len && has_substr_at(path, ext, path.len - ext.len)) {
+            append_str_to_slice(files, path);
+        } else {
+            free_str(path);
+        }
+        free_str(names.elem[i]);
+    }
+    free_slice_of_strs(names);
+    return true;
+}
@@ -2,6 +2,7 @@
 #define KU_PATH_H
 
 #include "str.h"
+#include "strop.h"
 #include "types.h"
 
 typedef struct Path Path;
@@ -19,6 +20,9 @@ str new_clean_path_from_cstr(const char *cstr);
 str new_clean_path_from_str(str s);
 Path borrow_path_from_str(str dirty_path);
 Path take_path_from_cstr(char* cstr);
+str new_joined_path(str dir, str name);
+bool is_dir_path(str path);
+bool append_dir_files_with_ext(str dir, str ext, slice_of_strs *files);
 void free_path(Path path);
 
 #endif // KU_PATH_H
@@ -0,0 +1,368 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "fatal.h"
+#include "pool.h"
+#include "str.h"
+#include "trace.h"
+
+const char *worker_count_env_name = "CCKU_THREADS";
+
+const i64 initial_task_array_cap = 1 << 6;
+
+// number of range chunks per worker created by parallel_for when grain is not specified
+const u64 range_chunks_per_worker = 8;
+
+// number of unsuccessful attempts to find a task before idle worker goes to sleep
+const u32 max_idle_spins = 1 << 6;
+
+_Thread_local WorkerPool *current_pool = nil;
+_Thread_local u32 current_worker       = 0;
+
+u32 get_online_cpu_count() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) {
+        return 1;
+    }
+    return (u32)n;
+}
+
+// get_default_worker_count returns number of workers specified by environment
+// variable or number of online CPUs if variable is absent or invalid
+u32 get_default_worker_count() {
+    char *value = getenv(worker_count_env_name);
+    if (value == nil) {
+        return get_online_cpu_count();
+    }
+    U32ParseResult res = parse_u32_from_decimal(take_str_from_cstr(value));
+    if (!res.ok || res.num == 0) {
+        return get_online_cpu_count();
+    }
+    return res.num;
+}
+
+TaskArray *new_task_array(i64 cap) {
+    TaskArray *a = (TaskArray *)alloc_mem(at_Other, sizeof(TaskArray) + (u64)cap * sizeof(_Atomic(Task *)));
+    if (a == nil) {
+        fatal(1, "not enough memory for new task array");
+    }
+    a->prev = nil;
+    a->cap  = cap;
+    return a;
+}
+
+Task *get_task_array_elem(TaskArray *a, i64 i) {
+    return atomic_load_explicit(&a->elem[i & (a->cap - 1)], memory_order_relaxed);
+}
+
+void put_task_array_elem(TaskArray *a, i64 i, Task *task) {
+    atomic_store_explicit(&a->elem[i & (a->cap - 1)], task, memory_order_relaxed);
+}
+
+TaskArray *grow_task_array(TaskArray *a, i64 bottom, i64 top) {
+    TaskArray *b = new_task_array(a->cap << 1);
+    for (i64 i = top; i < bottom; i++) {
+        put_task_array_elem(b, i, get_task_array_elem(a, i));
+    }
+    b->prev = a;
+    return b;
+}
+
+void init_task_deque(TaskDeque *q) {
+    atomic_init(&q->top, 0);
+    atomic_init(&q->bottom, 0);
+    atomic_init(&q->array, new_task_array(initial_task_array_cap));
+}
+
+void free_task_deque(TaskDeque *q) {
+    TaskArray *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    while (a != nil) {
+        TaskArray *prev = a->prev;
+        free_mem(a);
+        a = prev;
+    }
+}
+
+// push_task must be called only by deque owner
+void push_task(TaskDeque *q, Task *task) {
+    i64 b        = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    i64 t        = atomic_load_explicit(&q->top, memory_order_acquire);
+    TaskArray *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    if (b - t > a->cap - 1) {
+        a = grow_task_array(a, b, t);
+        atomic_store_explicit(&q->array, a, memory_order_release);
+    }
+    put_task_array_elem(a, b, task);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+}
+
+// take_task must be called only by deque owner
+Task *take_task(TaskDeque *q) {
+    i64 b        = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    TaskArray *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+    if (t > b) {
+        // deque is empty
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return nil;
+    }
+
+    Task *task = get_task_array_elem(a, b);
+    if (t == b) {
+        // last task in deque, race against thieves
+        if (!atomic_compare_exchange_strong_explicit(
+                &q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            task = nil;
+        }
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// steal_task may be called by any worker
+Task *steal_task(TaskDeque *q) {
+    i64 t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) {
+        return nil;
+    }
+
+    TaskArray *a = atomic_load_explicit(&q->array, memory_order_acquire);
+    Task *task   = get_task_array_elem(a, t);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return nil;
+    }
+    return task;
+}
+
+u64 next_random(u64 *seed) {
+    u64 x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    return x;
+}
+
+Task *find_task(WorkerPool *pool, WorkerContext *ctx) {
+    Task *task = take_task(&pool->deques[ctx->index]);
+    if (task != nil) {
+        return task;
+    }
+
+    // start from random victim to spread thieves across deques
+    u32 n     = pool->workers;
+    u32 start = (u32)(next_random(&ctx->seed) % n);
+    for (u32 i = 0; i < n; i++) {
+        u32 victim = (start + i) % n;
+        if (victim == ctx->index) {
+            continue;
+        }
+        task = steal_task(&pool->deques[victim]);
+        if (task != nil) {
+            return task;
+        }
+    }
+    return nil;
+}
+
+void execute_task(Task *task) {
+    begin_trace_event("task", empty_str);
+    task->func(task->arg);
+    end_trace_event("task");
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+void wait_for_new_tasks(WorkerPool *pool, u32 epoch) {
+    mtx_lock(&pool->mutex);
+    atomic_fetch_add(&pool->sleeping, 1);
+    if (atomic_load(&pool->epoch) == epoch && !atomic_load(&pool->stop)) {
+        begin_trace_event("sleep", empty_str);
+        cnd_wait(&pool->wakeup, &pool->mutex);
+        end_trace_event("sleep");
+    }
+    atomic_fetch_sub(&pool->sleeping, 1);
+    mtx_unlock(&pool->mutex);
+}
+
+int run_worker(void *arg) {
+    WorkerContext *ctx = (WorkerContext *)arg;
+    WorkerPool *pool   = ctx->pool;
+    current_pool       = pool;
+    current_worker     = ctx->index;
+    name_trace_thread("worker", ctx->index);
+
+    u32 idle = 0;
+    while (!atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+        u32 epoch  = atomic_load(&pool->epoch);
+        Task *task = find_task(pool, ctx);
+        if (task != nil) {
+            execute_task(task);
+            idle = 0;
+            continue;
+        }
+
+        idle++;
+        if (idle < max_idle_spins) {
+            thrd_yield();
+            continue;
+        }
+        idle = 0;
+        wait_for_new_tasks(pool, epoch);
+    }
+    return 0;
+}
+
+WorkerPool *new_worker_pool(u32 workers) {
+    if (workers == 0) {
+        workers = 1;
+    }
+
+    WorkerPool *pool = (WorkerPool *)alloc_mem(at_Other, sizeof(WorkerPool));
+    if (pool == nil) {
+        fatal(1, "not enough memory for new worker pool");
+    }
+    pool->workers = workers;
+
+    u64 deques_size = ((u64)workers * sizeof(TaskDeque) + 63) & ~(u64)63;
+    pool->deques    = (TaskDeque *)aligned_alloc(64, deques_size);
+    pool->contexts  = (WorkerContext *)alloc_mem(at_Other, workers * sizeof(WorkerContext));
+    pool->threads   = (thrd_t *)alloc_mem(at_Other, workers * sizeof(thrd_t));
+    if (pool->deques == nil || pool->contexts == nil || pool->threads == nil) {
+        fatal(1, "not enough memory for new worker pool");
+    }
+
+    atomic_init(&pool->stop, false);
+    atomic_init(&pool->epoch, 0);
+    atomic_init(&pool->sleeping, 0);
+    if (mtx_init(&pool->mutex, mtx_plain) != thrd_success || cnd_init(&pool->wakeup) != thrd_success) {
+        fatal(1, "failed to initialize worker pool");
+    }
+
+    for (u32 i = 0; i < workers; i++) {
+        init_task_deque(&pool->deques[i]);
+        pool->contexts[i].pool  = pool;
+        pool->contexts[i].index = i;
+        pool->contexts[i].seed  = 0x9e3779b97f4a7c15ULL * (i + 1);
+    }
+
+    current_pool   = pool;
+    current_worker = 0;
+    name_trace_thread("worker", 0);
+    for (u32 i = 1; i < workers; i++) {
+        if (thrd_create(&pool->threads[i], run_worker, &pool->contexts[i]) != thrd_success) {
+            fatal(1, "failed to start worker thread");
+        }
+    }
+    return pool;
+}
+
+// spawn_task schedules task for execution, it must be called from one of pool workers
+void spawn_task(WorkerPool *pool, Task *task, TaskFunc func, void *arg) {
+    if (current_pool != pool) {
+        fatal(1, "task spawned outside of worker pool");
+    }
+
+    task->func = func;
+    task->arg  = arg;
+    atomic_store_explicit(&task->done, false, memory_order_relaxed);
+    push_task(&pool->deques[current_worker], task);
+
+    atomic_fetch_add(&pool->epoch, 1);
+    if (atomic_load(&pool->sleeping) > 0) {
+        mtx_lock(&pool->mutex);
+        cnd_signal(&pool->wakeup);
+        mtx_unlock(&pool->mutex);
+    }
+}
+
+// join_task waits until task is done, executing other pending tasks meanwhile.
+// Must be called from one of pool workers
+void join_task(WorkerPool *pool, Task *task) {
+    if (current_pool != pool) {
+        fatal(1, "task joined outside of worker pool");
+    }
+
+    WorkerContext *ctx = &pool->contexts[current_worker];
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        Task *other = find_task(pool, ctx);
+        if (other != nil) {
+            execute_task(other);
+        } else {
+            thrd_yield();
+        }
+    }
+}
+
+void run_range(WorkerPool *pool, u64 start, u64 end, u64 grain, RangeFunc func, void *arg);
+
+void execute_range_task(void *arg) {
+    RangeTask *r = (RangeTask *)arg;
+    run_range(r->pool, r->start, r->end, r->grain, r->func, r->arg);
+}
+
+// run_range recursively splits range in halves, right half is spawned for
+// other workers to steal while current worker descends into left half
+void run_range(WorkerPool *pool, u64 start, u64 end, u64 grain, RangeFunc func, void *arg) {
+    if (end - start <= grain) {
+        func(arg, start, end);
+        return;
+    }
+
+    u64 mid         = start + (end - start) / 2;
+    RangeTask right = {
+        .pool  = pool,
+        .func  = func,
+        .arg   = arg,
+        .start = mid,
+        .end   = end,
+        .grain = grain,
+    };
+    spawn_task(pool, &right.task, execute_range_task, &right);
+    run_range(pool, start, mid, grain, func, arg);
+    join_task(pool, &right.task);
+}
+
+// parallel_for calls func on chunks of index range [start, end) no larger than grain,
+// chunks are processed concurrently by pool workers. Zero grain selects chunk size
+// automatically. Returns after all chunks are processed. Must be called from
+// one of pool workers
+void parallel_for(WorkerPool *pool, u64 start, u64 end, u64 grain, RangeFunc func, void *arg) {
+    if (start >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = (end - start) / (pool->workers * range_chunks_per_worker);
+        if (grain == 0) {
+            grain = 1;
+        }
+    }
+    run_range(pool, start, end, grain, func, arg);
+}
+
+void free_worker_pool(WorkerPool *pool) {
+    atomic_store(&pool->stop, true);
+    mtx_lock(&pool->mutex);
+    cnd_broadcast(&pool->wakeup);
+    mtx_unlock(&pool->mutex);
+    for (u32 i = 1; i < pool->workers; i++) {
+        thrd_join(pool->threads[i], nil);
+    }
+
+    for (u32 i = 0; i < pool->workers; i++) {
+        free_task_deque(&pool->deques[i]);
+    }
+    mtx_destroy(&pool->mutex);
+    cnd_destroy(&pool->wakeup);
+    free(pool->deques);
+    free_mem(pool->contexts);
+    free_mem(pool->threads);
+    free_mem(pool);
+    current_pool = nil;
+}
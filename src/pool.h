@@ -0,0 +1,100 @@
+#ifndef KU_POOL_H
+#define KU_POOL_H
+
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "types.h"
+
+typedef struct Task Task;
+typedef struct TaskArray TaskArray;
+typedef struct TaskDeque TaskDeque;
+typedef struct WorkerPool WorkerPool;
+typedef struct WorkerContext WorkerContext;
+typedef struct RangeTask RangeTask;
+
+typedef void (*TaskFunc)(void *arg);
+
+// RangeFunc processes elements with indices in range [start, end)
+typedef void (*RangeFunc)(void *arg, u64 start, u64 end);
+
+// Task is a unit of work executed by pool workers. Memory for a task
+// is owned by the code which spawned it and must stay valid until
+// the task is joined
+struct Task {
+    TaskFunc func;
+    void *arg;
+
+    atomic_bool done;
+};
+
+// TaskArray is a circular buffer of task pointers used by TaskDeque
+struct TaskArray {
+    // array which was replaced by this one after growth, retired arrays
+    // may still be read by thieves and are freed together with the pool
+    TaskArray *prev;
+
+    i64 cap;
+
+    _Atomic(Task *) elem[];
+};
+
+// TaskDeque is a Chase-Lev work-stealing deque. Owner worker pushes and
+// takes tasks from the bottom, other workers steal them from the top
+struct TaskDeque {
+    _Alignas(64) atomic_int_fast64_t top;
+    _Alignas(64) atomic_int_fast64_t bottom;
+    _Atomic(TaskArray *) array;
+};
+
+// RangeTask is a part of parallel_for index range scheduled as a separate task
+struct RangeTask {
+    Task task;
+    WorkerPool *pool;
+    RangeFunc func;
+    void *arg;
+
+    u64 start;
+    u64 end;
+    u64 grain;
+};
+
+struct WorkerContext {
+    WorkerPool *pool;
+    u32 index;
+    u64 seed;
+};
+
+// WorkerPool executes tasks on a fixed set of worker threads. The thread
+// which created the pool is worker with index 0 and executes tasks only
+// while it waits inside join_task
+struct WorkerPool {
+    // number of workers including the thread which created the pool
+    u32 workers;
+
+    TaskDeque *deques;
+    WorkerContext *contexts;
+    thrd_t *threads;
+
+    atomic_bool stop;
+
+    // incremented after each spawned task, lets idle workers detect
+    // new tasks between last check and going to sleep
+    atomic_uint epoch;
+    atomic_uint sleeping;
+
+    mtx_t mutex;
+    cnd_t wakeup;
+};
+
+extern const char *worker_count_env_name;
+
+u32 get_online_cpu_count();
+u32 get_default_worker_count();
+WorkerPool *new_worker_pool(u32 workers);
+void spawn_task(WorkerPool *pool, Task *task, TaskFunc func, void *arg);
+void join_task(WorkerPool *pool, Task *task);
+void parallel_for(WorkerPool *pool, u64 start, u64 end, u64 grain, RangeFunc func, void *arg);
+void free_worker_pool(WorkerPool *pool);
+
+#endif // KU_POOL_H
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fatal.h"
+#include "pool.h"
+#include "str.h"
+#include "timer.h"
+
+typedef struct BenchWorkload BenchWorkload;
+typedef struct BenchRun BenchRun;
+
+// BenchWorkload describes cost of processing each item in benchmark index range
+struct BenchWorkload {
+    str name;
+
+    // number of hash rounds for a regular item
+    u64 base_rounds;
+
+    // items with index below this bound cost heavy_factor times more,
+    // static partitioning of such range leaves most workers idle
+    u64 heavy_items;
+    u64 heavy_factor;
+};
+
+struct BenchRun {
+    BenchWorkload workload;
+    u64 *results;
+};
+
+const u64 bench_items       = 1 << 14;
+const u32 bench_repetitions = 5;
+
+const BenchWorkload bench_workloads[] = {
+    {
+        .name         = STR("uniform"),
+        .base_rounds  = 1 << 10,
+        .heavy_items  = 0,
+        .heavy_factor = 1,
+    },
+    {
+        .name         = STR("skewed"),
+        .base_rounds  = 1 << 8,
+        .heavy_items  = (1 << 14) / 16,
+        .heavy_factor = 48,
+    },
+};
+
+const u32 number_of_bench_workloads = 2;
+
+u64 get_item_rounds(BenchWorkload w, u64 i) {
+    if (i < w.heavy_items) {
+        return w.base_rounds * w.heavy_factor;
+    }
+    return w.base_rounds;
+}
+
+void process_bench_items(void *arg, u64 start, u64 end) {
+    BenchRun *run = (BenchRun *)arg;
+    for (u64 i = start; i < end; i++) {
+        u64 x      = i + 1;
+        u64 rounds = get_item_rounds(run->workload, i);
+        for (u64 j = 0; j < rounds; j++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        run->results[i] = x;
+    }
+}
+
+u64 sum_bench_results(u64 *results) {
+    u64 sum = 0;
+    for (u64 i = 0; i < bench_items; i++) {
+        sum += results[i];
+    }
+    return sum;
+}
+
+// measure_workload returns best wall time of several runs, checksum of results
+// is stored to compare it between different numbers of threads
+u64 measure_workload(WorkerPool *pool, BenchWorkload workload, u64 *checksum) {
+    BenchRun run = {
+        .workload = workload,
+        .results  = (u64 *)malloc(bench_items * sizeof(u64)),
+    };
+    if (run.results == nil) {
+        fatal(1, "not enough memory for benchmark results");
+    }
+
+    // warm up threads and caches
+    parallel_for(pool, 0, bench_items, 0, process_bench_items, &run);
+
+    u64 best = UINT64_MAX;
+    for (u32 i = 0; i < bench_repetitions; i++) {
+        u64 start = get_wall_time_ns();
+        parallel_for(pool, 0, bench_items, 0, process_bench_items, &run);
+        u64 elapsed = get_wall_time_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    *checksum = sum_bench_results(run.results);
+    free(run.results);
+    return best;
+}
+
+void run_workload_benchmark(BenchWorkload workload, u32 max_threads) {
+    u64 single_time     = 0;
+    u64 single_checksum = 0;
+    for (u32 threads = 1; threads <= max_threads; threads++) {
+        WorkerPool *pool = new_worker_pool(threads);
+        u64 checksum;
+        u64 time = measure_workload(pool, workload, &checksum);
+        free_worker_pool(pool);
+
+        if (threads == 1) {
+            single_time     = time;
+            single_checksum = checksum;
+        } else if (checksum != single_checksum) {
+            fatal(1, "benchmark results differ between numbers of threads");
+        }
+
+        double speedup = (double)single_time / (double)time;
+        printf("%-8.*s  threads: %3u  time: %9.3f ms  speedup: %6.2f  efficiency: %5.1f%%\n",
+            (int)workload.name.len,
+            (char *)workload.name.bytes,
+            threads,
+            (double)time / 1e6,
+            speedup,
+            100.0 * speedup / threads);
+    }
+}
+
+// Usage: pool_bench [max_threads]
+//
+// Runs parallel_for over the same range with 1..max_threads workers. By
+// default maximum number of threads is taken from CCKU_THREADS environment
+// variable or number of online CPUs
+int main(int argc, char **argv) {
+    u32 max_threads = get_default_worker_count();
+    if (argc > 1) {
+        U32ParseResult res = parse_u32_from_decimal(take_str_from_cstr(argv[1]));
+        if (!res.ok || res.num == 0) {
+            fatal(1, "invalid number of threads");
+        }
+        max_threads = res.num;
+    }
+
+    for (u32 i = 0; i < number_of_bench_workloads; i++) {
+        run_workload_benchmark(bench_workloads[i], max_threads);
+    }
+    return 0;
+}
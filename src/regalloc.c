@@ -0,0 +1,393 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "regalloc.h"
+
+typedef struct RegisterAllocator RegisterAllocator;
+
+// RegisterAllocator keeps state of a single allocate_ir_registers call
+struct RegisterAllocator {
+    const IrFunction *fn;
+    const IrCfg *cfg;
+    const RaClass *classes;
+    const RaRegisters *registers;
+
+    // position of block parameters and of block terminator, instructions of
+    // block occupy positions which follow parameters
+    u32 *block_start;
+    u32 *block_end;
+
+    // sets of values live at the start and at the end of each block, set of
+    // block b occupies words_len words starting at b * words_len
+    u64 *live_in;
+    u64 *live_out;
+    u32 words_len;
+
+    // positions of calls in ascending order
+    u32 *calls;
+    u32 calls_len;
+
+    RaInterval *intervals;
+    u32 intervals_len;
+
+    // registers which hold values of active intervals
+    bool taken[64];
+
+    // intervals which contain current position
+    u32 *active;
+    u32 active_len;
+
+    RaAllocation out;
+};
+
+bool has_ra_value(const u64 *set, ValueId v) {
+    return (set[v / 64] & ((u64)1 << (v % 64))) != 0;
+}
+
+void add_ra_value(u64 *set, ValueId v) {
+    set[v / 64] |= (u64)1 << (v % 64);
+}
+
+// number_ra_positions gives each reachable block and instruction its
+// position and collects positions of calls
+void number_ra_positions(RegisterAllocator *ra, const bool *calls) {
+    const IrFunction *fn = ra->fn;
+    u32 pos              = 0;
+    ra->block_start      = (u32 *)alloc_ir_temp((u64)fn->blocks_len * sizeof(u32) + 1);
+    ra->block_end        = (u32 *)alloc_ir_temp((u64)fn->blocks_len * sizeof(u32) + 1);
+    ra->calls            = (u32 *)alloc_ir_temp((u64)fn->instructions_len * sizeof(u32) + 1);
+    ra->calls_len        = 0;
+    for (u32 i = 0; i < ra->cfg->reachable; i++) {
+        BlockId b     = ra->cfg->order[i];
+        IrBlock block = fn->blocks[b];
+        ra->block_start[b] = pos;
+        for (u32 j = 0; j < block.len; j++) {
+            pos++;
+            if (calls[block.start + j]) {
+                ra->calls[ra->calls_len] = pos;
+                ra->calls_len++;
+            }
+        }
+        ra->block_end[b] = pos;
+        pos++;
+    }
+}
+
+// compute_ra_liveness solves backward dataflow equations over reachable
+// blocks. Block parameters are defined by the block itself, arguments are
+// used by terminator of predecessor
+void compute_ra_liveness(RegisterAllocator *ra) {
+    const IrFunction *fn = ra->fn;
+    const IrCfg *cfg     = ra->cfg;
+    u32 words            = (fn->values_len + 63) / 64;
+    u64 size             = (u64)fn->blocks_len * words * sizeof(u64);
+    ra->words_len        = words;
+    ra->live_in          = (u64 *)alloc_ir_temp(size + 1);
+    ra->live_out         = (u64 *)alloc_ir_temp(size + 1);
+    u64 *uses            = (u64 *)alloc_ir_temp(size + 1);
+    u64 *defs            = (u64 *)alloc_ir_temp(size + 1);
+    memset(ra->live_in, 0, size);
+    memset(ra->live_out, 0, size);
+    memset(uses, 0, size);
+    memset(defs, 0, size);
+
+    for (u32 i = 0; i < cfg->reachable; i++) {
+        BlockId b     = cfg->order[i];
+        IrBlock block = fn->blocks[b];
+        u64 *use      = uses + (u64)b * words;
+        u64 *def      = defs + (u64)b * words;
+        for (u32 j = 0; j < block.params_len; j++) {
+            add_ra_value(def, block.params + j);
+        }
+        for (u32 j = 0; j < block.len; j++) {
+            IrInstruction inst = fn->instructions[block.start + j];
+            for (u32 k = 0; k < inst.operands_len; k++) {
+                ValueId v = fn->operands[inst.operands + k];
+                if (!has_ra_value(def, v)) {
+                    add_ra_value(use, v);
+                }
+            }
+            if (inst.result != IR_NONE) {
+                add_ra_value(def, inst.result);
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = cfg->reachable; i > 0; i--) {
+            BlockId b = cfg->order[i - 1];
+            u64 *in   = ra->live_in + (u64)b * words;
+            u64 *out  = ra->live_out + (u64)b * words;
+            BlockId succ[2];
+            u32 succ_len = get_ir_successors(fn, b, succ);
+            for (u32 w = 0; w < words; w++) {
+                u64 o = 0;
+                for (u32 s = 0; s < succ_len; s++) {
+                    o |= ra->live_in[(u64)succ[s] * words + w];
+                }
+                u64 n = uses[(u64)b * words + w] | (o & ~defs[(u64)b * words + w]);
+                if (n != in[w] || o != out[w]) {
+                    changed = true;
+                }
+                in[w]  = n;
+                out[w] = o;
+            }
+        }
+    }
+    free_mem(uses);
+    free_mem(defs);
+}
+
+void extend_ra_interval(RaInterval *interval, u32 pos) {
+    if (interval->start == IR_NONE || pos < interval->start) {
+        interval->start = pos;
+    }
+    if (pos > interval->end) {
+        interval->end = pos;
+    }
+}
+
+// crosses_ra_call tells whether some call lies strictly inside of interval,
+// calls are searched with bisection
+bool crosses_ra_call(const RegisterAllocator *ra, RaInterval interval) {
+    u32 lo = 0;
+    u32 hi = ra->calls_len;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (ra->calls[mid] <= interval.start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < ra->calls_len && ra->calls[lo] < interval.end;
+}
+
+int compare_ra_intervals(const void *a, const void *b) {
+    const RaInterval *x = (const RaInterval *)a;
+    const RaInterval *y = (const RaInterval *)b;
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+    if (x->value != y->value) {
+        return x->value < y->value ? -1 : 1;
+    }
+    return 0;
+}
+
+// build_ra_intervals extends interval of each value over positions of its
+// definition and uses and over blocks where it is live, then sorts
+// intervals by start
+void build_ra_intervals(RegisterAllocator *ra) {
+    const IrFunction *fn = ra->fn;
+    RaInterval *by_value = (RaInterval *)alloc_ir_temp((u64)fn->values_len * sizeof(RaInterval) + 1);
+    for (u32 v = 0; v < fn->values_len; v++) {
+        by_value[v].value        = v;
+        by_value[v].start        = IR_NONE;
+        by_value[v].end          = 0;
+        by_value[v].crosses_call = false;
+    }
+
+    for (u32 i = 0; i < ra->cfg->reachable; i++) {
+        BlockId b      = ra->cfg->order[i];
+        IrBlock block  = fn->blocks[b];
+        const u64 *in  = ra->live_in + (u64)b * ra->words_len;
+        const u64 *out = ra->live_out + (u64)b * ra->words_len;
+        for (u32 v = 0; v < fn->values_len; v++) {
+            if (has_ra_value(in, v)) {
+                extend_ra_interval(&by_value[v], ra->block_start[b]);
+            }
+            if (has_ra_value(out, v)) {
+                extend_ra_interval(&by_value[v], ra->block_end[b]);
+            }
+        }
+        for (u32 j = 0; j < block.params_len; j++) {
+            extend_ra_interval(&by_value[block.params + j], ra->block_start[b]);
+        }
+        for (u32 j = 0; j < block.len; j++) {
+            IrInstruction inst = fn->instructions[block.start + j];
+            u32 pos            = ra->block_start[b] + 1 + j;
+            for (u32 k = 0; k < inst.operands_len; k++) {
+                extend_ra_interval(&by_value[fn->operands[inst.operands + k]], pos);
+            }
+            if (inst.result != IR_NONE) {
+                extend_ra_interval(&by_value[inst.result], pos);
+            }
+        }
+    }
+
+    ra->intervals     = (RaInterval *)alloc_ir_temp((u64)fn->values_len * sizeof(RaInterval) + 1);
+    ra->intervals_len = 0;
+    for (u32 v = 0; v < fn->values_len; v++) {
+        if (by_value[v].start == IR_NONE || ra->classes[v] == rc_None) {
+            continue;
+        }
+        by_value[v].crosses_call         = crosses_ra_call(ra, by_value[v]);
+        ra->intervals[ra->intervals_len] = by_value[v];
+        ra->intervals_len++;
+    }
+    free_mem(by_value);
+    qsort(ra->intervals, ra->intervals_len, sizeof(RaInterval), compare_ra_intervals);
+}
+
+bool is_ra_callee_saved(const RaRegisters *regs, u32 reg) {
+    for (u32 i = 0; i < regs->callee_saved_len; i++) {
+        if (regs->callee_saved[i] == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// take_ra_register returns free register for interval, caller saved
+// registers are preferred unless interval crosses a call
+u32 take_ra_register(RegisterAllocator *ra, const RaRegisters *regs, RaInterval interval) {
+    if (!interval.crosses_call) {
+        for (u32 i = 0; i < regs->caller_saved_len; i++) {
+            if (!ra->taken[regs->caller_saved[i]]) {
+                return regs->caller_saved[i];
+            }
+        }
+    }
+    for (u32 i = 0; i < regs->callee_saved_len; i++) {
+        if (!ra->taken[regs->callee_saved[i]]) {
+            return regs->callee_saved[i];
+        }
+    }
+    return IR_NONE;
+}
+
+void spill_ra_value(RegisterAllocator *ra, ValueId v) {
+    ra->out.regs[v]  = RA_SPILLED;
+    ra->out.slots[v] = ra->out.slots_len;
+    ra->out.slots_len++;
+}
+
+void assign_ra_register(RegisterAllocator *ra, ValueId v, u32 reg) {
+    ra->out.regs[v] = reg;
+    ra->taken[reg]  = true;
+    ra->out.used |= (u64)1 << reg;
+}
+
+// expire_ra_intervals releases registers of intervals which end before
+// given position
+void expire_ra_intervals(RegisterAllocator *ra, u32 pos) {
+    u32 kept = 0;
+    for (u32 i = 0; i < ra->active_len; i++) {
+        RaInterval interval = ra->intervals[ra->active[i]];
+        if (interval.end < pos) {
+            ra->taken[ra->out.regs[interval.value]] = false;
+        } else {
+            ra->active[kept] = ra->active[i];
+            kept++;
+        }
+    }
+    ra->active_len = kept;
+}
+
+// allocate_ra_interval spills interval which ends last when no register is
+// free, register of active interval is taken over only if it suits the
+// current one
+void allocate_ra_interval(RegisterAllocator *ra, const RaRegisters *regs, u32 index) {
+    RaInterval interval = ra->intervals[index];
+    u32 reg             = take_ra_register(ra, regs, interval);
+    if (reg != IR_NONE) {
+        assign_ra_register(ra, interval.value, reg);
+        ra->active[ra->active_len] = index;
+        ra->active_len++;
+        return;
+    }
+
+    u32 victim = IR_NONE;
+    for (u32 i = 0; i < ra->active_len; i++) {
+        RaInterval a = ra->intervals[ra->active[i]];
+        if (interval.crosses_call && !is_ra_callee_saved(regs, ra->out.regs[a.value])) {
+            continue;
+        }
+        if (victim == IR_NONE || a.end > ra->intervals[ra->active[victim]].end) {
+            victim = i;
+        }
+    }
+    if (victim == IR_NONE || ra->intervals[ra->active[victim]].end <= interval.end) {
+        spill_ra_value(ra, interval.value);
+        return;
+    }
+    ValueId spilled = ra->intervals[ra->active[victim]].value;
+    reg             = ra->out.regs[spilled];
+    spill_ra_value(ra, spilled);
+    assign_ra_register(ra, interval.value, reg);
+    ra->active[victim] = index;
+}
+
+// scan_ra_class walks intervals of a single class in order of their start
+void scan_ra_class(RegisterAllocator *ra, RaClass class) {
+    const RaRegisters *regs = &ra->registers[class];
+    memset(ra->taken, 0, sizeof(ra->taken));
+    ra->active_len = 0;
+    for (u32 i = 0; i < ra->intervals_len; i++) {
+        RaInterval interval = ra->intervals[i];
+        if (ra->classes[interval.value] != class) {
+            continue;
+        }
+        expire_ra_intervals(ra, interval.start);
+        allocate_ra_interval(ra, regs, i);
+    }
+}
+
+RaAllocation allocate_ir_registers(
+    const IrFunction *fn, const IrCfg *cfg, const RaClass *classes, const bool *calls, const RaRegisters *registers) {
+    RegisterAllocator ra = {
+        .fn            = fn,
+        .cfg           = cfg,
+        .classes       = classes,
+        .registers     = registers,
+        .block_start   = nil,
+        .block_end     = nil,
+        .live_in       = nil,
+        .live_out      = nil,
+        .words_len     = 0,
+        .calls         = nil,
+        .calls_len     = 0,
+        .intervals     = nil,
+        .intervals_len = 0,
+        .taken         = {0},
+        .active        = nil,
+        .active_len    = 0,
+    };
+    ra.out.regs      = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1);
+    ra.out.slots     = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1);
+    ra.out.slots_len = 0;
+    ra.out.used      = 0;
+    for (u32 v = 0; v < fn->values_len; v++) {
+        ra.out.regs[v]  = IR_NONE;
+        ra.out.slots[v] = IR_NONE;
+    }
+
+    number_ra_positions(&ra, calls);
+    compute_ra_liveness(&ra);
+    build_ra_intervals(&ra);
+    ra.active = (u32 *)alloc_ir_temp((u64)ra.intervals_len * sizeof(u32) + 1);
+    scan_ra_class(&ra, rc_Int);
+    scan_ra_class(&ra, rc_Float);
+
+    free_mem(ra.block_start);
+    free_mem(ra.block_end);
+    free_mem(ra.live_in);
+    free_mem(ra.live_out);
+    free_mem(ra.calls);
+    free_mem(ra.intervals);
+    free_mem(ra.active);
+    return ra.out;
+}
+
+void free_ra_allocation(RaAllocation *a) {
+    free_mem(a->regs);
+    free_mem(a->slots);
+    a->regs      = nil;
+    a->slots     = nil;
+    a->slots_len = 0;
+    a->used      = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef KU_REGALLOC_H
+#define KU_REGALLOC_H
+
+#include "ir.h"
+#include "types.h"
+
+typedef enum RaClass RaClass;
+typedef struct RaRegisters RaRegisters;
+typedef struct RaInterval RaInterval;
+typedef struct RaAllocation RaAllocation;
+
+// marks value which lives in stack slot instead of register
+#define RA_SPILLED ((u32)0xFFFFFFFE)
+
+// RaClass is a kind of machine registers which may hold value
+enum RaClass {
+    // value does not need location of its own, for example tuple or constant
+    // which is always encoded as immediate operand
+    rc_None,
+
+    rc_Int,
+    rc_Float,
+
+    rc_end,
+};
+
+// RaRegisters lists registers of a single class which allocator may use,
+// registers are taken in the listed order. Value live across a call gets
+// only callee saved register or stack slot
+struct RaRegisters {
+    const u32 *caller_saved;
+    u32 caller_saved_len;
+
+    const u32 *callee_saved;
+    u32 callee_saved_len;
+};
+
+// RaInterval covers positions from definition of value up to its last use,
+// blocks are numbered in reverse postorder and interval includes all
+// positions between its ends even if value is dead in some of them
+struct RaInterval {
+    ValueId value;
+
+    u32 start;
+    u32 end;
+
+    // some call is placed strictly inside of interval
+    bool crosses_call;
+};
+
+struct RaAllocation {
+    // register of each value indexed by value id, RA_SPILLED for values in
+    // stack slots and IR_NONE for values without location
+    u32 *regs;
+
+    // stack slot of each spilled value, IR_NONE for other values
+    u32 *slots;
+
+    // number of stack slots used by function
+    u32 slots_len;
+
+    // bit for each register number which is assigned to some value
+    u64 used;
+};
+
+// allocate_ir_registers assigns registers to values of function with linear
+// scan over live intervals. Classes give class of each value, calls marks
+// instructions which clobber caller saved registers, registers are indexed
+// by class. Value keeps its register or slot during whole interval, interval
+// of result never shares register with intervals of operands which end at
+// the same instruction
+RaAllocation allocate_ir_registers(
+    const IrFunction *fn, const IrCfg *cfg, const RaClass *classes, const bool *calls, const RaRegisters *registers);
+
+void free_ra_allocation(RaAllocation *a);
+
+#endif // KU_REGALLOC_H
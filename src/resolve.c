@@ -0,0 +1,468 @@
+#include "fatal.h"
+#include "resolve.h"
+#include "xnew.h"
+
+typedef struct Resolver Resolver;
+typedef struct ResolveContext ResolveContext;
+
+// Resolver holds state of resolving statements of a single function
+struct Resolver {
+    // module level declarations, shared by all resolvers and only read by them
+    const SymbolTable *module;
+
+    SymbolTable locals;
+
+    // function being resolved, nil for top level statements
+    FunctionDefinition *function;
+
+    // number of local symbols declared so far in function
+    u32 locals_count;
+
+    slice_of_ResolveErrors errors;
+};
+
+// ResolveContext is shared by all range tasks resolving functions of one tree
+struct ResolveContext {
+    const SymbolTable *module;
+    slice_of_FunctionDefinitions functions;
+
+    // errors of each function, indexed in the same way as functions
+    slice_of_ResolveErrors *function_errors;
+};
+
+IMPLEMENT_SLICE(SymbolBinding)
+IMPLEMENT_SLICE(u32)
+IMPLEMENT_SLICE(ResolveError)
+
+const u32 no_symbol_binding = 0xFFFFFFFF;
+
+// initial capacity of per-function tables, most functions never grow them
+const u32 default_symbol_table_cap = 64;
+
+const u32 min_symbol_table_cap = 8;
+
+const str resolve_error_messages[] = {
+    [ret_Undefined]  = STR("undefined name"),
+    [ret_Redeclared] = STR("name redeclared in this scope"),
+};
+
+// predeclared functions visible in every module
+const str builtin_function_names[] = {
+    STR("print"),
+    STR("println"),
+};
+
+#define BUILTIN_FUNCTIONS_LEN (sizeof(builtin_function_names) / sizeof(builtin_function_names[0]))
+
+const u32 builtin_functions_len = BUILTIN_FUNCTIONS_LEN;
+
+// hash_symbol_name computes 64-bit FNV-1a hash of name
+u64 hash_symbol_name(str name) {
+    u64 h = 0xCBF29CE484222325ULL;
+    for (u64 i = 0; i < name.len; i++) {
+        h ^= name.bytes[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+SymbolSlot *new_symbol_slots(u32 cap) {
+    SymbolSlot *slots = (SymbolSlot *)alloc_mem(at_Map, (u64)cap * sizeof(SymbolSlot));
+    if (slots == nil) {
+        fatal(1, "not enough memory for symbol table");
+    }
+    for (u32 i = 0; i < cap; i++) {
+        slots[i].name    = empty_str;
+        slots[i].hash    = 0;
+        slots[i].binding = no_symbol_binding;
+    }
+    return slots;
+}
+
+SymbolTable new_symbol_table(u32 cap) {
+    u32 c = min_symbol_table_cap;
+    while (c < cap) {
+        c <<= 1;
+    }
+    SymbolTable t = {
+        .slots    = new_symbol_slots(c),
+        .cap      = c,
+        .len      = 0,
+        .bindings = empty_slice_of_SymbolBindings,
+        .scopes   = empty_slice_of_u32s,
+    };
+    return t;
+}
+
+void free_symbol_table(SymbolTable *t) {
+    free_mem(t->slots);
+    free_slice_of_SymbolBindings(t->bindings);
+    free_slice_of_u32s(t->scopes);
+    t->slots = nil;
+    t->cap   = 0;
+    t->len   = 0;
+}
+
+// find_symbol_slot returns index of slot with given name or index of free
+// slot where this name should be placed
+u32 find_symbol_slot(const SymbolTable *t, str name, u64 hash) {
+    u32 mask = t->cap - 1;
+    u32 i    = (u32)hash & mask;
+    while (t->slots[i].name.len != 0) {
+        if (t->slots[i].hash == hash && are_strs_equal(t->slots[i].name, name)) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void grow_symbol_table(SymbolTable *t) {
+    SymbolSlot *old = t->slots;
+    u32 old_cap     = t->cap;
+
+    t->cap   = old_cap << 1;
+    t->slots = new_symbol_slots(t->cap);
+    for (u32 i = 0; i < old_cap; i++) {
+        if (old[i].name.len == 0) {
+            continue;
+        }
+        u32 j       = find_symbol_slot(t, old[i].name, old[i].hash);
+        t->slots[j] = old[i];
+
+        // all bindings of the name, including shadowed ones, refer to the slot
+        for (u32 b = old[i].binding; b != no_symbol_binding; b = t->bindings.elem[b].shadowed) {
+            t->bindings.elem[b].slot = j;
+        }
+    }
+    free_mem(old);
+}
+
+void push_scope(SymbolTable *t) {
+    append_u32_to_slice(&t->scopes, t->bindings.len);
+}
+
+// pop_scope makes names shadowed by bindings of the innermost scope visible
+// again, bindings are undone in reverse order
+void pop_scope(SymbolTable *t) {
+    if (t->scopes.len == 0) {
+        fatal(1, "no scope to pop from symbol table");
+    }
+    u32 start = t->scopes.elem[t->scopes.len - 1];
+    for (u32 i = t->bindings.len; i > start; i--) {
+        SymbolBinding b          = t->bindings.elem[i - 1];
+        t->slots[b.slot].binding = b.shadowed;
+    }
+    t->bindings.len = start;
+    t->scopes.len--;
+}
+
+// declare_symbol makes symbol visible in the innermost scope, returns false if
+// this scope already has declaration with the same name
+bool declare_symbol(SymbolTable *t, Symbol *symbol) {
+    // load factor is kept at most 1/2
+    if ((t->len + 1) * 2 > t->cap) {
+        grow_symbol_table(t);
+    }
+
+    u64 hash         = hash_symbol_name(symbol->name);
+    u32 i            = find_symbol_slot(t, symbol->name, hash);
+    SymbolSlot *slot = &t->slots[i];
+    if (slot->name.len == 0) {
+        slot->name    = symbol->name;
+        slot->hash    = hash;
+        slot->binding = no_symbol_binding;
+        t->len++;
+    }
+
+    u32 scope_start = 0;
+    if (t->scopes.len != 0) {
+        scope_start = t->scopes.elem[t->scopes.len - 1];
+    }
+    if (slot->binding != no_symbol_binding && slot->binding >= scope_start) {
+        return false;
+    }
+
+    SymbolBinding b = {
+        .symbol   = symbol,
+        .slot     = i,
+        .shadowed = slot->binding,
+    };
+    slot->binding = t->bindings.len;
+    append_SymbolBinding_to_slice(&t->bindings, b);
+    return true;
+}
+
+// lookup_symbol returns innermost visible declaration of name or nil
+Symbol *lookup_symbol(const SymbolTable *t, str name) {
+    u32 b = t->slots[find_symbol_slot(t, name, hash_symbol_name(name))].binding;
+    if (b == no_symbol_binding) {
+        return nil;
+    }
+    return t->bindings.elem[b].symbol;
+}
+
+Symbol *new_symbol(SymbolKind kind, str name, Position pos, FunctionDefinition *function) {
+    Symbol *symbol   = xnew(at_AST, Symbol);
+    symbol->kind     = kind;
+    symbol->name     = name;
+    symbol->pos      = pos;
+    symbol->function = function;
+    symbol->type     = ti_Invalid;
+    symbol->index    = 0;
+    return symbol;
+}
+
+void add_resolve_error(slice_of_ResolveErrors *errors, ResolveErrorType type, Token token) {
+    ResolveError err = {
+        .type = type,
+        .name = token.literal,
+        .pos  = token.pos,
+    };
+    append_ResolveError_to_slice(errors, err);
+}
+
+void declare_identifier(Resolver *r, SymbolKind kind, Identifier *ident) {
+    ident->symbol        = new_symbol(kind, ident->token.literal, ident->token.pos, r->function);
+    ident->symbol->index = r->locals_count;
+    r->locals_count++;
+    if (!declare_symbol(&r->locals, ident->symbol)) {
+        add_resolve_error(&r->errors, ret_Redeclared, ident->token);
+    }
+}
+
+// resolve_identifier binds use of a name, local declarations shadow module
+// level ones
+void resolve_identifier(Resolver *r, Identifier *ident) {
+    Symbol *symbol = lookup_symbol(&r->locals, ident->token.literal);
+    if (symbol == nil) {
+        symbol = lookup_symbol(r->module, ident->token.literal);
+    }
+    if (symbol == nil) {
+        add_resolve_error(&r->errors, ret_Undefined, ident->token);
+    }
+    ident->symbol = symbol;
+}
+
+void resolve_expression(Resolver *r, Expression expr) {
+    switch (expr.type) {
+    case et_Identifier:
+        resolve_identifier(r, (Identifier *)expr.ptr);
+        break;
+    case et_Call: {
+        CallExpression *call = (CallExpression *)expr.ptr;
+        resolve_identifier(r, &call->name);
+        for (u32 i = 0; i < call->args.len; i++) {
+            resolve_expression(r, call->args.elem[i]);
+        }
+        break;
+    }
+    case et_Unary:
+        resolve_expression(r, ((UnaryExpression *)expr.ptr)->operand);
+        break;
+    case et_Binary: {
+        BinaryExpression *binary = (BinaryExpression *)expr.ptr;
+        resolve_expression(r, binary->left);
+        resolve_expression(r, binary->right);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void resolve_statements(Resolver *r, slice_of_Statements stmts);
+
+void resolve_expressions(Resolver *r, slice_of_Expressions exprs) {
+    for (u32 i = 0; i < exprs.len; i++) {
+        resolve_expression(r, exprs.elem[i]);
+    }
+}
+
+void resolve_block(Resolver *r, BlockStatement block) {
+    push_scope(&r->locals);
+    resolve_statements(r, block.statements);
+    pop_scope(&r->locals);
+}
+
+void resolve_statement(Resolver *r, Statement stmt) {
+    switch (stmt.type) {
+    case st_Define: {
+        // right side is resolved first, so that x := x refers to outer x
+        DefineStatement *dstmt = (DefineStatement *)stmt.ptr;
+        for (u32 i = 0; i < dstmt->right.len; i++) {
+            resolve_expression(r, dstmt->right.elem[i]);
+        }
+        for (u32 i = 0; i < dstmt->left.len; i++) {
+            Expression expr = dstmt->left.elem[i];
+            if (expr.type == et_Identifier) {
+                declare_identifier(r, sk_Variable, (Identifier *)expr.ptr);
+            } else {
+                resolve_expression(r, expr);
+            }
+        }
+        break;
+    }
+    case st_Assign: {
+        AssignStatement *astmt = (AssignStatement *)stmt.ptr;
+        resolve_expressions(r, astmt->right);
+        resolve_expressions(r, astmt->left);
+        break;
+    }
+    case st_Expression:
+        resolve_expression(r, *(Expression *)stmt.ptr);
+        break;
+    case st_Return:
+        resolve_expressions(r, ((ReturnStatement *)stmt.ptr)->values);
+        break;
+    case st_If: {
+        IfStatement *istmt = (IfStatement *)stmt.ptr;
+        for (u32 i = 0; i < istmt->clauses.len; i++) {
+            resolve_expression(r, istmt->clauses.elem[i].condition);
+            resolve_block(r, istmt->clauses.elem[i].body);
+        }
+        if (istmt->else_body != nil) {
+            resolve_block(r, *istmt->else_body);
+        }
+        break;
+    }
+    case st_Loop: {
+        LoopStatement *lstmt = (LoopStatement *)stmt.ptr;
+        if (lstmt->count.ptr != nil) {
+            resolve_expression(r, lstmt->count);
+        }
+        resolve_block(r, lstmt->body);
+        break;
+    }
+    case st_While: {
+        WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+        resolve_expression(r, wstmt->condition);
+        resolve_block(r, wstmt->body);
+        break;
+    }
+    case st_Block:
+        resolve_block(r, *(BlockStatement *)stmt.ptr);
+        break;
+    default:
+        break;
+    }
+}
+
+void resolve_statements(Resolver *r, slice_of_Statements stmts) {
+    for (u32 i = 0; i < stmts.len; i++) {
+        resolve_statement(r, stmts.elem[i]);
+    }
+}
+
+void declare_parameters(Resolver *r, SymbolKind kind, slice_of_ParameterDeclarations decls) {
+    for (u32 i = 0; i < decls.len; i++) {
+        ParameterDeclaration *decl = &decls.elem[i];
+        for (u32 j = 0; j < decl->names.len; j++) {
+            declare_identifier(r, kind, &decl->names.elem[j]);
+        }
+    }
+}
+
+// resolve_function places parameters, named results and top level statements
+// of the body into the same function scope, nested blocks get their own scopes
+void resolve_function(Resolver *r, FunctionDefinition *def) {
+    r->function     = def;
+    r->locals_count = 0;
+    push_scope(&r->locals);
+    declare_parameters(r, sk_Parameter, def->declaration.parameters.parameter_declarations);
+    if (def->declaration.result.type == frt_TypedTuple) {
+        TypedTupleResult *result = (TypedTupleResult *)def->declaration.result.ptr;
+        declare_parameters(r, sk_Result, result->parameter_declarations);
+    }
+    resolve_statements(r, def->body.statements);
+    pop_scope(&r->locals);
+    def->locals = r->locals_count;
+}
+
+void resolve_function_range(void *arg, u64 start, u64 end) {
+    ResolveContext *ctx = (ResolveContext *)arg;
+    Resolver r          = {
+        .module       = ctx->module,
+        .locals       = new_symbol_table(default_symbol_table_cap),
+        .function     = nil,
+        .locals_count = 0,
+    };
+    for (u64 i = start; i < end; i++) {
+        r.errors = empty_slice_of_ResolveErrors;
+        resolve_function(&r, &ctx->functions.elem[i]);
+        ctx->function_errors[i] = r.errors;
+    }
+    free_symbol_table(&r.locals);
+}
+
+void append_resolve_errors(slice_of_ResolveErrors *errors, slice_of_ResolveErrors more) {
+    for (u32 i = 0; i < more.len; i++) {
+        append_ResolveError_to_slice(errors, more.elem[i]);
+    }
+}
+
+// Module scope with builtins and function names is built first and then
+// only read, so that each function can be resolved independently with its
+// own table of local names
+ResolveResult resolve_standalone_source_tree(WorkerPool *pool, StandaloneSourceTree *tree) {
+    ResolveResult result = {
+        .errors = empty_slice_of_ResolveErrors,
+    };
+
+    u32 functions      = tree->functions.len;
+    SymbolTable module = new_symbol_table((functions + (u32)BUILTIN_FUNCTIONS_LEN) * 2);
+    push_scope(&module);
+    for (u32 i = 0; i < BUILTIN_FUNCTIONS_LEN; i++) {
+        Symbol *builtin = new_symbol(sk_Builtin, builtin_function_names[i], null_position, nil);
+        builtin->index  = i;
+        declare_symbol(&module, builtin);
+    }
+    for (u32 i = 0; i < functions; i++) {
+        FunctionDefinition *def = &tree->functions.elem[i];
+        Identifier *name        = &def->declaration.name;
+        name->symbol            = new_symbol(sk_Function, name->token.literal, name->token.pos, def);
+        if (!declare_symbol(&module, name->symbol)) {
+            add_resolve_error(&result.errors, ret_Redeclared, name->token);
+        }
+    }
+
+    if (functions != 0) {
+        u64 size           = functions * sizeof(slice_of_ResolveErrors);
+        ResolveContext ctx = {
+            .module          = &module,
+            .functions       = tree->functions,
+            .function_errors = (slice_of_ResolveErrors *)alloc_mem(at_Other, size),
+        };
+        if (ctx.function_errors == nil) {
+            fatal(1, "not enough memory for resolve errors");
+        }
+        if (pool == nil) {
+            resolve_function_range(&ctx, 0, functions);
+        } else {
+            parallel_for(pool, 0, functions, 0, resolve_function_range, &ctx);
+        }
+        for (u32 i = 0; i < functions; i++) {
+            append_resolve_errors(&result.errors, ctx.function_errors[i]);
+            free_slice_of_ResolveErrors(ctx.function_errors[i]);
+        }
+        free_mem(ctx.function_errors);
+    }
+
+    // top level statements form their own scope after all functions
+    Resolver r = {
+        .module       = &module,
+        .locals       = new_symbol_table(default_symbol_table_cap),
+        .function     = nil,
+        .locals_count = 0,
+        .errors       = empty_slice_of_ResolveErrors,
+    };
+    push_scope(&r.locals);
+    resolve_statements(&r, tree->statements);
+    pop_scope(&r.locals);
+    append_resolve_errors(&result.errors, r.errors);
+    free_slice_of_ResolveErrors(r.errors);
+    free_symbol_table(&r.locals);
+
+    free_symbol_table(&module);
+    return result;
+}
@@ -0,0 +1,149 @@
+#ifndef KU_RESOLVE_H
+#define KU_RESOLVE_H
+
+#include "ast.h"
+#include "pool.h"
+#include "position.h"
+#include "slice.h"
+#include "str.h"
+#include "types.h"
+
+typedef enum SymbolKind SymbolKind;
+typedef enum ResolveErrorType ResolveErrorType;
+typedef struct SymbolSlot SymbolSlot;
+typedef struct SymbolBinding SymbolBinding;
+typedef struct SymbolTable SymbolTable;
+typedef struct ResolveError ResolveError;
+typedef struct ResolveResult ResolveResult;
+
+enum SymbolKind {
+    // predeclared function, e.g. print
+    sk_Builtin,
+
+    // function defined at module level
+    sk_Function,
+
+    // name from function parameter list
+    sk_Parameter,
+
+    // name of function result value
+    sk_Result,
+
+    // name declared by define statement
+    sk_Variable,
+
+    // predeclared type name, bound by type checker
+    sk_Type,
+};
+
+enum ResolveErrorType {
+    // identifier does not refer to any visible declaration
+    ret_Undefined,
+
+    // name is already declared in the same scope
+    ret_Redeclared,
+};
+
+// Symbol is a single declaration, all identifiers which refer to it point to
+// the same Symbol
+struct Symbol {
+    SymbolKind kind;
+    str name;
+
+    // position of declaring identifier, null_position for builtins
+    Position pos;
+
+    // definition of function itself for sk_Function, function which declares
+    // symbol for other local kinds, nil for builtins
+    FunctionDefinition *function;
+
+    // type of value or type denoted by sk_Type name, ti_Invalid until type
+    // checker assigns it
+    TypeId type;
+
+    // parameters, results and variables of a function are numbered from zero
+    // in order of declaration, see FunctionDefinition.locals. Builtins have
+    // index of their name in builtin_function_names
+    u32 index;
+};
+
+// SymbolSlot is an entry of open addressing table, slot with empty name is
+// free. Once occupied slot keeps its name even when no declaration of this
+// name is visible anymore
+struct SymbolSlot {
+    str name;
+    u64 hash;
+
+    // index of the innermost visible binding of name, no_symbol_binding if
+    // there is none
+    u32 binding;
+};
+
+// SymbolBinding records declaration of name in the current scope. Bindings
+// are stored on stack in declaration order, so that all bindings of a scope
+// lie above its marker
+struct SymbolBinding {
+    Symbol *symbol;
+
+    // index of slot holding the name
+    u32 slot;
+
+    // binding of the same name shadowed by this one
+    u32 shadowed;
+};
+
+TYPEDEF_SLICE(SymbolBinding)
+TYPEDEF_SLICE(u32)
+
+// SymbolTable maps names to visible declarations in nested scopes. Lookup is
+// a single probe sequence regardless of nesting depth, entering a scope pushes
+// marker and leaving it unwinds only bindings made inside
+struct SymbolTable {
+    SymbolSlot *slots;
+
+    // always a power of two
+    u32 cap;
+
+    // number of occupied slots
+    u32 len;
+
+    slice_of_SymbolBindings bindings;
+
+    // length of bindings stack at the start of each open scope
+    slice_of_u32s scopes;
+};
+
+struct ResolveError {
+    ResolveErrorType type;
+    str name;
+    Position pos;
+};
+
+TYPEDEF_SLICE(ResolveError)
+
+struct ResolveResult {
+    // errors of module scope first, then errors of each function in order
+    // of definition
+    slice_of_ResolveErrors errors;
+};
+
+extern const u32 no_symbol_binding;
+extern const str resolve_error_messages[];
+extern const str builtin_function_names[];
+extern const u32 builtin_functions_len;
+
+SymbolTable new_symbol_table(u32 cap);
+void free_symbol_table(SymbolTable *t);
+void push_scope(SymbolTable *t);
+void pop_scope(SymbolTable *t);
+bool declare_symbol(SymbolTable *t, Symbol *symbol);
+Symbol *lookup_symbol(const SymbolTable *t, str name);
+Symbol *new_symbol(SymbolKind kind, str name, Position pos, FunctionDefinition *function);
+
+// resolve_standalone_source_tree binds identifiers of the tree to their
+// declarations. Functions are resolved concurrently on pool workers, pool may
+// be nil to resolve them on the calling thread. When pool is given, must be
+// called from one of its workers
+ResolveResult resolve_standalone_source_tree(WorkerPool *pool, StandaloneSourceTree *tree);
+
+#endif // KU_RESOLVE_H
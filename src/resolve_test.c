@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parser.h"
+#include "resolve.h"
+
+// maximum number of errors expected from a single test case
+#define MAX_RESOLVE_TEST_ERRORS 4
+
+typedef struct ResolveTestCase ResolveTestCase;
+
+struct ResolveTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    u32 errors_len;
+    ResolveError errors[MAX_RESOLVE_TEST_ERRORS];
+
+    // kind of symbol bound to identifier on the right side of the last
+    // statement in the last function, checked only when there are no errors
+    SymbolKind kind;
+};
+
+const u32 number_of_test_cases = 8;
+
+const ResolveTestCase test_cases[] = {
+    {
+        .id         = 1,
+        .label      = STR("parameter use"),
+        .input      = STR("fn f(x: int) {\n    y := x\n}\n"),
+        .errors_len = 0,
+        .kind       = sk_Parameter,
+    },
+    {
+        .id         = 2,
+        .label      = STR("named result use"),
+        .input      = STR("fn f() => (r: int) {\n    y := r\n}\n"),
+        .errors_len = 0,
+        .kind       = sk_Result,
+    },
+    {
+        .id         = 3,
+        .label      = STR("local variable use"),
+        .input      = STR("fn f() {\n    a := 1\n    b := a\n}\n"),
+        .errors_len = 0,
+        .kind       = sk_Variable,
+    },
+    {
+        .id         = 4,
+        .label      = STR("function defined later"),
+        .input      = STR("fn f() {\n    a := g\n}\n\nfn g() {\n    b := f\n}\n"),
+        .errors_len = 0,
+        .kind       = sk_Function,
+    },
+    {
+        .id         = 5,
+        .label      = STR("builtin function use"),
+        .input      = STR("fn f() {\n    a := print\n}\n"),
+        .errors_len = 0,
+        .kind       = sk_Builtin,
+    },
+    {
+        .id         = 6,
+        .label      = STR("undefined names"),
+        .input      = STR("fn f() {\n    a := b\n    c := undefined(a)\n}\n"),
+        .errors_len = 2,
+        .errors =
+            {
+                {.type = ret_Undefined, .name = STR("b"), .pos = {.line = 2, .column = 10}},
+                {.type = ret_Undefined, .name = STR("undefined"), .pos = {.line = 3, .column = 10}},
+            },
+    },
+    {
+        .id         = 7,
+        .label      = STR("local names do not leak between functions"),
+        .input      = STR("fn f(x: int) {\n    a := x\n}\n\nfn g() {\n    b := a\n}\n"),
+        .errors_len = 1,
+        .errors =
+            {
+                {.type = ret_Undefined, .name = STR("a"), .pos = {.line = 6, .column = 10}},
+            },
+    },
+    {
+        .id         = 8,
+        .label      = STR("redeclarations"),
+        .input      = STR("fn f(a: int, a: int) {\n    b := a\n    b := 2\n}\n\nfn f() {}\n"),
+        .errors_len = 3,
+        .errors =
+            {
+                {.type = ret_Redeclared, .name = STR("f"), .pos = {.line = 6, .column = 4}},
+                {.type = ret_Redeclared, .name = STR("a"), .pos = {.line = 1, .column = 14}},
+                {.type = ret_Redeclared, .name = STR("b"), .pos = {.line = 3, .column = 5}},
+            },
+    },
+};
+
+const str pass_str = STR("    resolve_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+void print_failed_test_case(ResolveTestCase test_case, str want, str got) {
+    str id_str = format_u64_as_decimal(test_case.id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+bool are_resolve_errors_equal(ResolveError a, ResolveError b) {
+    return a.type == b.type && are_strs_equal(a.name, b.name) && are_positions_equal(a.pos, b.pos);
+}
+
+str format_resolve_error(ResolveError err) {
+    char buf[128];
+    str message = resolve_error_messages[err.type];
+    snprintf(buf, sizeof(buf), "%u:%u: %.*s: %.*s", err.pos.line, err.pos.column, (int)message.len,
+        (char *)message.bytes, (int)err.name.len, (char *)err.name.bytes);
+    return new_str_from_cstr(buf);
+}
+
+bool check_resolve_errors(ResolveTestCase test_case, slice_of_ResolveErrors errors) {
+    if (errors.len != test_case.errors_len) {
+        str want = format_u64_as_decimal(test_case.errors_len);
+        str got  = format_u64_as_decimal(errors.len);
+        print_failed_test_case(test_case, want, got);
+        free_str(want);
+        free_str(got);
+        return true;
+    }
+    for (u32 i = 0; i < errors.len; i++) {
+        if (!are_resolve_errors_equal(test_case.errors[i], errors.elem[i])) {
+            str want = format_resolve_error(test_case.errors[i]);
+            str got  = format_resolve_error(errors.elem[i]);
+            print_failed_test_case(test_case, want, got);
+            free_str(want);
+            free_str(got);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool check_symbol_kind(ResolveTestCase test_case, StandaloneSourceTree tree) {
+    FunctionDefinition def = tree.functions.elem[tree.functions.len - 1];
+    Statement stmt         = def.body.statements.elem[def.body.statements.len - 1];
+    Expression expr        = ((DefineStatement *)stmt.ptr)->right.elem[0];
+    Symbol *symbol         = nil;
+    if (expr.type == et_Identifier) {
+        symbol = ((Identifier *)expr.ptr)->symbol;
+    }
+    if (symbol != nil && symbol->kind == test_case.kind) {
+        return false;
+    }
+
+    str want = format_u64_as_decimal(test_case.kind);
+    str got  = symbol == nil ? new_str_from_cstr("nil") : format_u64_as_decimal(symbol->kind);
+    print_failed_test_case(test_case, want, got);
+    free_str(want);
+    free_str(got);
+    return true;
+}
+
+bool run_test_case(ResolveTestCase test_case) {
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(test_case.input);
+    ResolveResult result               = resolve_standalone_source_tree(nil, &parse_result.tree);
+
+    bool failed = !parse_result.ok || check_resolve_errors(test_case, result.errors);
+    if (!failed && test_case.errors_len == 0) {
+        failed = check_symbol_kind(test_case, parse_result.tree);
+    }
+    free_slice_of_ResolveErrors(result.errors);
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+#include "strop.h"
+
+const VmString empty_vm_string = {
+    .bytes  = nil,
+    .len    = 0,
+    .buffer = nil,
+};
+
+// smallest buffer allocated by concatenation
+const u64 min_vm_string_buffer_cap = 32;
+
+const str vm_format_placeholder = STR("{}");
+const str vm_true_str           = STR("true");
+const str vm_false_str          = STR("false");
+
+VmRuntime init_vm_runtime(OutputBuffer *out) {
+    VmRuntime rt = {
+        .heap = init_arena(at_Vm),
+        .out  = out,
+    };
+    return rt;
+}
+
+void free_vm_runtime(VmRuntime *rt) {
+    free_arena(&rt->heap);
+}
+
+VmKind get_vm_kind(const TypeTable *t, TypeId id) {
+    Type type = get_type(t, id);
+    switch (type.kind) {
+    case tk_Signed:
+        return vk_Signed;
+    case tk_Unsigned:
+        return vk_Unsigned;
+    case tk_Float:
+        return type.size == 4 ? vk_F32 : vk_F64;
+    case tk_Bool:
+        return vk_Bool;
+    default:
+        return vk_Str;
+    }
+}
+
+const VmString *new_vm_string(Arena *a, str s) {
+    VmString *v = (VmString *)arena_alloc(a, sizeof(VmString) + s.len);
+    byte *bytes = (byte *)(v + 1);
+    memcpy(bytes, s.bytes, s.len);
+    v->bytes  = bytes;
+    v->len    = s.len;
+    v->buffer = nil;
+    return v;
+}
+
+byte *get_vm_string_buffer_bytes(VmStringBuffer *buffer) {
+    return (byte *)(buffer + 1);
+}
+
+const VmString *concat_vm_strings(VmRuntime *rt, const VmString *a, const VmString *b) {
+    if (b->len == 0) {
+        return a;
+    }
+    if (a->len == 0) {
+        return b;
+    }
+
+    u64 len                = a->len + b->len;
+    VmStringBuffer *buffer = a->buffer;
+    const byte *bytes;
+    if (buffer != nil && a->bytes + a->len == get_vm_string_buffer_bytes(buffer) + buffer->len &&
+        buffer->cap - buffer->len >= b->len) {
+        memcpy(get_vm_string_buffer_bytes(buffer) + buffer->len, b->bytes, b->len);
+        buffer->len += b->len;
+        bytes = a->bytes;
+    } else {
+        u64 cap = len * 2;
+        if (cap < min_vm_string_buffer_cap) {
+            cap = min_vm_string_buffer_cap;
+        }
+        buffer      = (VmStringBuffer *)arena_alloc(&rt->heap, sizeof(VmStringBuffer) + cap);
+        buffer->len = len;
+        buffer->cap = cap;
+        byte *dst   = get_vm_string_buffer_bytes(buffer);
+        memcpy(dst, a->bytes, a->len);
+        memcpy(dst + a->len, b->bytes, b->len);
+        bytes = dst;
+    }
+
+    VmString *s = (VmString *)arena_alloc(&rt->heap, sizeof(VmString));
+    s->bytes    = bytes;
+    s->len      = len;
+    s->buffer   = buffer;
+    return s;
+}
+
+i32 compare_vm_strings(const VmString *a, const VmString *b) {
+    u64 len = a->len < b->len ? a->len : b->len;
+    if (len != 0) {
+        int c = memcmp(a->bytes, b->bytes, len);
+        if (c != 0) {
+            return c < 0 ? -1 : 1;
+        }
+    }
+    if (a->len == b->len) {
+        return 0;
+    }
+    return a->len < b->len ? -1 : 1;
+}
+
+// are_vm_floats_same compares bits of values rounded to given size
+bool are_vm_floats_same(f64 a, f64 b, bool single) {
+    if (single) {
+        f32 x = (f32)a;
+        f32 y = (f32)b;
+        return memcmp(&x, &y, sizeof(f32)) == 0;
+    }
+    return memcmp(&a, &b, sizeof(f64)) == 0;
+}
+
+// decimal exponents of floats written in positional notation, values
+// outside of this range are written in exponent form
+const int vm_float_min_positional_exp = -5;
+const int vm_float_max_positional_exp = 20;
+
+// write_vm_float writes the shortest decimal form which reads back as the
+// same value of given size, digits of the form are placed around decimal
+// point unless value is very small or very large
+void write_vm_float(OutputBuffer *out, f64 v, bool single) {
+    char buf[32];
+    int n = 0;
+    if (isnan(v) || isinf(v)) {
+        n = snprintf(buf, sizeof(buf), "%g", v);
+        write_bytes_to_output(out, (byte *)buf, (u64)n);
+        return;
+    }
+    for (int precision = 0; precision <= 16; precision++) {
+        n = snprintf(buf, sizeof(buf), "%.*e", precision, v);
+        if (are_vm_floats_same(strtod(buf, nil), v, single)) {
+            break;
+        }
+    }
+
+    // buf holds [-]d[.ddd]e[+-]dd
+    char *e = strchr(buf, 'e');
+    int exp = atoi(e + 1);
+    if (exp < vm_float_min_positional_exp || exp > vm_float_max_positional_exp) {
+        write_bytes_to_output(out, (byte *)buf, (u64)n);
+        return;
+    }
+
+    char digits[20];
+    int len = 0;
+    for (char *c = buf; c < e; c++) {
+        if ('0' <= *c && *c <= '9') {
+            digits[len] = *c;
+            len++;
+        }
+    }
+
+    char pos[48];
+    int m = 0;
+    if (buf[0] == '-') {
+        pos[m] = '-';
+        m++;
+    }
+    if (exp < 0) {
+        pos[m]     = '0';
+        pos[m + 1] = '.';
+        m += 2;
+        for (int i = exp + 1; i < 0; i++) {
+            pos[m] = '0';
+            m++;
+        }
+        memcpy(pos + m, digits, (u64)len);
+        m += len;
+    } else {
+        for (int i = 0; i <= exp || i < len; i++) {
+            if (i == exp + 1) {
+                pos[m] = '.';
+                m++;
+            }
+            pos[m] = i < len ? digits[i] : '0';
+            m++;
+        }
+    }
+    write_bytes_to_output(out, (byte *)pos, (u64)m);
+}
+
+void write_vm_value(OutputBuffer *out, VmValue v, VmKind kind) {
+    switch (kind) {
+    case vk_Signed:
+        if (v.i < 0) {
+            write_byte_to_output(out, '-');
+            write_u64_to_output(out, 0 - v.u);
+        } else {
+            write_u64_to_output(out, v.u);
+        }
+        break;
+    case vk_Unsigned:
+        write_u64_to_output(out, v.u);
+        break;
+    case vk_F32:
+        write_vm_float(out, v.f, true);
+        break;
+    case vk_F64:
+        write_vm_float(out, v.f, false);
+        break;
+    case vk_Bool:
+        write_str_to_output(out, v.u != 0 ? vm_true_str : vm_false_str);
+        break;
+    case vk_Str:
+        write_bytes_to_output(out, v.s->bytes, v.s->len);
+        break;
+    }
+}
+
+void print_vm_values(VmRuntime *rt, u32 builtin, const VmValue *values, const VmKind *kinds, u32 len) {
+    OutputBuffer *out = rt->out;
+    u32 next          = 0;
+    if (len != 0 && kinds[0] == vk_Str) {
+        str format = borrow_str_from_bytes(values[0].s->bytes, values[0].s->len);
+        next       = 1;
+        u64 start  = 0;
+        for (u64 i = 0; i + 1 < format.len; i++) {
+            if (next < len && has_substr_at(format, vm_format_placeholder, i)) {
+                write_bytes_to_output(out, format.bytes + start, i - start);
+                write_vm_value(out, values[next], kinds[next]);
+                next++;
+                i++;
+                start = i + 1;
+            }
+        }
+        write_bytes_to_output(out, format.bytes + start, format.len - start);
+    }
+    for (u32 i = next; i < len; i++) {
+        if (i != 0) {
+            write_byte_to_output(out, ' ');
+        }
+        write_vm_value(out, values[i], kinds[i]);
+    }
+    if (builtin == vb_Println) {
+        write_byte_to_output(out, '\n');
+    }
+}
+
+VmResult new_vm_error(const char *what, str function) {
+    slice_of_bytes b = empty_slice_of_bytes;
+    append_cstr_to_bytes(&b, what);
+    append_cstr_to_bytes(&b, " in function ");
+    append_str_to_bytes(&b, function);
+
+    VmResult result = {
+        .ok    = false,
+        .error = new_str_from_bytes(b.elem, b.len),
+    };
+    free_slice_of_bytes(b);
+    return result;
+}
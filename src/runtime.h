@@ -0,0 +1,113 @@
+#ifndef KU_RUNTIME_H
+#define KU_RUNTIME_H
+
+#include "arena.h"
+#include "output.h"
+#include "str.h"
+#include "type_table.h"
+#include "types.h"
+
+typedef enum VmKind VmKind;
+typedef enum VmBuiltin VmBuiltin;
+typedef union VmValue VmValue;
+typedef struct VmString VmString;
+typedef struct VmStringBuffer VmStringBuffer;
+typedef struct VmRuntime VmRuntime;
+typedef struct VmResult VmResult;
+
+// VmKind tells builtins how to print a value
+enum VmKind {
+    vk_Signed,
+    vk_Unsigned,
+    vk_F32,
+    vk_F64,
+    vk_Bool,
+    vk_Str,
+};
+
+// VmBuiltin is index of builtin function in builtin_function_names
+enum VmBuiltin {
+    vb_Print,
+    vb_Println,
+};
+
+// VmValue is a single value of running program. Integers and bools are
+// stored the same way as IR constants: signed values are sign-extended and
+// unsigned values are zero-extended from their width. Floats of both sizes
+// are kept as f64, f32 results are rounded after each operation
+union VmValue {
+    u64 u;
+    i64 i;
+    f64 f;
+    const VmString *s;
+};
+
+// VmStringBuffer holds bytes of strings built by concatenation, bytes follow
+// the header. Several strings may share prefix of the same buffer
+struct VmStringBuffer {
+    // number of used bytes
+    u64 len;
+
+    u64 cap;
+};
+
+// VmString is immutable, string values are pointers to it
+struct VmString {
+    const byte *bytes;
+    u64 len;
+
+    // nil for strings which are not created by concatenation
+    VmStringBuffer *buffer;
+};
+
+// VmRuntime holds state shared by all functions of running program
+struct VmRuntime {
+    // strings created at runtime, they are freed only together with runtime
+    Arena heap;
+
+    // receives output of print builtins
+    OutputBuffer *out;
+};
+
+// VmResult describes how program execution ended
+struct VmResult {
+    bool ok;
+
+    // new string with description of runtime error, empty if there was none
+    str error;
+};
+
+// value of uninitialized string variables and results
+extern const VmString empty_vm_string;
+
+VmRuntime init_vm_runtime(OutputBuffer *out);
+void free_vm_runtime(VmRuntime *rt);
+
+// get_vm_kind returns kind of values of integer, float, bool or str type
+VmKind get_vm_kind(const TypeTable *t, TypeId id);
+
+// new_vm_string copies bytes of s into arena
+const VmString *new_vm_string(Arena *a, str s);
+
+// concat_vm_strings appends b to a in place when a ends at the end of used
+// part of its buffer and buffer has enough space, otherwise new buffer with
+// room for growth is allocated. Repeated appends to the same string thus
+// take amortized linear time
+const VmString *concat_vm_strings(VmRuntime *rt, const VmString *a, const VmString *b);
+
+// compare_vm_strings returns negative number, zero or positive number if a is
+// less than, equal to or greater than b in lexicographic byte order
+i32 compare_vm_strings(const VmString *a, const VmString *b);
+
+void write_vm_value(OutputBuffer *out, VmValue v, VmKind kind);
+
+// print_vm_values implements builtin with given index in builtin_function_names.
+// If the first value is a string, each "{}" in it is replaced by the next
+// value. Remaining values are written separated by spaces, println ends
+// output with a new line
+void print_vm_values(VmRuntime *rt, u32 builtin, const VmValue *values, const VmKind *kinds, u32 len);
+
+// new_vm_error returns failed result with message "<what> in function <name>"
+VmResult new_vm_error(const char *what, str function);
+
+#endif // KU_RUNTIME_H
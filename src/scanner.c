@@ -1,6 +1,8 @@
 #include <stdlib.h>
 
+#include "alloc.h"
 #include "fatal.h"
+#include "number.h"
 #include "scanner.h"
 
 const u8 scanner_buffer_size = 2;
@@ -51,7 +53,7 @@ void init_scanner_buffer(Scanner *s) {
 }
 
 Scanner *new_scanner_from_source(SourceText source) {
-    Scanner *s = (Scanner *)malloc(sizeof(Scanner));
+    Scanner *s = (Scanner *)alloc_mem(at_Scanner, sizeof(Scanner));
     if (s == nil) {
         fatal(1, "not enough memory for new scanner");
     }
@@ -102,6 +104,35 @@ Scanner init_scanner_from_str(str string) {
     return s;
 }
 
+Scanner init_scanner_from_checkpoint(str string, ScannerCheckpoint cp) {
+    Scanner s = {
+        .prefetched        = false,
+        .insert_terminator = cp.insert_terminator,
+        .insert_blocked    = cp.insert_blocked,
+        .pos               = cp.pos,
+        .prev_code         = ReaderBOF,
+        .code              = ReaderBOF,
+        .next_code         = ReaderBOF,
+        .reader            = init_str_byte_reader(string, scanner_buffer_size),
+    };
+    s.reader.pos = cp.offset;
+    init_scanner_buffer(&s);
+    if (cp.offset > 0) {
+        s.prev_code = (int)string.bytes[cp.offset - 1];
+    }
+    return s;
+}
+
+ScannerCheckpoint get_scanner_checkpoint(const Scanner *s) {
+    ScannerCheckpoint cp = {
+        .insert_terminator = s->insert_terminator,
+        .insert_blocked    = s->insert_blocked,
+        .offset            = s->reader.pos - scanner_buffer_size,
+        .lookahead_end     = s->reader.pos,
+        .pos               = s->pos,
+    };
+    return cp;
+}
 
 bool is_letter_or_underscore(byte b) {
     return ('a' <= b && b <= 'z') || b == '_' || ('A' <= b && b <= 'Z');
@@ -119,10 +150,6 @@ bool is_decimal_digit(byte b) {
     return '0' <= b && b <= '9';
 }
 
-bool is_decimal_digit_or_period(byte b) {
-    return ('0' <= b && b <= '9') || b == '.';
-}
-
 bool is_hexadecimal_digit(byte b) {
     return ('0' <= b && b <= '9') || ('a' <= b && b <= 'f') || ('A' <= b && b <= 'F');
 }
@@ -206,53 +233,46 @@ Token scan_name(Scanner *s) {
     return token;
 }
 
-Token scan_binary_number(Scanner *s) {
-    Token token = {
-        .pos = s->pos,
-    };
-    mark_str_byte_reader_position(&s->reader);
-
-    advance_scanner(s); // skip '0' byte
-    advance_scanner(s); // skip 'b' byte
-
+// consume_digits advances scanner over digits accepted by is_digit, single '_'
+// between two digits is consumed as separator. Returns true if at least one
+// digit was consumed
+bool consume_digits(Scanner *s, bool (*is_digit)(byte)) {
     bool scanned_at_least_one_digit = false;
-    while (s->code != ReaderEOF && is_binary_digit((byte)s->code)) {
+    while (s->code != ReaderEOF) {
+        bool is_separator = s->code == '_' && scanned_at_least_one_digit && s->next_code != ReaderEOF &&
+                            is_digit((byte)s->next_code);
+        if (!is_separator && !is_digit((byte)s->code)) {
+            break;
+        }
         advance_scanner(s);
         scanned_at_least_one_digit = true;
     }
+    return scanned_at_least_one_digit;
+}
 
-    if (is_alphanum((byte)s->code)) {
-        consume_word(s);
-        token.type    = tt_Illegal;
-        token.literal = slice_from_str_byte_reader_mark(&s->reader);
-        return token;
+// set_integer_token_value stores decoded literal value in token, literals
+// with values which do not fit into u64 are illegal
+void set_integer_token_value(Token *token, TokenType type, U64ParseResult res) {
+    if (!res.ok) {
+        token->type = tt_Illegal;
+        return;
     }
-
-    if (!scanned_at_least_one_digit) {
-        token.type    = tt_Illegal;
-        token.literal = slice_from_str_byte_reader_mark(&s->reader);
-        return token;
-    }
-
-    token.type    = tt_BinaryInteger;
-    token.literal = slice_from_str_byte_reader_mark(&s->reader);
-    return token;
+    token->type          = type;
+    token->value.integer = res.num;
 }
 
-Token scan_octal_number(Scanner *s) {
+// scan_prefixed_integer scans integer literal which starts with two byte
+// base prefix, e.g. "0x"
+Token scan_prefixed_integer(Scanner *s, TokenType type, bool (*is_digit)(byte), U64ParseResult (*decode)(str)) {
     Token token = {
         .pos = s->pos,
     };
     mark_str_byte_reader_position(&s->reader);
 
     advance_scanner(s); // skip '0' byte
-    advance_scanner(s); // skip 'o' byte
+    advance_scanner(s); // skip base prefix byte
 
-    bool scanned_at_least_one_digit = false;
-    while (s->code != ReaderEOF && is_octal_digit((byte)s->code)) {
-        advance_scanner(s);
-        scanned_at_least_one_digit = true;
-    }
+    bool scanned_at_least_one_digit = consume_digits(s, is_digit);
 
     if (is_alphanum((byte)s->code)) {
         consume_word(s);
@@ -267,28 +287,34 @@ Token scan_octal_number(Scanner *s) {
         return token;
     }
 
-    token.type    = tt_OctalInteger;
     token.literal = slice_from_str_byte_reader_mark(&s->reader);
+    set_integer_token_value(&token, type, decode(token.literal));
     return token;
 }
 
+Token scan_binary_number(Scanner *s) {
+    return scan_prefixed_integer(s, tt_BinaryInteger, is_binary_digit, decode_binary_integer);
+}
+
+Token scan_octal_number(Scanner *s) {
+    return scan_prefixed_integer(s, tt_OctalInteger, is_octal_digit, decode_octal_integer);
+}
+
 Token scan_decimal_number(Scanner *s) {
     Token token = {
         .pos = s->pos,
     };
     mark_str_byte_reader_position(&s->reader);
 
-    bool scanned_one_period = false;
-    do {
+    consume_digits(s, is_decimal_digit);
+
+    bool scanned_period          = false;
+    bool scanned_fraction_digits = false;
+    if (s->code == '.') {
+        scanned_period = true;
         advance_scanner(s);
-        if (s->code == '.') {
-            if (scanned_one_period) {
-                break;
-            } else {
-                scanned_one_period = true;
-            }
-        }
-    } while (s->code != ReaderEOF && is_decimal_digit_or_period((byte)s->code));
+        scanned_fraction_digits = consume_digits(s, is_decimal_digit);
+    }
 
     if (is_alphanum((byte)s->code) || s->code == '.') {
         consume_word(s);
@@ -297,54 +323,32 @@ Token scan_decimal_number(Scanner *s) {
         return token;
     }
 
-    if (s->prev_code == '.') {
+    if (scanned_period && !scanned_fraction_digits) {
         token.type    = tt_Illegal;
         token.literal = slice_from_str_byte_reader_mark(&s->reader);
         return token;
     }
 
-    if (scanned_one_period) {
-        token.type = tt_DecimalFloat;
-    } else {
-        token.type = tt_DecimalInteger;
-    }
     token.literal = slice_from_str_byte_reader_mark(&s->reader);
-    return token;
-}
-
-Token scan_hexadecimal_number(Scanner *s) {
-    Token token = {
-        .pos = s->pos,
-    };
-    mark_str_byte_reader_position(&s->reader);
-
-    advance_scanner(s); // skip '0' byte
-    advance_scanner(s); // skip 'x' byte
-
-    bool scanned_at_least_one_digit = false;
-    while (s->code != ReaderEOF && is_hexadecimal_digit((byte)s->code)) {
-        advance_scanner(s);
-        scanned_at_least_one_digit = true;
-    }
-
-    if (is_alphanum((byte)s->code)) {
-        consume_word(s);
-        token.type    = tt_Illegal;
-        token.literal = slice_from_str_byte_reader_mark(&s->reader);
+    if (!scanned_period) {
+        set_integer_token_value(&token, tt_DecimalInteger, decode_decimal_integer(token.literal));
         return token;
     }
 
-    if (!scanned_at_least_one_digit) {
-        token.type    = tt_Illegal;
-        token.literal = slice_from_str_byte_reader_mark(&s->reader);
+    F64ParseResult res = decode_decimal_float(token.literal);
+    if (!res.ok) {
+        token.type = tt_Illegal;
         return token;
     }
-
-    token.type    = tt_HexadecimalInteger;
-    token.literal = slice_from_str_byte_reader_mark(&s->reader);
+    token.type       = tt_DecimalFloat;
+    token.value.real = res.num;
     return token;
 }
 
+Token scan_hexadecimal_number(Scanner *s) {
+    return scan_prefixed_integer(s, tt_HexadecimalInteger, is_hexadecimal_digit, decode_hexadecimal_integer);
+}
+
 Token scan_number(Scanner *s) {
     Token token;
 
@@ -497,6 +501,10 @@ Token scan_less_start(Scanner *s) {
         token = create_token_at_scanner_position(s, tt_LeftArrow);
         advance_scanner(s);
         advance_scanner(s);
+    } else if (s->next_code == '<') {
+        token = create_token_at_scanner_position(s, tt_LeftShift);
+        advance_scanner(s);
+        advance_scanner(s);
     } else {
         token = create_token_at_scanner_position(s, tt_Less);
         advance_scanner(s);
@@ -512,6 +520,10 @@ Token scan_greater_start(Scanner *s) {
         token = create_token_at_scanner_position(s, tt_GreaterOrEqual);
         advance_scanner(s);
         advance_scanner(s);
+    } else if (s->next_code == '>') {
+        token = create_token_at_scanner_position(s, tt_RightShift);
+        advance_scanner(s);
+        advance_scanner(s);
     } else {
         token = create_token_at_scanner_position(s, tt_Greater);
         advance_scanner(s);
@@ -527,6 +539,10 @@ Token scan_ampersand_start(Scanner *s) {
         token = create_token_at_scanner_position(s, tt_LogicalAnd);
         advance_scanner(s);
         advance_scanner(s);
+    } else if (s->next_code == '^') {
+        token = create_token_at_scanner_position(s, tt_BitwiseAndNot);
+        advance_scanner(s);
+        advance_scanner(s);
     } else {
         token = create_token_at_scanner_position(s, tt_Ampersand);
         advance_scanner(s);
@@ -670,6 +686,8 @@ Token scan_other(Scanner *s) {
         return scan_not_start(s);
     case '|':
         return scan_pipe_start(s);
+    case '^':
+        return scan_single_byte_token(s, tt_Caret);
     default:
         return scan_illegal_byte_token(s);
     }
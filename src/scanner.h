@@ -8,6 +8,7 @@
 #include "types.h"
 
 typedef struct Scanner Scanner;
+typedef struct ScannerCheckpoint ScannerCheckpoint;
 
 struct Scanner {
     bool prefetched;
@@ -26,6 +27,24 @@ struct Scanner {
     StrByteReader reader;
 };
 
+// ScannerCheckpoint holds everything scan_token depends on besides source
+// bytes, so scanning resumed from a checkpoint yields exactly the same tokens
+// as an uninterrupted scan
+struct ScannerCheckpoint {
+    bool insert_terminator;
+    bool insert_blocked;
+
+    // byte offset of the scanner's current code in source text
+    u64 offset;
+
+    // end of source bytes examined by scanner so far, after the token is
+    // scanned from checkpoint it tells how far the token depends on text,
+    // may exceed text length when scanner looked at EOF
+    u64 lookahead_end;
+
+    Position pos;
+};
+
 Scanner *new_scanner_from_str(str s);
 Scanner *new_scanner_from_source(SourceText source);
 Scanner *new_scanner_from_file(char *path);
@@ -33,6 +52,9 @@ Scanner *new_scanner_from_file(char *path);
 Scanner init_scanner_from_str(str s);
 Scanner init_scanner_from_source(SourceText source);
 Scanner init_scanner_from_file(char *path);
+Scanner init_scanner_from_checkpoint(str s, ScannerCheckpoint cp);
+
+ScannerCheckpoint get_scanner_checkpoint(const Scanner *s);
 
 Token scan_token(Scanner *s);
 
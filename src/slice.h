@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc.h"
 #include "fatal.h"
 #include "types.h"
 
@@ -28,7 +29,9 @@ u32 get_new_cap(u32 cap);
     };                                                                                                                 \
     extern const slice_of_##type##s empty_slice_of_##type##s;                                                          \
     slice_of_##type##s init_empty_slice_of_##type##s();                                                                \
+    void recap_slice_of_##type##s(slice_of_##type##s *s, u32 cap);                                                     \
     void append_##type##_to_slice(slice_of_##type##s *s, type x);                                                      \
+    void splice_slice_of_##type##s(slice_of_##type##s *s, u32 start, u32 end, slice_of_##type##s items);              \
     void free_slice_of_##type##s(slice_of_##type##s s);
 
 #define IMPLEMENT_SLICE(type)                                                                                          \
@@ -58,7 +61,7 @@ u32 get_new_cap(u32 cap);
         s->cap       = cap;                                                                                            \
                                                                                                                        \
         if (s->elem == nil) {                                                                                          \
-            type *new_ptr = (type *)malloc(new_size);                                                                  \
+            type *new_ptr = (type *)alloc_mem(at_Slice, new_size);                                                     \
             if (new_ptr == nil) {                                                                                      \
                 fatal(1, "not enough memory to resize a slice");                                                       \
             }                                                                                                          \
@@ -68,7 +71,7 @@ u32 get_new_cap(u32 cap);
         }                                                                                                              \
                                                                                                                        \
         if (s->is_owner) {                                                                                             \
-            type *new_ptr = (type *)realloc(s->elem, new_size);                                                        \
+            type *new_ptr = (type *)realloc_mem(at_Slice, s->elem, new_size);                                          \
             if (new_ptr == nil) {                                                                                      \
                 fatal(1, "not enough memory to resize a slice");                                                       \
             }                                                                                                          \
@@ -76,7 +79,7 @@ u32 get_new_cap(u32 cap);
             return;                                                                                                    \
         }                                                                                                              \
                                                                                                                        \
-        type *new_ptr = (type *)malloc(new_size);                                                                      \
+        type *new_ptr = (type *)alloc_mem(at_Slice, new_size);                                                         \
         if (new_ptr == nil) {                                                                                          \
             fatal(1, "not enough memory to resize a slice");                                                           \
         }                                                                                                              \
@@ -98,9 +101,24 @@ u32 get_new_cap(u32 cap);
         s->len++;                                                                                                      \
     }                                                                                                                  \
                                                                                                                        \
+    /* replaces elements in range [start, end) with a copy of given items */                                        \
+    void splice_slice_of_##type##s(slice_of_##type##s *s, u32 start, u32 end, slice_of_##type##s items) {              \
+        u32 new_len = s->len - (end - start) + items.len;                                                              \
+        if (new_len > s->cap || (!s->is_owner && new_len > 0)) {                                                       \
+            recap_slice_of_##type##s(s, new_len > s->len ? new_len : s->len);                                          \
+        }                                                                                                              \
+        if (end != start + items.len) {                                                                                \
+            memmove(s->elem + start + items.len, s->elem + end, ((u64)(s->len - end)) * ((u64)sizeof(type)));         \
+        }                                                                                                              \
+        if (items.len != 0) {                                                                                          \
+            memcpy(s->elem + start, items.elem, ((u64)items.len) * ((u64)sizeof(type)));                               \
+        }                                                                                                              \
+        s->len = new_len;                                                                                              \
+    }                                                                                                                  \
+                                                                                                                       \
     void free_slice_of_##type##s(slice_of_##type##s s) {                                                               \
         if (s.is_owner) {                                                                                              \
-            free(s.elem);                                                                                              \
+            free_mem(s.elem);                                                                                          \
         }                                                                                                              \
     }
 
@@ -1,10 +1,11 @@
 #include <errno.h>
 #include <fcntl.h>
-#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "alloc.h"
 #include "fatal.h"
 #include "source.h"
 
@@ -33,12 +34,13 @@ SourceReadErrCode read_all(int fd, byte *buf, u64 buf_size) {
 
 SourceReadResult read_source_from_fd(int fd) {
     SourceReadResult result;
+    result.err = 0;
 
     struct stat file_stat;
     int code = fstat(fd, &file_stat);
     if (code != 0) {
         result.erc = srec_StatFailed;
-
+        result.err = errno;
         return result;
     }
 
@@ -54,14 +56,17 @@ SourceReadResult read_source_from_fd(int fd) {
         return result;
     }
 
-    byte *bytes = (byte *)malloc(size);
+    byte *bytes = (byte *)alloc_mem(at_Source, size);
     if (bytes == nil) {
         fatal(1, "not enough memory to hold source text");
     }
 
     SourceReadErrCode erc = read_all(fd, bytes, size);
     if (erc != srec_NotAnError) {
-        free(bytes);
+        if (erc == srec_ReadError) {
+            result.err = errno;
+        }
+        free_mem(bytes);
         result.erc = erc;
         return result;
     }
@@ -71,50 +76,25 @@ SourceReadResult read_source_from_fd(int fd) {
     return result;
 }
 
-void print_open_err(int err) {
-    switch (err) {
-    case EACCES:
-        printf("EACCES\n");
-        break;
-    case EEXIST:
-        printf("EEXIST\n");
-        break;
-    case EINTR:
-        printf("EINTR\n");
-        break;
-    case EISDIR:
-        printf("EISDIR\n");
-        break;
-    case EMFILE:
-        printf("EMFILE\n");
-        break;
-    case ENFILE:
-        printf("ENFILE\n");
-        break;
-    case ENOENT:
-        printf("ENOENT\n");
-        break;
-    case ENOSPC:
-        printf("ENOSPC\n");
-        break;
-    case ENXIO:
-        printf("ENXIO\n");
-        break;
-    case EROFS:
-        printf("EROFS\n");
-        break;
-    case ENAMETOOLONG:
-        printf("ENAMETOOLONG\n");
-        break;
-    case ENOTDIR:
-        printf("ENOTDIR\n");
-        break;
-    case ELOOP:
-        printf("ELOOP\n");
-        break;
-    default:
-        printf("UNKNOWN %d\n", err);
+// texts of errors which are not caused by failed system call
+const char *source_read_err_texts[] = {
+    [srec_NotAnError]          = "no error",
+    [srec_OpenFailed]          = "open failed",
+    [srec_StatFailed]          = "stat failed",
+    [srec_NonPositiveFileSize] = "file is empty",
+    [srec_FileTooLarge]        = "file is too large",
+    [srec_ReadError]           = "read failed",
+    [srec_InconsistentSize]    = "file size changed while reading",
+};
+
+// describe_source_read_error returns text of error for given code and
+// errno value saved by read functions, zero errno means code alone describes
+// the error. Text of errno is not thread safe, call it from one thread only
+const char *describe_source_read_error(SourceReadErrCode erc, int err) {
+    if (err != 0) {
+        return strerror(err);
     }
+    return source_read_err_texts[erc];
 }
 
 SourceReadResult read_source_from_file(char *path) {
@@ -123,7 +103,7 @@ SourceReadResult read_source_from_file(char *path) {
     int fd = open(path, O_RDONLY);
     if (fd < 0) {
         result.erc = srec_OpenFailed;
-        print_open_err(errno);
+        result.err = errno;
         return result;
     }
 
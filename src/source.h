@@ -29,10 +29,14 @@ enum SourceReadErrCode {
 struct SourceReadResult {
     SourceText source;
     SourceReadErrCode erc;
+
+    // value of errno if system call failed, zero otherwise
+    int err;
 };
 
 SourceReadResult read_source_from_file(char *path);
 SourceText new_source_from_str(str s);
+const char *describe_source_read_error(SourceReadErrCode erc, int err);
 void free_source(SourceText source);
 
 #endif // KU_SOURCE_H
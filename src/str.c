@@ -2,10 +2,41 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "alloc.h"
 #include "charset.h"
 #include "fatal.h"
 #include "str.h"
 
+// Search functions below examine BYTE_VECTOR_SIZE bytes at once when vector
+// instructions are available. AVX2 is used only if compiler targets it, e.g.
+// with -mavx2 or -march=native, SSE2 is always present on x86-64. Scalar
+// loops handle tails shorter than vector and other architectures
+#if defined(__AVX2__)
+
+#define BYTE_VECTOR_SIZE 32
+typedef __m256i byte_vector;
+
+#define load_byte_vector(p) _mm256_loadu_si256((const __m256i *)(p))
+#define broadcast_byte_vector(b) _mm256_set1_epi8((char)(b))
+#define match_byte_vector(v, x) ((u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, x)))
+#define full_byte_vector_mask 0xFFFFFFFFu
+
+#elif defined(__SSE2__)
+
+#define BYTE_VECTOR_SIZE 16
+typedef __m128i byte_vector;
+
+#define load_byte_vector(p) _mm_loadu_si128((const __m128i *)(p))
+#define broadcast_byte_vector(b) _mm_set1_epi8((char)(b))
+#define match_byte_vector(v, x) ((u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, x)))
+#define full_byte_vector_mask 0xFFFFu
+
+#endif
+
 const u8 max_u32_decimal_length = 10;
 const u8 max_u64_decimal_length = 20;
 
@@ -53,13 +84,19 @@ str new_str_from_cstr(const char *cstr) {
 }
 
 str new_str_from_bytes(const byte *bytes, u64 size) {
+    return new_tagged_str_from_bytes(at_String, bytes, size);
+}
+
+// new_tagged_str_from_bytes is the same as new_str_from_bytes, but memory
+// is accounted under given allocation tag
+str new_tagged_str_from_bytes(AllocTag tag, const byte *bytes, u64 size) {
     if (size == 0) {
         return empty_str;
     } else if (size == 1) {
         return new_str_from_byte(bytes[0]);
     }
 
-    byte *new_bytes = (byte *)malloc(size);
+    byte *new_bytes = (byte *)alloc_mem(tag, size);
     if (new_bytes == nil) {
         fatal(1, "not enough memory for new string");
     }
@@ -181,7 +218,7 @@ str format_u32_as_decimal(u32 n) {
         return format_small_decimal((u8)n);
     }
 
-    byte *bytes = (byte *)malloc(max_u32_decimal_length);
+    byte *bytes = (byte *)alloc_mem(at_String, max_u32_decimal_length);
     if (bytes == nil) {
         fatal(1, "not enough memory for new string");
     }
@@ -200,7 +237,7 @@ str format_u64_as_decimal(u64 n) {
         return format_small_decimal((u8)n);
     }
 
-    byte *bytes = (byte *)malloc(max_u64_decimal_length);
+    byte *bytes = (byte *)alloc_mem(at_String, max_u64_decimal_length);
     if (bytes == nil) {
         fatal(1, "not enough memory for new string");
     }
@@ -295,7 +332,7 @@ str new_str_from_str(str s) {
         return new_str_from_byte(s.bytes[0]);
     }
 
-    byte *bytes = (byte *)malloc(s.len);
+    byte *bytes = (byte *)alloc_mem(at_String, s.len);
     if (bytes == nil) {
         fatal(1, "not enough memory for new string");
     }
@@ -336,8 +373,19 @@ u64 index_other_byte_in_str(str s, byte b) {
 }
 
 u64 index_other_byte_in_str_from(str s, byte b, u64 pos) {
-    u64 i;
-    for (i = pos; i < s.len && s.bytes[i] == b; i++) {
+    u64 i = pos;
+
+#if defined(BYTE_VECTOR_SIZE)
+    byte_vector x = broadcast_byte_vector(b);
+    for (; i + BYTE_VECTOR_SIZE <= s.len; i += BYTE_VECTOR_SIZE) {
+        u32 mask = match_byte_vector(load_byte_vector(s.bytes + i), x) ^ full_byte_vector_mask;
+        if (mask != 0) {
+            return i + (u64)__builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < s.len && s.bytes[i] == b; i++) {
     }
     return i;
 }
@@ -347,23 +395,99 @@ u64 index_byte_in_str(str s, byte b) {
 }
 
 u64 index_byte_in_str_from(str s, byte b, u64 pos) {
-    u64 i;
-    for (i = pos; i < s.len && s.bytes[i] != b; i++) {
+    u64 i = pos;
+
+#if defined(BYTE_VECTOR_SIZE)
+    byte_vector x = broadcast_byte_vector(b);
+    for (; i + BYTE_VECTOR_SIZE <= s.len; i += BYTE_VECTOR_SIZE) {
+        u32 mask = match_byte_vector(load_byte_vector(s.bytes + i), x);
+        if (mask != 0) {
+            return i + (u64)__builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < s.len && s.bytes[i] != b; i++) {
     }
     return i;
 }
 
 u64 index_last_byte_in_str(str s, byte b) {
-    if (s.len == 0) {
-        return 0;
+    u64 end = s.len;
+
+#if defined(BYTE_VECTOR_SIZE)
+    // vectors are taken from the end, end points past the last one checked
+    byte_vector x = broadcast_byte_vector(b);
+    for (; end >= BYTE_VECTOR_SIZE; end -= BYTE_VECTOR_SIZE) {
+        u32 mask = match_byte_vector(load_byte_vector(s.bytes + end - BYTE_VECTOR_SIZE), x);
+        if (mask != 0) {
+            return end - BYTE_VECTOR_SIZE + 31 - (u64)__builtin_clz(mask);
+        }
     }
-    u64 i;
-    for (i = s.len - 1; i > 0 && s.bytes[i] != b; i--) {
+#endif
+
+    for (u64 i = end; i > 0; i--) {
+        if (s.bytes[i - 1] == b) {
+            return i - 1;
+        }
     }
-    if (s.bytes[i] != b) {
+    return s.len;
+}
+
+u64 index_str_in_str(str s, str substr) {
+    return index_str_in_str_from(s, substr, 0);
+}
+
+// Candidate positions are found by comparing both the first and the last byte
+// of substr with corresponding bytes of s for a whole vector of positions at
+// once. Two bytes filter out almost all false positives, so remaining bytes
+// are compared only for few candidates
+u64 index_str_in_str_from(str s, str substr, u64 pos) {
+    if (pos > s.len || substr.len > s.len - pos) {
         return s.len;
     }
-    return i;
+    if (substr.len == 0) {
+        return pos;
+    }
+    if (substr.len == 1) {
+        return index_byte_in_str_from(s, substr.bytes[0], pos);
+    }
+
+    u64 i    = pos;
+    u64 last = substr.len - 1;
+    byte b   = substr.bytes[0];
+
+#if defined(BYTE_VECTOR_SIZE)
+    byte_vector first_x = broadcast_byte_vector(b);
+    byte_vector last_x  = broadcast_byte_vector(substr.bytes[last]);
+    for (; i + last + BYTE_VECTOR_SIZE <= s.len; i += BYTE_VECTOR_SIZE) {
+        u32 mask = match_byte_vector(load_byte_vector(s.bytes + i), first_x) &
+                   match_byte_vector(load_byte_vector(s.bytes + i + last), last_x);
+        for (; mask != 0; mask &= mask - 1) {
+            u64 j = i + (u64)__builtin_ctz(mask);
+            if (memcmp(s.bytes + j + 1, substr.bytes + 1, last - 1) == 0) {
+                return j;
+            }
+        }
+    }
+#endif
+
+    for (; i + last < s.len; i++) {
+        if (s.bytes[i] == b && memcmp(s.bytes + i + 1, substr.bytes + 1, last) == 0) {
+            return i;
+        }
+    }
+    return s.len;
+}
+
+char *str_to_cstr(str s) {
+    char *cstr = (char *)alloc_mem(at_String, s.len + 1);
+    if (cstr == nil) {
+        fatal(1, "not enough memory for new c string");
+    }
+    memcpy(cstr, s.bytes, s.len);
+    cstr[s.len] = 0;
+    return cstr;
 }
 
 void print_str(str s) {
@@ -391,5 +515,5 @@ void free_str(str s) {
     if (s.origin == nil) {
         return;
     }
-    free(s.origin);
+    free_mem(s.origin);
 }
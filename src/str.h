@@ -1,6 +1,7 @@
 #ifndef KU_STR_H
 #define KU_STR_H
 
+#include "alloc.h"
 #include "types.h"
 
 #define STR(s)                                                                                                         \
@@ -35,6 +36,7 @@ extern const str empty_str;
 
 str new_str_from_cstr(const char *s);
 str new_str_from_bytes(const byte *bytes, u64 size);
+str new_tagged_str_from_bytes(AllocTag tag, const byte *bytes, u64 size);
 str new_str_from_byte(byte b);
 str new_str_from_str(str s);
 str new_str_slice(str s, u64 start, u64 end);
@@ -64,6 +66,8 @@ u64 index_byte_in_str_from(str s, byte b, u64 pos);
 u64 index_other_byte_in_str(str s, byte b);
 u64 index_other_byte_in_str_from(str s, byte b, u64 pos);
 u64 index_last_byte_in_str(str s, byte b);
+u64 index_str_in_str(str s, str substr);
+u64 index_str_in_str_from(str s, str substr, u64 pos);
 char *str_to_cstr(str s);
 void print_str(str s);
 void print_indent_str(u8 spaces, str s);
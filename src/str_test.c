@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "str.h"
+#include "strop.h"
+
+typedef struct SearchTestInput SearchTestInput;
+
+// SearchTestInput is randomly generated haystack together with search
+// arguments for all tested functions
+struct SearchTestInput {
+    str s;
+    str substr;
+    u64 pos;
+    byte b;
+};
+
+// number of random inputs checked for each function
+const u32 number_of_random_checks = 200000;
+
+// haystacks are longer than several vectors so that vector loops and scalar
+// tails are both exercised, small alphabet makes matches frequent
+#define MAX_RANDOM_STR_LENGTH 300
+#define MAX_RANDOM_SUBSTR_LENGTH 40
+
+const byte random_str_alphabet[] = "aab\n";
+
+const str pass_str  = STR("    str_test [ OK ]");
+const str fail_str  = STR("[ FAILED ]");
+const str func_str  = STR("Function: ");
+const str input_str = STR("Input: ");
+const str want_str  = STR("Want: ");
+const str got_str   = STR("Got:  ");
+
+const str index_byte_name       = STR("index_byte_in_str_from");
+const str index_other_byte_name = STR("index_other_byte_in_str_from");
+const str index_last_byte_name  = STR("index_last_byte_in_str");
+const str index_str_name        = STR("index_str_in_str_from");
+const str split_name            = STR("borrow_split_str_by_byte");
+
+void print_failed_check(str name, SearchTestInput input, u64 want, u64 got) {
+    str want_num = format_u64_as_decimal(want);
+    str got_num  = format_u64_as_decimal(got);
+
+    println();
+    println_str(fail_str);
+    print_str(func_str);
+    println_str(name);
+    print_str(input_str);
+    print_str(input.s);
+    fwrite(" | ", 1, 3, stdout);
+    print_str(input.substr);
+    printf(" | pos=%llu byte=%u\n", (unsigned long long)input.pos, input.b);
+    print_str(want_str);
+    println_str(want_num);
+    print_str(got_str);
+    println_str(got_num);
+
+    free_str(want_num);
+    free_str(got_num);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+u64 next_random(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+void fill_random_bytes(u64 *state, byte *bytes, u64 len) {
+    for (u64 i = 0; i < len; i++) {
+        bytes[i] = random_str_alphabet[next_random(state) % (sizeof(random_str_alphabet) - 1)];
+    }
+}
+
+// Reference implementations below are plain byte loops which define
+// expected results
+
+u64 reference_index_byte(str s, byte b, u64 pos) {
+    u64 i = pos;
+    while (i < s.len && s.bytes[i] != b) {
+        i++;
+    }
+    return i;
+}
+
+u64 reference_index_other_byte(str s, byte b, u64 pos) {
+    u64 i = pos;
+    while (i < s.len && s.bytes[i] == b) {
+        i++;
+    }
+    return i;
+}
+
+u64 reference_index_last_byte(str s, byte b) {
+    u64 found = s.len;
+    for (u64 i = 0; i < s.len; i++) {
+        if (s.bytes[i] == b) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+u64 reference_index_str(str s, str substr, u64 pos) {
+    for (u64 i = pos; i + substr.len <= s.len; i++) {
+        if (has_substr_at(s, substr, i)) {
+            return i;
+        }
+    }
+    return s.len;
+}
+
+// check_split compares pieces returned by borrow_split_str_by_byte with
+// pieces found by reference loop
+bool check_split(SearchTestInput input) {
+    str s             = input.s;
+    slice_of_strs got = borrow_split_str_by_byte(s, input.b);
+
+    u64 n       = 0;
+    u64 start   = 0;
+    bool failed = false;
+    for (u64 i = 0; i <= s.len; i++) {
+        if (i < s.len && s.bytes[i] != input.b) {
+            continue;
+        }
+        if (i > start) {
+            if (n < got.len && !are_strs_equal(got.elem[n], borrow_str_slice(s, start, i))) {
+                failed = true;
+            }
+            n++;
+        }
+        start = i + 1;
+    }
+
+    // mismatched pieces are reported as difference in their count
+    if (failed || n != got.len) {
+        print_failed_check(split_name, input, n, failed ? n + 1 : got.len);
+        failed = true;
+    }
+    free_slice_of_strs(got);
+    return failed;
+}
+
+bool run_check(str name, SearchTestInput input, u64 want, u64 got) {
+    if (want == got) {
+        return false;
+    }
+    print_failed_check(name, input, want, got);
+    return true;
+}
+
+// run_random_checks stops at the first failed function to keep output short
+bool run_random_checks() {
+    u64 state = 0x2545F4914F6CDD1DULL;
+    byte bytes[MAX_RANDOM_STR_LENGTH];
+    byte substr_bytes[MAX_RANDOM_SUBSTR_LENGTH];
+
+    for (u32 i = 0; i < number_of_random_checks; i++) {
+        u64 len        = next_random(&state) % (MAX_RANDOM_STR_LENGTH + 1);
+        u64 substr_len = next_random(&state) % (MAX_RANDOM_SUBSTR_LENGTH + 1);
+        fill_random_bytes(&state, bytes, len);
+        fill_random_bytes(&state, substr_bytes, substr_len);
+
+        // half of substrings are taken from haystack to make sure that
+        // they are found
+        if (substr_len <= len && next_random(&state) % 2 == 0) {
+            u64 start = next_random(&state) % (len - substr_len + 1);
+            for (u64 j = 0; j < substr_len; j++) {
+                substr_bytes[j] = bytes[start + j];
+            }
+        }
+
+        SearchTestInput input = {
+            .s      = borrow_str_from_bytes(bytes, len),
+            .substr = borrow_str_from_bytes(substr_bytes, substr_len),
+            .pos    = next_random(&state) % (len + 1),
+            .b      = random_str_alphabet[next_random(&state) % (sizeof(random_str_alphabet) - 1)],
+        };
+        str s = input.s;
+
+        if (run_check(index_byte_name, input, reference_index_byte(s, input.b, input.pos),
+                index_byte_in_str_from(s, input.b, input.pos)) ||
+            run_check(index_other_byte_name, input, reference_index_other_byte(s, input.b, input.pos),
+                index_other_byte_in_str_from(s, input.b, input.pos)) ||
+            run_check(index_last_byte_name, input, reference_index_last_byte(s, input.b),
+                index_last_byte_in_str(s, input.b)) ||
+            run_check(index_str_name, input, reference_index_str(s, input.substr, input.pos),
+                index_str_in_str_from(s, input.substr, input.pos))) {
+            return true;
+        }
+
+        if (check_split(input)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    if (run_random_checks()) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -1,22 +1,43 @@
+#include <string.h>
+
 #include "strop.h"
 
 IMPLEMENT_SLICE(str)
+IMPLEMENT_SLICE(byte)
 
 slice_of_strs borrow_split_str_by_byte(str s, byte b) {
     slice_of_strs slice = empty_slice_of_strs;
     u64 start           = 0;
-    for (u64 i = 0; i < s.len; i++) {
-        if (s.bytes[i] == b) {
-            if (i > start) {
-                str substr = borrow_str_slice(s, start, i);
-                append_str_to_slice(&slice, substr);
-            }
-            start = i + 1;
+    while (start < s.len) {
+        u64 end = index_byte_in_str_from(s, b, start);
+        if (end > start) {
+            str substr = borrow_str_slice(s, start, end);
+            append_str_to_slice(&slice, substr);
         }
-    }
-    if (start < s.len) {
-        str substr = borrow_str_slice_to_end(s, start);
-        append_str_to_slice(&slice, substr);
+        start = end + 1;
     }
     return slice;
 }
+
+void append_str_to_bytes(slice_of_bytes *b, str s) {
+    u64 need = (u64)b->len + s.len;
+    if (need > b->cap) {
+        u32 cap = b->cap;
+        while (cap < need) {
+            cap = get_new_cap(cap);
+        }
+        recap_slice_of_bytes(b, cap);
+    }
+
+    slice_of_bytes items = {
+        .is_owner = false,
+        .elem     = s.bytes,
+        .len      = (u32)s.len,
+        .cap      = (u32)s.len,
+    };
+    splice_slice_of_bytes(b, b->len, b->len, items);
+}
+
+void append_cstr_to_bytes(slice_of_bytes *b, const char *s) {
+    append_str_to_bytes(b, borrow_str_from_bytes((const byte *)s, strlen(s)));
+}
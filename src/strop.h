@@ -6,7 +6,10 @@
 #include "slice.h"
 
 TYPEDEF_SLICE(str)
+TYPEDEF_SLICE(byte)
 
 slice_of_strs borrow_split_str_by_byte(str s, byte b);
+void append_str_to_bytes(slice_of_bytes *b, str s);
+void append_cstr_to_bytes(slice_of_bytes *b, const char *s);
 
 #endif // KU_STROP_H
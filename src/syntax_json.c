@@ -0,0 +1,357 @@
+#include "syntax_json.h"
+
+// Encoders of tokens and syntax tree nodes into JSON. Every node is an object
+// with "kind" field, field names follow names of corresponding C structs
+
+const str kind_json_key      = STR("kind");
+const str name_json_key      = STR("name");
+const str line_json_key      = STR("line");
+const str column_json_key    = STR("column");
+const str type_json_key      = STR("type");
+const str literal_json_key   = STR("literal");
+const str value_json_key     = STR("value");
+const str module_json_key    = STR("module");
+const str element_json_key   = STR("element");
+const str key_json_key       = STR("key");
+const str types_json_key     = STR("types");
+const str params_json_key    = STR("params");
+const str result_json_key    = STR("result");
+const str body_json_key      = STR("body");
+const str left_json_key      = STR("left");
+const str right_json_key     = STR("right");
+const str expr_json_key      = STR("expr");
+const str callee_json_key    = STR("callee");
+const str args_json_key      = STR("args");
+const str operator_json_key  = STR("operator");
+const str operand_json_key   = STR("operand");
+const str values_json_key    = STR("values");
+const str clauses_json_key   = STR("clauses");
+const str condition_json_key = STR("condition");
+const str else_json_key      = STR("else");
+const str count_json_key     = STR("count");
+
+void write_json_kind(JsonWriter *w, const char *kind) {
+    write_json_key(w, kind_json_key);
+    write_json_str(w, take_str_from_cstr((char *)kind));
+}
+
+void write_json_position(JsonWriter *w, Position pos) {
+    write_json_key(w, line_json_key);
+    write_json_u64(w, pos.line);
+    write_json_key(w, column_json_key);
+    write_json_u64(w, pos.column);
+}
+
+// write_token_json writes token as object with its position, type and
+// literal, literal is omitted for tokens which have static literal
+void write_token_json(JsonWriter *w, Token token) {
+    begin_json_object(w);
+    write_json_position(w, token.pos);
+    write_json_key(w, type_json_key);
+    write_json_str(w, token_type_strings[token.type]);
+    if (!has_static_literal(token.type)) {
+        write_json_key(w, literal_json_key);
+        write_json_str(w, token.literal);
+    }
+    end_json_object(w);
+}
+
+void write_identifier_json(JsonWriter *w, Identifier ident) {
+    begin_json_object(w);
+    write_json_kind(w, "identifier");
+    write_json_key(w, name_json_key);
+    write_json_str(w, ident.token.literal);
+    write_json_position(w, ident.token.pos);
+    end_json_object(w);
+}
+
+void write_type_specifier_json(JsonWriter *w, TypeSpecifier type_specifier);
+
+void write_type_literal_json(JsonWriter *w, TypeLiteral type_literal) {
+    switch (type_literal.type) {
+    case tlt_Slice:
+        write_json_kind(w, "slice");
+        write_json_key(w, element_json_key);
+        write_type_specifier_json(w, ((SliceTypeLiteral *)type_literal.ptr)->element_type);
+        break;
+    case tlt_Map: {
+        MapTypeLiteral *map_type_literal = (MapTypeLiteral *)type_literal.ptr;
+        write_json_kind(w, "map");
+        write_json_key(w, key_json_key);
+        write_type_specifier_json(w, map_type_literal->key_type);
+        write_json_key(w, value_json_key);
+        write_type_specifier_json(w, map_type_literal->value_type);
+        break;
+    }
+    default:
+        write_json_kind(w, "literal");
+        break;
+    }
+}
+
+void write_type_specifier_json(JsonWriter *w, TypeSpecifier type_specifier) {
+    begin_json_object(w);
+    switch (type_specifier.type) {
+    case tst_Name:
+        write_json_kind(w, "name");
+        write_json_key(w, name_json_key);
+        write_json_str(w, ((TypeName *)type_specifier.ptr)->name.token.literal);
+        break;
+    case tst_QualifiedName: {
+        TypeName *type_name = (TypeName *)type_specifier.ptr;
+        write_json_kind(w, "qualified_name");
+        write_json_key(w, module_json_key);
+        write_json_str(w, type_name->module_name.token.literal);
+        write_json_key(w, name_json_key);
+        write_json_str(w, type_name->name.token.literal);
+        break;
+    }
+    case tst_Literal:
+        write_type_literal_json(w, *(TypeLiteral *)type_specifier.ptr);
+        break;
+    default:
+        write_json_kind(w, "unknown");
+        break;
+    }
+    end_json_object(w);
+}
+
+void write_parameter_declarations_json(JsonWriter *w, slice_of_ParameterDeclarations decls) {
+    begin_json_array(w);
+    for (u32 i = 0; i < decls.len; i++) {
+        ParameterDeclaration decl = decls.elem[i];
+        for (u32 j = 0; j < decl.names.len; j++) {
+            begin_json_object(w);
+            write_json_kind(w, "parameter");
+            write_json_key(w, name_json_key);
+            write_json_str(w, decl.names.elem[j].token.literal);
+            write_json_position(w, decl.names.elem[j].token.pos);
+            write_json_key(w, type_json_key);
+            write_type_specifier_json(w, decl.type_specifier);
+            end_json_object(w);
+        }
+    }
+    end_json_array(w);
+}
+
+void write_function_result_json(JsonWriter *w, FunctionResult result) {
+    begin_json_object(w);
+    switch (result.type) {
+    case frt_Void:
+        write_json_kind(w, "void");
+        break;
+    case frt_Simple:
+        write_json_kind(w, "simple");
+        write_json_key(w, type_json_key);
+        write_type_specifier_json(w, ((SimpleResult *)result.ptr)->type_specifier);
+        break;
+    case frt_TupleSignature: {
+        slice_of_TypeSpecifiers types = ((TupleSignatureResult *)result.ptr)->type_specifiers;
+        write_json_kind(w, "tuple_signature");
+        write_json_key(w, types_json_key);
+        begin_json_array(w);
+        for (u32 i = 0; i < types.len; i++) {
+            write_type_specifier_json(w, types.elem[i]);
+        }
+        end_json_array(w);
+        break;
+    }
+    case frt_TypedTuple:
+        write_json_kind(w, "typed_tuple");
+        write_json_key(w, params_json_key);
+        write_parameter_declarations_json(w, ((TypedTupleResult *)result.ptr)->parameter_declarations);
+        break;
+    }
+    end_json_object(w);
+}
+
+void write_expression_json(JsonWriter *w, Expression expr);
+
+void write_expressions_json(JsonWriter *w, slice_of_Expressions exprs) {
+    begin_json_array(w);
+    for (u32 i = 0; i < exprs.len; i++) {
+        write_expression_json(w, exprs.elem[i]);
+    }
+    end_json_array(w);
+}
+
+void write_literal_json(JsonWriter *w, const char *kind, Token token) {
+    begin_json_object(w);
+    write_json_kind(w, kind);
+    write_json_key(w, value_json_key);
+    write_json_str(w, token.literal);
+    write_json_position(w, token.pos);
+    end_json_object(w);
+}
+
+void write_expression_json(JsonWriter *w, Expression expr) {
+    switch (expr.type) {
+    case et_Identifier:
+        write_identifier_json(w, *(Identifier *)expr.ptr);
+        break;
+    case et_IntegerLiteral:
+        write_literal_json(w, "integer", ((Integer *)expr.ptr)->token);
+        break;
+    case et_FloatLiteral:
+        write_literal_json(w, "float", ((Float *)expr.ptr)->token);
+        break;
+    case et_StringLiteral:
+        write_literal_json(w, "string", ((String *)expr.ptr)->token);
+        break;
+    case et_Unary: {
+        UnaryExpression *unary = (UnaryExpression *)expr.ptr;
+        begin_json_object(w);
+        write_json_kind(w, "unary");
+        write_json_key(w, operator_json_key);
+        write_json_str(w, token_type_strings[unary->operator.type]);
+        write_json_position(w, unary->operator.pos);
+        write_json_key(w, operand_json_key);
+        write_expression_json(w, unary->operand);
+        end_json_object(w);
+        break;
+    }
+    case et_Binary: {
+        BinaryExpression *binary = (BinaryExpression *)expr.ptr;
+        begin_json_object(w);
+        write_json_kind(w, "binary");
+        write_json_key(w, operator_json_key);
+        write_json_str(w, token_type_strings[binary->operator.type]);
+        write_json_position(w, binary->operator.pos);
+        write_json_key(w, left_json_key);
+        write_expression_json(w, binary->left);
+        write_json_key(w, right_json_key);
+        write_expression_json(w, binary->right);
+        end_json_object(w);
+        break;
+    }
+    case et_Call: {
+        CallExpression *call = (CallExpression *)expr.ptr;
+        begin_json_object(w);
+        write_json_kind(w, "call");
+        write_json_key(w, callee_json_key);
+        write_json_str(w, call->name.token.literal);
+        write_json_key(w, args_json_key);
+        write_expressions_json(w, call->args);
+        end_json_object(w);
+        break;
+    }
+    default:
+        begin_json_object(w);
+        write_json_kind(w, "unknown");
+        end_json_object(w);
+        break;
+    }
+}
+
+void write_block_json(JsonWriter *w, BlockStatement block);
+
+void write_statement_json(JsonWriter *w, Statement stmt) {
+    begin_json_object(w);
+    switch (stmt.type) {
+    case st_Define: {
+        DefineStatement *dstmt = (DefineStatement *)stmt.ptr;
+        write_json_kind(w, "define");
+        write_json_key(w, left_json_key);
+        write_expressions_json(w, dstmt->left);
+        write_json_key(w, right_json_key);
+        write_expressions_json(w, dstmt->right);
+        break;
+    }
+    case st_Expression:
+        write_json_kind(w, "expression");
+        write_json_key(w, expr_json_key);
+        write_expression_json(w, *(Expression *)stmt.ptr);
+        break;
+    case st_Assign: {
+        AssignStatement *astmt = (AssignStatement *)stmt.ptr;
+        write_json_kind(w, "assign");
+        write_json_key(w, operator_json_key);
+        write_json_str(w, token_type_strings[astmt->operator.type]);
+        write_json_position(w, astmt->operator.pos);
+        write_json_key(w, left_json_key);
+        write_expressions_json(w, astmt->left);
+        write_json_key(w, right_json_key);
+        write_expressions_json(w, astmt->right);
+        break;
+    }
+    case st_Return: {
+        ReturnStatement *rstmt = (ReturnStatement *)stmt.ptr;
+        write_json_kind(w, "return");
+        write_json_position(w, rstmt->token.pos);
+        write_json_key(w, values_json_key);
+        write_expressions_json(w, rstmt->values);
+        break;
+    }
+    case st_If: {
+        IfStatement *istmt = (IfStatement *)stmt.ptr;
+        write_json_kind(w, "if");
+        write_json_key(w, clauses_json_key);
+        begin_json_array(w);
+        for (u32 i = 0; i < istmt->clauses.len; i++) {
+            begin_json_object(w);
+            write_json_key(w, condition_json_key);
+            write_expression_json(w, istmt->clauses.elem[i].condition);
+            write_json_key(w, body_json_key);
+            write_block_json(w, istmt->clauses.elem[i].body);
+            end_json_object(w);
+        }
+        end_json_array(w);
+        if (istmt->else_body != nil) {
+            write_json_key(w, else_json_key);
+            write_block_json(w, *istmt->else_body);
+        }
+        break;
+    }
+    case st_Loop: {
+        LoopStatement *lstmt = (LoopStatement *)stmt.ptr;
+        write_json_kind(w, "loop");
+        write_json_position(w, lstmt->token.pos);
+        if (lstmt->count.ptr != nil) {
+            write_json_key(w, count_json_key);
+            write_expression_json(w, lstmt->count);
+        }
+        write_json_key(w, body_json_key);
+        write_block_json(w, lstmt->body);
+        break;
+    }
+    case st_While: {
+        WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+        write_json_kind(w, "while");
+        write_json_key(w, condition_json_key);
+        write_expression_json(w, wstmt->condition);
+        write_json_key(w, body_json_key);
+        write_block_json(w, wstmt->body);
+        break;
+    }
+    case st_Empty:
+        write_json_kind(w, "empty");
+        break;
+    default:
+        write_json_kind(w, "unknown");
+        break;
+    }
+    end_json_object(w);
+}
+
+void write_block_json(JsonWriter *w, BlockStatement block) {
+    begin_json_array(w);
+    for (u32 i = 0; i < block.statements.len; i++) {
+        write_statement_json(w, block.statements.elem[i]);
+    }
+    end_json_array(w);
+}
+
+void write_function_definition_json(JsonWriter *w, FunctionDefinition def) {
+    begin_json_object(w);
+    write_json_kind(w, "function");
+    write_json_key(w, name_json_key);
+    write_json_str(w, def.declaration.name.token.literal);
+    write_json_position(w, def.declaration.name.token.pos);
+    write_json_key(w, params_json_key);
+    write_parameter_declarations_json(w, def.declaration.parameters.parameter_declarations);
+    write_json_key(w, result_json_key);
+    write_function_result_json(w, def.declaration.result);
+    write_json_key(w, body_json_key);
+    write_block_json(w, def.body);
+    end_json_object(w);
+}
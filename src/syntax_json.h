@@ -0,0 +1,13 @@
+#ifndef KU_SYNTAX_JSON_H
+#define KU_SYNTAX_JSON_H
+
+#include "ast.h"
+#include "json.h"
+#include "token.h"
+
+void write_json_position(JsonWriter *w, Position pos);
+void write_token_json(JsonWriter *w, Token token);
+void write_statement_json(JsonWriter *w, Statement stmt);
+void write_function_definition_json(JsonWriter *w, FunctionDefinition def);
+
+#endif // KU_SYNTAX_JSON_H
@@ -5,9 +5,6 @@
 #include "types.h"
 #include <stdio.h>
 
-TYPEDEF_SLICE(Token);
-IMPLEMENT_SLICE(Token);
-
 typedef struct ScannerTestCase ScannerTestCase;
 typedef struct ScannerTestSuite ScannerTestSuite;
 
@@ -37,6 +34,8 @@ const str case_str = STR("Test case: ");
 const str want_str = STR("Want: ");
 const str got_str  = STR("Got:  ");
 
+const str keyword_str = STR("Keyword is not found in its slot: ");
+
 u32 run_test_cases(slice_of_ScannerTestCases test_cases) {
     u32 failed = 0;
     for (u32 i = 0; i < test_cases.len; i++) {
@@ -65,8 +64,24 @@ u32 run_test_cases(slice_of_ScannerTestCases test_cases) {
     return failed;
 }
 
+// check_keyword_lookup verifies that each keyword is found by lookup, slots
+// of keyword table are listed by hand and would be missed otherwise
+u32 check_keyword_lookup() {
+    u32 failed = 0;
+    for (u32 type = tt_begin_keyword + 1; type < tt_end_keyword; type++) {
+        TokenLookupResult result = lookup_keyword(token_type_strings[type]);
+        if (!result.ok || result.type != (TokenType)type) {
+            failed++;
+            println();
+            print_str(keyword_str);
+            println_str(token_type_strings[type]);
+        }
+    }
+    return failed;
+}
+
 int run_test_suite(ScannerTestSuite suite) {
-    u32 failed_test_cases = run_test_cases(suite.cases);
+    u32 failed_test_cases = run_test_cases(suite.cases) + check_keyword_lookup();
     if (failed_test_cases > 0) {
         return 1;
     }
@@ -148,8 +163,6 @@ int main(int argc, char **argv) {
         fatal(1, "not enough arguments");
     }
 
-    init_token_module();
-
     char *path                   = argv[1];
     SourceReadResult read_result = read_source_from_file(path);
     if (read_result.erc != 0) {
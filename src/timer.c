@@ -1,42 +1,355 @@
+// clock_gettime, thread CPU clocks and syscall are not part of C11
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "timer.h"
+#include "trace.h"
+
+const char *phase_names[] = {
+    [ph_Read]    = "read",
+    [ph_Scan]    = "scan",
+    [ph_Parse]   = "parse",
+    [ph_Resolve] = "resolve",
+    [ph_Check]   = "check",
+    [ph_Fold]    = "fold",
+    [ph_Lower]   = "lower",
+    [ph_Sccp]    = "sccp",
+    [ph_Copy]    = "copy",
+    [ph_Gvn]     = "gvn",
+    [ph_Licm]    = "licm",
+    [ph_Dce]     = "dce",
+    [ph_Compile] = "compile",
+    [ph_Run]     = "run",
+    [ph_Codegen] = "codegen",
+    [ph_Link]    = "link",
+    [ph_Print]   = "print",
+};
+
+typedef struct HardwareCounterConfig HardwareCounterConfig;
+
+struct HardwareCounterConfig {
+    const char *name;
+    u32 type;
+    u64 config;
+};
+
+#define HW_CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+const HardwareCounterConfig hardware_counter_configs[] = {
+    [hc_Cycles]       = {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [hc_Instructions] = {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [hc_BranchMisses] = {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [hc_L1DMisses]    = {"L1D-misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    [hc_LLCMisses]    = {"LLC-misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL)},
+};
+
+// measurements are skipped unless timing is enabled, so that phase scopes
+// may be left in code without slowing down regular runs
+bool phase_timing_enabled = false;
 
-u64 get_clock() {
-    clock_t start_clock = clock();
-    if (start_clock < 0) {
+bool hardware_counters_enabled = false;
+
+// bit mask of counters which were opened by at least one thread
+atomic_uint opened_counters_mask = 0;
+
+// error of the first failed attempt to open a counter
+atomic_int counters_open_errno = 0;
+
+PhaseStats phase_stats[ph_end];
+
+// counters are opened lazily by each thread on its first phase scope,
+// descriptors stay open until process exit
+_Thread_local bool thread_counters_opened = false;
+_Thread_local CounterGroup thread_counters;
+
+u64 get_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
         return 0;
     }
-    return (u64)start_clock;
+    return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+// get_wall_time_ns returns monotonic wall clock time in nanoseconds, it is
+// not affected by system time changes and only differences between values
+// are meaningful
+u64 get_wall_time_ns() {
+    return get_clock_ns(CLOCK_MONOTONIC);
 }
 
-u64 get_clock_since(u64 start) {
-    return get_clock() - start;
+// get_thread_cpu_time_ns returns CPU time consumed by calling thread
+u64 get_thread_cpu_time_ns() {
+    return get_clock_ns(CLOCK_THREAD_CPUTIME_ID);
 }
 
-CPUTimer init_cpu_timer() {
-    CPUTimer timer = {
-        .mark    = get_clock(),
-        .elapsed = 0,
+// get_process_cpu_time_ns returns CPU time consumed by all threads of the process
+u64 get_process_cpu_time_ns() {
+    return get_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void enable_phase_timing() {
+    phase_timing_enabled = true;
+}
+
+// enable_hardware_counters turns on collection of CPU events in phase scopes,
+// counters which kernel does not allow to open are reported as unavailable
+void enable_hardware_counters() {
+    hardware_counters_enabled = true;
+}
+
+int open_perf_event(HardwareCounterConfig c, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = c.type;
+    attr.config         = c.config;
+    attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    // measure calling thread on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// open_counter_group opens all counters which are permitted and supported,
+// the first successfully opened counter becomes group leader
+void open_counter_group(CounterGroup *g) {
+    g->leader = -1;
+    g->opened = 0;
+    for (u32 i = 0; i < hc_end; i++) {
+        int fd = open_perf_event(hardware_counter_configs[i], g->leader);
+        g->fds[i] = fd;
+        if (fd < 0) {
+            int expected = 0;
+            atomic_compare_exchange_strong(&counters_open_errno, &expected, errno);
+            continue;
+        }
+        if (g->leader < 0) {
+            g->leader = fd;
+        }
+        g->slots[i] = g->opened;
+        g->opened++;
+        atomic_fetch_or(&opened_counters_mask, 1u << i);
+    }
+}
+
+CounterGroup *get_thread_counters() {
+    if (!thread_counters_opened) {
+        open_counter_group(&thread_counters);
+        thread_counters_opened = true;
+    }
+    return &thread_counters;
+}
+
+// read_counter_group stores current values of counters, values of counters which
+// are not opened are zero. If kernel multiplexed the group with other events,
+// values are scaled by the fraction of time group was actually running
+void read_counter_group(CounterGroup *g, u64 *values) {
+    memset(values, 0, hc_end * sizeof(u64));
+    if (g->leader < 0) {
+        return;
+    }
+
+    // number of values, time enabled, time running, values
+    u64 buf[3 + hc_end];
+    ssize_t n = read(g->leader, buf, sizeof(buf));
+    if (n < (ssize_t)(3 * sizeof(u64)) || buf[0] != g->opened) {
+        return;
+    }
+    double scale = 1.0;
+    if (buf[2] != 0 && buf[2] < buf[1]) {
+        scale = (double)buf[1] / (double)buf[2];
+    }
+    for (u32 i = 0; i < hc_end; i++) {
+        if (g->fds[i] >= 0) {
+            values[i] = (u64)((double)buf[3 + g->slots[i]] * scale);
+        }
+    }
+}
+
+// begin_phase starts measuring phase on current thread, phase is also recorded
+// as trace event with given argument if tracing is enabled
+PhaseScope begin_phase(Phase phase, str arg) {
+    begin_trace_event(phase_names[phase], arg);
+
+    PhaseScope scope = {
+        .phase      = phase,
+        .wall_start = 0,
+        .cpu_start  = 0,
     };
-    return timer;
+    if (!phase_timing_enabled && !hardware_counters_enabled) {
+        return scope;
+    }
+    if (hardware_counters_enabled) {
+        read_counter_group(get_thread_counters(), scope.counters_start);
+    }
+    scope.wall_start = get_wall_time_ns();
+    scope.cpu_start  = get_thread_cpu_time_ns();
+    return scope;
+}
+
+// end_phase adds measurements of the scope to stats of its phase, bytes and
+// tokens are amounts of data processed inside the scope
+void end_phase(PhaseScope scope, u64 bytes, u64 tokens) {
+    end_trace_event(phase_names[scope.phase]);
+    if (!phase_timing_enabled && !hardware_counters_enabled) {
+        return;
+    }
+    u64 cpu_ns  = get_thread_cpu_time_ns() - scope.cpu_start;
+    u64 wall_ns = get_wall_time_ns() - scope.wall_start;
+
+    PhaseStats *stats = &phase_stats[scope.phase];
+    if (hardware_counters_enabled) {
+        u64 counters[hc_end];
+        read_counter_group(get_thread_counters(), counters);
+        for (u32 i = 0; i < hc_end; i++) {
+            // scaled values of multiplexed counters may go slightly backwards
+            if (counters[i] > scope.counters_start[i]) {
+                atomic_fetch_add_explicit(
+                    &stats->counters[i], counters[i] - scope.counters_start[i], memory_order_relaxed);
+            }
+        }
+    }
+    atomic_fetch_add_explicit(&stats->scopes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->wall_ns, wall_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->cpu_ns, cpu_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->tokens, tokens, memory_order_relaxed);
+}
+
+// end_pass_phase finishes scope of optimization pass, instruction counts of
+// IR which pass received and produced are accumulated in phase stats
+void end_pass_phase(PhaseScope scope, u64 instructions_in, u64 instructions_out) {
+    end_phase(scope, 0, 0);
+    if (!phase_timing_enabled) {
+        return;
+    }
+    PhaseStats *stats = &phase_stats[scope.phase];
+    atomic_fetch_add_explicit(&stats->instructions_in, instructions_in, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->instructions_out, instructions_out, memory_order_relaxed);
 }
 
-u64 get_cpu_timer_clock(CPUTimer timer) {
-    if (timer.mark == 0) {
-        return timer.elapsed;
+void print_rate(u64 amount, u64 ns, double unit) {
+    if (amount == 0 || ns == 0) {
+        fprintf(stderr, "  %12s", "-");
+        return;
     }
-    return get_clock() - timer.mark + timer.elapsed;
+    fprintf(stderr, "  %12.2f", (double)amount / unit / ((double)ns / 1e9));
 }
 
-void start_cpu_timer(CPUTimer *timer) {
-    timer->elapsed = 0;
-    timer->mark    = get_clock();
+// print_pass_instructions_report writes how optimization passes changed
+// number of IR instructions, nothing is written if no pass was run
+void print_pass_instructions_report() {
+    bool header = false;
+    for (u32 i = 0; i < ph_end; i++) {
+        PhaseStats *stats = &phase_stats[i];
+
+        u64 in  = atomic_load(&stats->instructions_in);
+        u64 out = atomic_load(&stats->instructions_out);
+        if (in == 0) {
+            continue;
+        }
+        if (!header) {
+            fprintf(stderr, "\n%-7s  %12s  %12s  %12s\n", "pass", "instrs in", "instrs out", "delta");
+            header = true;
+        }
+        fprintf(stderr,
+            "%-7s  %12llu  %12llu  %+12lld\n",
+            phase_names[i],
+            (unsigned long long)in,
+            (unsigned long long)out,
+            (long long)out - (long long)in);
+    }
 }
 
-void pause_cpu_timer(CPUTimer *timer) {
-    timer->elapsed += get_clock() - timer->mark;
-    timer->mark = 0;
+// print_phase_timing_report writes accumulated phase stats to stderr, given
+// wall and CPU time of the whole run are printed as total
+void print_phase_timing_report(u64 wall_ns, u64 cpu_ns) {
+    fprintf(stderr, "%-7s  %8s  %12s  %12s  %12s  %12s\n", "phase", "scopes", "wall ms", "cpu ms", "MB/s", "Mtokens/s");
+    for (u32 i = 0; i < ph_end; i++) {
+        PhaseStats *stats = &phase_stats[i];
+
+        u64 scopes     = atomic_load(&stats->scopes);
+        u64 phase_wall = atomic_load(&stats->wall_ns);
+        u64 phase_cpu  = atomic_load(&stats->cpu_ns);
+        u64 bytes      = atomic_load(&stats->bytes);
+        u64 tokens     = atomic_load(&stats->tokens);
+        if (scopes == 0) {
+            continue;
+        }
+
+        fprintf(stderr,
+            "%-7s  %8llu  %12.3f  %12.3f",
+            phase_names[i],
+            (unsigned long long)scopes,
+            (double)phase_wall / 1e6,
+            (double)phase_cpu / 1e6);
+        print_rate(bytes, phase_wall, 1e6);
+        print_rate(tokens, phase_wall, 1e6);
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "%-7s  %8s  %12.3f  %12.3f\n", "total", "", (double)wall_ns / 1e6, (double)cpu_ns / 1e6);
+    print_pass_instructions_report();
 }
 
-void resume_cpu_timer(CPUTimer *timer) {
-    timer->mark = get_clock();
+void print_ratio(u64 amount, u64 base) {
+    if (base == 0) {
+        fprintf(stderr, "  %12s", "-");
+        return;
+    }
+    fprintf(stderr, "  %12.4f", (double)amount / (double)base);
+}
+
+// print_phase_counters_report writes accumulated hardware counters of each phase
+// to stderr, together with their ratios to processed bytes and tokens
+void print_phase_counters_report() {
+    u32 mask = atomic_load(&opened_counters_mask);
+    if (mask == 0) {
+        int err = atomic_load(&counters_open_errno);
+        fprintf(stderr, "hardware counters are unavailable: %s\n", err == 0 ? "not used" : strerror(err));
+        if (err == EACCES || err == EPERM) {
+            fprintf(stderr, "check /proc/sys/kernel/perf_event_paranoid\n");
+        }
+        return;
+    }
+
+    fprintf(stderr, "%-7s  %-14s  %16s  %12s  %12s\n", "phase", "counter", "total", "per byte", "per token");
+    for (u32 i = 0; i < ph_end; i++) {
+        PhaseStats *stats = &phase_stats[i];
+        if (atomic_load(&stats->scopes) == 0) {
+            continue;
+        }
+        u64 bytes  = atomic_load(&stats->bytes);
+        u64 tokens = atomic_load(&stats->tokens);
+
+        for (u32 j = 0; j < hc_end; j++) {
+            const char *phase_name = j == 0 ? phase_names[i] : "";
+            if ((mask & (1u << j)) == 0) {
+                fprintf(stderr, "%-7s  %-14s  %16s\n", phase_name, hardware_counter_configs[j].name, "n/a");
+                continue;
+            }
+            u64 value = atomic_load(&stats->counters[j]);
+            fprintf(stderr,
+                "%-7s  %-14s  %16llu",
+                phase_name,
+                hardware_counter_configs[j].name,
+                (unsigned long long)value);
+            print_ratio(value, bytes);
+            print_ratio(value, tokens);
+            fprintf(stderr, "\n");
+        }
+
+        u64 cycles = atomic_load(&stats->counters[hc_Cycles]);
+        if (cycles != 0) {
+            u64 instructions = atomic_load(&stats->counters[hc_Instructions]);
+            fprintf(stderr, "%-7s  %-14s  %16.3f\n", "", "IPC", (double)instructions / (double)cycles);
+        }
+    }
 }
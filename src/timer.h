@@ -1,25 +1,103 @@
 #ifndef KU_TIMER_H
 #define KU_TIMER_H
 
-#include <time.h>
+#include <stdatomic.h>
 
+#include "str.h"
 #include "types.h"
 
-typedef struct CPUTimer CPUTimer;
+typedef enum Phase Phase;
+typedef enum HardwareCounter HardwareCounter;
+typedef struct PhaseStats PhaseStats;
+typedef struct PhaseScope PhaseScope;
+typedef struct CounterGroup CounterGroup;
 
-struct CPUTimer {
-    u64 mark;
-    u64 elapsed;
+enum Phase {
+    ph_Read,    // reading source file into memory
+    ph_Scan,    // splitting source text into tokens
+    ph_Parse,   // building syntax tree, includes scanning done by parser
+    ph_Resolve, // binding identifiers to their declarations
+    ph_Check,   // assigning and checking types
+    ph_Fold,    // evaluating constant expressions
+    ph_Lower,   // translating syntax tree into intermediate representation
+    ph_Sccp,    // propagating constants along executable paths
+    ph_Copy,    // replacing block parameters which receive a single value
+    ph_Gvn,     // merging instructions which compute the same value
+    ph_Licm,    // hoisting loop invariant instructions out of loops
+    ph_Dce,     // removing unused instructions and unreachable blocks
+    ph_Compile, // translating intermediate representation into bytecode
+    ph_Run,     // executing bytecode
+    ph_Codegen, // writing native assembly
+    ph_Link,    // assembling and linking native executable
+    ph_Print,   // printing results
+
+    ph_end,
+};
+
+// HardwareCounter is an index of CPU event counted by CounterGroup
+enum HardwareCounter {
+    hc_Cycles,
+    hc_Instructions,
+    hc_BranchMisses,
+    hc_L1DMisses, // L1 data cache read misses
+    hc_LLCMisses, // last level cache read misses
+
+    hc_end,
+};
+
+// PhaseStats accumulates measurements of all scopes of a single phase.
+// Scopes may run concurrently on different threads, thus total wall time
+// of a phase may exceed wall time of the whole run
+struct PhaseStats {
+    atomic_uint_fast64_t scopes;
+    atomic_uint_fast64_t wall_ns;
+    atomic_uint_fast64_t cpu_ns;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t tokens;
+
+    // sums of IR instruction counts before and after optimization passes
+    atomic_uint_fast64_t instructions_in;
+    atomic_uint_fast64_t instructions_out;
+
+    // sums of hardware counters deltas, stay zero if counters are disabled
+    atomic_uint_fast64_t counters[hc_end];
 };
 
-u64 get_clock();
-u64 get_clock_since(u64 start);
+// PhaseScope measures a single execution of a phase on current thread
+struct PhaseScope {
+    Phase phase;
+    u64 wall_start;
+    u64 cpu_start;
+
+    u64 counters_start[hc_end];
+};
+
+// CounterGroup is a set of perf event counters of a single thread, which
+// are scheduled on CPU together and read with a single system call
+struct CounterGroup {
+    // file descriptor of group leader, -1 if no counter could be opened
+    int leader;
+
+    // file descriptors of counters, -1 for counters which failed to open
+    int fds[hc_end];
+
+    // position of counter value in group read result
+    u32 slots[hc_end];
+
+    // number of opened counters
+    u32 opened;
+};
 
-CPUTimer init_cpu_timer();
-u64 get_cpu_timer_clock(CPUTimer timer);
-void start_cpu_timer(CPUTimer *timer);
-void pause_cpu_timer(CPUTimer *timer);
-void resume_cpu_timer(CPUTimer *timer);
+u64 get_wall_time_ns();
+u64 get_thread_cpu_time_ns();
+u64 get_process_cpu_time_ns();
 
+void enable_phase_timing();
+void enable_hardware_counters();
+PhaseScope begin_phase(Phase phase, str arg);
+void end_phase(PhaseScope scope, u64 bytes, u64 tokens);
+void end_pass_phase(PhaseScope scope, u64 instructions_in, u64 instructions_out);
+void print_phase_timing_report(u64 wall_ns, u64 cpu_ns);
+void print_phase_counters_report();
 
 #endif // KU_TIMER_H
@@ -1,107 +1,119 @@
 #include <stdio.h>
+#include <unistd.h>
 
-#include "map.h"
 #include "token.h"
 
 const u8 position_format_width   = 12;
 const u8 token_type_format_width = 12;
 
-const u32 lookup_token_map_cap = 1 << 8;
-
-
-// These variables should be initialized through init_token_module() call
-map_str_u64 lookup_token_map = empty_map;
-u64 min_keyword_length       = UINT64_MAX;
-u64 max_keyword_length       = 0;
-
-str token_type_strings[] = {
-    // Non static or empty literals
-    [tt_Empty]              = STR("EMPTY"),
-    [tt_Illegal]            = STR("ILLEGAL"),
-    [tt_Comment]            = STR("COMMENT"),
-    [tt_EOF]                = STR("EOF"),
-    [tt_Terminator]         = STR("TERM"),
-    [tt_Identifier]         = STR("IDENT"),
-    [tt_String]             = STR("STR"),
-    [tt_Character]          = STR("CHAR"),
-    [tt_BinaryInteger]      = STR("BININT"),
-    [tt_OctalInteger]       = STR("OCTINT"),
-    [tt_DecimalInteger]     = STR("DECINT"),
-    [tt_HexadecimalInteger] = STR("HEXINT"),
-    [tt_DecimalFloat]       = STR("DECFLT"),
-
-    // Operators/punctuators
-    [tt_BlankIdentifier]    = STR("_"),
-    [tt_Plus]               = STR("+"),
-    [tt_Minus]              = STR("-"),
-    [tt_Equal]              = STR("=="),
-    [tt_NotEqual]           = STR("!="),
-    [tt_LessOrEqual]        = STR("<="),
-    [tt_GreaterOrEqual]     = STR(">="),
-    [tt_LeftArrow]          = STR("<-"),
-    [tt_RightArrow]         = STR("=>"),
-    [tt_Increment]          = STR("++"),
-    [tt_Decrement]          = STR("--"),
-    [tt_Define]             = STR(":="),
-    [tt_AddAssign]          = STR("+="),
-    [tt_SubtractAssign]     = STR("-="),
-    [tt_Assign]             = STR("="),
-    [tt_Colon]              = STR(":"),
-    [tt_Semicolon]          = STR(";"),
-    [tt_Asterisk]           = STR("*"),
-    [tt_Ampersand]          = STR("&"),
-    [tt_Not]                = STR("!"),
-    [tt_Slash]              = STR("/"),
-    [tt_Percent]            = STR("%"),
-    [tt_Period]             = STR("."),
-    [tt_Comma]              = STR(","),
-    [tt_Less]               = STR("<"),
-    [tt_Greater]            = STR(">"),
-    [tt_LeftCurlyBracket]   = STR("{"),
-    [tt_RightCurlyBracket]  = STR("}"),
-    [tt_LeftRoundBracket]   = STR("("),
-    [tt_RightRoundBracket]  = STR(")"),
-    [tt_LeftSquareBracket]  = STR("["),
-    [tt_RightSquareBracket] = STR("]"),
-
-    // Keywords
-    [tt_Import]    = STR("import"),
-    [tt_Function]  = STR("fn"),
-    [tt_Continue]  = STR("continue"),
-    [tt_Return]    = STR("return"),
-    [tt_Break]     = STR("break"),
-    [tt_Const]     = STR("const"),
-    [tt_Case]      = STR("case"),
-    [tt_For]       = STR("for"),
-    [tt_Else]      = STR("else"),
-    [tt_If]        = STR("if"),
-    [tt_ElseIf]    = STR("elif"),
-    [tt_Defer]     = STR("defer"),
-    [tt_Default]   = STR("default"),
-    [tt_Interface] = STR("interface"),
-    [tt_Map]       = STR("map"),
-    [tt_Module]    = STR("module"),
-    [tt_Dirty]     = STR("dirty"),
-    [tt_Immutable] = STR("imt"),
-    [tt_In]        = STR("in"),
-    [tt_Var]       = STR("var"),
-    [tt_Type]      = STR("type"),
-    [tt_Switch]    = STR("switch"),
-    [tt_Struct]    = STR("struct"),
-    [tt_Public]    = STR("pub"),
-    [tt_Ku]        = STR("ku"),
-    [tt_Select]    = STR("select"),
-    [tt_Package]   = STR("package"),
-    [tt_Goto]      = STR("goto"),
-    [tt_Channel]   = STR("chan"),
-    [tt_Loop]      = STR("loop"),
-    [tt_While]     = STR("while"),
+#define TOKEN_TYPE_STRING(name, s) [tt_##name] = STR(s),
+
+str token_type_strings[] = {TOKEN_LIST(TOKEN_TYPE_STRING)};
+
+typedef enum KeywordSlot KeywordSlot;
+typedef struct KeywordEntry KeywordEntry;
+
+// KeywordEntry holds keyword literal packed into two little-endian words, so
+// that candidate is compared with two loads instead of byte loop. Length of
+// keywords is limited by 16 bytes, which is checked at compile time below
+struct KeywordEntry {
+    u64 lo;
+    u64 hi;
+    u8 len;
+    u8 type;
+};
+
+// index is taken modulo string size to stay inside literal, bytes beyond its
+// length are replaced with zeros
+#define KEYWORD_BYTE(s, i) (((u64)(u8)(s)[(i) % sizeof(s)] * ((i) < sizeof(s) - 1)) << (8 * ((i) % 8)))
+
+#define KEYWORD_WORD(s, start)                                                                                         \
+    (KEYWORD_BYTE(s, start + 0) | KEYWORD_BYTE(s, start + 1) | KEYWORD_BYTE(s, start + 2) |                            \
+        KEYWORD_BYTE(s, start + 3) | KEYWORD_BYTE(s, start + 4) | KEYWORD_BYTE(s, start + 5) |                         \
+        KEYWORD_BYTE(s, start + 6) | KEYWORD_BYTE(s, start + 7))
+
+#define KEYWORD_ENTRY(name, s)                                                                                         \
+    {.lo = KEYWORD_WORD(s, 0), .hi = KEYWORD_WORD(s, 8), .len = sizeof(s) - 1, .type = tt_##name},
+#define KEYWORD_LENGTH_BIT(name, s) | (1u << (sizeof(s) - 1))
+#define KEYWORD_LENGTH_CHECK(name, s) _Static_assert(sizeof(s) - 1 <= 16, "keyword " s " is longer than 16 bytes");
+
+KEYWORD_TOKEN_LIST(KEYWORD_LENGTH_CHECK)
+_Static_assert(tt_end_keyword < 256, "keyword types do not fit into u8");
+
+// keywords are placed into table by multiplicative hash of their first word,
+// see hash_keyword_word. Bytes of string literals are not integer constant
+// expressions, so slots can not be computed from KEYWORD_TOKEN_LIST and are
+// listed here. Missing slot fails the build, slot shared by two keywords
+// fails it with -Woverride-init, and scanner test checks that each keyword
+// is found in its slot. New slots may be computed with the same hash, on
+// collision another odd multiplier must be picked and all slots recomputed
+#define KEYWORD_HASH_BITS 6
+
+const u64 keyword_hash_multiplier = 0xe06072104ca8468b;
+
+enum KeywordSlot {
+    ks_Break     = 3,
+    ks_Case      = 63,
+    ks_Channel   = 11,
+    ks_Const     = 42,
+    ks_Continue  = 52,
+    ks_If        = 29,
+    ks_Else      = 56,
+    ks_ElseIf    = 31,
+    ks_In        = 30,
+    ks_For       = 0,
+    ks_Loop      = 4,
+    ks_While     = 24,
+    ks_Defer     = 45,
+    ks_Function  = 53,
+    ks_Ku        = 55,
+    ks_Goto      = 54,
+    ks_Import    = 28,
+    ks_Interface = 16,
+    ks_Map       = 62,
+    ks_Package   = 13,
+    ks_Module    = 5,
+    ks_Return    = 34,
+    ks_Select    = 18,
+    ks_Struct    = 40,
+    ks_Switch    = 51,
+    ks_Type      = 37,
+    ks_Var       = 48,
+    ks_Dirty     = 39,
+    ks_Default   = 19,
+    ks_Immutable = 49,
+    ks_Public    = 58,
 };
 
+#define KEYWORD_TABLE_ENTRY(name, s) [ks_##name] = KEYWORD_ENTRY(name, s)
+
+// empty slots have zero length, which does not match any candidate
+const KeywordEntry keyword_table[1 << KEYWORD_HASH_BITS] = {KEYWORD_TOKEN_LIST(KEYWORD_TABLE_ENTRY)};
+
+// bit i is set if there is a keyword of length i
+const u32 keyword_length_mask = 0 KEYWORD_TOKEN_LIST(KEYWORD_LENGTH_BIT);
+
 bool has_static_literal(TokenType type) {
     return type > tt_end_no_static_literal;
 }
 
+TokenType get_assign_operation(TokenType type) {
+    switch (type) {
+    case tt_AddAssign:
+        return tt_Plus;
+    case tt_SubtractAssign:
+        return tt_Minus;
+    case tt_MultiplyAssign:
+        return tt_Asterisk;
+    case tt_QuotientAssign:
+        return tt_Slash;
+    case tt_RemainderAssign:
+        return tt_Percent;
+    default:
+        return tt_Empty;
+    }
+}
+
 bool is_keyword(TokenType type) {
     return tt_begin_keyword < type && type < tt_end_keyword;
 }
@@ -130,26 +142,37 @@ Token create_token(TokenType type, Position pos) {
     return token;
 }
 
+// load_keyword_word packs up to 8 bytes of string starting from given index
+// the same way as KEYWORD_WORD
+u64 load_keyword_word(str s, u64 start) {
+    u64 word = 0;
+    for (u64 i = start; i < s.len && i < start + 8; i++) {
+        word |= (u64)s.bytes[i] << (8 * (i - start));
+    }
+    return word;
+}
+
+u64 hash_keyword_word(u64 lo) {
+    return (lo * keyword_hash_multiplier) >> (64 - KEYWORD_HASH_BITS);
+}
+
 TokenLookupResult lookup_keyword(str s) {
     TokenLookupResult result;
-    if (s.len < min_keyword_length || s.len > max_keyword_length) {
+    if (s.len > 16 || (keyword_length_mask & (1u << s.len)) == 0) {
         result.ok = false;
         return result;
     }
 
-    result_u64 res = get_map_str_u64(lookup_token_map, s);
-    if (!res.ok) {
-        result.ok = false;
-        return result;
-    }
+    u64 lo             = load_keyword_word(s, 0);
+    KeywordEntry entry = keyword_table[hash_keyword_word(lo)];
 
-    if (!is_keyword(res.val)) {
+    // second word is zero for entries which are not longer than 8 bytes
+    if (entry.lo != lo || entry.len != s.len || (s.len > 8 && entry.hi != load_keyword_word(s, 8))) {
         result.ok = false;
         return result;
     }
-
     result.ok   = true;
-    result.type = res.val;
+    result.type = (TokenType)entry.type;
     return result;
 }
 
@@ -165,40 +188,19 @@ bool are_tokens_equal(Token t1, Token t2) {
     return are_strs_equal(t1.literal, t2.literal);
 }
 
-void init_token_lookup_map() {
-    lookup_token_map = new_map_str_u64(lookup_token_map_cap);
-    for (u64 type = tt_begin_no_static_literal + 1; type < tt_end_no_static_literal; type++) {
-        put_map_str_u64(&lookup_token_map, token_type_strings[type], type);
-    }
-    for (u64 type = tt_begin_operator + 1; type < tt_end_operator; type++) {
-        put_map_str_u64(&lookup_token_map, token_type_strings[type], type);
-    }
-    for (u64 type = tt_begin_keyword + 1; type < tt_end_keyword; type++) {
-        put_map_str_u64(&lookup_token_map, token_type_strings[type], type);
-    }
-    put_map_str_u64(&lookup_token_map, token_type_strings[tt_Empty], tt_Empty);
-    put_map_str_u64(&lookup_token_map, token_type_strings[tt_Terminator], tt_Terminator);
-    put_map_str_u64(&lookup_token_map, token_type_strings[tt_EOF], tt_EOF);
-}
-
-void init_keyword_length_vars() {
-    for (u64 type = tt_begin_keyword + 1; type < tt_end_keyword; type++) {
-        u64 len = token_type_strings[type].len;
-        if (min_keyword_length > len) {
-            min_keyword_length = len;
-        }
-        if (max_keyword_length < len) {
-            max_keyword_length = len;
+// lookup_token finds token type by its string representation, group markers
+// are not matched
+TokenLookupResult lookup_token(str s) {
+    TokenLookupResult result;
+    for (u32 type = 0; type <= tt_EOF; type++) {
+        if (token_type_strings[type].len != 0 && are_strs_equal(token_type_strings[type], s)) {
+            result.ok   = true;
+            result.type = (TokenType)type;
+            return result;
         }
     }
-}
-
-TokenLookupResult lookup_token(str s) {
-    TokenLookupResult lookup_res;
-    result_u64 res  = get_map_str_u64(lookup_token_map, s);
-    lookup_res.ok   = res.ok;
-    lookup_res.type = res.val;
-    return lookup_res;
+    result.ok = false;
+    return result;
 }
 
 TokenParseResult parse_token_from_str(str s) {
@@ -264,32 +266,36 @@ TokenParseResult parse_token_from_str(str s) {
     return res;
 }
 
-void init_token_module() {
-    init_keyword_length_vars();
-    init_token_lookup_map();
-}
+// write_token writes token position, type and literal as one line of
+// scanner output
+void write_token(OutputBuffer *out, Token token) {
+    str type_str = token_type_strings[token.type];
 
-void print_token(Token token) {
-    str type_str   = token_type_strings[token.type];
-    str line_str   = format_u32_as_decimal(token.pos.line);
-    str column_str = format_u32_as_decimal(token.pos.column);
-
-    print_str(line_str);
-    fwrite(":", 1, 1, stdout);
-    print_str(column_str);
-    u64 spaces = (u64)position_format_width - 1 - line_str.len - column_str.len;
-    print_indent_str((u8)spaces, type_str);
+    write_u64_to_output(out, token.pos.line);
+    write_byte_to_output(out, ':');
+    write_u64_to_output(out, token.pos.column);
+
+    u64 position_len = count_decimal_digits(token.pos.line) + 1 + count_decimal_digits(token.pos.column);
+    write_indent_str_to_output(out, (u8)((u64)position_format_width - position_len), type_str);
     if (!has_static_literal(token.type)) {
-        spaces = (u64)token_type_format_width - type_str.len;
-        print_indent_str((u8)spaces, token.literal);
+        write_indent_str_to_output(out, (u8)((u64)token_type_format_width - type_str.len), token.literal);
     }
-    println();
+    write_byte_to_output(out, '\n');
+}
+
+// print_token writes token to standard output, it is intended for debugging
+// and tests which also print through stdio
+void print_token(Token token) {
+    byte bytes[256];
+    OutputBuffer out = init_output_buffer(STDOUT_FILENO, bytes, sizeof(bytes));
 
-    free_str(type_str);
-    free_str(line_str);
-    free_str(column_str);
+    fflush(stdout);
+    write_token(&out, token);
+    flush_output(&out);
 }
 
 void free_token(Token token) {
     free_str(token.literal);
 }
+
+IMPLEMENT_SLICE(Token)
@@ -1,7 +1,9 @@
 #ifndef KU_TOKEN_H
 #define KU_TOKEN_H
 
+#include "output.h"
 #include "position.h"
+#include "slice.h"
 #include "str.h"
 #include "types.h"
 
@@ -10,139 +12,144 @@
         .type = tt_Empty,                                                                                              \
     }
 
+// Token types are described by X-macro lists, entry X(Name, "string") defines
+// type tt_Name and its string representation. For tokens with static literal
+// this string is the literal itself, keywords and operators are looked up
+// by it. Group markers tt_begin_* and tt_end_* have empty strings.
+//
+// Lists are expanded into TokenType enum, token_type_strings and keyword
+// table at compile time, so no initialization is needed before scanning
+
+// Identifiers, basic type literal classes and other tokens with literal
+// stored in Token struct
+#define NON_STATIC_TOKEN_LIST(X)                                                                                       \
+    X(Illegal, "ILLEGAL")           /* any byte sequence unknown to scanner */                                         \
+    X(Comment, "COMMENT")           /* only line comments are supported */                                             \
+    X(Identifier, "IDENT")          /* e.g: myvar, main, Line, println */                                              \
+    X(BinaryInteger, "BININT")      /* e.g: 0b1101100001 */                                                            \
+    X(OctalInteger, "OCTINT")       /* e.g: 0o43671 */                                                                 \
+    X(DecimalInteger, "DECINT")     /* e.g: 5367, 43_432, 1_000_097 */                                                 \
+    X(HexadecimalInteger, "HEXINT") /* e.g: 0x43da1 */                                                                 \
+    X(DecimalFloat, "DECFLT")       /* e.g: 123.45 */                                                                  \
+    X(Character, "CHAR")            /* e.g: 'a', '\t', 'p' */                                                          \
+    X(String, "STR")                /* e.g: "abc", "", "\t\n  42Hello\n" */
+
+// Operators and/or punctuators
+#define OPERATOR_TOKEN_LIST(X)                                                                                         \
+    X(BlankIdentifier, "_")                                                                                            \
+    X(Plus, "+")                                                                                                       \
+    X(Minus, "-")                                                                                                      \
+    X(Asterisk, "*")                                                                                                   \
+    X(Slash, "/")                                                                                                      \
+    X(Percent, "%")                                                                                                    \
+    X(Ampersand, "&")                                                                                                  \
+    X(Pipe, "|")                                                                                                       \
+    X(Caret, "^")                                                                                                      \
+    X(LeftShift, "<<")                                                                                                 \
+    X(RightShift, ">>")                                                                                                \
+    X(BitwiseAndNot, "&^")                                                                                             \
+    X(Semicolon, ";")                                                                                                  \
+    X(Period, ".")                                                                                                     \
+    X(Colon, ":")                                                                                                      \
+    X(Comma, ",")                                                                                                      \
+    X(Ellipsis, "...")                                                                                                 \
+    X(Equal, "==")                                                                                                     \
+    X(NotEqual, "!=")                                                                                                  \
+    X(LessOrEqual, "<=")                                                                                               \
+    X(GreaterOrEqual, ">=")                                                                                            \
+    X(Less, "<")                                                                                                       \
+    X(Greater, ">")                                                                                                    \
+    X(Assign, "=")                                                                                                     \
+    X(Not, "!")                                                                                                        \
+    X(Define, ":=")                                                                                                    \
+    X(AddAssign, "+=")                                                                                                 \
+    X(SubtractAssign, "-=")                                                                                            \
+    X(MultiplyAssign, "*=")                                                                                            \
+    X(QuotientAssign, "/=")                                                                                            \
+    X(RemainderAssign, "%=")                                                                                           \
+    X(LogicalAnd, "&&")                                                                                                \
+    X(LogicalOr, "||")                                                                                                 \
+    X(LeftArrow, "<-")                                                                                                 \
+    X(RightArrow, "=>")                                                                                                \
+    X(Increment, "++")                                                                                                 \
+    X(Decrement, "--")                                                                                                 \
+    X(LeftCurlyBracket, "{")                                                                                           \
+    X(RightCurlyBracket, "}")                                                                                          \
+    X(LeftSquareBracket, "[")                                                                                          \
+    X(RightSquareBracket, "]")                                                                                         \
+    X(LeftRoundBracket, "(")                                                                                           \
+    X(RightRoundBracket, ")")
+
+// Keywords
+#define KEYWORD_TOKEN_LIST(X)                                                                                          \
+    X(Break, "break")                                                                                                  \
+    X(Case, "case")                                                                                                    \
+    X(Channel, "chan")                                                                                                 \
+    X(Const, "const")                                                                                                  \
+    X(Continue, "continue")                                                                                            \
+    X(If, "if")                                                                                                        \
+    X(Else, "else")                                                                                                    \
+    X(ElseIf, "elif")                                                                                                  \
+    X(In, "in")                                                                                                        \
+    X(For, "for")                                                                                                      \
+    X(Loop, "loop")                                                                                                    \
+    X(While, "while")                                                                                                  \
+    X(Defer, "defer")                                                                                                  \
+    X(Function, "fn")                                                                                                  \
+    X(Ku, "ku")                                                                                                        \
+    X(Goto, "goto")                                                                                                    \
+    X(Import, "import")                                                                                                \
+    X(Interface, "interface")                                                                                          \
+    X(Map, "map")                                                                                                      \
+    X(Package, "package")                                                                                              \
+    X(Module, "module")                                                                                                \
+    X(Return, "return")                                                                                                \
+    X(Select, "select")                                                                                                \
+    X(Struct, "struct")                                                                                                \
+    X(Switch, "switch")                                                                                                \
+    X(Type, "type")                                                                                                    \
+    X(Var, "var")                                                                                                      \
+    X(Dirty, "dirty")                                                                                                  \
+    X(Default, "default")                                                                                              \
+    X(Immutable, "imt")                                                                                                \
+    X(Public, "pub")
+
+#define TOKEN_LIST(X)                                                                                                  \
+    X(Empty, "EMPTY") /* for empty_token const, zero value of TokenType */                                             \
+    X(begin_no_static_literal, "")                                                                                     \
+    NON_STATIC_TOKEN_LIST(X)                                                                                           \
+    X(end_no_static_literal, "")                                                                                       \
+    X(begin_operator, "")                                                                                              \
+    OPERATOR_TOKEN_LIST(X)                                                                                             \
+    X(end_operator, "")                                                                                                \
+    X(begin_keyword, "")                                                                                               \
+    KEYWORD_TOKEN_LIST(X)                                                                                              \
+    X(end_keyword, "")                                                                                                 \
+    X(Terminator, "TERM") /* generated by scanner in place of newline character to terminate a statement */            \
+    X(EOF, "EOF")
+
+#define TOKEN_TYPE_ENUM_ENTRY(name, s) tt_##name,
+
 typedef enum TokenType TokenType;
+typedef union TokenValue TokenValue;
 typedef struct Token Token;
 typedef struct TokenLookupResult TokenLookupResult;
 typedef struct TokenParseResult TokenParseResult;
 
-enum TokenType {
-    tt_Empty, // for empty_token const, zero value of TokenType
-
-    tt_begin_no_static_literal,
-
-    tt_Illegal, // any byte sequence unknown to scanner
-    tt_Comment, // only line comments are supported
-
-    // Identifiers and basic type literal classes
-    tt_Identifier,         // e.g: myvar, main, Line, println
-    tt_BinaryInteger,      // e.g: 0b1101100001
-    tt_OctalInteger,       // e.g: 0o43671
-    tt_DecimalInteger,     // e.g: 5367, 43_432, 1_000_097
-    tt_HexadecimalInteger, // e.g: 0x43da1
-    tt_DecimalFloat,       // e.g: 123.45
-    tt_Character,          // e.g: 'a', '\t', 'p'
-    tt_String,             // e.g: "abc", "", "\t\n  42Hello\n"
-
-    tt_end_no_static_literal,
-
-    // Operators and/or punctuators
-    tt_begin_operator,
-
-    tt_BlankIdentifier, // _
-    tt_Plus,            // +
-    tt_Minus,           // -
-    tt_Asterisk,        // *
-    tt_Slash,           // /
-    tt_Percent,         // %
-    tt_Ampersand,       // &
-
-    tt_Pipe,          // |
-    tt_Caret,         // ^
-    tt_LeftShift,     // <<
-    tt_RightShift,    // >>
-    tt_BitwiseAndNot, // &^
-
-    tt_Semicolon, // ;
-    tt_Period,    // .
-    tt_Colon,     // :
-    tt_Comma,     // ,
-    tt_Ellipsis,  // ...
-
-    tt_Equal,          // ==
-    tt_NotEqual,       // !=
-    tt_LessOrEqual,    // <=
-    tt_GreaterOrEqual, // >=
-    tt_Less,           // <
-    tt_Greater,        // >
-    tt_Assign,         // =
-    tt_Not,            // !
-
-    tt_Define,          // :=
-    tt_AddAssign,       // +=
-    tt_SubtractAssign,  // -=
-    tt_MultiplyAssign,  // *=
-    tt_QuotientAssign,  // /=
-    tt_RemainderAssign, // %=
-
-    tt_LogicalAnd, // &&
-    tt_LogicalOr,  // ||
-    tt_LeftArrow,  // <-
-    tt_RightArrow, // =>
-    tt_Increment,  // ++
-    tt_Decrement,  // --
-
-    // Brackets
-    tt_LeftCurlyBracket,   // {
-    tt_RightCurlyBracket,  // }
-    tt_LeftSquareBracket,  // [
-    tt_RightSquareBracket, // ]
-    tt_LeftRoundBracket,   // (
-    tt_RightRoundBracket,  // )
-
-    tt_end_operator,
-
-    // Keywords
-    tt_begin_keyword,
-
-    tt_Break,
-    tt_Case,
-    tt_Channel,
-    tt_Const,
-    tt_Continue,
-
-    tt_If,
-    tt_Else,
-    tt_ElseIf,
-    tt_In,
-    tt_For,
-    tt_Loop,
-    tt_While,
-
-    tt_Defer,
-    tt_Function,
-    tt_Ku,
-    tt_Goto,
-    tt_Import,
-
-    tt_Interface,
-    tt_Map,
-    tt_Package,
-    tt_Module,
-    tt_Return,
-
-    tt_Select,
-    tt_Struct,
-    tt_Switch,
-    tt_Type,
-    tt_Var,
-
-    tt_Dirty,
-    tt_Default,
-    tt_Immutable,
-    tt_Public,
-
-    tt_end_keyword,
-
-    // Special tokens
-    tt_Terminator, // Generated by scanner in place of newline character to terminate a statement
-    tt_EOF,
-};
+enum TokenType { TOKEN_LIST(TOKEN_TYPE_ENUM_ENTRY) };
 
+// TokenValue holds value of numeric literal decoded by scanner, integer is
+// used by integer tokens and real by tt_DecimalFloat
+union TokenValue {
+    u64 integer;
+    f64 real;
+};
 
 struct Token {
     TokenType type;
     Position pos;
     str literal;
+    TokenValue value;
 };
 
 struct TokenLookupResult {
@@ -155,13 +162,23 @@ struct TokenParseResult {
     Token token;
 };
 
-void init_token_module();
+TYPEDEF_SLICE(Token)
+
+// string representation of each token type, indexed by TokenType
+extern str token_type_strings[];
+
 Token create_token(TokenType type, Position pos);
 Token create_token_with_literal(TokenType type, Position pos, str literal);
 TokenLookupResult lookup_keyword(str s);
 TokenLookupResult lookup_token(str s);
 TokenParseResult parse_token_from_str(str s);
+bool has_static_literal(TokenType type);
+
+// get_assign_operation returns binary operator applied by compound assignment,
+// e.g. tt_Plus for "+=", and tt_Empty for other token types
+TokenType get_assign_operation(TokenType type);
 bool are_tokens_equal(Token t1, Token t2);
+void write_token(OutputBuffer *out, Token token);
 void print_token(Token token);
 void free_token(Token token);
 
@@ -0,0 +1,309 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fatal.h"
+#include "token_stream.h"
+
+const byte token_stream_magic[4] = {'K', 'U', 'T', 'S'};
+
+const u16 token_stream_version     = 1;
+const u32 token_stream_header_size = 32;
+const u32 token_record_size        = 16;
+
+void store_u16_le(byte *p, u16 v) {
+    p[0] = (byte)v;
+    p[1] = (byte)(v >> 8);
+}
+
+void store_u32_le(byte *p, u32 v) {
+    p[0] = (byte)v;
+    p[1] = (byte)(v >> 8);
+    p[2] = (byte)(v >> 16);
+    p[3] = (byte)(v >> 24);
+}
+
+void store_u64_le(byte *p, u64 v) {
+    store_u32_le(p, (u32)v);
+    store_u32_le(p + 4, (u32)(v >> 32));
+}
+
+u16 load_u16_le(const byte *p) {
+    return (u16)(p[0] | (p[1] << 8));
+}
+
+u32 load_u32_le(const byte *p) {
+    return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+u64 load_u64_le(const byte *p) {
+    return (u64)load_u32_le(p) | ((u64)load_u32_le(p + 4) << 32);
+}
+
+u64 align_to_4(u64 n) {
+    return (n + 3) & ~(u64)3;
+}
+
+bool has_stream_literal(Token token) {
+    return !has_static_literal(token.type) && token.literal.len != 0;
+}
+
+// get_string_entry_size returns size of string table entry with literal of given length
+u64 get_string_entry_size(u64 len) {
+    return 4 + align_to_4(len);
+}
+
+// write_token_stream encodes tokens in binary format described in token_stream.h,
+// line numbers of tokens must not decrease if line table is requested
+void write_token_stream(OutputBuffer *out, slice_of_Tokens tokens, bool line_table) {
+    // empty entry at offset 0
+    u64 string_table_size = get_string_entry_size(0);
+    for (u32 i = 0; i < tokens.len; i++) {
+        if (has_stream_literal(tokens.elem[i])) {
+            string_table_size += get_string_entry_size(tokens.elem[i].literal.len);
+        }
+    }
+    if (string_table_size > UINT32_MAX) {
+        fatal(1, "string table of token stream is too large");
+    }
+
+    u32 line_count = 0;
+    if (line_table && tokens.len != 0) {
+        line_count = tokens.elem[tokens.len - 1].pos.line;
+    }
+
+    byte header[32];
+    memcpy(header, token_stream_magic, 4);
+    store_u16_le(header + 4, token_stream_version);
+    store_u16_le(header + 6, line_table ? tsf_LineTable : 0);
+    store_u32_le(header + 8, token_record_size);
+    store_u32_le(header + 12, tokens.len);
+    store_u32_le(header + 16, line_count);
+    store_u32_le(header + 20, 0);
+    store_u64_le(header + 24, string_table_size);
+    write_bytes_to_output(out, header, sizeof(header));
+
+    // literals are placed in table in order of tokens
+    u32 offset = (u32)get_string_entry_size(0);
+    for (u32 i = 0; i < tokens.len; i++) {
+        Token token = tokens.elem[i];
+
+        byte record[16];
+        store_u32_le(record, token.pos.line);
+        store_u32_le(record + 4, token.pos.column);
+        store_u16_le(record + 8, (u16)token.type);
+        store_u16_le(record + 10, 0);
+        if (has_stream_literal(token)) {
+            store_u32_le(record + 12, offset);
+            offset += (u32)get_string_entry_size(token.literal.len);
+        } else {
+            store_u32_le(record + 12, 0);
+        }
+        write_bytes_to_output(out, record, sizeof(record));
+    }
+
+    u32 token_index = 0;
+    for (u32 line = 1; line <= line_count; line++) {
+        while (token_index < tokens.len && tokens.elem[token_index].pos.line < line) {
+            token_index++;
+        }
+        byte entry[4];
+        store_u32_le(entry, token_index);
+        write_bytes_to_output(out, entry, sizeof(entry));
+    }
+
+    const byte padding[4] = {0, 0, 0, 0};
+    write_bytes_to_output(out, padding, 4);
+    for (u32 i = 0; i < tokens.len; i++) {
+        Token token = tokens.elem[i];
+        if (!has_stream_literal(token)) {
+            continue;
+        }
+        byte len[4];
+        store_u32_le(len, (u32)token.literal.len);
+        write_bytes_to_output(out, len, sizeof(len));
+        write_str_to_output(out, token.literal);
+        write_bytes_to_output(out, padding, align_to_4(token.literal.len) - token.literal.len);
+    }
+}
+
+// check_stream_literals verifies that all literal offsets of records point to
+// complete entries inside string table, so that consumers may skip checks
+bool check_stream_literals(TokenStream ts) {
+    for (u32 i = 0; i < ts.token_count; i++) {
+        u64 offset = load_u32_le(ts.records + (u64)i * token_record_size + 12);
+        if (offset % 4 != 0 || offset + 4 > ts.string_table_size) {
+            return false;
+        }
+        u64 len = load_u32_le(ts.strings + offset);
+        if (len > ts.string_table_size - offset - 4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_stream_line_table(TokenStream ts) {
+    u32 prev = 0;
+    for (u32 i = 0; i < ts.line_count; i++) {
+        u32 index = load_u32_le(ts.line_table + (u64)i * 4);
+        if (index < prev || index > ts.token_count) {
+            return false;
+        }
+        prev = index;
+    }
+    return true;
+}
+
+// read_token_stream_from_bytes validates stream which starts at given bytes,
+// returned stream points into the same memory
+TokenStreamReadResult read_token_stream_from_bytes(const byte *bytes, u64 size) {
+    TokenStreamReadResult res;
+    memset(&res, 0, sizeof(res));
+
+    if (size < token_stream_header_size) {
+        res.erc = tsec_Truncated;
+        return res;
+    }
+    if (memcmp(bytes, token_stream_magic, 4) != 0) {
+        res.erc = tsec_BadMagic;
+        return res;
+    }
+
+    TokenStream ts;
+    ts.version = load_u16_le(bytes + 4);
+    ts.flags   = load_u16_le(bytes + 6);
+    if (ts.version != token_stream_version) {
+        res.erc = tsec_UnsupportedVersion;
+        return res;
+    }
+    if (load_u32_le(bytes + 8) != token_record_size) {
+        res.erc = tsec_BadRecordSize;
+        return res;
+    }
+    ts.token_count       = load_u32_le(bytes + 12);
+    ts.line_count        = load_u32_le(bytes + 16);
+    ts.string_table_size = load_u64_le(bytes + 24);
+    if ((ts.flags & tsf_LineTable) == 0 && ts.line_count != 0) {
+        res.erc = tsec_BadLineTable;
+        return res;
+    }
+
+    u64 records_size = (u64)ts.token_count * token_record_size;
+    u64 lines_size   = (u64)ts.line_count * 4;
+    u64 rest         = size - token_stream_header_size;
+    if (records_size > rest || lines_size > rest - records_size ||
+        ts.string_table_size > rest - records_size - lines_size) {
+        res.erc = tsec_Truncated;
+        return res;
+    }
+
+    ts.records    = bytes + token_stream_header_size;
+    ts.line_table = ts.records + records_size;
+    ts.strings    = ts.line_table + lines_size;
+    ts.size       = token_stream_header_size + records_size + lines_size + ts.string_table_size;
+    if (!check_stream_literals(ts)) {
+        res.erc = tsec_BadLiteral;
+        return res;
+    }
+    if (!check_stream_line_table(ts)) {
+        res.erc = tsec_BadLineTable;
+        return res;
+    }
+
+    res.stream = ts;
+    res.erc    = tsec_NotAnError;
+    return res;
+}
+
+// map_token_stream_file maps whole file into memory for reading, streams
+// inside it are read with read_token_stream_from_bytes
+TokenStreamFile map_token_stream_file(char *path) {
+    TokenStreamFile file = {
+        .bytes = nil,
+        .size  = 0,
+        .erc   = tsec_NotAnError,
+    };
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        file.erc = tsec_OpenFailed;
+        return file;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        file.erc = tsec_StatFailed;
+        return file;
+    }
+    if (st.st_size < token_stream_header_size) {
+        close(fd);
+        file.erc = tsec_Truncated;
+        return file;
+    }
+
+    void *p = mmap(nil, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        file.erc = tsec_MapFailed;
+        return file;
+    }
+    file.bytes = (const byte *)p;
+    file.size  = (u64)st.st_size;
+    return file;
+}
+
+void unmap_token_stream_file(TokenStreamFile file) {
+    if (file.bytes == nil) {
+        return;
+    }
+    munmap((void *)file.bytes, file.size);
+}
+
+// get_token_from_stream decodes token record, literal of returned token is
+// borrowed from stream memory
+Token get_token_from_stream(TokenStream ts, u32 index) {
+    const byte *record = ts.records + (u64)index * token_record_size;
+    u32 offset         = load_u32_le(record + 12);
+
+    Token token = {
+        .type    = (TokenType)load_u16_le(record + 8),
+        .pos     = {.line = load_u32_le(record), .column = load_u32_le(record + 4)},
+        .literal = empty_str,
+    };
+    if (offset != 0) {
+        token.literal = borrow_str_from_bytes(ts.strings + offset + 4, load_u32_le(ts.strings + offset));
+    }
+    return token;
+}
+
+// get_first_token_of_line returns index of first token placed on given line or
+// below it, token_count is returned if there are no such tokens. Lines are
+// numbered from 1
+u32 get_first_token_of_line(TokenStream ts, u32 line) {
+    if (line == 0) {
+        return 0;
+    }
+    if ((ts.flags & tsf_LineTable) != 0) {
+        if (line > ts.line_count) {
+            return ts.token_count;
+        }
+        return load_u32_le(ts.line_table + (u64)(line - 1) * 4);
+    }
+
+    // records are ordered by position, so binary search is possible
+    // without line table
+    u32 lo = 0;
+    u32 hi = ts.token_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (load_u32_le(ts.records + (u64)mid * token_record_size) < line) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
@@ -0,0 +1,111 @@
+#ifndef KU_TOKEN_STREAM_H
+#define KU_TOKEN_STREAM_H
+
+#include "output.h"
+#include "token.h"
+#include "types.h"
+
+// Binary token stream produced by cckuc scan --format=bin. All numbers are
+// little-endian, sections are aligned so that stream may be used directly
+// from mapped file memory:
+//
+//     header          32 bytes
+//     token records   token_count * 16 bytes
+//     line table      line_count * 4 bytes, only if tsf_LineTable flag is set
+//     string table    string_table_size bytes
+//
+// Header:
+//
+//     0   magic "KUTS"
+//     4   u16 format version
+//     6   u16 flags
+//     8   u32 size of token record
+//     12  u32 number of tokens
+//     16  u32 number of lines in line table
+//     20  u32 reserved, zero
+//     24  u64 size of string table in bytes
+//
+// Token record:
+//
+//     0   u32 line
+//     4   u32 column
+//     8   u16 token type, value of TokenType in producing compiler version
+//     10  u16 reserved, zero
+//     12  u32 offset of literal in string table
+//
+// String table entry is u32 literal length followed by literal bytes padded
+// with zeros to multiple of 4. Table always starts with empty entry, tokens
+// with static or empty literal point to offset 0.
+//
+// Line table entry at index i holds index of first token placed on line i + 1
+// or below it, so tokens of line i + 1 are in range [table[i], table[i + 1]).
+//
+// Streams of several files are written one after another
+
+typedef enum TokenStreamFlag TokenStreamFlag;
+typedef enum TokenStreamErrCode TokenStreamErrCode;
+typedef struct TokenStream TokenStream;
+typedef struct TokenStreamReadResult TokenStreamReadResult;
+typedef struct TokenStreamFile TokenStreamFile;
+
+enum TokenStreamFlag {
+    tsf_LineTable = 1 << 0,
+};
+
+enum TokenStreamErrCode {
+    tsec_NotAnError,
+    tsec_OpenFailed,
+    tsec_StatFailed,
+    tsec_MapFailed,
+    tsec_Truncated,
+    tsec_BadMagic,
+    tsec_UnsupportedVersion,
+    tsec_BadRecordSize,
+    tsec_BadLiteral,
+    tsec_BadLineTable,
+};
+
+// TokenStream points into memory of a single encoded stream, it does not own
+// the memory
+struct TokenStream {
+    const byte *records;
+    const byte *line_table;
+    const byte *strings;
+
+    u64 string_table_size;
+
+    // size of the whole encoded stream including header, next stream
+    // starts right after it
+    u64 size;
+
+    u32 token_count;
+    u32 line_count;
+
+    u16 version;
+    u16 flags;
+};
+
+struct TokenStreamReadResult {
+    TokenStream stream;
+    TokenStreamErrCode erc;
+};
+
+// TokenStreamFile is memory mapped file with one or more token streams
+struct TokenStreamFile {
+    const byte *bytes;
+    u64 size;
+    TokenStreamErrCode erc;
+};
+
+extern const u16 token_stream_version;
+extern const u32 token_stream_header_size;
+extern const u32 token_record_size;
+
+void write_token_stream(OutputBuffer *out, slice_of_Tokens tokens, bool line_table);
+TokenStreamReadResult read_token_stream_from_bytes(const byte *bytes, u64 size);
+TokenStreamFile map_token_stream_file(char *path);
+void unmap_token_stream_file(TokenStreamFile file);
+Token get_token_from_stream(TokenStream ts, u32 index);
+u32 get_first_token_of_line(TokenStream ts, u32 line);
+
+#endif // KU_TOKEN_STREAM_H
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "token_stream.h"
+
+typedef struct TokenStreamTestCase TokenStreamTestCase;
+
+struct TokenStreamTestCase {
+    u64 id;
+    str label;
+    str source_str;
+    bool line_table;
+};
+
+const u32 number_of_test_cases = 5;
+
+const TokenStreamTestCase test_cases[] = {
+    {
+        .id         = 1,
+        .label      = STR("empty source"),
+        .source_str = EMPTY_STR,
+        .line_table = true,
+    },
+    {
+        .id         = 2,
+        .label      = STR("function with literals and comments"),
+        .source_str = STR("// swap values\n"
+                          "fn swap(a, b: i32) => (i32, i32) {\n"
+                          "    print(\"swap\")\n"
+                          "    x := 0x1f\n"
+                          "}\n"),
+        .line_table = true,
+    },
+    {
+        .id         = 3,
+        .label      = STR("function without line table"),
+        .source_str = STR("fn main() {\n"
+                          "    x := 12\n"
+                          "    print(x)\n"
+                          "}\n"),
+        .line_table = false,
+    },
+    {
+        .id         = 4,
+        .label      = STR("empty lines between tokens"),
+        .source_str = STR("\n\n\nfn a() {\n\n\n}\n\n\n// end\n"),
+        .line_table = true,
+    },
+    {
+        .id         = 5,
+        .label      = STR("literal lengths which need padding"),
+        .source_str = STR("a ab abc abcd abcde \"\" \"x\" 1 12 123 1234"),
+        .line_table = true,
+    },
+};
+
+const str pass_str   = STR("    token_stream_test [ OK ]");
+const str fail_str   = STR("[ FAILED ]");
+const str case_str   = STR("Test case: ");
+const str reason_str = STR("Reason: ");
+
+// large enough to keep whole encoded stream of any test case in memory
+const u64 test_stream_buffer_cap = 1 << 16;
+
+void print_failed_test_case(TokenStreamTestCase test_case, char *reason) {
+    str id_str = format_u64_as_decimal(test_case.id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(reason_str);
+    println_str(take_str_from_cstr(reason));
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+slice_of_Tokens scan_test_source(str source_str) {
+    slice_of_Tokens tokens = empty_slice_of_Tokens;
+    Scanner scanner        = init_scanner_from_str(source_str);
+    Token token;
+    do {
+        token = scan_token(&scanner);
+        append_Token_to_slice(&tokens, token);
+    } while (token.type != tt_EOF);
+    return tokens;
+}
+
+// find_first_token_of_line is reference implementation of line lookup
+u32 find_first_token_of_line(slice_of_Tokens tokens, u32 line) {
+    for (u32 i = 0; i < tokens.len; i++) {
+        if (tokens.elem[i].pos.line >= line) {
+            return i;
+        }
+    }
+    return tokens.len;
+}
+
+char *check_decoded_stream(slice_of_Tokens tokens, byte *bytes, u64 size) {
+    TokenStreamReadResult res = read_token_stream_from_bytes(bytes, size);
+    if (res.erc != tsec_NotAnError) {
+        return "failed to read encoded stream";
+    }
+    TokenStream ts = res.stream;
+    if (ts.size != size) {
+        return "stream size differs from number of written bytes";
+    }
+    if (ts.token_count != tokens.len) {
+        return "number of tokens differs";
+    }
+    for (u32 i = 0; i < tokens.len; i++) {
+        if (!are_tokens_equal(tokens.elem[i], get_token_from_stream(ts, i))) {
+            return "decoded token differs";
+        }
+    }
+    u32 last_line = tokens.elem[tokens.len - 1].pos.line;
+    for (u32 line = 0; line <= last_line + 1; line++) {
+        if (get_first_token_of_line(ts, line) != find_first_token_of_line(tokens, line)) {
+            return "wrong first token of line";
+        }
+    }
+
+    if (read_token_stream_from_bytes(bytes, size - 1).erc != tsec_Truncated) {
+        return "truncated stream is accepted";
+    }
+    bytes[0] = 'X';
+    if (read_token_stream_from_bytes(bytes, size).erc != tsec_BadMagic) {
+        return "stream with wrong magic is accepted";
+    }
+    bytes[0] = 'K';
+    if (ts.token_count != 0) {
+        // literal offset of the first record
+        bytes[token_stream_header_size + 12] = 0xFF;
+        if (read_token_stream_from_bytes(bytes, size).erc != tsec_BadLiteral) {
+            return "stream with wrong literal offset is accepted";
+        }
+    }
+    return nil;
+}
+
+bool run_test_case(TokenStreamTestCase test_case) {
+    slice_of_Tokens tokens = scan_test_source(test_case.source_str);
+
+    OutputBuffer out = new_output_buffer(-1, test_stream_buffer_cap);
+    write_token_stream(&out, tokens, test_case.line_table);
+
+    char *reason = nil;
+    if (out.failed) {
+        reason = "encoded stream does not fit into test buffer";
+    } else {
+        reason = check_decoded_stream(tokens, out.bytes, out.len);
+    }
+
+    free_output_buffer(&out);
+    for (u32 i = 0; i < tokens.len; i++) {
+        free_token(tokens.elem[i]);
+    }
+    free_slice_of_Tokens(tokens);
+
+    if (reason == nil) {
+        return false;
+    }
+    print_failed_test_case(test_case, reason);
+    return true;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,85 @@
+// fork, execvp and readlink are not part of C11
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "path.h"
+#include "toolchain.h"
+
+const char *const default_c_compiler = "cc";
+const char *const c_recursion_flag   = "-fno-optimize-sibling-calls";
+const str native_runtime_name        = STR("libkurt.a");
+
+str get_toolchain_dir() {
+    char exe[4096];
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe));
+    if (len <= 0 || (size_t)len == sizeof(exe)) {
+        return empty_str;
+    }
+    str path = borrow_str_from_bytes((byte *)exe, (u64)len);
+    u64 i    = index_last_byte_in_str(path, '/');
+    if (i >= path.len) {
+        return empty_str;
+    }
+    return new_str_from_str(borrow_str_slice_from_start(path, i));
+}
+
+str get_native_runtime_path() {
+    str dir = get_toolchain_dir();
+    if (dir.len == 0) {
+        return new_str_from_str(native_runtime_name);
+    }
+    str path = new_joined_path(dir, native_runtime_name);
+    free_str(dir);
+    return path;
+}
+
+bool run_c_compiler(const char *const *args) {
+    const char *cc = getenv("CC");
+    if (cc == nil || cc[0] == 0) {
+        cc = default_c_compiler;
+    }
+
+    u32 len = 0;
+    while (args[len] != nil) {
+        len++;
+    }
+    char **argv = (char **)alloc_mem(at_Other, (len + 2) * sizeof(char *));
+    if (argv == nil) {
+        return false;
+    }
+    argv[0] = (char *)cc;
+    for (u32 i = 0; i < len; i++) {
+        argv[i + 1] = (char *)args[i];
+    }
+    argv[len + 1] = nil;
+
+    // buffered output must not be written twice by both processes
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp(cc, argv);
+        fprintf(stderr, "error starting C compiler %s: %s\n", cc, strerror(errno));
+        _exit(127);
+    }
+    free_mem(argv);
+    if (pid < 0) {
+        fprintf(stderr, "error starting C compiler %s: %s\n", cc, strerror(errno));
+        return false;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
@@ -0,0 +1,29 @@
+#ifndef KU_TOOLCHAIN_H
+#define KU_TOOLCHAIN_H
+
+#include "str.h"
+#include "types.h"
+
+// Native programs are assembled and linked by system C compiler, its
+// executable is taken from CC environment variable, "cc" by default
+
+// c_recursion_flag is passed when compiling generated C source, compiler
+// must not turn recursive calls into loops, so that unbounded recursion is
+// reported as stack overflow as by other backends
+extern const char *const c_recursion_flag;
+
+// get_toolchain_dir returns directory of compiler executable, runtime
+// library and header are installed there. Empty string is returned if the
+// directory is unknown
+str get_toolchain_dir();
+
+// get_native_runtime_path returns path of native runtime library, it is
+// installed next to compiler executable
+str get_native_runtime_path();
+
+// run_c_compiler runs C compiler with given arguments and waits for it to
+// finish, args list is terminated by nil. Returns false if compiler could
+// not be started or failed, compiler prints its own diagnostics
+bool run_c_compiler(const char *const *args);
+
+#endif // KU_TOOLCHAIN_H
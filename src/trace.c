@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "fatal.h"
+#include "timer.h"
+#include "trace.h"
+
+// number of events each thread keeps before overwriting oldest ones
+const u64 trace_buffer_cap = 1 << 15;
+
+bool trace_enabled = false;
+u64 trace_start_ns = 0;
+
+// list of buffers of all threads which recorded at least one event,
+// new buffers are pushed to the front
+_Atomic(TraceBuffer *) trace_buffers = nil;
+atomic_uint next_trace_tid           = 0;
+
+_Thread_local TraceBuffer *thread_trace_buffer = nil;
+
+void enable_tracing() {
+    trace_start_ns = get_wall_time_ns();
+    trace_enabled  = true;
+}
+
+bool is_tracing_enabled() {
+    return trace_enabled;
+}
+
+TraceBuffer *new_trace_buffer() {
+    TraceBuffer *buf = (TraceBuffer *)alloc_mem(at_Other, sizeof(TraceBuffer));
+    TraceEvent *evs  = (TraceEvent *)alloc_mem(at_Other, trace_buffer_cap * sizeof(TraceEvent));
+    if (buf == nil || evs == nil) {
+        fatal(1, "not enough memory for trace buffer");
+    }
+    buf->tid          = atomic_fetch_add(&next_trace_tid, 1);
+    buf->thread_name  = nil;
+    buf->thread_index = 0;
+    buf->cap          = trace_buffer_cap;
+    buf->events       = evs;
+    atomic_init(&buf->head, 0);
+
+    buf->next = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+        &trace_buffers, &buf->next, buf, memory_order_release, memory_order_relaxed)) {
+    }
+    return buf;
+}
+
+TraceBuffer *get_thread_trace_buffer() {
+    if (thread_trace_buffer == nil) {
+        thread_trace_buffer = new_trace_buffer();
+    }
+    return thread_trace_buffer;
+}
+
+// name_trace_thread sets name of calling thread in trace, index is appended to name
+void name_trace_thread(const char *name, u32 index) {
+    if (!trace_enabled) {
+        return;
+    }
+    TraceBuffer *buf  = get_thread_trace_buffer();
+    buf->thread_name  = name;
+    buf->thread_index = index;
+}
+
+void record_trace_event(const char *name, char kind, str arg) {
+    TraceBuffer *buf = get_thread_trace_buffer();
+    u64 head         = atomic_load_explicit(&buf->head, memory_order_relaxed);
+    TraceEvent *ev   = &buf->events[head % buf->cap];
+
+    ev->name = name;
+    ev->ts   = get_wall_time_ns() - trace_start_ns;
+    ev->kind = kind;
+
+    u64 len = arg.len;
+    if (len > TRACE_ARG_CAP) {
+        len = TRACE_ARG_CAP;
+    }
+    if (len != 0) {
+        memcpy(ev->arg, arg.bytes, len);
+    }
+    ev->arg_len = (u8)len;
+
+    atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+}
+
+// begin_trace_event starts event with given name on calling thread,
+// non-empty arg is shown as file argument of the event
+void begin_trace_event(const char *name, str arg) {
+    if (!trace_enabled) {
+        return;
+    }
+    record_trace_event(name, 'B', arg);
+}
+
+void end_trace_event(const char *name) {
+    if (!trace_enabled) {
+        return;
+    }
+    record_trace_event(name, 'E', empty_str);
+}
+
+void write_json_escaped(FILE *file, const char *s, u64 len) {
+    for (u64 i = 0; i < len; i++) {
+        byte c = (byte)s[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+}
+
+void write_trace_thread_name(FILE *file, TraceBuffer *buf) {
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", buf->tid);
+    if (buf->thread_name == nil) {
+        fprintf(file, "thread %u", buf->tid);
+    } else {
+        fprintf(file, "%s %u", buf->thread_name, buf->thread_index);
+    }
+    fprintf(file, "\"}}");
+}
+
+void write_trace_event(FILE *file, TraceBuffer *buf, TraceEvent *ev) {
+    fprintf(file,
+        ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%u",
+        ev->name,
+        ev->kind,
+        (unsigned long long)(ev->ts / 1000),
+        (unsigned long long)(ev->ts % 1000),
+        buf->tid);
+    if (ev->arg_len != 0) {
+        fprintf(file, ",\"args\":{\"file\":\"");
+        write_json_escaped(file, ev->arg, ev->arg_len);
+        fprintf(file, "\"}");
+    }
+    fprintf(file, "}");
+}
+
+// write_trace_file writes events of all threads in Chrome trace event JSON format.
+// Must be called after all traced threads stopped recording. Returns false if
+// file could not be written
+bool write_trace_file(char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nil) {
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"cckuc\"}}");
+
+    TraceBuffer *buf = atomic_load_explicit(&trace_buffers, memory_order_acquire);
+    while (buf != nil) {
+        fprintf(file, ",\n");
+        write_trace_thread_name(file, buf);
+
+        u64 head  = atomic_load_explicit(&buf->head, memory_order_acquire);
+        u64 first = 0;
+        if (head > buf->cap) {
+            first = head - buf->cap;
+        }
+        for (u64 i = first; i < head; i++) {
+            write_trace_event(file, buf, &buf->events[i % buf->cap]);
+        }
+
+        TraceBuffer *next = buf->next;
+        free_mem(buf->events);
+        free_mem(buf);
+        buf = next;
+    }
+    atomic_store(&trace_buffers, nil);
+    thread_trace_buffer = nil;
+
+    fprintf(file, "\n]}\n");
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    return ok;
+}
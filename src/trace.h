@@ -0,0 +1,59 @@
+#ifndef KU_TRACE_H
+#define KU_TRACE_H
+
+#include <stdatomic.h>
+
+#include "str.h"
+#include "types.h"
+
+typedef struct TraceEvent TraceEvent;
+typedef struct TraceBuffer TraceBuffer;
+
+// maximum number of argument bytes stored in event, longer arguments are truncated
+#define TRACE_ARG_CAP 64
+
+// TraceEvent is a begin or end event in Chrome trace event format
+struct TraceEvent {
+    // static string, only pointer is stored
+    const char *name;
+
+    // nanoseconds since tracing was enabled
+    u64 ts;
+
+    // 'B' for begin and 'E' for end
+    char kind;
+
+    u8 arg_len;
+    char arg[TRACE_ARG_CAP];
+};
+
+// TraceBuffer is a ring of events recorded by a single thread. Only owner
+// thread writes into buffer, so recording requires no synchronization.
+// When ring is full oldest events are overwritten
+struct TraceBuffer {
+    // next registered buffer
+    TraceBuffer *next;
+
+    // sequential number of thread in trace
+    u32 tid;
+
+    // name which is shown for the thread in trace viewer
+    const char *thread_name;
+    u32 thread_index;
+
+    // total number of events recorded, event with number n
+    // is stored at index n % cap
+    atomic_uint_fast64_t head;
+
+    u64 cap;
+    TraceEvent *events;
+};
+
+void enable_tracing();
+bool is_tracing_enabled();
+void name_trace_thread(const char *name, u32 index);
+void begin_trace_event(const char *name, str arg);
+void end_trace_event(const char *name);
+bool write_trace_file(char *path);
+
+#endif // KU_TRACE_H
@@ -0,0 +1,871 @@
+#include <stdio.h>
+
+#include "type_check.h"
+
+typedef struct TypeChecker TypeChecker;
+
+struct TypeChecker {
+    TypeTable *table;
+
+    // predeclared type names
+    SymbolTable type_names;
+
+    slice_of_TypeErrors errors;
+
+    // scratch list for building tuples
+    slice_of_TypeIds tuple;
+
+    // result type of function whose body is being checked, ti_Void for top
+    // level statements
+    TypeId result;
+
+    // true if results of current function are named, such function may use
+    // bare return
+    bool named_results;
+};
+
+IMPLEMENT_SLICE(TypeError)
+
+// type of variables initialized by untyped literals
+const TypeId default_integer_type = ti_I64;
+const TypeId default_float_type   = ti_F64;
+
+void add_type_error(TypeChecker *c, TypeErrorType type, Position pos, str name, u32 want, u32 got) {
+    TypeError err = {
+        .type = type,
+        .pos  = pos,
+        .name = name,
+        .want = want,
+        .got  = got,
+    };
+    append_TypeError_to_slice(&c->errors, err);
+}
+
+Position get_expression_position(Expression expr) {
+    switch (expr.type) {
+    case et_Identifier:
+        return ((Identifier *)expr.ptr)->token.pos;
+    case et_Call:
+        return ((CallExpression *)expr.ptr)->name.token.pos;
+    case et_IntegerLiteral:
+        return ((Integer *)expr.ptr)->token.pos;
+    case et_FloatLiteral:
+        return ((Float *)expr.ptr)->token.pos;
+    case et_StringLiteral:
+        return ((String *)expr.ptr)->token.pos;
+    case et_Unary:
+        return ((UnaryExpression *)expr.ptr)->operator.pos;
+    case et_Binary:
+        return get_expression_position(((BinaryExpression *)expr.ptr)->left);
+    default:
+        return null_position;
+    }
+}
+
+TypeId check_type_specifier(TypeChecker *c, TypeSpecifier type_specifier);
+
+TypeId check_type_literal(TypeChecker *c, TypeLiteral *type_literal) {
+    switch (type_literal->type) {
+    case tlt_Slice: {
+        SliceTypeLiteral *slice = (SliceTypeLiteral *)type_literal->ptr;
+        return intern_slice_type(c->table, check_type_specifier(c, slice->element_type));
+    }
+    case tlt_Map: {
+        MapTypeLiteral *map = (MapTypeLiteral *)type_literal->ptr;
+        TypeId key          = check_type_specifier(c, map->key_type);
+        TypeId value        = check_type_specifier(c, map->value_type);
+        return intern_map_type(c->table, key, value);
+    }
+    default:
+        return ti_Invalid;
+    }
+}
+
+TypeId check_type_specifier(TypeChecker *c, TypeSpecifier type_specifier) {
+    if (type_specifier.ptr == nil) {
+        return ti_Invalid;
+    }
+    switch (type_specifier.type) {
+    case tst_Name: {
+        Identifier *name = &((TypeName *)type_specifier.ptr)->name;
+        name->symbol     = lookup_symbol(&c->type_names, name->token.literal);
+        if (name->symbol == nil) {
+            add_type_error(c, tet_UnknownType, name->token.pos, name->token.literal, 0, 0);
+            return ti_Invalid;
+        }
+        return name->symbol->type;
+    }
+    case tst_QualifiedName: {
+        // there are no imported modules yet
+        Identifier name = ((TypeName *)type_specifier.ptr)->name;
+        add_type_error(c, tet_UnknownType, name.token.pos, name.token.literal, 0, 0);
+        return ti_Invalid;
+    }
+    case tst_Literal:
+        return check_type_literal(c, (TypeLiteral *)type_specifier.ptr);
+    default:
+        return ti_Invalid;
+    }
+}
+
+// check_parameters assigns types to names of declarations and appends them
+// to scratch tuple, each name is a separate member
+void check_parameters(TypeChecker *c, slice_of_ParameterDeclarations decls) {
+    for (u32 i = 0; i < decls.len; i++) {
+        ParameterDeclaration *decl = &decls.elem[i];
+        TypeId type                = check_type_specifier(c, decl->type_specifier);
+        for (u32 j = 0; j < decl->names.len; j++) {
+            Symbol *symbol = decl->names.elem[j].symbol;
+            if (symbol != nil) {
+                symbol->type = type;
+            }
+            append_TypeId_to_slice(&c->tuple, type);
+        }
+    }
+}
+
+TypeId intern_scratch_tuple(TypeChecker *c) {
+    TypeList members = {
+        .elem = c->tuple.elem,
+        .len  = c->tuple.len,
+    };
+    TypeId id    = intern_tuple_type(c->table, members);
+    c->tuple.len = 0;
+    return id;
+}
+
+TypeId check_function_result(TypeChecker *c, FunctionResult *result) {
+    switch (result->type) {
+    case frt_Void:
+        result->type_id = ti_Void;
+        break;
+    case frt_Simple:
+        result->type_id = check_type_specifier(c, ((SimpleResult *)result->ptr)->type_specifier);
+        break;
+    case frt_TupleSignature: {
+        slice_of_TypeSpecifiers type_specifiers = ((TupleSignatureResult *)result->ptr)->type_specifiers;
+        for (u32 i = 0; i < type_specifiers.len; i++) {
+            append_TypeId_to_slice(&c->tuple, check_type_specifier(c, type_specifiers.elem[i]));
+        }
+        result->type_id = intern_scratch_tuple(c);
+        break;
+    }
+    case frt_TypedTuple:
+        check_parameters(c, ((TypedTupleResult *)result->ptr)->parameter_declarations);
+        result->type_id = intern_scratch_tuple(c);
+        break;
+    default:
+        result->type_id = ti_Invalid;
+        break;
+    }
+    return result->type_id;
+}
+
+// check_function_signature assigns function type to its name, so that calls
+// can be checked regardless of definition order
+void check_function_signature(TypeChecker *c, FunctionDefinition *def) {
+    FunctionDeclaration *decl = &def->declaration;
+    check_parameters(c, decl->parameters.parameter_declarations);
+    TypeId params = intern_scratch_tuple(c);
+    TypeId result = check_function_result(c, &decl->result);
+    if (decl->name.symbol != nil && decl->name.symbol->function == def) {
+        decl->name.symbol->type = intern_function_type(c->table, params, result);
+    }
+}
+
+// check_integer_fits reports literals which do not fit into integer type
+void check_integer_fits(TypeChecker *c, Expression expr, TypeId want) {
+    if (expr.type != et_IntegerLiteral) {
+        return;
+    }
+    Token token = ((Integer *)expr.ptr)->token;
+    Type type   = get_type(c->table, want);
+
+    // literals are never negative, so only upper bound matters
+    u32 bits = type.size * 8;
+    if (type.kind == tk_Signed) {
+        bits--;
+    }
+    if (bits < 64 && token.value.integer >> bits != 0) {
+        add_type_error(c, tet_Overflow, token.pos, token.literal, want, 0);
+    }
+}
+
+// has_typed_operand tells whether untyped expression depends on value of
+// concrete type, this is possible only through count of shift. Such
+// expression is not constant, so its operands need concrete type too
+bool has_typed_operand(Expression expr) {
+    switch (expr.type) {
+    case et_IntegerLiteral:
+    case et_FloatLiteral:
+        return false;
+    case et_Unary:
+        return has_typed_operand(((UnaryExpression *)expr.ptr)->operand);
+    case et_Binary: {
+        BinaryExpression *binary = (BinaryExpression *)expr.ptr;
+        return has_typed_operand(binary->left) || has_typed_operand(binary->right);
+    }
+    default:
+        return true;
+    }
+}
+
+void convert_untyped_operand(TypeChecker *c, Expression *expr, TypeId want);
+
+// convert_untyped gives type want to untyped expression. Constant expression
+// keeps untyped operands, so that folding computes it exactly. Otherwise
+// operands are converted as well, except shift counts
+void convert_untyped(TypeChecker *c, Expression *expr, TypeId want) {
+    expr->type_id = want;
+    if (!has_typed_operand(*expr)) {
+        return;
+    }
+    switch (expr->type) {
+    case et_Unary:
+        convert_untyped_operand(c, &((UnaryExpression *)expr->ptr)->operand, want);
+        break;
+    case et_Binary: {
+        BinaryExpression *binary = (BinaryExpression *)expr->ptr;
+        TokenType operator       = binary->operator.type;
+        convert_untyped_operand(c, &binary->left, want);
+        if (operator != tt_LeftShift && operator != tt_RightShift) {
+            convert_untyped_operand(c, &binary->right, want);
+        } else if (!is_integer_type(c->table, want)) {
+            add_type_error(c, tet_InvalidOperation, binary->operator.pos, token_type_strings[operator], want, 0);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void convert_untyped_operand(TypeChecker *c, Expression *expr, TypeId want) {
+    if (expr->type_id != ti_UntypedInteger && expr->type_id != ti_UntypedFloat) {
+        return;
+    }
+    if (is_integer_type(c->table, want)) {
+        check_integer_fits(c, *expr, want);
+    }
+    convert_untyped(c, expr, want);
+}
+
+// check_assignable reports error if value of expression cannot be stored
+// into variable of type want, untyped expressions are converted to that type
+void check_assignable(TypeChecker *c, Expression *expr, TypeId want) {
+    TypeId got = expr->type_id;
+    if (got == want || got == ti_Invalid || want == ti_Invalid) {
+        return;
+    }
+    if (got == ti_UntypedInteger && is_integer_type(c->table, want)) {
+        check_integer_fits(c, *expr, want);
+        convert_untyped(c, expr, want);
+        return;
+    }
+    if ((got == ti_UntypedInteger || got == ti_UntypedFloat) && is_float_type(c->table, want)) {
+        convert_untyped(c, expr, want);
+        return;
+    }
+    add_type_error(c, tet_Mismatch, get_expression_position(*expr), empty_str, want, got);
+}
+
+TypeId get_default_type(TypeId type) {
+    switch (type) {
+    case ti_UntypedInteger:
+        return default_integer_type;
+    case ti_UntypedFloat:
+        return default_float_type;
+    default:
+        return type;
+    }
+}
+
+TypeId check_expression(TypeChecker *c, Expression *expr);
+
+// check_untyped_arguments is used for calls which do not constrain types of
+// arguments, untyped literals receive their default types
+void check_untyped_arguments(TypeChecker *c, slice_of_Expressions args) {
+    for (u32 i = 0; i < args.len; i++) {
+        Expression *arg = &args.elem[i];
+        check_assignable(c, arg, get_default_type(check_expression(c, arg)));
+    }
+}
+
+TypeId check_call(TypeChecker *c, CallExpression *call) {
+    Symbol *symbol = call->name.symbol;
+    if (symbol == nil) {
+        // undefined name is already reported by name resolution
+        check_untyped_arguments(c, call->args);
+        return ti_Invalid;
+    }
+    if (symbol->kind == sk_Builtin) {
+        // builtins accept any number of values of any type
+        check_untyped_arguments(c, call->args);
+        return ti_Void;
+    }
+
+    Type type = get_type(c->table, symbol->type);
+    if (type.kind != tk_Function) {
+        if (type.kind != tk_Invalid) {
+            add_type_error(c, tet_NotFunction, call->name.token.pos, call->name.token.literal, 0, 0);
+        }
+        check_untyped_arguments(c, call->args);
+        return ti_Invalid;
+    }
+
+    TypeList params = get_tuple_members(c->table, &type.key);
+    if (params.len != call->args.len) {
+        add_type_error(c, tet_ArgumentCount, call->name.token.pos, call->name.token.literal, params.len,
+            call->args.len);
+    }
+    for (u32 i = 0; i < call->args.len; i++) {
+        Expression *arg = &call->args.elem[i];
+        check_expression(c, arg);
+        if (i < params.len) {
+            check_assignable(c, arg, params.elem[i]);
+        }
+    }
+    return type.elem;
+}
+
+bool is_numeric_type(const TypeTable *t, TypeId id) {
+    switch (get_type(t, id).kind) {
+    case tk_Signed:
+    case tk_Unsigned:
+    case tk_Float:
+    case tk_UntypedInteger:
+    case tk_UntypedFloat:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_integer_operand_type(const TypeTable *t, TypeId id) {
+    return id == ti_UntypedInteger || is_integer_type(t, id);
+}
+
+// is_binary_operator_defined tells whether operator can be applied to operands
+// of given type, invalid type accepts any operator
+bool is_binary_operator_defined(const TypeTable *t, TokenType operator, TypeId type) {
+    if (type == ti_Invalid) {
+        return true;
+    }
+    switch (operator) {
+    case tt_Plus:
+        return is_numeric_type(t, type) || type == ti_Str;
+    case tt_Minus:
+    case tt_Asterisk:
+    case tt_Slash:
+        return is_numeric_type(t, type);
+    case tt_Percent:
+    case tt_Ampersand:
+    case tt_Pipe:
+    case tt_Caret:
+    case tt_BitwiseAndNot:
+    case tt_LeftShift:
+    case tt_RightShift:
+        return is_integer_operand_type(t, type);
+    case tt_Equal:
+    case tt_NotEqual:
+        return is_numeric_type(t, type) || type == ti_Str || type == ti_Bool;
+    case tt_Less:
+    case tt_LessOrEqual:
+    case tt_Greater:
+    case tt_GreaterOrEqual:
+        return is_numeric_type(t, type) || type == ti_Str;
+    case tt_LogicalAnd:
+    case tt_LogicalOr:
+        return type == ti_Bool;
+    default:
+        return false;
+    }
+}
+
+bool is_comparison_operator(TokenType operator) {
+    switch (operator) {
+    case tt_Equal:
+    case tt_NotEqual:
+    case tt_Less:
+    case tt_LessOrEqual:
+    case tt_Greater:
+    case tt_GreaterOrEqual:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_unary_operator_defined(const TypeTable *t, TokenType operator, TypeId type) {
+    if (type == ti_Invalid) {
+        return true;
+    }
+    switch (operator) {
+    case tt_Plus:
+    case tt_Minus:
+        return is_numeric_type(t, type);
+    case tt_Caret:
+        return is_integer_operand_type(t, type);
+    case tt_Not:
+        return type == ti_Bool;
+    default:
+        return false;
+    }
+}
+
+// check_binary_operator reports operator which is not defined on type and
+// returns invalid type in that case
+TypeId check_binary_operator(TypeChecker *c, Token operator, TypeId type) {
+    if (is_binary_operator_defined(c->table, operator.type, type)) {
+        return type;
+    }
+    add_type_error(c, tet_InvalidOperation, operator.pos, token_type_strings[operator.type], type, 0);
+    return ti_Invalid;
+}
+
+// unify_operands brings operands of binary operator to common type. Untyped
+// operand takes type of the other one, two untyped operands stay untyped and
+// integer one is promoted to float if needed
+TypeId unify_operands(TypeChecker *c, BinaryExpression *binary) {
+    TypeId left  = binary->left.type_id;
+    TypeId right = binary->right.type_id;
+    if (left == right) {
+        return left;
+    }
+    if (left == ti_Invalid || right == ti_Invalid) {
+        return ti_Invalid;
+    }
+
+    bool left_untyped  = left == ti_UntypedInteger || left == ti_UntypedFloat;
+    bool right_untyped = right == ti_UntypedInteger || right == ti_UntypedFloat;
+    if (left_untyped && right_untyped) {
+        return ti_UntypedFloat;
+    }
+    if (left_untyped) {
+        check_assignable(c, &binary->left, right);
+        return binary->left.type_id == right ? right : ti_Invalid;
+    }
+    if (right_untyped) {
+        check_assignable(c, &binary->right, left);
+        return binary->right.type_id == left ? left : ti_Invalid;
+    }
+    add_type_error(c, tet_Mismatch, get_expression_position(binary->right), empty_str, left, right);
+    return ti_Invalid;
+}
+
+TypeId check_unary(TypeChecker *c, UnaryExpression *unary) {
+    TypeId type = check_expression(c, &unary->operand);
+    if (is_unary_operator_defined(c->table, unary->operator.type, type)) {
+        return type;
+    }
+    add_type_error(c, tet_InvalidOperation, unary->operator.pos, token_type_strings[unary->operator.type], type, 0);
+    return ti_Invalid;
+}
+
+// Shift takes type of its left operand, count may be of any integer type.
+// Comparisons and logical operators give bool
+TypeId check_binary(TypeChecker *c, BinaryExpression *binary) {
+    TokenType operator = binary->operator.type;
+    check_expression(c, &binary->left);
+    check_expression(c, &binary->right);
+
+    if (operator == tt_LeftShift || operator == tt_RightShift) {
+        check_binary_operator(c, binary->operator, binary->right.type_id);
+        return check_binary_operator(c, binary->operator, binary->left.type_id);
+    }
+    if (operator == tt_LogicalAnd || operator == tt_LogicalOr) {
+        check_assignable(c, &binary->left, ti_Bool);
+        check_assignable(c, &binary->right, ti_Bool);
+        return ti_Bool;
+    }
+
+    TypeId type = check_binary_operator(c, binary->operator, unify_operands(c, binary));
+    if (is_comparison_operator(operator)) {
+        return ti_Bool;
+    }
+    return type;
+}
+
+TypeId check_expression(TypeChecker *c, Expression *expr) {
+    switch (expr->type) {
+    case et_Identifier: {
+        Symbol *symbol = ((Identifier *)expr->ptr)->symbol;
+        expr->type_id  = symbol == nil ? ti_Invalid : symbol->type;
+        break;
+    }
+    case et_Call:
+        expr->type_id = check_call(c, (CallExpression *)expr->ptr);
+        break;
+    case et_IntegerLiteral:
+        expr->type_id = ti_UntypedInteger;
+        break;
+    case et_FloatLiteral:
+        expr->type_id = ti_UntypedFloat;
+        break;
+    case et_StringLiteral:
+        expr->type_id = ti_Str;
+        break;
+    case et_Unary:
+        expr->type_id = check_unary(c, (UnaryExpression *)expr->ptr);
+        break;
+    case et_Binary:
+        expr->type_id = check_binary(c, (BinaryExpression *)expr->ptr);
+        break;
+    default:
+        expr->type_id = ti_Invalid;
+        break;
+    }
+    return expr->type_id;
+}
+
+// declare_value assigns type to name on the left side of define statement
+void declare_value(TypeChecker *c, Expression *left, Expression *right, TypeId type) {
+    if (left->type != et_Identifier) {
+        return;
+    }
+    if (type == ti_Void) {
+        add_type_error(c, tet_NoValue, get_expression_position(right == nil ? *left : *right), empty_str, 0, 0);
+        type = ti_Invalid;
+    }
+    type = get_default_type(type);
+    if (right != nil) {
+        check_assignable(c, right, type);
+    }
+
+    Symbol *symbol = ((Identifier *)left->ptr)->symbol;
+    if (symbol != nil && symbol->kind == sk_Variable) {
+        symbol->type = type;
+    }
+    left->type_id = type;
+}
+
+// In define statement with single call on the right side and several names on
+// the left, names receive members of call result tuple
+void check_define_statement(TypeChecker *c, DefineStatement *dstmt) {
+    for (u32 i = 0; i < dstmt->right.len; i++) {
+        check_expression(c, &dstmt->right.elem[i]);
+    }
+
+    if (dstmt->right.len == 1 && dstmt->left.len > 1) {
+        Expression *right = &dstmt->right.elem[0];
+        TypeList values   = get_tuple_members(c->table, &right->type_id);
+        if (right->type_id != ti_Invalid && values.len != dstmt->left.len) {
+            add_type_error(c, tet_ValueCount, get_expression_position(*right), empty_str, dstmt->left.len, values.len);
+        }
+        for (u32 i = 0; i < dstmt->left.len; i++) {
+            TypeId type = i < values.len ? values.elem[i] : ti_Invalid;
+            declare_value(c, &dstmt->left.elem[i], nil, type);
+        }
+        return;
+    }
+
+    if (dstmt->right.len != dstmt->left.len) {
+        add_type_error(c, tet_ValueCount, get_expression_position(dstmt->left.elem[0]), empty_str, dstmt->left.len,
+            dstmt->right.len);
+    }
+    for (u32 i = 0; i < dstmt->left.len; i++) {
+        if (i < dstmt->right.len) {
+            Expression *right = &dstmt->right.elem[i];
+            declare_value(c, &dstmt->left.elem[i], right, right->type_id);
+        } else {
+            declare_value(c, &dstmt->left.elem[i], nil, ti_Invalid);
+        }
+    }
+}
+
+// check_assign_target reports left side of assignment which does not name
+// a variable, parameter or named result, type of such target is invalid
+void check_assign_target(TypeChecker *c, Expression *left) {
+    check_expression(c, left);
+    if (left->type != et_Identifier) {
+        add_type_error(c, tet_NotAssignable, get_expression_position(*left), empty_str, 0, 0);
+        left->type_id = ti_Invalid;
+        return;
+    }
+    Symbol *symbol = ((Identifier *)left->ptr)->symbol;
+    if (symbol == nil || symbol->kind == sk_Variable || symbol->kind == sk_Parameter || symbol->kind == sk_Result) {
+        // undefined name is already reported by name resolution
+        return;
+    }
+    add_type_error(c, tet_NotAssignable, get_expression_position(*left), symbol->name, 0, 0);
+    left->type_id = ti_Invalid;
+}
+
+// Compound assignment takes exactly one value on each side. Plain assignment
+// with single call on the right side stores members of call result tuple
+void check_assign_statement(TypeChecker *c, AssignStatement *astmt) {
+    for (u32 i = 0; i < astmt->right.len; i++) {
+        check_expression(c, &astmt->right.elem[i]);
+    }
+    for (u32 i = 0; i < astmt->left.len; i++) {
+        check_assign_target(c, &astmt->left.elem[i]);
+    }
+
+    TokenType operation = get_assign_operation(astmt->operator.type);
+    if (operation != tt_Empty) {
+        if (astmt->left.len != 1 || astmt->right.len != 1) {
+            add_type_error(c, tet_ValueCount, astmt->operator.pos, empty_str, 1,
+                astmt->left.len > astmt->right.len ? astmt->left.len : astmt->right.len);
+            return;
+        }
+        Token operator = create_token(operation, astmt->operator.pos);
+        TypeId type    = check_binary_operator(c, operator, astmt->left.elem[0].type_id);
+        check_assignable(c, &astmt->right.elem[0], type);
+        return;
+    }
+
+    if (astmt->right.len == 1 && astmt->left.len > 1) {
+        Expression right = astmt->right.elem[0];
+        TypeList values  = get_tuple_members(c->table, &right.type_id);
+        if (right.type_id == ti_Invalid) {
+            return;
+        }
+        if (values.len != astmt->left.len) {
+            add_type_error(c, tet_ValueCount, get_expression_position(right), empty_str, astmt->left.len, values.len);
+            return;
+        }
+        for (u32 i = 0; i < values.len; i++) {
+            TypeId want = astmt->left.elem[i].type_id;
+            if (want != values.elem[i] && want != ti_Invalid && values.elem[i] != ti_Invalid) {
+                add_type_error(c, tet_Mismatch, get_expression_position(right), empty_str, want, values.elem[i]);
+            }
+        }
+        return;
+    }
+
+    if (astmt->right.len != astmt->left.len) {
+        add_type_error(c, tet_ValueCount, astmt->operator.pos, empty_str, astmt->left.len, astmt->right.len);
+        return;
+    }
+    for (u32 i = 0; i < astmt->left.len; i++) {
+        check_assignable(c, &astmt->right.elem[i], astmt->left.elem[i].type_id);
+    }
+}
+
+// Bare return is allowed in functions without result or with named results,
+// single call may supply all result values
+void check_return_statement(TypeChecker *c, ReturnStatement *rstmt) {
+    for (u32 i = 0; i < rstmt->values.len; i++) {
+        check_expression(c, &rstmt->values.elem[i]);
+    }
+    if (c->result == ti_Invalid) {
+        return;
+    }
+    if (rstmt->values.len == 0) {
+        if (c->result != ti_Void && !c->named_results) {
+            TypeList members = get_tuple_members(c->table, &c->result);
+            add_type_error(c, tet_ValueCount, rstmt->token.pos, empty_str, members.len, 0);
+        }
+        return;
+    }
+    if (rstmt->values.len == 1 && rstmt->values.elem[0].type_id == c->result) {
+        return;
+    }
+
+    TypeList members = get_tuple_members(c->table, &c->result);
+    if (members.len != rstmt->values.len) {
+        add_type_error(c, tet_ValueCount, rstmt->token.pos, empty_str, members.len, rstmt->values.len);
+        return;
+    }
+    for (u32 i = 0; i < members.len; i++) {
+        check_assignable(c, &rstmt->values.elem[i], members.elem[i]);
+    }
+}
+
+// check_condition requires boolean value for if and while statements
+void check_condition(TypeChecker *c, Expression *condition) {
+    check_expression(c, condition);
+    check_assignable(c, condition, ti_Bool);
+}
+
+void check_statements(TypeChecker *c, slice_of_Statements stmts);
+
+void check_if_statement(TypeChecker *c, IfStatement *istmt) {
+    for (u32 i = 0; i < istmt->clauses.len; i++) {
+        IfClause *clause = &istmt->clauses.elem[i];
+        check_condition(c, &clause->condition);
+        check_statements(c, clause->body.statements);
+    }
+    if (istmt->else_body != nil) {
+        check_statements(c, istmt->else_body->statements);
+    }
+}
+
+// Loop count may be of any integer type, untyped count gets default integer
+// type
+void check_loop_statement(TypeChecker *c, LoopStatement *lstmt) {
+    if (lstmt->count.ptr != nil) {
+        TypeId type = get_default_type(check_expression(c, &lstmt->count));
+        if (type != ti_Invalid && !is_integer_type(c->table, type)) {
+            add_type_error(c, tet_LoopCount, get_expression_position(lstmt->count), empty_str, 0, type);
+        } else {
+            check_assignable(c, &lstmt->count, type);
+        }
+    }
+    check_statements(c, lstmt->body.statements);
+}
+
+void check_while_statement(TypeChecker *c, WhileStatement *wstmt) {
+    check_condition(c, &wstmt->condition);
+    check_statements(c, wstmt->body.statements);
+}
+
+void check_statement(TypeChecker *c, Statement stmt) {
+    switch (stmt.type) {
+    case st_Define:
+        check_define_statement(c, (DefineStatement *)stmt.ptr);
+        break;
+    case st_Expression:
+        check_expression(c, (Expression *)stmt.ptr);
+        break;
+    case st_Block:
+        check_statements(c, ((BlockStatement *)stmt.ptr)->statements);
+        break;
+    case st_Assign:
+        check_assign_statement(c, (AssignStatement *)stmt.ptr);
+        break;
+    case st_Return:
+        check_return_statement(c, (ReturnStatement *)stmt.ptr);
+        break;
+    case st_If:
+        check_if_statement(c, (IfStatement *)stmt.ptr);
+        break;
+    case st_Loop:
+        check_loop_statement(c, (LoopStatement *)stmt.ptr);
+        break;
+    case st_While:
+        check_while_statement(c, (WhileStatement *)stmt.ptr);
+        break;
+    default:
+        break;
+    }
+}
+
+void check_statements(TypeChecker *c, slice_of_Statements stmts) {
+    for (u32 i = 0; i < stmts.len; i++) {
+        check_statement(c, stmts.elem[i]);
+    }
+}
+
+void declare_builtin_type_names(TypeChecker *c) {
+    push_scope(&c->type_names);
+    for (u32 i = 0; i < builtin_type_names_len; i++) {
+        BuiltinTypeName name = builtin_type_names[i];
+        Symbol *symbol       = new_symbol(sk_Type, name.name, null_position, nil);
+        symbol->type         = name.id;
+        declare_symbol(&c->type_names, symbol);
+    }
+}
+
+// Signatures of all functions are checked before any body, since bodies may
+// call functions defined after them
+TypeCheckResult check_standalone_source_tree(TypeTable *table, StandaloneSourceTree *tree) {
+    TypeChecker c = {
+        .table      = table,
+        .type_names = new_symbol_table(builtin_type_names_len * 2),
+        .errors     = empty_slice_of_TypeErrors,
+        .tuple      = empty_slice_of_TypeIds,
+        .result     = ti_Void,
+    };
+    declare_builtin_type_names(&c);
+
+    for (u32 i = 0; i < tree->functions.len; i++) {
+        check_function_signature(&c, &tree->functions.elem[i]);
+    }
+    for (u32 i = 0; i < tree->functions.len; i++) {
+        FunctionDefinition *def = &tree->functions.elem[i];
+        c.result                = def->declaration.result.type_id;
+        c.named_results         = def->declaration.result.type == frt_TypedTuple;
+        check_statements(&c, def->body.statements);
+    }
+    c.result        = ti_Void;
+    c.named_results = false;
+    check_statements(&c, tree->statements);
+
+    free_symbol_table(&c.type_names);
+    free_slice_of_TypeIds(c.tuple);
+    TypeCheckResult result = {
+        .errors = c.errors,
+    };
+    return result;
+}
+
+void append_u32_to_bytes(slice_of_bytes *b, u32 n) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u", n);
+    append_cstr_to_bytes(b, buf);
+}
+
+str format_type_error(const TypeTable *table, TypeError err) {
+    slice_of_bytes b = empty_slice_of_bytes;
+    switch (err.type) {
+    case tet_UnknownType:
+        append_cstr_to_bytes(&b, "unknown type: ");
+        append_str_to_bytes(&b, err.name);
+        break;
+    case tet_Mismatch:
+        append_cstr_to_bytes(&b, "type mismatch: want ");
+        append_type_to_bytes(&b, table, err.want);
+        append_cstr_to_bytes(&b, ", got ");
+        append_type_to_bytes(&b, table, err.got);
+        break;
+    case tet_ArgumentCount:
+        append_cstr_to_bytes(&b, "wrong number of arguments in call to ");
+        append_str_to_bytes(&b, err.name);
+        append_cstr_to_bytes(&b, ": want ");
+        append_u32_to_bytes(&b, err.want);
+        append_cstr_to_bytes(&b, ", got ");
+        append_u32_to_bytes(&b, err.got);
+        break;
+    case tet_ValueCount:
+        append_cstr_to_bytes(&b, "wrong number of values: want ");
+        append_u32_to_bytes(&b, err.want);
+        append_cstr_to_bytes(&b, ", got ");
+        append_u32_to_bytes(&b, err.got);
+        break;
+    case tet_NotFunction:
+        append_cstr_to_bytes(&b, "not a function: ");
+        append_str_to_bytes(&b, err.name);
+        break;
+    case tet_NoValue:
+        append_cstr_to_bytes(&b, "function call has no value");
+        break;
+    case tet_Overflow:
+        append_cstr_to_bytes(&b, "constant ");
+        if (err.name.len != 0) {
+            append_str_to_bytes(&b, err.name);
+            append_cstr_to_bytes(&b, " ");
+        }
+        append_cstr_to_bytes(&b, "overflows ");
+        append_type_to_bytes(&b, table, err.want);
+        break;
+    case tet_InvalidOperation:
+        append_cstr_to_bytes(&b, "operator ");
+        append_str_to_bytes(&b, err.name);
+        append_cstr_to_bytes(&b, " not defined on ");
+        append_type_to_bytes(&b, table, err.want);
+        break;
+    case tet_DivisionByZero:
+        append_cstr_to_bytes(&b, "division by zero");
+        break;
+    case tet_InvalidShift:
+        append_cstr_to_bytes(&b, "negative shift count");
+        break;
+    case tet_LoopCount:
+        append_cstr_to_bytes(&b, "loop count must be integer, got ");
+        append_type_to_bytes(&b, table, err.got);
+        break;
+    case tet_NotAssignable:
+        append_cstr_to_bytes(&b, "cannot assign to ");
+        if (err.name.len != 0) {
+            append_str_to_bytes(&b, err.name);
+        } else {
+            append_cstr_to_bytes(&b, "expression");
+        }
+        break;
+    }
+
+    str s = new_str_from_bytes(b.elem, b.len);
+    free_slice_of_bytes(b);
+    return s;
+}
@@ -0,0 +1,93 @@
+#ifndef KU_TYPE_CHECK_H
+#define KU_TYPE_CHECK_H
+
+#include "ast.h"
+#include "position.h"
+#include "resolve.h"
+#include "slice.h"
+#include "str.h"
+#include "type_table.h"
+#include "types.h"
+
+typedef enum TypeErrorType TypeErrorType;
+typedef struct TypeError TypeError;
+typedef struct TypeCheckResult TypeCheckResult;
+
+enum TypeErrorType {
+    // type specifier names unknown type, name holds it
+    tet_UnknownType,
+
+    // value of type got is used where type want is expected
+    tet_Mismatch,
+
+    // want and got hold expected and actual number of call arguments
+    tet_ArgumentCount,
+
+    // want and got hold expected and actual number of values in define,
+    // assign or return statement
+    tet_ValueCount,
+
+    // called name does not refer to a function
+    tet_NotFunction,
+
+    // call of function without result is used as value
+    tet_NoValue,
+
+    // constant value does not fit into type want, name holds literal if
+    // error is caused by a single literal
+    tet_Overflow,
+
+    // operator held by name cannot be applied to operands of type want
+    tet_InvalidOperation,
+
+    // constant divisor of integer or float division is zero
+    tet_DivisionByZero,
+
+    // constant shift count is negative
+    tet_InvalidShift,
+
+    // count of loop statement has non-integer type got
+    tet_LoopCount,
+
+    // left side of assignment is not a variable, name holds it if it is
+    // an identifier
+    tet_NotAssignable,
+};
+
+struct TypeError {
+    TypeErrorType type;
+    Position pos;
+
+    // name related to the error, may be empty
+    str name;
+
+    // type ids or counts depending on error type
+    u32 want;
+    u32 got;
+};
+
+TYPEDEF_SLICE(TypeError)
+
+struct TypeCheckResult {
+    // errors of function signatures first, then errors of function bodies
+    // and top level statements in order of definition
+    slice_of_TypeErrors errors;
+};
+
+// check_standalone_source_tree assigns types to expressions, function results
+// and symbols of the tree, all types are interned into given table. Tree must
+// be already processed by name resolution pass
+TypeCheckResult check_standalone_source_tree(TypeTable *table, StandaloneSourceTree *tree);
+
+// get_expression_position returns position used to report errors related to
+// expression
+Position get_expression_position(Expression expr);
+
+// get_default_type returns type which untyped constant gets when it is not
+// converted to another type, other types are returned unchanged
+TypeId get_default_type(TypeId type);
+
+// format_type_error returns new string with error message, without position
+str format_type_error(const TypeTable *table, TypeError err);
+
+#endif // KU_TYPE_CHECK_H
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parser.h"
+#include "resolve.h"
+#include "type_check.h"
+
+typedef struct TypeCheckTestCase TypeCheckTestCase;
+
+struct TypeCheckTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    // first reported error in the form "line:column: message", empty if
+    // there must be no errors
+    str want;
+};
+
+const u32 number_of_test_cases = 15;
+
+const TypeCheckTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("matching argument"),
+        .input = STR("fn f(a: str) {}\n\nfn g() {\n    f(\"x\")\n}\n"),
+        .want  = EMPTY_STR,
+    },
+    {
+        .id    = 2,
+        .label = STR("literal of wrong kind"),
+        .input = STR("fn f(a: str) {}\n\nfn g() {\n    f(1)\n}\n"),
+        .want  = STR("4:7: type mismatch: want str, got untyped integer"),
+    },
+    {
+        .id    = 3,
+        .label = STR("literal does not fit"),
+        .input = STR("fn f(a: u8) {}\n\nfn g() {\n    f(256)\n}\n"),
+        .want  = STR("4:7: constant 256 overflows u8"),
+    },
+    {
+        .id    = 4,
+        .label = STR("unknown type name"),
+        .input = STR("fn f(a: foo) {}\n"),
+        .want  = STR("1:9: unknown type: foo"),
+    },
+    {
+        .id    = 5,
+        .label = STR("variable type comes from its value"),
+        .input = STR("fn f(a: str) {}\n\nfn g(b: []byte) {\n    x := b\n    f(x)\n}\n"),
+        .want  = STR("5:7: type mismatch: want str, got []u8"),
+    },
+    {
+        .id    = 6,
+        .label = STR("equal map types"),
+        .input = STR("fn f(m: map[str => u32]) {}\n\nfn g(n: map[str => rune]) {\n    f(n)\n}\n"),
+        .want  = EMPTY_STR,
+    },
+    {
+        .id    = 7,
+        .label = STR("different map types"),
+        .input = STR("fn f(m: map[str => u32]) {}\n\nfn g(n: map[str => u64]) {\n    f(n)\n}\n"),
+        .want  = STR("4:7: type mismatch: want map[str => u32], got map[str => u64]"),
+    },
+    {
+        .id    = 8,
+        .label = STR("call of parameter"),
+        .input = STR("fn g(b: i32) {\n    b(1)\n}\n"),
+        .want  = STR("2:5: not a function: b"),
+    },
+    {
+        .id    = 9,
+        .label = STR("default type of integer literal"),
+        .input = STR("fn f(a: i32) {}\n\nfn g() {\n    x := 1\n    f(x)\n}\n"),
+        .want  = STR("5:7: type mismatch: want i32, got i64"),
+    },
+    {
+        .id    = 10,
+        .label = STR("function used as value"),
+        .input = STR("fn f(a: i32) => (r: i32, ok: bool) {}\n\nfn g(b: str) {}\n\nfn h() {\n    x := f\n    g(x)\n}\n"),
+        .want  = STR("7:7: type mismatch: want str, got fn(i32) => (i32, bool)"),
+    },
+    {
+        .id    = 11,
+        .label = STR("non-integer loop count"),
+        .input = STR("fn f() {\n    loop 1.5 {}\n}\n"),
+        .want  = STR("2:10: loop count must be integer, got f64"),
+    },
+    {
+        .id    = 12,
+        .label = STR("assignment to function"),
+        .input = STR("fn g() {}\n\nfn f() {\n    g = 1\n}\n"),
+        .want  = STR("4:5: cannot assign to g"),
+    },
+    {
+        .id    = 13,
+        .label = STR("bare return of unnamed result"),
+        .input = STR("fn f() => i32 {\n    return\n}\n"),
+        .want  = STR("2:5: wrong number of values: want 1, got 0"),
+    },
+    {
+        .id    = 14,
+        .label = STR("condition of if statement"),
+        .input = STR("fn f(a: i32) {\n    if a {}\n}\n"),
+        .want  = STR("2:8: type mismatch: want bool, got i32"),
+    },
+    {
+        .id    = 15,
+        .label = STR("untyped shift converted to float"),
+        .input = STR("fn f(r: u16) => f64 {\n    return 1 << r\n}\n"),
+        .want  = STR("2:14: operator << not defined on f64"),
+    },
+};
+
+// depth of nested slice types built to make type table grow several times
+#define NESTED_TYPES_DEPTH 1000
+
+const str pass_str = STR("    type_check_test [ OK ]");
+const str fail_str = STR("[ FAILED ]");
+const str case_str = STR("Test case: ");
+const str want_str = STR("Want: ");
+const str got_str  = STR("Got:  ");
+
+const str interning_label = STR("interning");
+
+void print_failed_test_case(u64 id, str label, str want, str got) {
+    str id_str = format_u64_as_decimal(id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(want_str);
+    println_str(want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+str format_first_error(const TypeTable *table, slice_of_TypeErrors errors) {
+    if (errors.len == 0) {
+        return empty_str;
+    }
+    TypeError err = errors.elem[0];
+    str message   = format_type_error(table, err);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%u:%u: %.*s", err.pos.line, err.pos.column, (int)message.len, (char *)message.bytes);
+    free_str(message);
+    return new_str_from_cstr(buf);
+}
+
+bool run_test_case(TypeCheckTestCase test_case) {
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(test_case.input);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult result             = check_standalone_source_tree(&table, &parse_result.tree);
+
+    str got     = format_first_error(&table, result.errors);
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || !are_strs_equal(got, test_case.want);
+    if (failed) {
+        print_failed_test_case(test_case.id, test_case.label, test_case.want, got);
+    }
+
+    free_str(got);
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(result.errors);
+    free_type_table(&table);
+    return failed;
+}
+
+bool check_same_id(u64 id, u32 want, u32 got) {
+    if (want == got) {
+        return false;
+    }
+    str want_num = format_u64_as_decimal(want);
+    str got_num  = format_u64_as_decimal(got);
+    print_failed_test_case(id, interning_label, want_num, got_num);
+    free_str(want_num);
+    free_str(got_num);
+    return true;
+}
+
+// run_interning_checks verifies that structurally equal types get the same id
+// regardless of how many types were interned between them
+bool run_interning_checks() {
+    TypeTable t = new_type_table();
+
+    TypeId nested[NESTED_TYPES_DEPTH];
+    TypeId elem = ti_U8;
+    for (u32 i = 0; i < NESTED_TYPES_DEPTH; i++) {
+        elem      = intern_slice_type(&t, elem);
+        nested[i] = elem;
+    }
+
+    TypeId members[] = {ti_Str, nested[0], ti_U32};
+    TypeList list    = {
+           .elem = members,
+           .len  = 3,
+    };
+    TypeId tuple = intern_tuple_type(&t, list);
+    TypeId map   = intern_map_type(&t, ti_Str, tuple);
+
+    bool failed = false;
+    elem        = ti_U8;
+    for (u32 i = 0; i < NESTED_TYPES_DEPTH && !failed; i++) {
+        elem   = intern_slice_type(&t, elem);
+        failed = check_same_id(1, nested[i], elem);
+    }
+    failed = failed || check_same_id(2, tuple, intern_tuple_type(&t, list));
+    failed = failed || check_same_id(3, map, intern_map_type(&t, ti_Str, tuple));
+    // different types must not collapse into one id
+    failed = failed || check_same_id(4, false, intern_map_type(&t, ti_Str, ti_U32) == map);
+
+    free_type_table(&t);
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (run_interning_checks()) {
+        failed_test_cases++;
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,332 @@
+#include "type_table.h"
+
+IMPLEMENT_SLICE(Type)
+IMPLEMENT_SLICE(TypeId)
+
+const u32 min_type_table_cap = 64;
+
+// kind and size of each builtin type, indexed by BuiltinTypeId
+const Type builtin_types[] = {
+    [ti_Invalid]        = {.kind = tk_Invalid},
+    [ti_Void]           = {.kind = tk_Void},
+    [ti_Bool]           = {.kind = tk_Bool, .size = 1},
+    [ti_U8]             = {.kind = tk_Unsigned, .size = 1},
+    [ti_U16]            = {.kind = tk_Unsigned, .size = 2},
+    [ti_U32]            = {.kind = tk_Unsigned, .size = 4},
+    [ti_U64]            = {.kind = tk_Unsigned, .size = 8},
+    [ti_I8]             = {.kind = tk_Signed, .size = 1},
+    [ti_I16]            = {.kind = tk_Signed, .size = 2},
+    [ti_I32]            = {.kind = tk_Signed, .size = 4},
+    [ti_I64]            = {.kind = tk_Signed, .size = 8},
+    [ti_F32]            = {.kind = tk_Float, .size = 4},
+    [ti_F64]            = {.kind = tk_Float, .size = 8},
+    [ti_Str]            = {.kind = tk_Str},
+    [ti_Error]          = {.kind = tk_Error},
+    [ti_UntypedInteger] = {.kind = tk_UntypedInteger},
+    [ti_UntypedFloat]   = {.kind = tk_UntypedFloat},
+};
+
+// names used when formatting builtin types, indexed by BuiltinTypeId
+const char *builtin_type_display_names[] = {
+    [ti_Invalid]        = "invalid",
+    [ti_Void]           = "void",
+    [ti_Bool]           = "bool",
+    [ti_U8]             = "u8",
+    [ti_U16]            = "u16",
+    [ti_U32]            = "u32",
+    [ti_U64]            = "u64",
+    [ti_I8]             = "i8",
+    [ti_I16]            = "i16",
+    [ti_I32]            = "i32",
+    [ti_I64]            = "i64",
+    [ti_F32]            = "f32",
+    [ti_F64]            = "f64",
+    [ti_Str]            = "str",
+    [ti_Error]          = "error",
+    [ti_UntypedInteger] = "untyped integer",
+    [ti_UntypedFloat]   = "untyped float",
+};
+
+const BuiltinTypeName builtin_type_names[] = {
+    {.name = STR("bool"), .id = ti_Bool},
+    {.name = STR("u8"), .id = ti_U8},
+    {.name = STR("u16"), .id = ti_U16},
+    {.name = STR("u32"), .id = ti_U32},
+    {.name = STR("u64"), .id = ti_U64},
+    {.name = STR("i8"), .id = ti_I8},
+    {.name = STR("i16"), .id = ti_I16},
+    {.name = STR("i32"), .id = ti_I32},
+    {.name = STR("i64"), .id = ti_I64},
+    {.name = STR("f32"), .id = ti_F32},
+    {.name = STR("f64"), .id = ti_F64},
+    {.name = STR("str"), .id = ti_Str},
+    {.name = STR("error"), .id = ti_Error},
+    {.name = STR("byte"), .id = ti_U8},
+    {.name = STR("rune"), .id = ti_U32},
+};
+
+const u32 builtin_type_names_len = sizeof(builtin_type_names) / sizeof(builtin_type_names[0]);
+
+TypeId *new_type_slots(u32 cap) {
+    TypeId *slots = (TypeId *)alloc_mem(at_Map, (u64)cap * sizeof(TypeId));
+    if (slots == nil) {
+        fatal(1, "not enough memory for type table");
+    }
+    memset(slots, 0, (u64)cap * sizeof(TypeId));
+    return slots;
+}
+
+TypeTable new_type_table() {
+    TypeTable t = {
+        .types   = empty_slice_of_Types,
+        .members = empty_slice_of_TypeIds,
+        .slots   = new_type_slots(min_type_table_cap),
+        .cap     = min_type_table_cap,
+    };
+    for (u32 i = 0; i < ti_end; i++) {
+        append_Type_to_slice(&t.types, builtin_types[i]);
+    }
+    return t;
+}
+
+void free_type_table(TypeTable *t) {
+    free_slice_of_Types(t->types);
+    free_slice_of_TypeIds(t->members);
+    free_mem(t->slots);
+    t->types   = empty_slice_of_Types;
+    t->members = empty_slice_of_TypeIds;
+    t->slots   = nil;
+    t->cap     = 0;
+}
+
+Type get_type(const TypeTable *t, TypeId id) {
+    return t->types.elem[id];
+}
+
+// get_tuple_members returns members of tuple, void gives empty list and any
+// other type is viewed as a tuple of one element. In that case list refers to
+// the id itself, so it must outlive the list
+TypeList get_tuple_members(const TypeTable *t, const TypeId *id) {
+    TypeList list = {
+        .elem = nil,
+        .len  = 0,
+    };
+    Type type = t->types.elem[*id];
+    switch (type.kind) {
+    case tk_Void:
+        break;
+    case tk_Tuple:
+        list.elem = t->members.elem + type.members;
+        list.len  = type.members_len;
+        break;
+    default:
+        list.elem = id;
+        list.len  = 1;
+        break;
+    }
+    return list;
+}
+
+u64 mix_type_hash(u64 h, u64 x) {
+    h ^= x;
+    h *= 0x100000001B3ULL;
+    return h;
+}
+
+u64 hash_type(Type type, TypeList members) {
+    u64 h = 0xCBF29CE484222325ULL;
+    h     = mix_type_hash(h, type.kind);
+    h     = mix_type_hash(h, type.elem);
+    h     = mix_type_hash(h, type.key);
+    for (u32 i = 0; i < members.len; i++) {
+        h = mix_type_hash(h, members.elem[i]);
+    }
+    return h;
+}
+
+bool is_same_type(const TypeTable *t, Type type, TypeList members, TypeId id) {
+    Type other = t->types.elem[id];
+    if (other.hash != type.hash || other.kind != type.kind || other.elem != type.elem || other.key != type.key ||
+        other.members_len != members.len) {
+        return false;
+    }
+    return members.len == 0 ||
+           memcmp(t->members.elem + other.members, members.elem, members.len * sizeof(TypeId)) == 0;
+}
+
+void grow_type_table(TypeTable *t) {
+    TypeId *old = t->slots;
+    u32 old_cap = t->cap;
+    t->cap      = old_cap << 1;
+    t->slots    = new_type_slots(t->cap);
+    u32 mask    = t->cap - 1;
+    for (u32 i = 0; i < old_cap; i++) {
+        if (old[i] == ti_Invalid) {
+            continue;
+        }
+        u32 j = (u32)t->types.elem[old[i]].hash & mask;
+        while (t->slots[j] != ti_Invalid) {
+            j = (j + 1) & mask;
+        }
+        t->slots[j] = old[i];
+    }
+    free_mem(old);
+}
+
+// intern_type returns id of existing type equal to given one or adds it to
+// the table. Members must not refer to memory owned by the table, since it
+// may be moved while they are copied
+TypeId intern_type(TypeTable *t, Type type, TypeList members) {
+    type.hash = hash_type(type, members);
+
+    u32 mask = t->cap - 1;
+    u32 i    = (u32)type.hash & mask;
+    while (t->slots[i] != ti_Invalid) {
+        if (is_same_type(t, type, members, t->slots[i])) {
+            return t->slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    type.members     = t->members.len;
+    type.members_len = members.len;
+    for (u32 j = 0; j < members.len; j++) {
+        append_TypeId_to_slice(&t->members, members.elem[j]);
+    }
+    TypeId id = t->types.len;
+    append_Type_to_slice(&t->types, type);
+    t->slots[i] = id;
+
+    // builtins are not stored in slots, so composite types are counted
+    // from the end of them, load factor is kept at most 1/2
+    if ((t->types.len - ti_end) * 2 > t->cap) {
+        grow_type_table(t);
+    }
+    return id;
+}
+
+TypeId intern_slice_type(TypeTable *t, TypeId elem) {
+    if (elem == ti_Invalid) {
+        return ti_Invalid;
+    }
+    Type type = {
+        .kind = tk_Slice,
+        .elem = elem,
+    };
+    TypeList members = {
+        .elem = nil,
+        .len  = 0,
+    };
+    return intern_type(t, type, members);
+}
+
+TypeId intern_map_type(TypeTable *t, TypeId key, TypeId value) {
+    if (key == ti_Invalid || value == ti_Invalid) {
+        return ti_Invalid;
+    }
+    Type type = {
+        .kind = tk_Map,
+        .elem = value,
+        .key  = key,
+    };
+    TypeList members = {
+        .elem = nil,
+        .len  = 0,
+    };
+    return intern_type(t, type, members);
+}
+
+// intern_tuple_type does not create tuples of less than two members, empty
+// tuple is void and single member tuple is the member itself
+TypeId intern_tuple_type(TypeTable *t, TypeList members) {
+    for (u32 i = 0; i < members.len; i++) {
+        if (members.elem[i] == ti_Invalid) {
+            return ti_Invalid;
+        }
+    }
+    if (members.len == 0) {
+        return ti_Void;
+    }
+    if (members.len == 1) {
+        return members.elem[0];
+    }
+    Type type = {
+        .kind = tk_Tuple,
+    };
+    return intern_type(t, type, members);
+}
+
+TypeId intern_function_type(TypeTable *t, TypeId params, TypeId result) {
+    if (params == ti_Invalid || result == ti_Invalid) {
+        return ti_Invalid;
+    }
+    Type type = {
+        .kind = tk_Function,
+        .elem = result,
+        .key  = params,
+    };
+    TypeList members = {
+        .elem = nil,
+        .len  = 0,
+    };
+    return intern_type(t, type, members);
+}
+
+bool is_integer_type(const TypeTable *t, TypeId id) {
+    TypeKind kind = t->types.elem[id].kind;
+    return kind == tk_Signed || kind == tk_Unsigned;
+}
+
+bool is_float_type(const TypeTable *t, TypeId id) {
+    return t->types.elem[id].kind == tk_Float;
+}
+
+void append_tuple_to_bytes(slice_of_bytes *b, const TypeTable *t, TypeId id) {
+    append_cstr_to_bytes(b, "(");
+    TypeList members = get_tuple_members(t, &id);
+    for (u32 i = 0; i < members.len; i++) {
+        if (i != 0) {
+            append_cstr_to_bytes(b, ", ");
+        }
+        append_type_to_bytes(b, t, members.elem[i]);
+    }
+    append_cstr_to_bytes(b, ")");
+}
+
+// append_type_to_bytes writes type in the same form it is specified in
+// source code
+void append_type_to_bytes(slice_of_bytes *b, const TypeTable *t, TypeId id) {
+    if (id < ti_end) {
+        append_cstr_to_bytes(b, builtin_type_display_names[id]);
+        return;
+    }
+
+    Type type = t->types.elem[id];
+    switch (type.kind) {
+    case tk_Slice:
+        append_cstr_to_bytes(b, "[]");
+        append_type_to_bytes(b, t, type.elem);
+        break;
+    case tk_Map:
+        append_cstr_to_bytes(b, "map[");
+        append_type_to_bytes(b, t, type.key);
+        append_cstr_to_bytes(b, " => ");
+        append_type_to_bytes(b, t, type.elem);
+        append_cstr_to_bytes(b, "]");
+        break;
+    case tk_Tuple:
+        append_tuple_to_bytes(b, t, id);
+        break;
+    case tk_Function:
+        append_cstr_to_bytes(b, "fn");
+        append_tuple_to_bytes(b, t, type.key);
+        if (type.elem != ti_Void) {
+            append_cstr_to_bytes(b, " => ");
+            append_type_to_bytes(b, t, type.elem);
+        }
+        break;
+    default:
+        append_cstr_to_bytes(b, "?");
+        break;
+    }
+}
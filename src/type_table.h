@@ -0,0 +1,141 @@
+#ifndef KU_TYPE_TABLE_H
+#define KU_TYPE_TABLE_H
+
+#include "slice.h"
+#include "str.h"
+#include "strop.h"
+#include "types.h"
+
+// TypeId identifies a distinct type inside TypeTable, two types are equal if
+// and only if their ids are equal
+typedef u32 TypeId;
+
+typedef enum TypeKind TypeKind;
+typedef enum BuiltinTypeId BuiltinTypeId;
+typedef struct Type Type;
+typedef struct TypeList TypeList;
+typedef struct TypeTable TypeTable;
+typedef struct BuiltinTypeName BuiltinTypeName;
+
+enum TypeKind {
+    // type of erroneous expression, compatible with any other type so that
+    // the same error is not reported over and over again
+    tk_Invalid,
+
+    // result of function which does not return anything
+    tk_Void,
+
+    tk_Bool,
+    tk_Signed,
+    tk_Unsigned,
+    tk_Float,
+    tk_Str,
+    tk_Error,
+
+    // literal which was not yet converted to a concrete type
+    tk_UntypedInteger,
+    tk_UntypedFloat,
+
+    tk_Slice,
+    tk_Map,
+    tk_Tuple,
+    tk_Function,
+};
+
+// BuiltinTypeId lists predeclared types, they occupy the first ids of each
+// table in this order
+enum BuiltinTypeId {
+    ti_Invalid,
+    ti_Void,
+    ti_Bool,
+    ti_U8,
+    ti_U16,
+    ti_U32,
+    ti_U64,
+    ti_I8,
+    ti_I16,
+    ti_I32,
+    ti_I64,
+    ti_F32,
+    ti_F64,
+    ti_Str,
+    ti_Error,
+    ti_UntypedInteger,
+    ti_UntypedFloat,
+
+    // not a type, marks the end of builtin ids
+    ti_end,
+};
+
+struct Type {
+    TypeKind kind;
+
+    // size in bytes of integer and float types
+    u32 size;
+
+    // element of slice, value of map or result of function
+    TypeId elem;
+
+    // key of map or tuple of function parameters
+    TypeId key;
+
+    // tuple members are stored in TypeTable.members starting at this index
+    u32 members;
+    u32 members_len;
+
+    u64 hash;
+};
+
+// TypeList is a borrowed view of tuple members
+struct TypeList {
+    const TypeId *elem;
+    u32 len;
+};
+
+TYPEDEF_SLICE(Type)
+TYPEDEF_SLICE(TypeId)
+
+// TypeTable stores each distinct type once (hash consing). Composite types
+// are looked up by their kind and ids of their components, which are already
+// unique, so interning a type costs a single hash probe regardless of its depth
+struct TypeTable {
+    // indexed by TypeId
+    slice_of_Types types;
+
+    // members of all tuples, one after another
+    slice_of_TypeIds members;
+
+    // open addressing set of composite type ids, zero (ti_Invalid) marks
+    // free slot
+    TypeId *slots;
+
+    // always a power of two
+    u32 cap;
+};
+
+// BuiltinTypeName maps predeclared type name to its id
+struct BuiltinTypeName {
+    str name;
+    TypeId id;
+};
+
+extern const BuiltinTypeName builtin_type_names[];
+extern const u32 builtin_type_names_len;
+
+TypeTable new_type_table();
+void free_type_table(TypeTable *t);
+
+Type get_type(const TypeTable *t, TypeId id);
+TypeList get_tuple_members(const TypeTable *t, const TypeId *id);
+
+TypeId intern_slice_type(TypeTable *t, TypeId elem);
+TypeId intern_map_type(TypeTable *t, TypeId key, TypeId value);
+TypeId intern_tuple_type(TypeTable *t, TypeList members);
+TypeId intern_function_type(TypeTable *t, TypeId params, TypeId result);
+
+bool is_integer_type(const TypeTable *t, TypeId id);
+bool is_float_type(const TypeTable *t, TypeId id);
+
+void append_type_to_bytes(slice_of_bytes *b, const TypeTable *t, TypeId id);
+
+#endif // KU_TYPE_TABLE_H
@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "fatal.h"
+#include "jit.h"
+#include "vm.h"
+
+typedef struct VmFrame VmFrame;
+
+// VmFrame saves state of caller while callee runs
+struct VmFrame {
+    const BcFunction *fn;
+
+    // instruction following the call
+    const BcInstruction *ip;
+
+    VmValue *base;
+
+    // first register of caller which receives results
+    u32 dst;
+};
+
+const u64 vm_stack_size = 1 << 20;
+const u32 vm_max_frames = 1 << 16;
+
+// number of rows in each table of profile report
+const u32 vm_profile_report_rows = 16;
+
+#if KU_VM_THREADED
+#define VM_OP(name) vm_##name:
+#define VM_DISPATCH() goto *ip->handler
+#define VM_HANDLER_ENTRY(name, s) [bc_##name] = &&vm_##name,
+#else
+#define VM_OP(name) case bc_##name:
+#define VM_DISPATCH() goto dispatch
+#endif
+
+#define VM_NEXT()                                                                                                      \
+    do {                                                                                                               \
+        ip++;                                                                                                          \
+        VM_DISPATCH();                                                                                                 \
+    } while (0)
+
+#define VM_BINARY(name, field, expr)                                                                                   \
+    VM_OP(name) {                                                                                                      \
+        base[ip->a].field = (expr);                                                                                    \
+        VM_NEXT();                                                                                                     \
+    }
+
+#define VM_COMPARE(name, type, field, expr)                                                                            \
+    VM_OP(name) {                                                                                                      \
+        type x        = base[ip->b].field;                                                                             \
+        type y        = base[ip->c].field;                                                                             \
+        base[ip->a].u = (u64)(expr);                                                                                   \
+        VM_NEXT();                                                                                                     \
+    }
+
+// VM_JUMP counts backward jumps as loop iterations, once function is
+// compiled the loop continues in native code
+#define VM_JUMP(target)                                                                                                \
+    do {                                                                                                               \
+        u32 t = (target);                                                                                              \
+        if (jit != nil && t <= (u32)(ip - code) && heat_jit_function(jit, (u32)(fn - p->functions))) {                 \
+            osr_target = t;                                                                                            \
+            goto vm_osr;                                                                                               \
+        }                                                                                                              \
+        ip = code + t;                                                                                                 \
+        VM_DISPATCH();                                                                                                 \
+    } while (0)
+
+#define VM_COMPARE_JUMP(name, type, field, expr)                                                                       \
+    VM_OP(name) {                                                                                                      \
+        type x = base[ip->a].field;                                                                                    \
+        type y = base[ip->b].field;                                                                                    \
+        if (expr) {                                                                                                    \
+            VM_JUMP(ip->c);                                                                                            \
+        }                                                                                                              \
+        VM_NEXT();                                                                                                     \
+    }
+
+void *alloc_vm_stack(u64 size) {
+    void *p = alloc_mem(at_Vm, size);
+    if (p == nil) {
+        fatal(1, "not enough memory for interpreter stack");
+    }
+    return p;
+}
+
+// Profiling run installs the same counting handler for every instruction,
+// it jumps to the real handler afterwards. This way regular runs do not pay
+// for profiling support.
+//
+// Call sites of compiled functions are rewritten into call_jit, which runs
+// callee natively. When a guard of native code fails, frames recorded by
+// native code are pushed to interpreter stack and interpreter continues
+// where native code stopped
+VmResult run_bc_program(BcProgram *p, u32 entry, VmRuntime *rt, VmProfile *profile, u32 jit_threshold) {
+#if KU_VM_THREADED
+    const void *const handlers[] = {BC_OPCODE_LIST(VM_HANDLER_ENTRY)};
+    bool profiled                = profile != nil;
+    if (!p->threaded || p->profiled != profiled) {
+        for (u32 i = 0; i < p->functions_len; i++) {
+            slice_of_BcInstructions code = p->functions[i].code;
+            for (u32 j = 0; j < code.len; j++) {
+                code.elem[j].handler = profiled ? &&vm_profile : handlers[code.elem[j].op];
+            }
+        }
+        p->threaded = true;
+        p->profiled = profiled;
+    }
+#endif
+
+    VmResult result = {
+        .ok    = true,
+        .error = empty_str,
+    };
+    VmValue *stack     = (VmValue *)alloc_vm_stack(vm_stack_size * sizeof(VmValue));
+    VmFrame *frames    = (VmFrame *)alloc_vm_stack((u64)vm_max_frames * sizeof(VmFrame));
+    VmValue *scratch   = (VmValue *)alloc_vm_stack((u64)p->max_builtin_args * sizeof(VmValue) + 1);
+    VmKind *kinds      = (VmKind *)alloc_vm_stack((u64)p->max_builtin_args * sizeof(VmKind) + 1);
+    const VmValue *end = stack + vm_stack_size;
+    const VmValue *k   = p->constants.elem;
+    const char *error  = nil;
+    u32 depth          = 0;
+    Jit *jit           = nil;
+    u32 osr_target     = 0;
+    if (jit_threshold != 0 && profile == nil) {
+        jit = new_jit(p, rt, end, jit_threshold);
+    }
+
+    // opcode of previously executed instruction, entry function is entered
+    // as if it was called
+    BcOpcode prev = bc_Call;
+
+    const BcFunction *fn      = &p->functions[entry];
+    VmValue *base             = stack;
+    const BcInstruction *code = fn->code.elem;
+    const BcInstruction *ip   = code;
+    if (fn->frame_size > vm_stack_size) {
+        error = "stack overflow";
+        goto fail;
+    }
+
+#if KU_VM_THREADED
+    VM_DISPATCH();
+
+vm_profile:
+    profile->ops[ip->op]++;
+    profile->pairs[prev][ip->op]++;
+    prev = ip->op;
+    goto *handlers[ip->op];
+#else
+dispatch:
+    if (profile != nil) {
+        profile->ops[ip->op]++;
+        profile->pairs[prev][ip->op]++;
+        prev = ip->op;
+    }
+    switch (ip->op) {
+#endif
+
+    VM_OP(Move) {
+        base[ip->a] = base[ip->b];
+        VM_NEXT();
+    }
+    VM_OP(Const) {
+        base[ip->a] = k[ip->b];
+        VM_NEXT();
+    }
+
+    VM_BINARY(Add, u, base[ip->b].u + base[ip->c].u)
+    VM_BINARY(AddI, u, base[ip->b].u + (u64)(i64)(i32)ip->c)
+    VM_BINARY(Sub, u, base[ip->b].u - base[ip->c].u)
+    VM_BINARY(Mul, u, base[ip->b].u * base[ip->c].u)
+
+    VM_OP(DivS) {
+        i64 d = base[ip->c].i;
+        if (d == 0) {
+            error = "division by zero";
+            goto fail;
+        }
+        if (d == -1) {
+            base[ip->a].u = 0 - base[ip->b].u;
+        } else {
+            base[ip->a].i = base[ip->b].i / d;
+        }
+        VM_NEXT();
+    }
+    VM_OP(DivU) {
+        u64 d = base[ip->c].u;
+        if (d == 0) {
+            error = "division by zero";
+            goto fail;
+        }
+        base[ip->a].u = base[ip->b].u / d;
+        VM_NEXT();
+    }
+    VM_OP(RemS) {
+        i64 d = base[ip->c].i;
+        if (d == 0) {
+            error = "division by zero";
+            goto fail;
+        }
+        if (d == -1) {
+            base[ip->a].u = 0;
+        } else {
+            base[ip->a].i = base[ip->b].i % d;
+        }
+        VM_NEXT();
+    }
+    VM_OP(RemU) {
+        u64 d = base[ip->c].u;
+        if (d == 0) {
+            error = "division by zero";
+            goto fail;
+        }
+        base[ip->a].u = base[ip->b].u % d;
+        VM_NEXT();
+    }
+
+    VM_BINARY(And, u, base[ip->b].u & base[ip->c].u)
+    VM_BINARY(Or, u, base[ip->b].u | base[ip->c].u)
+    VM_BINARY(Xor, u, base[ip->b].u ^ base[ip->c].u)
+    VM_BINARY(AndNot, u, base[ip->b].u & ~base[ip->c].u)
+
+    // shift count is taken as unsigned, so negative count shifts all bits out
+    VM_BINARY(Shl, u, base[ip->c].u >= 64 ? 0 : base[ip->b].u << base[ip->c].u)
+    VM_BINARY(ShrS, i, base[ip->b].i >> (base[ip->c].u >= 64 ? 63 : base[ip->c].u))
+    VM_BINARY(ShrU, u, base[ip->c].u >= 64 ? 0 : base[ip->b].u >> base[ip->c].u)
+
+    VM_BINARY(Neg, u, 0 - base[ip->b].u)
+    VM_BINARY(Not, u, base[ip->b].u ^ 1)
+    VM_BINARY(BitNot, u, ~base[ip->b].u)
+    VM_BINARY(Sext8, i, (i8)base[ip->b].u)
+    VM_BINARY(Sext16, i, (i16)base[ip->b].u)
+    VM_BINARY(Sext32, i, (i32)base[ip->b].u)
+    VM_BINARY(Zext8, u, base[ip->b].u & 0xFF)
+    VM_BINARY(Zext16, u, base[ip->b].u & 0xFFFF)
+    VM_BINARY(Zext32, u, base[ip->b].u & 0xFFFFFFFF)
+
+    VM_COMPARE(Eq, u64, u, x == y)
+    VM_COMPARE(Ne, u64, u, x != y)
+    VM_COMPARE(LtS, i64, i, x < y)
+    VM_COMPARE(LeS, i64, i, x <= y)
+    VM_COMPARE(LtU, u64, u, x < y)
+    VM_COMPARE(LeU, u64, u, x <= y)
+
+    VM_BINARY(FAdd, f, base[ip->b].f + base[ip->c].f)
+    VM_BINARY(FSub, f, base[ip->b].f - base[ip->c].f)
+    VM_BINARY(FMul, f, base[ip->b].f * base[ip->c].f)
+    VM_BINARY(FDiv, f, base[ip->b].f / base[ip->c].f)
+    VM_BINARY(FNeg, f, -base[ip->b].f)
+    VM_BINARY(FRound32, f, (f64)(f32)base[ip->b].f)
+
+    // equality is expressed with ordered comparisons, so that NaN is not
+    // equal to anything
+    VM_COMPARE(FEq, f64, f, x <= y && x >= y)
+    VM_COMPARE(FNe, f64, f, !(x <= y && x >= y))
+    VM_COMPARE(FLt, f64, f, x < y)
+    VM_COMPARE(FLe, f64, f, x <= y)
+
+    VM_OP(Concat) {
+        base[ip->a].s = concat_vm_strings(rt, base[ip->b].s, base[ip->c].s);
+        VM_NEXT();
+    }
+    VM_BINARY(StrEq, u, (u64)(compare_vm_strings(base[ip->b].s, base[ip->c].s) == 0))
+    VM_BINARY(StrNe, u, (u64)(compare_vm_strings(base[ip->b].s, base[ip->c].s) != 0))
+    VM_BINARY(StrLt, u, (u64)(compare_vm_strings(base[ip->b].s, base[ip->c].s) < 0))
+    VM_BINARY(StrLe, u, (u64)(compare_vm_strings(base[ip->b].s, base[ip->c].s) <= 0))
+
+    VM_OP(Jump) {
+        VM_JUMP(ip->c);
+    }
+    VM_OP(JumpIf) {
+        if (base[ip->b].u != 0) {
+            VM_JUMP(ip->c);
+        }
+        VM_NEXT();
+    }
+    VM_OP(JumpIfNot) {
+        if (base[ip->b].u == 0) {
+            VM_JUMP(ip->c);
+        }
+        VM_NEXT();
+    }
+    VM_COMPARE_JUMP(JumpEq, u64, u, x == y)
+    VM_COMPARE_JUMP(JumpNe, u64, u, x != y)
+    VM_COMPARE_JUMP(JumpLtS, i64, i, x < y)
+    VM_COMPARE_JUMP(JumpLeS, i64, i, x <= y)
+    VM_COMPARE_JUMP(JumpLtU, u64, u, x < y)
+    VM_COMPARE_JUMP(JumpLeU, u64, u, x <= y)
+    VM_OP(MoveJump) {
+        base[ip->a] = base[ip->b];
+        VM_JUMP(ip->c);
+    }
+
+    // Callee frame starts right after frame of caller, arguments are copied
+    // into its first registers
+    VM_OP(Call) {
+        if (jit != nil && heat_jit_function(jit, ip->b)) {
+            BcInstruction *site = &p->functions[fn - p->functions].code.elem[ip - code];
+            site->op            = bc_CallJit;
+#if KU_VM_THREADED
+            site->handler = handlers[bc_CallJit];
+#endif
+            VM_DISPATCH();
+        }
+        const BcFunction *callee = &p->functions[ip->b];
+        const u32 *list          = fn->lists.elem + ip->c;
+        VmValue *next            = base + fn->frame_size;
+        if (depth == vm_max_frames || next + callee->frame_size > end) {
+            error = "stack overflow";
+            goto fail;
+        }
+        for (u32 i = 0; i < list[0]; i++) {
+            next[i] = base[list[i + 1]];
+        }
+        frames[depth].fn   = fn;
+        frames[depth].ip   = ip + 1;
+        frames[depth].base = base;
+        frames[depth].dst  = ip->a;
+        depth++;
+
+        fn   = callee;
+        base = next;
+        code = fn->code.elem;
+        ip   = code;
+        VM_DISPATCH();
+    }
+    VM_OP(CallJit) {
+        const BcFunction *callee = &p->functions[ip->b];
+        const u32 *list          = fn->lists.elem + ip->c;
+        VmValue *next            = base + fn->frame_size;
+        if (depth == vm_max_frames || next + callee->frame_size > end) {
+            error = "stack overflow";
+            goto fail;
+        }
+        for (u32 i = 0; i < list[0]; i++) {
+            next[i] = base[list[i + 1]];
+        }
+        if (run_jit_function(jit, ip->b, 0, next, base + ip->a, depth + 1)) {
+            VM_NEXT();
+        }
+        frames[depth].fn   = fn;
+        frames[depth].ip   = ip + 1;
+        frames[depth].base = base;
+        frames[depth].dst  = ip->a;
+        depth++;
+        goto vm_deopt;
+    }
+    VM_OP(CallBuiltin) {
+        const u32 *list = fn->lists.elem + ip->c;
+        for (u32 i = 0; i < list[0]; i++) {
+            scratch[i] = base[list[2 * i + 1]];
+            kinds[i]   = (VmKind)list[2 * i + 2];
+        }
+        print_vm_values(rt, ip->b, scratch, kinds, list[0]);
+        VM_NEXT();
+    }
+    VM_OP(Return) {
+        if (depth == 0) {
+            goto done;
+        }
+        const u32 *list = fn->lists.elem + ip->c;
+        depth--;
+        VmFrame caller = frames[depth];
+        for (u32 i = 0; i < list[0]; i++) {
+            caller.base[caller.dst + i] = base[list[i + 1]];
+        }
+        fn   = caller.fn;
+        base = caller.base;
+        code = fn->code.elem;
+        ip   = caller.ip;
+        VM_DISPATCH();
+    }
+
+    // Hot loop continues natively from target of backward jump, results of
+    // function are written to its caller the same way as by return
+vm_osr: {
+    VmValue *results = depth == 0 ? jit->results : frames[depth - 1].base + frames[depth - 1].dst;
+    if (!run_jit_function(jit, (u32)(fn - p->functions), osr_target, base, results, depth)) {
+        goto vm_deopt;
+    }
+    if (depth == 0) {
+        goto done;
+    }
+    depth--;
+    VmFrame caller = frames[depth];
+    fn             = caller.fn;
+    base           = caller.base;
+    code           = fn->code.elem;
+    ip             = caller.ip;
+    VM_DISPATCH();
+}
+
+    // Frames recorded by native code become interpreter frames, the
+    // innermost one continues at the instruction where its guard failed
+vm_deopt: {
+    const JitContext *ctx = &jit->ctx;
+    for (u32 i = ctx->frames_len - 1; i > 0; i--) {
+        JitFrame f         = ctx->frames[i];
+        frames[depth].fn   = &p->functions[f.fn];
+        frames[depth].ip   = p->functions[f.fn].code.elem + f.ip;
+        frames[depth].base = f.base;
+        frames[depth].dst  = f.dst;
+        depth++;
+    }
+    fn   = &p->functions[ctx->frames[0].fn];
+    base = ctx->frames[0].base;
+    code = fn->code.elem;
+    ip   = code + ctx->frames[0].ip;
+    VM_DISPATCH();
+}
+
+#if !KU_VM_THREADED
+    case bc_end:
+        error = "invalid instruction";
+        break;
+    }
+#endif
+
+fail:
+    result = new_vm_error(error, fn->name);
+done:
+    if (jit != nil) {
+        // the next run may not use native code, so call sites are restored
+        for (u32 i = 0; i < p->functions_len; i++) {
+            slice_of_BcInstructions sites = p->functions[i].code;
+            for (u32 j = 0; j < sites.len; j++) {
+                if (sites.elem[j].op == bc_CallJit) {
+                    sites.elem[j].op = bc_Call;
+#if KU_VM_THREADED
+                    sites.elem[j].handler = handlers[bc_Call];
+#endif
+                }
+            }
+        }
+        free_jit(jit);
+    }
+    free_mem(stack);
+    free_mem(frames);
+    free_mem(scratch);
+    free_mem(kinds);
+    return result;
+}
+
+VmProfile *new_vm_profile() {
+    VmProfile *profile = (VmProfile *)alloc_vm_stack(sizeof(VmProfile));
+    memset(profile, 0, sizeof(VmProfile));
+    return profile;
+}
+
+void free_vm_profile(VmProfile *profile) {
+    free_mem(profile);
+}
+
+// take_max_vm_count returns the largest count and clears it, index of the
+// count is stored into given pointer
+u64 take_max_vm_count(u64 *counts, u32 len, u32 *index) {
+    u32 max = 0;
+    for (u32 i = 1; i < len; i++) {
+        if (counts[i] > counts[max]) {
+            max = i;
+        }
+    }
+    u64 count   = counts[max];
+    counts[max] = 0;
+    *index      = max;
+    return count;
+}
+
+void print_vm_profile_row(str first, str second, u64 count, u64 total) {
+    char name[64];
+    if (second.len == 0) {
+        snprintf(name, sizeof(name), "%.*s", (int)first.len, (char *)first.bytes);
+    } else {
+        snprintf(name, sizeof(name), "%.*s, %.*s", (int)first.len, (char *)first.bytes, (int)second.len,
+            (char *)second.bytes);
+    }
+    fprintf(stderr, "%-28s  %16llu  %6.2f%%\n", name, (unsigned long long)count, 100.0 * (double)count / (double)total);
+}
+
+void print_vm_profile_report(const VmProfile *profile) {
+    u64 total = 0;
+    for (u32 i = 0; i < bc_end; i++) {
+        total += profile->ops[i];
+    }
+    if (total == 0) {
+        fprintf(stderr, "no instructions executed\n");
+        return;
+    }
+
+    u64 *counts = (u64 *)alloc_vm_stack(sizeof(profile->pairs));
+    memcpy(counts, profile->ops, sizeof(profile->ops));
+    fprintf(stderr, "%-28s  %16s  %7s\n", "opcode", "count", "share");
+    for (u32 i = 0; i < vm_profile_report_rows; i++) {
+        u32 op;
+        u64 count = take_max_vm_count(counts, bc_end, &op);
+        if (count == 0) {
+            break;
+        }
+        print_vm_profile_row(bc_opcode_names[op], empty_str, count, total);
+    }
+
+    memcpy(counts, profile->pairs, sizeof(profile->pairs));
+    fprintf(stderr, "\n%-28s  %16s  %7s\n", "opcode pair", "count", "share");
+    for (u32 i = 0; i < vm_profile_report_rows; i++) {
+        u32 pair;
+        u64 count = take_max_vm_count(counts, bc_end * bc_end, &pair);
+        if (count == 0) {
+            break;
+        }
+        print_vm_profile_row(bc_opcode_names[pair / bc_end], bc_opcode_names[pair % bc_end], count, total);
+    }
+    free_mem(counts);
+}
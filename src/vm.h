@@ -0,0 +1,52 @@
+#ifndef KU_VM_H
+#define KU_VM_H
+
+#include "bytecode.h"
+#include "runtime.h"
+#include "types.h"
+
+// Interpreter dispatches instructions with computed goto when compiler
+// supports labels as values: each instruction stores address of its handler
+// and handler jumps straight to the next one (direct threading). Define
+// KU_VM_SWITCH_DISPATCH to use portable switch loop instead
+#if defined(__GNUC__) && !defined(KU_VM_SWITCH_DISPATCH)
+#define KU_VM_THREADED 1
+#else
+#define KU_VM_THREADED 0
+#endif
+
+typedef struct VmProfile VmProfile;
+
+// VmProfile counts executed instructions by opcode and pairs of instructions
+// executed one after another, frequent pairs are candidates for fusion into
+// a single instruction
+struct VmProfile {
+    u64 ops[bc_end];
+
+    // pairs[x][y] counts executions of y right after x
+    u64 pairs[bc_end][bc_end];
+};
+
+// number of registers in interpreter stack, frames of all active calls
+// are placed there one after another
+extern const u64 vm_stack_size;
+
+// maximal depth of calls
+extern const u32 vm_max_frames;
+
+// run_bc_program calls function with given index, it must not have
+// parameters and its results are discarded. Calls do not use C stack, deep
+// recursion of the program ends with "stack overflow" error. Executed
+// instructions are counted into profile if it is not nil. Functions called
+// or looping jit_threshold times are compiled into native code, zero
+// threshold or profiling keeps all of them in bytecode
+VmResult run_bc_program(BcProgram *p, u32 entry, VmRuntime *rt, VmProfile *profile, u32 jit_threshold);
+
+VmProfile *new_vm_profile();
+void free_vm_profile(VmProfile *profile);
+
+// print_vm_profile_report prints the most frequent opcodes and pairs of
+// opcodes to stderr
+void print_vm_profile_report(const VmProfile *profile);
+
+#endif // KU_VM_H
@@ -0,0 +1,356 @@
+// mkdtemp and unlink are not part of C11
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "bytecode.h"
+#include "cgen.h"
+#include "const_eval.h"
+#include "fatal.h"
+#include "jit.h"
+#include "lower.h"
+#include "opt.h"
+#include "parser.h"
+#include "resolve.h"
+#include "timer.h"
+#include "toolchain.h"
+#include "type_check.h"
+#include "vm.h"
+#include "walk.h"
+#include "x64.h"
+
+typedef struct BenchProgram BenchProgram;
+typedef struct BenchSubject BenchSubject;
+
+struct BenchProgram {
+    str name;
+    str source;
+};
+
+// BenchSubject holds program prepared for both interpreters and executables
+// built by native code generators
+struct BenchSubject {
+    StandaloneParseResult parse;
+    TypeTable table;
+    BcProgram program;
+
+    // index of function main in syntax tree and in bytecode
+    u32 tree_entry;
+    u32 bc_entry;
+
+    // executables indexed by backend, empty if build failed
+    char native_paths[2][512];
+};
+
+const BenchProgram bench_programs[] = {
+    {
+        .name   = STR("fib"),
+        .source = STR("fn fib(n: i64) => i64 {\n    if n < 2 {\n        return n\n    }\n"
+                      "    return fib(n - 1) + fib(n - 2)\n}\n\nfn main() {\n    println(fib(27))\n}\n"),
+    },
+    {
+        .name   = STR("loops"),
+        .source = STR("fn main() {\n    s := 0\n    i := 0\n    while i < 2000 {\n        j := 0\n"
+                      "        while j < 1000 {\n            s += i * j + 1\n            j += 1\n        }\n"
+                      "        i += 1\n    }\n    println(s)\n}\n"),
+    },
+    {
+        .name   = STR("strings"),
+        .source = STR("fn main() {\n    s := \"\"\n    n := 0\n    loop 200000 {\n        s = s + \"ab\"\n"
+                      "        if s < \"b\" {\n            n += 1\n        }\n    }\n    println(n, s == \"\")\n}\n"),
+    },
+};
+
+const u32 number_of_bench_programs = 3;
+
+const str bench_entry_name   = STR("main");
+const str repeat_flag_prefix = STR("--repeat=");
+const str profile_flag       = STR("--profile");
+
+const u64 bench_output_buffer_cap = 1 << 12;
+
+// native programs are built by both code generators the same way as by
+// cckuc build and emit-c commands
+const u32 number_of_native_backends = 2;
+
+const char *const native_backend_names[] = {"x64", "c"};
+
+// build_native_bench_program writes source of the module into dir and
+// compiles it into executable at path
+bool build_native_bench_program(const IrModule *m, u32 backend, const char *path) {
+    char src_path[600];
+    snprintf(src_path, sizeof(src_path), backend == 0 ? "%s.s" : "%s.c", path);
+    FILE *file = fopen(src_path, "w");
+    if (file == nil) {
+        return false;
+    }
+    OutputBuffer out = new_output_buffer(fileno(file), bench_output_buffer_cap);
+    if (backend == 0) {
+        write_x64_module(&out, m, find_ir_function(m, bench_entry_name));
+    } else {
+        write_c_module(&out, m, find_ir_function(m, bench_entry_name));
+    }
+    bool ok = flush_output(&out);
+    free_output_buffer(&out);
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    str runtime                  = get_native_runtime_path();
+    char *rt_path                = str_to_cstr(runtime);
+    str bin_dir                  = get_toolchain_dir();
+    char *include                = str_to_cstr(bin_dir);
+    const char *const asm_args[] = {"-o", path, src_path, rt_path, nil};
+    const char *const c_args[]   = {"-O2", c_recursion_flag, "-I", include, "-o", path, src_path, rt_path, nil};
+    ok                           = run_c_compiler(backend == 0 ? asm_args : c_args);
+    free_mem(include);
+    free_str(bin_dir);
+    free_mem(rt_path);
+    free_str(runtime);
+    unlink(src_path);
+    return ok;
+}
+
+// prepare_bench_subject compiles program for interpreters and, if dir is
+// not nil, builds native executables in dir
+BenchSubject prepare_bench_subject(BenchProgram bp, const char *dir) {
+    BenchSubject s = {
+        .parse        = parse_standalone_source_from_str(bp.source),
+        .table        = new_type_table(),
+        .program      = empty_bc_program,
+        .tree_entry   = 0,
+        .bc_entry     = 0,
+        .native_paths = {{0}, {0}},
+    };
+    ResolveResult resolved = resolve_standalone_source_tree(nil, &s.parse.tree);
+    TypeCheckResult checks = check_standalone_source_tree(&s.table, &s.parse.tree);
+    FoldResult folded      = fold_standalone_source_tree(&s.table, &s.parse.tree);
+    if (resolved.errors.len != 0 || checks.errors.len != 0 || folded.errors.len != 0) {
+        fatal(1, "benchmark program has errors");
+    }
+    free_slice_of_ResolveErrors(resolved.errors);
+    free_slice_of_TypeErrors(checks.errors);
+    free_slice_of_TypeErrors(folded.errors);
+
+    LowerResult lowered = lower_standalone_source_tree(&s.table, &s.parse.tree);
+    optimize_ir_module(&lowered.module, ol_Full, empty_str);
+    s.program  = compile_ir_module(&lowered.module);
+    s.bc_entry = find_bc_function(&s.program, bench_entry_name);
+    for (u32 i = 0; i < number_of_native_backends && dir != nil; i++) {
+        char *path = s.native_paths[i];
+        snprintf(path, sizeof(s.native_paths[i]), "%s/%.*s_%s", dir, (int)bp.name.len, (char *)bp.name.bytes,
+                 native_backend_names[i]);
+        if (!build_native_bench_program(&lowered.module, i, path)) {
+            path[0] = 0;
+        }
+    }
+    free_slice_of_LowerErrors(lowered.errors);
+    free_ir_module(&lowered.module);
+
+    for (u32 i = 0; i < s.parse.tree.functions.len; i++) {
+        if (are_strs_equal(s.parse.tree.functions.elem[i].declaration.name.token.literal, bench_entry_name)) {
+            s.tree_entry = i;
+        }
+    }
+    return s;
+}
+
+// run_bench_subject executes program once with chosen interpreter, output of
+// the program is returned to compare it between interpreters. Profile and
+// threshold of native compilation are used only by bytecode interpreter
+str run_bench_subject(BenchSubject *s, bool walk, VmProfile *profile, u32 jit_threshold) {
+    OutputBuffer out = new_output_buffer(-1, bench_output_buffer_cap);
+    VmRuntime rt     = init_vm_runtime(&out);
+    VmResult result;
+    if (walk) {
+        result = walk_standalone_source_tree(&s->table, &s->parse.tree, s->tree_entry, &rt);
+    } else {
+        result = run_bc_program(&s->program, s->bc_entry, &rt, profile, jit_threshold);
+    }
+    if (!result.ok) {
+        fatal(1, "benchmark program failed");
+    }
+    str output = new_str_from_bytes(out.bytes, out.len);
+    free_vm_runtime(&rt);
+    free_output_buffer(&out);
+    return output;
+}
+
+// measure_bench_subject returns best wall time of several runs
+u64 measure_bench_subject(BenchSubject *s, bool walk, u32 jit_threshold, u32 repetitions, str *output) {
+    u64 best = UINT64_MAX;
+    for (u32 i = 0; i < repetitions; i++) {
+        u64 start   = get_wall_time_ns();
+        str got     = run_bench_subject(s, walk, nil, jit_threshold);
+        u64 elapsed = get_wall_time_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        free_str(*output);
+        *output = got;
+    }
+    return best;
+}
+
+// run_native_bench_program runs executable once, its output is redirected
+// into file next to it and returned. Time of starting the process is
+// included into measurement
+str run_native_bench_program(const char *path, u64 *elapsed) {
+    char out_path[600];
+    char command[1300];
+    snprintf(out_path, sizeof(out_path), "%s.out", path);
+    snprintf(command, sizeof(command), "%s > %s", path, out_path);
+    u64 start = get_wall_time_ns();
+    int code  = system(command);
+    *elapsed  = get_wall_time_ns() - start;
+    if (code != 0) {
+        fatal(1, "native benchmark program failed");
+    }
+
+    byte *bytes = (byte *)alloc_mem(at_String, bench_output_buffer_cap);
+    FILE *file  = fopen(out_path, "r");
+    u64 len     = 0;
+    if (file != nil) {
+        len = fread(bytes, 1, bench_output_buffer_cap, file);
+        fclose(file);
+    }
+    str output = new_str_from_bytes(bytes, len);
+    free_mem(bytes);
+    unlink(out_path);
+    return output;
+}
+
+// measure_native_bench_program returns best wall time of several runs,
+// zero if executable was not built
+u64 measure_native_bench_program(const char *path, u32 repetitions, str want) {
+    if (path[0] == 0) {
+        return 0;
+    }
+    u64 best = UINT64_MAX;
+    for (u32 i = 0; i < repetitions; i++) {
+        u64 elapsed;
+        str got = run_native_bench_program(path, &elapsed);
+        if (!are_strs_equal(got, want)) {
+            fatal(1, "benchmark outputs differ between interpreter and native program");
+        }
+        free_str(got);
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+void free_bench_subject(BenchSubject *s) {
+    for (u32 i = 0; i < number_of_native_backends; i++) {
+        if (s->native_paths[i][0] != 0) {
+            unlink(s->native_paths[i]);
+        }
+    }
+    free_bc_program(&s->program);
+    free_type_table(&s->table);
+}
+
+void run_program_benchmark(BenchProgram bp, u32 repetitions, const char *dir) {
+    BenchSubject s = prepare_bench_subject(bp, dir);
+
+    str vm_output   = empty_str;
+    str walk_output = empty_str;
+    str jit_output  = empty_str;
+    u64 vm_time     = measure_bench_subject(&s, false, 0, repetitions, &vm_output);
+    u64 walk_time   = measure_bench_subject(&s, true, 0, repetitions, &walk_output);
+    u64 jit_time    = measure_bench_subject(&s, false, jit_default_threshold, repetitions, &jit_output);
+    if (!are_strs_equal(vm_output, walk_output) || !are_strs_equal(vm_output, jit_output)) {
+        fatal(1, "benchmark outputs differ between interpreters");
+    }
+
+    printf("%-8.*s  bytecode: %9.3f ms  tree walking: %9.3f ms  speedup: %6.2f\n",
+        (int)bp.name.len,
+        (char *)bp.name.bytes,
+        (double)vm_time / 1e6,
+        (double)walk_time / 1e6,
+        (double)walk_time / (double)vm_time);
+    printf("%-8s  %-8s  %9.3f ms  speedup over bytecode: %6.2f\n",
+        "",
+        "jit",
+        (double)jit_time / 1e6,
+        (double)vm_time / (double)jit_time);
+    for (u32 i = 0; i < number_of_native_backends; i++) {
+        u64 native_time = measure_native_bench_program(s.native_paths[i], repetitions, vm_output);
+        if (native_time == 0) {
+            printf("%-8s  %-8s  build failed\n", "", native_backend_names[i]);
+            continue;
+        }
+        printf("%-8s  %-8s  %9.3f ms  speedup over bytecode: %6.2f\n",
+            "",
+            native_backend_names[i],
+            (double)native_time / 1e6,
+            (double)vm_time / (double)native_time);
+    }
+
+    free_str(vm_output);
+    free_str(walk_output);
+    free_str(jit_output);
+    free_bench_subject(&s);
+}
+
+// profile_bench_programs runs each program once and reports instructions
+// executed by all of them together
+void profile_bench_programs() {
+    VmProfile *profile = new_vm_profile();
+    for (u32 i = 0; i < number_of_bench_programs; i++) {
+        BenchSubject s = prepare_bench_subject(bench_programs[i], nil);
+        free_str(run_bench_subject(&s, false, profile, 0));
+        free_bench_subject(&s);
+    }
+    print_vm_profile_report(profile);
+    free_vm_profile(profile);
+}
+
+// Usage: vm_bench [--repeat=N] [--profile]
+//
+// Runs each program with bytecode interpreter and with tree walking
+// interpreter, reports best time of N runs (5 by default). Bytecode is timed
+// once more with hot functions compiled into native code by JIT, compilation
+// included. Programs are also built into executables by x64 and C code
+// generators and timed against bytecode, process startup included. Bytecode
+// and native programs are compiled with full optimization, compilation is
+// not measured. With profile flag programs are not timed, instead opcodes
+// and pairs of opcodes executed by all of them are reported
+int main(int argc, char **argv) {
+    u32 repetitions = 5;
+    bool profile    = false;
+    for (int i = 1; i < argc; i++) {
+        str arg = take_str_from_cstr(argv[i]);
+        if (are_strs_equal(arg, profile_flag)) {
+            profile = true;
+            continue;
+        }
+        if (!has_prefix_str(arg, repeat_flag_prefix)) {
+            fatal(1, "unknown flag");
+        }
+        U32ParseResult res = parse_u32_from_decimal(borrow_str_slice_to_end(arg, repeat_flag_prefix.len));
+        if (!res.ok || res.num == 0) {
+            fatal(1, "invalid number of repetitions");
+        }
+        repetitions = res.num;
+    }
+
+    if (profile) {
+        profile_bench_programs();
+        return 0;
+    }
+    char dir[] = "/tmp/vm_bench.XXXXXX";
+    if (mkdtemp(dir) == nil) {
+        fatal(1, "error creating temporary directory");
+    }
+    for (u32 i = 0; i < number_of_bench_programs; i++) {
+        run_program_benchmark(bench_programs[i], repetitions, dir);
+    }
+    rmdir(dir);
+    return 0;
+}
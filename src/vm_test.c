@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bytecode.h"
+#include "const_eval.h"
+#include "lower.h"
+#include "opt.h"
+#include "parser.h"
+#include "resolve.h"
+#include "source.h"
+#include "jit.h"
+#include "type_check.h"
+#include "vm.h"
+#include "walk.h"
+
+typedef enum VmTestMode VmTestMode;
+typedef struct VmTestCase VmTestCase;
+
+// VmTestMode selects how program of test case is executed, each case is
+// checked in all modes
+enum VmTestMode {
+    vtm_Bytecode,
+    vtm_OptimizedBytecode,
+    vtm_Jit,
+    vtm_OptimizedJit,
+    vtm_Walk,
+
+    vtm_end,
+};
+
+struct VmTestCase {
+    u64 id;
+    str label;
+    str input;
+
+    // when set program is read from the file instead of input, path is
+    // relative to repository root from which tests are run
+    char *path;
+
+    // output of the program followed by runtime error if there is one
+    str want;
+};
+
+const u32 number_of_test_cases = 16;
+
+const VmTestCase test_cases[] = {
+    {
+        .id    = 1,
+        .label = STR("hello"),
+        .input = STR("fn main() {\n    println(\"hello\")\n    print(\"a\\tb\\n\")\n}\n"),
+        .want  = STR("hello\na\tb\n"),
+    },
+    {
+        .id    = 2,
+        .label = STR("fibonacci loop"),
+        .input = STR("fn fib(n: i64) => i64 {\n    if n == 0 {\n        return 0\n    }\n    a := 0\n    b := 1\n"
+                     "    loop n - 1 {\n        a, b = b, a + b\n    }\n    return b\n}\n\n"
+                     "fn main() {\n    n := 12\n    println(\"{} fibonacci number is {}\", n, fib(n))\n}\n"),
+        .want  = STR("12 fibonacci number is 144\n"),
+    },
+    {
+        .id    = 3,
+        .label = STR("recursion"),
+        .input = STR("fn fact(n: i64) => i64 {\n    if n <= 1 {\n        return 1\n    }\n    return n * fact(n - 1)\n}\n\n"
+                     "fn main() {\n    println(fact(20), fact(21))\n}\n"),
+        .want  = STR("2432902008176640000 -4249290049419214848\n"),
+    },
+    {
+        .id    = 4,
+        .label = STR("named results"),
+        .input = STR("fn divmod(a: i64, b: i64) => (q: i64, r: i64) {\n    q = a / b\n    r = a % b\n    return\n}\n\n"
+                     "fn main() {\n    q, r := divmod(-17, 5)\n    println(q, r)\n    println(divmod(17, 5))\n}\n"),
+        .want  = STR("-3 -2\n3 2\n"),
+    },
+    {
+        .id    = 5,
+        .label = STR("string building"),
+        .input = STR("fn main() {\n    s := \"\"\n    loop 3 {\n        s = s + \"ab\"\n    }\n    t := s + \"!\"\n"
+                     "    println(s, t, s == \"ababab\", s < t)\n}\n"),
+        .want  = STR("ababab ababab! true true\n"),
+    },
+    {
+        .id    = 6,
+        .label = STR("narrow integers wrap"),
+        .input = STR("fn add(x: u8, y: u8) => u8 {\n    return x + y\n}\n\n"
+                     "fn neg(x: i16) => i16 {\n    return -x\n}\n\n"
+                     "fn main() {\n    println(add(100, 200), neg(-32768), add(255, 1) < 1)\n}\n"),
+        .want  = STR("44 -32768 true\n"),
+    },
+    {
+        .id    = 7,
+        .label = STR("floats"),
+        .input = STR("fn half(x: f64) => f64 {\n    return x / 2.0\n}\n\n"
+                     "fn third(x: f32) => f32 {\n    return x / 3.0\n}\n\n"
+                     "fn main() {\n    println(half(3.0), third(1.0), half(0.2) == 0.1)\n}\n"),
+        .want  = STR("1.5 0.33333334 true\n"),
+    },
+    {
+        .id    = 8,
+        .label = STR("while and short circuit"),
+        .input = STR("fn check(n: i64) => bool {\n    println(\"check\", n)\n    return n > 1\n}\n\n"
+                     "fn main() {\n    i := 0\n    while i < 3 && check(i) || i == 0 {\n        i += 1\n    }\n"
+                     "    println(\"{}\", i)\n}\n"),
+        .want  = STR("check 0\ncheck 1\n1\n"),
+    },
+    {
+        .id    = 9,
+        .label = STR("division by zero"),
+        .input = STR("fn div(a: i64, b: i64) => i64 {\n    return a / b\n}\n\n"
+                     "fn main() {\n    println(\"before\")\n    println(div(1, 0))\n    println(\"after\")\n}\n"),
+        .want  = STR("before\nruntime error: division by zero in function div"),
+    },
+    {
+        .id    = 10,
+        .label = STR("unbounded recursion"),
+        .input = STR("fn f(n: i64) => i64 {\n    return f(n + 1) + 1\n}\n\nfn main() {\n    println(f(0))\n}\n"),
+        .want  = STR("runtime error: stack overflow in function f"),
+    },
+    {
+        .id    = 11,
+        .label = STR("fused compare and immediates"),
+        .input = STR("fn down(n: u32, k: u8) => (steps: i64, last: u8) {\n    while n >= 3 {\n        n = n - 3\n"
+                     "        k = k - 1\n        steps += 1\n    }\n    last = k\n    return\n}\n\n"
+                     "fn main() {\n    s, l := down(10, 0)\n    if s != 3 {\n        println(\"wrong\")\n    } else {\n"
+                     "        println(s, l)\n    }\n}\n"),
+        .want  = STR("3 253\n"),
+    },
+    {
+        .id    = 12,
+        .label = STR("hot loops and calls"),
+        .input = STR("fn step(x: f64) => f64 {\n    return x * 0.5 + 1.0\n}\n\n"
+                     "fn count(n: i64) => (sum: i64, s: str) {\n    i := 0\n    while i < n {\n        sum += i % 7\n"
+                     "        if i % 1000 == 0 {\n            s = s + \"x\"\n        }\n        i += 1\n    }\n"
+                     "    return\n}\n\n"
+                     "fn depth(n: i64) => i64 {\n    if n == 0 {\n        return 0\n    }\n"
+                     "    return depth(n - 1) + 1\n}\n\n"
+                     "fn main() {\n    x := 0.0\n    loop 100 {\n        x = step(x)\n    }\n"
+                     "    sum, s := count(5000)\n    println(x, sum, s, s < \"xy\", depth(4000))\n}\n"),
+        .want  = STR("2 14995 xxxxx true 4000\n"),
+    },
+    {
+        .id    = 13,
+        .label = STR("untyped shift operands"),
+        .input = STR("fn bit(r: u16) => u16 {\n    return 1 << r\n}\n\n"
+                     "fn mask(r: u8) => i8 {\n    return -(1 << r) + 1\n}\n\n"
+                     "fn main() {\n    println(bit(3), bit(15), bit(16), mask(7), 1 << bit(2))\n}\n"),
+        .want  = STR("8 32768 0 -127 16\n"),
+    },
+    {
+        .id    = 14,
+        .label = STR("float notation"),
+        .input = STR("fn scale(x: f64, k: f64) => f64 {\n    return x * k\n}\n\n"
+                     "fn main() {\n    println(scale(1.0, 10.0), scale(1000.0, 1000.0), scale(0.5, 0.001))\n"
+                     "    println(scale(1.0, 100000000000000000000.0), scale(10.0, 100000000000000000000.0))\n"
+                     "    println(scale(-1.0, 0.000001), scale(2.0, 61.625))\n}\n"),
+        .want  = STR("10 1000000 0.0005\n100000000000000000000 1e+21\n-1e-06 123.25\n"),
+    },
+    {
+        .id    = 15,
+        .label = STR("fibonacci pairs program"),
+        .path  = "tests/fibonacci_pairs.ku",
+        .want  = STR("12 fibonacci number is 144\n90 fibonacci number is 2880067194370816120\n"),
+    },
+    {
+        .id    = 16,
+        .label = STR("increment statements"),
+        .input = STR("fn main() {\n    x := 1\n    x++\n    x--\n    x++\n    println(\"{}\", x)\n"
+                     "    i := 0\n    s := 0\n    while i < 10 { s += 1; i++ }\n    s--\n    println(i, s)\n}\n"),
+        .want  = STR("2\n10 9\n"),
+    },
+};
+
+const u64 test_output_buffer_cap = 1 << 16;
+
+// functions are compiled on the second call or loop iteration, so that both
+// calls of native code and entry into running loops are covered
+const u32 test_jit_threshold = 2;
+
+const str pass_str  = STR("    vm_test [ OK ]");
+const str fail_str  = STR("[ FAILED ]");
+const str case_str  = STR("Test case: ");
+const str mode_str  = STR("Mode: ");
+const str want_str  = STR("Want: ");
+const str got_str   = STR("Got:  ");
+const str error_str = STR("runtime error: ");
+
+const str test_entry_name  = STR("main");
+const str front_errors_str = STR("errors before execution");
+const str read_error_str   = STR("error reading program file");
+
+const str vm_test_mode_names[] = {
+    [vtm_Bytecode]          = STR("bytecode -O0"),
+    [vtm_OptimizedBytecode] = STR("bytecode -O2"),
+    [vtm_Jit]               = STR("jit -O0"),
+    [vtm_OptimizedJit]      = STR("jit -O2"),
+    [vtm_Walk]              = STR("tree walking"),
+};
+
+void print_failed_test_case(VmTestCase test_case, VmTestMode mode, str got) {
+    str id_str = format_u64_as_decimal(test_case.id);
+
+    println();
+    println_str(fail_str);
+    print_str(case_str);
+    print_str(id_str);
+    fwrite(" (", 1, 2, stdout);
+    print_str(test_case.label);
+    fwrite(")\n", 1, 2, stdout);
+    print_str(mode_str);
+    println_str(vm_test_mode_names[mode]);
+    print_str(want_str);
+    println_str(test_case.want);
+    print_str(got_str);
+    println_str(got);
+
+    free_str(id_str);
+}
+
+void print_test_passed_message() {
+    println();
+    println_str(pass_str);
+    println();
+}
+
+// run_test_bytecode compiles the tree and runs function main, zero threshold
+// disables compilation into native code
+VmResult run_test_bytecode(
+    const TypeTable *table, const StandaloneSourceTree *tree, OptLevel level, u32 jit_threshold, VmRuntime *rt) {
+    LowerResult lowered = lower_standalone_source_tree(table, tree);
+    optimize_ir_module(&lowered.module, level, empty_str);
+    BcProgram program = compile_ir_module(&lowered.module);
+
+    VmResult result = run_bc_program(&program, find_bc_function(&program, test_entry_name), rt, nil, jit_threshold);
+
+    free_bc_program(&program);
+    free_slice_of_LowerErrors(lowered.errors);
+    free_ir_module(&lowered.module);
+    return result;
+}
+
+u32 find_test_entry(const StandaloneSourceTree *tree) {
+    for (u32 i = 0; i < tree->functions.len; i++) {
+        if (are_strs_equal(tree->functions.elem[i].declaration.name.token.literal, test_entry_name)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// run_test_program returns output of the program followed by runtime error
+str run_test_program(const TypeTable *table, const StandaloneSourceTree *tree, VmTestMode mode) {
+    OutputBuffer out = new_output_buffer(-1, test_output_buffer_cap);
+    VmRuntime rt     = init_vm_runtime(&out);
+
+    VmResult result;
+    switch (mode) {
+    case vtm_Bytecode:
+        result = run_test_bytecode(table, tree, ol_None, 0, &rt);
+        break;
+    case vtm_OptimizedBytecode:
+        result = run_test_bytecode(table, tree, ol_Full, 0, &rt);
+        break;
+    case vtm_Jit:
+        result = run_test_bytecode(table, tree, ol_None, test_jit_threshold, &rt);
+        break;
+    case vtm_OptimizedJit:
+        result = run_test_bytecode(table, tree, ol_Full, test_jit_threshold, &rt);
+        break;
+    default:
+        result = walk_standalone_source_tree(table, tree, find_test_entry(tree), &rt);
+        break;
+    }
+    if (!result.ok) {
+        write_str_to_output(&out, error_str);
+        write_str_to_output(&out, result.error);
+        free_str(result.error);
+    }
+
+    str got = new_str_from_bytes(out.bytes, out.len);
+    free_vm_runtime(&rt);
+    free_output_buffer(&out);
+    return got;
+}
+
+bool run_test_case(VmTestCase test_case) {
+    SourceText source = new_source_from_str(test_case.input);
+    if (test_case.path != nil) {
+        SourceReadResult read_result = read_source_from_file(test_case.path);
+        if (read_result.erc != srec_NotAnError) {
+            print_failed_test_case(test_case, vtm_Bytecode, read_error_str);
+            return true;
+        }
+        source = read_result.source;
+    }
+
+    StandaloneParseResult parse_result = parse_standalone_source_from_str(source.text);
+    ResolveResult resolve_result       = resolve_standalone_source_tree(nil, &parse_result.tree);
+    TypeTable table                    = new_type_table();
+    TypeCheckResult check_result       = check_standalone_source_tree(&table, &parse_result.tree);
+    FoldResult fold_result             = fold_standalone_source_tree(&table, &parse_result.tree);
+
+    bool failed = !parse_result.ok || resolve_result.errors.len != 0 || check_result.errors.len != 0 ||
+                  fold_result.errors.len != 0;
+    if (failed) {
+        print_failed_test_case(test_case, vtm_Bytecode, front_errors_str);
+    }
+    for (u32 i = 0; i < vtm_end && !failed; i++) {
+        str got = run_test_program(&table, &parse_result.tree, (VmTestMode)i);
+        if (!are_strs_equal(got, test_case.want)) {
+            print_failed_test_case(test_case, (VmTestMode)i, got);
+            failed = true;
+        }
+        free_str(got);
+    }
+
+    free_slice_of_ResolveErrors(resolve_result.errors);
+    free_slice_of_TypeErrors(check_result.errors);
+    free_slice_of_TypeErrors(fold_result.errors);
+    free_type_table(&table);
+    if (test_case.path != nil) {
+        free_source(source);
+    }
+    return failed;
+}
+
+int main() {
+    u32 failed_test_cases = 0;
+    for (u32 i = 0; i < number_of_test_cases; i++) {
+        bool failed = run_test_case(test_cases[i]);
+        if (failed) {
+            failed_test_cases++;
+        }
+    }
+    if (failed_test_cases > 0) {
+        println();
+        exit(1);
+    }
+    print_test_passed_message();
+    return 0;
+}
@@ -0,0 +1,604 @@
+#include <string.h>
+
+#include "const_eval.h"
+#include "fatal.h"
+#include "lower.h"
+#include "resolve.h"
+#include "type_check.h"
+#include "walk.h"
+
+typedef struct Walker Walker;
+typedef struct WalkStringSlot WalkStringSlot;
+
+// WalkStringSlot caches decoded string literal, slot with nil literal is free
+struct WalkStringSlot {
+    const String *literal;
+    const VmString *value;
+};
+
+struct Walker {
+    const TypeTable *table;
+    const StandaloneSourceTree *tree;
+    VmRuntime *rt;
+
+    // local variables of current call indexed by Symbol.index
+    VmValue *locals;
+
+    // receives values given by return statement of current call
+    VmValue *results;
+
+    // types of results of current function
+    TypeList result_types;
+
+    // number of parameters of current function, named results follow them
+    // in local numbering
+    u32 params;
+
+    bool named_results;
+
+    // set by return statement, statements are skipped until call ends
+    bool returned;
+
+    u32 depth;
+
+    // runtime error, nil if there is none. Statements are skipped until
+    // execution leaves the entry function
+    const char *error;
+    str error_function;
+
+    // name of function being executed
+    str function;
+
+    // open addressing table of decoded string literals
+    WalkStringSlot *strings;
+    u32 strings_len;
+
+    // always a power of two
+    u32 strings_cap;
+};
+
+const u32 walk_max_depth = 1 << 12;
+
+// initial capacity of string literal table
+const u32 min_walk_strings_cap = 64;
+
+void *alloc_walk_mem(u64 size) {
+    void *p = alloc_mem(at_Vm, size + 1);
+    if (p == nil) {
+        fatal(1, "not enough memory for tree walking interpreter");
+    }
+    return p;
+}
+
+void set_walk_error(Walker *w, const char *error) {
+    if (w->error == nil) {
+        w->error          = error;
+        w->error_function = w->function;
+    }
+}
+
+bool is_walk_stopped(Walker *w) {
+    return w->returned || w->error != nil;
+}
+
+VmValue get_walk_zero_value(TypeId type) {
+    VmValue v = {.u = 0};
+    if (type == ti_Str) {
+        v.s = &empty_vm_string;
+    }
+    return v;
+}
+
+u32 hash_walk_string(const String *literal, u32 cap) {
+    return (u32)(((u64)(uintptr_t)literal * 0x9E3779B97F4A7C15) >> 32) & (cap - 1);
+}
+
+void grow_walk_strings(Walker *w) {
+    u32 cap               = w->strings_cap == 0 ? min_walk_strings_cap : w->strings_cap * 2;
+    WalkStringSlot *slots = (WalkStringSlot *)alloc_walk_mem((u64)cap * sizeof(WalkStringSlot));
+    memset(slots, 0, (u64)cap * sizeof(WalkStringSlot));
+    for (u32 i = 0; i < w->strings_cap; i++) {
+        WalkStringSlot slot = w->strings[i];
+        if (slot.literal == nil) {
+            continue;
+        }
+        u32 j = hash_walk_string(slot.literal, cap);
+        while (slots[j].literal != nil) {
+            j = (j + 1) & (cap - 1);
+        }
+        slots[j] = slot;
+    }
+    free_mem(w->strings);
+    w->strings     = slots;
+    w->strings_cap = cap;
+}
+
+// walk_string decodes literal once, later evaluations take cached value
+VmValue walk_string(Walker *w, const String *literal) {
+    if ((w->strings_len + 1) * 2 > w->strings_cap) {
+        grow_walk_strings(w);
+    }
+    u32 i = hash_walk_string(literal, w->strings_cap);
+    while (w->strings[i].literal != nil && w->strings[i].literal != literal) {
+        i = (i + 1) & (w->strings_cap - 1);
+    }
+    if (w->strings[i].literal == nil) {
+        slice_of_bytes b         = decode_string_literal(literal->token.literal);
+        w->strings[i].literal    = literal;
+        w->strings[i].value      = new_vm_string(&w->rt->heap, borrow_str_from_bytes(b.elem, b.len));
+        w->strings_len++;
+        free_slice_of_bytes(b);
+    }
+    VmValue v = {.s = w->strings[i].value};
+    return v;
+}
+
+f64 round_walk_float(Type type, f64 v) {
+    if (type.size == 4) {
+        return (f64)(f32)v;
+    }
+    return v;
+}
+
+bool compare_walk_order(TokenType operator, i32 order) {
+    switch (operator) {
+    case tt_Equal:
+        return order == 0;
+    case tt_NotEqual:
+        return order != 0;
+    case tt_Less:
+        return order < 0;
+    case tt_LessOrEqual:
+        return order <= 0;
+    case tt_Greater:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+// get_walk_float_order compares floats without equality operators, NaN is
+// unordered and not equal to anything
+i32 get_walk_float_order(TokenType operator, f64 a, f64 b) {
+    if (a < b) {
+        return -1;
+    }
+    if (a > b) {
+        return 1;
+    }
+    if (a <= b && a >= b) {
+        return 0;
+    }
+    // only != holds for unordered values
+    return operator == tt_NotEqual ? 1 : 2;
+}
+
+i32 get_walk_integer_order(Type type, VmValue a, VmValue b) {
+    if (type.kind == tk_Signed) {
+        return a.i < b.i ? -1 : (a.i > b.i ? 1 : 0);
+    }
+    return a.u < b.u ? -1 : (a.u > b.u ? 1 : 0);
+}
+
+bool is_walk_comparison(TokenType operator) {
+    switch (operator) {
+    case tt_Equal:
+    case tt_NotEqual:
+    case tt_Less:
+    case tt_LessOrEqual:
+    case tt_Greater:
+    case tt_GreaterOrEqual:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// walk_binary_values applies operator to operands of given type
+VmValue walk_binary_values(Walker *w, TokenType operator, TypeId type_id, VmValue a, VmValue b) {
+    Type type = get_type(w->table, type_id);
+    VmValue v = {.u = 0};
+    if (is_walk_comparison(operator)) {
+        i32 order;
+        switch (type.kind) {
+        case tk_Str:
+            order = compare_vm_strings(a.s, b.s);
+            break;
+        case tk_Float:
+            order = get_walk_float_order(operator, a.f, b.f);
+            if (order == 2) {
+                return v;
+            }
+            break;
+        case tk_Bool:
+            order = a.u == b.u ? 0 : 1;
+            break;
+        default:
+            order = get_walk_integer_order(type, a, b);
+            break;
+        }
+        v.u = compare_walk_order(operator, order) ? 1 : 0;
+        return v;
+    }
+
+    if (type.kind == tk_Str) {
+        v.s = concat_vm_strings(w->rt, a.s, b.s);
+        return v;
+    }
+    if (type.kind == tk_Float) {
+        switch (operator) {
+        case tt_Plus:
+            v.f = a.f + b.f;
+            break;
+        case tt_Minus:
+            v.f = a.f - b.f;
+            break;
+        case tt_Asterisk:
+            v.f = a.f * b.f;
+            break;
+        default:
+            v.f = a.f / b.f;
+            break;
+        }
+        v.f = round_walk_float(type, v.f);
+        return v;
+    }
+    if ((operator == tt_Slash || operator == tt_Percent) && b.u == 0) {
+        set_walk_error(w, "division by zero");
+        return v;
+    }
+    v.u = fold_typed_integer(type, operator, a.u, b.u).value.integer;
+    return v;
+}
+
+VmValue walk_expression(Walker *w, Expression expr);
+
+VmValue walk_unary(Walker *w, Expression expr) {
+    UnaryExpression *unary = (UnaryExpression *)expr.ptr;
+    VmValue v              = walk_expression(w, unary->operand);
+    Type type              = get_type(w->table, get_default_type(expr.type_id));
+    switch (unary->operator.type) {
+    case tt_Minus:
+        if (type.kind == tk_Float) {
+            v.f = -v.f;
+        } else {
+            v.u = wrap_integer(type, 0 - v.u);
+        }
+        break;
+    case tt_Not:
+        v.u ^= 1;
+        break;
+    case tt_Caret:
+        v.u = wrap_integer(type, ~v.u);
+        break;
+    default:
+        break;
+    }
+    return v;
+}
+
+VmValue walk_binary(Walker *w, BinaryExpression *binary) {
+    TokenType operator = binary->operator.type;
+    VmValue left       = walk_expression(w, binary->left);
+    if (operator == tt_LogicalAnd) {
+        return left.u == 0 ? left : walk_expression(w, binary->right);
+    }
+    if (operator == tt_LogicalOr) {
+        return left.u != 0 ? left : walk_expression(w, binary->right);
+    }
+    VmValue right = walk_expression(w, binary->right);
+    return walk_binary_values(w, operator, get_default_type(binary->left.type_id), left, right);
+}
+
+void walk_statements(Walker *w, slice_of_Statements stmts);
+
+// set_walk_bare_results gives current values of named results or zero values
+// when results are not named
+void set_walk_bare_results(Walker *w) {
+    for (u32 i = 0; i < w->result_types.len; i++) {
+        TypeId type   = w->result_types.elem[i];
+        w->results[i] = w->named_results ? w->locals[w->params + i] : get_walk_zero_value(type);
+    }
+}
+
+// call_walk_function runs function body with fresh locals, results are
+// written to given array
+void call_walk_function(Walker *w, const FunctionDefinition *def, const VmValue *args, VmValue *results) {
+    if (w->depth == walk_max_depth) {
+        set_walk_error(w, "stack overflow");
+        return;
+    }
+    Type type        = get_type(w->table, def->declaration.name.symbol->type);
+    TypeList params  = get_tuple_members(w->table, &type.key);
+    TypeList members = get_tuple_members(w->table, &type.elem);
+
+    Walker saved = *w;
+    w->locals    = (VmValue *)alloc_walk_mem(((u64)def->locals + params.len) * sizeof(VmValue));
+    w->results       = results;
+    w->result_types  = members;
+    w->params        = params.len;
+    w->named_results = def->declaration.result.type == frt_TypedTuple;
+    w->returned      = false;
+    w->function      = def->declaration.name.token.literal;
+    w->depth++;
+
+    memcpy(w->locals, args, params.len * sizeof(VmValue));
+    if (w->named_results) {
+        for (u32 i = 0; i < members.len; i++) {
+            w->locals[params.len + i] = get_walk_zero_value(members.elem[i]);
+        }
+    }
+    walk_statements(w, def->body.statements);
+    if (!w->returned) {
+        set_walk_bare_results(w);
+    }
+
+    free_mem(w->locals);
+    w->locals        = saved.locals;
+    w->results       = saved.results;
+    w->result_types  = saved.result_types;
+    w->params        = saved.params;
+    w->named_results = saved.named_results;
+    w->returned      = saved.returned;
+    w->function      = saved.function;
+    w->depth         = saved.depth;
+}
+
+// walk_builtin_call passes values and kinds of arguments to builtin, members
+// of tuple arguments are passed separately
+void walk_builtin_call(Walker *w, CallExpression *call) {
+    u32 len = 0;
+    for (u32 i = 0; i < call->args.len; i++) {
+        len += get_tuple_members(w->table, &call->args.elem[i].type_id).len;
+    }
+    VmValue *values = (VmValue *)alloc_walk_mem((u64)len * sizeof(VmValue));
+    VmKind *kinds   = (VmKind *)alloc_walk_mem((u64)len * sizeof(VmKind));
+    u32 n           = 0;
+    for (u32 i = 0; i < call->args.len; i++) {
+        Expression arg   = call->args.elem[i];
+        TypeList members = get_tuple_members(w->table, &arg.type_id);
+        if (members.len > 1) {
+            CallExpression *inner = (CallExpression *)arg.ptr;
+            VmValue *args         = (VmValue *)alloc_walk_mem((u64)inner->args.len * sizeof(VmValue));
+            for (u32 j = 0; j < inner->args.len; j++) {
+                args[j] = walk_expression(w, inner->args.elem[j]);
+            }
+            call_walk_function(w, inner->name.symbol->function, args, values + n);
+            free_mem(args);
+        } else {
+            values[n] = walk_expression(w, arg);
+        }
+        for (u32 j = 0; j < members.len; j++) {
+            kinds[n] = get_vm_kind(w->table, members.elem[j]);
+            n++;
+        }
+    }
+    if (w->error == nil) {
+        print_vm_values(w->rt, call->name.symbol->index, values, kinds, len);
+    }
+    free_mem(values);
+    free_mem(kinds);
+}
+
+// walk_call evaluates arguments from left to right and calls function,
+// results must have room for all results of the function
+void walk_call(Walker *w, CallExpression *call, VmValue *results) {
+    Symbol *symbol = call->name.symbol;
+    if (symbol->kind == sk_Builtin) {
+        walk_builtin_call(w, call);
+        return;
+    }
+    VmValue *args = (VmValue *)alloc_walk_mem((u64)call->args.len * sizeof(VmValue));
+    for (u32 i = 0; i < call->args.len; i++) {
+        args[i] = walk_expression(w, call->args.elem[i]);
+    }
+    if (w->error == nil) {
+        call_walk_function(w, symbol->function, args, results);
+    }
+    free_mem(args);
+}
+
+VmValue walk_expression(Walker *w, Expression expr) {
+    VmValue v = {.u = 0};
+    if (expr.constant.kind == ck_Float) {
+        v.f = expr.constant.value.real;
+        return v;
+    }
+    if (expr.constant.kind != ck_None) {
+        v.u = expr.constant.value.integer;
+        return v;
+    }
+    switch (expr.type) {
+    case et_Identifier: {
+        Symbol *symbol = ((Identifier *)expr.ptr)->symbol;
+        if (symbol->kind == sk_Function || symbol->kind == sk_Builtin) {
+            return v;
+        }
+        return w->locals[symbol->index];
+    }
+    case et_Call:
+        walk_call(w, (CallExpression *)expr.ptr, &v);
+        return v;
+    case et_StringLiteral:
+        return walk_string(w, (String *)expr.ptr);
+    case et_Unary:
+        return walk_unary(w, expr);
+    case et_Binary:
+        return walk_binary(w, (BinaryExpression *)expr.ptr);
+    default:
+        return v;
+    }
+}
+
+// walk_values evaluates expressions into array of want values, single call
+// with several results gives all of them
+void walk_values(Walker *w, slice_of_Expressions exprs, u32 want, VmValue *values) {
+    if (exprs.len == 1 && want > 1) {
+        walk_call(w, (CallExpression *)exprs.elem[0].ptr, values);
+        return;
+    }
+    for (u32 i = 0; i < exprs.len; i++) {
+        values[i] = walk_expression(w, exprs.elem[i]);
+    }
+}
+
+void set_walk_local(Walker *w, Expression expr, VmValue v) {
+    Symbol *symbol = ((Identifier *)expr.ptr)->symbol;
+    if (symbol != nil) {
+        w->locals[symbol->index] = v;
+    }
+}
+
+// All values are evaluated before any variable changes, so that "a, b = b, a"
+// swaps values
+void walk_assignment(Walker *w, slice_of_Expressions left, slice_of_Expressions right) {
+    VmValue *values = (VmValue *)alloc_walk_mem((u64)left.len * sizeof(VmValue));
+    walk_values(w, right, left.len, values);
+    for (u32 i = 0; i < left.len; i++) {
+        set_walk_local(w, left.elem[i], values[i]);
+    }
+    free_mem(values);
+}
+
+void walk_assign_statement(Walker *w, AssignStatement *astmt) {
+    TokenType operation = get_assign_operation(astmt->operator.type);
+    if (operation == tt_Empty) {
+        walk_assignment(w, astmt->left, astmt->right);
+        return;
+    }
+    Expression left = astmt->left.elem[0];
+    VmValue current = walk_expression(w, left);
+    VmValue right   = walk_expression(w, astmt->right.elem[0]);
+    set_walk_local(w, left, walk_binary_values(w, operation, left.type_id, current, right));
+}
+
+void walk_return_statement(Walker *w, ReturnStatement *rstmt) {
+    w->returned = true;
+    if (rstmt->values.len == 0) {
+        set_walk_bare_results(w);
+        return;
+    }
+    u32 want = rstmt->values.len;
+    if (want == 1) {
+        want = get_tuple_members(w->table, &rstmt->values.elem[0].type_id).len;
+    }
+    walk_values(w, rstmt->values, want, w->results);
+}
+
+// walk_loop_statement repeats body while remaining count is positive
+void walk_loop_statement(Walker *w, LoopStatement *lstmt) {
+    if (lstmt->count.ptr == nil) {
+        while (!is_walk_stopped(w)) {
+            walk_statements(w, lstmt->body.statements);
+        }
+        return;
+    }
+    Type type         = get_type(w->table, get_default_type(lstmt->count.type_id));
+    VmValue remaining = walk_expression(w, lstmt->count);
+    while (!is_walk_stopped(w) && (type.kind == tk_Signed ? remaining.i > 0 : remaining.u > 0)) {
+        remaining.u--;
+        walk_statements(w, lstmt->body.statements);
+    }
+}
+
+void walk_statement(Walker *w, Statement stmt) {
+    switch (stmt.type) {
+    case st_Define: {
+        DefineStatement *dstmt = (DefineStatement *)stmt.ptr;
+        walk_assignment(w, dstmt->left, dstmt->right);
+        break;
+    }
+    case st_Assign:
+        walk_assign_statement(w, (AssignStatement *)stmt.ptr);
+        break;
+    case st_Expression: {
+        Expression expr = *(Expression *)stmt.ptr;
+        if (expr.type == et_Call) {
+            VmValue *results = (VmValue *)alloc_walk_mem(
+                (u64)get_tuple_members(w->table, &expr.type_id).len * sizeof(VmValue));
+            walk_call(w, (CallExpression *)expr.ptr, results);
+            free_mem(results);
+        } else {
+            walk_expression(w, expr);
+        }
+        break;
+    }
+    case st_Return:
+        walk_return_statement(w, (ReturnStatement *)stmt.ptr);
+        break;
+    case st_If: {
+        IfStatement *istmt = (IfStatement *)stmt.ptr;
+        for (u32 i = 0; i < istmt->clauses.len; i++) {
+            IfClause clause = istmt->clauses.elem[i];
+            if (walk_expression(w, clause.condition).u != 0) {
+                walk_statements(w, clause.body.statements);
+                return;
+            }
+        }
+        if (istmt->else_body != nil) {
+            walk_statements(w, istmt->else_body->statements);
+        }
+        break;
+    }
+    case st_Loop:
+        walk_loop_statement(w, (LoopStatement *)stmt.ptr);
+        break;
+    case st_While: {
+        WhileStatement *wstmt = (WhileStatement *)stmt.ptr;
+        while (!is_walk_stopped(w) && walk_expression(w, wstmt->condition).u != 0) {
+            walk_statements(w, wstmt->body.statements);
+        }
+        break;
+    }
+    case st_Block:
+        walk_statements(w, ((BlockStatement *)stmt.ptr)->statements);
+        break;
+    default:
+        break;
+    }
+}
+
+void walk_statements(Walker *w, slice_of_Statements stmts) {
+    for (u32 i = 0; i < stmts.len && !is_walk_stopped(w); i++) {
+        walk_statement(w, stmts.elem[i]);
+    }
+}
+
+VmResult walk_standalone_source_tree(
+    const TypeTable *table, const StandaloneSourceTree *tree, u32 entry, VmRuntime *rt) {
+    Walker w = {
+        .table          = table,
+        .tree           = tree,
+        .rt             = rt,
+        .locals         = nil,
+        .results        = nil,
+        .result_types   = {.elem = nil, .len = 0},
+        .params         = 0,
+        .named_results  = false,
+        .returned       = false,
+        .depth          = 0,
+        .error          = nil,
+        .error_function = empty_str,
+        .function       = empty_str,
+        .strings        = nil,
+        .strings_len    = 0,
+        .strings_cap    = 0,
+    };
+
+    const FunctionDefinition *def = &tree->functions.elem[entry];
+    Type type                     = get_type(table, def->declaration.name.symbol->type);
+    u32 results                   = get_tuple_members(table, &type.elem).len;
+    VmValue *values               = (VmValue *)alloc_walk_mem((u64)results * sizeof(VmValue));
+    call_walk_function(&w, def, nil, values);
+    free_mem(values);
+    free_mem(w.strings);
+
+    if (w.error != nil) {
+        return new_vm_error(w.error, w.error_function);
+    }
+    VmResult result = {
+        .ok    = true,
+        .error = empty_str,
+    };
+    return result;
+}
@@ -0,0 +1,22 @@
+#ifndef KU_WALK_H
+#define KU_WALK_H
+
+#include "ast.h"
+#include "runtime.h"
+#include "type_table.h"
+#include "types.h"
+
+// maximal depth of calls, each call of program takes several C stack frames
+extern const u32 walk_max_depth;
+
+// walk_standalone_source_tree calls function with given index in the tree by
+// evaluating its syntax tree directly. Tree must pass type checking and
+// constant folding without errors, entry function must not have parameters.
+//
+// This is a naive interpreter kept as baseline for benchmarks of bytecode
+// interpreter: every expression is dispatched by its node type, every call
+// allocates its local variables and results are given by value
+VmResult walk_standalone_source_tree(
+    const TypeTable *table, const StandaloneSourceTree *tree, u32 entry, VmRuntime *rt);
+
+#endif // KU_WALK_H
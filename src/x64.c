@@ -0,0 +1,1706 @@
+#include <string.h>
+
+#include "alloc.h"
+#include "native_rt.h"
+#include "regalloc.h"
+#include "runtime.h"
+#include "x64.h"
+
+typedef enum X64Register X64Register;
+typedef enum X64LocationKind X64LocationKind;
+typedef enum X64Condition X64Condition;
+typedef enum X64LabelKind X64LabelKind;
+typedef struct X64Location X64Location;
+typedef struct X64Label X64Label;
+typedef struct X64Move X64Move;
+typedef struct X64Emitter X64Emitter;
+
+// Registers rax, rcx, rdx, r11 and xmm15 are never allocated to values,
+// division, shifts, moves and calls of runtime use them as scratch
+enum X64Register {
+    xr_Rax,
+    xr_Rcx,
+    xr_Rdx,
+    xr_Rbx,
+    xr_Rsp,
+    xr_Rbp,
+    xr_Rsi,
+    xr_Rdi,
+    xr_R8,
+    xr_R9,
+    xr_R10,
+    xr_R11,
+    xr_R12,
+    xr_R13,
+    xr_R14,
+    xr_R15,
+    xr_Xmm0,
+    xr_Xmm1,
+    xr_Xmm2,
+    xr_Xmm3,
+    xr_Xmm4,
+    xr_Xmm5,
+    xr_Xmm6,
+    xr_Xmm7,
+    xr_Xmm8,
+    xr_Xmm9,
+    xr_Xmm10,
+    xr_Xmm11,
+    xr_Xmm12,
+    xr_Xmm13,
+    xr_Xmm14,
+    xr_Xmm15,
+
+    xr_end,
+};
+
+enum X64LocationKind {
+    xl_Register,
+    xl_Memory,
+    xl_Immediate,
+};
+
+// X64Condition is condition code of jump or set instruction, conditions
+// below/above compare unsigned integers and floats
+enum X64Condition {
+    xc_E,
+    xc_Ne,
+    xc_L,
+    xc_Le,
+    xc_G,
+    xc_Ge,
+    xc_B,
+    xc_Be,
+    xc_A,
+    xc_Ae,
+
+    // unconditional jump
+    xc_Always,
+};
+
+enum X64LabelKind {
+    xlk_Block,
+
+    // label inside of instruction sequence, numbered within function
+    xlk_Local,
+
+    // code which reports runtime error
+    xlk_StackOverflow,
+    xlk_DivisionByZero,
+
+    // name of function as C string
+    xlk_Name,
+};
+
+struct X64Location {
+    X64LocationKind kind;
+
+    // register or base register of memory
+    X64Register reg;
+
+    // size of register operand in bytes
+    u32 size;
+
+    // offset of memory operand or value of immediate
+    i64 value;
+};
+
+struct X64Label {
+    X64LabelKind kind;
+    u32 index;
+};
+
+// X64Move copies value of given class, moves of a single group happen as if
+// all of them read their sources at once
+struct X64Move {
+    RaClass class;
+    X64Location dst;
+    X64Location src;
+};
+
+// X64Emitter keeps state of write_x64_module call, fields below fn describe
+// the function being written
+struct X64Emitter {
+    OutputBuffer *out;
+    const IrModule *m;
+
+    // number of string literals written so far, their labels are unique in
+    // module
+    u32 strings;
+
+    const IrFunction *fn;
+    u32 fn_index;
+
+    // index of instruction which defines each value, IR_NONE for block
+    // parameters
+    u32 *defs;
+
+    // number of operands referring to each value
+    u32 *uses;
+
+    // constants whose every use takes them as immediate operand, they are
+    // not loaded into registers
+    bool *immediate_only;
+
+    RaClass *classes;
+
+    // instructions which call other functions
+    bool *calls;
+
+    RaAllocation alloc;
+
+    // callee saved registers pushed in prologue
+    X64Register saved[8];
+    u32 saved_len;
+
+    // Frame words below saved registers hold spill slots, address of tuple
+    // results, tuples returned by calls and arguments of print builtins.
+    // Arguments passed on stack to callees are placed at the bottom of frame
+    u32 ret_word;
+    u32 *tuple_words;
+    u32 builtin_word;
+
+    // bytes subtracted from stack pointer after saving registers
+    u32 frame_size;
+
+    // number of local labels used by function
+    u32 labels;
+
+    bool divides;
+};
+
+const char *const x64_register_names[] = {
+    [xr_Rax]   = "rax",
+    [xr_Rcx]   = "rcx",
+    [xr_Rdx]   = "rdx",
+    [xr_Rbx]   = "rbx",
+    [xr_Rsp]   = "rsp",
+    [xr_Rbp]   = "rbp",
+    [xr_Rsi]   = "rsi",
+    [xr_Rdi]   = "rdi",
+    [xr_R8]    = "r8",
+    [xr_R9]    = "r9",
+    [xr_R10]   = "r10",
+    [xr_R11]   = "r11",
+    [xr_R12]   = "r12",
+    [xr_R13]   = "r13",
+    [xr_R14]   = "r14",
+    [xr_R15]   = "r15",
+    [xr_Xmm0]  = "xmm0",
+    [xr_Xmm1]  = "xmm1",
+    [xr_Xmm2]  = "xmm2",
+    [xr_Xmm3]  = "xmm3",
+    [xr_Xmm4]  = "xmm4",
+    [xr_Xmm5]  = "xmm5",
+    [xr_Xmm6]  = "xmm6",
+    [xr_Xmm7]  = "xmm7",
+    [xr_Xmm8]  = "xmm8",
+    [xr_Xmm9]  = "xmm9",
+    [xr_Xmm10] = "xmm10",
+    [xr_Xmm11] = "xmm11",
+    [xr_Xmm12] = "xmm12",
+    [xr_Xmm13] = "xmm13",
+    [xr_Xmm14] = "xmm14",
+    [xr_Xmm15] = "xmm15",
+};
+
+const char *const x64_register_names32[] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+
+const char *const x64_register_names16[] = {
+    "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
+};
+
+const char *const x64_register_names8[] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+
+const char *const x64_jump_names[] = {
+    [xc_E]      = "je",
+    [xc_Ne]     = "jne",
+    [xc_L]      = "jl",
+    [xc_Le]     = "jle",
+    [xc_G]      = "jg",
+    [xc_Ge]     = "jge",
+    [xc_B]      = "jb",
+    [xc_Be]     = "jbe",
+    [xc_A]      = "ja",
+    [xc_Ae]     = "jae",
+    [xc_Always] = "jmp",
+};
+
+const char *const x64_set_names[] = {
+    [xc_E]  = "sete",
+    [xc_Ne] = "setne",
+    [xc_L]  = "setl",
+    [xc_Le] = "setle",
+    [xc_G]  = "setg",
+    [xc_Ge] = "setge",
+    [xc_B]  = "setb",
+    [xc_Be] = "setbe",
+    [xc_A]  = "seta",
+    [xc_Ae] = "setae",
+};
+
+// condition which holds when the given one does not
+const X64Condition x64_negated_conditions[] = {
+    [xc_E]  = xc_Ne,
+    [xc_Ne] = xc_E,
+    [xc_L]  = xc_Ge,
+    [xc_Le] = xc_G,
+    [xc_G]  = xc_Le,
+    [xc_Ge] = xc_L,
+    [xc_B]  = xc_Ae,
+    [xc_Be] = xc_A,
+    [xc_A]  = xc_Be,
+    [xc_Ae] = xc_B,
+};
+
+// condition which holds after operands of comparison are swapped
+const X64Condition x64_mirrored_conditions[] = {
+    [xc_E]  = xc_E,
+    [xc_Ne] = xc_Ne,
+    [xc_L]  = xc_G,
+    [xc_Le] = xc_Ge,
+    [xc_G]  = xc_L,
+    [xc_Ge] = xc_Le,
+    [xc_B]  = xc_A,
+    [xc_Be] = xc_Ae,
+    [xc_A]  = xc_B,
+    [xc_Ae] = xc_Be,
+};
+
+const X64Register x64_int_arg_registers[] = {xr_Rdi, xr_Rsi, xr_Rdx, xr_Rcx, xr_R8, xr_R9};
+const u32 x64_int_arg_registers_len       = 6;
+const u32 x64_float_arg_registers_len     = 8;
+
+const u32 x64_int_caller_saved[]   = {xr_Rsi, xr_Rdi, xr_R8, xr_R9, xr_R10};
+const u32 x64_int_callee_saved[]   = {xr_Rbx, xr_R12, xr_R13, xr_R14, xr_R15};
+const u32 x64_float_caller_saved[] = {
+    xr_Xmm0,
+    xr_Xmm1,
+    xr_Xmm2,
+    xr_Xmm3,
+    xr_Xmm4,
+    xr_Xmm5,
+    xr_Xmm6,
+    xr_Xmm7,
+    xr_Xmm8,
+    xr_Xmm9,
+    xr_Xmm10,
+    xr_Xmm11,
+    xr_Xmm12,
+    xr_Xmm13,
+    xr_Xmm14,
+};
+
+// System V convention has no callee saved xmm registers, floats live across
+// calls are kept in stack slots
+const RaRegisters x64_registers[] = {
+    [rc_None] = {.caller_saved = nil, .caller_saved_len = 0, .callee_saved = nil, .callee_saved_len = 0},
+    [rc_Int] =
+        {
+            .caller_saved     = x64_int_caller_saved,
+            .caller_saved_len = 5,
+            .callee_saved     = x64_int_callee_saved,
+            .callee_saved_len = 5,
+        },
+    [rc_Float] =
+        {
+            .caller_saved     = x64_float_caller_saved,
+            .caller_saved_len = 15,
+            .callee_saved     = nil,
+            .callee_saved_len = 0,
+        },
+};
+
+const char *const x64_symbol_prefix = "ku.";
+const char *const x64_label_prefix  = ".Lku";
+const char *const x64_entry_symbol  = "ku_entry";
+
+void write_x64_cstr(X64Emitter *e, const char *s) {
+    write_bytes_to_output(e->out, (const byte *)s, strlen(s));
+}
+
+void write_x64_i64(X64Emitter *e, i64 n) {
+    if (n < 0) {
+        write_byte_to_output(e->out, '-');
+        write_u64_to_output(e->out, 0 - (u64)n);
+        return;
+    }
+    write_u64_to_output(e->out, (u64)n);
+}
+
+X64Location x64_reg(X64Register reg) {
+    X64Location l = {
+        .kind  = xl_Register,
+        .reg   = reg,
+        .size  = 8,
+        .value = 0,
+    };
+    return l;
+}
+
+X64Location x64_sized(X64Register reg, u32 size) {
+    X64Location l = x64_reg(reg);
+    l.size        = size;
+    return l;
+}
+
+X64Location x64_mem(X64Register base, i64 offset) {
+    X64Location l = {
+        .kind  = xl_Memory,
+        .reg   = base,
+        .size  = 8,
+        .value = offset,
+    };
+    return l;
+}
+
+X64Location x64_imm(i64 value) {
+    X64Location l = {
+        .kind  = xl_Immediate,
+        .reg   = xr_end,
+        .size  = 8,
+        .value = value,
+    };
+    return l;
+}
+
+bool are_x64_locations_equal(X64Location a, X64Location b) {
+    return a.kind == b.kind && a.reg == b.reg && a.value == b.value;
+}
+
+X64Label x64_label(X64LabelKind kind, u32 index) {
+    X64Label l = {
+        .kind  = kind,
+        .index = index,
+    };
+    return l;
+}
+
+void write_x64_register(X64Emitter *e, X64Register reg, u32 size) {
+    write_byte_to_output(e->out, '%');
+    if (reg >= xr_Xmm0 || size == 8) {
+        write_x64_cstr(e, x64_register_names[reg]);
+    } else if (size == 4) {
+        write_x64_cstr(e, x64_register_names32[reg]);
+    } else if (size == 2) {
+        write_x64_cstr(e, x64_register_names16[reg]);
+    } else {
+        write_x64_cstr(e, x64_register_names8[reg]);
+    }
+}
+
+void write_x64_location(X64Emitter *e, X64Location l) {
+    switch (l.kind) {
+    case xl_Register:
+        write_x64_register(e, l.reg, l.size);
+        break;
+    case xl_Memory:
+        if (l.value != 0) {
+            write_x64_i64(e, l.value);
+        }
+        write_byte_to_output(e->out, '(');
+        write_x64_register(e, l.reg, 8);
+        write_byte_to_output(e->out, ')');
+        break;
+    case xl_Immediate:
+        write_byte_to_output(e->out, '$');
+        write_x64_i64(e, l.value);
+        break;
+    }
+}
+
+void write_x64_label(X64Emitter *e, X64Label l) {
+    write_x64_cstr(e, x64_label_prefix);
+    write_u64_to_output(e->out, e->fn_index);
+    switch (l.kind) {
+    case xlk_Block:
+        write_x64_cstr(e, "_b");
+        write_u64_to_output(e->out, l.index);
+        break;
+    case xlk_Local:
+        write_x64_cstr(e, "_l");
+        write_u64_to_output(e->out, l.index);
+        break;
+    case xlk_StackOverflow:
+        write_x64_cstr(e, "_stack_overflow");
+        break;
+    case xlk_DivisionByZero:
+        write_x64_cstr(e, "_division_by_zero");
+        break;
+    case xlk_Name:
+        write_x64_cstr(e, "_name");
+        break;
+    }
+}
+
+void write_x64_symbol(X64Emitter *e, u32 fn) {
+    write_x64_cstr(e, x64_symbol_prefix);
+    write_str_to_output(e->out, e->m->functions[fn].name);
+}
+
+void place_x64_label(X64Emitter *e, X64Label l) {
+    write_x64_label(e, l);
+    write_x64_cstr(e, ":\n");
+}
+
+X64Label new_x64_local_label(X64Emitter *e) {
+    e->labels++;
+    return x64_label(xlk_Local, e->labels - 1);
+}
+
+void begin_x64_instruction(X64Emitter *e, const char *mnemonic) {
+    write_x64_cstr(e, "    ");
+    write_x64_cstr(e, mnemonic);
+}
+
+// emit_x64 writes instruction with operands in AT&T order, source first
+void emit_x64(X64Emitter *e, const char *mnemonic, u32 len, const X64Location *operands) {
+    begin_x64_instruction(e, mnemonic);
+    for (u32 i = 0; i < len; i++) {
+        write_x64_cstr(e, i == 0 ? " " : ", ");
+        write_x64_location(e, operands[i]);
+    }
+    write_byte_to_output(e->out, '\n');
+}
+
+void emit_x64_unary(X64Emitter *e, const char *mnemonic, X64Location a) {
+    emit_x64(e, mnemonic, 1, &a);
+}
+
+void emit_x64_binary(X64Emitter *e, const char *mnemonic, X64Location src, X64Location dst) {
+    X64Location operands[] = {src, dst};
+    emit_x64(e, mnemonic, 2, operands);
+}
+
+void emit_x64_jump(X64Emitter *e, X64Condition c, X64Label target) {
+    begin_x64_instruction(e, x64_jump_names[c]);
+    write_byte_to_output(e->out, ' ');
+    write_x64_label(e, target);
+    write_byte_to_output(e->out, '\n');
+}
+
+// emit_x64_address loads address of label or symbol relative to instruction
+// pointer, label is written when symbol is nil
+void emit_x64_address(X64Emitter *e, const char *symbol, X64Label label, X64Register dst) {
+    begin_x64_instruction(e, "leaq ");
+    if (symbol != nil) {
+        write_x64_cstr(e, symbol);
+    } else {
+        write_x64_label(e, label);
+    }
+    write_x64_cstr(e, "(%rip), ");
+    write_x64_register(e, dst, 8);
+    write_byte_to_output(e->out, '\n');
+}
+
+void emit_x64_call_symbol(X64Emitter *e, const char *symbol) {
+    begin_x64_instruction(e, "call ");
+    write_x64_cstr(e, symbol);
+    write_byte_to_output(e->out, '\n');
+}
+
+RaClass get_x64_class(const TypeTable *t, TypeId id) {
+    switch (get_type(t, id).kind) {
+    case tk_Float:
+        return rc_Float;
+    case tk_Void:
+    case tk_Tuple:
+        return rc_None;
+    default:
+        return rc_Int;
+    }
+}
+
+bool is_x64_tuple(const X64Emitter *e, TypeId id) {
+    return get_type(e->m->table, id).kind == tk_Tuple;
+}
+
+VmKind get_x64_value_kind(const X64Emitter *e, ValueId v) {
+    return get_vm_kind(e->m->table, e->fn->values[v]);
+}
+
+// get_x64_word_offset returns offset from frame pointer of the lowest of
+// given number of frame words starting at word index
+i64 get_x64_word_offset(const X64Emitter *e, u32 word, u32 len) {
+    return -8 * (i64)(e->saved_len + word + len);
+}
+
+// get_x64_value returns register or stack slot of value
+X64Location get_x64_value(const X64Emitter *e, ValueId v) {
+    u32 reg = e->alloc.regs[v];
+    if (reg == RA_SPILLED) {
+        return x64_mem(xr_Rbp, get_x64_word_offset(e, e->alloc.slots[v], 1));
+    }
+    return x64_reg((X64Register)reg);
+}
+
+// get_x64_immediate tells whether value is integer, bool or str constant
+// which fits into sign-extended 32-bit immediate operand
+bool get_x64_immediate(const X64Emitter *e, ValueId v, i64 *imm) {
+    u32 def = e->defs[v];
+    if (def == IR_NONE) {
+        return false;
+    }
+    const IrInstruction *inst = &e->fn->instructions[def];
+    VmKind kind               = get_vm_kind(e->m->table, inst->type);
+    if (inst->op != op_Const || (kind != vk_Signed && kind != vk_Unsigned && kind != vk_Bool)) {
+        return false;
+    }
+    i64 x = (i64)inst->imm;
+    if (x < INT32_MIN || x > INT32_MAX) {
+        return false;
+    }
+    *imm = x;
+    return true;
+}
+
+// get_x64_immediate_operand returns index of operand which may be encoded as
+// immediate, IR_NONE if there is none. Only the right operand of operations
+// which are not commutative may be immediate, left immediate operand of
+// comparison is handled by swapping operands
+u32 get_x64_immediate_operand(const X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    bool commutative = false;
+    switch (inst->op) {
+    case op_Add:
+    case op_Mul:
+    case op_And:
+    case op_Or:
+    case op_Xor:
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        commutative = true;
+        break;
+    case op_Sub:
+    case op_AndNot:
+    case op_Shl:
+    case op_Shr:
+        break;
+    default:
+        return IR_NONE;
+    }
+    VmKind kind = get_x64_value_kind(e, ops[0]);
+    if (kind != vk_Signed && kind != vk_Unsigned && kind != vk_Bool) {
+        return IR_NONE;
+    }
+    i64 imm;
+    if (get_x64_immediate(e, ops[1], &imm)) {
+        return 1;
+    }
+    if (commutative && get_x64_immediate(e, ops[0], &imm)) {
+        return 0;
+    }
+    return IR_NONE;
+}
+
+// get_x64_operand returns immediate for constants which are not loaded into
+// registers, location of value otherwise
+X64Location get_x64_operand(const X64Emitter *e, ValueId v) {
+    i64 imm;
+    if (e->immediate_only[v] && get_x64_immediate(e, v, &imm)) {
+        return x64_imm(imm);
+    }
+    return get_x64_value(e, v);
+}
+
+void emit_x64_int_move(X64Emitter *e, X64Location dst, X64Location src) {
+    if (are_x64_locations_equal(dst, src)) {
+        return;
+    }
+    if (src.kind == xl_Immediate && src.value == 0 && dst.kind == xl_Register) {
+        emit_x64_binary(e, "xorl", x64_sized(dst.reg, 4), x64_sized(dst.reg, 4));
+        return;
+    }
+    if (src.kind == xl_Memory && dst.kind == xl_Memory) {
+        emit_x64_binary(e, "movq", src, x64_reg(xr_R11));
+        src = x64_reg(xr_R11);
+    }
+    emit_x64_binary(e, "movq", src, dst);
+}
+
+void emit_x64_float_move(X64Emitter *e, X64Location dst, X64Location src) {
+    if (are_x64_locations_equal(dst, src)) {
+        return;
+    }
+    if (src.kind == xl_Memory && dst.kind == xl_Memory) {
+        emit_x64_binary(e, "movq", src, x64_reg(xr_R11));
+        emit_x64_binary(e, "movq", x64_reg(xr_R11), dst);
+        return;
+    }
+    if (src.kind == xl_Register && dst.kind == xl_Register) {
+        emit_x64_binary(e, "movaps", src, dst);
+        return;
+    }
+    emit_x64_binary(e, "movsd", src, dst);
+}
+
+void emit_x64_move(X64Emitter *e, RaClass class, X64Location dst, X64Location src) {
+    if (class == rc_Float) {
+        emit_x64_float_move(e, dst, src);
+    } else {
+        emit_x64_int_move(e, dst, src);
+    }
+}
+
+// emit_x64_parallel_moves emits move only after no other pending move reads
+// its destination, cycles are broken with rax or xmm15. Moves are reordered
+// in place
+void emit_x64_parallel_moves(X64Emitter *e, X64Move *moves, u32 len) {
+    u32 n = 0;
+    for (u32 i = 0; i < len; i++) {
+        if (!are_x64_locations_equal(moves[i].dst, moves[i].src)) {
+            moves[n] = moves[i];
+            n++;
+        }
+    }
+
+    while (n != 0) {
+        u32 ready = IR_NONE;
+        for (u32 i = 0; i < n && ready == IR_NONE; i++) {
+            bool is_read = false;
+            for (u32 j = 0; j < n && !is_read; j++) {
+                is_read = j != i && are_x64_locations_equal(moves[j].src, moves[i].dst);
+            }
+            if (!is_read) {
+                ready = i;
+            }
+        }
+
+        if (ready == IR_NONE) {
+            // every destination is read by another move, save one of them
+            X64Location saved = x64_reg(moves[0].class == rc_Float ? xr_Xmm15 : xr_Rax);
+            emit_x64_move(e, moves[0].class, saved, moves[0].dst);
+            for (u32 j = 0; j < n; j++) {
+                if (are_x64_locations_equal(moves[j].src, moves[0].dst)) {
+                    moves[j].src = saved;
+                }
+            }
+            continue;
+        }
+
+        emit_x64_move(e, moves[ready].class, moves[ready].dst, moves[ready].src);
+        n--;
+        moves[ready] = moves[n];
+    }
+}
+
+// emit_x64_wrap brings result of integer operation back to width of its type
+void emit_x64_wrap(X64Emitter *e, TypeId type, X64Register reg) {
+    Type t = get_type(e->m->table, type);
+    if (t.size == 8) {
+        return;
+    }
+    if (t.kind == tk_Signed) {
+        switch (t.size) {
+        case 1:
+            emit_x64_binary(e, "movsbq", x64_sized(reg, 1), x64_reg(reg));
+            break;
+        case 2:
+            emit_x64_binary(e, "movswq", x64_sized(reg, 2), x64_reg(reg));
+            break;
+        default:
+            emit_x64_binary(e, "movslq", x64_sized(reg, 4), x64_reg(reg));
+            break;
+        }
+        return;
+    }
+    switch (t.size) {
+    case 1:
+        emit_x64_binary(e, "movzbl", x64_sized(reg, 1), x64_sized(reg, 4));
+        break;
+    case 2:
+        emit_x64_binary(e, "movzwl", x64_sized(reg, 2), x64_sized(reg, 4));
+        break;
+    default:
+        emit_x64_binary(e, "movl", x64_sized(reg, 4), x64_sized(reg, 4));
+        break;
+    }
+}
+
+// get_x64_target returns register which receives result of operation, it is
+// register of result or scratch register if result is spilled
+X64Location get_x64_target(X64Location dst, X64Register scratch) {
+    return dst.kind == xl_Register ? dst : x64_reg(scratch);
+}
+
+bool is_x64_wrapped(IrOpcode op) {
+    switch (op) {
+    case op_Add:
+    case op_Sub:
+    case op_Mul:
+    case op_Shl:
+    case op_Neg:
+    case op_BitNot:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void emit_x64_shift(X64Emitter *e, const IrInstruction *inst, X64Location t, X64Location count) {
+    bool is_signed       = inst->op == op_Shr && get_vm_kind(e->m->table, inst->type) == vk_Signed;
+    const char *mnemonic = inst->op == op_Shl ? "shlq" : is_signed ? "sarq" : "shrq";
+    if (count.kind == xl_Immediate) {
+        // count is taken as unsigned, so negative count shifts all bits out
+        u64 k = (u64)count.value;
+        if (k < 64) {
+            emit_x64_binary(e, mnemonic, count, t);
+        } else if (is_signed) {
+            emit_x64_binary(e, mnemonic, x64_imm(63), t);
+        } else {
+            emit_x64_int_move(e, t, x64_imm(0));
+        }
+        return;
+    }
+
+    X64Location rcx = x64_reg(xr_Rcx);
+    X64Location r11 = x64_reg(xr_R11);
+    emit_x64_int_move(e, rcx, count);
+    if (is_signed) {
+        emit_x64_binary(e, "movl", x64_imm(63), x64_sized(xr_R11, 4));
+        emit_x64_binary(e, "cmpq", x64_imm(63), rcx);
+        emit_x64_binary(e, "cmovaq", r11, rcx);
+        emit_x64_binary(e, mnemonic, x64_sized(xr_Rcx, 1), t);
+        return;
+    }
+    emit_x64_binary(e, mnemonic, x64_sized(xr_Rcx, 1), t);
+    emit_x64_binary(e, "xorl", x64_sized(xr_R11, 4), x64_sized(xr_R11, 4));
+    emit_x64_binary(e, "cmpq", x64_imm(63), rcx);
+    emit_x64_binary(e, "cmovaq", r11, t);
+}
+
+// emit_x64_division checks divisor before dividing, signed division by -1
+// is done with negation since idiv traps on overflow
+void emit_x64_division(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    bool is_signed  = get_vm_kind(e->m->table, inst->type) == vk_Signed;
+    X64Location rax = x64_reg(xr_Rax);
+    X64Location rcx = x64_reg(xr_Rcx);
+    X64Location rdx = x64_reg(xr_Rdx);
+    X64Location res = inst->op == op_Div ? rax : rdx;
+    e->divides      = true;
+
+    emit_x64_int_move(e, rcx, get_x64_operand(e, ops[1]));
+    emit_x64_binary(e, "testq", rcx, rcx);
+    emit_x64_jump(e, xc_E, x64_label(xlk_DivisionByZero, 0));
+    if (is_signed) {
+        X64Label divide = new_x64_local_label(e);
+        X64Label done   = new_x64_local_label(e);
+        emit_x64_binary(e, "cmpq", x64_imm(-1), rcx);
+        emit_x64_jump(e, xc_Ne, divide);
+        if (inst->op == op_Div) {
+            emit_x64_int_move(e, rax, get_x64_operand(e, ops[0]));
+            emit_x64_unary(e, "negq", rax);
+        } else {
+            emit_x64_binary(e, "xorl", x64_sized(xr_Rdx, 4), x64_sized(xr_Rdx, 4));
+        }
+        emit_x64_jump(e, xc_Always, done);
+        place_x64_label(e, divide);
+        emit_x64_int_move(e, rax, get_x64_operand(e, ops[0]));
+        emit_x64(e, "cqto", 0, nil);
+        emit_x64_unary(e, "idivq", rcx);
+        place_x64_label(e, done);
+        if (inst->op == op_Div) {
+            emit_x64_wrap(e, inst->type, xr_Rax);
+        }
+    } else {
+        emit_x64_int_move(e, rax, get_x64_operand(e, ops[0]));
+        emit_x64_binary(e, "xorl", x64_sized(xr_Rdx, 4), x64_sized(xr_Rdx, 4));
+        emit_x64_unary(e, "divq", rcx);
+    }
+    emit_x64_int_move(e, get_x64_value(e, inst->result), res);
+}
+
+const char *get_x64_int_mnemonic(IrOpcode op) {
+    switch (op) {
+    case op_Add:
+        return "addq";
+    case op_Sub:
+        return "subq";
+    case op_Mul:
+        return "imulq";
+    case op_And:
+        return "andq";
+    case op_Or:
+        return "orq";
+    default:
+        return "xorq";
+    }
+}
+
+void emit_x64_int_arithmetic(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    if (inst->op == op_Div || inst->op == op_Rem) {
+        emit_x64_division(e, inst, ops);
+        return;
+    }
+
+    X64Location dst = get_x64_value(e, inst->result);
+    X64Location t   = get_x64_target(dst, xr_Rax);
+    X64Location left;
+    X64Location right;
+    if (inst->operands_len == 1) {
+        left  = get_x64_operand(e, ops[0]);
+        right = left;
+    } else if (get_x64_immediate_operand(e, inst, ops) == 0) {
+        left  = get_x64_operand(e, ops[1]);
+        right = get_x64_operand(e, ops[0]);
+    } else {
+        left  = get_x64_operand(e, ops[0]);
+        right = get_x64_operand(e, ops[1]);
+    }
+    emit_x64_int_move(e, t, left);
+
+    switch (inst->op) {
+    case op_Neg:
+        emit_x64_unary(e, "negq", t);
+        break;
+    case op_BitNot:
+        emit_x64_unary(e, "notq", t);
+        break;
+    case op_Not:
+        emit_x64_binary(e, "xorq", x64_imm(1), t);
+        break;
+    case op_Shl:
+    case op_Shr:
+        emit_x64_shift(e, inst, t, right);
+        break;
+    case op_AndNot:
+        if (right.kind == xl_Immediate) {
+            emit_x64_binary(e, "andq", x64_imm(~right.value), t);
+        } else {
+            emit_x64_int_move(e, x64_reg(xr_R11), right);
+            emit_x64_unary(e, "notq", x64_reg(xr_R11));
+            emit_x64_binary(e, "andq", x64_reg(xr_R11), t);
+        }
+        break;
+    case op_Mul:
+        if (right.kind == xl_Immediate) {
+            X64Location operands[] = {right, t, t};
+            emit_x64(e, "imulq", 3, operands);
+            break;
+        }
+        emit_x64_binary(e, "imulq", right, t);
+        break;
+    default:
+        emit_x64_binary(e, get_x64_int_mnemonic(inst->op), right, t);
+        break;
+    }
+
+    if (get_vm_kind(e->m->table, inst->type) != vk_Bool && is_x64_wrapped(inst->op)) {
+        emit_x64_wrap(e, inst->type, t.reg);
+    }
+    emit_x64_int_move(e, dst, t);
+}
+
+void emit_x64_float_arithmetic(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    bool single     = get_vm_kind(e->m->table, inst->type) == vk_F32;
+    X64Location dst = get_x64_value(e, inst->result);
+    X64Location r11 = x64_reg(xr_R11);
+    if (inst->op == op_Neg) {
+        // sign bit is flipped in general purpose register
+        X64Location src = get_x64_value(e, ops[0]);
+        emit_x64_binary(e, "movq", src, r11);
+        emit_x64_binary(e, "btcq", x64_imm(single ? 31 : 63), r11);
+        emit_x64_binary(e, "movq", r11, dst);
+        return;
+    }
+
+    X64Location t = get_x64_target(dst, xr_Xmm15);
+    emit_x64_float_move(e, t, get_x64_value(e, ops[0]));
+    const char *mnemonic;
+    switch (inst->op) {
+    case op_Add:
+        mnemonic = single ? "addss" : "addsd";
+        break;
+    case op_Sub:
+        mnemonic = single ? "subss" : "subsd";
+        break;
+    case op_Mul:
+        mnemonic = single ? "mulss" : "mulsd";
+        break;
+    default:
+        mnemonic = single ? "divss" : "divsd";
+        break;
+    }
+    emit_x64_binary(e, mnemonic, get_x64_value(e, ops[1]), t);
+    emit_x64_float_move(e, dst, t);
+}
+
+// emit_x64_runtime_call passes values as arguments to function of native
+// runtime, result is left in rax
+void emit_x64_runtime_call(X64Emitter *e, const char *symbol, const ValueId *args, u32 len) {
+    X64Move moves[2];
+    for (u32 i = 0; i < len; i++) {
+        moves[i].class = rc_Int;
+        moves[i].dst   = x64_reg(x64_int_arg_registers[i]);
+        moves[i].src   = get_x64_value(e, args[i]);
+    }
+    emit_x64_parallel_moves(e, moves, len);
+    emit_x64_call_symbol(e, symbol);
+}
+
+X64Condition get_x64_int_condition(IrOpcode op, bool is_signed) {
+    switch (op) {
+    case op_Eq:
+        return xc_E;
+    case op_Ne:
+        return xc_Ne;
+    case op_Lt:
+        return is_signed ? xc_L : xc_B;
+    case op_Le:
+        return is_signed ? xc_Le : xc_Be;
+    case op_Gt:
+        return is_signed ? xc_G : xc_A;
+    default:
+        return is_signed ? xc_Ge : xc_Ae;
+    }
+}
+
+bool is_x64_comparison(IrOpcode op) {
+    switch (op) {
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// emit_x64_int_compare compares integer or bool operands and returns
+// condition which holds if comparison is true
+X64Condition emit_x64_int_compare(X64Emitter *e, const IrInstruction *inst) {
+    const ValueId *ops = e->fn->operands + inst->operands;
+    X64Condition c     = get_x64_int_condition(inst->op, get_x64_value_kind(e, ops[0]) == vk_Signed);
+    X64Location left   = get_x64_operand(e, ops[0]);
+    X64Location right  = get_x64_operand(e, ops[1]);
+    if (left.kind == xl_Immediate) {
+        X64Location t = left;
+        left          = right;
+        right         = t;
+        c             = x64_mirrored_conditions[c];
+    }
+    if (left.kind == xl_Memory && right.kind == xl_Memory) {
+        emit_x64_int_move(e, x64_reg(xr_R11), left);
+        left = x64_reg(xr_R11);
+    }
+    emit_x64_binary(e, "cmpq", right, left);
+    return c;
+}
+
+// emit_x64_float_compare writes result of comparison into 8-bit part of
+// register t. Unordered operands compare as not equal
+void emit_x64_float_compare(X64Emitter *e, const IrInstruction *inst, X64Register t) {
+    const ValueId *ops = e->fn->operands + inst->operands;
+    bool single        = get_x64_value_kind(e, ops[0]) == vk_F32;
+    X64Location a      = get_x64_value(e, ops[0]);
+    X64Location b      = get_x64_value(e, ops[1]);
+
+    // ucomis compares its second operand with the first one, which may be in
+    // memory. Less comparisons become greater comparisons with swapped
+    // operands, so that unordered result is false
+    bool is_less      = inst->op == op_Lt || inst->op == op_Le;
+    X64Location first = is_less ? a : b;
+    X64Location other = is_less ? b : a;
+    if (other.kind != xl_Register) {
+        emit_x64_float_move(e, x64_reg(xr_Xmm15), other);
+        other = x64_reg(xr_Xmm15);
+    }
+    emit_x64_binary(e, single ? "ucomiss" : "ucomisd", first, other);
+
+    X64Location t8  = x64_sized(t, 1);
+    X64Location r8  = x64_sized(xr_R11, 1);
+    switch (inst->op) {
+    case op_Eq:
+        emit_x64_unary(e, "sete", t8);
+        emit_x64_unary(e, "setnp", r8);
+        emit_x64_binary(e, "andb", r8, t8);
+        break;
+    case op_Ne:
+        emit_x64_unary(e, "setne", t8);
+        emit_x64_unary(e, "setp", r8);
+        emit_x64_binary(e, "orb", r8, t8);
+        break;
+    case op_Lt:
+    case op_Gt:
+        emit_x64_unary(e, "seta", t8);
+        break;
+    default:
+        emit_x64_unary(e, "setae", t8);
+        break;
+    }
+}
+
+void emit_x64_comparison(X64Emitter *e, const IrInstruction *inst) {
+    const ValueId *ops = e->fn->operands + inst->operands;
+    X64Location dst    = get_x64_value(e, inst->result);
+    X64Location t      = get_x64_target(dst, xr_Rax);
+    switch (get_x64_value_kind(e, ops[0])) {
+    case vk_F32:
+    case vk_F64:
+        emit_x64_float_compare(e, inst, t.reg);
+        break;
+    case vk_Str: {
+        emit_x64_runtime_call(e, "ku_rt_compare", ops, 2);
+        emit_x64_binary(e, "cmpl", x64_imm(0), x64_sized(xr_Rax, 4));
+        emit_x64_unary(e, x64_set_names[get_x64_int_condition(inst->op, true)], x64_sized(t.reg, 1));
+        break;
+    }
+    default:
+        emit_x64_unary(e, x64_set_names[emit_x64_int_compare(e, inst)], x64_sized(t.reg, 1));
+        break;
+    }
+    emit_x64_binary(e, "movzbl", x64_sized(t.reg, 1), x64_sized(t.reg, 4));
+    emit_x64_int_move(e, dst, t);
+}
+
+// is_x64_fused_comparison tells whether integer comparison is used only as
+// condition of the following branch, so that flags are tested directly
+bool is_x64_fused_comparison(const X64Emitter *e, const IrInstruction *inst, const IrInstruction *term) {
+    if (!is_x64_comparison(inst->op) || term->op != op_Branch) {
+        return false;
+    }
+    if (e->fn->operands[term->operands] != inst->result || e->uses[inst->result] != 1) {
+        return false;
+    }
+    VmKind kind = get_x64_value_kind(e, e->fn->operands[inst->operands]);
+    return kind == vk_Signed || kind == vk_Unsigned || kind == vk_Bool;
+}
+
+// emit_x64_edge passes arguments to target block and jumps there unless
+// target is placed right after current block
+void emit_x64_edge(X64Emitter *e, const IrInstruction *inst, u32 index, BlockId next) {
+    u32 len;
+    const ValueId *args = get_ir_target_args(e->fn, inst, index, &len);
+    BlockId target      = inst->targets[index];
+    ValueId params      = e->fn->blocks[target].params;
+    X64Move *moves      = (X64Move *)alloc_ir_temp((u64)len * sizeof(X64Move) + 1);
+    u32 n               = 0;
+    for (u32 i = 0; i < len; i++) {
+        if (e->alloc.regs[params + i] == IR_NONE) {
+            continue;
+        }
+        moves[n].class = e->classes[params + i];
+        moves[n].dst   = get_x64_value(e, params + i);
+        moves[n].src   = get_x64_value(e, args[i]);
+        n++;
+    }
+    emit_x64_parallel_moves(e, moves, n);
+    free_mem(moves);
+    if (target != next) {
+        emit_x64_jump(e, xc_Always, x64_label(xlk_Block, target));
+    }
+}
+
+// emit_x64_branch jumps on condition c which holds if branch goes to its
+// first target
+void emit_x64_branch(X64Emitter *e, const IrInstruction *inst, X64Condition c, BlockId next) {
+    u32 then_len;
+    u32 else_len;
+    get_ir_target_args(e->fn, inst, 0, &then_len);
+    get_ir_target_args(e->fn, inst, 1, &else_len);
+    BlockId then_block = inst->targets[0];
+    BlockId else_block = inst->targets[1];
+
+    if (then_len == 0 && else_len == 0) {
+        if (then_block == next) {
+            emit_x64_jump(e, x64_negated_conditions[c], x64_label(xlk_Block, else_block));
+        } else {
+            emit_x64_jump(e, c, x64_label(xlk_Block, then_block));
+            if (else_block != next) {
+                emit_x64_jump(e, xc_Always, x64_label(xlk_Block, else_block));
+            }
+        }
+        return;
+    }
+
+    // arguments of each target are moved on its own path
+    X64Label skip = new_x64_local_label(e);
+    emit_x64_jump(e, x64_negated_conditions[c], skip);
+    emit_x64_edge(e, inst, 0, IR_NONE);
+    place_x64_label(e, skip);
+    emit_x64_edge(e, inst, 1, next);
+}
+
+void emit_x64_bool_branch(X64Emitter *e, const IrInstruction *inst, BlockId next) {
+    X64Location cond = get_x64_value(e, e->fn->operands[inst->operands]);
+    if (cond.kind == xl_Register) {
+        emit_x64_binary(e, "testq", cond, cond);
+    } else {
+        emit_x64_binary(e, "cmpq", x64_imm(0), cond);
+    }
+    emit_x64_branch(e, inst, xc_Ne, next);
+}
+
+// emit_x64_call places arguments into registers and stack slots of System
+// V convention, tuple results are written into frame of caller
+void emit_x64_call(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    const IrFunction *callee = &e->m->functions[inst->imm];
+    bool tuple               = is_x64_tuple(e, callee->result);
+    X64Move *moves           = (X64Move *)alloc_ir_temp((u64)inst->operands_len * sizeof(X64Move) + 1);
+    u32 ints                 = tuple ? 1 : 0;
+    u32 floats               = 0;
+    u32 stack                = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        RaClass class  = e->classes[ops[i]];
+        moves[i].class = class;
+        moves[i].src   = get_x64_value(e, ops[i]);
+        if (class == rc_Float && floats < x64_float_arg_registers_len) {
+            moves[i].dst = x64_reg((X64Register)(xr_Xmm0 + floats));
+            floats++;
+        } else if (class != rc_Float && ints < x64_int_arg_registers_len) {
+            moves[i].dst = x64_reg(x64_int_arg_registers[ints]);
+            ints++;
+        } else {
+            moves[i].dst = x64_mem(xr_Rsp, 8 * (i64)stack);
+            stack++;
+        }
+    }
+    emit_x64_parallel_moves(e, moves, inst->operands_len);
+    free_mem(moves);
+
+    if (tuple) {
+        u32 members = get_tuple_members(e->m->table, &callee->result).len;
+        i64 offset  = get_x64_word_offset(e, e->tuple_words[inst->result], members);
+        emit_x64_binary(e, "leaq", x64_mem(xr_Rbp, offset), x64_reg(xr_Rdi));
+    }
+    begin_x64_instruction(e, "call ");
+    write_x64_symbol(e, (u32)inst->imm);
+    write_byte_to_output(e->out, '\n');
+
+    if (inst->result != IR_NONE && !tuple && e->alloc.regs[inst->result] != IR_NONE) {
+        RaClass class = e->classes[inst->result];
+        emit_x64_move(e, class, get_x64_value(e, inst->result), x64_reg(class == rc_Float ? xr_Xmm0 : xr_Rax));
+    }
+}
+
+// emit_x64_builtin_call stores arguments into frame as VmValue array, kinds
+// of values are placed into read-only data
+void emit_x64_builtin_call(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    const TypeTable *table = e->m->table;
+    X64Label kinds         = new_x64_local_label(e);
+    X64Location xmm15      = x64_reg(xr_Xmm15);
+
+    u32 len = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        len += get_tuple_members(table, &e->fn->values[ops[i]]).len;
+    }
+    i64 base = get_x64_word_offset(e, e->builtin_word, len);
+
+    write_x64_cstr(e, "    .pushsection .rodata\n    .p2align 2\n");
+    place_x64_label(e, kinds);
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        TypeList members = get_tuple_members(table, &e->fn->values[ops[i]]);
+        for (u32 j = 0; j < members.len; j++) {
+            write_x64_cstr(e, "    .long ");
+            write_u64_to_output(e->out, get_vm_kind(table, members.elem[j]));
+            write_byte_to_output(e->out, '\n');
+        }
+    }
+    write_x64_cstr(e, "    .popsection\n");
+
+    u32 next = 0;
+    for (u32 i = 0; i < inst->operands_len; i++) {
+        ValueId v        = ops[i];
+        TypeList members = get_tuple_members(table, &e->fn->values[v]);
+        bool tuple       = is_x64_tuple(e, e->fn->values[v]);
+        for (u32 j = 0; j < members.len; j++) {
+            X64Location src = get_x64_value(e, v);
+            if (tuple) {
+                src = x64_mem(xr_Rbp, get_x64_word_offset(e, e->tuple_words[v], members.len) + 8 * (i64)j);
+            }
+            X64Location dst = x64_mem(xr_Rbp, base + 8 * (i64)next);
+            switch (get_vm_kind(table, members.elem[j])) {
+            case vk_F32:
+                // print builtins take floats of both sizes as f64
+                emit_x64_binary(e, "cvtss2sd", src, xmm15);
+                emit_x64_float_move(e, dst, xmm15);
+                break;
+            case vk_F64:
+                emit_x64_float_move(e, dst, src);
+                break;
+            default:
+                emit_x64_int_move(e, dst, src);
+                break;
+            }
+            next++;
+        }
+    }
+
+    emit_x64_binary(e, "movl", x64_imm((i64)inst->imm), x64_sized(xr_Rdi, 4));
+    emit_x64_binary(e, "leaq", x64_mem(xr_Rbp, base), x64_reg(xr_Rsi));
+    emit_x64_address(e, nil, kinds, xr_Rdx);
+    emit_x64_binary(e, "movl", x64_imm(len), x64_sized(xr_Rcx, 4));
+    emit_x64_call_symbol(e, "ku_rt_print");
+}
+
+void write_x64_string_bytes(X64Emitter *e, str s) {
+    write_x64_cstr(e, "    .ascii \"");
+    for (u64 i = 0; i < s.len; i++) {
+        byte b = s.bytes[i];
+        if (b >= 0x20 && b < 0x7F && b != '"' && b != '\\') {
+            write_byte_to_output(e->out, b);
+            continue;
+        }
+        write_byte_to_output(e->out, '\\');
+        write_byte_to_output(e->out, (byte)('0' + (b >> 6)));
+        write_byte_to_output(e->out, (byte)('0' + ((b >> 3) & 7)));
+        write_byte_to_output(e->out, (byte)('0' + (b & 7)));
+    }
+    write_x64_cstr(e, "\"\n");
+}
+
+// emit_x64_string places VmString header and bytes of literal into data
+// sections and loads its address
+void emit_x64_string(X64Emitter *e, str s, X64Location dst) {
+    u32 index = e->strings;
+    e->strings++;
+
+    write_x64_cstr(e, "    .pushsection .rodata\n.Lku_str_bytes");
+    write_u64_to_output(e->out, index);
+    write_x64_cstr(e, ":\n");
+    write_x64_string_bytes(e, s);
+    write_x64_cstr(e, "    .popsection\n    .pushsection .data.rel.ro,\"aw\"\n    .p2align 3\n.Lku_str");
+    write_u64_to_output(e->out, index);
+    write_x64_cstr(e, ":\n    .quad .Lku_str_bytes");
+    write_u64_to_output(e->out, index);
+    write_x64_cstr(e, "\n    .quad ");
+    write_u64_to_output(e->out, s.len);
+    write_x64_cstr(e, "\n    .quad 0\n    .popsection\n");
+
+    X64Location t = get_x64_target(dst, xr_Rax);
+    begin_x64_instruction(e, "leaq .Lku_str");
+    write_u64_to_output(e->out, index);
+    write_x64_cstr(e, "(%rip), ");
+    write_x64_location(e, t);
+    write_byte_to_output(e->out, '\n');
+    emit_x64_int_move(e, dst, t);
+}
+
+void emit_x64_const(X64Emitter *e, const IrInstruction *inst) {
+    if (e->immediate_only[inst->result] || e->alloc.regs[inst->result] == IR_NONE) {
+        return;
+    }
+    X64Location dst = get_x64_value(e, inst->result);
+    X64Location r11 = x64_reg(xr_R11);
+    switch (get_vm_kind(e->m->table, inst->type)) {
+    case vk_Str: {
+        // zero value of string type is empty string
+        X64Location t = get_x64_target(dst, xr_Rax);
+        emit_x64_address(e, "empty_vm_string", x64_label(xlk_Local, 0), t.reg);
+        emit_x64_int_move(e, dst, t);
+        return;
+    }
+    case vk_F32:
+    case vk_F64: {
+        u64 bits = inst->imm;
+        if (get_vm_kind(e->m->table, inst->type) == vk_F32) {
+            f64 d;
+            memcpy(&d, &bits, sizeof(f64));
+            f32 f = (f32)d;
+            u32 b;
+            memcpy(&b, &f, sizeof(u32));
+            bits = b;
+        }
+        if (bits == 0 && dst.kind == xl_Register) {
+            emit_x64_binary(e, "xorps", dst, dst);
+            return;
+        }
+        emit_x64_binary(e, "movabsq", x64_imm((i64)bits), r11);
+        emit_x64_binary(e, "movq", r11, dst);
+        return;
+    }
+    default:
+        break;
+    }
+
+    i64 x = (i64)inst->imm;
+    if (x >= INT32_MIN && x <= INT32_MAX) {
+        emit_x64_int_move(e, dst, x64_imm(x));
+        return;
+    }
+    X64Location t = get_x64_target(dst, xr_R11);
+    emit_x64_binary(e, "movabsq", x64_imm(x), t);
+    emit_x64_int_move(e, dst, t);
+}
+
+void emit_x64_epilogue(X64Emitter *e) {
+    if (e->saved_len != 0) {
+        emit_x64_binary(e, "leaq", x64_mem(xr_Rbp, -8 * (i64)e->saved_len), x64_reg(xr_Rsp));
+    } else {
+        emit_x64_binary(e, "movq", x64_reg(xr_Rbp), x64_reg(xr_Rsp));
+    }
+    for (u32 i = e->saved_len; i > 0; i--) {
+        emit_x64_unary(e, "popq", x64_reg(e->saved[i - 1]));
+    }
+    emit_x64_unary(e, "popq", x64_reg(xr_Rbp));
+    emit_x64(e, "ret", 0, nil);
+}
+
+// Tuple results are stored through address saved in prologue
+void emit_x64_return(X64Emitter *e, const IrInstruction *inst, const ValueId *ops) {
+    if (is_x64_tuple(e, e->fn->result)) {
+        emit_x64_binary(e, "movq", x64_mem(xr_Rbp, get_x64_word_offset(e, e->ret_word, 1)), x64_reg(xr_Rax));
+        for (u32 i = 0; i < inst->operands_len; i++) {
+            emit_x64_move(e, e->classes[ops[i]], x64_mem(xr_Rax, 8 * (i64)i), get_x64_value(e, ops[i]));
+        }
+    } else if (inst->operands_len == 1) {
+        RaClass class = e->classes[ops[0]];
+        emit_x64_move(e, class, x64_reg(class == rc_Float ? xr_Xmm0 : xr_Rax), get_x64_value(e, ops[0]));
+    }
+    emit_x64_epilogue(e);
+}
+
+void emit_x64_instruction(X64Emitter *e, const IrInstruction *inst, BlockId next) {
+    const ValueId *ops = e->fn->operands + inst->operands;
+    switch (inst->op) {
+    case op_Const:
+        emit_x64_const(e, inst);
+        break;
+    case op_String:
+        emit_x64_string(e, e->fn->strings[inst->imm], get_x64_value(e, inst->result));
+        break;
+    case op_Eq:
+    case op_Ne:
+    case op_Lt:
+    case op_Le:
+    case op_Gt:
+    case op_Ge:
+        emit_x64_comparison(e, inst);
+        break;
+    case op_Call:
+        emit_x64_call(e, inst, ops);
+        break;
+    case op_CallBuiltin:
+        emit_x64_builtin_call(e, inst, ops);
+        break;
+    case op_Extract: {
+        ValueId tuple   = ops[0];
+        u32 members     = get_tuple_members(e->m->table, &e->fn->values[tuple]).len;
+        i64 offset      = get_x64_word_offset(e, e->tuple_words[tuple], members) + 8 * (i64)inst->imm;
+        X64Location src = x64_mem(xr_Rbp, offset);
+        emit_x64_move(e, e->classes[inst->result], get_x64_value(e, inst->result), src);
+        break;
+    }
+    case op_Jump:
+        emit_x64_edge(e, inst, 0, next);
+        break;
+    case op_Branch:
+        emit_x64_bool_branch(e, inst, next);
+        break;
+    case op_Return:
+        emit_x64_return(e, inst, ops);
+        break;
+    case op_Add:
+        if (get_vm_kind(e->m->table, inst->type) == vk_Str) {
+            emit_x64_runtime_call(e, "ku_rt_concat", ops, 2);
+            emit_x64_int_move(e, get_x64_value(e, inst->result), x64_reg(xr_Rax));
+            break;
+        }
+        // fallthrough
+    default:
+        if (e->classes[inst->result] == rc_Float) {
+            emit_x64_float_arithmetic(e, inst, ops);
+        } else {
+            emit_x64_int_arithmetic(e, inst, ops);
+        }
+        break;
+    }
+}
+
+// analyze_x64_values finds definitions, counts uses, selects constants which
+// are encoded only as immediates and classes of values
+void analyze_x64_values(X64Emitter *e) {
+    const IrFunction *fn = e->fn;
+    u64 size             = (u64)fn->values_len * sizeof(u32);
+    e->defs              = (u32 *)alloc_ir_temp(size + 1);
+    e->uses              = (u32 *)alloc_ir_temp(size + 1);
+    e->immediate_only    = (bool *)alloc_ir_temp(fn->values_len * sizeof(bool) + 1);
+    e->classes           = (RaClass *)alloc_ir_temp(fn->values_len * sizeof(RaClass) + 1);
+    e->calls             = (bool *)alloc_ir_temp(fn->instructions_len * sizeof(bool) + 1);
+    u32 *immediate_uses  = (u32 *)alloc_ir_temp(size + 1);
+    memset(e->uses, 0, size);
+    memset(immediate_uses, 0, size);
+    for (u32 v = 0; v < fn->values_len; v++) {
+        e->defs[v] = IR_NONE;
+    }
+
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        const IrInstruction *inst = &fn->instructions[i];
+        if (inst->result != IR_NONE) {
+            e->defs[inst->result] = i;
+        }
+        for (u32 j = 0; j < inst->operands_len; j++) {
+            e->uses[fn->operands[inst->operands + j]]++;
+        }
+    }
+    for (u32 i = 0; i < fn->instructions_len; i++) {
+        const IrInstruction *inst = &fn->instructions[i];
+        const ValueId *ops        = fn->operands + inst->operands;
+        u32 index                 = get_x64_immediate_operand(e, inst, ops);
+        if (index != IR_NONE) {
+            immediate_uses[ops[index]]++;
+        }
+
+        // string operations are implemented by runtime
+        VmKind kind = inst->operands_len != 0 ? get_x64_value_kind(e, ops[0]) : vk_Signed;
+        e->calls[i] = inst->op == op_Call || inst->op == op_CallBuiltin ||
+                      (kind == vk_Str && (inst->op == op_Add || is_x64_comparison(inst->op)));
+    }
+    for (u32 v = 0; v < fn->values_len; v++) {
+        e->immediate_only[v] = immediate_uses[v] != 0 && immediate_uses[v] == e->uses[v];
+        e->classes[v]        = e->immediate_only[v] ? rc_None : get_x64_class(e->m->table, fn->values[v]);
+    }
+    free_mem(immediate_uses);
+}
+
+// layout_x64_frame assigns frame words and computes size of frame, so that
+// stack pointer stays aligned to 16 bytes at calls
+void layout_x64_frame(X64Emitter *e, const IrCfg *cfg) {
+    const IrFunction *fn   = e->fn;
+    const TypeTable *table = e->m->table;
+    e->saved_len           = 0;
+    for (u32 i = 0; i < x64_registers[rc_Int].callee_saved_len; i++) {
+        u32 reg = x64_registers[rc_Int].callee_saved[i];
+        if ((e->alloc.used & ((u64)1 << reg)) != 0) {
+            e->saved[e->saved_len] = (X64Register)reg;
+            e->saved_len++;
+        }
+    }
+
+    u32 words      = e->alloc.slots_len;
+    e->ret_word    = words;
+    e->tuple_words = (u32 *)alloc_ir_temp((u64)fn->values_len * sizeof(u32) + 1);
+    if (is_x64_tuple(e, fn->result)) {
+        words++;
+    }
+
+    u32 builtin_words = 0;
+    u32 stack_words   = 0;
+    for (u32 i = 0; i < cfg->reachable; i++) {
+        IrBlock block = fn->blocks[cfg->order[i]];
+        for (u32 j = 0; j < block.len; j++) {
+            const IrInstruction *inst = &fn->instructions[block.start + j];
+            const ValueId *ops        = fn->operands + inst->operands;
+            if (inst->op == op_Call && inst->result != IR_NONE && is_x64_tuple(e, inst->type)) {
+                e->tuple_words[inst->result] = words;
+                words += get_tuple_members(table, &inst->type).len;
+            }
+            if (inst->op == op_Call) {
+                u32 ints   = is_x64_tuple(e, inst->type) ? 1 : 0;
+                u32 floats = 0;
+                u32 stack  = 0;
+                for (u32 k = 0; k < inst->operands_len; k++) {
+                    if (e->classes[ops[k]] == rc_Float && floats < x64_float_arg_registers_len) {
+                        floats++;
+                    } else if (e->classes[ops[k]] != rc_Float && ints < x64_int_arg_registers_len) {
+                        ints++;
+                    } else {
+                        stack++;
+                    }
+                }
+                if (stack > stack_words) {
+                    stack_words = stack;
+                }
+            }
+            if (inst->op == op_CallBuiltin) {
+                u32 len = 0;
+                for (u32 k = 0; k < inst->operands_len; k++) {
+                    len += get_tuple_members(table, &fn->values[ops[k]]).len;
+                }
+                if (len > builtin_words) {
+                    builtin_words = len;
+                }
+            }
+        }
+    }
+    e->builtin_word = words;
+    words += builtin_words;
+
+    e->frame_size = 8 * (words + stack_words);
+    if ((8 * e->saved_len + e->frame_size) % 16 != 0) {
+        e->frame_size += 8;
+    }
+}
+
+// emit_x64_prologue saves registers, allocates frame, checks stack limit
+// and moves parameters from registers of calling convention
+void emit_x64_prologue(X64Emitter *e) {
+    const IrFunction *fn = e->fn;
+    emit_x64_unary(e, "pushq", x64_reg(xr_Rbp));
+    emit_x64_binary(e, "movq", x64_reg(xr_Rsp), x64_reg(xr_Rbp));
+    for (u32 i = 0; i < e->saved_len; i++) {
+        emit_x64_unary(e, "pushq", x64_reg(e->saved[i]));
+    }
+    if (e->frame_size != 0) {
+        emit_x64_binary(e, "subq", x64_imm(e->frame_size), x64_reg(xr_Rsp));
+    }
+    write_x64_cstr(e, "    cmpq ku_rt_stack_limit(%rip), %rsp\n");
+    emit_x64_jump(e, xc_B, x64_label(xlk_StackOverflow, 0));
+
+    IrBlock entry  = fn->blocks[0];
+    X64Move *moves = (X64Move *)alloc_ir_temp((u64)(entry.params_len + 1) * sizeof(X64Move));
+    u32 n          = 0;
+    u32 ints       = 0;
+    u32 floats     = 0;
+    u32 stack      = 0;
+    if (is_x64_tuple(e, fn->result)) {
+        moves[n].class = rc_Int;
+        moves[n].dst   = x64_mem(xr_Rbp, get_x64_word_offset(e, e->ret_word, 1));
+        moves[n].src   = x64_reg(xr_Rdi);
+        n++;
+        ints++;
+    }
+    for (u32 i = 0; i < entry.params_len; i++) {
+        ValueId v     = entry.params + i;
+        RaClass class = get_x64_class(e->m->table, fn->values[v]);
+        X64Location src;
+        if (class == rc_Float && floats < x64_float_arg_registers_len) {
+            src = x64_reg((X64Register)(xr_Xmm0 + floats));
+            floats++;
+        } else if (class != rc_Float && ints < x64_int_arg_registers_len) {
+            src = x64_reg(x64_int_arg_registers[ints]);
+            ints++;
+        } else {
+            // return address and saved frame pointer precede stack arguments
+            src = x64_mem(xr_Rbp, 16 + 8 * (i64)stack);
+            stack++;
+        }
+        if (e->alloc.regs[v] == IR_NONE) {
+            continue;
+        }
+        moves[n].class = class;
+        moves[n].dst   = get_x64_value(e, v);
+        moves[n].src   = src;
+        n++;
+    }
+    emit_x64_parallel_moves(e, moves, n);
+    free_mem(moves);
+}
+
+// emit_x64_failure writes code which reports runtime error of given kind
+void emit_x64_failure(X64Emitter *e, X64LabelKind kind, NativeError error) {
+    place_x64_label(e, x64_label(kind, 0));
+    emit_x64_binary(e, "movl", x64_imm(error), x64_sized(xr_Rdi, 4));
+    emit_x64_address(e, nil, x64_label(xlk_Name, 0), xr_Rsi);
+    emit_x64_call_symbol(e, "ku_rt_fail");
+}
+
+void write_x64_function(X64Emitter *e, u32 index) {
+    const IrFunction *fn = &e->m->functions[index];
+    e->fn                = fn;
+    e->fn_index          = index;
+    e->labels            = 0;
+    e->divides           = false;
+
+    IrCfg cfg = compute_ir_cfg(fn);
+    analyze_x64_values(e);
+    e->alloc = allocate_ir_registers(fn, &cfg, e->classes, e->calls, x64_registers);
+    layout_x64_frame(e, &cfg);
+
+    write_x64_cstr(e, "\n    .p2align 4\n    .type ");
+    write_x64_symbol(e, index);
+    write_x64_cstr(e, ", @function\n");
+    write_x64_symbol(e, index);
+    write_x64_cstr(e, ":\n");
+    emit_x64_prologue(e);
+
+    for (u32 i = 0; i < cfg.reachable; i++) {
+        BlockId b     = cfg.order[i];
+        BlockId next  = i + 1 < cfg.reachable ? cfg.order[i + 1] : IR_NONE;
+        IrBlock block = fn->blocks[b];
+        place_x64_label(e, x64_label(xlk_Block, b));
+        for (u32 j = 0; j < block.len; j++) {
+            const IrInstruction *inst = &fn->instructions[block.start + j];
+            if (j + 2 == block.len && is_x64_fused_comparison(e, inst, inst + 1)) {
+                emit_x64_branch(e, inst + 1, emit_x64_int_compare(e, inst), next);
+                break;
+            }
+            emit_x64_instruction(e, inst, next);
+        }
+    }
+
+    emit_x64_failure(e, xlk_StackOverflow, ne_StackOverflow);
+    if (e->divides) {
+        emit_x64_failure(e, xlk_DivisionByZero, ne_DivisionByZero);
+    }
+    write_x64_cstr(e, "    .size ");
+    write_x64_symbol(e, index);
+    write_x64_cstr(e, ", .-");
+    write_x64_symbol(e, index);
+    write_x64_cstr(e, "\n    .pushsection .rodata\n");
+    place_x64_label(e, x64_label(xlk_Name, 0));
+    write_x64_cstr(e, "    .asciz \"");
+    write_str_to_output(e->out, fn->name);
+    write_x64_cstr(e, "\"\n    .popsection\n");
+
+    free_ir_cfg(&cfg);
+    free_ra_allocation(&e->alloc);
+    free_mem(e->defs);
+    free_mem(e->uses);
+    free_mem(e->immediate_only);
+    free_mem(e->classes);
+    free_mem(e->calls);
+    free_mem(e->tuple_words);
+}
+
+// write_x64_entry writes ku_entry which reserves memory for results of
+// entry function, stack stays aligned to 16 bytes at the call
+void write_x64_entry(X64Emitter *e, u32 entry) {
+    const IrFunction *fn = &e->m->functions[entry];
+    u32 words            = get_tuple_members(e->m->table, &fn->result).len;
+    if (words % 2 == 0) {
+        words++;
+    }
+    write_x64_cstr(e, "\n    .globl ku_entry\n    .p2align 4\n    .type ku_entry, @function\nku_entry:\n");
+    emit_x64_binary(e, "subq", x64_imm(8 * (i64)words), x64_reg(xr_Rsp));
+    if (is_x64_tuple(e, fn->result)) {
+        emit_x64_binary(e, "movq", x64_reg(xr_Rsp), x64_reg(xr_Rdi));
+    }
+    begin_x64_instruction(e, "call ");
+    write_x64_symbol(e, entry);
+    write_byte_to_output(e->out, '\n');
+    emit_x64_binary(e, "addq", x64_imm(8 * (i64)words), x64_reg(xr_Rsp));
+    emit_x64(e, "ret", 0, nil);
+    write_x64_cstr(e, "    .size ku_entry, .-ku_entry\n");
+}
+
+void write_x64_module(OutputBuffer *out, const IrModule *m, u32 entry) {
+    X64Emitter e = {
+        .out            = out,
+        .m              = m,
+        .strings        = 0,
+        .fn             = nil,
+        .fn_index       = 0,
+        .defs           = nil,
+        .uses           = nil,
+        .immediate_only = nil,
+        .classes        = nil,
+        .calls          = nil,
+        .saved_len      = 0,
+        .ret_word       = 0,
+        .tuple_words    = nil,
+        .builtin_word   = 0,
+        .frame_size     = 0,
+        .labels         = 0,
+        .divides        = false,
+    };
+    write_x64_cstr(&e, "    .text\n");
+    for (u32 i = 0; i < m->functions_len; i++) {
+        write_x64_function(&e, i);
+    }
+    write_x64_entry(&e, entry);
+    write_x64_cstr(&e, "\n    .section .note.GNU-stack,\"\",@progbits\n");
+}
@@ -0,0 +1,24 @@
+#ifndef KU_X64_H
+#define KU_X64_H
+
+#include "ir.h"
+#include "output.h"
+#include "types.h"
+
+// Functions of module become local symbols "ku.<name>" and follow System V
+// AMD64 calling convention: integer, bool and str arguments are passed in
+// rdi, rsi, rdx, rcx, r8 and r9, floats in xmm0-xmm7, the rest on stack.
+// Single result is returned in rax or xmm0, tuple of results is written to
+// memory passed as hidden first argument, like large structures in C.
+// Integers are kept extended to 64 bits the same way as in bytecode, f32
+// values are single precision numbers in the low part of xmm register.
+//
+// Program is linked with native runtime (see native_rt.h), which calls
+// ku_entry symbol emitted for entry function and implements strings,
+// printing and runtime errors
+
+// write_x64_module writes GNU assembler source for valid IR module, entry
+// is index of function without parameters which runs the program
+void write_x64_module(OutputBuffer *out, const IrModule *m, u32 entry);
+
+#endif // KU_X64_H
@@ -3,8 +3,8 @@
 #include "types.h"
 
 
-void *xmalloc(size_t size) {
-    void *ptr = malloc(size);
+void *xmalloc(AllocTag tag, size_t size) {
+    void *ptr = alloc_mem(tag, size);
     if (ptr == nil) {
         fatal(1, "not enough memory");
     }
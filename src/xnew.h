@@ -3,8 +3,10 @@
 
 #include <stdlib.h>
 
-#define xnew(type) (type *)xmalloc(sizeof(type))
+#include "alloc.h"
 
-void *xmalloc(size_t size);
+#define xnew(tag, type) (type *)xmalloc(tag, sizeof(type))
+
+void *xmalloc(AllocTag tag, size_t size);
 
 #endif // KU_XNEW_H